@@ -0,0 +1,380 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <cxxopts.hpp>
+
+#include "Globals.hpp"
+#include "ThreadPool.hpp"
+#include "DataStreamer.hpp"
+#include "FrameCodec.hpp"
+#include "FrameRecorder.hpp"
+#include "ReplayBuffer.hpp"
+
+// VarjoExamples namespace contains simple example wrappers for using Varjo API features.
+// These are only meant to be used in SDK example applications. In your own application,
+// use your own production quality integration layer.
+using namespace VarjoExamples;
+
+namespace
+{
+//! Synthetic camera footage settings
+struct Footage {
+    varjo_TextureFormat format = varjo_TextureFormat_YUV422;  //!< Frame format
+    int width = 1152;                                         //!< Frame width
+    int height = 1152;                                        //!< Frame height
+    int noise = 2;                                            //!< Sensor noise amplitude
+    int motion = 1;                                           //!< Horizontal pan in pixels per frame
+};
+
+// Deterministic hash used for texture and noise
+inline uint32_t hash(uint32_t x)
+{
+    x ^= x >> 16;
+    x *= 0x7feb352d;
+    x ^= x >> 15;
+    x *= 0x846ca68b;
+    x ^= x >> 16;
+    return x;
+}
+
+// Generate packed frame of slowly panning textured scene with per frame sensor noise. Same frame
+// index always produces the same frame, so decoded frames can be verified without storing originals.
+void generateFrame(const Footage& footage, int channel, int frameIndex, std::vector<uint8_t>& out)
+{
+    const int w = footage.width;
+    const int h = footage.height;
+    const int chromaRows = (footage.format == varjo_TextureFormat_NV12) ? (h + 1) / 2 : h;
+    out.resize(FrameCodec::getPackedSize(footage.format, w, h));
+
+    const int pan = frameIndex * footage.motion + channel * 24;
+    const uint32_t seed = hash(static_cast<uint32_t>(frameIndex * 2 + channel) + 0x9e3779b9u);
+    const int noiseRange = 2 * footage.noise + 1;
+
+    for (int y = 0; y < h; y++) {
+        uint8_t* row = out.data() + static_cast<size_t>(w) * y;
+        for (int x = 0; x < w; x++) {
+            // Smooth gradients with a grid of flat blocks, like walls and furniture
+            const int sx = x + pan;
+            const float base = 110.0f + 50.0f * std::sin(sx * 0.011f) * std::cos(y * 0.007f) + 20.0f * std::sin((sx + y) * 0.031f);
+            const uint32_t block = hash(static_cast<uint32_t>((sx >> 6) * 7919 + (y >> 6)));
+            const int value = static_cast<int>(base) + static_cast<int>(block & 31) - 16;
+            const int noise = (footage.noise > 0) ? static_cast<int>(hash(seed ^ static_cast<uint32_t>(y * w + x)) % noiseRange) - footage.noise : 0;
+            row[x] = static_cast<uint8_t>(std::max(16, std::min(235, value + noise)));
+        }
+    }
+
+    for (int y = 0; y < chromaRows; y++) {
+        uint8_t* row = out.data() + static_cast<size_t>(w) * (h + y);
+        const int ly = (footage.format == varjo_TextureFormat_NV12) ? y * 2 : y;
+        for (int x = 0; x < w; x += 2) {
+            const int sx = x + pan;
+            const uint32_t block = hash(static_cast<uint32_t>((sx >> 6) * 7919 + (ly >> 6)));
+            row[x] = static_cast<uint8_t>(128 + static_cast<int>(block >> 8 & 15) - 8);
+            if (x + 1 < w) {
+                row[x + 1] = static_cast<uint8_t>(128 + static_cast<int>(block >> 16 & 15) - 8 + static_cast<int>(8.0f * std::sin(ly * 0.005f)));
+            }
+        }
+    }
+}
+
+// Returns buffer metadata of packed frame
+varjo_BufferMetadata getPackedMetadata(varjo_TextureFormat format, int width, int height)
+{
+    varjo_BufferMetadata buffer{};
+    buffer.format = format;
+    buffer.type = varjo_BufferType_CPU;
+    buffer.byteSize = static_cast<int32_t>(FrameCodec::getPackedSize(format, width, height));
+    buffer.rowStride = width;
+    buffer.width = width;
+    buffer.height = height;
+    return buffer;
+}
+
+// Encode and decode synthetic stereo footage in memory and report throughput
+bool runCodecBenchmark(ThreadPool& threadPool, const Footage& footage, int frames, int sliceCount, int keyframeInterval)
+{
+    const varjo_BufferMetadata buffer = getPackedMetadata(footage.format, footage.width, footage.height);
+    const size_t frameSize = static_cast<size_t>(buffer.byteSize);
+
+    FrameEncoder encoders[2] = {{threadPool, sliceCount}, {threadPool, sliceCount}};
+    FrameDecoder decoders[2] = {{threadPool}, {threadPool}};
+    std::vector<std::vector<uint8_t>> encoded(static_cast<size_t>(frames) * 2);
+    std::vector<uint8_t> frame;
+
+    int64_t encodeNs = 0;
+    int64_t encodedBytes = 0;
+    int64_t keyframeBytes = 0;
+    int keyframes = 0;
+    for (int i = 0; i < frames; i++) {
+        for (int c = 0; c < 2; c++) {
+            generateFrame(footage, c, i, frame);
+            auto& out = encoded[i * 2 + c];
+            const bool keyframe = (keyframeInterval > 0) && (i % keyframeInterval == 0);
+            const int64_t start = getTimestampNs();
+            if (!encoders[c].encode(buffer, frame.data(), keyframe, out)) {
+                return false;
+            }
+            encodeNs += getTimestampNs() - start;
+            encodedBytes += static_cast<int64_t>(out.size());
+
+            FrameCodec::FrameInfo info;
+            FrameCodec::readFrameInfo(out.data(), out.size(), info);
+            if (info.keyframe) {
+                keyframes++;
+                keyframeBytes += static_cast<int64_t>(out.size());
+            }
+        }
+    }
+
+    // Decode timing excludes verification, which regenerates the original frames
+    int64_t decodeNs = 0;
+    int mismatches = 0;
+    for (int i = 0; i < frames; i++) {
+        for (int c = 0; c < 2; c++) {
+            const auto& in = encoded[i * 2 + c];
+            const int64_t start = getTimestampNs();
+            if (!decoders[c].decode(in.data(), in.size())) {
+                return false;
+            }
+            decodeNs += getTimestampNs() - start;
+
+            generateFrame(footage, c, i, frame);
+            if (memcmp(frame.data(), decoders[c].getFrameData(), frameSize) != 0) {
+                mismatches++;
+            }
+        }
+    }
+
+    const int count = frames * 2;
+    const double rawBytes = static_cast<double>(frameSize) * count;
+    const int deltaFrames = count - keyframes;
+    printf("Frames: %d (%d keyframes), %dx%d %s, %d slices, noise %d, motion %d px/frame\n", count, keyframes, footage.width, footage.height,
+        footage.format == varjo_TextureFormat_NV12 ? "NV12" : "YUV422", sliceCount, footage.noise, footage.motion);
+    printf("Compression: %.2f:1 overall, %.2f:1 keyframes, %.2f:1 other frames\n", rawBytes / std::max<int64_t>(encodedBytes, 1),
+        keyframes ? static_cast<double>(frameSize) * keyframes / keyframeBytes : 0.0,
+        deltaFrames ? static_cast<double>(frameSize) * deltaFrames / std::max<int64_t>(encodedBytes - keyframeBytes, 1) : 0.0);
+    printf("Encode: %.3f ms/frame, %.2f GB/s\n", encodeNs * 1e-6 / count, rawBytes / std::max<int64_t>(encodeNs, 1));
+    printf("Decode: %.3f ms/frame, %.2f GB/s\n", decodeNs * 1e-6 / count, rawBytes / std::max<int64_t>(decodeNs, 1));
+    printf("Verify: %s\n", mismatches ? "FAILED" : "lossless");
+    return mismatches == 0;
+}
+
+// Returns stream frame for synthetic packed frame
+DataStreamer::Frame getStreamFrame(const Footage& footage, int channel, int frameIndex, const std::vector<uint8_t>& frame)
+{
+    DataStreamer::Frame streamFrame;
+    streamFrame.type = varjo_StreamType_DistortedColor;
+    streamFrame.channelIndex = (channel == 0) ? varjo_ChannelIndex_Left : varjo_ChannelIndex_Right;
+    streamFrame.frameNumber = frameIndex;
+    streamFrame.metadata.distortedColor.timestamp = static_cast<int64_t>(frameIndex) * 11111111;
+    streamFrame.hmdPose.value[12] = frameIndex * 0.001;
+    streamFrame.buffer = getPackedMetadata(footage.format, footage.width, footage.height);
+    streamFrame.cpuData = frame.data();
+    return streamFrame;
+}
+
+// Record synthetic footage through frame recorder and verify seeking in written file
+bool runRecordingTest(ThreadPool& threadPool, const Footage& footage, int frames, int sliceCount, int keyframeInterval, const std::string& filename)
+{
+    FrameRecorder::Config config;
+    config.sliceCount = sliceCount;
+    config.keyframeInterval = keyframeInterval;
+    config.maxQueuedFrames = frames * 2;
+
+    FrameRecorder recorder(threadPool, config);
+    if (!recorder.start(filename)) {
+        return false;
+    }
+
+    std::vector<uint8_t> frame;
+    for (int i = 0; i < frames; i++) {
+        for (int c = 0; c < 2; c++) {
+            generateFrame(footage, c, i, frame);
+            recorder.submitFrame(getStreamFrame(footage, c, i, frame));
+        }
+    }
+    recorder.stop();
+
+    const auto stats = recorder.getStats();
+    printf("Recorded: %lld frames, %lld dropped, %.1f MB, %.3f ms/frame encode\n", static_cast<long long>(stats.frames),
+        static_cast<long long>(stats.droppedFrames), stats.encodedBytes / 1e6, stats.encodeTimeAvgMs);
+
+    FrameRecordingReader reader(threadPool);
+    if (!reader.open(filename)) {
+        return false;
+    }
+
+    // Seek backwards from end so that each read starts from a keyframe
+    const auto& records = reader.getRecords();
+    const int step = std::max(1, static_cast<int>(records.size()) / 7);
+    int mismatches = 0;
+    int reads = 0;
+    const int64_t start = getTimestampNs();
+    for (int i = static_cast<int>(records.size()) - 1; i >= 0; i -= step) {
+        if (!reader.readFrame(i)) {
+            return false;
+        }
+        const int channel = (records[i].channelIndex == varjo_ChannelIndex_Right) ? 1 : 0;
+        generateFrame(footage, channel, static_cast<int>(records[i].frameNumber), frame);
+        if (memcmp(frame.data(), reader.getFrameData(), frame.size()) != 0) {
+            mismatches++;
+        }
+        reads++;
+    }
+    printf("Seek: %d random reads, %.2f ms/read, %s\n", reads, (getTimestampNs() - start) * 1e-6 / std::max(reads, 1),
+        mismatches ? "FAILED" : "lossless");
+    return mismatches == 0;
+}
+
+// Feed synthetic footage at 90 Hz through replay buffer, dump last seconds and verify dumped file
+bool runReplayTest(ThreadPool& threadPool, const Footage& footage, int frames, int sliceCount, const ReplayBuffer::Config& config,
+    double seconds, const std::string& filename)
+{
+    ReplayBuffer::Config replayConfig = config;
+    replayConfig.sliceCount = sliceCount;
+    ReplayBuffer replay(threadPool, replayConfig);
+
+    // Stream thread is not allowed to wait for encoder, so frames are fed at stream rate
+    std::vector<uint8_t> frame;
+    int64_t submitNs = 0;
+    for (int i = 0; i < frames; i++) {
+        const int64_t frameStart = getTimestampNs();
+        for (int c = 0; c < 2; c++) {
+            generateFrame(footage, c, i, frame);
+            const int64_t start = getTimestampNs();
+            replay.submitFrame(getStreamFrame(footage, c, i, frame));
+            submitNs += getTimestampNs() - start;
+        }
+        while (getTimestampNs() - frameStart < 11111111) {
+            std::this_thread::yield();
+        }
+    }
+
+    // Give encoder time to drain before dumping
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+
+    auto stats = replay.getStats();
+    printf("Replay: %lld frames / %.1f MB of %.1f MB / %.2f s / %.2f frames per MB / %lld dropped / %lld evicted\n",
+        static_cast<long long>(stats.frames), stats.usedBytes / 1048576.0, stats.budgetBytes / 1048576.0, stats.retainedSeconds, stats.framesPerMB,
+        static_cast<long long>(stats.droppedFrames), static_cast<long long>(stats.evictedFrames));
+    printf("Replay: submit %.3f ms/frame on stream thread, encode %.3f ms/frame\n", submitNs * 1e-6 / (frames * 2), stats.encodeTimeAvgMs);
+
+    if (!replay.dump(filename, seconds)) {
+        return false;
+    }
+
+    // Stream keeps running while dump is written
+    int extra = 0;
+    while (replay.getStats().dumping) {
+        generateFrame(footage, extra % 2, frames + extra / 2, frame);
+        replay.submitFrame(getStreamFrame(footage, extra % 2, frames + extra / 2, frame));
+        extra++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    stats = replay.getStats();
+    printf("Replay: dumped %lld frames while %d frames were submitted\n", static_cast<long long>(stats.dumpedFrames), extra);
+
+    FrameRecordingReader reader(threadPool);
+    if (!reader.open(filename)) {
+        return false;
+    }
+
+    int mismatches = 0;
+    const auto& records = reader.getRecords();
+    for (int i = 0; i < static_cast<int>(records.size()); i++) {
+        if (!reader.readFrame(i)) {
+            return false;
+        }
+        const int channel = (records[i].channelIndex == varjo_ChannelIndex_Right) ? 1 : 0;
+        generateFrame(footage, channel, static_cast<int>(records[i].frameNumber), frame);
+        if (memcmp(frame.data(), reader.getFrameData(), frame.size()) != 0 ||
+            reader.getFrameMetadata().hmdPose.value[12] != records[i].frameNumber * 0.001) {
+            mismatches++;
+        }
+    }
+    const double span = records.empty() ? 0.0 : (records.back().timestamp - records.front().timestamp) * 1e-9;
+    printf("Replay: file has %d frames over %.2f s, %s\n", static_cast<int>(records.size()), span, mismatches ? "FAILED" : "lossless");
+    return mismatches == 0 && !records.empty();
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    cxxopts::Options options("CodecBench", "Benchmark lossless camera frame codec on synthetic stereo footage");
+
+    // clang-format off
+    options.add_options()
+        ("frames", "Frames per channel", cxxopts::value<int>()->default_value("90"))
+        ("size", "Frame width and height in pixels", cxxopts::value<int>()->default_value("1152"))
+        ("format", "Frame format: yuv422 or nv12", cxxopts::value<std::string>()->default_value("yuv422"))
+        ("noise", "Sensor noise amplitude", cxxopts::value<int>()->default_value("2"))
+        ("motion", "Camera pan in pixels per frame", cxxopts::value<int>()->default_value("1"))
+        ("slices", "Row slices per frame", cxxopts::value<int>()->default_value(std::to_string(FrameCodec::c_defaultSliceCount)))
+        ("keyframe-interval", "Frames between keyframes, zero for first frame only", cxxopts::value<int>()->default_value("90"))
+        ("threads", "Worker thread count, zero for hardware concurrency minus one", cxxopts::value<int>()->default_value("0"))
+        ("record", "Also write recording to given file and verify seeking", cxxopts::value<std::string>()->default_value(""))
+        ("replay", "Also test replay buffer of given size in megabytes", cxxopts::value<int>()->default_value("0"))
+        ("replay-file", "Replay dump file", cxxopts::value<std::string>()->default_value("replay.vfr"))
+        ("replay-seconds", "Seconds to dump from replay buffer", cxxopts::value<double>()->default_value("1.0"))
+        ("replay-raw", "Store uncompressed frames in replay buffer")
+        ("help", "Print help");
+    // clang-format on
+
+    cxxopts::ParseResult args = options.parse(argc, argv);
+    if (args.count("help")) {
+        printf("%s\n", options.help().c_str());
+        return EXIT_SUCCESS;
+    }
+
+    LOG_INIT(nullptr, LogLevel::Warning);
+
+    Footage footage;
+    const std::string format = args["format"].as<std::string>();
+    if (format == "nv12") {
+        footage.format = varjo_TextureFormat_NV12;
+    } else if (format != "yuv422") {
+        LOGE("Unknown format: %s", format.c_str());
+        return EXIT_FAILURE;
+    }
+    footage.width = footage.height = std::max(args["size"].as<int>(), 16);
+    footage.noise = std::max(args["noise"].as<int>(), 0);
+    footage.motion = args["motion"].as<int>();
+
+    const int frames = std::max(args["frames"].as<int>(), 1);
+    const int sliceCount = args["slices"].as<int>();
+    const int keyframeInterval = args["keyframe-interval"].as<int>();
+
+    ThreadPool threadPool(args["threads"].as<int>());
+    printf("Worker threads: %d\n", threadPool.getThreadCount());
+
+    if (!runCodecBenchmark(threadPool, footage, frames, sliceCount, keyframeInterval)) {
+        return EXIT_FAILURE;
+    }
+
+    const std::string recordFile = args["record"].as<std::string>();
+    if (!recordFile.empty() && !runRecordingTest(threadPool, footage, frames, sliceCount, keyframeInterval, recordFile)) {
+        return EXIT_FAILURE;
+    }
+
+    const int replayBudget = args["replay"].as<int>();
+    if (replayBudget > 0) {
+        ReplayBuffer::Config config;
+        config.memoryBudget = static_cast<size_t>(replayBudget) << 20;
+        config.compress = !args.count("replay-raw");
+        config.keyframeInterval = keyframeInterval;
+        if (!runReplayTest(threadPool, footage, frames, sliceCount, config, args["replay-seconds"].as<double>(), args["replay-file"].as<std::string>())) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
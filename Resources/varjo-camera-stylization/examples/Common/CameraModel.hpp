@@ -0,0 +1,89 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+
+#include <Varjo.h>
+
+#include "Globals.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Camera space of the model is OpenCV camera space: X right, Y down and Z forward. Varjo
+// camera space has Y up and Z backward, so extrinsics are converted before use with the model.
+
+//! Omnidir camera model of stream intrinsics. Intrinsics are normalized to image size.
+struct CameraModel {
+    double fx, fy, cx, cy;  //!< Normalized focal lengths and principal point
+    double k1, k2, p1, p2;  //!< Radial and tangential distortion
+    double skew, xi;        //!< Skew and mirror parameter
+    int width, height;      //!< Image size in pixels
+
+    //! Construct model of intrinsics for image of given size
+    CameraModel(const varjo_CameraIntrinsics& intrinsics, int w, int h)
+        : fx(intrinsics.focalLengthX)
+        , fy(intrinsics.focalLengthY)
+        , cx(intrinsics.principalPointX)
+        , cy(intrinsics.principalPointY)
+        , k1(intrinsics.distortionCoefficients[0])
+        , k2(intrinsics.distortionCoefficients[1])
+        , p1(intrinsics.distortionCoefficients[4])
+        , p2(intrinsics.distortionCoefficients[5])
+        , skew(intrinsics.distortionCoefficients[2])
+        , xi(intrinsics.distortionCoefficients[3])
+        , width(w)
+        , height(h)
+    {
+    }
+
+    //! Apply lens distortion to point on unit plane
+    glm::dvec2 distort(const glm::dvec2& p) const
+    {
+        const double r2 = p.x * p.x + p.y * p.y;
+        const double radial = 1.0 + k1 * r2 + k2 * r2 * r2;
+        return glm::dvec2(p.x * radial + 2.0 * p1 * p.x * p.y + p2 * (r2 + 2.0 * p.x * p.x),  //
+            p.y * radial + p1 * (r2 + 2.0 * p.y * p.y) + 2.0 * p2 * p.x * p.y);
+    }
+
+    //! Project camera space point to pixel. Returns false if point is behind projection center.
+    bool project(const glm::dvec3& point, glm::dvec2& outPixel) const
+    {
+        const glm::dvec3 s = glm::normalize(point);
+        const double z = s.z + xi;
+        if (z < 1e-9) {
+            return false;
+        }
+        const glm::dvec2 d = distort(glm::dvec2(s.x, s.y) / z);
+        outPixel.x = (fx * d.x + skew * d.y + cx) * width - 0.5;
+        outPixel.y = (fy * d.y + cy) * height - 0.5;
+        return true;
+    }
+
+    //! Unproject pixel to point on z = 1 plane. Returns false if ray does not point forward.
+    bool unproject(const glm::dvec2& pixel, glm::dvec2& outPoint) const
+    {
+        const double vn = (pixel.y + 0.5) / height;
+        const double un = (pixel.x + 0.5) / width;
+        const glm::dvec2 d((un - cx - skew * (vn - cy) / fy) / fx, (vn - cy) / fy);
+
+        // Invert distortion with fixed point iteration
+        glm::dvec2 p = d;
+        for (int i = 0; i < 10; i++) {
+            p += d - distort(p);
+        }
+
+        // Lift from unit sphere projection to ray
+        const double r2 = p.x * p.x + p.y * p.y;
+        const double lambda = (xi + std::sqrt(std::max(0.0, 1.0 + (1.0 - xi * xi) * r2))) / (1.0 + r2);
+        const glm::dvec3 ray(lambda * p.x, lambda * p.y, lambda - xi);
+        if (ray.z < 1e-9) {
+            return false;
+        }
+        outPoint = glm::dvec2(ray) / ray.z;
+        return true;
+    }
+};
+
+}  // namespace VarjoExamples
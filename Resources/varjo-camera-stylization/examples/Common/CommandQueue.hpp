@@ -0,0 +1,78 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <array>
+#include <atomic>
+
+#include "Globals.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Command queue passes commands from one producer thread to one consumer thread, e.g. from
+// UI thread to frame loop. Push and pop are a copy and one release store each, so neither side ever
+// locks or waits for the other. Head and tail indices are on separate cache lines, so that producer
+// and consumer do not invalidate each other's line on every operation.
+//
+// Queue has fixed capacity and push fails when it is full. Producer should keep the command and
+// retry later instead of blocking.
+
+//! Fixed capacity lock-free single producer single consumer command queue
+template <typename T, size_t Capacity>
+class CommandQueue
+{
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be power of two");
+
+public:
+    //! Queue capacity
+    static constexpr size_t c_capacity = Capacity;
+
+    //! Constructor
+    CommandQueue() = default;
+
+    // Disable copy, move and assign
+    CommandQueue(const CommandQueue& other) = delete;
+    CommandQueue(const CommandQueue&& other) = delete;
+    CommandQueue& operator=(const CommandQueue& other) = delete;
+    CommandQueue& operator=(const CommandQueue&& other) = delete;
+
+    //! Push command. Call from producer thread only. Returns false if queue is full.
+    bool push(const T& command)
+    {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_head.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        m_commands[tail & (Capacity - 1)] = command;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    //! Pop oldest command. Call from consumer thread only. Returns false if queue is empty.
+    bool pop(T& outCommand)
+    {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        outCommand = m_commands[head & (Capacity - 1)];
+        m_head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    //! Returns number of queued commands. Value may be stale when read from other threads.
+    size_t getSize() const { return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire); }
+
+private:
+    //! Cache line size for padding indices
+    static constexpr size_t c_cacheLine = 64;
+
+    std::array<T, Capacity> m_commands;                             //!< Command slots
+    std::atomic<size_t> m_head{0};                                  //!< Next slot to pop, written by consumer
+    char m_headPadding[c_cacheLine - sizeof(std::atomic<size_t>)];  //!< Padding to own cache line
+    std::atomic<size_t> m_tail{0};                                  //!< Next slot to push, written by producer
+    char m_tailPadding[c_cacheLine - sizeof(std::atomic<size_t>)];  //!< Padding to own cache line
+};
+
+}  // namespace VarjoExamples
@@ -0,0 +1,314 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstddef>
+#include <algorithm>
+#include <utility>
+
+#include "SimdMath.hpp"
+
+// Compile time convolution kernels for CPU image kernels. Kernels are types whose size, integer
+// taps and divisor are template parameters, so each instantiation evaluates to a fully unrolled
+// sequence of SIMD loads and multiply-adds for the SIMD variant it is used with. Zero taps generate
+// no code and unit taps generate plain adds and subtracts.
+//
+// A kernel type exposes:
+//
+//   c_width, c_height  Kernel extent in pixels
+//   c_divisor          Tap sum is divided by this
+//   tap(i)             Integer tap at row-major index i
+//
+// Images are planes of float or Simd::Half elements with strides in elements, and all arithmetic is
+// float. Channel layout is a template parameter: planar images keep each channel in its own plane,
+// interleaved images store channels of a pixel next to each other and vectorize across channels.
+//
+// NOTICE! Clamped convolution reads the nearest edge pixel for samples outside the image, which
+// matches the linear clamp sampler used by the post process shader. Valid convolution does no border
+// handling and expects sources padded by kernel extent, like the stylizer planes from unpackRegion.
+
+namespace VarjoExamples
+{
+namespace Conv
+{
+//! Sample map applying no change
+struct Identity {
+    template <typename V>
+    static typename V::Float apply(typename V::Float x)
+    {
+        return x;
+    }
+};
+
+//! Sample map squaring samples, for variance sums
+struct Square {
+    template <typename V>
+    static typename V::Float apply(typename V::Float x)
+    {
+        return V::mul(x, x);
+    }
+};
+
+//! Weighted tap accumulation
+template <int Weight>
+struct Tap {
+    template <typename V, typename Map, typename T>
+    static typename V::Float accumulate(const T* p, typename V::Float acc)
+    {
+        return V::madd(Map::template apply<V>(V::load(p)), V::set1(static_cast<float>(Weight)), acc);
+    }
+};
+
+//! Zero tap, generates no code
+template <>
+struct Tap<0> {
+    template <typename V, typename Map, typename T>
+    static typename V::Float accumulate(const T*, typename V::Float acc)
+    {
+        return acc;
+    }
+};
+
+//! Unit tap
+template <>
+struct Tap<1> {
+    template <typename V, typename Map, typename T>
+    static typename V::Float accumulate(const T* p, typename V::Float acc)
+    {
+        return V::add(acc, Map::template apply<V>(V::load(p)));
+    }
+};
+
+//! Negative unit tap
+template <>
+struct Tap<-1> {
+    template <typename V, typename Map, typename T>
+    static typename V::Float accumulate(const T* p, typename V::Float acc)
+    {
+        return V::sub(acc, Map::template apply<V>(V::load(p)));
+    }
+};
+
+//! Division of tap sum
+template <int Divisor>
+struct Scale {
+    template <typename V>
+    static typename V::Float apply(typename V::Float x)
+    {
+        return V::mul(x, V::set1(1.0f / Divisor));
+    }
+};
+
+//! Unit divisor, generates no code
+template <>
+struct Scale<1> {
+    template <typename V>
+    static typename V::Float apply(typename V::Float x)
+    {
+        return x;
+    }
+};
+
+//! Horizontal 1D kernel
+template <int Divisor, int... Taps>
+struct Kernel1D {
+    static constexpr int c_width = sizeof...(Taps);
+    static constexpr int c_height = 1;
+    static constexpr int c_divisor = Divisor;
+
+    static constexpr int tap(int i)
+    {
+        const int taps[] = {Taps...};
+        return taps[i];
+    }
+};
+
+//! 1D kernel turned vertical
+template <typename K>
+struct Column {
+    static constexpr int c_width = 1;
+    static constexpr int c_height = K::c_width;
+    static constexpr int c_divisor = K::c_divisor;
+
+    static constexpr int tap(int i) { return K::tap(i); }
+};
+
+//! 2D kernel with row-major taps
+template <int Width, int Height, int Divisor, int... Taps>
+struct Kernel2D {
+    static_assert(Width * Height == sizeof...(Taps), "Tap count must match kernel size");
+
+    static constexpr int c_width = Width;
+    static constexpr int c_height = Height;
+    static constexpr int c_divisor = Divisor;
+
+    static constexpr int tap(int i)
+    {
+        const int taps[] = {Taps...};
+        return taps[i];
+    }
+};
+
+//! Separable 2D kernel as outer product of horizontal 1D kernels for rows and columns. Can be
+//! evaluated directly or as a row pass followed by a column pass.
+template <typename RowKernel, typename ColumnKernel>
+struct Separable {
+    using Rows = RowKernel;
+    using Columns = Column<ColumnKernel>;
+
+    static constexpr int c_width = RowKernel::c_width;
+    static constexpr int c_height = ColumnKernel::c_width;
+    static constexpr int c_divisor = RowKernel::c_divisor * ColumnKernel::c_divisor;
+
+    static constexpr int tap(int i) { return ColumnKernel::tap(i / c_width) * RowKernel::tap(i % c_width); }
+};
+
+//! Unnormalized box sum
+template <int Width, int Height>
+struct BoxSum {
+    static constexpr int c_width = Width;
+    static constexpr int c_height = Height;
+    static constexpr int c_divisor = 1;
+
+    static constexpr int tap(int) { return 1; }
+};
+
+//! Planar channel layout
+template <int Channels>
+struct Planar {
+    static constexpr int c_planes = Channels;
+    static constexpr int c_pixelStep = 1;
+};
+
+//! Interleaved channel layout
+template <int Channels>
+struct Interleaved {
+    static constexpr int c_planes = 1;
+    static constexpr int c_pixelStep = Channels;
+};
+
+namespace Detail
+{
+// Unrolled tap sum. Indices and taps expand in lockstep, left to right.
+template <typename K, typename V, typename Map, typename T, size_t... I>
+inline typename V::Float sum(const T* p, ptrdiff_t rowStride, ptrdiff_t step, std::index_sequence<I...>)
+{
+    auto acc = V::zero();
+    using Expand = int[];
+    (void)Expand{0, (acc = Tap<K::tap(I)>::template accumulate<V, Map>(
+                         p + static_cast<ptrdiff_t>(I / K::c_width) * rowStride + static_cast<ptrdiff_t>(I % K::c_width) * step, acc),
+                        0)...};
+    return acc;
+}
+
+}  // namespace Detail
+
+//! Evaluate kernel for V::c_width consecutive outputs. Source points to the top left tap sample of
+//! the first output, step is the distance of horizontally adjacent taps in floats.
+template <typename K, typename V, typename Map = Identity, typename T>
+inline typename V::Float apply(const T* src, ptrdiff_t rowStride, ptrdiff_t step = 1)
+{
+    return Scale<K::c_divisor>::template apply<V>(Detail::sum<K, V, Map>(src, rowStride, step, std::make_index_sequence<K::c_width * K::c_height>()));
+}
+
+//! Evaluate kernel for one output with top left tap at pixel (x, y), clamping samples to image edges
+template <typename K, typename Map = Identity, typename T>
+inline float applyClamped(const T* src, size_t stride, int width, int height, int step, int x, int y)
+{
+    float acc = 0.0f;
+    for (int j = 0; j < K::c_height; j++) {
+        const T* row = src + stride * std::max(0, std::min(height - 1, y + j));
+        for (int i = 0; i < K::c_width; i++) {
+            const int weight = K::tap(j * K::c_width + i);
+            if (weight != 0) {
+                acc += weight * Map::template apply<Simd::Scalar>(Simd::Scalar::load(row + std::max(0, std::min(width - 1, x + i)) * step));
+            }
+        }
+    }
+    return Scale<K::c_divisor>::template apply<Simd::Scalar>(acc);
+}
+
+//! Convolve output region [x0, x1) x [y0, y1) of width x height image with kernel centered on each
+//! output pixel. Samples outside the image are clamped to edges. Planar channels are plane stride apart.
+template <typename K, typename V, typename Layout = Planar<1>, typename Map = Identity, typename Src, typename Dst>
+void convolveClamped(const Src* src, size_t srcStride, size_t srcPlaneStride, Dst* dst, size_t dstStride, size_t dstPlaneStride, int width,
+    int height, int x0, int y0, int x1, int y1)
+{
+    constexpr int originX = (K::c_width - 1) / 2;
+    constexpr int originY = (K::c_height - 1) / 2;
+    constexpr int step = Layout::c_pixelStep;
+
+    // Interior elements where all taps are inside the image
+    const int inBegin = std::min(std::max(x0, originX), x1) * step;
+    const int inEnd = std::max(inBegin, std::min(x1, width - (K::c_width - 1 - originX)) * step);
+    const int end = x1 * step;
+
+    for (int plane = 0; plane < Layout::c_planes; plane++) {
+        const Src* s = src + srcPlaneStride * plane;
+        Dst* d = dst + dstPlaneStride * plane;
+
+        for (int y = y0; y < y1; y++) {
+            Dst* out = d + dstStride * y;
+            const int top = y - originY;
+            int e = x0 * step;
+
+            if (top >= 0 && top + K::c_height <= height) {
+                for (; e < inBegin; e++) {
+                    Simd::Scalar::store(out + e, applyClamped<K, Map>(s + e % step, srcStride, width, height, step, e / step - originX, top));
+                }
+                const Src* base = s + srcStride * top - originX * step;
+                for (; e + V::c_width <= inEnd; e += V::c_width) {
+                    V::store(out + e, apply<K, V, Map>(base + e, srcStride, step));
+                }
+                for (; e < inEnd; e++) {
+                    Simd::Scalar::store(out + e, apply<K, Simd::Scalar, Map>(base + e, srcStride, step));
+                }
+            }
+            for (; e < end; e++) {
+                Simd::Scalar::store(out + e, applyClamped<K, Map>(s + e % step, srcStride, width, height, step, e / step - originX, top));
+            }
+        }
+    }
+}
+
+//! Convolve width x height outputs without border handling. Output (x, y) reads source pixels from
+//! (x, y) to (x + c_width - 1, y + c_height - 1). Planar channels are plane stride apart.
+template <typename K, typename V, typename Layout = Planar<1>, typename Map = Identity, typename Src, typename Dst>
+void convolveValid(const Src* src, size_t srcStride, size_t srcPlaneStride, Dst* dst, size_t dstStride, size_t dstPlaneStride, int width,
+    int height)
+{
+    constexpr int step = Layout::c_pixelStep;
+    const int end = width * step;
+
+    for (int plane = 0; plane < Layout::c_planes; plane++) {
+        for (int y = 0; y < height; y++) {
+            const Src* in = src + srcPlaneStride * plane + srcStride * y;
+            Dst* out = dst + dstPlaneStride * plane + dstStride * y;
+            int e = 0;
+            for (; e + V::c_width <= end; e += V::c_width) {
+                V::store(out + e, apply<K, V, Map>(in + e, srcStride, step));
+            }
+            for (; e < end; e++) {
+                Simd::Scalar::store(out + e, apply<K, Simd::Scalar, Map>(in + e, srcStride, step));
+            }
+        }
+    }
+}
+
+//! Convolve output region with separable kernel as a clamped row pass to temp image followed by a
+//! clamped column pass. Temp image has the layout and size of the source.
+template <typename K, typename V, typename Layout = Planar<1>, typename Map = Identity, typename Src, typename Temp, typename Dst>
+void convolveSeparable(const Src* src, size_t srcStride, size_t srcPlaneStride, Temp* temp, Dst* dst, size_t dstStride,
+    size_t dstPlaneStride, int width, int height, int x0, int y0, int x1, int y1)
+{
+    // Rows read by the column pass, clamped to image
+    constexpr int originY = (K::c_height - 1) / 2;
+    const int rowBegin = std::max(0, y0 - originY);
+    const int rowEnd = std::min(height, y1 - originY + K::c_height - 1);
+
+    convolveClamped<typename K::Rows, V, Layout, Map>(src, srcStride, srcPlaneStride, temp, srcStride, srcPlaneStride, width, height, x0, rowBegin, x1, rowEnd);
+    convolveClamped<typename K::Columns, V, Layout>(static_cast<const Temp*>(temp), srcStride, srcPlaneStride, dst, dstStride, dstPlaneStride, width, height, x0, y0, x1, y1);
+}
+
+}  // namespace Conv
+}  // namespace VarjoExamples
@@ -0,0 +1,360 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "CpuCompositor.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "SimdMath.hpp"
+
+using namespace VarjoExamples;
+
+namespace
+{
+// Linear to sRGB table size
+constexpr int c_srgbTableSize = 4096;
+
+// Smallest divisor of HSV conversion and key falloff, avoids division by zero
+constexpr float c_epsilon = 1e-6f;
+
+template <typename F>
+void dispatchSimd(SimdLevel level, F&& func)
+{
+    switch (level) {
+        case SimdLevel::AVX2: func(Simd::AVX2()); break;
+        case SimdLevel::SSE41: func(Simd::SSE41()); break;
+        default: func(Simd::Scalar()); break;
+    }
+}
+
+// Returns table from sRGB encoded byte to linear value
+const std::vector<float>& getLinearTable()
+{
+    static const std::vector<float> table = []() {
+        std::vector<float> result(256);
+        for (int i = 0; i < 256; i++) {
+            const double s = i / 255.0;
+            result[i] = static_cast<float>(s <= 0.04045 ? s / 12.92 : std::pow((s + 0.055) / 1.055, 2.4));
+        }
+        return result;
+    }();
+    return table;
+}
+
+// Returns table from linear value in [0, 1] scaled to table size to sRGB encoded byte
+const std::vector<uint8_t>& getSrgbTable()
+{
+    static const std::vector<uint8_t> table = []() {
+        std::vector<uint8_t> result(c_srgbTableSize);
+        for (int i = 0; i < c_srgbTableSize; i++) {
+            const double v = static_cast<double>(i) / (c_srgbTableSize - 1);
+            const double s = v <= 0.0031308 ? 12.92 * v : 1.055 * std::pow(v, 1.0 / 2.4) - 0.055;
+            result[i] = static_cast<uint8_t>(s * 255.0 + 0.5);
+        }
+        return result;
+    }();
+    return table;
+}
+
+// Clamp to [0, 1]
+template <typename V>
+inline typename V::Float saturate(typename V::Float v)
+{
+    return V::min(V::max(v, V::zero()), V::set1(1.0f));
+}
+
+// Planar rows of one row span, and zero padded copies of inputs read with SIMD for the last span of a row.
+// Lanes past span width hold finite values and are not written out.
+struct SpanRow {
+    float layerR[CpuCompositor::c_spanSize];            // Linear layer color
+    float layerG[CpuCompositor::c_spanSize];
+    float layerB[CpuCompositor::c_spanSize];
+    float layerA[CpuCompositor::c_spanSize];            // Layer alpha
+    float videoR[CpuCompositor::c_spanSize];            // Linear video color
+    float videoG[CpuCompositor::c_spanSize];
+    float videoB[CpuCompositor::c_spanSize];
+    uint8_t videoColor[CpuCompositor::c_spanSize * 4];  // Padded video color
+    float layerDepth[CpuCompositor::c_spanSize];        // Padded layer depth
+    float videoDepth[CpuCompositor::c_spanSize];        // Padded video depth
+};
+
+}  // namespace
+
+CpuCompositor::CpuCompositor(ThreadPool& threadPool, const Config& config)
+    : m_threadPool(threadPool)
+    , m_config(config)
+{
+    // Build tables before bands read them from workers
+    getLinearTable();
+    getSrgbTable();
+}
+
+CpuCompositor::LayerParams CpuCompositor::getLayerParams(const LayerView::SubmitParams& params)
+{
+    // Flags as set by LayerView::endFrame(). Depth extension range and clip planes are LayerView defaults.
+    LayerParams result;
+    result.flags = 0;
+    if (params.alphaBlend) {
+        result.flags |= varjo_LayerFlag_BlendMode_AlphaBlend;
+    }
+    if (params.depthTestEnabled && params.submitDepth) {
+        result.flags |= varjo_LayerFlag_DepthTesting;
+    }
+    if (params.chromaKeyEnabled) {
+        result.flags |= varjo_LayerFlag_ChromaKeyMasking;
+    }
+    result.depthTestRangeEnabled = params.submitDepth && params.depthTestRangeEnabled;
+    result.depthTestNearZ = params.depthTestRangeLimits[0];
+    result.depthTestFarZ = params.depthTestRangeLimits[1];
+    return result;
+}
+
+bool CpuCompositor::setChromaKeys(const std::vector<varjo_ChromaKeyConfig>& configs)
+{
+    std::vector<ChromaKey> keys;
+    for (const auto& config : configs) {
+        if (config.type == varjo_ChromaKeyType_Disabled) {
+            continue;
+        }
+        if (config.type != varjo_ChromaKeyType_HSV) {
+            LOGE("Unsupported chroma key type: %d", static_cast<int>(config.type));
+            return false;
+        }
+        ChromaKey key;
+        for (int i = 0; i < 3; i++) {
+            key.target[i] = static_cast<float>(config.params.hsv.targetColor[i]);
+            key.tolerance[i] = static_cast<float>(config.params.hsv.tolerance[i]);
+            key.invFalloff[i] = 1.0f / std::max(static_cast<float>(config.params.hsv.falloff[i]), c_epsilon);
+        }
+        keys.push_back(key);
+    }
+    m_chromaKeys = std::move(keys);
+    return true;
+}
+
+void CpuCompositor::setMetrics(MetricsRegistry* metrics)
+{
+    m_metrics = metrics;
+    if (metrics) {
+        m_timeMetric = metrics->addMetric("CPU compositor: composite", MetricsRegistry::Kind::Timer);
+        m_pixelsMetric = metrics->addMetric("CPU compositor: pixels", MetricsRegistry::Kind::Counter);
+    } else {
+        m_timeMetric = m_pixelsMetric = MetricsRegistry::c_invalidId;
+    }
+}
+
+template <typename V>
+void CpuCompositor::compositeRows(
+    int y0, int y1, const LayerParams& params, const LayerImage& layer, const VideoFrame& video, uint8_t* dst, size_t dstStride, int width) const
+{
+    using Float = typename V::Float;
+
+    const float* linearTable = getLinearTable().data();
+    const uint8_t* srgbTable = getSrgbTable().data();
+
+    const bool alphaBlend = (params.flags & varjo_LayerFlag_BlendMode_AlphaBlend) != 0;
+    const bool invertAlpha = alphaBlend && (params.flags & varjo_LayerFlag_InvertAlpha) != 0;
+    const bool depthTest = (params.flags & varjo_LayerFlag_DepthTesting) != 0;
+    const bool chromaKey = (params.flags & varjo_LayerFlag_ChromaKeyMasking) != 0;
+
+    // Layer depth to meters: normalized depth d maps to n * f / (f - d * (f - n)) in zero to one clip range
+    const Float depthScale = V::set1(static_cast<float>(1.0 / (params.maxDepth - params.minDepth)));
+    const Float depthOffset = V::set1(static_cast<float>(-params.minDepth / (params.maxDepth - params.minDepth)));
+    const Float nf = V::set1(static_cast<float>(params.nearZ * params.farZ));
+    const Float f = V::set1(static_cast<float>(params.farZ));
+    const Float fn = V::set1(static_cast<float>(params.farZ - params.nearZ));
+    const Float rangeNear = V::set1(static_cast<float>(params.depthTestNearZ));
+    const Float rangeFar = V::set1(static_cast<float>(std::min(params.depthTestFarZ, static_cast<double>(FLT_MAX))));
+    const Float constantDepth = V::set1(video.constantDepth);
+    const Float maxDistance = V::set1(FLT_MAX);
+
+    const Float zero = V::zero();
+    const Float one = V::set1(1.0f);
+    const Float epsilon = V::set1(c_epsilon);
+    const Float tableScale = V::set1(static_cast<float>(c_srgbTableSize - 1));
+
+    // Spans of fully transparent layer pixels show video, and spans of opaque pixels show layer when nothing
+    // hides it. sRGB decode and encode tables round trip every byte, so copying equals blending.
+    const uint32_t transparentMask = params.premultiplied ? 0xffffffffu : 0xff000000u;
+    const bool videoCopy = alphaBlend && !invertAlpha;
+    const bool layerCopy = !depthTest && !chromaKey;
+
+    SpanRow row{};
+    for (int y = y0; y < y1; y++) {
+        for (int x0 = 0; x0 < width; x0 += c_spanSize) {
+            const int spanWidth = std::min(c_spanSize, width - x0);
+            const int laneWidth = (spanWidth + V::c_width - 1) / V::c_width * V::c_width;
+
+            const uint32_t* layerColor = layer.color + static_cast<size_t>(y) * layer.colorStride + x0;
+            const uint8_t* videoColor = video.color + static_cast<size_t>(y) * video.colorStride + static_cast<size_t>(x0) * 4;
+            uint8_t* out = dst + static_cast<size_t>(y) * dstStride + static_cast<size_t>(x0) * 4;
+
+            uint32_t anyVisible = 0;
+            uint32_t allOpaque = 0xff000000u;
+            for (int i = 0; i < spanWidth; i++) {
+                anyVisible |= layerColor[i] & transparentMask;
+                allOpaque &= layerColor[i];
+            }
+            if (videoCopy && anyVisible == 0) {
+                for (int i = 0; i < spanWidth; i++) {
+                    out[i * 4 + 0] = videoColor[i * 4 + 0];
+                    out[i * 4 + 1] = videoColor[i * 4 + 1];
+                    out[i * 4 + 2] = videoColor[i * 4 + 2];
+                    out[i * 4 + 3] = 255;
+                }
+                continue;
+            }
+            if (layerCopy && (!alphaBlend || (!invertAlpha && allOpaque == 0xff000000u))) {
+                for (int i = 0; i < spanWidth; i++) {
+                    const uint32_t pixel = layerColor[i] | 0xff000000u;
+                    std::memcpy(out + i * 4, &pixel, sizeof(pixel));
+                }
+                continue;
+            }
+
+            // Decode inputs to planar rows
+            for (int i = 0; i < spanWidth; i++) {
+                const uint32_t l = layerColor[i];
+                row.layerR[i] = linearTable[l & 0xff];
+                row.layerG[i] = linearTable[(l >> 8) & 0xff];
+                row.layerB[i] = linearTable[(l >> 16) & 0xff];
+                row.layerA[i] = static_cast<float>(l >> 24) * (1.0f / 255.0f);
+                row.videoR[i] = linearTable[videoColor[i * 4 + 0]];
+                row.videoG[i] = linearTable[videoColor[i * 4 + 1]];
+                row.videoB[i] = linearTable[videoColor[i * 4 + 2]];
+            }
+
+            // Depth and chroma key inputs are read with SIMD directly, except from padded copies when lanes
+            // would read past the span
+            const uint8_t* videoLanes = videoColor;
+            const float* layerDepth = depthTest ? layer.depth + static_cast<size_t>(y) * layer.depthStride + x0 : nullptr;
+            const float* videoDepth = depthTest && video.depth ? video.depth + static_cast<size_t>(y) * video.depthStride + x0 : nullptr;
+            if (spanWidth < laneWidth) {
+                std::copy(videoColor, videoColor + spanWidth * 4, row.videoColor);
+                videoLanes = row.videoColor;
+                if (layerDepth) {
+                    std::copy(layerDepth, layerDepth + spanWidth, row.layerDepth);
+                    layerDepth = row.layerDepth;
+                }
+                if (videoDepth) {
+                    std::copy(videoDepth, videoDepth + spanWidth, row.videoDepth);
+                    videoDepth = row.videoDepth;
+                }
+            }
+
+            // Blend
+            for (int i = 0; i < laneWidth; i += V::c_width) {
+                Float alpha = V::load(row.layerA + i);
+                if (invertAlpha) {
+                    alpha = V::sub(one, alpha);
+                } else if (!alphaBlend) {
+                    alpha = one;
+                }
+
+                // Layer visibility from depth test and chroma key mask
+                Float visibility = one;
+                if (depthTest) {
+                    // Invalid video depth estimates fall back to constant depth
+                    const Float d = saturate<V>(V::add(V::mul(V::load(layerDepth + i), depthScale), depthOffset));
+                    const Float layerZ = V::div(nf, V::sub(f, V::mul(d, fn)));
+                    Float videoZ = constantDepth;
+                    if (videoDepth) {
+                        const Float z = V::load(videoDepth + i);
+                        videoZ = V::select(V::maskAnd(V::cmpgt(z, zero), V::cmpge(maxDistance, z)), z, constantDepth);
+                    }
+                    Float occluded = V::select(V::cmpgt(layerZ, videoZ), one, zero);
+                    if (params.depthTestRangeEnabled) {
+                        const Float inRange = V::select(V::maskAnd(V::cmpge(layerZ, rangeNear), V::cmpge(rangeFar, layerZ)), one, zero);
+                        occluded = V::mul(occluded, inRange);
+                    }
+                    visibility = V::sub(one, occluded);
+                }
+                if (chromaKey) {
+                    Float r, g, b;
+                    V::loadRGBA(videoLanes + static_cast<size_t>(i) * 4, r, g, b);
+                    const Float value = V::max(r, V::max(g, b));
+                    const Float chroma = V::sub(value, V::min(r, V::min(g, b)));
+                    const Float saturation = V::div(chroma, V::max(value, epsilon));
+                    const Float invChroma = V::div(one, V::max(chroma, epsilon));
+                    Float hue = V::add(V::mul(V::sub(r, g), invChroma), V::set1(4.0f));
+                    hue = V::select(V::cmpge(g, value), V::add(V::mul(V::sub(b, r), invChroma), V::set1(2.0f)), hue);
+                    hue = V::select(V::cmpge(r, value), V::mul(V::sub(g, b), invChroma), hue);
+                    hue = V::select(V::cmplt(hue, zero), V::add(hue, V::set1(6.0f)), hue);
+                    hue = V::mul(hue, V::set1(1.0f / 6.0f));
+                    const Float hsv[3] = {hue, saturation, value};
+
+                    Float mask = zero;
+                    for (const auto& key : m_chromaKeys) {
+                        Float match = one;
+                        for (int c = 0; c < 3; c++) {
+                            Float distance = V::abs(V::sub(hsv[c], V::set1(key.target[c])));
+                            if (c == 0) {
+                                distance = V::min(distance, V::sub(one, distance));
+                            }
+                            const Float excess = V::sub(distance, V::set1(key.tolerance[c]));
+                            match = V::mul(match, saturate<V>(V::sub(one, V::mul(excess, V::set1(key.invFalloff[c])))));
+                        }
+                        mask = V::max(mask, match);
+                    }
+                    visibility = V::mul(visibility, mask);
+                }
+
+                // Premultiplied: L + (1 - a) * V, straight: a * L + (1 - a) * V, both weighted by visibility.
+                // Results are stored as sRGB table indices.
+                const Float weight = V::mul(visibility, alpha);
+                const Float layerWeight = params.premultiplied ? visibility : weight;
+                const Float videoWeight = V::sub(one, weight);
+                const Float r = V::add(V::mul(V::load(row.layerR + i), layerWeight), V::mul(V::load(row.videoR + i), videoWeight));
+                const Float g = V::add(V::mul(V::load(row.layerG + i), layerWeight), V::mul(V::load(row.videoG + i), videoWeight));
+                const Float b = V::add(V::mul(V::load(row.layerB + i), layerWeight), V::mul(V::load(row.videoB + i), videoWeight));
+                V::store(row.layerR + i, V::round(V::mul(saturate<V>(r), tableScale)));
+                V::store(row.layerG + i, V::round(V::mul(saturate<V>(g), tableScale)));
+                V::store(row.layerB + i, V::round(V::mul(saturate<V>(b), tableScale)));
+            }
+
+            // Encode output
+            for (int i = 0; i < spanWidth; i++) {
+                out[i * 4 + 0] = srgbTable[static_cast<int>(row.layerR[i])];
+                out[i * 4 + 1] = srgbTable[static_cast<int>(row.layerG[i])];
+                out[i * 4 + 2] = srgbTable[static_cast<int>(row.layerB[i])];
+                out[i * 4 + 3] = 255;
+            }
+        }
+    }
+}
+
+bool CpuCompositor::composite(
+    const LayerParams& params, const LayerImage& layer, const VideoFrame& video, uint8_t* dst, size_t dstStride, int width, int height)
+{
+    if (width <= 0 || height <= 0 || !layer.color || !video.color || !dst) {
+        LOGE("Invalid compositor inputs: %dx%d", width, height);
+        return false;
+    }
+    if ((params.flags & varjo_LayerFlag_DepthTesting) && !layer.depth) {
+        LOGE("Depth testing layer has no depth");
+        return false;
+    }
+    if (params.maxDepth == params.minDepth || params.nearZ <= 0.0 || params.farZ <= 0.0 || params.nearZ == params.farZ) {
+        LOGE("Invalid layer depth range: depth %f..%f, z %f..%f", params.minDepth, params.maxDepth, params.nearZ, params.farZ);
+        return false;
+    }
+
+    const int64_t startNs = getTimestampNs();
+
+    dispatchSimd(m_config.simd, [&](auto tag) {
+        using V = decltype(tag);
+        m_threadPool.parallelFor(height, [&](int y0, int y1) { compositeRows<V>(y0, y1, params, layer, video, dst, dstStride, width); }, c_bandRows);
+    });
+
+    const int64_t timeNs = getTimestampNs() - startNs;
+    const int64_t pixels = static_cast<int64_t>(width) * height;
+    m_stats.frames++;
+    m_stats.pixels += pixels;
+    m_stats.timeNs += timeNs;
+    if (m_metrics) {
+        m_metrics->recordTime(m_timeMetric, timeNs);
+        m_metrics->increment(m_pixelsMetric, pixels);
+    }
+    return true;
+}
@@ -0,0 +1,142 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <cfloat>
+#include <vector>
+
+#include <Varjo_types_layers.h>
+#include <Varjo_types_mr.h>
+
+#include "Globals.hpp"
+#include "LayerView.hpp"
+#include "KernelConfig.hpp"
+#include "ThreadPool.hpp"
+#include "MetricsRegistry.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! CPU compositor blends a VR layer over the video see through frame like the Varjo compositor
+// does on the headset, for offline recordings and previews of what the user sees. Layer semantics:
+//
+//   - Alpha: without varjo_LayerFlag_BlendMode_AlphaBlend the layer is opaque. With it, layer alpha is
+//     inverted first if varjo_LayerFlag_InvertAlpha is given, and layer color is either premultiplied
+//     (Varjo default) or straight alpha.
+//   - Depth: with varjo_LayerFlag_DepthTesting, layer depth is converted to meters using the depth
+//     extension range and clip planes, and the layer is hidden where video is closer. Video depth is
+//     an estimated depth plane in meters, e.g. from stereo matching, or a constant distance. Depth
+//     test range limits restrict testing to layer depths inside the range, outside it the layer is
+//     alpha blended normally.
+//   - Chroma key: with varjo_LayerFlag_ChromaKeyMasking, the layer is shown only where video matches
+//     one of the HSV chroma keys. Match is one inside tolerance and falls off linearly to zero over
+//     falloff, separately for hue, saturation and value. Hue distance wraps around.
+//
+// Frames are processed in bands of rows in parallel on the thread pool. Bands span the full width, so
+// inputs are read as sequential streams the prefetcher follows; square tiles would start a new page
+// on each row. Row spans are decoded from sRGB to linear with tables into planar rows, blended with
+// SIMD and encoded back. Spans that are fully transparent, or opaque with nothing hiding the layer, are
+// copied without blending. Chroma keys are matched against sRGB encoded video colors, like key colors
+// picked from the camera image.
+
+//! Multithreaded CPU compositor of VR layer over video see through
+class CpuCompositor
+{
+public:
+    static constexpr int c_bandRows = 8;   //!< Rows per band, unit of parallel work
+    static constexpr int c_spanSize = 64;  //!< Row span in pixels, unit of planar decode and blend
+
+    //! Compositor configuration
+    struct Config {
+        SimdLevel simd = getMaxSimdLevel();  //!< SIMD variant of blending
+    };
+
+    //! Layer blending parameters, matching layer header flags and view depth extensions
+    struct LayerParams {
+        varjo_LayerFlags flags = varjo_LayerFlag_BlendMode_AlphaBlend;  //!< Layer flags
+        bool premultiplied = true;                                      //!< Layer color is premultiplied with alpha
+        double minDepth = 0.0;                                          //!< Depth buffer value at near plane
+        double maxDepth = 1.0;                                          //!< Depth buffer value at far plane
+        double nearZ = 0.1;                                             //!< Near plane distance in meters
+        double farZ = 1e3;                                              //!< Far plane distance in meters
+        bool depthTestRangeEnabled = false;                             //!< Limit depth testing to range
+        double depthTestNearZ = 0.0;                                    //!< Depth test range minimum in meters
+        double depthTestFarZ = FLT_MAX;                                 //!< Depth test range maximum in meters
+    };
+
+    //! VR layer view image
+    struct LayerImage {
+        const uint32_t* color = nullptr;  //!< RGBA8 pixels, sRGB encoded color and linear alpha
+        size_t colorStride = 0;           //!< Color row stride in pixels
+        const float* depth = nullptr;     //!< Depth buffer values, null if layer has no depth
+        size_t depthStride = 0;           //!< Depth row stride in pixels
+    };
+
+    //! Video see through frame
+    struct VideoFrame {
+        const uint8_t* color = nullptr;  //!< RGBA8 pixels, sRGB encoded
+        size_t colorStride = 0;          //!< Color row stride in bytes
+        const float* depth = nullptr;    //!< Estimated depth in meters, null for constant depth
+        size_t depthStride = 0;          //!< Depth row stride in pixels
+        float constantDepth = 1.0f;      //!< Depth in meters without depth plane and for invalid estimates
+    };
+
+    //! Compositor statistics
+    struct Stats {
+        int64_t frames = 0;  //!< Composited frames
+        int64_t pixels = 0;  //!< Composited pixels
+        int64_t timeNs = 0;  //!< Total composition time
+    };
+
+    //! Construct compositor running bands on given thread pool
+    CpuCompositor(ThreadPool& threadPool, const Config& config);
+
+    // Disable copy, move and assign
+    CpuCompositor(const CpuCompositor& other) = delete;
+    CpuCompositor(const CpuCompositor&& other) = delete;
+    CpuCompositor& operator=(const CpuCompositor& other) = delete;
+    CpuCompositor& operator=(const CpuCompositor&& other) = delete;
+
+    //! Returns layer parameters for layer submitted by LayerView with given parameters
+    static LayerParams getLayerParams(const LayerView::SubmitParams& params);
+
+    //! Set chroma key configurations used for masking. Returns false for unsupported key types.
+    bool setChromaKeys(const std::vector<varjo_ChromaKeyConfig>& configs);
+
+    //! Composite layer over video frame into RGBA8 output of given size. Output alpha is opaque.
+    //! Returns false if inputs are missing or invalid.
+    bool composite(const LayerParams& params, const LayerImage& layer, const VideoFrame& video, uint8_t* dst, size_t dstStride, int width, int height);
+
+    //! Returns compositor statistics
+    const Stats& getStats() const { return m_stats; }
+
+    //! Reset compositor statistics
+    void resetStats() { m_stats = {}; }
+
+    //! Publish composition time and pixel count to metrics registry. Pass null to stop publishing.
+    void setMetrics(MetricsRegistry* metrics);
+
+private:
+    //! HSV chroma key prepared for matching
+    struct ChromaKey {
+        float target[3];      //!< Target hue, saturation and value
+        float tolerance[3];   //!< Distance matched fully
+        float invFalloff[3];  //!< Inverse of distance over which match falls to zero
+    };
+
+    //! Composite rows in [y0, y1)
+    template <typename V>
+    void compositeRows(int y0, int y1, const LayerParams& params, const LayerImage& layer, const VideoFrame& video, uint8_t* dst, size_t dstStride,
+        int width) const;
+
+    ThreadPool& m_threadPool;             //!< Thread pool running bands
+    const Config m_config;                //!< Compositor configuration
+    std::vector<ChromaKey> m_chromaKeys;  //!< Enabled chroma keys
+    Stats m_stats{};                      //!< Compositor statistics
+
+    MetricsRegistry* m_metrics = nullptr;                               //!< Metrics registry, null if not published
+    MetricsRegistry::Id m_timeMetric = MetricsRegistry::c_invalidId;    //!< Composition timer
+    MetricsRegistry::Id m_pixelsMetric = MetricsRegistry::c_invalidId;  //!< Composited pixel counter
+};
+
+}  // namespace VarjoExamples
@@ -0,0 +1,104 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "CpuInfo.hpp"
+
+#include <cstring>
+#include <thread>
+#include <utility>
+#include <intrin.h>
+
+namespace
+{
+// Read CPUID leaf
+void cpuid(int leaf, int subleaf, int regs[4]) { __cpuidex(regs, leaf, subleaf); }
+
+// Detect CPU info
+VarjoExamples::CpuInfo detect()
+{
+    VarjoExamples::CpuInfo info;
+    info.logicalCores = static_cast<int>(std::thread::hardware_concurrency());
+
+    int regs[4] = {};
+    cpuid(0, 0, regs);
+    const int maxLeaf = regs[0];
+
+    if (maxLeaf >= 1) {
+        cpuid(1, 0, regs);
+        info.sse41 = (regs[2] & (1 << 19)) != 0;
+        info.fma = (regs[2] & (1 << 12)) != 0;
+        info.f16c = (regs[2] & (1 << 29)) != 0;
+
+        // AVX state must also be enabled by the OS
+        const bool osxsave = (regs[2] & (1 << 27)) != 0;
+        const bool avxCpu = (regs[2] & (1 << 28)) != 0;
+        const uint64_t xcr0 = osxsave ? _xgetbv(0) : 0;
+        info.avx = avxCpu && ((xcr0 & 0x6) == 0x6);
+        info.fma = info.fma && info.avx;
+        info.f16c = info.f16c && info.avx;
+
+        if (maxLeaf >= 7) {
+            cpuid(7, 0, regs);
+            info.avx2 = info.avx && (regs[1] & (1 << 5)) != 0;
+            info.avx512f = info.avx && ((xcr0 & 0xe0) == 0xe0) && (regs[1] & (1 << 16)) != 0;
+        }
+    }
+
+    // Brand string from extended leaves
+    cpuid(0x80000000, 0, regs);
+    if (static_cast<unsigned>(regs[0]) >= 0x80000004) {
+        char brand[49] = {};
+        for (int i = 0; i < 3; i++) {
+            cpuid(0x80000002 + i, 0, regs);
+            memcpy(brand + i * 16, regs, sizeof(regs));
+        }
+        info.brand = brand;
+
+        // Trim padding spaces
+        const auto first = info.brand.find_first_not_of(' ');
+        const auto last = info.brand.find_last_not_of(' ');
+        info.brand = (first == std::string::npos) ? std::string() : info.brand.substr(first, last - first + 1);
+    }
+
+    if (info.brand.empty()) {
+        info.brand = "Unknown CPU";
+    }
+
+    return info;
+}
+
+}  // namespace
+
+namespace VarjoExamples
+{
+std::vector<std::string> CpuInfo::getFeatureNames() const
+{
+    const std::pair<bool, const char*> features[] = {
+        {sse41, "sse4.1"}, {avx, "avx"}, {avx2, "avx2"}, {fma, "fma"}, {f16c, "f16c"}, {avx512f, "avx512f"}};
+
+    std::vector<std::string> names;
+    for (const auto& feature : features) {
+        if (feature.first) {
+            names.push_back(feature.second);
+        }
+    }
+    return names;
+}
+
+std::string CpuInfo::getKey() const
+{
+    std::string key = brand + " [";
+    const auto features = getFeatureNames();
+    for (size_t i = 0; i < features.size(); i++) {
+        key += (i > 0 ? " " : "") + features[i];
+    }
+    key += "]";
+    return key;
+}
+
+const CpuInfo& CpuInfo::get()
+{
+    static const CpuInfo s_info = detect();
+    return s_info;
+}
+
+}  // namespace VarjoExamples
@@ -0,0 +1,33 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Globals.hpp"
+
+namespace VarjoExamples
+{
+//! CPU model and instruction set features detected with CPUID
+struct CpuInfo {
+    std::string brand;     //!< CPU brand string
+    int logicalCores = 0;  //!< Number of logical cores
+    bool sse41 = false;    //!< SSE 4.1 supported
+    bool avx = false;      //!< AVX supported (including OS support)
+    bool avx2 = false;     //!< AVX2 supported
+    bool fma = false;      //!< FMA3 supported
+    bool f16c = false;     //!< F16C half float conversion supported
+    bool avx512f = false;  //!< AVX-512 foundation supported
+
+    //! Returns list of supported feature names
+    std::vector<std::string> getFeatureNames() const;
+
+    //! Returns key identifying this CPU model and feature set
+    std::string getKey() const;
+
+    //! Returns CPU info of this machine. Detected once.
+    static const CpuInfo& get();
+};
+
+}  // namespace VarjoExamples
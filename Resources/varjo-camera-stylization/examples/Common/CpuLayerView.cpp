@@ -0,0 +1,38 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "CpuLayerView.hpp"
+#include "StandInRuntime.hpp"
+
+namespace VarjoExamples
+{
+CpuLayerView::CpuLayerView(varjo_Session* session, CpuRenderer& renderer)
+    : LayerView(session, renderer)
+{
+    // Create color swap chain without textures
+    varjo_SwapChainConfig2 colorConfig;
+    colorConfig.numberOfTextures = 4;
+    colorConfig.textureArraySize = 1;
+    colorConfig.textureFormat = varjo_TextureFormat_R8G8B8A8_SRGB;
+    colorConfig.textureWidth = getTotalWidth(m_fullViewports);
+    colorConfig.textureHeight = getTotalHeight(m_fullViewports);
+
+    m_colorSwapChain = StandInRuntime::createSwapChain(getSession(), colorConfig);
+    CHECK_VARJO_ERR(getSession());
+
+    // Create depth swap chain without textures
+    varjo_SwapChainConfig2 depthConfig{colorConfig};
+    depthConfig.textureFormat = varjo_DepthTextureFormat_D32_FLOAT;
+
+    m_depthSwapChain = StandInRuntime::createSwapChain(getSession(), depthConfig);
+    CHECK_VARJO_ERR(getSession());
+
+    // Create sRGB CPU render target for each swap chain image, matching color swap chain format
+    for (int i = 0; i < colorConfig.numberOfTextures; ++i) {
+        m_renderTargets.emplace_back(std::make_unique<CpuRenderer::RenderTarget>(colorConfig.textureWidth, colorConfig.textureHeight, true));
+    }
+
+    // Setup views
+    setupViews();
+}
+
+}  // namespace VarjoExamples
@@ -0,0 +1,26 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include "Globals.hpp"
+#include "LayerView.hpp"
+#include "CpuRenderer.hpp"
+
+namespace VarjoExamples
+{
+//! Layer view implementation for CPU renderer. Requires stand-in runtime for swap chains. Rendered
+//! atlas is read from render targets, in the same view layout as swap chain textures.
+class CpuLayerView final : public LayerView
+{
+public:
+    //! Constructor
+    CpuLayerView(varjo_Session* session, CpuRenderer& renderer);
+
+    //! Returns number of render targets, one for each swap chain image
+    int getRenderTargetCount() const { return static_cast<int>(m_renderTargets.size()); }
+
+    //! Returns render target of given swap chain image
+    const CpuRenderer::RenderTarget& getRenderTarget(int index) const { return static_cast<const CpuRenderer::RenderTarget&>(*m_renderTargets.at(index)); }
+};
+
+}  // namespace VarjoExamples
@@ -0,0 +1,844 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "CpuRenderer.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+#include "SimdMath.hpp"
+#include "CpuShaders.hpp"
+
+using namespace VarjoExamples;
+
+namespace
+{
+// Floats per clip space vertex: position followed by varyings
+constexpr int c_clipStride = 4 + CpuRenderer::c_maxVaryings;
+
+// Largest clipped polygon: triangle clipped by six planes
+constexpr int c_maxPolygon = 3 + 6;
+
+// Guard band in viewport sizes. Triangles are clipped to it, so that pixel space coordinates stay
+// small enough for float edge functions.
+constexpr float c_guardBand = 4.0f;
+
+// Margin in pixels of conservative tile and block rejection
+constexpr float c_rejectMargin = 1e-3f;
+
+// Depth margin of hierarchical rejection, covers rounding of interpolated depth
+constexpr float c_depthMargin = 1e-5f;
+
+// Pixel center offsets of one block row
+alignas(32) const float c_laneOffsets[CpuRenderer::c_blockSize] = {0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f};
+
+// Linear to sRGB table size
+constexpr int c_srgbTableSize = 4096;
+
+// Call function with SIMD variant tag
+template <typename F>
+void dispatchSimd(SimdLevel level, F&& func)
+{
+    switch (level) {
+        case SimdLevel::AVX2: func(Simd::AVX2()); break;
+        case SimdLevel::SSE41: func(Simd::SSE41()); break;
+        default: func(Simd::Scalar()); break;
+    }
+}
+
+// Clamp to [0, 1], NaN to zero
+inline float saturate(float v) { return v > 0.0f ? (v < 1.0f ? v : 1.0f) : 0.0f; }
+
+// Returns table from linear value in [0, 1] scaled to table size to sRGB encoded byte
+const std::vector<uint8_t>& getSrgbTable()
+{
+    static const std::vector<uint8_t> table = []() {
+        std::vector<uint8_t> result(c_srgbTableSize);
+        for (int i = 0; i < c_srgbTableSize; i++) {
+            const double v = static_cast<double>(i) / (c_srgbTableSize - 1);
+            const double s = v <= 0.0031308 ? 12.92 * v : 1.055 * std::pow(v, 1.0 / 2.4) - 0.055;
+            result[i] = static_cast<uint8_t>(s * 255.0 + 0.5);
+        }
+        return result;
+    }();
+    return table;
+}
+
+// Pack color to RGBA8, color channels sRGB encoded if requested. Alpha is always linear.
+inline uint32_t packColor(const glm::vec4& color, const uint8_t* srgbTable)
+{
+    uint32_t rgb[3];
+    for (int i = 0; i < 3; i++) {
+        rgb[i] = srgbTable ? srgbTable[static_cast<int>(saturate(color[i]) * (c_srgbTableSize - 1) + 0.5f)]
+                           : static_cast<uint32_t>(saturate(color[i]) * 255.0f + 0.5f);
+    }
+    const uint32_t a = static_cast<uint32_t>(saturate(color.a) * 255.0f + 0.5f);
+    return rgb[0] | (rgb[1] << 8) | (rgb[2] << 16) | (a << 24);
+}
+
+// Evaluate plane at pixel position
+inline float evaluate(const CpuRenderer::Plane& plane, float x, float y) { return plane.a * x + plane.b * y + plane.c; }
+
+// Returns true if pixel space point is before other in canonical edge order
+inline bool isCanonical(const CpuRenderer::ScreenVertex& a, const CpuRenderer::ScreenVertex& b) { return a.x < b.x || (a.x == b.x && a.y < b.y); }
+
+// Returns true if edge function of rectangle corner farthest inside is negative, i.e. rectangle of
+// pixel centers [x0, x1] x [y0, y1] is outside edge
+inline bool isOutside(const CpuRenderer::Plane& edge, float x0, float y0, float x1, float y1)
+{
+    const float x = edge.a > 0.0f ? x1 : x0;
+    const float y = edge.b > 0.0f ? y1 : y0;
+    return evaluate(edge, x, y) < -c_rejectMargin * (std::abs(edge.a) + std::abs(edge.b));
+}
+
+// Intersection of clip space edge with plane of given signed distances. Interpolates from the
+// canonical end point, so that triangles sharing the edge get identical vertices.
+void intersect(const float* a, float da, const float* b, float db, int floats, float* out)
+{
+    if (std::memcmp(a, b, floats * sizeof(float)) > 0) {
+        std::swap(a, b);
+        std::swap(da, db);
+    }
+    const float t = da / (da - db);
+    for (int i = 0; i < floats; i++) {
+        out[i] = a[i] + t * (b[i] - a[i]);
+    }
+}
+
+// Signed distance of clip space vertex to clip plane, negative outside
+float getClipDistance(const float* v, int plane)
+{
+    switch (plane) {
+        case 0: return v[2];                        // Near: z >= 0
+        case 1: return v[3] - v[2];                 // Far: z <= w
+        case 2: return c_guardBand * v[3] + v[0];  // Guard band left
+        case 3: return c_guardBand * v[3] - v[0];  // Guard band right
+        case 4: return c_guardBand * v[3] + v[1];  // Guard band bottom
+        default: return c_guardBand * v[3] - v[1];  // Guard band top
+    }
+}
+
+// Read little endian value from memory
+template <typename T>
+T readLE(const uint8_t* p)
+{
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); i++) {
+        value |= static_cast<T>(static_cast<T>(p[i]) << (8 * i));
+    }
+    return value;
+}
+
+// Decode uncompressed 24 or 32 bit BMP, as written by data streamer, to RGBA texels
+bool decodeBmp(const uint8_t* memory, size_t size, int32_t& outWidth, int32_t& outHeight, std::vector<glm::vec4>& outTexels)
+{
+    constexpr size_t c_headerSize = 14 + 40;
+    if (size < c_headerSize || memory[0] != 'B' || memory[1] != 'M') {
+        return false;
+    }
+    const uint32_t offset = readLE<uint32_t>(memory + 10);
+    const int32_t width = static_cast<int32_t>(readLE<uint32_t>(memory + 18));
+    const int32_t height = static_cast<int32_t>(readLE<uint32_t>(memory + 22));
+    const uint16_t bits = readLE<uint16_t>(memory + 28);
+    const uint32_t compression = readLE<uint32_t>(memory + 30);
+    const int32_t rows = std::abs(height);
+    const size_t rowSize = ((static_cast<size_t>(width) * bits / 8) + 3) & ~size_t(3);
+    if (width <= 0 || rows == 0 || (bits != 24 && bits != 32) || compression != 0 || offset + rowSize * rows > size) {
+        return false;
+    }
+
+    // Positive height is stored bottom up, pixels are BGR(A)
+    outWidth = width;
+    outHeight = rows;
+    outTexels.resize(static_cast<size_t>(width) * rows);
+    for (int32_t y = 0; y < rows; y++) {
+        const uint8_t* src = memory + offset + rowSize * (height > 0 ? rows - 1 - y : y);
+        for (int32_t x = 0; x < width; x++) {
+            const uint8_t* p = src + x * (bits / 8);
+            outTexels[static_cast<size_t>(y) * width + x] = glm::vec4(p[2], p[1], p[0], bits == 32 ? p[3] : 255) / 255.0f;
+        }
+    }
+    return true;
+}
+
+}  // namespace
+
+//---------------------------------------------------------------------------
+
+CpuRenderer::RenderTarget::RenderTarget(int32_t width, int32_t height, bool srgb)
+    : Renderer::RenderTarget(width, height)
+    , m_srgb(srgb)
+    , m_blocksX((width + c_blockSize - 1) / c_blockSize)
+    , m_color(static_cast<size_t>(width) * height)
+    , m_depth(static_cast<size_t>(width) * height + c_blockSize, 1.0f)
+    , m_maxDepth(static_cast<size_t>(m_blocksX) * ((height + c_blockSize - 1) / c_blockSize), 1.0f)
+{
+    // Depth is padded by one block width, so that SIMD loads of last row stay in buffer
+}
+
+//---------------------------------------------------------------------------
+
+glm::vec4 CpuRenderer::Texture::sampleFace(int face, const glm::vec2& uv, bool clamp) const
+{
+    const glm::ivec2& size = getSize();
+    const glm::vec4* texels = m_texels.data() + static_cast<size_t>(face) * size.x * size.y;
+    const float fx = uv.x * size.x - 0.5f;
+    const float fy = uv.y * size.y - 0.5f;
+    const int x0 = static_cast<int>(std::floor(fx));
+    const int y0 = static_cast<int>(std::floor(fy));
+    const float tx = fx - x0;
+    const float ty = fy - y0;
+
+    // Border color is zero like D3D11 renderer samplers, cubemap faces are clamped
+    const auto fetch = [&](int x, int y) {
+        if (clamp) {
+            x = std::min(std::max(x, 0), size.x - 1);
+            y = std::min(std::max(y, 0), size.y - 1);
+        } else if (x < 0 || y < 0 || x >= size.x || y >= size.y) {
+            return glm::vec4(0.0f);
+        }
+        return texels[static_cast<size_t>(y) * size.x + x];
+    };
+    return glm::mix(glm::mix(fetch(x0, y0), fetch(x0 + 1, y0), tx), glm::mix(fetch(x0, y0 + 1), fetch(x0 + 1, y0 + 1), tx), ty);
+}
+
+glm::vec4 CpuRenderer::Texture::sample(const glm::vec2& uv) const
+{
+    if (m_texels.empty() || getType() != TextureType::Texture2D) {
+        return glm::vec4(0.0f);
+    }
+    return sampleFace(0, uv, false);
+}
+
+glm::vec4 CpuRenderer::Texture::sampleCube(const glm::vec3& direction) const
+{
+    if (m_texels.empty() || getType() != TextureType::Cubemap) {
+        return glm::vec4(0.0f);
+    }
+
+    // Major axis selects face in D3D order +X, -X, +Y, -Y, +Z, -Z
+    const glm::vec3 a = glm::abs(direction);
+    int face;
+    float ma, sc, tc;
+    if (a.x >= a.y && a.x >= a.z) {
+        face = direction.x >= 0.0f ? 0 : 1;
+        ma = a.x;
+        sc = direction.x >= 0.0f ? -direction.z : direction.z;
+        tc = -direction.y;
+    } else if (a.y >= a.z) {
+        face = direction.y >= 0.0f ? 2 : 3;
+        ma = a.y;
+        sc = direction.x;
+        tc = direction.y >= 0.0f ? direction.z : -direction.z;
+    } else {
+        face = direction.z >= 0.0f ? 4 : 5;
+        ma = a.z;
+        sc = direction.z >= 0.0f ? direction.x : -direction.x;
+        tc = -direction.y;
+    }
+    if (!(ma > 0.0f)) {
+        return glm::vec4(0.0f);
+    }
+    return sampleFace(face, glm::vec2(sc / ma + 1.0f, tc / ma + 1.0f) * 0.5f, true);
+}
+
+//---------------------------------------------------------------------------
+
+CpuRenderer::CpuRenderer(ThreadPool& threadPool, const Config& config)
+    : m_threadPool(threadPool)
+    , m_config(config)
+    , m_shaders(std::make_unique<CpuExampleShaders>(*this))
+{
+    if (!isSimdLevelSupported(m_config.simd)) {
+        const_cast<Config&>(m_config).simd = getMaxSimdLevel();
+    }
+}
+
+CpuRenderer::~CpuRenderer() = default;
+
+std::unique_ptr<Renderer::Shader> CpuRenderer::createShader(const Shader::InitParams& params)
+{
+    if (!params.vertexFunction || !params.pixelFunction || params.varyingCount < 0 || params.varyingCount > c_maxVaryings) {
+        LOGE("Invalid CPU shader: %s", params.name);
+        return nullptr;
+    }
+    return std::make_unique<CpuRenderer::Shader>(params);
+}
+
+const ExampleShaders& CpuRenderer::getShaders() const { return *m_shaders; }
+
+void CpuRenderer::setMetrics(MetricsRegistry* metrics)
+{
+    m_metrics = metrics;
+    if (metrics) {
+        m_flushMetric = metrics->addMetric("CPU renderer: raster", MetricsRegistry::Kind::Timer);
+        m_pixelsMetric = metrics->addMetric("CPU renderer: shaded pixels", MetricsRegistry::Kind::Counter);
+    } else {
+        m_flushMetric = m_pixelsMetric = MetricsRegistry::c_invalidId;
+    }
+}
+
+std::unique_ptr<Renderer::Mesh> CpuRenderer::createMesh(
+    const std::vector<float>& vertexData, int vertexStride, const std::vector<unsigned short>& indexData, PrimitiveTopology topology)
+{
+    return std::make_unique<CpuRenderer::Mesh>(vertexData, vertexStride, indexData, topology);
+}
+
+std::unique_ptr<Renderer::Texture> CpuRenderer::loadTextureFromMemory(const uint8_t* memory, size_t size)
+{
+    // Only uncompressed BMP is decoded, there is no image codec without WIC
+    int32_t width = 0;
+    int32_t height = 0;
+    std::vector<glm::vec4> texels;
+    if (!decodeBmp(memory, size, width, height, texels)) {
+        LOGE("Unsupported texture image, CPU renderer loads only uncompressed BMP.");
+        return nullptr;
+    }
+
+    auto texture = std::make_unique<CpuRenderer::Texture>();
+    texture->init(width, height);
+    texture->m_texels = std::move(texels);
+    texture->setMemoryBytes(texture->m_texels.size() * sizeof(glm::vec4));
+    return texture;
+}
+
+std::unique_ptr<Renderer::Texture> CpuRenderer::createHdrCubemap(int32_t resolution, varjo_TextureFormat format)
+{
+    if (format != varjo_TextureFormat_RGBA16_FLOAT) {
+        LOGE("Unsupported cubemap format: %lld", static_cast<long long>(format));
+        return nullptr;
+    }
+
+    auto texture = std::make_unique<CpuRenderer::Texture>();
+    texture->init(resolution, resolution, TextureType::Cubemap);
+    texture->m_format = format;
+    texture->m_texels.resize(static_cast<size_t>(6) * resolution * resolution);
+    texture->setMemoryBytes(texture->m_texels.size() * sizeof(glm::vec4));
+    return texture;
+}
+
+void CpuRenderer::updateTexture(Renderer::Texture* texture, const uint8_t* data, size_t rowPitch)
+{
+    assert(texture);
+    auto& cpuTexture = *static_cast<CpuRenderer::Texture*>(texture);
+    const glm::ivec2& size = cpuTexture.getSize();
+    const int faces = cpuTexture.getType() == TextureType::Cubemap ? 6 : 1;
+    cpuTexture.m_texels.resize(static_cast<size_t>(faces) * size.x * size.y);
+
+    // Faces follow each other like in D3D11 renderer. Texels are RGBA16_FLOAT or RGBA8.
+    const size_t faceDataSize = size.y * rowPitch;
+    for (int face = 0; face < faces; face++) {
+        for (int y = 0; y < size.y; y++) {
+            const uint8_t* src = data + face * faceDataSize + y * rowPitch;
+            glm::vec4* dst = cpuTexture.m_texels.data() + (static_cast<size_t>(face) * size.y + y) * size.x;
+            for (int x = 0; x < size.x; x++) {
+                if (cpuTexture.m_format == varjo_TextureFormat_RGBA16_FLOAT) {
+                    Simd::Half h[4];
+                    memcpy(h, src + x * sizeof(h), sizeof(h));
+                    dst[x] = glm::vec4(Simd::halfToFloat(h[0]), Simd::halfToFloat(h[1]), Simd::halfToFloat(h[2]), Simd::halfToFloat(h[3]));
+                } else {
+                    const uint8_t* p = src + x * 4;
+                    dst[x] = glm::vec4(p[0], p[1], p[2], p[3]) / 255.0f;
+                }
+            }
+        }
+    }
+}
+
+void CpuRenderer::bindRenderTarget(Renderer::RenderTarget& target)
+{
+    auto* cpuTarget = static_cast<CpuRenderer::RenderTarget*>(&target);
+    if (cpuTarget == m_target) {
+        return;
+    }
+    flush();
+
+    m_target = cpuTarget;
+    const glm::ivec2& size = target.getSize();
+    m_tilesX = (size.x + c_tileSize - 1) / c_tileSize;
+    m_tilesY = (size.y + c_tileSize - 1) / c_tileSize;
+    m_bins.resize(static_cast<size_t>(m_tilesX) * m_tilesY);
+}
+
+void CpuRenderer::unbindRenderTarget()
+{
+    flush();
+    m_target = nullptr;
+}
+
+void CpuRenderer::bindTextures(const std::vector<Renderer::Texture*> textures)
+{
+    m_textures.fill(nullptr);
+    for (size_t i = 0; i < textures.size() && i < m_textures.size(); i++) {
+        m_textures[i] = static_cast<const CpuRenderer::Texture*>(textures[i]);
+    }
+}
+
+void CpuRenderer::clear(
+    Renderer::RenderTarget& target, const glm::vec4& colorValue, bool clearColor, bool clearDepth, bool clearStencil, float depthValue, uint8_t stencilValue)
+{
+    // Like D3D11, clears the full target regardless of viewport. Binned triangles are drawn first.
+    auto& cpuTarget = static_cast<CpuRenderer::RenderTarget&>(target);
+    if (&cpuTarget == m_target) {
+        flush();
+    }
+    m_stats.clears++;
+
+    const glm::ivec2& size = target.getSize();
+    const uint32_t color = packColor(colorValue, cpuTarget.m_srgb ? getSrgbTable().data() : nullptr);
+    m_threadPool.parallelFor(size.y, [&](int y0, int y1) {
+        const size_t begin = static_cast<size_t>(y0) * size.x;
+        const size_t end = static_cast<size_t>(y1) * size.x;
+        if (clearColor) {
+            std::fill(cpuTarget.m_color.begin() + begin, cpuTarget.m_color.begin() + end, color);
+        }
+        if (clearDepth) {
+            std::fill(cpuTarget.m_depth.begin() + begin, cpuTarget.m_depth.begin() + end, depthValue);
+        }
+    }, c_blockSize);
+    if (clearDepth) {
+        std::fill(cpuTarget.m_maxDepth.begin(), cpuTarget.m_maxDepth.end(), depthValue);
+    }
+}
+
+//---------------------------------------------------------------------------
+
+void CpuRenderer::renderMesh(Renderer::Mesh& mesh, const void* vsConstants, size_t vsConstantsSize, const void* psConstants, size_t psConstantsSize)
+{
+    if (!m_target || !m_shader) {
+        LOGE("Rendering mesh without bound render target and shader.");
+        return;
+    }
+    const Shader::InitParams& shader = m_shader->getParams();
+    if (vsConstantsSize < shader.vsConstantsSize || psConstantsSize < shader.psConstantsSize) {
+        LOGE("Shader constants missing for shader: %s", shader.name);
+        return;
+    }
+    const int64_t begin = getTimestampNs();
+    auto& cpuMesh = static_cast<CpuRenderer::Mesh&>(mesh);
+    m_stats.meshes++;
+
+    // Draw state of triangles. Pixel shader constants are copied 16 byte aligned like constant
+    // buffers, caller may reuse its buffer.
+    Draw draw;
+    draw.shader = m_shader;
+    m_constants.resize((m_constants.size() + 15) & ~size_t(15));
+    draw.constantsOffset = m_constants.size();
+    draw.textures = m_textures;
+    draw.depthEnabled = m_depthEnabled;
+    const uint8_t* constants = static_cast<const uint8_t*>(psConstants);
+    m_constants.insert(m_constants.end(), constants, constants + psConstantsSize);
+    const uint32_t drawIndex = static_cast<uint32_t>(m_draws.size());
+    m_draws.push_back(draw);
+
+    // Vertex shader
+    const int vertexCount = cpuMesh.m_stride > 0 ? static_cast<int>(cpuMesh.m_vertices.size()) / cpuMesh.m_stride : 0;
+    m_clipVertices.resize(static_cast<size_t>(vertexCount) * c_clipStride);
+    for (int i = 0; i < vertexCount; i++) {
+        float* clip = m_clipVertices.data() + static_cast<size_t>(i) * c_clipStride;
+        const glm::vec4 position = shader.vertexFunction(cpuMesh.m_vertices.data() + static_cast<size_t>(i) * cpuMesh.m_stride, vsConstants, clip + 4);
+        memcpy(clip, &position, sizeof(position));
+    }
+
+    // Primitives, indices out of range are skipped
+    const auto& indices = cpuMesh.m_indices;
+    const int primitiveSize = cpuMesh.m_topology == PrimitiveTopology::Lines ? 2 : 3;
+    for (size_t i = 0; i + primitiveSize <= indices.size(); i += primitiveSize) {
+        m_stats.triangles++;
+        const float* clip[3] = {};
+        bool valid = true;
+        for (int k = 0; k < primitiveSize; k++) {
+            valid = valid && indices[i + k] < vertexCount;
+            clip[k] = m_clipVertices.data() + static_cast<size_t>(valid ? indices[i + k] : 0) * c_clipStride;
+        }
+        if (valid) {
+            setupClipped(clip, primitiveSize, shader.varyingCount, drawIndex);
+        } else {
+            m_stats.culledTriangles++;
+        }
+    }
+
+    m_stats.setupTimeNs += getTimestampNs() - begin;
+}
+
+CpuRenderer::ScreenVertex CpuRenderer::toScreen(const float* clip, int varyingCount) const
+{
+    // D3D viewport transform, y down
+    ScreenVertex v;
+    v.invW = 1.0f / clip[3];
+    v.x = m_viewport[0] + (clip[0] * v.invW * 0.5f + 0.5f) * m_viewport[2];
+    v.y = m_viewport[1] + (0.5f - clip[1] * v.invW * 0.5f) * m_viewport[3];
+    v.z = clip[2] * v.invW;
+    for (int i = 0; i < varyingCount; i++) {
+        v.varyings[i] = clip[4 + i] * v.invW;
+    }
+    return v;
+}
+
+void CpuRenderer::setupClipped(const float* const clip[3], int count, int varyingCount, uint32_t draw)
+{
+    const int floats = 4 + varyingCount;
+
+    // Lines are clipped as segments
+    if (count == 2) {
+        float ends[2][c_clipStride];
+        memcpy(ends[0], clip[0], floats * sizeof(float));
+        memcpy(ends[1], clip[1], floats * sizeof(float));
+        for (int plane = 0; plane < 6; plane++) {
+            const float d0 = getClipDistance(ends[0], plane);
+            const float d1 = getClipDistance(ends[1], plane);
+            if (d0 < 0.0f && d1 < 0.0f) {
+                m_stats.culledTriangles++;
+                return;
+            }
+            if (d0 < 0.0f || d1 < 0.0f) {
+                float point[c_clipStride];
+                intersect(ends[0], d0, ends[1], d1, floats, point);
+                memcpy(ends[d0 < 0.0f ? 0 : 1], point, floats * sizeof(float));
+            }
+        }
+        setupLine(toScreen(ends[0], varyingCount), toScreen(ends[1], varyingCount), varyingCount, draw);
+        return;
+    }
+
+    // Sutherland-Hodgman against planes the triangle crosses
+    float polygons[2][c_maxPolygon][c_clipStride];
+    int size = 3;
+    int current = 0;
+    for (int i = 0; i < 3; i++) {
+        memcpy(polygons[0][i], clip[i], floats * sizeof(float));
+    }
+    for (int plane = 0; plane < 6; plane++) {
+        float distances[c_maxPolygon];
+        bool inside = true;
+        bool outside = true;
+        for (int i = 0; i < size; i++) {
+            distances[i] = getClipDistance(polygons[current][i], plane);
+            inside = inside && distances[i] >= 0.0f;
+            outside = outside && distances[i] < 0.0f;
+        }
+        if (outside) {
+            m_stats.culledTriangles++;
+            return;
+        }
+        if (inside) {
+            continue;
+        }
+
+        int clippedSize = 0;
+        for (int i = 0; i < size; i++) {
+            const int j = (i + 1) % size;
+            if (distances[i] >= 0.0f) {
+                memcpy(polygons[1 - current][clippedSize++], polygons[current][i], floats * sizeof(float));
+            }
+            if ((distances[i] >= 0.0f) != (distances[j] >= 0.0f)) {
+                intersect(polygons[current][i], distances[i], polygons[current][j], distances[j], floats, polygons[1 - current][clippedSize++]);
+            }
+        }
+        size = clippedSize;
+        current = 1 - current;
+    }
+
+    // Triangle fan of clipped polygon
+    ScreenVertex vertices[c_maxPolygon];
+    for (int i = 0; i < size; i++) {
+        vertices[i] = toScreen(polygons[current][i], varyingCount);
+    }
+    for (int i = 1; i + 1 < size; i++) {
+        setupTriangle(vertices[0], vertices[i], vertices[i + 1], varyingCount, draw, false);
+    }
+}
+
+void CpuRenderer::setupLine(const ScreenVertex& v0, const ScreenVertex& v1, int varyingCount, uint32_t draw)
+{
+    const float dx = v1.x - v0.x;
+    const float dy = v1.y - v0.y;
+    const float length = std::sqrt(dx * dx + dy * dy);
+    if (!(length > 0.0f)) {
+        m_stats.culledTriangles++;
+        return;
+    }
+
+    // Quad half a pixel to both sides of line
+    const float nx = -0.5f * dy / length;
+    const float ny = 0.5f * dx / length;
+    ScreenVertex quad[4] = {v0, v0, v1, v1};
+    quad[0].x += nx;
+    quad[0].y += ny;
+    quad[1].x -= nx;
+    quad[1].y -= ny;
+    quad[2].x += nx;
+    quad[2].y += ny;
+    quad[3].x -= nx;
+    quad[3].y -= ny;
+    setupTriangle(quad[0], quad[2], quad[3], varyingCount, draw, true);
+    setupTriangle(quad[0], quad[3], quad[1], varyingCount, draw, true);
+}
+
+void CpuRenderer::setupTriangle(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2, int varyingCount, uint32_t draw, bool isLine)
+{
+    const ScreenVertex* v[3] = {&v0, &v1, &v2};
+    const float area2 = (v1.x - v0.x) * (v2.y - v0.y) - (v1.y - v0.y) * (v2.x - v0.x);
+    if (!(area2 != 0.0f) || !std::isfinite(area2)) {
+        m_stats.culledTriangles++;
+        return;
+    }
+
+    // Pixel bounds clipped to viewport and target
+    const glm::ivec2& size = m_target->getSize();
+    Triangle tri;
+    const float minX = std::min({v0.x, v1.x, v2.x});
+    const float minY = std::min({v0.y, v1.y, v2.y});
+    const float maxX = std::max({v0.x, v1.x, v2.x});
+    const float maxY = std::max({v0.y, v1.y, v2.y});
+    tri.minX = std::max({static_cast<int32_t>(std::floor(minX)), m_viewport[0], 0});
+    tri.minY = std::max({static_cast<int32_t>(std::floor(minY)), m_viewport[1], 0});
+    tri.maxX = std::min({static_cast<int32_t>(std::ceil(maxX)), m_viewport[0] + m_viewport[2], size.x});
+    tri.maxY = std::min({static_cast<int32_t>(std::ceil(maxY)), m_viewport[1] + m_viewport[3], size.y});
+    if (tri.minX >= tri.maxX || tri.minY >= tri.maxY) {
+        m_stats.culledTriangles++;
+        return;
+    }
+
+    // Edge functions from canonical end points, flipped to be positive inside. The triangle that
+    // did not need to flip owns pixels exactly on the edge, its neighbor across the edge flipped.
+    for (int i = 0; i < 3; i++) {
+        const ScreenVertex* p = v[i];
+        const ScreenVertex* q = v[(i + 1) % 3];
+        const bool swapped = !isCanonical(*p, *q);
+        if (swapped) {
+            std::swap(p, q);
+        }
+        Plane edge;
+        edge.a = q->y - p->y;
+        edge.b = p->x - q->x;
+        edge.c = -(edge.a * p->x + edge.b * p->y);
+        if (swapped == (area2 < 0.0f)) {
+            edge = {-edge.a, -edge.b, -edge.c};
+        } else {
+            tri.owned |= 1 << i;
+        }
+        tri.edges[i] = edge;
+    }
+
+    // Attribute planes through vertex values
+    const float invArea2 = 1.0f / area2;
+    const float dx1 = v1.x - v0.x, dy1 = v1.y - v0.y;
+    const float dx2 = v2.x - v0.x, dy2 = v2.y - v0.y;
+    const auto makePlane = [&](float f0, float f1, float f2) {
+        Plane plane;
+        plane.a = ((f1 - f0) * dy2 - (f2 - f0) * dy1) * invArea2;
+        plane.b = ((f2 - f0) * dx1 - (f1 - f0) * dx2) * invArea2;
+        plane.c = f0 - plane.a * v0.x - plane.b * v0.y;
+        return plane;
+    };
+    tri.depth = makePlane(v0.z, v1.z, v2.z);
+    tri.invW = makePlane(v0.invW, v1.invW, v2.invW);
+    for (int i = 0; i < varyingCount; i++) {
+        tri.varyings[i] = makePlane(v0.varyings[i], v1.varyings[i], v2.varyings[i]);
+    }
+    tri.minDepth = std::max(std::min({v0.z, v1.z, v2.z}) - c_depthMargin, 0.0f);
+    tri.draw = draw;
+    tri.frontFace = isLine || area2 > 0.0f;
+
+    // Bin to tiles the edges do not reject
+    const uint32_t index = static_cast<uint32_t>(m_triangles.size());
+    bool binned = false;
+    for (int ty = tri.minY / c_tileSize; ty <= (tri.maxY - 1) / c_tileSize; ty++) {
+        for (int tx = tri.minX / c_tileSize; tx <= (tri.maxX - 1) / c_tileSize; tx++) {
+            const float x0 = tx * c_tileSize + 0.5f;
+            const float y0 = ty * c_tileSize + 0.5f;
+            const float x1 = x0 + c_tileSize - 1.0f;
+            const float y1 = y0 + c_tileSize - 1.0f;
+            if (isOutside(tri.edges[0], x0, y0, x1, y1) || isOutside(tri.edges[1], x0, y0, x1, y1) || isOutside(tri.edges[2], x0, y0, x1, y1)) {
+                continue;
+            }
+            m_bins[static_cast<size_t>(ty) * m_tilesX + tx].push_back(index);
+            m_stats.binnedTriangles++;
+            binned = true;
+        }
+    }
+    if (binned) {
+        m_triangles.push_back(tri);
+        m_stats.setupTriangles++;
+    } else {
+        m_stats.culledTriangles++;
+    }
+}
+
+//---------------------------------------------------------------------------
+
+template <typename V>
+void CpuRenderer::rasterTile(int tile, Stats& stats) const
+{
+    using Float = typename V::Float;
+    using Mask = typename V::Mask;
+
+    RenderTarget& target = *m_target;
+    const glm::ivec2& size = target.getSize();
+    const int tileX0 = (tile % m_tilesX) * c_tileSize;
+    const int tileY0 = (tile / m_tilesX) * c_tileSize;
+    const int tileX1 = std::min(tileX0 + c_tileSize, size.x);
+    const int tileY1 = std::min(tileY0 + c_tileSize, size.y);
+    const uint8_t* srgbTable = target.m_srgb ? getSrgbTable().data() : nullptr;
+
+    std::array<float, c_maxVaryings> varyings{};
+    alignas(32) float depthRow[c_blockSize];
+
+    for (uint32_t index : m_bins[tile]) {
+        const Triangle& tri = m_triangles[index];
+        const Draw& draw = m_draws[tri.draw];
+        const Shader::InitParams& shader = draw.shader->getParams();
+        const int varyingCount = shader.varyingCount;
+
+        PixelInput input;
+        input.varyings = varyings.data();
+        input.frontFace = tri.frontFace;
+        input.constants = shader.psConstantsSize ? m_constants.data() + draw.constantsOffset : nullptr;
+        input.textures = draw.textures.data();
+
+        const int x0 = std::max(tri.minX, tileX0);
+        const int y0 = std::max(tri.minY, tileY0);
+        const int x1 = std::min(tri.maxX, tileX1);
+        const int y1 = std::min(tri.maxY, tileY1);
+
+        Float edgeA[3], edgeB[3], edgeC[3];
+        for (int e = 0; e < 3; e++) {
+            edgeA[e] = V::set1(tri.edges[e].a);
+            edgeB[e] = V::set1(tri.edges[e].b);
+            edgeC[e] = V::set1(tri.edges[e].c);
+        }
+        const Float depthA = V::set1(tri.depth.a);
+        const Float depthB = V::set1(tri.depth.b);
+        const Float depthC = V::set1(tri.depth.c);
+        const Float zero = V::zero();
+        const Float one = V::set1(1.0f);
+
+        // Blocks are aligned to target, tiles are whole blocks
+        for (int by = y0 - y0 % c_blockSize; by < y1; by += c_blockSize) {
+            for (int bx = x0 - x0 % c_blockSize; bx < x1; bx += c_blockSize) {
+                float& blockMaxDepth = target.m_maxDepth[static_cast<size_t>(by / c_blockSize) * target.m_blocksX + bx / c_blockSize];
+                if (draw.depthEnabled && m_config.hierarchicalDepth && tri.minDepth > blockMaxDepth) {
+                    stats.depthRejectedBlocks++;
+                    continue;
+                }
+                const int rowX0 = std::max(bx, x0);
+                const int rowX1 = std::min(bx + c_blockSize, x1);
+                const int rowY0 = std::max(by, y0);
+                const int rowY1 = std::min(by + c_blockSize, y1);
+                const float cx0 = rowX0 + 0.5f, cy0 = rowY0 + 0.5f, cx1 = rowX1 - 0.5f, cy1 = rowY1 - 0.5f;
+                if (isOutside(tri.edges[0], cx0, cy0, cx1, cy1) || isOutside(tri.edges[1], cx0, cy0, cx1, cy1) ||
+                    isOutside(tri.edges[2], cx0, cy0, cx1, cy1)) {
+                    stats.edgeRejectedBlocks++;
+                    continue;
+                }
+                stats.blocks++;
+
+                const int laneMask = ((1 << (rowX1 - bx)) - 1) & ~((1 << (rowX0 - bx)) - 1);
+                bool depthWritten = false;
+                for (int y = rowY0; y < rowY1; y++) {
+                    const Float py = V::set1(y + 0.5f);
+                    float* depth = target.m_depth.data() + static_cast<size_t>(y) * size.x + bx;
+
+                    // Coverage and depth test of row, pixels exactly on edge only if edge is owned
+                    int bits = 0;
+                    for (int lane = 0; lane < c_blockSize; lane += V::c_width) {
+                        const Float px = V::add(V::set1(static_cast<float>(bx)), V::load(c_laneOffsets + lane));
+                        Mask covered;
+                        for (int e = 0; e < 3; e++) {
+                            const Float value = V::madd(edgeA[e], px, V::madd(edgeB[e], py, edgeC[e]));
+                            const Mask inside = (tri.owned >> e) & 1 ? V::cmpge(value, zero) : V::cmpgt(value, zero);
+                            covered = e == 0 ? inside : V::maskAnd(covered, inside);
+                        }
+                        if (draw.depthEnabled) {
+                            const Float z = V::min(V::max(V::madd(depthA, px, V::madd(depthB, py, depthC)), zero), one);
+                            covered = V::maskAnd(covered, V::cmpge(V::load(depth + lane), z));
+                            V::store(depthRow + lane, z);
+                        }
+                        bits |= V::movemask(covered) << lane;
+                    }
+                    bits &= laneMask;
+
+                    // Shade covered pixels
+                    for (int lane = 0; bits; lane++, bits >>= 1) {
+                        if (!(bits & 1)) {
+                            continue;
+                        }
+                        const float fx = bx + c_laneOffsets[lane];
+                        const float fy = y + 0.5f;
+                        const float w = 1.0f / evaluate(tri.invW, fx, fy);
+                        for (int i = 0; i < varyingCount; i++) {
+                            varyings[i] = evaluate(tri.varyings[i], fx, fy) * w;
+                        }
+                        input.position = glm::vec2(fx, fy);
+                        const glm::vec4 color = shader.pixelFunction(input);
+                        target.m_color[static_cast<size_t>(y) * size.x + bx + lane] = packColor(color, srgbTable);
+                        if (draw.depthEnabled) {
+                            depth[lane] = depthRow[lane];
+                            depthWritten = true;
+                        }
+                        stats.shadedPixels++;
+                    }
+                }
+
+                // Farthest depth of block over pixels inside target
+                if (depthWritten) {
+                    float maxDepth = 0.0f;
+                    const int blockX1 = std::min(bx + c_blockSize, size.x);
+                    const int blockY1 = std::min(by + c_blockSize, size.y);
+                    for (int y = by; y < blockY1; y++) {
+                        const float* depth = target.m_depth.data() + static_cast<size_t>(y) * size.x;
+                        for (int x = bx; x < blockX1; x++) {
+                            maxDepth = std::max(maxDepth, depth[x]);
+                        }
+                    }
+                    blockMaxDepth = maxDepth;
+                }
+            }
+        }
+    }
+}
+
+void CpuRenderer::flush()
+{
+    if (m_triangles.empty() || !m_target) {
+        m_triangles.clear();
+        m_draws.clear();
+        m_constants.clear();
+        return;
+    }
+    const int64_t begin = getTimestampNs();
+
+    // Each tile is rasterized by one worker, so tiles need no synchronization
+    const int tileCount = m_tilesX * m_tilesY;
+    m_tileStats.assign(tileCount, Stats());
+    dispatchSimd(m_config.simd, [&](auto tag) {
+        using V = decltype(tag);
+        m_threadPool.parallelFor(tileCount, [&](int t0, int t1) {
+            for (int t = t0; t < t1; t++) {
+                rasterTile<V>(t, m_tileStats[t]);
+            }
+        });
+    });
+
+    int64_t shadedPixels = 0;
+    for (int t = 0; t < tileCount; t++) {
+        m_stats.blocks += m_tileStats[t].blocks;
+        m_stats.depthRejectedBlocks += m_tileStats[t].depthRejectedBlocks;
+        m_stats.edgeRejectedBlocks += m_tileStats[t].edgeRejectedBlocks;
+        shadedPixels += m_tileStats[t].shadedPixels;
+        m_bins[t].clear();
+    }
+    m_stats.shadedPixels += shadedPixels;
+    m_triangles.clear();
+    m_draws.clear();
+    m_constants.clear();
+
+    const int64_t timeNs = getTimestampNs() - begin;
+    m_stats.flushes++;
+    m_stats.rasterTimeNs += timeNs;
+    if (m_metrics) {
+        m_metrics->recordTime(m_flushMetric, timeNs);
+        m_metrics->increment(m_pixelsMetric, shadedPixels);
+    }
+}
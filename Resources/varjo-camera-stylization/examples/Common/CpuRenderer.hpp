@@ -0,0 +1,303 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <memory>
+
+#include "Globals.hpp"
+#include "Renderer.hpp"
+#include "KernelConfig.hpp"
+#include "ThreadPool.hpp"
+#include "MetricsRegistry.hpp"
+#include "MemoryAccounting.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! CPU renderer draws meshes without a GPU, for golden images, spectator previews and offline
+// renders on machines without graphics hardware. It follows D3D11 renderer state: no culling, depth
+// test less or equal, no blending, clip space depth in [0, 1] and clockwise front faces.
+//
+// Drawing is deferred and binned:
+//
+//   1. Setup: renderMesh() runs the vertex shader, clips triangles to near, far and guard band planes and sets
+//      up edge, depth and attribute plane equations in pixel space. Lines are expanded to one pixel
+//      wide quads. Each triangle is appended to the bins of the tiles its edges touch.
+//   2. Raster: unbinding the render target, clearing or binding another target flushes the bins.
+//      Tiles are rasterized in parallel on the thread pool, each tile by one worker, triangles in
+//      submission order. Edge functions are evaluated for rows of eight pixels with SIMD, and the
+//      pixel shader is called for covered pixels passing the depth test.
+//
+// Edge functions are computed from vertices in a canonical order and evaluated directly at pixel
+// centers, so triangles sharing an edge get exactly opposite values there. Pixel centers on a
+// shared edge belong to exactly one triangle, so meshes are drawn without cracks or double hits.
+//
+// Hierarchical depth keeps the farthest depth of each 8x8 block. Triangles whose nearest depth is
+// behind it are rejected for the whole block without evaluating edges.
+//
+// Output is deterministic: it does not depend on thread count, and SIMD variants differ from
+// scalar only where FMA rounds differently.
+
+//! Multithreaded binned software rasterizer
+class CpuRenderer final : public Renderer
+{
+public:
+    static constexpr int c_tileSize = 64;    //!< Tile size in pixels, unit of binning and parallel work
+    static constexpr int c_blockSize = 8;    //!< Block size in pixels, unit of hierarchical depth and SIMD rows
+    static constexpr int c_maxVaryings = 8;  //!< Largest number of floats passed from vertex to pixel shader
+    static constexpr int c_maxTextures = 4;  //!< Largest number of bound textures
+
+    //! Renderer configuration
+    struct Config {
+        SimdLevel simd = getMaxSimdLevel();  //!< SIMD variant of edge functions
+        bool hierarchicalDepth = true;       //!< Reject blocks behind farthest depth of block
+    };
+
+    //! Render target implementation for CPU renderer: RGBA8 color and float depth
+    class RenderTarget final : public Renderer::RenderTarget
+    {
+    public:
+        //! Construct render target of given size. sRGB targets encode shader output like R8G8B8A8_SRGB.
+        RenderTarget(int32_t width, int32_t height, bool srgb = true);
+
+        //! Returns RGBA8 color pixels, row order
+        const uint32_t* getColor() const { return m_color.data(); }
+
+        //! Returns float depth pixels, row order
+        const float* getDepth() const { return m_depth.data(); }
+
+        //! Returns true if color is sRGB encoded
+        bool isSrgb() const { return m_srgb; }
+
+    private:
+        friend class CpuRenderer;
+
+        const bool m_srgb;                                     //!< sRGB encoded color
+        const int m_blocksX;                                   //!< Blocks per row
+        TrackedVector<uint32_t, MemoryTag::Renderer> m_color;  //!< RGBA8 color
+        TrackedVector<float, MemoryTag::Renderer> m_depth;     //!< Depth
+        TrackedVector<float, MemoryTag::Renderer> m_maxDepth;  //!< Farthest depth of each block
+    };
+
+    //! Texture implementation for CPU renderer. Texels are stored as floats.
+    class Texture final : public Renderer::Texture
+    {
+    public:
+        //! Returns bilinear sample of 2D texture at D3D texture coordinates, zero outside texture
+        glm::vec4 sample(const glm::vec2& uv) const;
+
+        //! Returns bilinear sample of cubemap in given direction
+        glm::vec4 sampleCube(const glm::vec3& direction) const;
+
+    private:
+        friend class CpuRenderer;
+
+        //! Bilinear sample of given face at D3D texture coordinates, clamped or bordered
+        glm::vec4 sampleFace(int face, const glm::vec2& uv, bool clamp) const;
+
+        varjo_TextureFormat m_format = varjo_TextureFormat_R8G8B8A8_UNORM;  //!< Format of updated data
+        std::vector<glm::vec4> m_texels;                                    //!< Texels of each face, row order
+    };
+
+    //! Vertex after viewport transform. Varyings are divided by w for perspective correct interpolation.
+    struct ScreenVertex {
+        float x, y, z, invW;                        //!< Pixel position, depth and 1/w
+        std::array<float, c_maxVaryings> varyings;  //!< Varyings divided by w
+    };
+
+    //! Plane equation a * x + b * y + c in pixel space
+    struct Plane {
+        float a, b, c;  //!< Coefficients
+    };
+
+    //! Inputs of pixel shader for one pixel
+    struct PixelInput {
+        glm::vec2 position{0.0f};                  //!< Pixel center in render target
+        const float* varyings = nullptr;           //!< Perspective correct interpolated varyings
+        bool frontFace = true;                     //!< Triangle is clockwise on screen
+        const void* constants = nullptr;           //!< Pixel shader constants
+        const Texture* const* textures = nullptr;  //!< Bound textures, null where not bound
+    };
+
+    //! Vertex shader function. Writes varyings and returns clip space position.
+    using VertexFunction = glm::vec4 (*)(const float* vertex, const void* constants, float* outVaryings);
+
+    //! Pixel shader function. Returns color.
+    using PixelFunction = glm::vec4 (*)(const PixelInput& input);
+
+    //! Shader implementation for CPU renderer
+    class Shader final : public Renderer::Shader
+    {
+    public:
+        //! Shader init parameters
+        struct InitParams {
+            const char* name;               //!< Shader name
+            VertexFunction vertexFunction;  //!< Vertex shader
+            PixelFunction pixelFunction;    //!< Pixel shader
+            int varyingCount;               //!< Floats passed from vertex to pixel shader
+            size_t vsConstantsSize;         //!< Vertex shader constant buffer size
+            size_t psConstantsSize;         //!< Pixel shader constant buffer size
+        };
+
+        //! Construct shader from init parameters
+        Shader(const InitParams& params)
+            : m_params(params)
+        {
+        }
+
+        //! Returns init parameters
+        const InitParams& getParams() const { return m_params; }
+
+    private:
+        const InitParams m_params;  //!< Init parameters
+    };
+
+    //! Mesh implementation for CPU renderer
+    class Mesh final : public Renderer::Mesh
+    {
+    public:
+        //! Construct mesh storing given vertex data. Stride is in bytes.
+        Mesh(const std::vector<float>& vertexData, int vertexStride, const std::vector<unsigned short>& indexData, PrimitiveTopology topology)
+            : Renderer::Mesh(vertexData, indexData, topology)
+            , m_stride(vertexStride / static_cast<int>(sizeof(float)))
+        {
+        }
+
+    private:
+        friend class CpuRenderer;
+
+        const int m_stride;  //!< Vertex stride in floats
+    };
+
+    //! Renderer statistics
+    struct Stats {
+        int64_t meshes = 0;               //!< Rendered meshes
+        int64_t triangles = 0;            //!< Triangles and lines submitted
+        int64_t setupTriangles = 0;       //!< Triangles set up after clipping and line expansion
+        int64_t culledTriangles = 0;      //!< Triangles dropped in setup: clipped away, degenerate or outside viewport
+        int64_t binnedTriangles = 0;      //!< Triangle and tile pairs binned
+        int64_t blocks = 0;               //!< Triangle and block pairs rasterized
+        int64_t depthRejectedBlocks = 0;  //!< Triangle and block pairs rejected by hierarchical depth
+        int64_t edgeRejectedBlocks = 0;   //!< Triangle and block pairs outside triangle
+        int64_t shadedPixels = 0;         //!< Pixels shaded and written
+        int64_t flushes = 0;              //!< Bin flushes
+        int64_t clears = 0;               //!< Render target clears
+        int64_t setupTimeNs = 0;          //!< Total vertex shading, clipping, setup and binning time
+        int64_t rasterTimeNs = 0;         //!< Total flush time
+    };
+
+    //! Construct renderer running tiles on given thread pool
+    CpuRenderer(ThreadPool& threadPool, const Config& config);
+
+    //! Destructor
+    ~CpuRenderer();
+
+    // Disable copy, move and assign
+    CpuRenderer(const CpuRenderer& other) = delete;
+    CpuRenderer(const CpuRenderer&& other) = delete;
+    CpuRenderer& operator=(const CpuRenderer& other) = delete;
+    CpuRenderer& operator=(const CpuRenderer&& other) = delete;
+
+    //! Create shader of given init parameters
+    std::unique_ptr<Renderer::Shader> createShader(const Shader::InitParams& params);
+
+    //! Rasterize binned triangles into bound render target. Called implicitly before target changes and clears.
+    void flush();
+
+    //! Returns renderer statistics
+    const Stats& getStats() const { return m_stats; }
+
+    //! Reset renderer statistics
+    void resetStats() { m_stats = {}; }
+
+    //! Register flush timer and shaded pixel counter metrics to given registry. Pass null to stop publishing.
+    void setMetrics(MetricsRegistry* metrics);
+
+    //! From Renderer
+    using Renderer::renderMesh;
+    std::unique_ptr<Renderer::Mesh> createMesh(
+        const std::vector<float>& vertexData, int vertexStride, const std::vector<unsigned short>& indexData, PrimitiveTopology topology) override;
+    std::unique_ptr<Renderer::Texture> loadTextureFromMemory(const uint8_t* memory, size_t size) override;
+    std::unique_ptr<Renderer::Texture> createHdrCubemap(int32_t resolution, varjo_TextureFormat format) override;
+    void updateTexture(Renderer::Texture* texture, const uint8_t* data, size_t rowPitch) override;
+    void renderMesh(Renderer::Mesh& mesh, const void* vsConstants, size_t vsConstantsSize, const void* psConstants, size_t psConstantsSize) override;
+    void setDepthEnabled(bool enabled) override { m_depthEnabled = enabled; }
+    void bindRenderTarget(Renderer::RenderTarget& target) override;
+    void unbindRenderTarget() override;
+    void bindShader(Renderer::Shader& shader) override { m_shader = static_cast<CpuRenderer::Shader*>(&shader); }
+    void bindTextures(const std::vector<Renderer::Texture*> textures) override;
+    void setViewport(int32_t x, int32_t y, int32_t width, int32_t height) override { m_viewport = {x, y, width, height}; }
+    void clear(Renderer::RenderTarget& target, const glm::vec4& colorValue, bool clearColor, bool clearDepth, bool clearStencil, float depthValue,
+        uint8_t stencilValue) override;
+    const ExampleShaders& getShaders() const override;
+
+private:
+    //! Set up triangle ready for raster
+    struct Triangle {
+        std::array<Plane, 3> edges;                      //!< Edge functions, positive inside
+        int owned = 0;                                   //!< Bit per edge that includes pixels exactly on edge
+        Plane depth;                                     //!< Depth plane
+        Plane invW;                                      //!< 1/w plane
+        std::array<Plane, c_maxVaryings> varyings;       //!< Varying / w planes
+        float minDepth = 0.0f;                           //!< Nearest depth of triangle
+        int32_t minX = 0, minY = 0, maxX = 0, maxY = 0;  //!< Pixel bounds, max exclusive
+        uint32_t draw = 0;                               //!< Draw index
+        bool frontFace = true;                           //!< Clockwise on screen
+    };
+
+    //! Draw state shared by triangles of one renderMesh()
+    struct Draw {
+        const Shader* shader = nullptr;                        //!< Bound shader
+        size_t constantsOffset = 0;                            //!< Offset of pixel shader constants in constant storage
+        std::array<const Texture*, c_maxTextures> textures{};  //!< Bound textures
+        bool depthEnabled = true;                              //!< Depth test and write enabled
+    };
+
+    //! Clip triangle or line of given vertex count in clip space to near, far and guard band planes, set up and bin
+    //! resulting triangles
+    void setupClipped(const float* const clip[3], int count, int varyingCount, uint32_t draw);
+
+    //! Set up triangle of screen vertices and bin it
+    void setupTriangle(const ScreenVertex& v0, const ScreenVertex& v1, const ScreenVertex& v2, int varyingCount, uint32_t draw, bool isLine);
+
+    //! Expand line of screen vertices to one pixel wide quad and set it up
+    void setupLine(const ScreenVertex& v0, const ScreenVertex& v1, int varyingCount, uint32_t draw);
+
+    //! Convert clip space vertex to screen vertex using current viewport
+    ScreenVertex toScreen(const float* clip, int varyingCount) const;
+
+    //! Rasterize bin of one tile
+    template <typename V>
+    void rasterTile(int tile, Stats& stats) const;
+
+private:
+    ThreadPool& m_threadPool;  //!< Tile workers
+    const Config m_config;     //!< Renderer configuration
+    Stats m_stats{};           //!< Renderer statistics
+
+    // Bound state
+    RenderTarget* m_target = nullptr;                        //!< Bound render target
+    Shader* m_shader = nullptr;                              //!< Bound shader
+    std::array<const Texture*, c_maxTextures> m_textures{};  //!< Bound textures
+    std::array<int32_t, 4> m_viewport{};                     //!< Viewport x, y, width and height
+    bool m_depthEnabled = true;                              //!< Depth test and write enabled
+    std::unique_ptr<ExampleShaders> m_shaders;               //!< Example shader library
+
+    // Binned frame data, kept allocated between flushes
+    int m_tilesX = 0;                                                  //!< Tiles per row of bound target
+    int m_tilesY = 0;                                                  //!< Tile rows of bound target
+    TrackedVector<Triangle, MemoryTag::Renderer> m_triangles;          //!< Triangles set up since last flush
+    TrackedVector<Draw, MemoryTag::Renderer> m_draws;                  //!< Draws since last flush
+    TrackedVector<uint8_t, MemoryTag::Renderer> m_constants;           //!< Pixel shader constants of draws
+    std::vector<TrackedVector<uint32_t, MemoryTag::Renderer>> m_bins;  //!< Triangle indices of each tile
+    std::vector<Stats> m_tileStats;                                    //!< Raster statistics of each tile
+    TrackedVector<float, MemoryTag::Renderer> m_clipVertices;          //!< Vertex shader output of current mesh
+
+    MetricsRegistry* m_metrics = nullptr;                               //!< Metrics registry, null if not published
+    MetricsRegistry::Id m_flushMetric = MetricsRegistry::c_invalidId;   //!< Flush timer
+    MetricsRegistry::Id m_pixelsMetric = MetricsRegistry::c_invalidId;  //!< Shaded pixel counter
+};
+
+}  // namespace VarjoExamples
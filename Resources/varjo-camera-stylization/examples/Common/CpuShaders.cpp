@@ -0,0 +1,298 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "CpuShaders.hpp"
+
+#include <cmath>
+
+#include "CpuRenderer.hpp"
+
+namespace
+{
+using VarjoExamples::CpuRenderer;
+using VarjoExamples::ExampleShaders;
+
+// Shaders below are functors with typed constants. These thunks adapt them to CPU renderer function pointers.
+template <typename Shader>
+glm::vec4 vertexThunk(const float* vertex, const void* constants, float* outVaryings)
+{
+    return typename Shader::Vertex()(vertex, *static_cast<const decltype(Shader::Constants::vs)*>(constants), outVaryings);
+}
+
+template <typename Shader>
+glm::vec4 pixelThunk(const CpuRenderer::PixelInput& input)
+{
+    return typename Shader::Pixel()(input, *static_cast<const decltype(Shader::Constants::ps)*>(input.constants));
+}
+
+template <typename Shader>
+CpuRenderer::Shader::InitParams makeInitParams(const char* name)
+{
+    return {name, &vertexThunk<Shader>, &pixelThunk<Shader>, Shader::c_varyingCount, sizeof(Shader::Constants::vs), sizeof(Shader::Constants::ps)};
+}
+
+// HLSL frac()
+inline float frac(float v) { return v - std::floor(v); }
+
+// Clip space position of object space position, mul(projection, mul(view, mul(world, p))) in HLSL
+inline glm::vec4 transform(const ExampleShaders::TransformData& transform, const float* position)
+{
+    return transform.projection * (transform.view * (transform.world * glm::vec4(position[0], position[1], position[2], 1.0f)));
+}
+
+// HLSL normalizeWhiteBalance(). mul(rgb, (float3x3)m) of column major constant buffer is rgb * mat3(m).
+glm::vec3 normalizeWhiteBalance(const glm::vec3& rgb, const ExampleShaders::WBNormalizationData& data)
+{
+    glm::vec3 result = rgb * glm::mat3(data.invCCM);
+    result *= glm::vec3(data.wbGains);
+    result = glm::clamp(result, 0.0f, 1.0f);
+    return result * glm::mat3(data.ccm);
+}
+
+}  // namespace
+
+namespace VarjoExamples
+{
+// ----------------------------------------------------------------
+
+namespace RainbowCube
+{
+struct Shader {
+    using Constants = ExampleShaders::RainbowCubeConstants;
+
+    // Varyings: txcoord.xyz, color.rgba
+    static constexpr int c_varyingCount = 7;
+
+    // Vertex: position.xyz, color.rgb
+    struct Vertex {
+        glm::vec4 operator()(const float* vertex, const decltype(Constants::vs)& constants, float* out) const
+        {
+            const glm::vec3 txcoord = glm::vec3(vertex[0], vertex[1], vertex[2]) * constants.objectScale;
+            const glm::vec3 color = glm::mix(glm::vec3(constants.objectColor), glm::vec3(vertex[3], vertex[4], vertex[5]), constants.vtxColorFactor);
+            out[0] = txcoord.x;
+            out[1] = txcoord.y;
+            out[2] = txcoord.z;
+            out[3] = color.r;
+            out[4] = color.g;
+            out[5] = color.b;
+            out[6] = constants.objectColor.a;
+            return transform(constants.transform, vertex);
+        }
+    };
+
+    struct Pixel {
+        glm::vec4 operator()(const CpuRenderer::PixelInput& input, const decltype(Constants::ps)& constants) const
+        {
+            const float* in = input.varyings;
+            const glm::vec3 c = glm::vec3(in[0], in[1], in[2]) * 10.0f;
+            const float surfColor = 0.2f + 0.8f * frac(c.x + c.y) * frac(c.y + c.z) * frac(c.x + c.z);
+            const glm::vec3 color(in[3], in[4], in[5]);
+            const glm::vec3 faceColor =
+                input.frontFace ? color : glm::vec3(0.7f, 0.01f, 0.1f) * (glm::vec3(0.2f, 0.1f, 0.2f) + glm::vec3(color.g, color.b, color.r));
+            const glm::vec3 rgb = constants.exposureGain * constants.lighting.ambientLight * faceColor * surfColor;
+            return glm::vec4(normalizeWhiteBalance(rgb, constants.wbNormalization), in[6]);
+        }
+    };
+};
+
+}  // namespace RainbowCube
+
+// ----------------------------------------------------------------
+
+namespace CubemappedCube
+{
+struct Shader {
+    using Constants = ExampleShaders::CubemappedCubeConstants;
+
+    // Varyings: txcoord.xyz
+    static constexpr int c_varyingCount = 3;
+
+    // Vertex: position.xyz
+    struct Vertex {
+        glm::vec4 operator()(const float* vertex, const decltype(Constants::vs)& constants, float* out) const
+        {
+            out[0] = vertex[0];
+            out[1] = vertex[1];
+            out[2] = vertex[2];
+            return transform(constants.transform, vertex);
+        }
+    };
+
+    struct Pixel {
+        glm::vec4 operator()(const CpuRenderer::PixelInput& input, const decltype(Constants::ps)& constants) const
+        {
+            const float* in = input.varyings;
+            const CpuRenderer::Texture* cubeTex = input.textures[0];
+            const glm::vec3 cubeCoord = glm::normalize(glm::vec3(-in[0], -in[1], in[2]));
+            const glm::vec3 cubemapColor = cubeTex ? glm::vec3(cubeTex->sampleCube(cubeCoord)) * 100.0f : glm::vec3(0.0f);
+            const float faceColor = input.frontFace ? 1.0f : 0.5f;
+            return glm::vec4(normalizeWhiteBalance(constants.exposureGain * faceColor * cubemapColor, constants.wbNormalization), 1.0f);
+        }
+    };
+};
+
+}  // namespace CubemappedCube
+
+// ----------------------------------------------------------------
+
+namespace MarkerPlane
+{
+struct Shader {
+    using Constants = ExampleShaders::MarkerPlaneConstants;
+
+    // Varyings: texCoord.xy
+    static constexpr int c_varyingCount = 2;
+
+    // Vertex: position.xyz, texCoord.xy
+    struct Vertex {
+        glm::vec4 operator()(const float* vertex, const decltype(Constants::vs)& constants, float* out) const
+        {
+            out[0] = vertex[3];
+            out[1] = vertex[4];
+            return transform(constants.transform, vertex);
+        }
+    };
+
+    struct Pixel {
+        // Multiply color with digit of number atlas if texture coordinate is inside given rectangle
+        static void drawLetter(const CpuRenderer::Texture* numberAtlas, unsigned letter, glm::vec2 texCoord, const glm::vec2& min, const glm::vec2& max,
+            glm::vec4& color)
+        {
+            constexpr float c_letterSize = 0.1f;
+            texCoord = (texCoord - min) / (max - min);
+            if (texCoord.x < 0.01f || texCoord.x > 0.99f || texCoord.y < 0.01f || texCoord.y > 0.99f) {
+                return;
+            }
+            texCoord.x = texCoord.x * c_letterSize + c_letterSize * static_cast<float>(letter);
+            color *= numberAtlas ? numberAtlas->sample(texCoord) : glm::vec4(0.0f);
+        }
+
+        glm::vec4 operator()(const CpuRenderer::PixelInput& input, const decltype(Constants::ps)& constants) const
+        {
+            const glm::vec2 texCoord(input.varyings[0], input.varyings[1]);
+            const CpuRenderer::Texture* numberAtlas = input.textures[0];
+            glm::vec4 color(1.0f);
+
+            unsigned id = static_cast<unsigned>(constants.markerId);
+            const unsigned thousands = id / 1000;
+            id -= thousands * 1000;
+            const unsigned hundreds = id / 100;
+            id -= hundreds * 100;
+            const unsigned tens = id / 10;
+            id -= tens * 10;
+
+            drawLetter(numberAtlas, thousands, texCoord, {0.0f, 0.5f}, {0.25f, 0.75f}, color);
+            drawLetter(numberAtlas, hundreds, texCoord, {0.25f, 0.5f}, {0.5f, 0.75f}, color);
+            drawLetter(numberAtlas, tens, texCoord, {0.5f, 0.5f}, {0.75f, 0.75f}, color);
+            drawLetter(numberAtlas, id, texCoord, {0.75f, 0.5f}, {1.0f, 0.75f}, color);
+            return glm::vec4(glm::vec3(color), 1.0f);
+        }
+    };
+};
+
+}  // namespace MarkerPlane
+
+// ----------------------------------------------------------------
+
+namespace MarkerAxis
+{
+struct Shader {
+    using Constants = ExampleShaders::MarkerAxisConstants;
+
+    // Varyings: color.rgb
+    static constexpr int c_varyingCount = 3;
+
+    // Vertex: position.xyz, color.rgb, normal.xyz
+    struct Vertex {
+        glm::vec4 operator()(const float* vertex, const decltype(Constants::vs)& constants, float* out) const
+        {
+            glm::vec4 position = transform(constants.transform, vertex);
+            const glm::vec4 normal = constants.transform.projection *
+                                     (constants.transform.view * (constants.transform.world * glm::vec4(vertex[6], vertex[7], vertex[8], 0.0f)));
+            const glm::vec2 offset = glm::normalize(glm::vec2(normal)) * 0.001f;
+            position.x += offset.x;
+            position.y += offset.y;
+            out[0] = vertex[3];
+            out[1] = vertex[4];
+            out[2] = vertex[5];
+            return position;
+        }
+    };
+
+    struct Pixel {
+        glm::vec4 operator()(const CpuRenderer::PixelInput& input, const decltype(Constants::ps)&) const
+        {
+            return glm::vec4(input.varyings[0], input.varyings[1], input.varyings[2], 1.0f);
+        }
+    };
+};
+
+}  // namespace MarkerAxis
+
+// ----------------------------------------------------------------
+
+namespace TexturedPlane
+{
+struct Shader {
+    using Constants = ExampleShaders::TexturedPlaneConstants;
+
+    // Varyings: texCoord.xy
+    static constexpr int c_varyingCount = 2;
+
+    // Vertex: position.xyz, texCoord.xy
+    struct Vertex {
+        glm::vec4 operator()(const float* vertex, const decltype(Constants::vs)& constants, float* out) const
+        {
+            const glm::vec2 uv = glm::vec2(vertex[3], vertex[4]) - 0.5f;
+            glm::vec2 texCoord;
+            if (constants.dstAspect > constants.texAspect) {
+                texCoord = glm::vec2(0.5f) + glm::vec2(uv.x, uv.y * constants.texAspect / constants.dstAspect);
+            } else {
+                texCoord = glm::vec2(0.5f) + glm::vec2(uv.x * constants.dstAspect / constants.texAspect, uv.y);
+            }
+            out[0] = texCoord.x;
+            out[1] = texCoord.y;
+            return transform(constants.transform, vertex);
+        }
+    };
+
+    struct Pixel {
+        glm::vec4 operator()(const CpuRenderer::PixelInput& input, const decltype(Constants::ps)& constants) const
+        {
+            const CpuRenderer::Texture* imageTexture = input.textures[0];
+            const glm::vec4 color = imageTexture ? imageTexture->sample({input.varyings[0], input.varyings[1]}) : glm::vec4(0.0f);
+            const glm::vec4& colorCorrection = constants.colorCorrection;
+            return glm::vec4(colorCorrection.a * glm::vec3(colorCorrection) * glm::vec3(color), 1.0f);
+        }
+    };
+};
+
+}  // namespace TexturedPlane
+
+// ----------------------------------------------------------------
+
+std::unique_ptr<Renderer::Shader> CpuExampleShaders::createShader(ExampleShaders::ShaderType type) const
+{
+    switch (type) {
+        case ExampleShaders::ShaderType::RainbowCube: {
+            return m_cpuRenderer.createShader(makeInitParams<RainbowCube::Shader>("RainbowCube"));
+        }
+        case ExampleShaders::ShaderType::CubemappedCube: {
+            return m_cpuRenderer.createShader(makeInitParams<CubemappedCube::Shader>("CubemappedCube"));
+        }
+        case ExampleShaders::ShaderType::MarkerPlane: {
+            return m_cpuRenderer.createShader(makeInitParams<MarkerPlane::Shader>("MarkerPlane"));
+        }
+        case ExampleShaders::ShaderType::MarkerAxis: {
+            return m_cpuRenderer.createShader(makeInitParams<MarkerAxis::Shader>("LineSegment"));
+        }
+        case ExampleShaders::ShaderType::TexturedPlane: {
+            return m_cpuRenderer.createShader(makeInitParams<TexturedPlane::Shader>("TexturedPlane"));
+        }
+        default: {
+            LOGE("Unsupported shader type: %d", static_cast<int>(type));
+            return nullptr;
+        }
+    }
+}
+
+}  // namespace VarjoExamples
@@ -0,0 +1,28 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include "ExampleShaders.hpp"
+
+namespace VarjoExamples
+{
+class CpuRenderer;
+
+//! CPU example shaders. C++ implementations of D3D11 example shaders for CPU renderer.
+class CpuExampleShaders final : public ExampleShaders
+{
+public:
+    //! Constructor
+    CpuExampleShaders(CpuRenderer& cpuRenderer)
+        : m_cpuRenderer(cpuRenderer)
+    {
+    }
+
+    //! Create a shader of given type
+    std::unique_ptr<Renderer::Shader> createShader(ExampleShaders::ShaderType type) const override;
+
+private:
+    CpuRenderer& m_cpuRenderer;  //!< CPU renderer reference
+};
+
+}  // namespace VarjoExamples
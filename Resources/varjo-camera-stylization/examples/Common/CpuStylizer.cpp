@@ -0,0 +1,1185 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "CpuStylizer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <type_traits>
+
+#include "SimdMath.hpp"
+#include "Convolution.hpp"
+
+using namespace VarjoExamples;
+
+namespace
+{
+// Pointilism background color
+constexpr float c_paperColor[3] = {0.988235f, 0.94902f, 0.870588f};
+
+// Luma weights used by the sketch effect
+constexpr float c_sketchLumaWeights[3] = {0.2125f, 0.7154f, 0.0721f};
+
+// Plain average used by the cartoon effect
+constexpr float c_cartoonLumaWeights[3] = {1.0f / 3.0f, 1.0f / 3.0f, 1.0f / 3.0f};
+
+// Cartoon outline edge threshold
+constexpr float c_outlineThreshold = 0.05f;
+
+// Number of planes in watercolor sums: RGB and squared RGB
+constexpr int c_sumPlanes = 6;
+
+//! Source RGBA8 image
+struct SrcImage {
+    const uint8_t* data;  //!< Pixel data
+    size_t stride;        //!< Row stride in bytes
+    int width;            //!< Width in pixels
+    int height;           //!< Height in pixels
+
+    const uint8_t* pixel(int x, int y) const { return data + stride * y + static_cast<size_t>(x) * 4; }
+};
+
+//! Planar output of unpack stage with float or Simd::Half elements. Null planes are skipped.
+template <typename T>
+struct Planes {
+    T* r = nullptr;                                   //!< Red plane
+    T* g = nullptr;                                   //!< Green plane
+    T* b = nullptr;                                   //!< Blue plane
+    T* luma = nullptr;                                //!< Weighted luma plane
+    size_t stride = 0;                                //!< Row stride in elements
+    const float* lumaWeights = c_cartoonLumaWeights;  //!< Luma weights
+};
+
+// Call function with SIMD variant tag
+template <typename F>
+void dispatchSimd(SimdLevel level, F&& func)
+{
+    switch (level) {
+        case SimdLevel::AVX2: func(Simd::AVX2()); break;
+        case SimdLevel::SSE41: func(Simd::SSE41()); break;
+        default: func(Simd::Scalar()); break;
+    }
+}
+
+// Call function with storage element tag of intermediate buffer: Simd::Half or float
+template <typename F>
+void dispatchStorage(bool half, F&& func)
+{
+    if (half) {
+        func(Simd::Half());
+    } else {
+        func(0.0f);
+    }
+}
+
+// Returns byte offset of next intermediate buffer aligned for SIMD loads
+inline size_t alignBuffer(size_t bytes) { return (bytes + 31) & ~static_cast<size_t>(31); }
+
+// Returns configuration with SIMD level limited to what this machine supports
+KernelConfig sanitize(const KernelConfig& config)
+{
+    KernelConfig result = config;
+    if (!isSimdLevelSupported(result.simd)) {
+        result.simd = getMaxSimdLevel();
+    }
+    return result;
+}
+
+//---------------------------------------------------------------------------
+// Format conversion
+
+// Convert single YUV pixel to RGBA8 with the same integer math as DataStreamer
+inline void convertPixel(int Y, int U, int V, uint8_t* dst)
+{
+    const int C = Y - 16;
+    const int D = U - 128;
+    const int E = V - 128;
+    dst[0] = static_cast<uint8_t>(std::max(std::min((298 * C + 409 * E + 128) >> 8, 255), 0));
+    dst[1] = static_cast<uint8_t>(std::max(std::min((298 * C - 100 * D - 208 * E + 128) >> 8, 255), 0));
+    dst[2] = static_cast<uint8_t>(std::max(std::min((298 * C + 516 * D + 128) >> 8, 255), 0));
+    dst[3] = 255;
+}
+
+// Convert pixels [x0, x1) of one row. UV row holds interleaved U and V for each pixel pair, x0 must be even.
+template <typename V>
+void convertRow(const uint8_t* yRow, const uint8_t* uvRow, uint8_t* dst, int x0, int x1);
+
+template <>
+void convertRow<Simd::Scalar>(const uint8_t* yRow, const uint8_t* uvRow, uint8_t* dst, int x0, int x1)
+{
+    for (int x = x0; x < x1; x++) {
+        const int uvX = x - (x & 1);
+        convertPixel(yRow[x], uvRow[uvX + 0], uvRow[uvX + 1], dst + x * 4);
+    }
+}
+
+template <>
+void convertRow<Simd::SSE41>(const uint8_t* yRow, const uint8_t* uvRow, uint8_t* dst, int x0, int x1)
+{
+    const __m128i c16 = _mm_set1_epi32(16);
+    const __m128i c128 = _mm_set1_epi32(128);
+    const __m128i c255 = _mm_set1_epi32(255);
+    const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xff000000));
+    const __m128i zero = _mm_setzero_si128();
+
+    int x = x0;
+    for (; x + 4 <= x1; x += 4) {
+        int32_t yBits, uvBits;
+        memcpy(&yBits, yRow + x, sizeof(yBits));
+        memcpy(&uvBits, uvRow + x, sizeof(uvBits));
+
+        // Expand to 32-bit lanes and duplicate chroma for pixel pairs
+        const __m128i yv = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(yBits));
+        const __m128i uv = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(uvBits));
+        const __m128i c = _mm_mullo_epi32(_mm_sub_epi32(yv, c16), _mm_set1_epi32(298));
+        const __m128i d = _mm_sub_epi32(_mm_shuffle_epi32(uv, _MM_SHUFFLE(2, 2, 0, 0)), c128);
+        const __m128i e = _mm_sub_epi32(_mm_shuffle_epi32(uv, _MM_SHUFFLE(3, 3, 1, 1)), c128);
+
+        __m128i r = _mm_add_epi32(_mm_add_epi32(c, _mm_mullo_epi32(e, _mm_set1_epi32(409))), c128);
+        __m128i g = _mm_add_epi32(_mm_sub_epi32(_mm_sub_epi32(c, _mm_mullo_epi32(d, _mm_set1_epi32(100))), _mm_mullo_epi32(e, _mm_set1_epi32(208))), c128);
+        __m128i b = _mm_add_epi32(_mm_add_epi32(c, _mm_mullo_epi32(d, _mm_set1_epi32(516))), c128);
+        r = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(r, 8), zero), c255);
+        g = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(g, 8), zero), c255);
+        b = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(b, 8), zero), c255);
+
+        const __m128i px = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)), _mm_or_si128(_mm_slli_epi32(b, 16), alpha));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * 4), px);
+    }
+
+    convertRow<Simd::Scalar>(yRow, uvRow, dst, x, x1);
+}
+
+template <>
+void convertRow<Simd::AVX2>(const uint8_t* yRow, const uint8_t* uvRow, uint8_t* dst, int x0, int x1)
+{
+    const __m256i c16 = _mm256_set1_epi32(16);
+    const __m256i c128 = _mm256_set1_epi32(128);
+    const __m256i c255 = _mm256_set1_epi32(255);
+    const __m256i alpha = _mm256_set1_epi32(static_cast<int>(0xff000000));
+    const __m256i zero = _mm256_setzero_si256();
+
+    int x = x0;
+    for (; x + 8 <= x1; x += 8) {
+        // Expand to 32-bit lanes and duplicate chroma for pixel pairs. Shuffles work within
+        // 128-bit lanes which hold pixels 0-3 and 4-7 respectively.
+        const __m256i yv = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(yRow + x)));
+        const __m256i uv = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(uvRow + x)));
+        const __m256i c = _mm256_mullo_epi32(_mm256_sub_epi32(yv, c16), _mm256_set1_epi32(298));
+        const __m256i d = _mm256_sub_epi32(_mm256_shuffle_epi32(uv, _MM_SHUFFLE(2, 2, 0, 0)), c128);
+        const __m256i e = _mm256_sub_epi32(_mm256_shuffle_epi32(uv, _MM_SHUFFLE(3, 3, 1, 1)), c128);
+
+        __m256i r = _mm256_add_epi32(_mm256_add_epi32(c, _mm256_mullo_epi32(e, _mm256_set1_epi32(409))), c128);
+        __m256i g = _mm256_add_epi32(
+            _mm256_sub_epi32(_mm256_sub_epi32(c, _mm256_mullo_epi32(d, _mm256_set1_epi32(100))), _mm256_mullo_epi32(e, _mm256_set1_epi32(208))), c128);
+        __m256i b = _mm256_add_epi32(_mm256_add_epi32(c, _mm256_mullo_epi32(d, _mm256_set1_epi32(516))), c128);
+        r = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(r, 8), zero), c255);
+        g = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(g, 8), zero), c255);
+        b = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(b, 8), zero), c255);
+
+        const __m256i px = _mm256_or_si256(_mm256_or_si256(r, _mm256_slli_epi32(g, 8)), _mm256_or_si256(_mm256_slli_epi32(b, 16), alpha));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + x * 4), px);
+    }
+
+    convertRow<Simd::SSE41>(yRow, uvRow, dst, x, x1);
+}
+
+//---------------------------------------------------------------------------
+// Shared stages
+
+// Unpack c_width pixels starting at given source pixel to planes at given index
+template <typename V, typename T>
+inline void unpackPixels(const uint8_t* src, const Planes<T>& out, size_t index)
+{
+    typename V::Float r, g, b;
+    V::loadRGBA(src, r, g, b);
+    if (out.r) {
+        V::store(out.r + index, r);
+        V::store(out.g + index, g);
+        V::store(out.b + index, b);
+    }
+    if (out.luma) {
+        const auto luma = V::madd(r, V::set1(out.lumaWeights[0]), V::madd(g, V::set1(out.lumaWeights[1]), V::mul(b, V::set1(out.lumaWeights[2]))));
+        V::store(out.luma + index, luma);
+    }
+}
+
+// Unpack source region starting at (x0, y0) to float planes. Region may extend outside the image,
+// in which case coordinates are clamped to edges like the linear clamp sampler does.
+template <typename V, typename T>
+void unpackRegion(const SrcImage& src, int x0, int y0, int w, int h, const Planes<T>& out)
+{
+    // Interior span where vector loads stay inside the image
+    const int inBegin = std::min(std::max(0, -x0), w);
+    const int inEnd = std::max(inBegin, std::min(w, src.width - x0));
+
+    for (int j = 0; j < h; j++) {
+        const int sy = std::max(0, std::min(src.height - 1, y0 + j));
+        const size_t row = out.stride * j;
+
+        int i = 0;
+        for (; i < inBegin; i++) {
+            unpackPixels<Simd::Scalar>(src.pixel(0, sy), out, row + i);
+        }
+        for (; i + V::c_width <= inEnd; i += V::c_width) {
+            unpackPixels<V>(src.pixel(x0 + i, sy), out, row + i);
+        }
+        for (; i < w; i++) {
+            const int sx = std::max(0, std::min(src.width - 1, x0 + i));
+            unpackPixels<Simd::Scalar>(src.pixel(sx, sy), out, row + i);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+// Cartoon and sketch
+
+//! Arguments for Sobel effect pixels
+template <typename T>
+struct SobelArgs {
+    const SrcImage* src;  //!< Source image
+    const T* luma;        //!< Luma plane, element 0 is pixel (x0 - 1, y0 - 1)
+    size_t lumaStride;    //!< Luma row stride in elements
+    uint8_t* dst;         //!< Destination image
+    size_t dstStride;     //!< Destination row stride in bytes
+    int x0;               //!< Tile left
+    int y0;               //!< Tile top
+    int levels;           //!< Cartoon color levels
+    bool outline;         //!< Cartoon outline enabled
+    float edgeScale;      //!< Cartoon edge scale
+    float intensity;      //!< Sketch intensity
+};
+
+// Sobel kernels of getEdgeValue and getEdgeValue2 in vstPostProcess.hlsl
+using SobelX = Conv::Separable<Conv::Kernel1D<1, -1, 0, 1>, Conv::Kernel1D<1, 1, 2, 1>>;
+using SobelY = Conv::Separable<Conv::Kernel1D<1, 1, 2, 1>, Conv::Kernel1D<1, -1, 0, 1>>;
+
+// Cartoon effect for c_width pixels at (x, y)
+template <typename V, typename T>
+inline void cartoonPixels(const SobelArgs<T>& a, int x, int y)
+{
+    const T* l0 = a.luma + a.lumaStride * (y - a.y0) + (x - a.x0);
+    const auto gx = Conv::apply<SobelX, V>(l0, a.lumaStride);
+    const auto gy = Conv::apply<SobelY, V>(l0, a.lumaStride);
+
+    typename V::Float r, g, b;
+    V::loadRGBA(a.src->pixel(x, y), r, g, b);
+
+    const auto levels = V::set1(static_cast<float>(a.levels));
+    const auto invLevels = V::set1(1.0f / a.levels);
+    r = V::mul(V::round(V::mul(r, levels)), invLevels);
+    g = V::mul(V::round(V::mul(g, levels)), invLevels);
+    b = V::mul(V::round(V::mul(b, levels)), invLevels);
+
+    if (a.outline) {
+        const auto edge = V::mul(V::add(V::abs(gx), V::abs(gy)), V::set1(a.edgeScale));
+        const auto isEdge = V::cmpgt(edge, V::set1(c_outlineThreshold));
+        r = V::select(isEdge, V::zero(), r);
+        g = V::select(isEdge, V::zero(), g);
+        b = V::select(isEdge, V::zero(), b);
+    }
+
+    V::storeRGBA(a.dst + a.dstStride * y + static_cast<size_t>(x) * 4, r, g, b);
+}
+
+// Sketch effect for c_width pixels at (x, y)
+template <typename V, typename T>
+inline void sketchPixels(const SobelArgs<T>& a, int x, int y)
+{
+    const T* l0 = a.luma + a.lumaStride * (y - a.y0) + (x - a.x0);
+    const auto gx = Conv::apply<SobelX, V>(l0, a.lumaStride);
+    const auto gy = Conv::apply<SobelY, V>(l0, a.lumaStride);
+
+    const auto magnitude = V::sqrt(V::madd(gx, gx, V::mul(gy, gy)));
+    const auto value = V::mul(V::sub(V::set1(1.0f), magnitude), V::set1(a.intensity));
+    V::storeRGBA(a.dst + a.dstStride * y + static_cast<size_t>(x) * 4, value, value, value);
+}
+
+// Run Sobel effect over tile [x0, x1) x [y0, y1)
+template <typename V, typename T>
+void sobelTile(const SobelArgs<T>& a, bool sketch, int x1, int y1)
+{
+    for (int y = a.y0; y < y1; y++) {
+        int x = a.x0;
+        if (sketch) {
+            for (; x + V::c_width <= x1; x += V::c_width) {
+                sketchPixels<V>(a, x, y);
+            }
+            for (; x < x1; x++) {
+                sketchPixels<Simd::Scalar>(a, x, y);
+            }
+        } else {
+            for (; x + V::c_width <= x1; x += V::c_width) {
+                cartoonPixels<V>(a, x, y);
+            }
+            for (; x < x1; x++) {
+                cartoonPixels<Simd::Scalar>(a, x, y);
+            }
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+// Watercolor (Kuwahara filter)
+//
+// For radius r each output pixel picks the mean of the (r + 1) x (r + 1) quadrant with the lowest
+// color variance. Quadrant sums are box sums anchored at four positions, so box sums of RGB and
+// squared RGB are computed once. Vertical sums use sliding windows making the cost independent of
+// radius. Horizontal sums use unrolled SIMD box kernels up to the radius range of the shader UI and
+// scalar sliding windows beyond that.
+
+// Largest quadrant size using unrolled box kernels
+constexpr int c_maxUnrolledBox = 16;
+
+// Call function with quadrant size as std::integral_constant if it is at most Size. Returns false otherwise.
+template <int Size>
+struct BoxDispatch {
+    template <typename F>
+    static bool call(int size, F&& func)
+    {
+        if (size == Size) {
+            func(std::integral_constant<int, Size>());
+            return true;
+        }
+        return BoxDispatch<Size - 1>::call(size, func);
+    }
+};
+
+template <>
+struct BoxDispatch<0> {
+    template <typename F>
+    static bool call(int, F&&)
+    {
+        return false;
+    }
+};
+
+// Vertical box sums. For anchor row i and column x, sums[c][i][x] holds the sum of rows i..i+r of
+// the source planes (c < 3) or their squares (c >= 3).
+template <typename V, typename P, typename S>
+void verticalSums(const P* const planes[3], size_t planeStride, int cols, int anchorRows, int radius, S* const sums[c_sumPlanes], size_t sumStride)
+{
+    const int vecCols = cols - cols % V::c_width;
+
+    for (int c = 0; c < 3; c++) {
+        const P* p = planes[c];
+        S* s = sums[c];
+        S* s2 = sums[c + 3];
+
+        // Initial window
+        for (int x = 0; x < vecCols; x += V::c_width) {
+            auto acc = V::zero();
+            auto acc2 = V::zero();
+            for (int k = 0; k <= radius; k++) {
+                const auto v = V::load(p + planeStride * k + x);
+                acc = V::add(acc, v);
+                acc2 = V::madd(v, v, acc2);
+            }
+            V::store(s + x, acc);
+            V::store(s2 + x, acc2);
+        }
+        for (int x = vecCols; x < cols; x++) {
+            float acc = 0.0f;
+            float acc2 = 0.0f;
+            for (int k = 0; k <= radius; k++) {
+                const float v = Simd::Scalar::load(p + planeStride * k + x);
+                acc += v;
+                acc2 += v * v;
+            }
+            Simd::Scalar::store(s + x, acc);
+            Simd::Scalar::store(s2 + x, acc2);
+        }
+
+        // Slide window down
+        for (int i = 1; i < anchorRows; i++) {
+            const P* outRow = p + planeStride * (i - 1);
+            const P* inRow = p + planeStride * (i + radius);
+            const S* prev = s + sumStride * (i - 1);
+            const S* prev2 = s2 + sumStride * (i - 1);
+            S* cur = s + sumStride * i;
+            S* cur2 = s2 + sumStride * i;
+
+            for (int x = 0; x < vecCols; x += V::c_width) {
+                const auto vOut = V::load(outRow + x);
+                const auto vIn = V::load(inRow + x);
+                V::store(cur + x, V::add(V::load(prev + x), V::sub(vIn, vOut)));
+                V::store(cur2 + x, V::add(V::load(prev2 + x), V::sub(V::mul(vIn, vIn), V::mul(vOut, vOut))));
+            }
+            for (int x = vecCols; x < cols; x++) {
+                const float vOut = Simd::Scalar::load(outRow + x);
+                const float vIn = Simd::Scalar::load(inRow + x);
+                Simd::Scalar::store(cur + x, Simd::Scalar::load(prev + x) + vIn - vOut);
+                Simd::Scalar::store(cur2 + x, Simd::Scalar::load(prev2 + x) + vIn * vIn - vOut * vOut);
+            }
+        }
+    }
+}
+
+// Horizontal box sums of vertical sums. For anchor column j, box[c][i][j] holds the sum of
+// columns j..j+r of sums[c][i].
+template <typename V, typename S, typename B>
+void horizontalSums(const S* const sums[c_sumPlanes], size_t sumStride, int rows, int anchorCols, int radius, B* const box[c_sumPlanes], size_t boxStride)
+{
+    const bool unrolled = BoxDispatch<c_maxUnrolledBox>::call(radius + 1, [&](auto size) {
+        using Box = Conv::BoxSum<decltype(size)::value, 1>;
+        for (int c = 0; c < c_sumPlanes; c++) {
+            Conv::convolveValid<Box, V>(sums[c], sumStride, 0, box[c], boxStride, 0, anchorCols, rows);
+        }
+    });
+    if (unrolled) {
+        return;
+    }
+
+    for (int c = 0; c < c_sumPlanes; c++) {
+        for (int i = 0; i < rows; i++) {
+            const S* s = sums[c] + sumStride * i;
+            B* out = box[c] + boxStride * i;
+
+            float acc = 0.0f;
+            for (int k = 0; k <= radius; k++) {
+                acc += Simd::Scalar::load(s + k);
+            }
+            Simd::Scalar::store(out, acc);
+            for (int j = 1; j < anchorCols; j++) {
+                acc += Simd::Scalar::load(s + j + radius) - Simd::Scalar::load(s + j - 1);
+                Simd::Scalar::store(out + j, acc);
+            }
+        }
+    }
+}
+
+// Pick lowest variance quadrant for c_width pixels. Box element (tx, ty) is anchored at (x - r, y - r).
+template <typename V, typename B>
+inline void kuwaharaPixels(const B* const box[c_sumPlanes], size_t boxStride, int radius, float invN, int tx, int ty, uint8_t* dst)
+{
+    const size_t offsets[4] = {
+        boxStride * ty + tx,
+        boxStride * (ty + radius) + tx,
+        boxStride * (ty + radius) + tx + radius,
+        boxStride * ty + tx + radius,
+    };
+
+    const auto n = V::set1(invN);
+    auto minSigma = V::set1(100.0f);
+    auto outR = V::zero();
+    auto outG = V::zero();
+    auto outB = V::zero();
+
+    for (int q = 0; q < 4; q++) {
+        const size_t o = offsets[q];
+        const auto meanR = V::mul(V::load(box[0] + o), n);
+        const auto meanG = V::mul(V::load(box[1] + o), n);
+        const auto meanB = V::mul(V::load(box[2] + o), n);
+        const auto varR = V::abs(V::sub(V::mul(V::load(box[3] + o), n), V::mul(meanR, meanR)));
+        const auto varG = V::abs(V::sub(V::mul(V::load(box[4] + o), n), V::mul(meanG, meanG)));
+        const auto varB = V::abs(V::sub(V::mul(V::load(box[5] + o), n), V::mul(meanB, meanB)));
+        const auto sigma = V::add(V::add(varR, varG), varB);
+
+        const auto better = V::cmplt(sigma, minSigma);
+        minSigma = V::select(better, sigma, minSigma);
+        outR = V::select(better, meanR, outR);
+        outG = V::select(better, meanG, outG);
+        outB = V::select(better, meanB, outB);
+    }
+
+    V::storeRGBA(dst, outR, outG, outB);
+}
+
+// Run quadrant selection over w x h tile
+template <typename V, typename B>
+void kuwaharaTile(const B* const box[c_sumPlanes], size_t boxStride, int radius, int w, int h, uint8_t* dst, size_t dstStride)
+{
+    const float invN = 1.0f / ((radius + 1) * (radius + 1));
+    for (int ty = 0; ty < h; ty++) {
+        uint8_t* row = dst + dstStride * ty;
+        int tx = 0;
+        for (; tx + V::c_width <= w; tx += V::c_width) {
+            kuwaharaPixels<V>(box, boxStride, radius, invN, tx, ty, row + tx * 4);
+        }
+        for (; tx < w; tx++) {
+            kuwaharaPixels<Simd::Scalar>(box, boxStride, radius, invN, tx, ty, row + tx * 4);
+        }
+    }
+}
+
+//---------------------------------------------------------------------------
+// Oil paint (constant time median filter)
+
+// Perreault and Hebert, "Median Filtering in Constant Time". Each image column keeps a histogram of
+// the 2r + 1 source rows around the current row, updated with one removal and one addition per row.
+// The kernel histogram is the sum of 2r + 1 column histograms, updated with one column removal and
+// one column addition per pixel. Histograms have 16 coarse bins for the high nibble followed by 256
+// fine bins, and only the fine bins under the coarse bin holding the median are brought up to date,
+// so cost per pixel does not depend on radius.
+
+// Number of coarse and fine histogram bins
+constexpr int c_coarseBins = 16;
+constexpr int c_fineBins = 256;
+
+// Histogram size in bins: coarse bins followed by fine bins
+constexpr int c_histogramBins = c_coarseBins + c_fineBins;
+
+// Add 16 histogram bins of src to dst
+template <typename V>
+void addBins(uint16_t* dst, const uint16_t* src);
+
+// Subtract 16 histogram bins of src from dst
+template <typename V>
+void subBins(uint16_t* dst, const uint16_t* src);
+
+template <>
+void addBins<Simd::Scalar>(uint16_t* dst, const uint16_t* src)
+{
+    for (int i = 0; i < 16; i++) {
+        dst[i] = static_cast<uint16_t>(dst[i] + src[i]);
+    }
+}
+
+template <>
+void subBins<Simd::Scalar>(uint16_t* dst, const uint16_t* src)
+{
+    for (int i = 0; i < 16; i++) {
+        dst[i] = static_cast<uint16_t>(dst[i] - src[i]);
+    }
+}
+
+template <>
+void addBins<Simd::SSE41>(uint16_t* dst, const uint16_t* src)
+{
+    __m128i* d = reinterpret_cast<__m128i*>(dst);
+    const __m128i* s = reinterpret_cast<const __m128i*>(src);
+    _mm_storeu_si128(d, _mm_add_epi16(_mm_loadu_si128(d), _mm_loadu_si128(s)));
+    _mm_storeu_si128(d + 1, _mm_add_epi16(_mm_loadu_si128(d + 1), _mm_loadu_si128(s + 1)));
+}
+
+template <>
+void subBins<Simd::SSE41>(uint16_t* dst, const uint16_t* src)
+{
+    __m128i* d = reinterpret_cast<__m128i*>(dst);
+    const __m128i* s = reinterpret_cast<const __m128i*>(src);
+    _mm_storeu_si128(d, _mm_sub_epi16(_mm_loadu_si128(d), _mm_loadu_si128(s)));
+    _mm_storeu_si128(d + 1, _mm_sub_epi16(_mm_loadu_si128(d + 1), _mm_loadu_si128(s + 1)));
+}
+
+template <>
+void addBins<Simd::AVX2>(uint16_t* dst, const uint16_t* src)
+{
+    __m256i* d = reinterpret_cast<__m256i*>(dst);
+    const __m256i* s = reinterpret_cast<const __m256i*>(src);
+    _mm256_storeu_si256(d, _mm256_add_epi16(_mm256_loadu_si256(d), _mm256_loadu_si256(s)));
+}
+
+template <>
+void subBins<Simd::AVX2>(uint16_t* dst, const uint16_t* src)
+{
+    __m256i* d = reinterpret_cast<__m256i*>(dst);
+    const __m256i* s = reinterpret_cast<const __m256i*>(src);
+    _mm256_storeu_si256(d, _mm256_sub_epi16(_mm256_loadu_si256(d), _mm256_loadu_si256(s)));
+}
+
+// Median filter one channel of rows [y0, y1). Columns holds one histogram per image column and
+// kernel one histogram for the sliding window. Coordinates outside the image are clamped to edges.
+template <typename V>
+void medianBand(const SrcImage& src, int channel, int radius, int y0, int y1, uint16_t* columns, uint16_t* kernel, uint8_t* dst, size_t dstStride)
+{
+    const int w = src.width;
+    const int h = src.height;
+    const int diameter = 2 * radius + 1;
+    const int rank = diameter * diameter / 2;
+    const auto clampY = [h](int y) { return std::max(0, std::min(h - 1, y)); };
+    const auto column = [columns, w](int x) { return columns + static_cast<size_t>(std::max(0, std::min(w - 1, x))) * c_histogramBins; };
+
+    // Column histograms of rows around first row
+    std::memset(columns, 0, sizeof(uint16_t) * c_histogramBins * w);
+    for (int i = -radius; i <= radius; i++) {
+        const uint8_t* row = src.pixel(0, clampY(y0 + i)) + channel;
+        for (int x = 0; x < w; x++) {
+            uint16_t* hist = columns + static_cast<size_t>(x) * c_histogramBins;
+            const int v = row[x * 4];
+            hist[v >> 4]++;
+            hist[c_coarseBins + v]++;
+        }
+    }
+
+    uint16_t* coarse = kernel;
+    uint16_t* fine = kernel + c_coarseBins;
+    int fineX[c_coarseBins];
+
+    for (int y = y0; y < y1; y++) {
+        if (y > y0) {
+            // Slide column histograms down one row
+            const uint8_t* oldRow = src.pixel(0, clampY(y - radius - 1)) + channel;
+            const uint8_t* newRow = src.pixel(0, clampY(y + radius)) + channel;
+            for (int x = 0; x < w; x++) {
+                uint16_t* hist = columns + static_cast<size_t>(x) * c_histogramBins;
+                const int oldV = oldRow[x * 4];
+                const int newV = newRow[x * 4];
+                hist[oldV >> 4]--;
+                hist[c_coarseBins + oldV]--;
+                hist[newV >> 4]++;
+                hist[c_coarseBins + newV]++;
+            }
+        }
+
+        // Coarse kernel histogram at first pixel. Fine bins are marked stale and rebuilt on demand.
+        std::memset(coarse, 0, sizeof(uint16_t) * c_coarseBins);
+        for (int i = -radius; i <= radius; i++) {
+            addBins<V>(coarse, column(i));
+        }
+        std::fill(fineX, fineX + c_coarseBins, -diameter);
+
+        uint8_t* out = dst + dstStride * y + channel;
+        for (int x = 0; x < w; x++) {
+            if (x > 0) {
+                subBins<V>(coarse, column(x - radius - 1));
+                addBins<V>(coarse, column(x + radius));
+            }
+
+            // Coarse bin holding median
+            int b = 0;
+            int count = 0;
+            while (count + coarse[b] <= rank) {
+                count += coarse[b++];
+            }
+
+            // Bring its fine bins up to date, rebuilding them if that is cheaper than sliding
+            uint16_t* segment = fine + b * 16;
+            const int offset = c_coarseBins + b * 16;
+            if (x - fineX[b] >= diameter) {
+                std::memset(segment, 0, sizeof(uint16_t) * 16);
+                for (int i = x - radius; i <= x + radius; i++) {
+                    addBins<V>(segment, column(i) + offset);
+                }
+            } else {
+                for (int i = fineX[b] + 1; i <= x; i++) {
+                    subBins<V>(segment, column(i - radius - 1) + offset);
+                    addBins<V>(segment, column(i + radius) + offset);
+                }
+            }
+            fineX[b] = x;
+
+            int v = 0;
+            while (count + segment[v] <= rank) {
+                count += segment[v++];
+            }
+            out[x * 4] = static_cast<uint8_t>(b * 16 + v);
+        }
+    }
+}
+
+}  // namespace
+
+namespace VarjoExamples
+{
+CpuStylizer::CpuStylizer(ThreadPool& threadPool)
+    : m_threadPool(threadPool)
+{
+}
+
+void CpuStylizer::setProfile(const KernelProfile& profile)
+{
+    std::lock_guard<std::mutex> lock(m_profileMutex);
+    m_profile = profile;
+}
+
+KernelConfig CpuStylizer::getKernelConfig(Kernel kernel, int width, int height) const
+{
+    KernelConfig config;
+    config.simd = hasSimdVariants(kernel) ? getMaxSimdLevel() : SimdLevel::Scalar;
+
+    std::lock_guard<std::mutex> lock(m_profileMutex);
+    m_profile.findConfig(getKernelName(kernel), width, height, config);
+    return config;
+}
+
+const char* CpuStylizer::getKernelName(Kernel kernel)
+{
+    switch (kernel) {
+        case Kernel::ConvertYUV422: return "convertYUV422";
+        case Kernel::ConvertNV12: return "convertNV12";
+        case Kernel::Cartoon: return "cartoon";
+        case Kernel::Watercolor: return "watercolor";
+        case Kernel::Sketch: return "sketch";
+        case Kernel::Pointilism: return "pointilism";
+        case Kernel::OilPaint: return "oilPaint";
+        default: return "unknown";
+    }
+}
+
+const char* CpuStylizer::getIntermediateName(Intermediate intermediate)
+{
+    switch (intermediate) {
+        case Intermediate::Luma: return "luma";
+        case Intermediate::WatercolorPlanes: return "watercolorPlanes";
+        case Intermediate::WatercolorSums: return "watercolorSums";
+        case Intermediate::WatercolorBoxes: return "watercolorBoxes";
+        default: return "unknown";
+    }
+}
+
+bool CpuStylizer::isMultiStage(Kernel kernel) { return kernel == Kernel::Cartoon || kernel == Kernel::Watercolor || kernel == Kernel::Sketch; }
+
+bool CpuStylizer::hasSimdVariants(Kernel kernel) { return kernel != Kernel::Pointilism; }
+
+bool CpuStylizer::isBanded(Kernel kernel) { return kernel == Kernel::OilPaint; }
+
+CpuStylizer::Kernel CpuStylizer::getEffectKernel(const Params& params)
+{
+    // Same precedence as in post process shader where later effects overwrite earlier ones
+    if (params.pointilismStep > 0.0f) {
+        return Kernel::Pointilism;
+    }
+    if (params.sketchIntensity > 0.0f) {
+        return Kernel::Sketch;
+    }
+    if (params.oilPaintRadius > 0) {
+        return Kernel::OilPaint;
+    }
+    if (params.watercolorRadius > 0) {
+        return Kernel::Watercolor;
+    }
+    if (params.clusterSize > 0) {
+        return Kernel::Cartoon;
+    }
+    return Kernel::Count;
+}
+
+int CpuStylizer::getTaskCount(const KernelConfig& config) const
+{
+    const int maxTasks = m_threadPool.getThreadCount() + 1;
+    return (config.threads > 0) ? std::min(config.threads, maxTasks) : maxTasks;
+}
+
+float* CpuStylizer::getScratch(int task, size_t count)
+{
+    auto& scratch = m_scratch[task];
+    if (scratch.size() < count) {
+        scratch.resize(count);
+    }
+    return scratch.data();
+}
+
+uint16_t* CpuStylizer::getHistograms(int task, size_t count)
+{
+    auto& histograms = m_histograms[task];
+    if (histograms.size() < count) {
+        histograms.resize(count);
+    }
+    return histograms.data();
+}
+
+uint8_t* CpuStylizer::getScratchBytes(int task, size_t bytes) { return reinterpret_cast<uint8_t*>(getScratch(task, (bytes + 3) / sizeof(float))); }
+
+uint8_t* CpuStylizer::getFrameBuffer(size_t bytes)
+{
+    if (m_frameBuffer.size() < bytes) {
+        m_frameBuffer.resize(bytes);
+    }
+    return m_frameBuffer.data();
+}
+
+bool CpuStylizer::useHalf(const KernelConfig& config, Intermediate intermediate) const
+{
+    // Scalar variant converts in software, SIMD variants need F16C
+    if ((m_halfIntermediates & getIntermediateMask(intermediate)) == 0) {
+        return false;
+    }
+    return config.simd == SimdLevel::Scalar || CpuInfo::get().f16c;
+}
+
+void CpuStylizer::forEachTile(const KernelConfig& config, int width, int height, int tileAlignX, const TileFunc& func)
+{
+    if (width <= 0 || height <= 0) {
+        return;
+    }
+
+    int tileW = (config.tileWidth > 0) ? std::min(config.tileWidth, width) : width;
+    tileW = std::max(tileAlignX, tileW - tileW % tileAlignX);
+    const int tileH = std::max(1, std::min(config.tileHeight, height));
+    const int tilesX = (width + tileW - 1) / tileW;
+    const int tilesY = (height + tileH - 1) / tileH;
+    const int tileCount = tilesX * tilesY;
+    const int taskCount = std::min(getTaskCount(config), tileCount);
+
+    if (static_cast<int>(m_scratch.size()) < taskCount) {
+        m_scratch.resize(taskCount);
+        m_histograms.resize(taskCount);
+    }
+
+    // Each task pulls tiles until all are done, so task count limits the number of threads used
+    std::atomic<int> nextTile{0};
+    m_threadPool.parallelFor(taskCount, [&](int begin, int end) {
+        for (int task = begin; task < end; task++) {
+            for (int tile = nextTile++; tile < tileCount; tile = nextTile++) {
+                const int x0 = (tile % tilesX) * tileW;
+                const int y0 = (tile / tilesX) * tileH;
+                func(x0, y0, std::min(x0 + tileW, width), std::min(y0 + tileH, height), task);
+            }
+        }
+    });
+}
+
+bool CpuStylizer::convert(const varjo_BufferMetadata& buffer, const void* cpuData, std::vector<uint8_t>& outRGBA)
+{
+    if (cpuData == nullptr || buffer.type != varjo_BufferType_CPU) {
+        return false;
+    }
+
+    Kernel kernel;
+    switch (buffer.format) {
+        case varjo_TextureFormat_YUV422: kernel = Kernel::ConvertYUV422; break;
+        case varjo_TextureFormat_NV12: kernel = Kernel::ConvertNV12; break;
+        default: return false;
+    }
+
+    outRGBA.resize(static_cast<size_t>(buffer.width) * buffer.height * 4);
+    const uint8_t* yPlane = reinterpret_cast<const uint8_t*>(cpuData);
+    const uint8_t* uvPlane = yPlane + static_cast<size_t>(buffer.rowStride) * buffer.height;
+    runConvert(kernel, getKernelConfig(kernel, buffer.width, buffer.height), yPlane, uvPlane, buffer.rowStride, outRGBA.data(), buffer.width,
+        buffer.height);
+    return true;
+}
+
+void CpuStylizer::runConvert(
+    Kernel kernel, const KernelConfig& config, const uint8_t* yPlane, const uint8_t* uvPlane, size_t rowStride, uint8_t* dst, int width, int height)
+{
+    const KernelConfig cfg = sanitize(config);
+    const bool nv12 = (kernel == Kernel::ConvertNV12);
+
+    dispatchSimd(cfg.simd, [&](auto simd) {
+        using V = decltype(simd);
+        forEachTile(cfg, width, height, 2, [&](int x0, int y0, int x1, int y1, int) {
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* uvRow = uvPlane + rowStride * (nv12 ? (y >> 1) : y);
+                convertRow<V>(yPlane + rowStride * y, uvRow, dst + static_cast<size_t>(width) * 4 * y, x0, x1);
+            }
+        });
+    });
+}
+
+bool CpuStylizer::stylize(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, int width, int height, const Params& params)
+{
+    const Kernel kernel = getEffectKernel(params);
+    if (kernel == Kernel::Count) {
+        return false;
+    }
+
+    runEffect(kernel, getKernelConfig(kernel, width, height), src, srcStride, dst, dstStride, width, height, params);
+    return true;
+}
+
+void CpuStylizer::runEffect(Kernel kernel, const KernelConfig& config, const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride,
+    int width, int height, const Params& params)
+{
+    const KernelConfig cfg = sanitize(config);
+
+    // Buffers are only used while effect runs, so they can be released here
+    if (m_releaseRequested.exchange(false)) {
+        m_scratch.clear();
+        m_histograms.clear();
+        m_frameBuffer.clear();
+        m_frameBuffer.shrink_to_fit();
+    }
+
+    switch (kernel) {
+        case Kernel::Cartoon:
+        case Kernel::Sketch: {
+            runSobelEffect(kernel, cfg, src, srcStride, dst, dstStride, width, height, params);
+        } break;
+
+        case Kernel::Watercolor: {
+            runWatercolor(cfg, src, srcStride, dst, dstStride, width, height, params);
+        } break;
+
+        case Kernel::Pointilism: {
+            runPointilism(cfg, src, srcStride, dst, dstStride, width, height, params);
+        } break;
+
+        case Kernel::OilPaint: {
+            runOilPaint(cfg, src, srcStride, dst, dstStride, width, height, params);
+        } break;
+
+        default: {
+            LOGE("Not an effect kernel: %s", getKernelName(kernel));
+        } break;
+    }
+}
+
+void CpuStylizer::runSobelEffect(Kernel kernel, const KernelConfig& config, const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride,
+    int width, int height, const Params& params)
+{
+    const SrcImage image{src, srcStride, width, height};
+    const bool sketch = (kernel == Kernel::Sketch);
+
+    dispatchSimd(config.simd, [&](auto simd) {
+        using V = decltype(simd);
+
+        dispatchStorage(useHalf(config, Intermediate::Luma), [&](auto lumaTag) {
+            using L = decltype(lumaTag);
+
+            SobelArgs<L> args{};
+            args.src = &image;
+            args.dst = dst;
+            args.dstStride = dstStride;
+            args.levels = params.clusterSize;
+            args.outline = params.outlineIntensity > 0.0f;
+            args.edgeScale = 1.0f / (10.0f - 9.9f * params.outlineIntensity);
+            args.intensity = params.sketchIntensity;
+
+            Planes<L> planes;
+            planes.lumaWeights = sketch ? c_sketchLumaWeights : c_cartoonLumaWeights;
+
+            if (config.mode == ExecutionMode::Frame) {
+                // Stage 1: luma of whole frame with one pixel clamped border
+                const int lumaW = width + 2;
+                const int lumaH = height + 2;
+                const size_t bytes = static_cast<size_t>(lumaW) * lumaH * sizeof(L);
+                L* luma = reinterpret_cast<L*>(getFrameBuffer(bytes));
+                m_intermediateBytes = bytes;
+                forEachTile(config, lumaW, lumaH, 1, [&](int x0, int y0, int x1, int y1, int) {
+                    Planes<L> out = planes;
+                    out.luma = luma + static_cast<size_t>(lumaW) * y0 + x0;
+                    out.stride = lumaW;
+                    unpackRegion<V>(image, x0 - 1, y0 - 1, x1 - x0, y1 - y0, out);
+                });
+
+                // Stage 2: effect
+                forEachTile(config, width, height, 1, [&](int x0, int y0, int x1, int y1, int) {
+                    SobelArgs<L> a = args;
+                    a.luma = luma + static_cast<size_t>(lumaW) * y0 + x0;
+                    a.lumaStride = lumaW;
+                    a.x0 = x0;
+                    a.y0 = y0;
+                    sobelTile<V>(a, sketch, x1, y1);
+                });
+            } else {
+                // Luma of tile and its border in task local buffer
+                forEachTile(config, width, height, 1, [&](int x0, int y0, int x1, int y1, int task) {
+                    const int lumaW = x1 - x0 + 2;
+                    const int lumaH = y1 - y0 + 2;
+                    Planes<L> out = planes;
+                    out.luma = reinterpret_cast<L*>(getScratchBytes(task, static_cast<size_t>(lumaW) * lumaH * sizeof(L)));
+                    out.stride = lumaW;
+                    unpackRegion<V>(image, x0 - 1, y0 - 1, lumaW, lumaH, out);
+
+                    SobelArgs<L> a = args;
+                    a.luma = out.luma;
+                    a.lumaStride = lumaW;
+                    a.x0 = x0;
+                    a.y0 = y0;
+                    sobelTile<V>(a, sketch, x1, y1);
+                });
+            }
+        });
+    });
+}
+
+void CpuStylizer::runWatercolor(
+    const KernelConfig& config, const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, int width, int height, const Params& params)
+{
+    const SrcImage image{src, srcStride, width, height};
+    const int r = params.watercolorRadius;
+
+    // Storage of unpacked planes, vertical sums and box sums are selected separately
+    dispatchSimd(config.simd, [&](auto simd) {
+        dispatchStorage(useHalf(config, Intermediate::WatercolorPlanes), [&](auto planeTag) {
+            dispatchStorage(useHalf(config, Intermediate::WatercolorSums), [&](auto sumTag) {
+                dispatchStorage(useHalf(config, Intermediate::WatercolorBoxes), [&](auto boxTag) {
+                    using V = decltype(simd);
+                    using P = decltype(planeTag);
+                    using S = decltype(sumTag);
+                    using B = decltype(boxTag);
+
+                    // Buffer layout for padded plane, sum and box sizes in elements
+                    struct Layout {
+                        size_t planeBytes;
+                        size_t sumBytes;
+                        size_t boxBytes;
+                        size_t totalBytes;
+                    };
+                    auto getLayout = [](size_t planeSize, size_t sumSize, size_t boxSize) {
+                        Layout layout;
+                        layout.planeBytes = alignBuffer(planeSize * sizeof(P));
+                        layout.sumBytes = alignBuffer(sumSize * sizeof(S));
+                        layout.boxBytes = alignBuffer(boxSize * sizeof(B));
+                        layout.totalBytes = 3 * layout.planeBytes + c_sumPlanes * (layout.sumBytes + layout.boxBytes);
+                        return layout;
+                    };
+                    auto carve = [](uint8_t* buffer, const Layout& layout, P* planes[3], S* sums[c_sumPlanes], B* box[c_sumPlanes]) {
+                        for (int c = 0; c < 3; c++) {
+                            planes[c] = reinterpret_cast<P*>(buffer + c * layout.planeBytes);
+                        }
+                        uint8_t* sumBuffer = buffer + 3 * layout.planeBytes;
+                        uint8_t* boxBuffer = sumBuffer + c_sumPlanes * layout.sumBytes;
+                        for (int c = 0; c < c_sumPlanes; c++) {
+                            sums[c] = reinterpret_cast<S*>(sumBuffer + c * layout.sumBytes);
+                            box[c] = reinterpret_cast<B*>(boxBuffer + c * layout.boxBytes);
+                        }
+                    };
+
+                    if (config.mode == ExecutionMode::Frame) {
+                        // Whole frame planes: source with r pixel clamped border, vertical sums and box sums
+                        const int padW = width + 2 * r;
+                        const int padH = height + 2 * r;
+                        const int anchorW = width + r;
+                        const int anchorH = height + r;
+                        const Layout layout = getLayout(
+                            static_cast<size_t>(padW) * padH, static_cast<size_t>(padW) * anchorH, static_cast<size_t>(anchorW) * anchorH);
+                        m_intermediateBytes = layout.totalBytes;
+
+                        P* planes[3];
+                        S* sums[c_sumPlanes];
+                        B* box[c_sumPlanes];
+                        carve(getFrameBuffer(layout.totalBytes), layout, planes, sums, box);
+
+                        // Stage 1: unpack
+                        forEachTile(config, padW, padH, 1, [&](int x0, int y0, int x1, int y1, int) {
+                            Planes<P> out;
+                            const size_t offset = static_cast<size_t>(padW) * y0 + x0;
+                            out.r = planes[0] + offset;
+                            out.g = planes[1] + offset;
+                            out.b = planes[2] + offset;
+                            out.stride = padW;
+                            unpackRegion<V>(image, x0 - r, y0 - r, x1 - x0, y1 - y0, out);
+                        });
+
+                        // Stage 2: vertical sums
+                        forEachTile(config, padW, anchorH, 1, [&](int x0, int y0, int x1, int y1, int) {
+                            const size_t offset = static_cast<size_t>(padW) * y0 + x0;
+                            const P* const in[3] = {planes[0] + offset, planes[1] + offset, planes[2] + offset};
+                            S* out[c_sumPlanes];
+                            for (int c = 0; c < c_sumPlanes; c++) {
+                                out[c] = sums[c] + offset;
+                            }
+                            verticalSums<V>(in, padW, x1 - x0, y1 - y0, r, out, padW);
+                        });
+
+                        // Stage 3: horizontal sums
+                        forEachTile(config, anchorW, anchorH, 1, [&](int x0, int y0, int x1, int y1, int) {
+                            const S* in[c_sumPlanes];
+                            B* out[c_sumPlanes];
+                            for (int c = 0; c < c_sumPlanes; c++) {
+                                in[c] = sums[c] + static_cast<size_t>(padW) * y0 + x0;
+                                out[c] = box[c] + static_cast<size_t>(anchorW) * y0 + x0;
+                            }
+                            horizontalSums<V>(in, padW, y1 - y0, x1 - x0, r, out, anchorW);
+                        });
+
+                        // Stage 4: quadrant selection
+                        forEachTile(config, width, height, 1, [&](int x0, int y0, int x1, int y1, int) {
+                            const B* in[c_sumPlanes];
+                            for (int c = 0; c < c_sumPlanes; c++) {
+                                in[c] = box[c] + static_cast<size_t>(anchorW) * y0 + x0;
+                            }
+                            kuwaharaTile<V>(in, anchorW, r, x1 - x0, y1 - y0, dst + dstStride * y0 + static_cast<size_t>(x0) * 4, dstStride);
+                        });
+                    } else {
+                        // All stages per tile in task local buffers
+                        forEachTile(config, width, height, 1, [&](int x0, int y0, int x1, int y1, int task) {
+                            const int padW = x1 - x0 + 2 * r;
+                            const int padH = y1 - y0 + 2 * r;
+                            const int anchorW = x1 - x0 + r;
+                            const int anchorH = y1 - y0 + r;
+                            const Layout layout = getLayout(
+                                static_cast<size_t>(padW) * padH, static_cast<size_t>(padW) * anchorH, static_cast<size_t>(anchorW) * anchorH);
+
+                            P* planes[3];
+                            S* sums[c_sumPlanes];
+                            B* box[c_sumPlanes];
+                            carve(getScratchBytes(task, layout.totalBytes), layout, planes, sums, box);
+
+                            Planes<P> out;
+                            out.r = planes[0];
+                            out.g = planes[1];
+                            out.b = planes[2];
+                            out.stride = padW;
+                            unpackRegion<V>(image, x0 - r, y0 - r, padW, padH, out);
+
+                            const P* const in[3] = {planes[0], planes[1], planes[2]};
+                            verticalSums<V>(in, padW, padW, anchorH, r, sums, padW);
+                            horizontalSums<V>(sums, padW, anchorH, anchorW, r, box, anchorW);
+                            kuwaharaTile<V>(box, anchorW, r, x1 - x0, y1 - y0, dst + dstStride * y0 + static_cast<size_t>(x0) * 4, dstStride);
+                        });
+                    }
+                });
+            });
+        });
+    });
+}
+
+void CpuStylizer::runPointilism(
+    const KernelConfig& config, const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, int width, int height, const Params& params)
+{
+    const SrcImage image{src, srcStride, width, height};
+    const float step = params.pointilismStep;
+
+    // Dot lookups are data dependent gathers, so there is only a scalar variant
+    forEachTile(config, width, height, 1, [&](int x0, int y0, int x1, int y1, int task) {
+        // Column terms are shared by all rows of the tile
+        const int w = x1 - x0;
+        float* du = getScratch(task, 2 * static_cast<size_t>(w));
+        float* sx = du + w;
+        for (int x = x0; x < x1; x++) {
+            const float u = static_cast<float>(x) / width * step;
+            const float nearU = std::floor(u + 0.5f);
+            du[x - x0] = u - nearU;
+            sx[x - x0] = static_cast<float>(std::max(0, std::min(width - 1, static_cast<int>(nearU / step * width))));
+        }
+
+        for (int y = y0; y < y1; y++) {
+            const float v = static_cast<float>(y) / height * step;
+            const float nearV = std::floor(v + 0.5f);
+            const float dv2 = (v - nearV) * (v - nearV);
+            const int sy = std::max(0, std::min(height - 1, static_cast<int>(nearV / step * height)));
+            uint8_t* row = dst + dstStride * y;
+
+            for (int i = 0; i < w; i++) {
+                float r, g, b;
+                Simd::Scalar::loadRGBA(image.pixel(static_cast<int>(sx[i]), sy), r, g, b);
+                const float colorMax = std::max(std::max(r, b), g);
+                const float colorMin = std::min(std::min(r, b), g);
+                const float threshold = std::max((colorMin + colorMax) * 0.5f, params.pointilismThreshold);
+
+                if (du[i] * du[i] + dv2 >= threshold * threshold) {
+                    r = c_paperColor[0];
+                    g = c_paperColor[1];
+                    b = c_paperColor[2];
+                }
+                Simd::Scalar::storeRGBA(row + (x0 + i) * 4, r, g, b);
+            }
+        }
+    });
+}
+
+void CpuStylizer::runOilPaint(
+    const KernelConfig& config, const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, int width, int height, const Params& params)
+{
+    const SrcImage image{src, srcStride, width, height};
+    const int r = std::max(0, std::min(params.oilPaintRadius, c_maxOilPaintRadius));
+
+    // Column histograms are built once per band and slid down from there, so each task gets one
+    // full width row band regardless of tile configuration
+    const int taskCount = getTaskCount(config);
+    KernelConfig bandConfig = config;
+    bandConfig.tileWidth = 0;
+    bandConfig.tileHeight = (height + taskCount - 1) / taskCount;
+
+    dispatchSimd(config.simd, [&](auto simd) {
+        using V = decltype(simd);
+        forEachTile(bandConfig, width, height, 1, [&](int, int y0, int, int y1, int task) {
+            uint16_t* columns = getHistograms(task, static_cast<size_t>(width + 1) * c_histogramBins);
+            uint16_t* kernel = columns + static_cast<size_t>(width) * c_histogramBins;
+            for (int c = 0; c < 3; c++) {
+                medianBand<V>(image, c, r, y0, y1, columns, kernel, dst, dstStride);
+            }
+            for (int y = y0; y < y1; y++) {
+                uint8_t* row = dst + dstStride * y;
+                for (int x = 0; x < width; x++) {
+                    row[x * 4 + 3] = 255;
+                }
+            }
+        });
+    });
+}
+
+}  // namespace VarjoExamples
@@ -0,0 +1,185 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
+#include <Varjo_datastream.h>
+
+#include "Globals.hpp"
+#include "ThreadPool.hpp"
+#include "KernelConfig.hpp"
+#include "KernelProfile.hpp"
+#include "MemoryAccounting.hpp"
+
+namespace VarjoExamples
+{
+//! CPU implementation of the video post process stylization effects (see vstPostProcess.hlsl) and
+//! camera format conversion kernels. Each kernel has scalar, SSE and AVX2 variants and runs tile
+//! parallel on given thread pool using configuration selected from a kernel tuning profile.
+//!
+//! NOTICE! Not thread safe. Only one kernel may run at a time on one instance.
+class CpuStylizer
+{
+public:
+    //! Tunable kernels
+    enum class Kernel {
+        ConvertYUV422 = 0,  //!< YUV422 camera buffer to RGBA8
+        ConvertNV12,        //!< NV12 camera buffer to RGBA8
+        Cartoon,            //!< Color quantization with Sobel outlines
+        Watercolor,         //!< Kuwahara filter
+        Sketch,             //!< Inverted Sobel magnitude
+        Pointilism,         //!< Dot grid
+        OilPaint,           //!< Constant time median filter
+        Count
+    };
+
+    //! Effect parameters. Same semantics as post process shader constants, zero disables effect.
+    struct Params {
+        int clusterSize = 0;               //!< Cartoon color levels
+        float outlineIntensity = 0.0f;     //!< Cartoon outline intensity
+        int watercolorRadius = 0;          //!< Watercolor filter radius
+        float sketchIntensity = 0.0f;      //!< Sketch intensity
+        float pointilismStep = 0.0f;       //!< Pointilism dot grid frequency
+        float pointilismThreshold = 0.0f;  //!< Pointilism minimum dot radius
+        int oilPaintRadius = 0;            //!< Oil paint median filter radius. CPU only, no shader counterpart.
+    };
+
+    //! Whole frame intermediate buffers of multi stage kernels that can be stored as FP16
+    enum class Intermediate {
+        Luma = 0,          //!< Cartoon and sketch luma plane
+        WatercolorPlanes,  //!< Watercolor RGB planes
+        WatercolorSums,    //!< Watercolor vertical sums of RGB and squared RGB
+        WatercolorBoxes,   //!< Watercolor quadrant box sums of RGB and squared RGB
+        Count
+    };
+
+    //! Maximum oil paint radius. Window pixel counts must fit in 16-bit histogram bins.
+    static constexpr int c_maxOilPaintRadius = 64;
+
+    //! Construct stylizer running kernels on given thread pool
+    CpuStylizer(ThreadPool& threadPool);
+
+    // Disable copy, move and assign
+    CpuStylizer(const CpuStylizer& other) = delete;
+    CpuStylizer(const CpuStylizer&& other) = delete;
+    CpuStylizer& operator=(const CpuStylizer& other) = delete;
+    CpuStylizer& operator=(const CpuStylizer&& other) = delete;
+
+    //! Set kernel tuning profile used for selecting kernel configurations. Can be called from any thread.
+    void setProfile(const KernelProfile& profile);
+
+    //! Returns configuration used for kernel at given resolution
+    KernelConfig getKernelConfig(Kernel kernel, int width, int height) const;
+
+    //! Set intermediates stored as FP16 as mask of getIntermediateMask() bits. Can be called from any thread.
+    //!
+    //! NOTICE! FP16 storage halves the memory traffic of intermediates, all arithmetic stays float32.
+    //! Values in [0, 1] keep 11 significant bits, so luma and watercolor planes are visually exact.
+    //! Watercolor variance is a difference of sums and loses precision with FP16 sums, which makes
+    //! near-tie quadrant picks flip. Needs F16C for SIMD variants, ignored on machines without it.
+    void setHalfIntermediates(uint32_t mask) { m_halfIntermediates = mask; }
+
+    //! Returns mask of intermediates stored as FP16
+    uint32_t getHalfIntermediates() const { return m_halfIntermediates; }
+
+    //! Returns whole frame intermediate buffer size of last frame mode run in bytes
+    size_t getIntermediateBytes() const { return m_intermediateBytes; }
+
+    //! Request releasing scratch and intermediate buffers. Buffers are freed when next effect runs, so
+    //! this can be called from any thread. Use for shedding memory, e.g. together with FP16 intermediates.
+    void releaseBuffers() { m_releaseRequested = true; }
+
+    //! Convert YUV422 or NV12 camera buffer to tightly packed RGBA8. Returns false for other formats.
+    bool convert(const varjo_BufferMetadata& buffer, const void* cpuData, std::vector<uint8_t>& outRGBA);
+
+    //! Apply stylization effect to RGBA8 image. Like the shader, the last enabled effect wins.
+    //! Returns false if no effect is enabled and nothing was written.
+    bool stylize(const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, int width, int height, const Params& params);
+
+    //! Run single effect kernel with explicit configuration
+    void runEffect(Kernel kernel, const KernelConfig& config, const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, int width,
+        int height, const Params& params);
+
+    //! Run single conversion kernel with explicit configuration. Output must hold width * height RGBA8 pixels.
+    void runConvert(Kernel kernel, const KernelConfig& config, const uint8_t* yPlane, const uint8_t* uvPlane, size_t rowStride, uint8_t* dst,
+        int width, int height);
+
+    //! Returns effect kernel enabled by params, or Kernel::Count if none
+    static Kernel getEffectKernel(const Params& params);
+
+    //! Returns kernel name used in tuning profiles
+    static const char* getKernelName(Kernel kernel);
+
+    //! Returns true if kernel has more than one stage and supports streaming execution
+    static bool isMultiStage(Kernel kernel);
+
+    //! Returns true if kernel has SIMD variants
+    static bool hasSimdVariants(Kernel kernel);
+
+    //! Returns true if kernel runs one row band per task and ignores tile size
+    static bool isBanded(Kernel kernel);
+
+    //! Returns mask bit of intermediate
+    static uint32_t getIntermediateMask(Intermediate intermediate) { return 1u << static_cast<int>(intermediate); }
+
+    //! Returns name of intermediate
+    static const char* getIntermediateName(Intermediate intermediate);
+
+private:
+    //! Tile function called with tile rectangle and task index
+    using TileFunc = std::function<void(int x0, int y0, int x1, int y1, int task)>;
+
+    //! Run tile function over image area with given configuration. Tile widths are multiples of given alignment.
+    void forEachTile(const KernelConfig& config, int width, int height, int tileAlignX, const TileFunc& func);
+
+    //! Returns number of parallel tasks for configuration
+    int getTaskCount(const KernelConfig& config) const;
+
+    //! Returns task local scratch buffer with at least given number of floats
+    float* getScratch(int task, size_t count);
+
+    //! Returns task local scratch buffer with at least given number of bytes
+    uint8_t* getScratchBytes(int task, size_t bytes);
+
+    //! Returns whole frame intermediate buffer with at least given number of bytes
+    uint8_t* getFrameBuffer(size_t bytes);
+
+    //! Returns true if intermediate is stored as FP16 when running with given configuration
+    bool useHalf(const KernelConfig& config, Intermediate intermediate) const;
+
+    //! Returns task local histogram buffer with at least given number of bins
+    uint16_t* getHistograms(int task, size_t count);
+
+    //! Run Sobel based effect (cartoon or sketch)
+    void runSobelEffect(Kernel kernel, const KernelConfig& config, const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, int width,
+        int height, const Params& params);
+
+    //! Run watercolor effect
+    void runWatercolor(const KernelConfig& config, const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, int width, int height,
+        const Params& params);
+
+    //! Run pointilism effect
+    void runPointilism(const KernelConfig& config, const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, int width, int height,
+        const Params& params);
+
+    //! Run oil paint effect
+    void runOilPaint(const KernelConfig& config, const uint8_t* src, size_t srcStride, uint8_t* dst, size_t dstStride, int width, int height,
+        const Params& params);
+
+private:
+    ThreadPool& m_threadPool;                                                   //!< Worker threads
+    mutable std::mutex m_profileMutex;                                          //!< Profile access mutex
+    KernelProfile m_profile;                                                    //!< Kernel tuning profile
+    std::vector<TrackedVector<float, MemoryTag::Stylization>> m_scratch;        //!< Task local scratch buffers
+    std::vector<TrackedVector<uint16_t, MemoryTag::Stylization>> m_histograms;  //!< Task local histogram buffers
+    TrackedVector<uint8_t, MemoryTag::Stylization> m_frameBuffer;               //!< Whole frame intermediate buffer for frame mode
+    std::atomic<uint32_t> m_halfIntermediates{0};                               //!< Mask of intermediates stored as FP16
+    size_t m_intermediateBytes = 0;                                             //!< Whole frame intermediate bytes of last frame mode run
+    std::atomic<bool> m_releaseRequested{false};                                //!< Release buffers before next effect run
+};
+
+}  // namespace VarjoExamples
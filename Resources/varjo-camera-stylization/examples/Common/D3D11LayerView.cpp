@@ -14,8 +14,8 @@ D3D11LayerView::D3D11LayerView(varjo_Session* session, D3D11Renderer& renderer)
     colorConfig.numberOfTextures = 4;
     colorConfig.textureArraySize = 1;
     colorConfig.textureFormat = varjo_TextureFormat_R8G8B8A8_SRGB;
-    colorConfig.textureWidth = getTotalWidth(m_viewports);
-    colorConfig.textureHeight = getTotalHeight(m_viewports);
+    colorConfig.textureWidth = getTotalWidth(m_fullViewports);
+    colorConfig.textureHeight = getTotalHeight(m_fullViewports);
 
     m_colorSwapChain = varjo_D3D11CreateSwapChain(getSession(), renderer.getD3DDevice(), &colorConfig);
     CHECK_VARJO_ERR(getSession());
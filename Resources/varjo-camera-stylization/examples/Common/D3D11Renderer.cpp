@@ -126,6 +126,7 @@ D3D11Renderer::Texture loadTextureFromMemory(ID3D11Device* device, ID3D11DeviceC
         initialData.pSysMem = pixelData.data();
         initialData.SysMemPitch = width * 4;
         CHECK_HRESULT(device->CreateTexture2D(&textureDesc, &initialData, &texture.texture));
+        texture.setMemoryBytes(static_cast<size_t>(width) * height * 4);
 
         D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc{};
         srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
@@ -345,6 +346,9 @@ std::unique_ptr<Renderer::Texture> D3D11Renderer::createHdrCubemap(int32_t resol
     textureDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
     CHECK_HRESULT(m_device->CreateTexture2D(&textureDesc, nullptr, &texture->stagingTexture));
 
+    // Six RGBA16F faces, for both texture and staging texture
+    texture->setMemoryBytes(static_cast<size_t>(resolution) * resolution * 6 * 8 * 2);
+
     // Create sampler state
     D3D11_SAMPLER_DESC samplerDescr = {};
     samplerDescr.Filter = D3D11_FILTER_MIN_MAG_MIP_LINEAR;
@@ -34,6 +34,13 @@ void saveBMP(const std::string& filename, const varjo_BufferMetadata& buffer, vo
 {
     LOGD("Saving buffer to file: %s", filename.c_str());
 
+    // Convert to top-down RGBA8, BMP rows are written bottom-up in BGRA byte order below
+    std::vector<uint8_t> rgba;
+    if (!VarjoExamples::DataStreamer::convertToRGBA(buffer, cpuData, rgba)) {
+        CRITICAL("Unsupported pixel format: %d", static_cast<int>(buffer.format));
+        return;
+    }
+
     std::ofstream outFile(filename, std::ofstream::binary);
 
     if (!outFile.good()) {
@@ -70,125 +77,41 @@ void saveBMP(const std::string& filename, const varjo_BufferMetadata& buffer, vo
         return;
     }
 
-    switch (buffer.format) {
-        case varjo_TextureFormat_RGBA16_FLOAT: {
-            // Background color for alpha blending
-            const float rgbBackground[3] = {0.25f, 0.45f, 0.40f};
-
-            // Convert half float to uint8
-            const DirectX::PackedVector::HALF* halfSrc = reinterpret_cast<const DirectX::PackedVector::HALF*>(cpuData);
-            halfSrc += buffer.byteSize / sizeof(DirectX::PackedVector::HALF);
-            for (int32_t y = 0; y < buffer.height; y++) {
-                halfSrc -= buffer.rowStride / sizeof(DirectX::PackedVector::HALF);
-                std::vector<uint8_t> line(buffer.width * components);
-                for (int32_t x = 0; x < buffer.width * components; x += components) {
-                    // Streamed RGB values are in linear colorspace so we gamma correct them for screen here
-                    constexpr float gamma = 1.0f / 2.2f;
-
-                    // Read alpha
-                    const float alpha = DirectX::PackedVector::XMConvertHalfToFloat(halfSrc[x + 3]);
-
-                    // Read value, gamma correct, alpha blend to background color, write to output in BMP byte order
-                    for (int32_t c = 0; c < 3; c++) {
-                        float value = powf(DirectX::PackedVector::XMConvertHalfToFloat(halfSrc[x + c]), gamma);
-                        value = value * alpha + rgbBackground[c] * (1.0f - alpha);
-                        line[x + (2 - c)] = static_cast<uint8_t>(std::max(0.0f, std::min(255.0f, 255.0f * value)));
-                    }
-
-                    // Write alpha
-                    line[x + 3] = 255;
-                    // line[x + 3] = static_cast<uint8_t>(max(0, min(255, 255.0 * alpha)));
-                }
-
-                // Write line to file
-                outFile.write(reinterpret_cast<const char*>(line.data()), line.size());
-                if (!outFile.good()) {
-                    LOGE("Writing to bitmap file failed: %s", filename.c_str());
-                    return;
-                }
-            }
-        } break;
-
-        case varjo_TextureFormat_YUV422: {
-            // Convert YUV422 to RGBA8
-            const uint8_t* b = reinterpret_cast<const uint8_t*>(cpuData);
-            b += (buffer.rowStride * buffer.height);
-            const uint32_t uvOffs = (buffer.rowStride * buffer.height);
-            for (int32_t y = 0; y < buffer.height; y++) {
-                std::vector<uint8_t> line(buffer.width * components);
-                b -= buffer.rowStride;
-                size_t lineOffs = 0;
-                for (int32_t x = 0; x < buffer.width; x++) {
-                    int Y = b[x];
-                    auto uvX = x - (x & 1);
-                    int U = b[uvX + 0 + uvOffs];
-                    int V = b[uvX + 1 + uvOffs];
-
-                    int R, G, B;
-                    convertYUVtoRGB(Y, U, V, R, G, B);
-
-                    // Write RGBA in BMP byteorder
-                    line[lineOffs + 2] = std::max(std::min(R, 255), 0);
-                    line[lineOffs + 1] = std::max(std::min(G, 255), 0);
-                    line[lineOffs + 0] = std::max(std::min(B, 255), 0);
-                    line[lineOffs + 3] = 255;
-                    lineOffs += components;
-                }
-                outFile.write(reinterpret_cast<const char*>(line.data()), line.size());
-                if (!outFile.good()) {
-                    LOGE("Writing to bitmap file failed: %s", filename.c_str());
-                    return;
-                }
-            }
-        } break;
-
-        case varjo_TextureFormat_NV12: {
-            // Convert YUV420 NV12 to RGBA8
-            const uint8_t* bY = reinterpret_cast<const uint8_t*>(cpuData);
-            bY += (buffer.rowStride * buffer.height);
-            const uint8_t* bUV = bY + (buffer.rowStride * (buffer.height >> 1));
-
-            for (int32_t y = 0; y < buffer.height; y++) {
-                std::vector<uint8_t> line(buffer.width * components);
-                bY -= buffer.rowStride;
-                if ((y & 1) == 0) {
-                    bUV -= buffer.rowStride;
-                }
-                size_t lineOffs = 0;
-                for (int32_t x = 0; x < buffer.width; x++) {
-                    int Y = bY[x];
-
-                    auto uvX = x - (x & 1);
-                    int U = bUV[uvX + 0];
-                    int V = bUV[uvX + 1];
-
-                    int R, G, B;
-                    convertYUVtoRGB(Y, U, V, R, G, B);
-
-                    // Write RGBA in BMP byteorder
-                    line[lineOffs + 2] = std::max(std::min(R, 255), 0);
-                    line[lineOffs + 1] = std::max(std::min(G, 255), 0);
-                    line[lineOffs + 0] = std::max(std::min(B, 255), 0);
-                    line[lineOffs + 3] = 255;
-                    lineOffs += components;
-                }
-                outFile.write(reinterpret_cast<const char*>(line.data()), line.size());
-                if (!outFile.good()) {
-                    LOGE("Writing to bitmap file failed: %s", filename.c_str());
-                    return;
-                }
-            }
-        } break;
-
-        default: {
-            CRITICAL("Unsupported pixel format: %d", static_cast<int>(buffer.format));
-        } break;
+    const size_t lineSize = static_cast<size_t>(buffer.width) * components;
+    std::vector<uint8_t> line(lineSize);
+    for (int32_t y = buffer.height - 1; y >= 0; y--) {
+        const uint8_t* src = rgba.data() + lineSize * y;
+        for (size_t x = 0; x < lineSize; x += components) {
+            // Write RGBA in BMP byteorder
+            line[x + 0] = src[x + 2];
+            line[x + 1] = src[x + 1];
+            line[x + 2] = src[x + 0];
+            line[x + 3] = src[x + 3];
+        }
+        outFile.write(reinterpret_cast<const char*>(line.data()), line.size());
+        if (!outFile.good()) {
+            LOGE("Writing to bitmap file failed: %s", filename.c_str());
+            return;
+        }
     }
 
     outFile.close();
     LOGI("File saved succesfully: %s", filename.c_str());
 }
 
+// Fill in frame listener data common to all channels
+VarjoExamples::DataStreamer::Frame makeFrame(const varjo_StreamFrame& streamFrame, varjo_ChannelIndex channelIndex)
+{
+    VarjoExamples::DataStreamer::Frame frame;
+    frame.type = streamFrame.type;
+    frame.streamId = streamFrame.id;
+    frame.channelIndex = channelIndex;
+    frame.frameNumber = streamFrame.frameNumber;
+    frame.hmdPose = streamFrame.hmdPose;
+    frame.metadata = streamFrame.metadata;
+    return frame;
+}
+
 }  // namespace
 
 namespace VarjoExamples
@@ -318,6 +241,31 @@ void DataStreamer::stopDataStream(varjo_StreamType streamType, varjo_TextureForm
     }
 }
 
+bool DataStreamer::onStreamStopped(varjo_StreamId streamId)
+{
+    // Frame callback comes from different thread, lock streaming data
+    std::lock_guard<std::recursive_mutex> streamLock(m_streamData.mutex);
+
+    if (m_streamData.streamIds.count(streamId) == 0) {
+        return false;
+    }
+
+    LOGW("Data stream stopped by runtime: %d", static_cast<int>(streamId));
+    m_streamData.frameCounts.erase({streamId, varjo_ChannelIndex_First});
+    m_streamData.frameCounts.erase({streamId, varjo_ChannelIndex_Second});
+    m_streamData.streamIds.erase(streamId);
+    for (auto it = m_streamData.streamMapping.begin(); it != m_streamData.streamMapping.end(); ++it) {
+        if (it->second.first == streamId) {
+            if (it->first.first == varjo_StreamType_DistortedColor) {
+                m_frameExposure = {};
+            }
+            m_streamData.streamMapping.erase(it);
+            break;
+        }
+    }
+    return true;
+}
+
 void DataStreamer::handleDelayedBuffers()
 {
     // Callback comes from different thread, lock streaming data
@@ -327,6 +275,20 @@ void DataStreamer::handleDelayedBuffers()
         storeBuffer(db.type, db.streamId, db.channelIndex, db.frameNumber, db.bufferId, db.buffer, db.cpuBuffer, db.baseName);
     }
     m_streamData.delayedBuffers.clear();
+    m_delayedBytes.set(0);
+    if (m_metrics) {
+        m_metrics->set(m_delayedMetric, 0);
+    }
+}
+
+void DataStreamer::setMetrics(MetricsRegistry* metrics)
+{
+    m_metrics = metrics;
+    if (m_metrics) {
+        m_callbackMetric = m_metrics->addMetric("Stream: callback", MetricsRegistry::Kind::Timer);
+        m_framesMetric = m_metrics->addMetric("Stream: frames", MetricsRegistry::Kind::Counter);
+        m_delayedMetric = m_metrics->addMetric("Stream: delayed buffers", MetricsRegistry::Kind::Gauge);
+    }
 }
 
 void DataStreamer::printStreamConfigs()
@@ -390,8 +352,7 @@ void DataStreamer::storeBuffer(varjo_StreamType type, varjo_StreamId streamId, v
     CHECK_VARJO_ERR(m_session);
 }
 
-void DataStreamer::handleBuffer(
-    varjo_StreamType type, varjo_StreamId streamId, varjo_ChannelIndex channelIdx, int64_t frameNumber, varjo_BufferId bufferId, const std::string& baseName)
+void DataStreamer::handleBuffer(Frame& frame, varjo_BufferId bufferId, const std::string& baseName)
 {
     // Lock buffer
     varjo_LockDataStreamBuffer(m_session, bufferId);
@@ -403,14 +364,21 @@ void DataStreamer::handleBuffer(
     LOGD("Locked buffer (id=%lld): res=%dx%d, stride=%u, bytes=%u, type=%d, format=%d", bufferId, meta.width, meta.height, meta.rowStride, meta.byteSize,
         (int)meta.type, (int)meta.format);
 
+    // Pass locked buffer to frame listeners before it gets stored or delayed
+    frame.buffer = meta;
+    frame.cpuData = cpuData;
+    for (const auto& listener : m_streamData.frameListeners) {
+        listener.second(frame);
+    }
+
     bool delayed = m_delayedBufferHandling;
 
     if (delayed) {
         DelayedBuffer delayedBuffer;
-        delayedBuffer.type = type;
-        delayedBuffer.streamId = streamId;
-        delayedBuffer.channelIndex = channelIdx;
-        delayedBuffer.frameNumber = frameNumber;
+        delayedBuffer.type = frame.type;
+        delayedBuffer.streamId = frame.streamId;
+        delayedBuffer.channelIndex = frame.channelIndex;
+        delayedBuffer.frameNumber = frame.frameNumber;
         delayedBuffer.bufferId = bufferId;
         delayedBuffer.baseName = baseName;
         delayedBuffer.buffer = meta;
@@ -418,10 +386,14 @@ void DataStreamer::handleBuffer(
 
         // Add to delayed buffers. Will be handled in main loop.
         m_streamData.delayedBuffers.emplace_back(delayedBuffer);
+        m_delayedBytes.set(m_delayedBytes.get() + meta.byteSize);
+        if (m_metrics) {
+            m_metrics->set(m_delayedMetric, static_cast<int64_t>(m_streamData.delayedBuffers.size()));
+        }
 
     } else {
         // Handle buffer immediately
-        storeBuffer(type, streamId, channelIdx, frameNumber, bufferId, meta, cpuData, baseName);
+        storeBuffer(frame.type, frame.streamId, frame.channelIndex, frame.frameNumber, bufferId, meta, cpuData, baseName);
     }
 }
 
@@ -432,6 +404,10 @@ void DataStreamer::dataStreamFrameCallback(const varjo_StreamFrame* frame, varjo
     // i.e. file writing should be offloaded to a different thread.
 
     DataStreamer* streamer = reinterpret_cast<DataStreamer*>(userData);
+    MetricsRegistry::ScopedTimer timer(streamer->m_metrics, streamer->m_callbackMetric);
+    if (streamer->m_metrics) {
+        streamer->m_metrics->increment(streamer->m_framesMetric);
+    }
     streamer->onDataStreamFrame(frame, session);
 }
 
@@ -479,14 +455,16 @@ void DataStreamer::onDataStreamFrame(const varjo_StreamFrame* frame, varjo_Sessi
             for (const auto& channel : channels) {
                 LOGD("  Channel #%lld", channel);
 
+                Frame channelFrame = makeFrame(*frame, channel);
+
                 if (frame->dataFlags & varjo_DataFlag_Extrinsics) {
-                    varjo_Matrix extrinsics = varjo_GetCameraExtrinsics(session, frame->id, frame->frameNumber, channel);
-                    CHECK_VARJO_ERR(m_session);
+                    channelFrame.extrinsics = varjo_GetCameraExtrinsics(session, frame->id, frame->frameNumber, channel);
+                    channelFrame.hasExtrinsics = (CHECK_VARJO_ERR(m_session) == varjo_NoError);
                 }
 
                 if (frame->dataFlags & varjo_DataFlag_Intrinsics) {
-                    varjo_CameraIntrinsics intrinsics = varjo_GetCameraIntrinsics(session, frame->id, frame->frameNumber, channel);
-                    CHECK_VARJO_ERR(m_session);
+                    channelFrame.intrinsics = varjo_GetCameraIntrinsics(session, frame->id, frame->frameNumber, channel);
+                    channelFrame.hasIntrinsics = (CHECK_VARJO_ERR(m_session) == varjo_NoError);
                 }
 
                 varjo_BufferId bufferId = varjo_InvalidId;
@@ -500,7 +478,7 @@ void DataStreamer::onDataStreamFrame(const varjo_StreamFrame* frame, varjo_Sessi
                     return;
                 }
 
-                handleBuffer(frame->type, frame->id, channel, frame->frameNumber, bufferId, std::string(c_bufferFilenames[channel]));
+                handleBuffer(channelFrame, bufferId, std::string(c_bufferFilenames[channel]));
             }
         } break;
 
@@ -520,7 +498,8 @@ void DataStreamer::onDataStreamFrame(const varjo_StreamFrame* frame, varjo_Sessi
                 return;
             }
 
-            handleBuffer(frame->type, frame->id, varjo_ChannelIndex_First, frame->frameNumber, bufferId, "cube");
+            Frame cubemapFrame = makeFrame(*frame, varjo_ChannelIndex_First);
+            handleBuffer(cubemapFrame, bufferId, "cube");
 
         } break;
 
@@ -588,4 +567,113 @@ bool DataStreamer::getCubemapFrame(CubemapFrame& frame)
     return true;
 }
 
+void DataStreamer::releaseCubemapFrame()
+{
+    std::lock_guard<std::recursive_mutex> streamLock(m_streamData.mutex);
+
+    m_latestCubemapFrame.data.clear();
+    m_latestCubemapFrame.data.shrink_to_fit();
+}
+
+int DataStreamer::addFrameListener(const FrameListener& listener)
+{
+    // Listeners are called from stream thread, lock streaming data
+    std::lock_guard<std::recursive_mutex> streamLock(m_streamData.mutex);
+
+    const int listenerId = m_streamData.nextListenerId++;
+    m_streamData.frameListeners.emplace_back(listenerId, listener);
+    return listenerId;
+}
+
+void DataStreamer::removeFrameListener(int listenerId)
+{
+    std::lock_guard<std::recursive_mutex> streamLock(m_streamData.mutex);
+
+    auto& listeners = m_streamData.frameListeners;
+    listeners.erase(std::remove_if(listeners.begin(), listeners.end(), [listenerId](const auto& l) { return l.first == listenerId; }), listeners.end());
+}
+
+bool DataStreamer::convertToRGBA(const varjo_BufferMetadata& buffer, const void* cpuData, std::vector<uint8_t>& outRGBA)
+{
+    if (cpuData == nullptr || buffer.type != varjo_BufferType_CPU) {
+        return false;
+    }
+
+    constexpr int32_t components = 4;
+    outRGBA.resize(static_cast<size_t>(buffer.width) * buffer.height * components);
+    uint8_t* dst = outRGBA.data();
+
+    switch (buffer.format) {
+        case varjo_TextureFormat_RGBA16_FLOAT: {
+            // Background color for alpha blending
+            const float rgbBackground[3] = {0.25f, 0.45f, 0.40f};
+
+            const uint8_t* src = reinterpret_cast<const uint8_t*>(cpuData);
+            for (int32_t y = 0; y < buffer.height; y++) {
+                const DirectX::PackedVector::HALF* halfSrc = reinterpret_cast<const DirectX::PackedVector::HALF*>(src + buffer.rowStride * y);
+                for (int32_t x = 0; x < buffer.width * components; x += components) {
+                    // Streamed RGB values are in linear colorspace so we gamma correct them for screen here
+                    constexpr float gamma = 1.0f / 2.2f;
+
+                    // Read alpha
+                    const float alpha = DirectX::PackedVector::XMConvertHalfToFloat(halfSrc[x + 3]);
+
+                    // Read value, gamma correct, alpha blend to background color
+                    for (int32_t c = 0; c < 3; c++) {
+                        float value = powf(DirectX::PackedVector::XMConvertHalfToFloat(halfSrc[x + c]), gamma);
+                        value = value * alpha + rgbBackground[c] * (1.0f - alpha);
+                        dst[x + c] = static_cast<uint8_t>(std::max(0.0f, std::min(255.0f, 255.0f * value)));
+                    }
+                    dst[x + 3] = 255;
+                }
+                dst += buffer.width * components;
+            }
+        } break;
+
+        case varjo_TextureFormat_YUV422: {
+            const uint8_t* b = reinterpret_cast<const uint8_t*>(cpuData);
+            const uint32_t uvOffs = (buffer.rowStride * buffer.height);
+            for (int32_t y = 0; y < buffer.height; y++) {
+                for (int32_t x = 0; x < buffer.width; x++) {
+                    const auto uvX = x - (x & 1);
+                    int R, G, B;
+                    convertYUVtoRGB(b[x], b[uvX + 0 + uvOffs], b[uvX + 1 + uvOffs], R, G, B);
+                    dst[0] = std::max(std::min(R, 255), 0);
+                    dst[1] = std::max(std::min(G, 255), 0);
+                    dst[2] = std::max(std::min(B, 255), 0);
+                    dst[3] = 255;
+                    dst += components;
+                }
+                b += buffer.rowStride;
+            }
+        } break;
+
+        case varjo_TextureFormat_NV12: {
+            const uint8_t* bY = reinterpret_cast<const uint8_t*>(cpuData);
+            const uint8_t* bUVPlane = bY + (buffer.rowStride * buffer.height);
+            for (int32_t y = 0; y < buffer.height; y++) {
+                const uint8_t* bUV = bUVPlane + buffer.rowStride * (y >> 1);
+                for (int32_t x = 0; x < buffer.width; x++) {
+                    const auto uvX = x - (x & 1);
+                    int R, G, B;
+                    convertYUVtoRGB(bY[x], bUV[uvX + 0], bUV[uvX + 1], R, G, B);
+                    dst[0] = std::max(std::min(R, 255), 0);
+                    dst[1] = std::max(std::min(G, 255), 0);
+                    dst[2] = std::max(std::min(B, 255), 0);
+                    dst[3] = 255;
+                    dst += components;
+                }
+                bY += buffer.rowStride;
+            }
+        } break;
+
+        default: {
+            LOGE("Unsupported pixel format: %d", static_cast<int>(buffer.format));
+            return false;
+        }
+    }
+
+    return true;
+}
+
 }  // namespace VarjoExamples
@@ -8,10 +8,13 @@
 #include <unordered_set>
 #include <atomic>
 #include <array>
+#include <functional>
 
 #include <Varjo_datastream.h>
 
 #include "Globals.hpp"
+#include "MetricsRegistry.hpp"
+#include "MemoryAccounting.hpp"
 
 namespace VarjoExamples
 {
@@ -30,10 +33,29 @@ public:
 
     //! HDR cubemap frame data.
     struct CubemapFrame {
-        varjo_BufferMetadata metadata;  //!< Cubemap frame metadata
-        std::vector<uint8_t> data;      //!< Cubemap frame data
+        varjo_BufferMetadata metadata;                    //!< Cubemap frame metadata
+        TrackedVector<uint8_t, MemoryTag::Cubemap> data;  //!< Cubemap frame data
     };
 
+    //! Stream frame passed to frame listeners. CPU data is only valid during the listener call.
+    struct Frame {
+        varjo_StreamType type = 0;                                   //!< Stream type
+        varjo_StreamId streamId = varjo_InvalidId;                   //!< Stream id
+        varjo_ChannelIndex channelIndex = varjo_ChannelIndex_First;  //!< Channel index
+        int64_t frameNumber = 0;                                     //!< Frame number
+        varjo_Matrix hmdPose{};                                      //!< HMD world pose at frame time
+        varjo_StreamFrameMetadata metadata{};                        //!< Stream specific frame metadata
+        bool hasIntrinsics = false;                                  //!< Intrinsics valid flag
+        varjo_CameraIntrinsics intrinsics{};                         //!< Camera intrinsics for this channel
+        bool hasExtrinsics = false;                                  //!< Extrinsics valid flag
+        varjo_Matrix extrinsics{};                                   //!< Camera extrinsics for this channel
+        varjo_BufferMetadata buffer{};                               //!< Buffer metadata
+        const void* cpuData = nullptr;                               //!< Locked CPU buffer data
+    };
+
+    //! Frame listener callback type. Called from the stream thread, so keep it lightweight.
+    using FrameListener = std::function<void(const Frame&)>;
+
     //! Construct data streamer
     DataStreamer(varjo_Session* session);
 
@@ -55,6 +77,10 @@ public:
     //! Stop data streaming
     void stopDataStream(varjo_StreamType streamType, varjo_TextureFormat streamFormat);
 
+    //! Forget stream that runtime stopped, e.g. on DataStreamStop event. Returns false if stream was not running,
+    //! which is the case for streams stopped with stopDataStream.
+    bool onStreamStopped(varjo_StreamId streamId);
+
     //! Is streaming
     bool isStreaming(varjo_StreamType streamType, varjo_TextureFormat streamFormat);
 
@@ -79,6 +105,22 @@ public:
     //! Get latest cube map frame
     bool getCubemapFrame(CubemapFrame& frame);
 
+    //! Release latest cube map frame copy. Next cubemap frame allocates it again.
+    void releaseCubemapFrame();
+
+    //! Add frame listener. Returns listener id for removing it.
+    int addFrameListener(const FrameListener& listener);
+
+    //! Remove frame listener with given id
+    void removeFrameListener(int listenerId);
+
+    //! Register stream metrics to given registry and update them from stream callbacks. Call before starting streams.
+    void setMetrics(MetricsRegistry* metrics);
+
+    //! Convert CPU stream buffer to tightly packed top-down RGBA8. Half float colors are gamma corrected and alpha
+    //! blended over a background color. Returns false for unsupported formats.
+    static bool convertToRGBA(const varjo_BufferMetadata& buffer, const void* cpuData, std::vector<uint8_t>& outRGBA);
+
 private:
     //! Static data stream frame callback function
     static void dataStreamFrameCallback(const varjo_StreamFrame* frame, varjo_Session* session, void* userData);
@@ -87,8 +129,7 @@ private:
     void onDataStreamFrame(const varjo_StreamFrame* frame, varjo_Session* session);
 
     //! Handle frame buffer
-    void handleBuffer(varjo_StreamType type, varjo_StreamId streamId, varjo_ChannelIndex channelIdx, int64_t frameNumber, varjo_BufferId bufferId,
-        const std::string& baseName);
+    void handleBuffer(Frame& frame, varjo_BufferId bufferId, const std::string& baseName);
 
     //! Store buffer contents to file
     void storeBuffer(varjo_StreamType type, varjo_StreamId streamId, varjo_ChannelIndex channelIdx, int64_t frameNumber, varjo_BufferId bufferId,
@@ -121,6 +162,8 @@ private:
             streamMapping;                                                             //!< Stream id+channels for each stream type+format pair
         std::map<std::pair<varjo_StreamId, varjo_ChannelIndex>, int64_t> frameCounts;  //!< Frame counters for stream IDs
         std::vector<DelayedBuffer> delayedBuffers;                                     //!< List of delayed buffers
+        std::vector<std::pair<int, FrameListener>> frameListeners;                     //!< Registered frame listeners
+        int nextListenerId = 0;                                                        //!< Next frame listener id
     };
 
     varjo_Session* m_session = nullptr;                //!< Varjo session
@@ -128,6 +171,13 @@ private:
     StreamData m_streamData;                           //!< Stream data
     ExposureAdjustments m_frameExposure;               //!< Latest known frame exposure adjustments (updated when color stream running)
     CubemapFrame m_latestCubemapFrame;                 //!< Latest cubemap frame
+
+    MetricsRegistry* m_metrics = nullptr;                                 //!< Metrics registry, null if not monitored
+    MetricsRegistry::Id m_callbackMetric = MetricsRegistry::c_invalidId;  //!< Frame callback time metric
+    MetricsRegistry::Id m_framesMetric = MetricsRegistry::c_invalidId;    //!< Received frames metric
+    MetricsRegistry::Id m_delayedMetric = MetricsRegistry::c_invalidId;   //!< Delayed buffer count metric
+
+    TrackedBytes m_delayedBytes{MemoryTag::Stream};  //!< Runtime buffer bytes held locked as delayed buffers
 };
 
 }  // namespace VarjoExamples
@@ -0,0 +1,955 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "FiducialDetector.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <emmintrin.h>
+
+#include "CameraModel.hpp"
+
+using namespace VarjoExamples;
+
+namespace
+{
+// Threshold tile size in decimated pixels
+constexpr int c_tileSize = 4;
+
+// Marker cells per side including border, and data cells per side
+constexpr int c_markerCells = 6;
+constexpr int c_dataCells = 4;
+
+// Data cells holding id bits in row order, skipping the orientation corners
+constexpr int c_codeBits = 12;
+
+// Rows per labeling band
+constexpr int c_bandRows = 32;
+
+// Gauss-Newton iterations for pose refinement
+constexpr int c_poseIterations = 10;
+
+// Convert between OpenCV camera space used for solving (Y down, Z forward) and Varjo camera space (Y up, Z backward)
+const glm::dmat4 c_cvToCamera(1.0, 0.0, 0.0, 0.0, 0.0, -1.0, 0.0, 0.0, 0.0, 0.0, -1.0, 0.0, 0.0, 0.0, 0.0, 1.0);
+
+// CRC-4 with polynomial x^4 + x + 1 over 8 bits
+uint32_t crc4(uint32_t value)
+{
+    uint32_t crc = value << 4;
+    for (int bit = 11; bit >= 4; bit--) {
+        if (crc & (1u << bit)) {
+            crc ^= 0x13u << (bit - 4);
+        }
+    }
+    return crc & 0xf;
+}
+
+// Returns marker data cell grid of id: 1 for white cells
+std::array<std::array<int, c_dataCells>, c_dataCells> getMarkerCells(uint32_t id)
+{
+    std::array<std::array<int, c_dataCells>, c_dataCells> cells{};
+    cells[0][0] = 1;
+    const uint32_t code = (id << 4) | crc4(id);
+    int bit = c_codeBits - 1;
+    for (int r = 0; r < c_dataCells; r++) {
+        for (int c = 0; c < c_dataCells; c++) {
+            const bool corner = (r == 0 || r == c_dataCells - 1) && (c == 0 || c == c_dataCells - 1);
+            if (!corner) {
+                cells[r][c] = (code >> bit--) & 1;
+            }
+        }
+    }
+    return cells;
+}
+
+// Find union-find root with path halving
+inline int32_t findRoot(int32_t* parents, int32_t i)
+{
+    while (parents[i] != i) {
+        parents[i] = parents[parents[i]];
+        i = parents[i];
+    }
+    return i;
+}
+
+// Union two sets
+inline void unite(int32_t* parents, int32_t a, int32_t b)
+{
+    a = findRoot(parents, a);
+    b = findRoot(parents, b);
+    if (a != b) {
+        parents[std::max(a, b)] = std::min(a, b);
+    }
+}
+
+// Cross product of 2D vectors
+inline double cross(const glm::dvec2& a, const glm::dvec2& b) { return a.x * b.y - a.y * b.x; }
+
+// Signed polygon area, positive for clockwise order in image coordinates
+double getArea(const glm::dvec2* points, size_t count)
+{
+    double area = 0.0;
+    for (size_t i = 0; i < count; i++) {
+        area += cross(points[i], points[(i + 1) % count]);
+    }
+    return 0.5 * area;
+}
+
+// Solve 8x8 linear system in place with partial pivoting. Returns false if singular.
+template <int N>
+bool solveLinear(double (&a)[N][N], double (&b)[N])
+{
+    for (int col = 0; col < N; col++) {
+        int pivot = col;
+        for (int row = col + 1; row < N; row++) {
+            if (std::abs(a[row][col]) > std::abs(a[pivot][col])) {
+                pivot = row;
+            }
+        }
+        if (std::abs(a[pivot][col]) < 1e-12) {
+            return false;
+        }
+        std::swap(a[col], a[pivot]);
+        std::swap(b[col], b[pivot]);
+        for (int row = col + 1; row < N; row++) {
+            const double f = a[row][col] / a[col][col];
+            for (int k = col; k < N; k++) {
+                a[row][k] -= f * a[col][k];
+            }
+            b[row] -= f * b[col];
+        }
+    }
+    for (int row = N - 1; row >= 0; row--) {
+        for (int k = row + 1; k < N; k++) {
+            b[row] -= a[row][k] * b[k];
+        }
+        b[row] /= a[row][row];
+    }
+    return true;
+}
+
+// Homography mapping four source points to destination points. Returns false if degenerate.
+bool getHomography(const glm::dvec2 (&src)[4], const glm::dvec2 (&dst)[4], glm::dmat3& outH)
+{
+    double a[8][8];
+    double b[8];
+    for (int i = 0; i < 4; i++) {
+        const double x = src[i].x, y = src[i].y, u = dst[i].x, v = dst[i].y;
+        const double rowU[8] = {x, y, 1.0, 0.0, 0.0, 0.0, -u * x, -u * y};
+        const double rowV[8] = {0.0, 0.0, 0.0, x, y, 1.0, -v * x, -v * y};
+        std::copy(rowU, rowU + 8, a[i * 2]);
+        std::copy(rowV, rowV + 8, a[i * 2 + 1]);
+        b[i * 2] = u;
+        b[i * 2 + 1] = v;
+    }
+    if (!solveLinear(a, b)) {
+        return false;
+    }
+
+    // GLM matrices are column major
+    outH = glm::dmat3(b[0], b[3], b[6], b[1], b[4], b[7], b[2], b[5], 1.0);
+    return true;
+}
+
+// Apply homography to point
+inline glm::dvec2 transform(const glm::dmat3& h, const glm::dvec2& p)
+{
+    const glm::dvec3 q = h * glm::dvec3(p, 1.0);
+    return glm::dvec2(q) / q.z;
+}
+
+// Bilinear luma sample, negative outside image
+inline float sampleLuma(const uint8_t* luma, size_t rowStride, int width, int height, const glm::dvec2& p)
+{
+    if (p.x < 0.0 || p.y < 0.0 || p.x > width - 1.0 || p.y > height - 1.0) {
+        return -1.0f;
+    }
+    const int x = std::min(static_cast<int>(p.x), width - 2);
+    const int y = std::min(static_cast<int>(p.y), height - 2);
+    const float fx = static_cast<float>(p.x - x);
+    const float fy = static_cast<float>(p.y - y);
+    const uint8_t* row0 = luma + rowStride * y + x;
+    const uint8_t* row1 = row0 + rowStride;
+    const float top = row0[0] + (row0[1] - row0[0]) * fx;
+    const float bottom = row1[0] + (row1[1] - row1[0]) * fx;
+    return top + (bottom - top) * fy;
+}
+
+// Rotation matrix from rotation vector
+glm::dmat3 getRotation(const glm::dvec3& v)
+{
+    const double angle = glm::length(v);
+    if (angle < 1e-12) {
+        return glm::dmat3(1.0);
+    }
+    return glm::dmat3(glm::rotate(glm::dmat4(1.0), angle, v / angle));
+}
+
+// Sum of squared corner reprojection errors of pose
+double getReprojError(const CameraModel& camera, const glm::dvec3 (&objectPoints)[4], const std::array<glm::vec2, 4>& corners, const glm::dmat3& r,
+    const glm::dvec3& t, double* outResiduals)
+{
+    double sum = 0.0;
+    for (int i = 0; i < 4; i++) {
+        glm::dvec2 pixel;
+        if (!camera.project(r * objectPoints[i] + t, pixel)) {
+            return 1e30;
+        }
+        const glm::dvec2 e = pixel - glm::dvec2(corners[i]);
+        if (outResiduals) {
+            outResiduals[i * 2] = e.x;
+            outResiduals[i * 2 + 1] = e.y;
+        }
+        sum += glm::dot(e, e);
+    }
+    return sum;
+}
+
+}  // namespace
+
+namespace VarjoExamples
+{
+FiducialDetector::FiducialDetector(ThreadPool& threadPool, const Config& config)
+    : m_threadPool(threadPool)
+    , m_config(config)
+{
+}
+
+void FiducialDetector::detect(const uint8_t* luma, size_t rowStride, int width, int height, const varjo_CameraIntrinsics* intrinsics,
+    std::vector<Detection>& outDetections)
+{
+    const int64_t start = getTimestampNs();
+
+    segment(luma, rowStride, width, height);
+    label();
+
+    // Fit, decode and solve regions in parallel. Each region writes its own slot.
+    std::vector<Detection> results(m_regions.size());
+    std::vector<uint8_t> valid(m_regions.size(), 0);
+    std::vector<uint8_t> quads(m_regions.size(), 0);
+    m_threadPool.parallelFor(static_cast<int>(m_regions.size()), [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            Detection& detection = results[i];
+            if (!fitQuad(m_regions[i], detection.corners)) {
+                continue;
+            }
+            quads[i] = 1;
+            if (!decode(luma, rowStride, width, height, detection.corners, detection.id)) {
+                continue;
+            }
+            if (intrinsics) {
+                detection.hasPose = solvePose(*intrinsics, width, height, detection);
+            }
+            valid[i] = 1;
+        }
+    });
+
+    // Keep the largest detection of each id
+    outDetections.clear();
+    for (size_t i = 0; i < results.size(); i++) {
+        if (!valid[i]) {
+            continue;
+        }
+        auto same = std::find_if(outDetections.begin(), outDetections.end(), [&](const Detection& d) { return d.id == results[i].id; });
+        if (same == outDetections.end()) {
+            outDetections.push_back(results[i]);
+        } else {
+            const glm::vec2 a = results[i].corners[2] - results[i].corners[0];
+            const glm::vec2 b = same->corners[2] - same->corners[0];
+            if (glm::dot(a, a) > glm::dot(b, b)) {
+                *same = results[i];
+            }
+        }
+    }
+
+    m_detections = outDetections;
+    m_stats.frames++;
+    m_stats.candidates = std::count(quads.begin(), quads.end(), 1);
+    m_stats.detections = static_cast<int64_t>(outDetections.size());
+    m_detectTimeTotalMs += (getTimestampNs() - start) * 1e-6;
+    m_stats.detectTimeAvgMs = m_detectTimeTotalMs / m_stats.frames;
+}
+
+bool FiducialDetector::detect(const DataStreamer::Frame& frame, MarkerTracker::MarkerMap& outMarkers)
+{
+    const varjo_BufferMetadata& buffer = frame.buffer;
+    if (frame.cpuData == nullptr || buffer.type != varjo_BufferType_CPU ||
+        (buffer.format != varjo_TextureFormat_YUV422 && buffer.format != varjo_TextureFormat_NV12)) {
+        return false;
+    }
+
+    // Luma plane is first in both formats
+    std::vector<Detection> detections;
+    detect(reinterpret_cast<const uint8_t*>(frame.cpuData), buffer.rowStride, buffer.width, buffer.height,
+        frame.hasIntrinsics ? &frame.intrinsics : nullptr, detections);
+
+    // Extrinsics place the camera relative to HMD pose
+    const glm::mat4x4 cameraToWorld =
+        fromVarjoMatrix(frame.hmdPose) * (frame.hasExtrinsics ? fromVarjoMatrix(frame.extrinsics) : glm::mat4x4(1.0f));
+    for (const auto& detection : detections) {
+        if (!detection.hasPose || detection.reprojError > m_config.maxReprojError) {
+            continue;
+        }
+        MarkerTracker::MarkerObject object;
+        object.id = detection.id;
+        object.time = frame.metadata.distortedColor.timestamp;
+        object.pose = cameraToWorld * detection.cameraPose;
+        object.size = glm::vec3(m_config.markerSize, m_config.markerSize, 0.0f);
+        outMarkers[object.id] = object;
+    }
+    return true;
+}
+
+bool FiducialDetector::renderMarker(MarkerTracker::MarkerId id, int cellSize, std::vector<uint8_t>& outLuma)
+{
+    if (id < 0 || id >= c_markerIdCount || cellSize < 1) {
+        return false;
+    }
+
+    const auto cells = getMarkerCells(static_cast<uint32_t>(id));
+    const int size = (c_markerCells + 2) * cellSize;
+    outLuma.assign(static_cast<size_t>(size) * size, 255);
+    for (int y = 0; y < size; y++) {
+        for (int x = 0; x < size; x++) {
+            // Cell coordinates inside marker, border at 0 and c_markerCells - 1
+            const int r = y / cellSize - 1;
+            const int c = x / cellSize - 1;
+            if (r < 0 || c < 0 || r >= c_markerCells || c >= c_markerCells) {
+                continue;
+            }
+            const bool border = (r == 0 || c == 0 || r == c_markerCells - 1 || c == c_markerCells - 1);
+            outLuma[static_cast<size_t>(y) * size + x] = (!border && cells[r - 1][c - 1]) ? 255 : 0;
+        }
+    }
+    return true;
+}
+
+void FiducialDetector::segment(const uint8_t* luma, size_t rowStride, int width, int height)
+{
+    const int d = std::max(1, m_config.decimation);
+    const int w = width / d;
+    const int h = height / d;
+    m_width = w;
+    m_height = h;
+    m_decimated.resize(static_cast<size_t>(w) * h);
+    m_binary.resize(m_decimated.size());
+
+    const int tilesX = (w + c_tileSize - 1) / c_tileSize;
+    const int tilesY = (h + c_tileSize - 1) / c_tileSize;
+    m_tileMin.resize(static_cast<size_t>(tilesX) * tilesY);
+    m_tileMax.resize(m_tileMin.size());
+
+    // Decimate and compute tile ranges one tile row at a time
+    m_threadPool.parallelFor(tilesY, [&](int begin, int end) {
+        for (int ty = begin; ty < end; ty++) {
+            const int y0 = ty * c_tileSize;
+            const int y1 = std::min(h, y0 + c_tileSize);
+            for (int y = y0; y < y1; y++) {
+                uint8_t* dst = m_decimated.data() + static_cast<size_t>(w) * y;
+                const uint8_t* src = luma + rowStride * (static_cast<size_t>(y) * d);
+                int x = 0;
+                if (d == 1) {
+                    memcpy(dst, src, w);
+                    x = w;
+                } else if (d == 2) {
+                    // Average row pairs, then even and odd pixels
+                    const __m128i lowMask = _mm_set1_epi16(0x00ff);
+                    for (; x + 16 <= w; x += 16) {
+                        const __m128i a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 2));
+                        const __m128i a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x * 2 + 16));
+                        const __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + rowStride + x * 2));
+                        const __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + rowStride + x * 2 + 16));
+                        const __m128i v0 = _mm_avg_epu8(a0, b0);
+                        const __m128i v1 = _mm_avg_epu8(a1, b1);
+                        const __m128i h0 = _mm_avg_epu16(_mm_and_si128(v0, lowMask), _mm_srli_epi16(v0, 8));
+                        const __m128i h1 = _mm_avg_epu16(_mm_and_si128(v1, lowMask), _mm_srli_epi16(v1, 8));
+                        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_packus_epi16(h0, h1));
+                    }
+                }
+                for (; x < w; x++) {
+                    int sum = 0;
+                    for (int j = 0; j < d; j++) {
+                        for (int i = 0; i < d; i++) {
+                            sum += src[rowStride * j + x * d + i];
+                        }
+                    }
+                    dst[x] = static_cast<uint8_t>((sum + d * d / 2) / (d * d));
+                }
+            }
+
+            for (int tx = 0; tx < tilesX; tx++) {
+                const int x0 = tx * c_tileSize;
+                const int x1 = std::min(w, x0 + c_tileSize);
+                uint8_t lo = 255;
+                uint8_t hi = 0;
+                for (int y = y0; y < y1; y++) {
+                    const uint8_t* row = m_decimated.data() + static_cast<size_t>(w) * y;
+                    for (int x = x0; x < x1; x++) {
+                        lo = std::min(lo, row[x]);
+                        hi = std::max(hi, row[x]);
+                    }
+                }
+                m_tileMin[static_cast<size_t>(ty) * tilesX + tx] = lo;
+                m_tileMax[static_cast<size_t>(ty) * tilesX + tx] = hi;
+            }
+        }
+    });
+
+    // Threshold each pixel at the middle of the range of its 3x3 tile neighbourhood
+    m_threadPool.parallelFor(tilesY, [&](int begin, int end) {
+        std::vector<uint8_t> thresholds(static_cast<size_t>(tilesX) * c_tileSize + 16);
+        std::vector<uint8_t> lowContrast(thresholds.size());
+        for (int ty = begin; ty < end; ty++) {
+            for (int tx = 0; tx < tilesX; tx++) {
+                uint8_t lo = 255;
+                uint8_t hi = 0;
+                for (int ny = std::max(0, ty - 1); ny <= std::min(tilesY - 1, ty + 1); ny++) {
+                    for (int nx = std::max(0, tx - 1); nx <= std::min(tilesX - 1, tx + 1); nx++) {
+                        lo = std::min(lo, m_tileMin[static_cast<size_t>(ny) * tilesX + nx]);
+                        hi = std::max(hi, m_tileMax[static_cast<size_t>(ny) * tilesX + nx]);
+                    }
+                }
+
+                // Pixels above threshold are light. Threshold is below max, so adding one cannot overflow.
+                const uint8_t threshold = static_cast<uint8_t>(lo + (hi - lo) / 2 + 1);
+                const uint8_t low = (hi - lo < m_config.minContrast) ? 0xff : 0x00;
+                memset(thresholds.data() + tx * c_tileSize, threshold, c_tileSize);
+                memset(lowContrast.data() + tx * c_tileSize, low, c_tileSize);
+            }
+
+            const int y0 = ty * c_tileSize;
+            const int y1 = std::min(h, y0 + c_tileSize);
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* src = m_decimated.data() + static_cast<size_t>(w) * y;
+                uint8_t* dst = m_binary.data() + static_cast<size_t>(w) * y;
+                int x = 0;
+                const __m128i gray = _mm_set1_epi8(127);
+                for (; x + 16 <= w; x += 16) {
+                    const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + x));
+                    const __m128i t = _mm_loadu_si128(reinterpret_cast<const __m128i*>(thresholds.data() + x));
+                    const __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lowContrast.data() + x));
+                    const __m128i light = _mm_cmpeq_epi8(_mm_max_epu8(p, t), p);
+                    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x), _mm_or_si128(_mm_andnot_si128(l, light), _mm_and_si128(l, gray)));
+                }
+                for (; x < w; x++) {
+                    dst[x] = lowContrast[x] ? 127 : (src[x] >= thresholds[x] ? 255 : 0);
+                }
+            }
+        }
+    });
+}
+
+void FiducialDetector::label()
+{
+    const int w = m_width;
+    const int h = m_height;
+    const int n = w * h;
+    m_parents.resize(n);
+    m_regions.clear();
+    if (n == 0) {
+        return;
+    }
+
+    // Union dark pixels with left and upper neighbours inside row bands. Bands only touch their own pixels.
+    const int bands = (h + c_bandRows - 1) / c_bandRows;
+    int32_t* parents = m_parents.data();
+    const uint8_t* binary = m_binary.data();
+    m_threadPool.parallelFor(bands, [&](int begin, int end) {
+        for (int band = begin; band < end; band++) {
+            const int y0 = band * c_bandRows;
+            const int y1 = std::min(h, y0 + c_bandRows);
+            for (int y = y0; y < y1; y++) {
+                for (int x = 0; x < w; x++) {
+                    const int i = y * w + x;
+                    if (binary[i] != 0) {
+                        parents[i] = -1;
+                        continue;
+                    }
+                    parents[i] = i;
+                    if (x > 0 && binary[i - 1] == 0) {
+                        unite(parents, i, i - 1);
+                    }
+                    if (y > y0 && binary[i - w] == 0) {
+                        unite(parents, i, i - w);
+                    }
+                }
+            }
+        }
+    });
+
+    // Merge band seams
+    for (int y = c_bandRows; y < h; y += c_bandRows) {
+        for (int x = 0; x < w; x++) {
+            const int i = y * w + x;
+            if (binary[i] == 0 && binary[i - w] == 0) {
+                unite(parents, i, i - w);
+            }
+        }
+    }
+
+    // Flatten to roots and gather region bounds. Regions touching image edges are partially visible.
+    m_regionIndex.assign(n, -1);
+    std::vector<Region> regions;
+    for (int y = 0; y < h; y++) {
+        for (int x = 0; x < w; x++) {
+            const int i = y * w + x;
+            if (parents[i] < 0) {
+                continue;
+            }
+            const int root = findRoot(parents, i);
+            parents[i] = root;
+            int& index = m_regionIndex[root];
+            if (index < 0) {
+                index = static_cast<int>(regions.size());
+                regions.emplace_back();
+                regions.back().min = regions.back().max = glm::ivec2(x, y);
+            }
+            Region& region = regions[index];
+            region.count++;
+            region.min = glm::min(region.min, glm::ivec2(x, y));
+            region.max = glm::max(region.max, glm::ivec2(x, y));
+        }
+    }
+
+    const int minSide = std::max(4, m_config.minSide);
+    for (auto& region : regions) {
+        const glm::ivec2 size = region.max - region.min + 1;
+        const bool edge = region.min.x == 0 || region.min.y == 0 || region.max.x == w - 1 || region.max.y == h - 1;
+        if (edge || size.x < minSide || size.y < minSide || region.count < minSide * 2) {
+            region.count = 0;
+        }
+    }
+
+    // Collect boundary pixels of candidate regions
+    for (auto& region : regions) {
+        if (region.count > 0) {
+            region.boundary.reserve(4 * (region.max.x - region.min.x + region.max.y - region.min.y + 2));
+        }
+    }
+    for (int y = 1; y < h - 1; y++) {
+        for (int x = 1; x < w - 1; x++) {
+            const int i = y * w + x;
+            if (parents[i] < 0) {
+                continue;
+            }
+            Region& region = regions[m_regionIndex[parents[i]]];
+            if (region.count > 0 && (binary[i - 1] | binary[i + 1] | binary[i - w] | binary[i + w]) != 0) {
+                region.boundary.emplace_back(x, y);
+            }
+        }
+    }
+
+    for (auto& region : regions) {
+        if (region.count > 0) {
+            m_regions.push_back(std::move(region));
+        }
+    }
+}
+
+bool FiducialDetector::fitQuad(const Region& region, std::array<glm::vec2, 4>& outCorners) const
+{
+    // Convex hull of a region is the hull of its leftmost and rightmost pixels on each row
+    const int rows = region.max.y - region.min.y + 1;
+    std::vector<glm::ivec2> extremes(rows * 2, glm::ivec2(INT32_MAX, 0));
+    for (int r = 0; r < rows; r++) {
+        extremes[r * 2 + 1].x = INT32_MIN;
+    }
+    for (const auto& p : region.boundary) {
+        const int r = p.y - region.min.y;
+        extremes[r * 2].x = std::min(extremes[r * 2].x, p.x);
+        extremes[r * 2 + 1].x = std::max(extremes[r * 2 + 1].x, p.x);
+    }
+
+    std::vector<glm::dvec2> points;
+    for (int r = 0; r < rows; r++) {
+        if (extremes[r * 2].x <= extremes[r * 2 + 1].x) {
+            points.emplace_back(extremes[r * 2].x, region.min.y + r);
+            points.emplace_back(extremes[r * 2 + 1].x, region.min.y + r);
+        }
+    }
+    std::sort(points.begin(), points.end(), [](const glm::dvec2& a, const glm::dvec2& b) { return a.x < b.x || (a.x == b.x && a.y < b.y); });
+
+    // Monotone chain hull
+    std::vector<glm::dvec2> hull(points.size() * 2);
+    size_t k = 0;
+    for (size_t i = 0; i < points.size(); i++) {
+        while (k >= 2 && cross(hull[k - 1] - hull[k - 2], points[i] - hull[k - 2]) <= 0.0) {
+            k--;
+        }
+        hull[k++] = points[i];
+    }
+    for (size_t i = points.size() - 1, lower = k + 1; i > 0; i--) {
+        while (k >= lower && cross(hull[k - 1] - hull[k - 2], points[i - 1] - hull[k - 2]) <= 0.0) {
+            k--;
+        }
+        hull[k++] = points[i - 1];
+    }
+    hull.resize(k > 1 ? k - 1 : k);
+    if (hull.size() < 4) {
+        return false;
+    }
+
+    // Corners: farthest point from centroid, farthest from it, and farthest from their diagonal on both sides
+    glm::dvec2 centroid(0.0);
+    for (const auto& p : hull) {
+        centroid += p;
+    }
+    centroid /= static_cast<double>(hull.size());
+
+    auto farthest = [&](const glm::dvec2& from) {
+        size_t best = 0;
+        for (size_t i = 1; i < hull.size(); i++) {
+            if (glm::distance(hull[i], from) > glm::distance(hull[best], from)) {
+                best = i;
+            }
+        }
+        return best;
+    };
+    const size_t c0 = farthest(centroid);
+    const size_t c2 = farthest(hull[c0]);
+    size_t c1 = c0, c3 = c0;
+    double side1 = 0.0, side3 = 0.0;
+    const glm::dvec2 diagonal = hull[c2] - hull[c0];
+    for (size_t i = 0; i < hull.size(); i++) {
+        const double s = cross(diagonal, hull[i] - hull[c0]);
+        if (s > side1) {
+            side1 = s;
+            c1 = i;
+        } else if (s < side3) {
+            side3 = s;
+            c3 = i;
+        }
+    }
+    if (c1 == c0 || c3 == c0) {
+        return false;
+    }
+
+    glm::dvec2 quad[4] = {hull[c0], hull[c1], hull[c2], hull[c3]};
+    if (getArea(quad, 4) < 0.0) {
+        std::swap(quad[1], quad[3]);
+    }
+
+    // Region must fill its quad. Hull area is measured between pixel centers, so it misses half a pixel on each side.
+    const double quadArea = getArea(quad, 4);
+    const double hullArea = std::abs(getArea(hull.data(), hull.size()));
+    if (quadArea < m_config.minSide * m_config.minSide * 0.5 || quadArea < hullArea * 0.9) {
+        return false;
+    }
+
+    // Refine edges with lines fitted to boundary pixels near each edge, pushed half a pixel out to the region edge
+    glm::dvec2 lineP[4];
+    glm::dvec2 lineD[4];
+    for (int e = 0; e < 4; e++) {
+        const glm::dvec2 a = quad[e];
+        const glm::dvec2 b = quad[(e + 1) % 4];
+        const double length = glm::distance(a, b);
+        if (length < 4.0) {
+            return false;
+        }
+        const glm::dvec2 dir = (b - a) / length;
+        const glm::dvec2 normal(dir.y, -dir.x);
+
+        glm::dvec2 mean(0.0);
+        int count = 0;
+        double sxx = 0.0, sxy = 0.0, syy = 0.0;
+        for (const auto& pi : region.boundary) {
+            const glm::dvec2 p(pi);
+            const double t = glm::dot(p - a, dir);
+            const double dist = glm::dot(p - a, normal);
+            if (t > length * 0.15 && t < length * 0.85 && std::abs(dist) < 2.0) {
+                mean += p;
+                count++;
+            }
+        }
+        if (count < 4) {
+            lineP[e] = a + normal * 0.5;
+            lineD[e] = dir;
+            continue;
+        }
+        mean /= count;
+        for (const auto& pi : region.boundary) {
+            const glm::dvec2 p(pi);
+            const double t = glm::dot(p - a, dir);
+            const double dist = glm::dot(p - a, normal);
+            if (t > length * 0.15 && t < length * 0.85 && std::abs(dist) < 2.0) {
+                const glm::dvec2 q = p - mean;
+                sxx += q.x * q.x;
+                sxy += q.x * q.y;
+                syy += q.y * q.y;
+            }
+        }
+
+        // Principal direction of covariance
+        const double angle = 0.5 * std::atan2(2.0 * sxy, sxx - syy);
+        glm::dvec2 fitDir(std::cos(angle), std::sin(angle));
+        if (glm::dot(fitDir, dir) < 0.0) {
+            fitDir = -fitDir;
+        }
+        lineP[e] = mean + glm::dvec2(fitDir.y, -fitDir.x) * 0.5;
+        lineD[e] = fitDir;
+    }
+
+    // Corners at intersections of consecutive edge lines, mapped to full resolution pixel coordinates
+    const double d = std::max(1, m_config.decimation);
+    for (int c = 0; c < 4; c++) {
+        const int e0 = (c + 3) % 4;
+        const int e1 = c;
+        const double denom = cross(lineD[e0], lineD[e1]);
+        if (std::abs(denom) < 1e-6) {
+            return false;
+        }
+        const double t = cross(lineP[e1] - lineP[e0], lineD[e1]) / denom;
+        const glm::dvec2 corner = lineP[e0] + lineD[e0] * t;
+        if (glm::distance(corner, quad[c]) > 3.0) {
+            return false;
+        }
+        outCorners[c] = glm::vec2(corner * d + (d - 1.0) * 0.5);
+    }
+    return true;
+}
+
+bool FiducialDetector::decode(
+    const uint8_t* luma, size_t rowStride, int width, int height, std::array<glm::vec2, 4>& corners, MarkerTracker::MarkerId& outId) const
+{
+    // Map cell coordinates to pixels
+    const glm::dvec2 cellCorners[4] = {{0.0, 0.0}, {c_markerCells, 0.0}, {c_markerCells, c_markerCells}, {0.0, c_markerCells}};
+    const glm::dvec2 pixelCorners[4] = {glm::dvec2(corners[0]), glm::dvec2(corners[1]), glm::dvec2(corners[2]), glm::dvec2(corners[3])};
+    glm::dmat3 h;
+    if (!getHomography(cellCorners, pixelCorners, h)) {
+        return false;
+    }
+
+    // Average of a few samples around cell center, negative if outside image
+    auto sampleCell = [&](double cx, double cy) {
+        float sum = 0.0f;
+        const double offsets[3] = {-0.2, 0.0, 0.2};
+        for (double oy : offsets) {
+            for (double ox : offsets) {
+                const float s = sampleLuma(luma, rowStride, width, height, transform(h, glm::dvec2(cx + ox, cy + oy)));
+                if (s < 0.0f) {
+                    return -1.0f;
+                }
+                sum += s;
+            }
+        }
+        return sum / 9.0f;
+    };
+
+    // Quick reject with one sample per cell: one data corner cell must be clearly lighter than border cells
+    {
+        const double middle = 0.5 * c_markerCells;
+        const glm::dvec2 borderCenters[4] = {{middle, 0.5}, {c_markerCells - 0.5, middle}, {middle, c_markerCells - 0.5}, {0.5, middle}};
+        float cornerMax = 0.0f;
+        float borderMax = 0.0f;
+        for (int i = 0; i < 4; i++) {
+            const glm::dvec2 cornerCenter((i & 1) ? c_markerCells - 1.5 : 1.5, (i & 2) ? c_markerCells - 1.5 : 1.5);
+            const float corner = sampleLuma(luma, rowStride, width, height, transform(h, cornerCenter));
+            const float border = sampleLuma(luma, rowStride, width, height, transform(h, borderCenters[i]));
+            if (corner < 0.0f || border < 0.0f) {
+                return false;
+            }
+            cornerMax = std::max(cornerMax, corner);
+            borderMax = std::max(borderMax, border);
+        }
+        if (cornerMax - borderMax < m_config.minContrast) {
+            return false;
+        }
+    }
+
+    // Border cells give dark level and quiet zone around them light level
+    float cells[c_markerCells][c_markerCells];
+    float dark = 0.0f;
+    float light = 0.0f;
+    int lightCount = 0;
+    for (int r = 0; r < c_markerCells; r++) {
+        for (int c = 0; c < c_markerCells; c++) {
+            cells[r][c] = sampleCell(c + 0.5, r + 0.5);
+            if (cells[r][c] < 0.0f) {
+                return false;
+            }
+            if (r == 0 || c == 0 || r == c_markerCells - 1 || c == c_markerCells - 1) {
+                dark += cells[r][c];
+            }
+        }
+    }
+    dark /= 4 * (c_markerCells - 1);
+
+    float quiet[4 * c_markerCells];
+    for (int i = 0; i < c_markerCells; i++) {
+        const double u = i + 0.5;
+        const double outside[4][2] = {{u, -0.5}, {c_markerCells + 0.5, u}, {c_markerCells - u, c_markerCells + 0.5}, {-0.5, c_markerCells - u}};
+        for (int side = 0; side < 4; side++) {
+            quiet[side * c_markerCells + i] = sampleCell(outside[side][0], outside[side][1]);
+            if (quiet[side * c_markerCells + i] >= 0.0f) {
+                light += quiet[side * c_markerCells + i];
+                lightCount++;
+            }
+        }
+    }
+    if (lightCount < c_markerCells * 2) {
+        return false;
+    }
+    light /= lightCount;
+    if (light - dark < m_config.minContrast) {
+        return false;
+    }
+
+    // Border must be dark and quiet zone light, allowing one misread cell on each for glare and occlusion
+    const float threshold = 0.5f * (dark + light);
+    int errors = 0;
+    for (int r = 0; r < c_markerCells; r++) {
+        for (int c = 0; c < c_markerCells; c++) {
+            const bool border = (r == 0 || c == 0 || r == c_markerCells - 1 || c == c_markerCells - 1);
+            errors += (border && cells[r][c] > threshold) ? 1 : 0;
+        }
+    }
+    int quietErrors = 0;
+    for (float q : quiet) {
+        quietErrors += (q >= 0.0f && q < threshold) ? 1 : 0;
+    }
+    if (errors > 1 || quietErrors > 1) {
+        return false;
+    }
+
+    // Try each corner as marker top left. Grid axes run towards the next and previous corner.
+    const glm::ivec2 gridCorners[4] = {{0, 0}, {c_dataCells - 1, 0}, {c_dataCells - 1, c_dataCells - 1}, {0, c_dataCells - 1}};
+    for (int q = 0; q < 4; q++) {
+        const glm::ivec2 origin = gridCorners[q];
+        const glm::ivec2 axisX = (gridCorners[(q + 1) % 4] - origin) / (c_dataCells - 1);
+        const glm::ivec2 axisY = (gridCorners[(q + 3) % 4] - origin) / (c_dataCells - 1);
+
+        int bits[c_dataCells][c_dataCells];
+        for (int r = 0; r < c_dataCells; r++) {
+            for (int c = 0; c < c_dataCells; c++) {
+                const glm::ivec2 p = origin + axisX * c + axisY * r;
+                bits[r][c] = cells[p.y + 1][p.x + 1] > threshold ? 1 : 0;
+            }
+        }
+        if (bits[0][0] != 1 || bits[0][c_dataCells - 1] != 0 || bits[c_dataCells - 1][0] != 0 || bits[c_dataCells - 1][c_dataCells - 1] != 0) {
+            continue;
+        }
+
+        uint32_t code = 0;
+        for (int r = 0; r < c_dataCells; r++) {
+            for (int c = 0; c < c_dataCells; c++) {
+                const bool corner = (r == 0 || r == c_dataCells - 1) && (c == 0 || c == c_dataCells - 1);
+                if (!corner) {
+                    code = (code << 1) | bits[r][c];
+                }
+            }
+        }
+        const uint32_t id = code >> 4;
+        if (crc4(id) != (code & 0xf)) {
+            return false;
+        }
+
+        const std::array<glm::vec2, 4> input = corners;
+        for (int i = 0; i < 4; i++) {
+            corners[i] = input[(i + q) % 4];
+        }
+        outId = static_cast<MarkerTracker::MarkerId>(id);
+        return true;
+    }
+    return false;
+}
+
+bool FiducialDetector::solvePose(const varjo_CameraIntrinsics& intrinsics, int width, int height, Detection& detection) const
+{
+    const CameraModel camera(intrinsics, width, height);
+    if (camera.fx <= 0.0 || camera.fy <= 0.0) {
+        return false;
+    }
+
+    // Marker space: X right, Y up, Z out of marker face
+    const double s = 0.5 * m_config.markerSize;
+    const glm::dvec3 objectPoints[4] = {{-s, s, 0.0}, {s, s, 0.0}, {s, -s, 0.0}, {-s, -s, 0.0}};
+
+    // Initial pose from homography between marker plane and undistorted corners
+    glm::dvec2 planePoints[4];
+    glm::dvec2 imagePoints[4];
+    for (int i = 0; i < 4; i++) {
+        planePoints[i] = glm::dvec2(objectPoints[i]);
+        if (!camera.unproject(glm::dvec2(detection.corners[i]), imagePoints[i])) {
+            return false;
+        }
+    }
+    glm::dmat3 h;
+    if (!getHomography(planePoints, imagePoints, h)) {
+        return false;
+    }
+
+    double scale = 2.0 / (glm::length(h[0]) + glm::length(h[1]));
+    if (h[2].z < 0.0) {
+        scale = -scale;
+    }
+    glm::dmat3 r(h[0] * scale, h[1] * scale, glm::cross(h[0] * scale, h[1] * scale));
+    glm::dvec3 t = h[2] * scale;
+
+    // Nearest rotation matrix by iterating average with inverse transpose
+    for (int i = 0; i < 5; i++) {
+        r = 0.5 * (r + glm::transpose(glm::inverse(r)));
+    }
+
+    // Gauss-Newton refinement of rotation and translation on corner reprojection error
+    double residuals[8];
+    double error = getReprojError(camera, objectPoints, detection.corners, r, t, residuals);
+    for (int iteration = 0; iteration < c_poseIterations && error < 1e29; iteration++) {
+        double jacobian[8][6];
+        for (int p = 0; p < 6; p++) {
+            constexpr double eps = 1e-6;
+            glm::dvec3 dr(0.0);
+            glm::dvec3 dt(0.0);
+            (p < 3 ? dr : dt)[p % 3] = eps;
+            double shifted[8];
+            getReprojError(camera, objectPoints, detection.corners, getRotation(dr) * r, t + dt, shifted);
+            for (int i = 0; i < 8; i++) {
+                jacobian[i][p] = (shifted[i] - residuals[i]) / eps;
+            }
+        }
+
+        double normal[6][6] = {};
+        double gradient[6] = {};
+        for (int i = 0; i < 8; i++) {
+            for (int a = 0; a < 6; a++) {
+                gradient[a] -= jacobian[i][a] * residuals[i];
+                for (int b = 0; b < 6; b++) {
+                    normal[a][b] += jacobian[i][a] * jacobian[i][b];
+                }
+            }
+        }
+        for (int a = 0; a < 6; a++) {
+            normal[a][a] *= 1.0 + 1e-6;
+        }
+        if (!solveLinear(normal, gradient)) {
+            break;
+        }
+
+        const glm::dmat3 nextR = getRotation(glm::dvec3(gradient[0], gradient[1], gradient[2])) * r;
+        const glm::dvec3 nextT = t + glm::dvec3(gradient[3], gradient[4], gradient[5]);
+        double nextResiduals[8];
+        const double nextError = getReprojError(camera, objectPoints, detection.corners, nextR, nextT, nextResiduals);
+        if (nextError >= error) {
+            break;
+        }
+        r = nextR;
+        t = nextT;
+        error = nextError;
+        std::copy(nextResiduals, nextResiduals + 8, residuals);
+    }
+    if (error >= 1e29 || t.z <= 0.0) {
+        return false;
+    }
+
+    double sum = 0.0;
+    for (int i = 0; i < 4; i++) {
+        sum += std::sqrt(residuals[i * 2] * residuals[i * 2] + residuals[i * 2 + 1] * residuals[i * 2 + 1]);
+    }
+    detection.reprojError = sum / 4.0;
+
+    glm::dmat4 pose(r);
+    pose[3] = glm::dvec4(t, 1.0);
+    detection.cameraPose = glm::mat4x4(c_cvToCamera * pose);
+    return true;
+}
+
+}  // namespace VarjoExamples
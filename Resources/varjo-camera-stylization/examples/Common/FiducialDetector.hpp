@@ -0,0 +1,131 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "Globals.hpp"
+#include "ThreadPool.hpp"
+#include "DataStreamer.hpp"
+#include "MarkerTracker.hpp"
+#include "MemoryAccounting.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Fiducial detector finds square markers directly from the luma plane of color stream
+// frames, so it works without Varjo world markers and on recorded footage. Markers are 6x6 cell
+// squares: a black border ring around 4x4 data cells, surrounded by a white quiet zone of at least
+// one cell. Data corner cells give orientation (top left white, others black), and the remaining 12
+// cells hold an 8-bit id followed by its CRC-4, most significant bit first in row order. These ids
+// are independent of the Varjo marker id range. See renderMarker() for generating markers.
+//
+// Pipeline: luma is box decimated and thresholded against local min/max of 4x4 pixel tiles, both
+// in row bands on the thread pool. Dark regions are labeled with union-find per band and merged at
+// band seams. Each large enough region is fit with a quad from its convex hull, corner positions
+// are refined by fitting lines to region boundary pixels, and cells are sampled from full resolution
+// luma. Pose is solved from the four corners with the omnidir camera model of stream intrinsics,
+// starting from homography decomposition and refined with Gauss-Newton on reprojection error.
+
+//! CPU fiducial marker detector for color stream luma
+class FiducialDetector
+{
+public:
+    //! Detector configuration
+    struct Config {
+        int decimation = 2;         //!< Luma decimation factor for segmentation
+        int minContrast = 20;       //!< Minimum local luma range for thresholding
+        int minSide = 8;            //!< Minimum marker side in decimated pixels
+        float markerSize = 0.15f;   //!< Marker side length in meters, border included
+        double maxReprojError = 3;  //!< Maximum corner reprojection error in pixels for reporting pose
+    };
+
+    //! Detected marker
+    struct Detection {
+        MarkerTracker::MarkerId id = 0;    //!< Decoded marker id
+        std::array<glm::vec2, 4> corners;  //!< Corners in pixels: top left, top right, bottom right, bottom left
+        bool hasPose = false;              //!< Pose valid flag. Requires stream intrinsics.
+        glm::mat4x4 cameraPose{1.0f};      //!< Marker pose in camera space, camera looking towards -Z
+        double reprojError = 0.0;          //!< Mean corner reprojection error in pixels
+    };
+
+    //! Detector statistics
+    struct Stats {
+        int64_t frames = 0;            //!< Processed frames
+        int64_t candidates = 0;        //!< Quads found in last frame
+        int64_t detections = 0;        //!< Markers decoded in last frame
+        double detectTimeAvgMs = 0.0;  //!< Average detection time
+    };
+
+    //! Number of marker ids
+    static constexpr int c_markerIdCount = 256;
+
+    //! Construct detector. Segmentation runs on given thread pool.
+    FiducialDetector(ThreadPool& threadPool, const Config& config);
+
+    // Disable copy, move and assign
+    FiducialDetector(const FiducialDetector& other) = delete;
+    FiducialDetector(const FiducialDetector&& other) = delete;
+    FiducialDetector& operator=(const FiducialDetector& other) = delete;
+    FiducialDetector& operator=(const FiducialDetector&& other) = delete;
+
+    //! Detect markers from luma plane. Pose is solved if intrinsics are given.
+    void detect(const uint8_t* luma, size_t rowStride, int width, int height, const varjo_CameraIntrinsics* intrinsics,
+        std::vector<Detection>& outDetections);
+
+    //! Detect markers from color stream frame and update world space marker objects. Returns false for unsupported frames.
+    bool detect(const DataStreamer::Frame& frame, MarkerTracker::MarkerMap& outMarkers);
+
+    //! Returns detections of last processed frame
+    const std::vector<Detection>& getDetections() const { return m_detections; }
+
+    //! Returns detector statistics
+    Stats getStats() const { return m_stats; }
+
+    //! Render marker with one cell quiet zone as 8x8 cells of given size. Returns false for invalid id.
+    static bool renderMarker(MarkerTracker::MarkerId id, int cellSize, std::vector<uint8_t>& outLuma);
+
+private:
+    //! Dark region being fit as quad
+    struct Region {
+        int count = 0;                     //!< Pixel count
+        glm::ivec2 min{0};                 //!< Bounding box minimum
+        glm::ivec2 max{0};                 //!< Bounding box maximum, inclusive
+        std::vector<glm::ivec2> boundary;  //!< Boundary pixels
+    };
+
+    //! Decimate luma and compute thresholded image
+    void segment(const uint8_t* luma, size_t rowStride, int width, int height);
+
+    //! Label dark pixels and collect candidate regions
+    void label();
+
+    //! Fit quad to region. Returns false if region is not a quad.
+    bool fitQuad(const Region& region, std::array<glm::vec2, 4>& outCorners) const;
+
+    //! Sample cells and decode id. Reorders corners to marker orientation. Returns false if decoding fails.
+    bool decode(const uint8_t* luma, size_t rowStride, int width, int height, std::array<glm::vec2, 4>& corners, MarkerTracker::MarkerId& outId) const;
+
+    //! Solve marker pose from corners. Returns false if solving fails.
+    bool solvePose(const varjo_CameraIntrinsics& intrinsics, int width, int height, Detection& detection) const;
+
+private:
+    ThreadPool& m_threadPool;                                  //!< Worker threads
+    const Config m_config;                                     //!< Detector configuration
+    int m_width = 0;                                           //!< Decimated width
+    int m_height = 0;                                          //!< Decimated height
+    TrackedVector<uint8_t, MemoryTag::Markers> m_decimated;    //!< Decimated luma
+    TrackedVector<uint8_t, MemoryTag::Markers> m_binary;       //!< Thresholded image: 0 dark, 255 light, 127 low contrast
+    TrackedVector<uint8_t, MemoryTag::Markers> m_tileMin;      //!< Tile minimums
+    TrackedVector<uint8_t, MemoryTag::Markers> m_tileMax;      //!< Tile maximums
+    TrackedVector<int32_t, MemoryTag::Markers> m_parents;      //!< Union-find parents, -1 for light pixels
+    TrackedVector<int32_t, MemoryTag::Markers> m_regionIndex;  //!< Region index per root pixel
+    std::vector<Region> m_regions;                             //!< Candidate regions
+    std::vector<Detection> m_detections;                       //!< Detections of last frame
+    Stats m_stats{};                                           //!< Statistics
+    double m_detectTimeTotalMs = 0.0;                          //!< Total detection time
+};
+
+}  // namespace VarjoExamples
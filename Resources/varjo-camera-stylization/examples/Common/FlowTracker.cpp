@@ -0,0 +1,566 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "FlowTracker.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "SimdMath.hpp"
+
+using namespace VarjoExamples;
+
+namespace
+{
+// Smallest pyramid level side in pixels. Levels below it are not built.
+constexpr int c_minLevelSize = 32;
+
+// Points per tracking task
+constexpr int c_trackGrain = 8;
+
+// Largest tracking window radius and pixels, windows are kept on stack
+constexpr int c_maxWindowRadius = 15;
+constexpr int c_maxWindowSize = (2 * c_maxWindowRadius + 1) * (2 * c_maxWindowRadius + 1);
+
+// FAST circle of radius 3, clockwise from top
+constexpr int c_circle[16][2] = {
+    {0, -3}, {1, -3}, {2, -2}, {3, -1}, {3, 0}, {3, 1}, {2, 2}, {1, 3}, {0, 3}, {-1, 3}, {-2, 2}, {-3, 1}, {-3, 0}, {-3, -1}, {-2, -2}, {-1, -3}};
+
+// Call function with SIMD variant tag
+template <typename F>
+void dispatchSimd(SimdLevel level, F&& func)
+{
+    switch (level) {
+        case SimdLevel::AVX2: func(Simd::AVX2()); break;
+        case SimdLevel::SSE41: func(Simd::SSE41()); break;
+        default: func(Simd::Scalar()); break;
+    }
+}
+
+//---------------------------------------------------------------------------
+// Pyramid downsampling: average of vertical pairs, then of horizontal pairs, both rounding up like
+// _mm_avg_epu8, so that all variants give identical levels.
+
+// Downsample two source rows to output pixels [x0, x1)
+template <typename V>
+void downsampleRow(const uint8_t* row0, const uint8_t* row1, uint8_t* out, int x0, int x1);
+
+template <>
+void downsampleRow<Simd::Scalar>(const uint8_t* row0, const uint8_t* row1, uint8_t* out, int x0, int x1)
+{
+    for (int x = x0; x < x1; x++) {
+        const int left = (row0[2 * x] + row1[2 * x] + 1) >> 1;
+        const int right = (row0[2 * x + 1] + row1[2 * x + 1] + 1) >> 1;
+        out[x] = static_cast<uint8_t>((left + right + 1) >> 1);
+    }
+}
+
+template <>
+void downsampleRow<Simd::SSE41>(const uint8_t* row0, const uint8_t* row1, uint8_t* out, int x0, int x1)
+{
+    const __m128i ones8 = _mm_set1_epi8(1);
+    const __m128i ones16 = _mm_set1_epi16(1);
+    int x = x0;
+    for (; x + 16 <= x1; x += 16) {
+        const __m128i* src0 = reinterpret_cast<const __m128i*>(row0 + 2 * x);
+        const __m128i* src1 = reinterpret_cast<const __m128i*>(row1 + 2 * x);
+        const __m128i a = _mm_avg_epu8(_mm_loadu_si128(src0), _mm_loadu_si128(src1));
+        const __m128i b = _mm_avg_epu8(_mm_loadu_si128(src0 + 1), _mm_loadu_si128(src1 + 1));
+        const __m128i sumA = _mm_srli_epi16(_mm_add_epi16(_mm_maddubs_epi16(a, ones8), ones16), 1);
+        const __m128i sumB = _mm_srli_epi16(_mm_add_epi16(_mm_maddubs_epi16(b, ones8), ones16), 1);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(sumA, sumB));
+    }
+    downsampleRow<Simd::Scalar>(row0, row1, out, x, x1);
+}
+
+template <>
+void downsampleRow<Simd::AVX2>(const uint8_t* row0, const uint8_t* row1, uint8_t* out, int x0, int x1)
+{
+    const __m256i ones8 = _mm256_set1_epi8(1);
+    const __m256i ones16 = _mm256_set1_epi16(1);
+    int x = x0;
+    for (; x + 32 <= x1; x += 32) {
+        const __m256i* src0 = reinterpret_cast<const __m256i*>(row0 + 2 * x);
+        const __m256i* src1 = reinterpret_cast<const __m256i*>(row1 + 2 * x);
+        const __m256i a = _mm256_avg_epu8(_mm256_loadu_si256(src0), _mm256_loadu_si256(src1));
+        const __m256i b = _mm256_avg_epu8(_mm256_loadu_si256(src0 + 1), _mm256_loadu_si256(src1 + 1));
+        const __m256i sumA = _mm256_srli_epi16(_mm256_add_epi16(_mm256_maddubs_epi16(a, ones8), ones16), 1);
+        const __m256i sumB = _mm256_srli_epi16(_mm256_add_epi16(_mm256_maddubs_epi16(b, ones8), ones16), 1);
+
+        // Pack works within 128-bit lanes, restore pixel order across lanes
+        const __m256i packed = _mm256_packus_epi16(sumA, sumB);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), _mm256_permute4x64_epi64(packed, 0xd8));
+    }
+    downsampleRow<Simd::SSE41>(row0, row1, out, x, x1);
+}
+
+//---------------------------------------------------------------------------
+// Corner detection
+
+// Returns FAST-9 score of pixel: sum of differences beyond threshold on circle, zero if not a corner
+int getFastScore(const uint8_t* p, const int (&offsets)[16], int threshold)
+{
+    const int center = p[0];
+    const int high = center + threshold;
+    const int low = center - threshold;
+
+    // Any 9 contiguous circle pixels include at least two of the four at right angles
+    int brightCardinal = 0;
+    int darkCardinal = 0;
+    for (int i = 0; i < 16; i += 4) {
+        brightCardinal += p[offsets[i]] > high ? 1 : 0;
+        darkCardinal += p[offsets[i]] < low ? 1 : 0;
+    }
+    if (brightCardinal < 2 && darkCardinal < 2) {
+        return 0;
+    }
+
+    uint32_t bright = 0;
+    uint32_t dark = 0;
+    for (int i = 0; i < 16; i++) {
+        const int v = p[offsets[i]];
+        bright |= static_cast<uint32_t>(v > high) << i;
+        dark |= static_cast<uint32_t>(v < low) << i;
+    }
+
+    // Arc of 9 contiguous set bits, wrapping around
+    const auto hasArc = [](uint32_t mask) {
+        const uint32_t m = mask | (mask << 16);
+        uint32_t run = m;
+        for (int i = 1; i < 9; i++) {
+            run &= m >> i;
+        }
+        return run != 0;
+    };
+    const bool isBright = hasArc(bright);
+    if (!isBright && !hasArc(dark)) {
+        return 0;
+    }
+
+    int score = 0;
+    for (int i = 0; i < 16; i++) {
+        const int v = p[offsets[i]];
+        score += isBright ? std::max(v - high, 0) : std::max(low - v, 0);
+    }
+    return std::max(score, 1);
+}
+
+//---------------------------------------------------------------------------
+// Lucas-Kanade
+
+// Bilinear sample of 8-bit image with precomputed weights
+inline float sampleBilinear(const uint8_t* p, int stride, float w00, float w01, float w10, float w11)
+{
+    return p[0] * w00 + p[1] * w01 + p[stride] * w10 + p[stride + 1] * w11;
+}
+
+// Returns true if window of radius plus one pixel for gradients and bilinear taps fits in image
+inline bool isWindowInside(const glm::vec2& p, int radius, int width, int height)
+{
+    return p.x >= radius + 1 && p.y >= radius + 1 && p.x < width - radius - 2 && p.y < height - radius - 2;
+}
+
+}  // namespace
+
+namespace VarjoExamples
+{
+FlowTracker::FlowTracker(ThreadPool& threadPool, const Config& config)
+    : m_threadPool(threadPool)
+    , m_config(config)
+{
+    m_tracks.reserve(m_config.maxFeatures);
+    m_candidates.reserve(m_config.maxFeatures);
+    m_trackLost.reserve(m_config.maxFeatures);
+}
+
+void FlowTracker::reset()
+{
+    m_tracks.clear();
+    m_hasPrevious = false;
+    m_frameNumber = -1;
+}
+
+bool FlowTracker::update(const uint8_t* luma, int width, int height, size_t rowStride, int64_t frameNumber)
+{
+    const int64_t begin = getTimestampNs();
+
+    // Size change restarts tracking
+    const Pyramid& previous = m_pyramids[m_current];
+    if (previous.widths.empty() || previous.widths[0] != width || previous.heights[0] != height) {
+        reset();
+    }
+
+    m_current ^= 1;
+    buildPyramid(m_pyramids[m_current], luma, width, height, rowStride);
+    const int64_t pyramidEnd = getTimestampNs();
+    m_frameNumber = frameNumber;
+
+    // Follow previous tracks into current frame
+    const bool tracking = m_hasPrevious;
+    m_stats.tracked = 0;
+    m_stats.lost = 0;
+    if (tracking && !m_tracks.empty()) {
+        m_candidates.assign(m_tracks.begin(), m_tracks.end());
+        m_trackLost.assign(m_candidates.size(), 0);
+        m_threadPool.parallelFor(static_cast<int>(m_candidates.size()), [&](int i0, int i1) {
+            for (int i = i0; i < i1; i++) {
+                Track& track = m_candidates[i];
+                glm::vec2 position;
+                if (trackPoint(track.position, 0, position, track.error)) {
+                    track.motion = position - track.position;
+                    track.position = position;
+                    track.age++;
+                } else {
+                    m_trackLost[i] = 1;
+                }
+            }
+        }, c_trackGrain);
+
+        m_tracks.clear();
+        for (size_t i = 0; i < m_candidates.size(); i++) {
+            if (!m_trackLost[i]) {
+                m_tracks.push_back(m_candidates[i]);
+            }
+        }
+        m_stats.tracked = static_cast<int64_t>(m_tracks.size());
+        m_stats.lost = static_cast<int64_t>(m_candidates.size() - m_tracks.size());
+    }
+    const int64_t trackEnd = getTimestampNs();
+
+    m_stats.detected = 0;
+    if (static_cast<int>(m_tracks.size()) < m_config.maxFeatures) {
+        detectCorners();
+    }
+    const int64_t detectEnd = getTimestampNs();
+
+    if (m_config.denseStep > 0) {
+        trackDense();
+    }
+    m_hasPrevious = true;
+
+    const int64_t end = getTimestampNs();
+    m_stats.frames++;
+    m_stats.pyramidTimeNs += pyramidEnd - begin;
+    m_stats.trackTimeNs += trackEnd - pyramidEnd;
+    m_stats.detectTimeNs += detectEnd - trackEnd;
+    m_stats.denseTimeNs += end - detectEnd;
+    m_stats.lastTimeNs = end - begin;
+    m_stats.totalTimeNs += m_stats.lastTimeNs;
+    m_stats.maxTimeNs = std::max(m_stats.maxTimeNs, m_stats.lastTimeNs);
+
+    if (m_metrics) {
+        m_metrics->recordTime(m_updateMetric, m_stats.lastTimeNs);
+        m_metrics->set(m_tracksMetric, static_cast<int64_t>(m_tracks.size()));
+    }
+    return tracking;
+}
+
+void FlowTracker::setMetrics(MetricsRegistry* metrics)
+{
+    m_metrics = metrics;
+    if (m_metrics) {
+        m_updateMetric = m_metrics->addMetric("Flow: update", MetricsRegistry::Kind::Timer);
+        m_tracksMetric = m_metrics->addMetric("Flow: tracks", MetricsRegistry::Kind::Gauge);
+    }
+}
+
+void FlowTracker::buildPyramid(Pyramid& pyramid, const uint8_t* luma, int width, int height, size_t rowStride)
+{
+    int levels = 1;
+    while (levels < m_config.levels && std::min(width, height) >> levels >= c_minLevelSize) {
+        levels++;
+    }
+    pyramid.levels.resize(levels);
+    pyramid.widths.resize(levels);
+    pyramid.heights.resize(levels);
+    for (int level = 0; level < levels; level++) {
+        pyramid.widths[level] = width >> level;
+        pyramid.heights[level] = height >> level;
+        pyramid.levels[level].resize(static_cast<size_t>(pyramid.widths[level]) * pyramid.heights[level]);
+    }
+
+    // Luma is only valid during the stream callback, so full resolution is copied too
+    m_threadPool.parallelFor(height, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            std::memcpy(pyramid.levels[0].data() + static_cast<size_t>(y) * width, luma + y * rowStride, width);
+        }
+    });
+
+    dispatchSimd(m_config.simd, [&](auto simd) {
+        using V = decltype(simd);
+        for (int level = 1; level < levels; level++) {
+            const int sourceWidth = pyramid.widths[level - 1];
+            const int levelWidth = pyramid.widths[level];
+            const uint8_t* source = pyramid.levels[level - 1].data();
+            uint8_t* target = pyramid.levels[level].data();
+            m_threadPool.parallelFor(pyramid.heights[level], [&](int y0, int y1) {
+                for (int y = y0; y < y1; y++) {
+                    const uint8_t* row0 = source + static_cast<size_t>(2 * y) * sourceWidth;
+                    downsampleRow<V>(row0, row0 + sourceWidth, target + static_cast<size_t>(y) * levelWidth, 0, levelWidth);
+                }
+            });
+        }
+    });
+}
+
+bool FlowTracker::trackPoint(const glm::vec2& position, int lastLevel, glm::vec2& outPosition, float& outError) const
+{
+    const Pyramid& prev = m_pyramids[m_current ^ 1];
+    const Pyramid& cur = m_pyramids[m_current];
+    const int levels = static_cast<int>(std::min(prev.levels.size(), cur.levels.size()));
+    if (lastLevel >= levels) {
+        return false;
+    }
+
+    const int radius = m_config.windowRadius;
+    const int side = 2 * radius + 1;
+    const int count = side * side;
+
+    if (radius > c_maxWindowRadius) {
+        return false;
+    }
+
+    // Template and gradients of previous frame window, on stack for concurrent calls
+    float patch[(2 * c_maxWindowRadius + 3) * (2 * c_maxWindowRadius + 3)];
+    float templ[c_maxWindowSize];
+    float gradX[c_maxWindowSize];
+    float gradY[c_maxWindowSize];
+
+    glm::vec2 guess(0.0f);
+    glm::vec2 flow(0.0f);
+    glm::vec2 point(0.0f);
+    for (int level = levels - 1; level >= lastLevel; level--) {
+        const float scale = 1.0f / static_cast<float>(1 << level);
+        point = (position + 0.5f) * scale - 0.5f;
+        const int width = prev.widths[level];
+        const int height = prev.heights[level];
+        const uint8_t* prevImage = prev.levels[level].data();
+        const uint8_t* curImage = cur.levels[level].data();
+
+        // Window must fit at last level. Coarse level windows are moved inside the image instead, since
+        // motion of a nearby window is still a good guess for the finer levels.
+        if (!isWindowInside(point, radius, width, height)) {
+            if (level == lastLevel) {
+                return false;
+            }
+            point = glm::clamp(point, glm::vec2(static_cast<float>(radius + 1)), glm::vec2(width - radius - 2.01f, height - radius - 2.01f));
+        }
+
+        // All window pixels share the fractional position, so bilinear weights are computed once. Window is
+        // sampled with a one pixel border, from which gradients are central differences.
+        const int ix = static_cast<int>(std::floor(point.x));
+        const int iy = static_cast<int>(std::floor(point.y));
+        const float fx = point.x - ix;
+        const float fy = point.y - iy;
+        const float w00 = (1.0f - fx) * (1.0f - fy), w01 = fx * (1.0f - fy), w10 = (1.0f - fx) * fy, w11 = fx * fy;
+        const int patchSide = side + 2;
+        for (int py = 0; py < patchSide; py++) {
+            const uint8_t* row = prevImage + static_cast<size_t>(iy + py - radius - 1) * width + (ix - radius - 1);
+            for (int px = 0; px < patchSide; px++) {
+                patch[py * patchSide + px] = sampleBilinear(row + px, width, w00, w01, w10, w11);
+            }
+        }
+        float gxx = 0.0f, gxy = 0.0f, gyy = 0.0f;
+        for (int wy = 0; wy < side; wy++) {
+            const float* p = patch + (wy + 1) * patchSide + 1;
+            for (int wx = 0; wx < side; wx++) {
+                const int i = wy * side + wx;
+                templ[i] = p[wx];
+                gradX[i] = 0.5f * (p[wx + 1] - p[wx - 1]);
+                gradY[i] = 0.5f * (p[wx + patchSide] - p[wx - patchSide]);
+                gxx += gradX[i] * gradX[i];
+                gxy += gradX[i] * gradY[i];
+                gyy += gradY[i] * gradY[i];
+            }
+        }
+
+        // Smallest eigenvalue tells if window has texture in both directions
+        const float minEigen = 0.5f * (gxx + gyy - std::sqrt((gxx - gyy) * (gxx - gyy) + 4.0f * gxy * gxy)) / count;
+        const float det = gxx * gyy - gxy * gxy;
+        if (minEigen < m_config.minEigen || det <= 0.0f) {
+            if (level == lastLevel) {
+                return false;
+            }
+            guess *= 2.0f;
+            continue;
+        }
+
+        // Gauss-Newton iteration on window translation
+        flow = glm::vec2(0.0f);
+        for (int iteration = 0; iteration < m_config.iterations; iteration++) {
+            const glm::vec2 q = point + guess + flow;
+            if (!isWindowInside(q, radius, width, height)) {
+                if (level == lastLevel) {
+                    return false;
+                }
+                break;
+            }
+            const int qx = static_cast<int>(std::floor(q.x));
+            const int qy = static_cast<int>(std::floor(q.y));
+            const float ux = q.x - qx;
+            const float uy = q.y - qy;
+            const float v00 = (1.0f - ux) * (1.0f - uy), v01 = ux * (1.0f - uy), v10 = (1.0f - ux) * uy, v11 = ux * uy;
+            float bx = 0.0f, by = 0.0f;
+            for (int wy = 0; wy < side; wy++) {
+                const uint8_t* row = curImage + static_cast<size_t>(qy + wy - radius) * width + (qx - radius);
+                for (int wx = 0; wx < side; wx++) {
+                    const int i = wy * side + wx;
+                    const float diff = templ[i] - sampleBilinear(row + wx, width, v00, v01, v10, v11);
+                    bx += diff * gradX[i];
+                    by += diff * gradY[i];
+                }
+            }
+            const glm::vec2 delta((gyy * bx - gxy * by) / det, (gxx * by - gxy * bx) / det);
+            flow += delta;
+            if (glm::dot(delta, delta) < m_config.epsilon * m_config.epsilon) {
+                break;
+            }
+        }
+
+        if (level > lastLevel) {
+            guess = 2.0f * (guess + flow);
+        }
+    }
+
+    // Window match error at final position
+    const glm::vec2 q = point + guess + flow;
+    const int width = cur.widths[lastLevel];
+    if (!isWindowInside(q, radius, width, cur.heights[lastLevel])) {
+        return false;
+    }
+    const int ix = static_cast<int>(std::floor(point.x));
+    const int iy = static_cast<int>(std::floor(point.y));
+    const float fx = point.x - ix;
+    const float fy = point.y - iy;
+    const int qx = static_cast<int>(std::floor(q.x));
+    const int qy = static_cast<int>(std::floor(q.y));
+    const float ux = q.x - qx;
+    const float uy = q.y - qy;
+    const uint8_t* prevImage = prev.levels[lastLevel].data();
+    const uint8_t* curImage = cur.levels[lastLevel].data();
+    float errorSum = 0.0f;
+    for (int wy = -radius; wy <= radius; wy++) {
+        for (int wx = -radius; wx <= radius; wx++) {
+            const float a = sampleBilinear(prevImage + static_cast<size_t>(iy + wy) * width + ix + wx, width, (1.0f - fx) * (1.0f - fy), fx * (1.0f - fy),
+                (1.0f - fx) * fy, fx * fy);
+            const float b = sampleBilinear(curImage + static_cast<size_t>(qy + wy) * width + qx + wx, width, (1.0f - ux) * (1.0f - uy), ux * (1.0f - uy),
+                (1.0f - ux) * uy, ux * uy);
+            errorSum += std::abs(a - b);
+        }
+    }
+    const float error = errorSum / count;
+    if (error > m_config.maxError) {
+        return false;
+    }
+
+    outError = error;
+    outPosition = (q + 0.5f) * static_cast<float>(1 << lastLevel) - 0.5f;
+    return true;
+}
+
+void FlowTracker::detectCorners()
+{
+    const Pyramid& pyramid = m_pyramids[m_current];
+    const int level = std::min(m_config.detectLevel, static_cast<int>(pyramid.levels.size()) - 1);
+    const int width = pyramid.widths[level];
+    const int height = pyramid.heights[level];
+    const uint8_t* image = pyramid.levels[level].data();
+    const int cellSize = std::max(m_config.minDistance >> level, 4);
+    const int cellsX = width / cellSize;
+    const int cellsY = height / cellSize;
+    const float scale = static_cast<float>(1 << level);
+
+    // Cells holding tracked points are not searched
+    m_occupied.assign(static_cast<size_t>(cellsX) * cellsY, 0);
+    for (const Track& track : m_tracks) {
+        const int cx = static_cast<int>(((track.position.x + 0.5f) / scale - 0.5f) / cellSize);
+        const int cy = static_cast<int>(((track.position.y + 0.5f) / scale - 0.5f) / cellSize);
+        if (cx >= 0 && cy >= 0 && cx < cellsX && cy < cellsY) {
+            m_occupied[static_cast<size_t>(cy) * cellsX + cx] = 1;
+        }
+    }
+
+    int offsets[16];
+    for (int i = 0; i < 16; i++) {
+        offsets[i] = c_circle[i][1] * width + c_circle[i][0];
+    }
+
+    // Strongest corner per free cell. Border keeps circle and tracking window inside image.
+    const int border = std::max(3, m_config.windowRadius + 2);
+    m_cellCorners.resize(static_cast<size_t>(cellsX) * cellsY);
+    m_threadPool.parallelFor(cellsY, [&](int cy0, int cy1) {
+        for (int cy = cy0; cy < cy1; cy++) {
+            for (int cx = 0; cx < cellsX; cx++) {
+                const size_t cell = static_cast<size_t>(cy) * cellsX + cx;
+                Corner best = {0, 0, 0};
+                if (!m_occupied[cell]) {
+                    const int y0 = std::max(cy * cellSize, border);
+                    const int y1 = std::min((cy + 1) * cellSize, height - border);
+                    const int x0 = std::max(cx * cellSize, border);
+                    const int x1 = std::min((cx + 1) * cellSize, width - border);
+                    for (int y = y0; y < y1; y++) {
+                        const uint8_t* row = image + static_cast<size_t>(y) * width;
+                        for (int x = x0; x < x1; x++) {
+                            const int score = getFastScore(row + x, offsets, m_config.fastThreshold);
+                            if (score > best.score) {
+                                best = {x, y, score};
+                            }
+                        }
+                    }
+                }
+                m_cellCorners[cell] = best;
+            }
+        }
+    });
+
+    // Strongest first, position breaks ties so that result does not depend on task split
+    m_corners.clear();
+    for (const Corner& corner : m_cellCorners) {
+        if (corner.score > 0) {
+            m_corners.push_back(corner);
+        }
+    }
+    std::sort(m_corners.begin(), m_corners.end(), [](const Corner& a, const Corner& b) {
+        return a.score != b.score ? a.score > b.score : (a.y != b.y ? a.y < b.y : a.x < b.x);
+    });
+
+    const size_t free = static_cast<size_t>(m_config.maxFeatures) - m_tracks.size();
+    for (size_t i = 0; i < std::min(free, m_corners.size()); i++) {
+        Track track;
+        track.id = m_nextId++;
+        track.position = (glm::vec2(static_cast<float>(m_corners[i].x), static_cast<float>(m_corners[i].y)) + 0.5f) * scale - 0.5f;
+        m_tracks.push_back(track);
+        m_stats.detected++;
+    }
+}
+
+void FlowTracker::trackDense()
+{
+    const Pyramid& pyramid = m_pyramids[m_current];
+    const int level = std::min(m_config.denseLevel, static_cast<int>(pyramid.levels.size()) - 1);
+    const int step = m_config.denseStep << level;
+    m_flowWidth = pyramid.widths[0] / step;
+    m_flowHeight = pyramid.heights[0] / step;
+    m_flow.assign(static_cast<size_t>(m_flowWidth) * m_flowHeight, glm::vec2(0.0f));
+    m_flowValid.assign(m_flow.size(), 0);
+    if (!m_hasPrevious) {
+        return;
+    }
+
+    m_threadPool.parallelFor(m_flowHeight, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            for (int x = 0; x < m_flowWidth; x++) {
+                const size_t cell = static_cast<size_t>(y) * m_flowWidth + x;
+                const glm::vec2 center(step * (x + 0.5f) - 0.5f, step * (y + 0.5f) - 0.5f);
+                glm::vec2 position;
+                float error = 0.0f;
+                if (trackPoint(center, level, position, error)) {
+                    m_flow[cell] = position - center;
+                    m_flowValid[cell] = 1;
+                }
+            }
+        }
+    });
+}
+
+}  // namespace VarjoExamples
@@ -0,0 +1,172 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "Globals.hpp"
+#include "KernelConfig.hpp"
+#include "ThreadPool.hpp"
+#include "MetricsRegistry.hpp"
+#include "MemoryAccounting.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Flow tracker estimates motion of the real scene between consecutive camera frames with
+// pyramidal Lucas-Kanade on the luma plane. Image pyramid is built with SIMD by 2x2 averaging. Each
+// frame, tracked points are followed from the previous frame coarse to fine, and points that leave
+// the image, lose texture or no longer match their window are dropped. Free image area is then
+// refilled with FAST-9 corners detected on a coarser pyramid level, at most one per cell of minimum
+// distance, strongest first. Points keep their id across frames, so they can be used as tracks.
+//
+// Feature budget bounds the work: tracking cost is linear in tracked points and corners are only
+// detected while the budget is not full. Optional dense flow tracks a regular grid on a coarse
+// pyramid level every frame and costs a fixed amount on top of the budget.
+//
+// Positions and motions are in source pixels of the luma plane, pixel centers at integers.
+
+//! Pyramidal Lucas-Kanade point tracker for camera luma
+class FlowTracker
+{
+public:
+    //! Tracker configuration
+    struct Config {
+        int levels = 4;                      //!< Pyramid levels including full resolution
+        int windowRadius = 7;                //!< Tracking window radius in pixels of each level, up to 15
+        int iterations = 10;                 //!< Largest Gauss-Newton iterations per level
+        float epsilon = 0.02f;               //!< Update length in pixels that ends iteration
+        float minEigen = 4.0f;               //!< Smallest gradient matrix eigenvalue per window pixel for a trackable window
+        float maxError = 10.0f;              //!< Largest mean absolute luma difference of tracked window
+        int maxFeatures = 256;               //!< Feature budget, tracked points at most
+        int detectLevel = 1;                 //!< Pyramid level of corner detection
+        int fastThreshold = 16;              //!< FAST luma difference threshold
+        int minDistance = 24;                //!< Minimum distance between points in source pixels
+        int denseLevel = 2;                  //!< Pyramid level of dense flow
+        int denseStep = 0;                   //!< Dense flow grid step in pixels of dense level, zero to disable
+        SimdLevel simd = getMaxSimdLevel();  //!< SIMD variant of pyramid building
+    };
+
+    //! Tracked point
+    struct Track {
+        int64_t id = 0;            //!< Track id, unique over tracker lifetime
+        glm::vec2 position{0.0f};  //!< Position in current frame
+        glm::vec2 motion{0.0f};    //!< Motion from previous frame, zero for new points
+        int age = 0;               //!< Frames tracked, zero for points detected in current frame
+        float error = 0.0f;        //!< Mean absolute luma difference of tracked window
+    };
+
+    //! Tracker statistics
+    struct Stats {
+        int64_t frames = 0;         //!< Processed frames
+        int64_t tracked = 0;        //!< Points tracked into last frame
+        int64_t lost = 0;           //!< Points lost in last frame
+        int64_t detected = 0;       //!< Points added in last frame
+        int64_t pyramidTimeNs = 0;  //!< Total pyramid time
+        int64_t trackTimeNs = 0;    //!< Total point tracking time
+        int64_t detectTimeNs = 0;   //!< Total corner detection time
+        int64_t denseTimeNs = 0;    //!< Total dense flow time
+        int64_t lastTimeNs = 0;     //!< Duration of last update
+        int64_t totalTimeNs = 0;    //!< Total duration of updates
+        int64_t maxTimeNs = 0;      //!< Longest update
+    };
+
+    //! Construct tracker running on given thread pool
+    FlowTracker(ThreadPool& threadPool, const Config& config);
+
+    // Disable copy, move and assign
+    FlowTracker(const FlowTracker& other) = delete;
+    FlowTracker(const FlowTracker&& other) = delete;
+    FlowTracker& operator=(const FlowTracker& other) = delete;
+    FlowTracker& operator=(const FlowTracker&& other) = delete;
+
+    //! Track points from previous frame to given 8-bit luma plane and refill feature budget. Frame size change
+    //! restarts tracking. Returns true if points were tracked from a previous frame. Call from one thread only.
+    bool update(const uint8_t* luma, int width, int height, size_t rowStride, int64_t frameNumber);
+
+    //! Drop tracks and previous frame
+    void reset();
+
+    //! Returns tracked points of current frame
+    const std::vector<Track>& getTracks() const { return m_tracks; }
+
+    //! Returns dense flow grid columns, zero if dense flow is disabled
+    int getFlowWidth() const { return m_flowWidth; }
+
+    //! Returns dense flow grid rows
+    int getFlowHeight() const { return m_flowHeight; }
+
+    //! Returns dense flow grid step in source pixels. Cell (x, y) is centered at step * (x + 0.5, y + 0.5) - 0.5.
+    int getFlowStep() const { return m_config.denseStep << m_config.denseLevel; }
+
+    //! Returns dense flow from previous frame per grid cell in source pixels, row order
+    const std::vector<glm::vec2>& getFlow() const { return m_flow; }
+
+    //! Returns dense flow valid flag per grid cell: 0 where cell has too little texture or was lost
+    const std::vector<uint8_t>& getFlowValid() const { return m_flowValid; }
+
+    //! Returns frame number of current frame, -1 if none
+    int64_t getFrameNumber() const { return m_frameNumber; }
+
+    //! Returns tracker statistics
+    const Stats& getStats() const { return m_stats; }
+
+    //! Register update timer and track count metrics to given registry. Pass null to stop publishing.
+    void setMetrics(MetricsRegistry* metrics);
+
+private:
+    //! Image pyramid, level 0 at full resolution
+    struct Pyramid {
+        std::vector<TrackedVector<uint8_t, MemoryTag::Stream>> levels;  //!< Level pixels, rows packed
+        std::vector<int> widths;                                        //!< Level widths
+        std::vector<int> heights;                                       //!< Level heights
+    };
+
+    //! Corner candidate
+    struct Corner {
+        int x;      //!< Column in detection level
+        int y;      //!< Row in detection level
+        int score;  //!< Sum of threshold exceeding differences on circle, zero for no corner
+    };
+
+    //! Build pyramid of luma plane
+    void buildPyramid(Pyramid& pyramid, const uint8_t* luma, int width, int height, size_t rowStride);
+
+    //! Track point from previous to current pyramid down to given level. Position and result are in source pixels.
+    //! Returns false if point is lost, in which case error is not set.
+    bool trackPoint(const glm::vec2& position, int lastLevel, glm::vec2& outPosition, float& outError) const;
+
+    //! Detect strongest corner of each cell without tracked points and add strongest ones until feature budget is full
+    void detectCorners();
+
+    //! Track dense grid on dense level
+    void trackDense();
+
+private:
+    ThreadPool& m_threadPool;    //!< Worker threads
+    const Config m_config;       //!< Tracker configuration
+    Pyramid m_pyramids[2];       //!< Previous and current frame pyramids
+    int m_current = 0;           //!< Index of current pyramid
+    bool m_hasPrevious = false;  //!< Previous pyramid holds a frame of current size
+    int64_t m_frameNumber = -1;  //!< Current frame number
+    int64_t m_nextId = 0;        //!< Id of next new track
+
+    std::vector<Track> m_tracks;        //!< Tracks of current frame
+    std::vector<Track> m_candidates;    //!< Tracks being followed into current frame
+    std::vector<uint8_t> m_trackLost;   //!< Lost flag per candidate
+    std::vector<Corner> m_cellCorners;  //!< Strongest corner per minimum distance cell, zero score for none
+    std::vector<Corner> m_corners;      //!< Corner candidates of free cells, strongest first
+    std::vector<uint8_t> m_occupied;    //!< Occupied flag per minimum distance cell
+
+    int m_flowWidth = 0;               //!< Dense flow grid columns
+    int m_flowHeight = 0;              //!< Dense flow grid rows
+    std::vector<glm::vec2> m_flow;     //!< Dense flow per cell
+    std::vector<uint8_t> m_flowValid;  //!< Dense flow valid flag per cell
+    Stats m_stats{};                   //!< Tracker statistics
+
+    MetricsRegistry* m_metrics = nullptr;                               //!< Metrics registry, null if not published
+    MetricsRegistry::Id m_updateMetric = MetricsRegistry::c_invalidId;  //!< Update timer
+    MetricsRegistry::Id m_tracksMetric = MetricsRegistry::c_invalidId;  //!< Tracked point gauge
+};
+
+}  // namespace VarjoExamples
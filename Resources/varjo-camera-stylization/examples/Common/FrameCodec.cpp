@@ -0,0 +1,725 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "FrameCodec.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cstring>
+#include <cstdlib>
+#include <emmintrin.h>
+
+using namespace VarjoExamples;
+
+namespace
+{
+// Frame magic 'VFC1'
+constexpr uint32_t c_magic = 0x31434656;
+
+// Format codes in frame header
+constexpr uint8_t c_formatYUV422 = 0;
+constexpr uint8_t c_formatNV12 = 1;
+
+// Frame header flag for keyframes
+constexpr uint16_t c_flagKeyframe = 1 << 0;
+
+// Maximum slice count
+constexpr int c_maxSlices = 256;
+
+// rANS probability precision, total frequency and lower bound of normalized state. State is
+// renormalized in 16-bit words, so decoder reads at most one word per symbol.
+constexpr int c_probBits = 12;
+constexpr uint32_t c_probScale = 1u << c_probBits;
+constexpr uint32_t c_ransLow = 1u << 16;
+
+// Interleaved rANS states
+constexpr int c_ransStates = 4;
+
+// Plane codings
+constexpr uint8_t c_codingRaw = 0;
+constexpr uint8_t c_codingRans = 1;
+
+//! Row predictors. Row above, previous frame and previous frame row above decode with SIMD.
+enum class Predictor : uint8_t {
+    Previous = 0,  //!< Same pixel in previous frame
+    PreviousUp,    //!< Previous frame plus vertical change in current frame
+    Up,            //!< Pixel above
+    Median,        //!< Median edge detector of left, above and above left
+    Left,          //!< Pixel on the left
+    Count
+};
+
+#pragma pack(push, 1)
+
+//! Encoded frame header, followed by slice sizes and slices
+struct FrameHeader {
+    uint32_t magic;       //!< Frame magic
+    uint8_t format;       //!< Format code
+    uint8_t reserved;     //!< Reserved
+    uint16_t flags;       //!< Frame flags
+    int32_t width;        //!< Frame width
+    int32_t height;       //!< Frame height
+    uint16_t sliceCount;  //!< Number of slices
+    uint16_t reserved2;   //!< Reserved
+};
+
+//! Plane header inside slice, preceded by per row predictors and followed by coded data
+struct PlaneHeader {
+    uint8_t coding;        //!< Plane coding
+    uint8_t reserved;      //!< Reserved
+    uint16_t symbolCount;  //!< Number of frequency table entries (rANS)
+    uint32_t size;         //!< Coded data size in bytes, excluding frequency table
+};
+
+#pragma pack(pop)
+
+//! rANS decoding table entry
+struct DecodeEntry {
+    uint16_t freq;  //!< Symbol frequency
+    uint16_t bias;  //!< Slot offset from symbol start
+    uint8_t value;  //!< Decoded residual
+};
+
+//! Plane rows of one slice
+struct PlaneRows {
+    int row0 = 0;  //!< First row in plane
+    int row1 = 0;  //!< End row in plane
+    int step = 1;  //!< Distance to left neighbour of same component
+};
+
+// Returns chroma plane row count
+int getChromaRows(varjo_TextureFormat format, int height) { return (format == varjo_TextureFormat_NV12) ? (height + 1) / 2 : height; }
+
+// Returns luma and chroma rows of slice
+void getSliceRows(varjo_TextureFormat format, int height, int sliceCount, int slice, PlaneRows& outLuma, PlaneRows& outChroma)
+{
+    // Even slice heights keep NV12 chroma rows in one slice
+    int rowsPerSlice = (height + sliceCount - 1) / sliceCount;
+    rowsPerSlice += rowsPerSlice & 1;
+    const int y0 = std::min(slice * rowsPerSlice, height);
+    const int y1 = std::min(y0 + rowsPerSlice, height);
+
+    outLuma.row0 = y0;
+    outLuma.row1 = y1;
+    outLuma.step = 1;
+
+    if (format == varjo_TextureFormat_NV12) {
+        outChroma.row0 = y0 / 2;
+        outChroma.row1 = (y1 + 1) / 2;
+    } else {
+        outChroma.row0 = y0;
+        outChroma.row1 = y1;
+    }
+    outChroma.step = 2;
+}
+
+// Zigzag map signed residual to unsigned symbol, small magnitudes first
+inline uint8_t zigzag(uint8_t r) { return static_cast<uint8_t>((r << 1) ^ (static_cast<int8_t>(r) >> 7)); }
+
+// Inverse of zigzag
+inline uint8_t unzigzag(uint8_t z) { return static_cast<uint8_t>((z >> 1) ^ (0 - (z & 1))); }
+
+// Median edge detector from LOCO-I
+inline uint8_t medianPredict(int a, int b, int c)
+{
+    if (c >= std::max(a, b)) {
+        return static_cast<uint8_t>(std::min(a, b));
+    }
+    if (c <= std::min(a, b)) {
+        return static_cast<uint8_t>(std::max(a, b));
+    }
+    return static_cast<uint8_t>(a + b - c);
+}
+
+// Compute residual row of predictor. Rows that are not needed by predictor may be null.
+void residualRow(Predictor p, const uint8_t* cur, const uint8_t* up, const uint8_t* prev, const uint8_t* prevUp, int n, int step, uint8_t* out)
+{
+    switch (p) {
+        case Predictor::Previous: {
+            for (int x = 0; x < n; x++) {
+                out[x] = static_cast<uint8_t>(cur[x] - prev[x]);
+            }
+        } break;
+        case Predictor::PreviousUp: {
+            for (int x = 0; x < n; x++) {
+                out[x] = static_cast<uint8_t>(cur[x] - prev[x] - up[x] + prevUp[x]);
+            }
+        } break;
+        case Predictor::Up: {
+            for (int x = 0; x < n; x++) {
+                out[x] = static_cast<uint8_t>(cur[x] - up[x]);
+            }
+        } break;
+        case Predictor::Median: {
+            for (int x = 0; x < std::min(step, n); x++) {
+                out[x] = static_cast<uint8_t>(cur[x] - up[x]);
+            }
+            for (int x = step; x < n; x++) {
+                out[x] = static_cast<uint8_t>(cur[x] - medianPredict(cur[x - step], up[x], up[x - step]));
+            }
+        } break;
+        case Predictor::Left: {
+            for (int x = 0; x < std::min(step, n); x++) {
+                out[x] = cur[x];
+            }
+            for (int x = step; x < n; x++) {
+                out[x] = static_cast<uint8_t>(cur[x] - cur[x - step]);
+            }
+        } break;
+        default: break;
+    }
+}
+
+// Returns sum of residual magnitudes
+int residualCost(const uint8_t* res, int n)
+{
+    int cost = 0;
+    for (int x = 0; x < n; x++) {
+        cost += std::abs(static_cast<int8_t>(res[x]));
+    }
+    return cost;
+}
+
+// Reconstruct row from residuals. Output may not alias inputs.
+void reconstructRow(Predictor p, const uint8_t* res, const uint8_t* up, const uint8_t* prev, const uint8_t* prevUp, int n, int step, uint8_t* out)
+{
+    int x = 0;
+    switch (p) {
+        case Predictor::Previous: {
+            for (; x + 16 <= n; x += 16) {
+                const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(res + x));
+                const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + x));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_add_epi8(r, a));
+            }
+            for (; x < n; x++) {
+                out[x] = static_cast<uint8_t>(res[x] + prev[x]);
+            }
+        } break;
+        case Predictor::PreviousUp: {
+            for (; x + 16 <= n; x += 16) {
+                const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(res + x));
+                const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + x));
+                const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up + x));
+                const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prevUp + x));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_sub_epi8(_mm_add_epi8(_mm_add_epi8(r, a), b), c));
+            }
+            for (; x < n; x++) {
+                out[x] = static_cast<uint8_t>(res[x] + prev[x] + up[x] - prevUp[x]);
+            }
+        } break;
+        case Predictor::Up: {
+            for (; x + 16 <= n; x += 16) {
+                const __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i*>(res + x));
+                const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(up + x));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm_add_epi8(r, b));
+            }
+            for (; x < n; x++) {
+                out[x] = static_cast<uint8_t>(res[x] + up[x]);
+            }
+        } break;
+        case Predictor::Median: {
+            for (; x < std::min(step, n); x++) {
+                out[x] = static_cast<uint8_t>(res[x] + up[x]);
+            }
+            for (; x < n; x++) {
+                out[x] = static_cast<uint8_t>(res[x] + medianPredict(out[x - step], up[x], up[x - step]));
+            }
+        } break;
+        case Predictor::Left: {
+            for (; x < std::min(step, n); x++) {
+                out[x] = res[x];
+            }
+            for (; x < n; x++) {
+                out[x] = static_cast<uint8_t>(res[x] + out[x - step]);
+            }
+        } break;
+        default: break;
+    }
+}
+
+// Scale symbol counts to frequencies summing to c_probScale. Every present symbol gets at least one.
+void normalizeFrequencies(const uint32_t counts[256], uint32_t total, uint16_t freqs[256])
+{
+    uint32_t sum = 0;
+    int largest = 0;
+    for (int s = 0; s < 256; s++) {
+        freqs[s] = 0;
+        if (counts[s] > 0) {
+            freqs[s] = static_cast<uint16_t>(std::max<uint64_t>(1, static_cast<uint64_t>(counts[s]) * c_probScale / total));
+            sum += freqs[s];
+            if (freqs[s] > freqs[largest]) {
+                largest = s;
+            }
+        }
+    }
+
+    // Rounding down leaves a deficit that goes to the most common symbol. Minimum frequencies of
+    // rare symbols may overshoot, which is taken from the most common ones.
+    if (sum < c_probScale) {
+        freqs[largest] = static_cast<uint16_t>(freqs[largest] + (c_probScale - sum));
+    }
+    while (sum > c_probScale) {
+        int s = static_cast<int>(std::max_element(freqs, freqs + 256) - freqs);
+        const uint32_t take = std::min<uint32_t>(freqs[s] - 1, sum - c_probScale);
+        freqs[s] = static_cast<uint16_t>(freqs[s] - take);
+        sum -= take;
+    }
+}
+
+// Append bytes to vector
+void append(std::vector<uint8_t>& out, const void* data, size_t size)
+{
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+// Entropy code symbols and append plane header and data to output
+void encodeSymbols(const uint8_t* symbols, int n, std::vector<uint8_t>& ransBytes, std::vector<uint8_t>& out)
+{
+    PlaneHeader header{};
+
+    uint32_t counts[256] = {};
+    for (int i = 0; i < n; i++) {
+        counts[symbols[i]]++;
+    }
+
+    int symbolCount = 256;
+    while (symbolCount > 0 && counts[symbolCount - 1] == 0) {
+        symbolCount--;
+    }
+
+    if (n > 0) {
+        uint16_t freqs[256];
+        uint16_t starts[256];
+        normalizeFrequencies(counts, static_cast<uint32_t>(n), freqs);
+        uint32_t start = 0;
+        for (int s = 0; s < 256; s++) {
+            starts[s] = static_cast<uint16_t>(start);
+            start += freqs[s];
+        }
+
+        // Symbols are encoded backwards so that decoder reads forwards. Each symbol costs at most
+        // c_probBits bits, which bounds the output.
+        ransBytes.resize(static_cast<size_t>(n) * 2 + sizeof(uint32_t) * c_ransStates);
+        uint8_t* const end = ransBytes.data() + ransBytes.size();
+        uint8_t* ptr = end;
+        uint32_t states[c_ransStates] = {c_ransLow, c_ransLow, c_ransLow, c_ransLow};
+
+        for (int i = n - 1; i >= 0; i--) {
+            const uint8_t s = symbols[i];
+            const uint32_t freq = freqs[s];
+            uint32_t& x = states[i & (c_ransStates - 1)];
+            const uint64_t xMax = static_cast<uint64_t>((c_ransLow >> c_probBits) << 16) * freq;
+            if (x >= xMax) {
+                ptr -= sizeof(uint16_t);
+                const uint16_t word = static_cast<uint16_t>(x);
+                memcpy(ptr, &word, sizeof(word));
+                x >>= 16;
+            }
+            x = ((x / freq) << c_probBits) + (x % freq) + starts[s];
+        }
+        for (int k = c_ransStates - 1; k >= 0; k--) {
+            ptr -= sizeof(uint32_t);
+            memcpy(ptr, &states[k], sizeof(uint32_t));
+        }
+
+        const size_t codedSize = (end - ptr) + sizeof(uint16_t) * symbolCount;
+        if (codedSize < static_cast<size_t>(n)) {
+            header.coding = c_codingRans;
+            header.symbolCount = static_cast<uint16_t>(symbolCount);
+            header.size = static_cast<uint32_t>(end - ptr);
+            append(out, &header, sizeof(header));
+            append(out, freqs, sizeof(uint16_t) * symbolCount);
+            append(out, ptr, end - ptr);
+            return;
+        }
+    }
+
+    // Incompressible plane is stored as is
+    header.coding = c_codingRaw;
+    header.size = static_cast<uint32_t>(n);
+    append(out, &header, sizeof(header));
+    append(out, symbols, n);
+}
+
+//! Bounded reader over encoded data
+struct Reader {
+    const uint8_t* ptr;  //!< Read position
+    const uint8_t* end;  //!< End of data
+
+    bool read(void* dst, size_t size)
+    {
+        if (static_cast<size_t>(end - ptr) < size) {
+            return false;
+        }
+        memcpy(dst, ptr, size);
+        ptr += size;
+        return true;
+    }
+
+    const uint8_t* take(size_t size)
+    {
+        if (static_cast<size_t>(end - ptr) < size) {
+            return nullptr;
+        }
+        const uint8_t* data = ptr;
+        ptr += size;
+        return data;
+    }
+};
+
+// Entropy decode n residuals of plane
+bool decodeSymbols(Reader& reader, int n, uint8_t* out)
+{
+    PlaneHeader header;
+    if (!reader.read(&header, sizeof(header))) {
+        return false;
+    }
+
+    if (header.coding == c_codingRaw) {
+        const uint8_t* data = reader.take(header.size);
+        if (data == nullptr || header.size != static_cast<uint32_t>(n)) {
+            return false;
+        }
+        for (int i = 0; i < n; i++) {
+            out[i] = unzigzag(data[i]);
+        }
+        return true;
+    }
+
+    if (header.coding != c_codingRans || header.symbolCount > 256) {
+        return false;
+    }
+
+    uint16_t freqs[256];
+    if (!reader.read(freqs, sizeof(uint16_t) * header.symbolCount)) {
+        return false;
+    }
+
+    // Slot lookup table with residuals already mapped back from zigzag
+    DecodeEntry table[c_probScale];
+    uint32_t start = 0;
+    for (int s = 0; s < header.symbolCount; s++) {
+        if (start + freqs[s] > c_probScale) {
+            return false;
+        }
+        for (uint32_t slot = start; slot < start + freqs[s]; slot++) {
+            table[slot] = DecodeEntry{freqs[s], static_cast<uint16_t>(slot - start), unzigzag(static_cast<uint8_t>(s))};
+        }
+        start += freqs[s];
+    }
+    if (start != c_probScale) {
+        return false;
+    }
+
+    const uint8_t* ptr = reader.take(header.size);
+    if (ptr == nullptr || header.size < sizeof(uint32_t) * c_ransStates) {
+        return false;
+    }
+    const uint8_t* const end = ptr + header.size;
+
+    uint32_t states[c_ransStates];
+    memcpy(states, ptr, sizeof(states));
+    ptr += sizeof(states);
+
+    constexpr uint32_t mask = c_probScale - 1;
+    int i = 0;
+    for (; i + c_ransStates <= n; i += c_ransStates) {
+        for (int k = 0; k < c_ransStates; k++) {
+            uint32_t& x = states[k];
+            const DecodeEntry& e = table[x & mask];
+            out[i + k] = e.value;
+            x = e.freq * (x >> c_probBits) + e.bias;
+            if (x < c_ransLow) {
+                if (end - ptr < 2) {
+                    return false;
+                }
+                uint16_t word;
+                memcpy(&word, ptr, sizeof(word));
+                ptr += sizeof(word);
+                x = (x << 16) | word;
+            }
+        }
+    }
+    for (; i < n; i++) {
+        uint32_t& x = states[i & (c_ransStates - 1)];
+        const DecodeEntry& e = table[x & mask];
+        out[i] = e.value;
+        x = e.freq * (x >> c_probBits) + e.bias;
+        if (x < c_ransLow) {
+            if (end - ptr < 2) {
+                return false;
+            }
+            uint16_t word;
+            memcpy(&word, ptr, sizeof(word));
+            ptr += sizeof(word);
+            x = (x << 16) | word;
+        }
+    }
+
+    // Valid stream ends with all data consumed and states back at their initial value
+    for (uint32_t x : states) {
+        if (x != c_ransLow) {
+            return false;
+        }
+    }
+    return ptr == end;
+}
+
+}  // namespace
+
+namespace VarjoExamples
+{
+namespace FrameCodec
+{
+bool isSupportedFormat(varjo_TextureFormat format) { return format == varjo_TextureFormat_YUV422 || format == varjo_TextureFormat_NV12; }
+
+size_t getPackedSize(varjo_TextureFormat format, int32_t width, int32_t height)
+{
+    return static_cast<size_t>(width) * (static_cast<size_t>(height) + getChromaRows(format, height));
+}
+
+bool readFrameInfo(const uint8_t* data, size_t size, FrameInfo& outInfo)
+{
+    FrameHeader header;
+    if (data == nullptr || size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != c_magic || header.format > c_formatNV12 || header.width <= 0 || header.height <= 0 || header.sliceCount == 0 ||
+        header.sliceCount > c_maxSlices) {
+        return false;
+    }
+
+    outInfo.format = (header.format == c_formatNV12) ? varjo_TextureFormat_NV12 : varjo_TextureFormat_YUV422;
+    outInfo.width = header.width;
+    outInfo.height = header.height;
+    outInfo.keyframe = (header.flags & c_flagKeyframe) != 0;
+    outInfo.sliceCount = header.sliceCount;
+    return true;
+}
+
+}  // namespace FrameCodec
+
+FrameEncoder::FrameEncoder(ThreadPool& threadPool, int sliceCount)
+    : m_threadPool(threadPool)
+    , m_sliceCount(std::max(1, std::min(sliceCount, c_maxSlices)))
+    , m_slices(m_sliceCount)
+{
+}
+
+bool FrameEncoder::encode(const varjo_BufferMetadata& buffer, const void* cpuData, bool keyframe, std::vector<uint8_t>& out)
+{
+    if (cpuData == nullptr || buffer.type != varjo_BufferType_CPU || !FrameCodec::isSupportedFormat(buffer.format) || buffer.width <= 0 ||
+        buffer.height <= 0 || buffer.rowStride < buffer.width) {
+        LOGE("Unsupported buffer for frame encoder: format=%lld, size=%dx%d", buffer.format, buffer.width, buffer.height);
+        return false;
+    }
+
+    const int width = buffer.width;
+    const int height = buffer.height;
+    const int chromaRows = getChromaRows(buffer.format, height);
+    keyframe = keyframe || !m_hasReference || buffer.format != m_format || width != m_width || height != m_height;
+
+    // Pack planes so that previous frame keeps the same layout whatever the source stride
+    m_current.resize(FrameCodec::getPackedSize(buffer.format, width, height));
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(cpuData);
+    for (int y = 0; y < height + chromaRows; y++) {
+        memcpy(m_current.data() + static_cast<size_t>(width) * y, src + static_cast<size_t>(buffer.rowStride) * y, width);
+    }
+
+    const uint8_t* lumaPlanes[2] = {m_current.data(), keyframe ? nullptr : m_reference.data()};
+    const uint8_t* chromaPlanes[2] = {lumaPlanes[0] + static_cast<size_t>(width) * height,
+        keyframe ? nullptr : lumaPlanes[1] + static_cast<size_t>(width) * height};
+
+    m_threadPool.parallelFor(m_sliceCount, [&](int begin, int end) {
+        for (int s = begin; s < end; s++) {
+            Slice& slice = m_slices[s];
+            slice.data.clear();
+
+            PlaneRows planeRows[2];
+            getSliceRows(buffer.format, height, m_sliceCount, s, planeRows[0], planeRows[1]);
+
+            for (int p = 0; p < 2; p++) {
+                const PlaneRows& rows = planeRows[p];
+                const uint8_t* const* planes = (p == 0) ? lumaPlanes : chromaPlanes;
+                const int rowCount = rows.row1 - rows.row0;
+                slice.symbols.resize(static_cast<size_t>(rowCount) * width);
+                slice.candidate.resize(width);
+
+                for (int y = rows.row0; y < rows.row1; y++) {
+                    // Rows above are only used inside slice so that slices decode independently
+                    const bool hasUp = (y > rows.row0);
+                    const uint8_t* cur = planes[0] + static_cast<size_t>(width) * y;
+                    const uint8_t* up = hasUp ? cur - width : nullptr;
+                    const uint8_t* prev = keyframe ? nullptr : planes[1] + static_cast<size_t>(width) * y;
+                    const uint8_t* prevUp = (prev && hasUp) ? prev - width : nullptr;
+
+                    // Pick predictor with smallest residuals. Ties go to the ones that decode faster.
+                    Predictor best = Predictor::Left;
+                    int bestCost = INT32_MAX;
+                    for (int i = 0; i < static_cast<int>(Predictor::Count); i++) {
+                        const Predictor predictor = static_cast<Predictor>(i);
+                        const bool temporal = (predictor == Predictor::Previous || predictor == Predictor::PreviousUp);
+                        const bool vertical = (predictor == Predictor::PreviousUp || predictor == Predictor::Up || predictor == Predictor::Median);
+                        if ((temporal && keyframe) || (vertical && !hasUp)) {
+                            continue;
+                        }
+                        residualRow(predictor, cur, up, prev, prevUp, width, rows.step, slice.candidate.data());
+                        const int cost = residualCost(slice.candidate.data(), width);
+                        if (cost < bestCost) {
+                            best = predictor;
+                            bestCost = cost;
+                        }
+                    }
+
+                    slice.data.push_back(static_cast<uint8_t>(best));
+                    uint8_t* symbols = slice.symbols.data() + static_cast<size_t>(y - rows.row0) * width;
+                    residualRow(best, cur, up, prev, prevUp, width, rows.step, symbols);
+                    for (int x = 0; x < width; x++) {
+                        symbols[x] = zigzag(symbols[x]);
+                    }
+                }
+
+                encodeSymbols(slice.symbols.data(), rowCount * width, slice.ransBytes, slice.data);
+            }
+        }
+    });
+
+    FrameHeader header{};
+    header.magic = c_magic;
+    header.format = (buffer.format == varjo_TextureFormat_NV12) ? c_formatNV12 : c_formatYUV422;
+    header.flags = keyframe ? c_flagKeyframe : 0;
+    header.width = width;
+    header.height = height;
+    header.sliceCount = static_cast<uint16_t>(m_sliceCount);
+    append(out, &header, sizeof(header));
+    for (const auto& slice : m_slices) {
+        const uint32_t size = static_cast<uint32_t>(slice.data.size());
+        append(out, &size, sizeof(size));
+    }
+    for (const auto& slice : m_slices) {
+        append(out, slice.data.data(), slice.data.size());
+    }
+
+    std::swap(m_current, m_reference);
+    m_hasReference = true;
+    m_format = buffer.format;
+    m_width = width;
+    m_height = height;
+    return true;
+}
+
+FrameDecoder::FrameDecoder(ThreadPool& threadPool)
+    : m_threadPool(threadPool)
+{
+}
+
+bool FrameDecoder::decode(const uint8_t* data, size_t size)
+{
+    FrameCodec::FrameInfo info;
+    if (!FrameCodec::readFrameInfo(data, size, info)) {
+        LOGE("Invalid encoded frame.");
+        return false;
+    }
+
+    if (!info.keyframe &&
+        (!m_hasReference || info.format != m_info.format || info.width != m_info.width || info.height != m_info.height)) {
+        LOGE("Missing reference frame for decoding.");
+        return false;
+    }
+
+    // Slice table
+    Reader reader{data + sizeof(FrameHeader), data + size};
+    std::vector<const uint8_t*> sliceData(info.sliceCount);
+    std::vector<uint32_t> sliceSizes(info.sliceCount);
+    if (!reader.read(sliceSizes.data(), sizeof(uint32_t) * info.sliceCount)) {
+        LOGE("Truncated encoded frame.");
+        return false;
+    }
+    for (int s = 0; s < info.sliceCount; s++) {
+        sliceData[s] = reader.take(sliceSizes[s]);
+        if (sliceData[s] == nullptr) {
+            LOGE("Truncated encoded frame.");
+            return false;
+        }
+    }
+
+    const int width = info.width;
+    const int height = info.height;
+    const int target = info.keyframe ? m_current : 1 - m_current;
+    m_frames[target].resize(FrameCodec::getPackedSize(info.format, width, height));
+    if (static_cast<int>(m_residuals.size()) < info.sliceCount) {
+        m_residuals.resize(info.sliceCount);
+    }
+
+    uint8_t* const lumaPlanes[2] = {m_frames[target].data(), info.keyframe ? nullptr : m_frames[m_current].data()};
+    uint8_t* const chromaPlanes[2] = {lumaPlanes[0] + static_cast<size_t>(width) * height,
+        info.keyframe ? nullptr : lumaPlanes[1] + static_cast<size_t>(width) * height};
+
+    std::atomic<bool> ok{true};
+    m_threadPool.parallelFor(info.sliceCount, [&](int begin, int end) {
+        for (int s = begin; s < end && ok; s++) {
+            Reader sliceReader{sliceData[s], sliceData[s] + sliceSizes[s]};
+            std::vector<uint8_t>& residuals = m_residuals[s];
+
+            PlaneRows planeRows[2];
+            getSliceRows(info.format, height, info.sliceCount, s, planeRows[0], planeRows[1]);
+
+            for (int p = 0; p < 2; p++) {
+                const PlaneRows& rows = planeRows[p];
+                uint8_t* const* planes = (p == 0) ? lumaPlanes : chromaPlanes;
+                const int rowCount = rows.row1 - rows.row0;
+
+                const uint8_t* predictors = sliceReader.take(rowCount);
+                residuals.resize(static_cast<size_t>(rowCount) * width);
+                if (predictors == nullptr || !decodeSymbols(sliceReader, rowCount * width, residuals.data())) {
+                    ok = false;
+                    break;
+                }
+
+                for (int y = rows.row0; y < rows.row1; y++) {
+                    const Predictor predictor = static_cast<Predictor>(predictors[y - rows.row0]);
+                    const bool hasUp = (y > rows.row0);
+                    const bool temporal = (predictor == Predictor::Previous || predictor == Predictor::PreviousUp);
+                    const bool vertical = (predictor == Predictor::PreviousUp || predictor == Predictor::Up || predictor == Predictor::Median);
+                    if (predictor >= Predictor::Count || (temporal && info.keyframe) || (vertical && !hasUp)) {
+                        ok = false;
+                        break;
+                    }
+
+                    uint8_t* cur = planes[0] + static_cast<size_t>(width) * y;
+                    const uint8_t* up = hasUp ? cur - width : nullptr;
+                    const uint8_t* prev = info.keyframe ? nullptr : planes[1] + static_cast<size_t>(width) * y;
+                    const uint8_t* prevUp = (prev && hasUp) ? prev - width : nullptr;
+                    reconstructRow(predictor, residuals.data() + static_cast<size_t>(y - rows.row0) * width, up, prev, prevUp, width, rows.step, cur);
+                }
+            }
+        }
+    });
+
+    if (!ok) {
+        LOGE("Corrupted encoded frame.");
+        m_hasReference = false;
+        return false;
+    }
+
+    m_current = target;
+    m_info = info;
+    m_hasReference = true;
+    return true;
+}
+
+varjo_BufferMetadata FrameDecoder::getBufferMetadata() const
+{
+    varjo_BufferMetadata meta{};
+    meta.format = m_info.format;
+    meta.type = varjo_BufferType_CPU;
+    meta.byteSize = static_cast<int32_t>(m_frames[m_current].size());
+    meta.rowStride = m_info.width;
+    meta.width = m_info.width;
+    meta.height = m_info.height;
+    return meta;
+}
+
+}  // namespace VarjoExamples
@@ -0,0 +1,126 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include <Varjo_types_datastream.h>
+
+#include "Globals.hpp"
+#include "ThreadPool.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Frame codec is a lossless codec for YUV422 and NV12 CPU stream buffers. Each plane row is
+// predicted with one of a few predictors picked per row by the encoder: spatial ones using left and
+// upper neighbours, and temporal ones using the previous frame of the same stream channel. Residuals
+// are zigzag mapped and entropy coded with interleaved order-0 rANS, one frequency table per plane.
+// Frames are split to row slices coded independently, so both directions run on a thread pool.
+// Keyframes use spatial predictors only and can be decoded without earlier frames. Predictors that
+// only look at the row above and the previous frame decode with SIMD, which is what makes non-key
+// frames fast to decode; the serial left neighbour predictors mostly end up in keyframes.
+
+//! Shared frame codec definitions
+namespace FrameCodec
+{
+//! Default number of row slices per frame
+constexpr int c_defaultSliceCount = 16;
+
+//! Decoded frame description
+struct FrameInfo {
+    varjo_TextureFormat format = 0;  //!< Texture format, YUV422 or NV12
+    int32_t width = 0;               //!< Frame width
+    int32_t height = 0;              //!< Frame height
+    bool keyframe = false;           //!< Frame decodes without earlier frames
+    int32_t sliceCount = 0;          //!< Row slice count
+};
+
+//! Returns true if format is supported by codec
+bool isSupportedFormat(varjo_TextureFormat format);
+
+//! Returns size of tightly packed frame: luma plane followed by chroma plane
+size_t getPackedSize(varjo_TextureFormat format, int32_t width, int32_t height);
+
+//! Read frame description from encoded frame. Returns false if data is not an encoded frame.
+bool readFrameInfo(const uint8_t* data, size_t size, FrameInfo& outInfo);
+
+}  // namespace FrameCodec
+
+//! Lossless frame encoder for one stream channel
+class FrameEncoder
+{
+public:
+    //! Construct encoder. Slices are encoded on given thread pool.
+    FrameEncoder(ThreadPool& threadPool, int sliceCount = FrameCodec::c_defaultSliceCount);
+
+    // Disable copy, move and assign
+    FrameEncoder(const FrameEncoder& other) = delete;
+    FrameEncoder(const FrameEncoder&& other) = delete;
+    FrameEncoder& operator=(const FrameEncoder& other) = delete;
+    FrameEncoder& operator=(const FrameEncoder&& other) = delete;
+
+    //! Encode CPU stream buffer and append it to output. Keyframe is written if requested, if there is
+    //! no previous frame or if buffer format or size changed. Returns false for unsupported buffers.
+    bool encode(const varjo_BufferMetadata& buffer, const void* cpuData, bool keyframe, std::vector<uint8_t>& out);
+
+    //! Forget previous frame so that next frame is a keyframe
+    void reset() { m_hasReference = false; }
+
+private:
+    //! Per slice output and scratch
+    struct Slice {
+        std::vector<uint8_t> data;       //!< Encoded slice
+        std::vector<uint8_t> symbols;    //!< Zigzag residuals of current plane
+        std::vector<uint8_t> candidate;  //!< Residual row of candidate predictor
+        std::vector<uint8_t> ransBytes;  //!< Backwards written rANS output
+    };
+
+    ThreadPool& m_threadPool;          //!< Encoding threads
+    const int m_sliceCount;            //!< Row slices per frame
+    std::vector<Slice> m_slices;       //!< Slice buffers
+    std::vector<uint8_t> m_reference;  //!< Packed copy of previous frame
+    std::vector<uint8_t> m_current;    //!< Packed copy of current frame
+    bool m_hasReference = false;       //!< Previous frame valid flag
+    varjo_TextureFormat m_format = 0;  //!< Previous frame format
+    int32_t m_width = 0;               //!< Previous frame width
+    int32_t m_height = 0;              //!< Previous frame height
+};
+
+//! Lossless frame decoder for one stream channel
+class FrameDecoder
+{
+public:
+    //! Construct decoder. Slices are decoded on given thread pool.
+    FrameDecoder(ThreadPool& threadPool);
+
+    // Disable copy, move and assign
+    FrameDecoder(const FrameDecoder& other) = delete;
+    FrameDecoder(const FrameDecoder&& other) = delete;
+    FrameDecoder& operator=(const FrameDecoder& other) = delete;
+    FrameDecoder& operator=(const FrameDecoder&& other) = delete;
+
+    //! Decode frame. Non-key frames need the previous frame of the same channel decoded first.
+    //! Returns false if data is corrupted or reference frame is missing.
+    bool decode(const uint8_t* data, size_t size);
+
+    //! Returns buffer metadata of decoded frame. Row stride equals width.
+    varjo_BufferMetadata getBufferMetadata() const;
+
+    //! Returns packed decoded frame, valid until next decode
+    const uint8_t* getFrameData() const { return m_frames[m_current].data(); }
+
+    //! Forget decoded frames so that only keyframes can be decoded next
+    void reset() { m_hasReference = false; }
+
+private:
+    ThreadPool& m_threadPool;                       //!< Decoding threads
+    std::vector<uint8_t> m_frames[2];               //!< Decoded frame and its reference
+    int m_current = 0;                              //!< Index of decoded frame
+    std::vector<std::vector<uint8_t>> m_residuals;  //!< Per slice residual scratch
+    bool m_hasReference = false;                    //!< Decoded frame valid flag
+    FrameCodec::FrameInfo m_info;                   //!< Decoded frame description
+};
+
+}  // namespace VarjoExamples
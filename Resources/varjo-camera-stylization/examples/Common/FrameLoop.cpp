@@ -0,0 +1,99 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "FrameLoop.hpp"
+
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+
+using namespace VarjoExamples;
+
+FrameLoop::~FrameLoop() { stop(); }
+
+bool FrameLoop::start(const FrameFunction& frameFunction, const ThreadFunction& threadBegin, const ThreadFunction& threadEnd)
+{
+    if (m_thread.joinable()) {
+        LOGE("Frame loop already started.");
+        return false;
+    }
+
+    m_stop = false;
+    m_running = true;
+    m_thread = std::thread(&FrameLoop::loopMain, this, frameFunction, threadBegin, threadEnd);
+    return true;
+}
+
+void FrameLoop::stop()
+{
+    if (m_thread.joinable()) {
+        m_stop = true;
+        m_thread.join();
+    }
+}
+
+FrameLoop::Stats FrameLoop::getStats() const
+{
+    Stats stats;
+    stats.frames = m_frames.load(std::memory_order_relaxed);
+    const int64_t intervals = m_intervals.load(std::memory_order_relaxed);
+    if (intervals > 0) {
+        stats.intervalMeanMs = m_intervalSumNs.load(std::memory_order_relaxed) * 1e-6 / intervals;
+        stats.intervalMaxMs = m_intervalMaxNs.load(std::memory_order_relaxed) * 1e-6;
+        const double variance = m_intervalSquareSum.load(std::memory_order_relaxed) / intervals - stats.intervalMeanMs * stats.intervalMeanMs;
+        stats.jitterMs = std::sqrt(std::max(variance, 0.0));
+    }
+    return stats;
+}
+
+void FrameLoop::setMetrics(MetricsRegistry* metrics)
+{
+    m_metrics = metrics;
+    if (m_metrics) {
+        m_intervalMetric = m_metrics->addMetric("Frame loop: interval", MetricsRegistry::Kind::Timer);
+    }
+}
+
+void FrameLoop::loopMain(FrameFunction frameFunction, ThreadFunction threadBegin, ThreadFunction threadEnd)
+{
+    LOGD("Frame loop started.");
+
+    if (threadBegin) {
+        threadBegin();
+    }
+
+    // Only this thread writes statistics, so plain stores are enough
+    int64_t prevNs = 0;
+    try {
+        while (!m_stop.load(std::memory_order_acquire)) {
+            const int64_t nowNs = getTimestampNs();
+            if (prevNs > 0) {
+                const int64_t intervalNs = nowNs - prevNs;
+                const double intervalMs = intervalNs * 1e-6;
+                m_intervals.store(m_intervals.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                m_intervalSumNs.store(m_intervalSumNs.load(std::memory_order_relaxed) + intervalNs, std::memory_order_relaxed);
+                m_intervalSquareSum.store(m_intervalSquareSum.load(std::memory_order_relaxed) + intervalMs * intervalMs, std::memory_order_relaxed);
+                if (intervalNs > m_intervalMaxNs.load(std::memory_order_relaxed)) {
+                    m_intervalMaxNs.store(intervalNs, std::memory_order_relaxed);
+                }
+                if (m_metrics) {
+                    m_metrics->recordTime(m_intervalMetric, intervalNs);
+                }
+            }
+            prevNs = nowNs;
+
+            if (!frameFunction()) {
+                break;
+            }
+            m_frames.store(m_frames.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+    } catch (const std::runtime_error& e) {
+        LOGE("Critical error caught in frame loop: %s", e.what());
+    }
+
+    if (threadEnd) {
+        threadEnd();
+    }
+
+    m_running = false;
+    LOGD("Frame loop finished.");
+}
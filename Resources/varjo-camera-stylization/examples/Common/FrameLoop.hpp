@@ -0,0 +1,86 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <functional>
+
+#include "Globals.hpp"
+#include "MetricsRegistry.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Frame loop runs the frame function back to back on a dedicated thread. Frame function is
+// expected to block in frame sync, so the loop is paced by the runtime and not by the thread that
+// started it. Frame function should not wait for other threads either: take state changes from a
+// CommandQueue and hand results out through a SnapshotBuffer, so that a stalled UI thread can not
+// delay frame submission.
+//
+// Loop measures intervals between frame starts. Jitter is the standard deviation of intervals.
+
+//! Dedicated frame loop thread
+class FrameLoop
+{
+public:
+    //! Frame function. Return false to stop the loop.
+    using FrameFunction = std::function<bool()>;
+
+    //! Function called on loop thread before first or after last frame, e.g. to bind graphics contexts
+    using ThreadFunction = std::function<void()>;
+
+    //! Frame interval statistics
+    struct Stats {
+        int64_t frames = 0;           //!< Frames run
+        double intervalMeanMs = 0.0;  //!< Mean interval between frame starts
+        double intervalMaxMs = 0.0;   //!< Maximum interval between frame starts
+        double jitterMs = 0.0;        //!< Standard deviation of intervals
+    };
+
+    //! Constructor
+    FrameLoop() = default;
+
+    //! Destructor. Stops the loop.
+    ~FrameLoop();
+
+    // Disable copy, move and assign
+    FrameLoop(const FrameLoop& other) = delete;
+    FrameLoop(const FrameLoop&& other) = delete;
+    FrameLoop& operator=(const FrameLoop& other) = delete;
+    FrameLoop& operator=(const FrameLoop&& other) = delete;
+
+    //! Start loop thread. Returns false if loop is already running.
+    bool start(const FrameFunction& frameFunction, const ThreadFunction& threadBegin = nullptr, const ThreadFunction& threadEnd = nullptr);
+
+    //! Stop loop and wait for frame in progress to finish
+    void stop();
+
+    //! Returns true if loop thread is running frames
+    bool isRunning() const { return m_running.load(std::memory_order_acquire); }
+
+    //! Returns frame interval statistics. Lock free, values may be a frame behind each other.
+    Stats getStats() const;
+
+    //! Set metrics registry for frame interval timer. Call before start, pass null to stop publishing.
+    void setMetrics(MetricsRegistry* metrics);
+
+private:
+    //! Loop thread main function
+    void loopMain(FrameFunction frameFunction, ThreadFunction threadBegin, ThreadFunction threadEnd);
+
+private:
+    std::thread m_thread;                //!< Loop thread
+    std::atomic<bool> m_stop{false};     //!< Stop request flag
+    std::atomic<bool> m_running{false};  //!< Running flag
+
+    std::atomic<int64_t> m_frames{0};              //!< Frames run
+    std::atomic<int64_t> m_intervals{0};           //!< Measured intervals
+    std::atomic<int64_t> m_intervalSumNs{0};       //!< Sum of intervals
+    std::atomic<int64_t> m_intervalMaxNs{0};       //!< Maximum interval
+    std::atomic<double> m_intervalSquareSum{0.0};  //!< Sum of squared intervals in ms^2
+
+    MetricsRegistry* m_metrics = nullptr;                                 //!< Metrics registry, null if not published
+    MetricsRegistry::Id m_intervalMetric = MetricsRegistry::c_invalidId;  //!< Frame interval timer
+};
+
+}  // namespace VarjoExamples
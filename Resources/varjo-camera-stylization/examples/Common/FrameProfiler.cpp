@@ -0,0 +1,210 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "FrameProfiler.hpp"
+
+#include <atomic>
+#include <algorithm>
+
+namespace
+{
+// Global counters of all threads
+std::atomic<int64_t> g_allocations{0};
+std::atomic<int64_t> g_allocatedBytes{0};
+std::atomic<int64_t> g_lockWaits{0};
+std::atomic<int64_t> g_lockWaitTimeNs{0};
+
+// Counters of calling thread. Plain integers so that they have no dynamic initialization.
+thread_local int64_t t_allocations = 0;
+thread_local int64_t t_allocatedBytes = 0;
+thread_local int64_t t_lockWaits = 0;
+thread_local int64_t t_lockWaitTimeNs = 0;
+
+// Returns counter difference
+VarjoExamples::FrameProfiler::Counters diff(const VarjoExamples::FrameProfiler::Counters& a, const VarjoExamples::FrameProfiler::Counters& b)
+{
+    VarjoExamples::FrameProfiler::Counters d;
+    d.allocations = a.allocations - b.allocations;
+    d.allocatedBytes = a.allocatedBytes - b.allocatedBytes;
+    d.lockWaits = a.lockWaits - b.lockWaits;
+    d.lockWaitTimeNs = a.lockWaitTimeNs - b.lockWaitTimeNs;
+    return d;
+}
+
+}  // namespace
+
+namespace VarjoExamples
+{
+FrameProfiler::FrameProfiler(const std::vector<std::string>& phaseNames, int maxFrames)
+    : m_phaseNames(phaseNames)
+    , m_samples(std::max(maxFrames, 0))
+{
+    if (m_phaseNames.size() > c_maxPhases) {
+        LOGW("Too many profiler phases: %d, using first %d.", static_cast<int>(m_phaseNames.size()), c_maxPhases);
+        m_phaseNames.resize(c_maxPhases);
+    }
+}
+
+void FrameProfiler::beginFrame()
+{
+    if (m_frameCount >= static_cast<int64_t>(m_samples.size())) {
+        m_inFrame = false;
+        return;
+    }
+
+    m_inFrame = true;
+    m_frameBeginCounters = getThreadCounters();
+    m_frameBeginNs = getTimestampNs();
+    m_samples[m_frameCount] = Sample();
+
+    if (m_frameCount == 0) {
+        m_firstFrameBeginNs = m_frameBeginNs;
+        m_globalBeginCounters = getGlobalCounters();
+        m_processCpuBeginNs = getProcessCpuTimeNs();
+    }
+}
+
+void FrameProfiler::endFrame()
+{
+    if (!m_inFrame) {
+        return;
+    }
+
+    const int64_t now = getTimestampNs();
+    auto& sample = m_samples[m_frameCount];
+    sample.frameTimeNs = now - m_frameBeginNs;
+    sample.frameThread = diff(getThreadCounters(), m_frameBeginCounters);
+
+    m_lastFrameEndNs = now;
+    m_globalEndCounters = getGlobalCounters();
+    m_processCpuEndNs = getProcessCpuTimeNs();
+    m_frameCount++;
+    m_inFrame = false;
+}
+
+void FrameProfiler::beginPhase(int phase)
+{
+    if (phase >= 0 && phase < c_maxPhases) {
+        m_phaseBeginNs[phase] = getTimestampNs();
+    }
+}
+
+void FrameProfiler::endPhase(int phase)
+{
+    if (m_inFrame && phase >= 0 && phase < c_maxPhases) {
+        m_samples[m_frameCount].phaseNs[phase] += getTimestampNs() - m_phaseBeginNs[phase];
+    }
+}
+
+FrameProfiler::Distribution FrameProfiler::getDistribution(std::vector<double>& values)
+{
+    Distribution d;
+    if (values.empty()) {
+        return d;
+    }
+
+    std::sort(values.begin(), values.end());
+    const auto percentile = [&values](double p) {
+        const size_t i = static_cast<size_t>(p * static_cast<double>(values.size() - 1) + 0.5);
+        return values[std::min(i, values.size() - 1)];
+    };
+
+    double sum = 0.0;
+    for (double v : values) {
+        sum += v;
+    }
+
+    d.min = values.front();
+    d.mean = sum / static_cast<double>(values.size());
+    d.p50 = percentile(0.50);
+    d.p90 = percentile(0.90);
+    d.p95 = percentile(0.95);
+    d.p99 = percentile(0.99);
+    d.max = values.back();
+    return d;
+}
+
+FrameProfiler::Report FrameProfiler::getReport() const
+{
+    Report report;
+    report.frames = m_frameCount;
+    report.phaseNames = m_phaseNames;
+    if (m_frameCount == 0) {
+        return report;
+    }
+
+    report.wallTimeMs = (m_lastFrameEndNs - m_firstFrameBeginNs) * 1e-6;
+    report.processCpuTimeMs = (m_processCpuEndNs - m_processCpuBeginNs) * 1e-6;
+    report.allThreads = diff(m_globalEndCounters, m_globalBeginCounters);
+
+    std::vector<double> values(static_cast<size_t>(m_frameCount));
+
+    // Frame thread totals and allocations per frame
+    for (int64_t i = 0; i < m_frameCount; i++) {
+        const auto& c = m_samples[i].frameThread;
+        report.frameThread.allocations += c.allocations;
+        report.frameThread.allocatedBytes += c.allocatedBytes;
+        report.frameThread.lockWaits += c.lockWaits;
+        report.frameThread.lockWaitTimeNs += c.lockWaitTimeNs;
+        values[i] = static_cast<double>(c.allocations);
+    }
+    report.frameAllocations = getDistribution(values);
+
+    // Phase times
+    for (size_t p = 0; p < m_phaseNames.size(); p++) {
+        for (int64_t i = 0; i < m_frameCount; i++) {
+            values[i] = m_samples[i].phaseNs[p] * 1e-6;
+        }
+        report.phaseTimeMs.push_back(getDistribution(values));
+    }
+
+    // Frame times and histogram. Bins span from zero to p99 so that outliers land in last bin.
+    for (int64_t i = 0; i < m_frameCount; i++) {
+        values[i] = m_samples[i].frameTimeNs * 1e-6;
+    }
+    report.frameTimeMs = getDistribution(values);
+    report.histogramBinMs = std::max(report.frameTimeMs.p99, 1e-3) / (c_histogramBins - 1);
+    for (double v : values) {
+        const int bin = std::min(static_cast<int>(v / report.histogramBinMs), c_histogramBins - 1);
+        report.histogram[bin]++;
+    }
+
+    return report;
+}
+
+void FrameProfiler::onAllocation(size_t size)
+{
+    t_allocations++;
+    t_allocatedBytes += static_cast<int64_t>(size);
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_allocatedBytes.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed);
+}
+
+void FrameProfiler::onLockWait(int64_t waitNs)
+{
+    t_lockWaits++;
+    t_lockWaitTimeNs += waitNs;
+    g_lockWaits.fetch_add(1, std::memory_order_relaxed);
+    g_lockWaitTimeNs.fetch_add(waitNs, std::memory_order_relaxed);
+}
+
+FrameProfiler::Counters FrameProfiler::getThreadCounters()
+{
+    Counters c;
+    c.allocations = t_allocations;
+    c.allocatedBytes = t_allocatedBytes;
+    c.lockWaits = t_lockWaits;
+    c.lockWaitTimeNs = t_lockWaitTimeNs;
+    return c;
+}
+
+FrameProfiler::Counters FrameProfiler::getGlobalCounters()
+{
+    Counters c;
+    c.allocations = g_allocations.load(std::memory_order_relaxed);
+    c.allocatedBytes = g_allocatedBytes.load(std::memory_order_relaxed);
+    c.lockWaits = g_lockWaits.load(std::memory_order_relaxed);
+    c.lockWaitTimeNs = g_lockWaitTimeNs.load(std::memory_order_relaxed);
+    return c;
+}
+
+}  // namespace VarjoExamples
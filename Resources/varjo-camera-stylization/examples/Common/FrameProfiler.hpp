@@ -0,0 +1,192 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <array>
+#include <mutex>
+
+#include "Globals.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Frame profiler records per frame phase times, heap allocations and lock waits of the
+// frame thread into preallocated sample storage, so profiling itself does not allocate or lock
+// while frames are running. Allocations are counted only if the application routes its global
+// operator new through FrameProfiler::onAllocation(). Lock waits are counted for ProfiledMutex.
+
+//! Frame loop profiler for headless benchmarks
+class FrameProfiler
+{
+public:
+    //! Maximum number of phases
+    static constexpr int c_maxPhases = 16;
+
+    //! Number of frame time histogram bins
+    static constexpr int c_histogramBins = 20;
+
+    //! Value distribution of recorded frames
+    struct Distribution {
+        double min = 0.0;   //!< Minimum value
+        double mean = 0.0;  //!< Mean value
+        double p50 = 0.0;   //!< Median
+        double p90 = 0.0;   //!< 90th percentile
+        double p95 = 0.0;   //!< 95th percentile
+        double p99 = 0.0;   //!< 99th percentile
+        double max = 0.0;   //!< Maximum value
+    };
+
+    //! Heap allocation and lock wait counters
+    struct Counters {
+        int64_t allocations = 0;     //!< Heap allocation count
+        int64_t allocatedBytes = 0;  //!< Heap allocated bytes
+        int64_t lockWaits = 0;       //!< Contended lock acquisitions
+        int64_t lockWaitTimeNs = 0;  //!< Time spent waiting for contended locks
+    };
+
+    //! Per frame sample
+    struct Sample {
+        int64_t frameTimeNs = 0;                     //!< Frame time on frame thread
+        std::array<int64_t, c_maxPhases> phaseNs{};  //!< Phase times on frame thread
+        Counters frameThread;                        //!< Frame thread counters
+    };
+
+    //! Profiling report
+    struct Report {
+        int64_t frames = 0;                                //!< Number of recorded frames
+        double wallTimeMs = 0.0;                           //!< Wall time of recorded frames
+        double processCpuTimeMs = 0.0;                     //!< CPU time of all process threads during recorded frames
+        Distribution frameTimeMs;                          //!< Frame time distribution
+        std::vector<std::string> phaseNames;               //!< Phase names
+        std::vector<Distribution> phaseTimeMs;             //!< Phase time distributions
+        std::array<int64_t, c_histogramBins> histogram{};  //!< Frame time histogram
+        double histogramBinMs = 0.0;                       //!< Width of histogram bin
+        Counters frameThread;                              //!< Frame thread totals
+        Counters allThreads;                               //!< Totals of all threads
+        Distribution frameAllocations;                     //!< Frame thread allocations per frame
+    };
+
+    //! Scope guard for measuring a phase
+    class ScopedPhase
+    {
+    public:
+        //! Begin phase
+        ScopedPhase(FrameProfiler& profiler, int phase)
+            : m_profiler(profiler)
+            , m_phase(phase)
+        {
+            m_profiler.beginPhase(m_phase);
+        }
+
+        //! End phase
+        ~ScopedPhase() { m_profiler.endPhase(m_phase); }
+
+        // Disable copy, move and assign
+        ScopedPhase(const ScopedPhase& other) = delete;
+        ScopedPhase(const ScopedPhase&& other) = delete;
+        ScopedPhase& operator=(const ScopedPhase& other) = delete;
+        ScopedPhase& operator=(const ScopedPhase&& other) = delete;
+
+    private:
+        FrameProfiler& m_profiler;  //!< Profiler
+        int m_phase;                //!< Measured phase
+    };
+
+    //! Constructor. Reserves storage for given number of frames.
+    FrameProfiler(const std::vector<std::string>& phaseNames, int maxFrames);
+
+    // Disable copy, move and assign
+    FrameProfiler(const FrameProfiler& other) = delete;
+    FrameProfiler(const FrameProfiler&& other) = delete;
+    FrameProfiler& operator=(const FrameProfiler& other) = delete;
+    FrameProfiler& operator=(const FrameProfiler&& other) = delete;
+
+    //! Begin recorded frame. Must be called from frame thread.
+    void beginFrame();
+
+    //! End recorded frame. Frames beyond reserved storage are ignored.
+    void endFrame();
+
+    //! Begin phase in current frame
+    void beginPhase(int phase);
+
+    //! End phase in current frame. Time is accumulated if phase runs several times per frame.
+    void endPhase(int phase);
+
+    //! Returns number of recorded frames
+    int getFrameCount() const { return static_cast<int>(m_frameCount); }
+
+    //! Returns recorded frame sample
+    const Sample& getSample(int frame) const { return m_samples.at(frame); }
+
+    //! Build report from recorded frames
+    Report getReport() const;
+
+    //! Count heap allocation. Called from global operator new, must not allocate.
+    static void onAllocation(size_t size);
+
+    //! Count contended lock wait. Called from ProfiledMutex.
+    static void onLockWait(int64_t waitNs);
+
+    //! Returns counters of calling thread
+    static Counters getThreadCounters();
+
+    //! Returns counters of all threads
+    static Counters getGlobalCounters();
+
+    //! Returns distribution of given values. Sorts values in place.
+    static Distribution getDistribution(std::vector<double>& values);
+
+private:
+    std::vector<std::string> m_phaseNames;              //!< Phase names
+    std::vector<Sample> m_samples;                      //!< Preallocated frame samples
+    int64_t m_frameCount = 0;                           //!< Recorded frames
+    bool m_inFrame = false;                             //!< Frame begun flag
+    int64_t m_frameBeginNs = 0;                         //!< Current frame begin time
+    std::array<int64_t, c_maxPhases> m_phaseBeginNs{};  //!< Current phase begin times
+    Counters m_frameBeginCounters;                      //!< Thread counters at frame begin
+    Counters m_globalBeginCounters;                     //!< Global counters at first frame
+    int64_t m_firstFrameBeginNs = 0;                    //!< First frame begin time
+    int64_t m_lastFrameEndNs = 0;                       //!< Last frame end time
+    int64_t m_processCpuBeginNs = 0;                    //!< Process CPU time at first frame
+    int64_t m_processCpuEndNs = 0;                      //!< Process CPU time at last frame
+    Counters m_globalEndCounters;                       //!< Global counters at last frame
+};
+
+//! Mutex that reports contended lock waits to frame profiler
+class ProfiledMutex
+{
+public:
+    //! Constructor
+    ProfiledMutex() = default;
+
+    // Disable copy, move and assign
+    ProfiledMutex(const ProfiledMutex& other) = delete;
+    ProfiledMutex(const ProfiledMutex&& other) = delete;
+    ProfiledMutex& operator=(const ProfiledMutex& other) = delete;
+    ProfiledMutex& operator=(const ProfiledMutex&& other) = delete;
+
+    //! Lock mutex. Time is measured only if mutex is already locked.
+    void lock()
+    {
+        if (m_mutex.try_lock()) {
+            return;
+        }
+        const int64_t begin = getTimestampNs();
+        m_mutex.lock();
+        FrameProfiler::onLockWait(getTimestampNs() - begin);
+    }
+
+    //! Try to lock mutex
+    bool try_lock() { return m_mutex.try_lock(); }
+
+    //! Unlock mutex
+    void unlock() { m_mutex.unlock(); }
+
+private:
+    std::mutex m_mutex;  //!< Wrapped mutex
+};
+
+}  // namespace VarjoExamples
@@ -0,0 +1,503 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "FrameRecorder.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace VarjoExamples;
+
+namespace
+{
+// File magic 'VFRC', record magic 'VFRR' and index footer magic 'VFRI'
+constexpr uint32_t c_fileMagic = 0x43524656;
+constexpr uint32_t c_recordMagic = 0x52524656;
+constexpr uint32_t c_indexMagic = 0x49524656;
+
+// File format version
+constexpr uint32_t c_fileVersion = 2;
+
+// Record flags
+constexpr uint8_t c_flagKeyframe = 1 << 0;
+constexpr uint8_t c_flagIntrinsics = 1 << 1;
+constexpr uint8_t c_flagExtrinsics = 1 << 2;
+
+#pragma pack(push, 1)
+
+//! File header
+struct FileHeader {
+    uint32_t magic;    //!< File magic
+    uint32_t version;  //!< File format version
+};
+
+//! Record header, followed by record metadata and encoded frame
+struct RecordHeader {
+    uint32_t magic;        //!< Record magic
+    uint32_t size;         //!< Encoded frame size
+    int64_t frameNumber;   //!< Stream frame number
+    int64_t timestamp;     //!< Capture timestamp
+    uint8_t channelIndex;  //!< Stream channel
+    uint8_t flags;         //!< Record flags
+    uint16_t reserved;     //!< Reserved
+};
+
+//! Record stream metadata
+struct RecordMetadata {
+    varjo_Matrix hmdPose;                             //!< HMD world pose at frame time
+    varjo_DistortedColorFrameMetadata colorMetadata;  //!< Color stream frame metadata
+    varjo_CameraIntrinsics intrinsics;                //!< Camera intrinsics, valid if flagged
+    varjo_Matrix extrinsics;                          //!< Camera extrinsics, valid if flagged
+};
+
+//! Index entry
+struct IndexEntry {
+    int64_t offset;       //!< Record header offset
+    RecordHeader header;  //!< Copy of record header
+};
+
+//! Index footer at end of file
+struct IndexFooter {
+    int64_t indexOffset;  //!< First index entry offset
+    uint32_t count;       //!< Number of index entries
+    uint32_t magic;       //!< Index magic
+};
+
+#pragma pack(pop)
+
+// Convert record header to record
+FrameRecord toRecord(const RecordHeader& header, int64_t headerOffset)
+{
+    FrameRecord record;
+    record.offset = headerOffset + static_cast<int64_t>(sizeof(RecordHeader) + sizeof(RecordMetadata));
+    record.size = header.size;
+    record.frameNumber = header.frameNumber;
+    record.timestamp = header.timestamp;
+    record.channelIndex = static_cast<varjo_ChannelIndex>(header.channelIndex);
+    record.keyframe = (header.flags & c_flagKeyframe) != 0;
+    return record;
+}
+
+// Convert record to record header
+RecordHeader toHeader(const FrameRecord& record, uint8_t metadataFlags)
+{
+    RecordHeader header{};
+    header.magic = c_recordMagic;
+    header.size = record.size;
+    header.frameNumber = record.frameNumber;
+    header.timestamp = record.timestamp;
+    header.channelIndex = static_cast<uint8_t>(record.channelIndex);
+    header.flags = static_cast<uint8_t>((record.keyframe ? c_flagKeyframe : 0) | metadataFlags);
+    return header;
+}
+
+// Returns record header flags of metadata
+uint8_t getMetadataFlags(const FrameMetadata& metadata)
+{
+    return static_cast<uint8_t>((metadata.hasIntrinsics ? c_flagIntrinsics : 0) | (metadata.hasExtrinsics ? c_flagExtrinsics : 0));
+}
+
+}  // namespace
+
+namespace VarjoExamples
+{
+FrameMetadata FrameMetadata::fromFrame(const DataStreamer::Frame& frame)
+{
+    FrameMetadata metadata;
+    metadata.hmdPose = frame.hmdPose;
+    metadata.colorMetadata = frame.metadata.distortedColor;
+    metadata.hasIntrinsics = frame.hasIntrinsics;
+    metadata.intrinsics = frame.intrinsics;
+    metadata.hasExtrinsics = frame.hasExtrinsics;
+    metadata.extrinsics = frame.extrinsics;
+    return metadata;
+}
+
+FrameRecordingWriter::~FrameRecordingWriter() { close(); }
+
+bool FrameRecordingWriter::open(const std::string& filename)
+{
+    close();
+
+    m_file.open(filename, std::ofstream::binary | std::ofstream::trunc);
+    if (!m_file) {
+        LOGE("Opening recording file failed: %s", filename.c_str());
+        return false;
+    }
+
+    const FileHeader header{c_fileMagic, c_fileVersion};
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_records.clear();
+    return true;
+}
+
+bool FrameRecordingWriter::writeFrame(FrameRecord& record, const FrameMetadata& metadata, const uint8_t* encoded, size_t size)
+{
+    FrameCodec::FrameInfo info;
+    if (!m_file.is_open() || !FrameCodec::readFrameInfo(encoded, size, info)) {
+        return false;
+    }
+
+    record.keyframe = info.keyframe;
+    record.size = static_cast<uint32_t>(size);
+    record.offset = static_cast<int64_t>(m_file.tellp()) + static_cast<int64_t>(sizeof(RecordHeader) + sizeof(RecordMetadata));
+
+    const uint8_t metadataFlags = getMetadataFlags(metadata);
+    const RecordHeader header = toHeader(record, metadataFlags);
+    const RecordMetadata recordMetadata{metadata.hmdPose, metadata.colorMetadata, metadata.intrinsics, metadata.extrinsics};
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_file.write(reinterpret_cast<const char*>(&recordMetadata), sizeof(recordMetadata));
+    m_file.write(reinterpret_cast<const char*>(encoded), size);
+    if (!m_file) {
+        LOGE("Writing recording failed.");
+        return false;
+    }
+
+    // Index keeps metadata flags so that they survive round trip through index
+    m_records.push_back(record);
+    m_recordFlags.push_back(metadataFlags);
+    return true;
+}
+
+void FrameRecordingWriter::close()
+{
+    if (!m_file.is_open()) {
+        return;
+    }
+
+    // Index of all records for seeking
+    IndexFooter footer{};
+    footer.indexOffset = static_cast<int64_t>(m_file.tellp());
+    footer.count = static_cast<uint32_t>(m_records.size());
+    footer.magic = c_indexMagic;
+    for (size_t i = 0; i < m_records.size(); i++) {
+        const FrameRecord& record = m_records[i];
+        const int64_t headerOffset = record.offset - static_cast<int64_t>(sizeof(RecordHeader) + sizeof(RecordMetadata));
+        const IndexEntry entry{headerOffset, toHeader(record, m_recordFlags[i])};
+        m_file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    }
+    m_file.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+    m_file.close();
+    m_records.clear();
+    m_recordFlags.clear();
+}
+
+FrameRecorder::FrameRecorder(ThreadPool& threadPool, const Config& config)
+    : m_threadPool(threadPool)
+    , m_config(config)
+{
+}
+
+FrameRecorder::~FrameRecorder() { stop(); }
+
+bool FrameRecorder::start(const std::string& filename)
+{
+    stop();
+
+    if (!m_writer.open(filename)) {
+        return false;
+    }
+
+    m_encoders.clear();
+    m_channelFrames.clear();
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        m_stats = Stats();
+        m_encodeTimeTotalMs = 0.0;
+    }
+
+    m_quit = false;
+    m_thread = std::thread(&FrameRecorder::recorderMain, this);
+    m_recording = true;
+    LOGI("Recording started: %s", filename.c_str());
+    return true;
+}
+
+void FrameRecorder::stop()
+{
+    if (!m_thread.joinable()) {
+        return;
+    }
+
+    m_recording = false;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_quit = true;
+    }
+    m_queueCond.notify_all();
+    m_thread.join();
+    m_writer.close();
+
+    const Stats stats = getStats();
+    LOGI("Recording stopped: %lld frames, %lld dropped, compression ratio %.2f", stats.frames, stats.droppedFrames,
+        stats.encodedBytes > 0 ? static_cast<double>(stats.rawBytes) / stats.encodedBytes : 0.0);
+}
+
+void FrameRecorder::submitFrame(const DataStreamer::Frame& frame)
+{
+    const varjo_BufferMetadata& buffer = frame.buffer;
+    if (frame.type != varjo_StreamType_DistortedColor || frame.cpuData == nullptr || buffer.type != varjo_BufferType_CPU ||
+        !FrameCodec::isSupportedFormat(buffer.format)) {
+        return;
+    }
+
+    // Take free frame buffer, or allocate one if queue is not yet at its limit
+    std::unique_ptr<QueuedFrame> queued;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        if (!m_recording || m_quit) {
+            return;
+        }
+        if (!m_freeFrames.empty()) {
+            queued = std::move(m_freeFrames.back());
+            m_freeFrames.pop_back();
+        } else if (m_allocatedFrames < m_config.maxQueuedFrames) {
+            queued = std::make_unique<QueuedFrame>();
+            m_allocatedFrames++;
+        }
+    }
+
+    if (!queued) {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        m_stats.droppedFrames++;
+        return;
+    }
+
+    // Copy packed planes so that stream buffer can be unlocked right away
+    const size_t rowCount = FrameCodec::getPackedSize(buffer.format, buffer.width, buffer.height) / buffer.width;
+    queued->data.resize(FrameCodec::getPackedSize(buffer.format, buffer.width, buffer.height));
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(frame.cpuData);
+    for (size_t y = 0; y < rowCount; y++) {
+        memcpy(queued->data.data() + buffer.width * y, src + buffer.rowStride * y, buffer.width);
+    }
+
+    queued->buffer = buffer;
+    queued->buffer.rowStride = buffer.width;
+    queued->buffer.byteSize = static_cast<int32_t>(queued->data.size());
+    queued->record = FrameRecord();
+    queued->record.frameNumber = frame.frameNumber;
+    queued->record.timestamp = frame.metadata.distortedColor.timestamp;
+    queued->record.channelIndex = frame.channelIndex;
+    queued->metadata = FrameMetadata::fromFrame(frame);
+
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_queue.push_back(std::move(queued));
+    }
+    m_queueCond.notify_one();
+}
+
+FrameRecorder::Stats FrameRecorder::getStats() const
+{
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    return m_stats;
+}
+
+void FrameRecorder::recorderMain()
+{
+    while (true) {
+        std::unique_ptr<QueuedFrame> frame;
+        {
+            std::unique_lock<std::mutex> lock(m_queueMutex);
+            m_queueCond.wait(lock, [this]() { return m_quit || !m_queue.empty(); });
+            if (m_queue.empty()) {
+                return;
+            }
+            frame = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        writeFrame(*frame);
+
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_freeFrames.push_back(std::move(frame));
+    }
+}
+
+void FrameRecorder::writeFrame(QueuedFrame& frame)
+{
+    auto& encoder = m_encoders[frame.record.channelIndex];
+    if (!encoder) {
+        encoder = std::make_unique<FrameEncoder>(m_threadPool, m_config.sliceCount);
+    }
+
+    int64_t& channelFrames = m_channelFrames[frame.record.channelIndex];
+    const bool keyframe = (m_config.keyframeInterval <= 0) ? (channelFrames == 0) : (channelFrames % m_config.keyframeInterval == 0);
+
+    const int64_t start = getTimestampNs();
+    m_encoded.clear();
+    if (!encoder->encode(frame.buffer, frame.data.data(), keyframe, m_encoded)) {
+        return;
+    }
+    const double encodeTimeMs = (getTimestampNs() - start) * 1e-6;
+
+    if (!m_writer.writeFrame(frame.record, frame.metadata, m_encoded.data(), m_encoded.size())) {
+        encoder->reset();
+        return;
+    }
+    channelFrames++;
+
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_stats.frames++;
+    m_stats.keyframes += frame.record.keyframe ? 1 : 0;
+    m_stats.rawBytes += static_cast<int64_t>(frame.data.size());
+    m_stats.encodedBytes += static_cast<int64_t>(m_encoded.size());
+    m_encodeTimeTotalMs += encodeTimeMs;
+    m_stats.encodeTimeAvgMs = m_encodeTimeTotalMs / m_stats.frames;
+}
+
+FrameRecordingReader::FrameRecordingReader(ThreadPool& threadPool)
+    : m_threadPool(threadPool)
+{
+}
+
+bool FrameRecordingReader::open(const std::string& filename)
+{
+    m_records.clear();
+    m_recordFlags.clear();
+    m_channels.clear();
+    m_lastChannel = nullptr;
+
+    m_file.close();
+    m_file.clear();
+    m_file.open(filename, std::ifstream::binary);
+    if (!m_file) {
+        LOGE("Opening recording file failed: %s", filename.c_str());
+        return false;
+    }
+
+    FileHeader fileHeader{};
+    m_file.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader));
+    if (!m_file || fileHeader.magic != c_fileMagic || fileHeader.version != c_fileVersion) {
+        LOGE("Not a recording file: %s", filename.c_str());
+        return false;
+    }
+
+    m_file.seekg(0, std::ifstream::end);
+    const int64_t fileSize = static_cast<int64_t>(m_file.tellg());
+
+    // Use index if recording was stopped cleanly
+    IndexFooter footer{};
+    if (fileSize >= static_cast<int64_t>(sizeof(FileHeader) + sizeof(IndexFooter))) {
+        m_file.seekg(fileSize - static_cast<int64_t>(sizeof(footer)));
+        m_file.read(reinterpret_cast<char*>(&footer), sizeof(footer));
+    }
+
+    const int64_t indexSize = static_cast<int64_t>(footer.count) * static_cast<int64_t>(sizeof(IndexEntry));
+    if (m_file && footer.magic == c_indexMagic && footer.indexOffset + indexSize + static_cast<int64_t>(sizeof(footer)) == fileSize) {
+        std::vector<IndexEntry> entries(footer.count);
+        m_file.seekg(footer.indexOffset);
+        m_file.read(reinterpret_cast<char*>(entries.data()), indexSize);
+        for (const auto& entry : entries) {
+            m_records.push_back(toRecord(entry.header, entry.offset));
+            m_recordFlags.push_back(entry.header.flags);
+        }
+    } else {
+        // Scan records until end of file or first truncated record
+        LOGW("Recording has no index, scanning records: %s", filename.c_str());
+        m_file.clear();
+        int64_t offset = sizeof(FileHeader);
+        while (offset + static_cast<int64_t>(sizeof(RecordHeader)) <= fileSize) {
+            RecordHeader header{};
+            m_file.seekg(offset);
+            m_file.read(reinterpret_cast<char*>(&header), sizeof(header));
+            const int64_t next = offset + static_cast<int64_t>(sizeof(header) + sizeof(RecordMetadata)) + header.size;
+            if (!m_file || header.magic != c_recordMagic || next > fileSize) {
+                break;
+            }
+            m_records.push_back(toRecord(header, offset));
+            m_recordFlags.push_back(header.flags);
+            offset = next;
+        }
+    }
+
+    m_file.clear();
+    LOGI("Recording opened: %s, %d frames", filename.c_str(), static_cast<int>(m_records.size()));
+    return true;
+}
+
+bool FrameRecordingReader::readFrame(int recordIndex)
+{
+    if (recordIndex < 0 || recordIndex >= static_cast<int>(m_records.size())) {
+        LOGE("Invalid record index: %d", recordIndex);
+        return false;
+    }
+
+    const FrameRecord& record = m_records[recordIndex];
+    Channel& channel = m_channels[record.channelIndex];
+    if (!channel.decoder) {
+        channel.decoder = std::make_unique<FrameDecoder>(m_threadPool);
+    }
+    if (channel.lastRecord == recordIndex) {
+        m_lastChannel = &channel;
+        return true;
+    }
+
+    // Continue from last decoded frame when reading forward, otherwise from preceding keyframe
+    int first = recordIndex;
+    if (!record.keyframe) {
+        int previous = recordIndex - 1;
+        while (previous >= 0 && m_records[previous].channelIndex != record.channelIndex) {
+            previous--;
+        }
+
+        if (previous < 0 || previous != channel.lastRecord) {
+            while (first >= 0 && (m_records[first].channelIndex != record.channelIndex || !m_records[first].keyframe)) {
+                first--;
+            }
+            if (first < 0) {
+                LOGE("No keyframe before record: %d", recordIndex);
+                return false;
+            }
+        }
+    }
+
+    for (int i = first; i <= recordIndex; i++) {
+        if (m_records[i].channelIndex == record.channelIndex && !decodeRecord(channel, i)) {
+            channel.lastRecord = -1;
+            return false;
+        }
+    }
+
+    m_lastChannel = &channel;
+    return true;
+}
+
+varjo_BufferMetadata FrameRecordingReader::getBufferMetadata() const
+{
+    return m_lastChannel ? m_lastChannel->decoder->getBufferMetadata() : varjo_BufferMetadata{};
+}
+
+const uint8_t* FrameRecordingReader::getFrameData() const { return m_lastChannel ? m_lastChannel->decoder->getFrameData() : nullptr; }
+
+FrameMetadata FrameRecordingReader::getFrameMetadata() const { return m_lastChannel ? m_lastChannel->metadata : FrameMetadata(); }
+
+bool FrameRecordingReader::decodeRecord(Channel& channel, int recordIndex)
+{
+    const FrameRecord& record = m_records[recordIndex];
+    RecordMetadata recordMetadata{};
+    m_encoded.resize(record.size);
+    m_file.seekg(record.offset - static_cast<int64_t>(sizeof(RecordMetadata)));
+    m_file.read(reinterpret_cast<char*>(&recordMetadata), sizeof(recordMetadata));
+    m_file.read(reinterpret_cast<char*>(m_encoded.data()), record.size);
+    if (!m_file) {
+        LOGE("Reading record failed: %d", recordIndex);
+        m_file.clear();
+        return false;
+    }
+
+    if (!channel.decoder->decode(m_encoded.data(), m_encoded.size())) {
+        return false;
+    }
+    channel.lastRecord = recordIndex;
+
+    const uint8_t flags = m_recordFlags[recordIndex];
+    channel.metadata.hmdPose = recordMetadata.hmdPose;
+    channel.metadata.colorMetadata = recordMetadata.colorMetadata;
+    channel.metadata.hasIntrinsics = (flags & c_flagIntrinsics) != 0;
+    channel.metadata.intrinsics = recordMetadata.intrinsics;
+    channel.metadata.hasExtrinsics = (flags & c_flagExtrinsics) != 0;
+    channel.metadata.extrinsics = recordMetadata.extrinsics;
+    return true;
+}
+
+}  // namespace VarjoExamples
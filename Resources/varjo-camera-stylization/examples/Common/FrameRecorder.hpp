@@ -0,0 +1,226 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <fstream>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+
+#include "Globals.hpp"
+#include "ThreadPool.hpp"
+#include "DataStreamer.hpp"
+#include "FrameCodec.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Recording file is a sequence of records, each holding stream metadata and one FrameCodec
+// encoded frame of one stream channel. Frames are copied out of the locked stream buffer on the stream thread, then
+// encoded and written on the recorder thread, so the stream callback only pays for the copy. If the
+// recorder falls behind, frames are dropped instead of queuing them without bound. When recording
+// stops, an index of all records is appended for seeking. Reader scans the records if it is missing.
+
+//! Frame record description in recording file
+struct FrameRecord {
+    int64_t offset = 0;                                          //!< Encoded frame offset in file
+    uint32_t size = 0;                                           //!< Encoded frame size
+    int64_t frameNumber = 0;                                     //!< Stream frame number
+    int64_t timestamp = 0;                                       //!< Capture timestamp in nanoseconds
+    varjo_ChannelIndex channelIndex = varjo_ChannelIndex_First;  //!< Stream channel
+    bool keyframe = false;                                       //!< Keyframe flag
+};
+
+//! Stream metadata stored with each recorded frame
+struct FrameMetadata {
+    varjo_Matrix hmdPose{};                             //!< HMD world pose at frame time
+    varjo_DistortedColorFrameMetadata colorMetadata{};  //!< Color stream frame metadata
+    bool hasIntrinsics = false;                         //!< Intrinsics valid flag
+    varjo_CameraIntrinsics intrinsics{};                //!< Camera intrinsics for this channel
+    bool hasExtrinsics = false;                         //!< Extrinsics valid flag
+    varjo_Matrix extrinsics{};                          //!< Camera extrinsics for this channel
+
+    //! Returns metadata of stream frame
+    static FrameMetadata fromFrame(const DataStreamer::Frame& frame);
+};
+
+//! Writes encoded frames to recording file
+class FrameRecordingWriter
+{
+public:
+    //! Construct writer
+    FrameRecordingWriter() = default;
+
+    //! Destruct writer. Closes file.
+    ~FrameRecordingWriter();
+
+    // Disable copy, move and assign
+    FrameRecordingWriter(const FrameRecordingWriter& other) = delete;
+    FrameRecordingWriter(const FrameRecordingWriter&& other) = delete;
+    FrameRecordingWriter& operator=(const FrameRecordingWriter& other) = delete;
+    FrameRecordingWriter& operator=(const FrameRecordingWriter&& other) = delete;
+
+    //! Create recording file. Returns false if file cannot be created.
+    bool open(const std::string& filename);
+
+    //! Write encoded frame. Record offset, size and keyframe flag are filled from written data.
+    bool writeFrame(FrameRecord& record, const FrameMetadata& metadata, const uint8_t* encoded, size_t size);
+
+    //! Write record index and close file
+    void close();
+
+    //! Returns true if file is open
+    bool isOpen() const { return m_file.is_open(); }
+
+private:
+    std::ofstream m_file;                //!< Recording file
+    std::vector<FrameRecord> m_records;  //!< Written records for index
+    std::vector<uint8_t> m_recordFlags;  //!< Metadata flags of written records
+};
+
+//! Records CPU color stream frames to file with lossless frame codec
+class FrameRecorder
+{
+public:
+    //! Recorder configuration
+    struct Config {
+        int keyframeInterval = 90;                         //!< Frames per channel between keyframes
+        int sliceCount = FrameCodec::c_defaultSliceCount;  //!< Row slices per frame
+        int maxQueuedFrames = 8;                           //!< Frames waiting for encoding before dropping
+    };
+
+    //! Recorder statistics
+    struct Stats {
+        int64_t frames = 0;            //!< Written frames
+        int64_t keyframes = 0;         //!< Written keyframes
+        int64_t droppedFrames = 0;     //!< Frames dropped because encoder was behind
+        int64_t rawBytes = 0;          //!< Packed size of written frames
+        int64_t encodedBytes = 0;      //!< Encoded size of written frames
+        double encodeTimeAvgMs = 0.0;  //!< Average frame encode time
+    };
+
+    //! Construct recorder. Frames are encoded on given thread pool.
+    FrameRecorder(ThreadPool& threadPool, const Config& config);
+
+    //! Destruct recorder. Stops recording.
+    ~FrameRecorder();
+
+    // Disable copy, move and assign
+    FrameRecorder(const FrameRecorder& other) = delete;
+    FrameRecorder(const FrameRecorder&& other) = delete;
+    FrameRecorder& operator=(const FrameRecorder& other) = delete;
+    FrameRecorder& operator=(const FrameRecorder&& other) = delete;
+
+    //! Start recording to given file. Returns false if file cannot be created.
+    bool start(const std::string& filename);
+
+    //! Stop recording. Writes queued frames and record index.
+    void stop();
+
+    //! Returns true if recording
+    bool isRecording() const { return m_recording; }
+
+    //! Copy frame for recording. Called from stream thread. Unsupported frames are ignored.
+    void submitFrame(const DataStreamer::Frame& frame);
+
+    //! Returns recorder statistics
+    Stats getStats() const;
+
+private:
+    //! Frame copied from stream buffer
+    struct QueuedFrame {
+        FrameRecord record;           //!< Record description
+        FrameMetadata metadata;       //!< Stream metadata
+        varjo_BufferMetadata buffer;  //!< Packed buffer metadata
+        std::vector<uint8_t> data;    //!< Packed frame data
+    };
+
+    //! Recorder thread main function
+    void recorderMain();
+
+    //! Encode and write frame. Called from recorder thread.
+    void writeFrame(QueuedFrame& frame);
+
+private:
+    ThreadPool& m_threadPool;              //!< Encoding threads
+    const Config m_config;                 //!< Recorder configuration
+    FrameRecordingWriter m_writer;         //!< Recording file writer
+    std::thread m_thread;                  //!< Recorder thread
+    std::atomic<bool> m_recording{false};  //!< Recording flag
+
+    std::mutex m_queueMutex;                                 //!< Queue mutex
+    std::condition_variable m_queueCond;                     //!< Signaled when frames are queued
+    std::deque<std::unique_ptr<QueuedFrame>> m_queue;        //!< Frames waiting for encoding
+    std::vector<std::unique_ptr<QueuedFrame>> m_freeFrames;  //!< Reusable frame buffers
+    int m_allocatedFrames = 0;                               //!< Allocated frame buffers
+    bool m_quit = false;                                     //!< Quit flag for recorder thread
+
+    std::map<varjo_ChannelIndex, std::unique_ptr<FrameEncoder>> m_encoders;  //!< Encoder per channel
+    std::map<varjo_ChannelIndex, int64_t> m_channelFrames;                   //!< Written frames per channel
+    std::vector<uint8_t> m_encoded;                                          //!< Encoding buffer
+
+    mutable std::mutex m_statsMutex;   //!< Statistics mutex
+    Stats m_stats{};                   //!< Statistics
+    double m_encodeTimeTotalMs = 0.0;  //!< Total encode time
+};
+
+//! Reads frames from recording file
+class FrameRecordingReader
+{
+public:
+    //! Construct reader. Frames are decoded on given thread pool.
+    FrameRecordingReader(ThreadPool& threadPool);
+
+    // Disable copy, move and assign
+    FrameRecordingReader(const FrameRecordingReader& other) = delete;
+    FrameRecordingReader(const FrameRecordingReader&& other) = delete;
+    FrameRecordingReader& operator=(const FrameRecordingReader& other) = delete;
+    FrameRecordingReader& operator=(const FrameRecordingReader&& other) = delete;
+
+    //! Open recording file. Returns false if file is not a recording.
+    bool open(const std::string& filename);
+
+    //! Returns records in file order
+    const std::vector<FrameRecord>& getRecords() const { return m_records; }
+
+    //! Decode frame of given record. Frames of the same channel are decoded from the preceding
+    //! keyframe unless the previous frame of the channel was the last one decoded.
+    bool readFrame(int recordIndex);
+
+    //! Returns buffer metadata of last read frame
+    varjo_BufferMetadata getBufferMetadata() const;
+
+    //! Returns packed data of last read frame
+    const uint8_t* getFrameData() const;
+
+    //! Returns stream metadata of last read frame
+    FrameMetadata getFrameMetadata() const;
+
+private:
+    //! Per channel decoding state
+    struct Channel {
+        std::unique_ptr<FrameDecoder> decoder;  //!< Channel decoder
+        int lastRecord = -1;                    //!< Last decoded record of channel
+        FrameMetadata metadata;                 //!< Metadata of last decoded record
+    };
+
+    //! Read and decode single record
+    bool decodeRecord(Channel& channel, int recordIndex);
+
+private:
+    ThreadPool& m_threadPool;                          //!< Decoding threads
+    std::ifstream m_file;                              //!< Recording file
+    std::vector<FrameRecord> m_records;                //!< Records in file
+    std::map<varjo_ChannelIndex, Channel> m_channels;  //!< Channel decoders
+    Channel* m_lastChannel = nullptr;                  //!< Channel of last read frame
+    std::vector<uint8_t> m_recordFlags;                //!< Metadata flags of records
+    std::vector<uint8_t> m_encoded;                    //!< Encoded frame buffer
+};
+
+}  // namespace VarjoExamples
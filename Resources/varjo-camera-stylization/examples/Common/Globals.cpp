@@ -44,4 +44,16 @@ void writeLog(LogLevel level, const char* funcName, int lineNum, const char* pre
     }
 }
 
+int64_t getProcessCpuTimeNs()
+{
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if (!GetProcessTimes(GetCurrentProcess(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+        return 0;
+    }
+
+    // File times are in 100 ns units
+    const auto toNs = [](const FILETIME& ft) { return ((static_cast<int64_t>(ft.dwHighDateTime) << 32) | ft.dwLowDateTime) * 100; };
+    return toNs(kernelTime) + toNs(userTime);
+}
+
 }  // namespace VarjoExamples
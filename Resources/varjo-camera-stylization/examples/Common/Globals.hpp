@@ -105,6 +105,25 @@ inline varjo_Error checkVError(const char* func, int line, varjo_Session* sessio
 //! Macro for checking Varjo error.
 #define CHECK_VARJO_ERR(SESSION) VarjoExamples::checkVError(__FUNCTION__, __LINE__, SESSION)
 
+//! Returns high resolution timestamp in nanoseconds. Consistent across processes on the same machine.
+inline int64_t getTimestampNs()
+{
+    static const int64_t frequency = []() {
+        LARGE_INTEGER f;
+        QueryPerformanceFrequency(&f);
+        return static_cast<int64_t>(f.QuadPart);
+    }();
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    const int64_t seconds = counter.QuadPart / frequency;
+    const int64_t remainder = counter.QuadPart % frequency;
+    return seconds * 1000000000 + remainder * 1000000000 / frequency;
+}
+
+//! Returns CPU time of all process threads in nanoseconds
+int64_t getProcessCpuTimeNs();
+
 //! Get Varjo matrix from GLM matrix
 inline varjo_Matrix toVarjoMatrix(const glm::mat4x4& m)
 {
@@ -0,0 +1,104 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstring>
+#include <string>
+
+#include "Globals.hpp"
+#include "CpuInfo.hpp"
+
+namespace VarjoExamples
+{
+//! SIMD instruction set variant used by CPU kernels
+enum class SimdLevel {
+    Scalar = 0,  //!< Plain C++ code
+    SSE41,       //!< 4-wide SSE 4.1
+    AVX2,        //!< 8-wide AVX2
+};
+
+//! Kernel execution mode for multi stage kernels
+enum class ExecutionMode {
+    Frame = 0,  //!< Each stage runs over whole frame using full frame intermediate buffers
+    Streaming,  //!< Tiles flow through all stages using small tile local intermediate buffers
+};
+
+//! Execution configuration for CPU image kernels
+struct KernelConfig {
+    SimdLevel simd = SimdLevel::SSE41;          //!< SIMD variant
+    ExecutionMode mode = ExecutionMode::Frame;  //!< Execution mode
+    int threads = 0;                            //!< Number of threads participating, zero for all
+    int tileWidth = 0;                          //!< Tile width in pixels, zero for full row
+    int tileHeight = 32;                        //!< Tile height in rows
+
+    bool operator==(const KernelConfig& other) const
+    {
+        return simd == other.simd && mode == other.mode && threads == other.threads && tileWidth == other.tileWidth && tileHeight == other.tileHeight;
+    }
+    bool operator!=(const KernelConfig& other) const { return !(*this == other); }
+};
+
+//! Returns name of SIMD level
+inline const char* getSimdLevelName(SimdLevel level)
+{
+    switch (level) {
+        case SimdLevel::Scalar: return "Scalar";
+        case SimdLevel::SSE41: return "SSE4.1";
+        case SimdLevel::AVX2: return "AVX2";
+        default: return "Unknown";
+    }
+}
+
+//! Parse SIMD level name. Returns false if name is unknown.
+inline bool parseSimdLevel(const std::string& name, SimdLevel& outLevel)
+{
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2}) {
+        if (name == getSimdLevelName(level)) {
+            outLevel = level;
+            return true;
+        }
+    }
+    return false;
+}
+
+//! Returns name of execution mode
+inline const char* getExecutionModeName(ExecutionMode mode) { return (mode == ExecutionMode::Streaming) ? "Streaming" : "Frame"; }
+
+//! Parse execution mode name. Returns false if name is unknown.
+inline bool parseExecutionMode(const std::string& name, ExecutionMode& outMode)
+{
+    if (name == "Frame" || name == "Streaming") {
+        outMode = (name == "Streaming") ? ExecutionMode::Streaming : ExecutionMode::Frame;
+        return true;
+    }
+    return false;
+}
+
+//! Returns true if SIMD level can be run on this machine
+inline bool isSimdLevelSupported(SimdLevel level)
+{
+    const auto& cpu = CpuInfo::get();
+    switch (level) {
+        case SimdLevel::Scalar: return true;
+        case SimdLevel::SSE41: return cpu.sse41;
+        case SimdLevel::AVX2: return cpu.avx2 && cpu.fma;
+        default: return false;
+    }
+}
+
+//! Returns highest SIMD level supported by this machine
+inline SimdLevel getMaxSimdLevel()
+{
+    return isSimdLevelSupported(SimdLevel::AVX2) ? SimdLevel::AVX2 : (isSimdLevelSupported(SimdLevel::SSE41) ? SimdLevel::SSE41 : SimdLevel::Scalar);
+}
+
+//! Returns human readable kernel config description
+inline std::string toString(const KernelConfig& config)
+{
+    char buf[128];
+    snprintf(buf, sizeof(buf), "%s %s threads=%d tile=%dx%d", getSimdLevelName(config.simd), getExecutionModeName(config.mode), config.threads,
+        config.tileWidth, config.tileHeight);
+    return buf;
+}
+
+}  // namespace VarjoExamples
@@ -0,0 +1,233 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "KernelProfile.hpp"
+
+#include <fstream>
+#include <ctime>
+#include <cstdlib>
+#include <json/json.hpp>
+
+#include "CpuInfo.hpp"
+
+using json = nlohmann::json;
+
+namespace
+{
+// Profile file format version
+constexpr int c_profileVersion = 1;
+
+// Returns current local time as string
+std::string getTimeString()
+{
+    const std::time_t now = std::time(nullptr);
+    std::tm local{};
+    localtime_s(&local, &now);
+    char buf[64];
+    std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &local);
+    return buf;
+}
+
+// Serialize entry
+json toJson(const VarjoExamples::KernelProfile::Entry& entry)
+{
+    return json{
+        {"kernel", entry.kernel},
+        {"width", entry.width},
+        {"height", entry.height},
+        {"simd", VarjoExamples::getSimdLevelName(entry.config.simd)},
+        {"mode", VarjoExamples::getExecutionModeName(entry.config.mode)},
+        {"threads", entry.config.threads},
+        {"tileWidth", entry.config.tileWidth},
+        {"tileHeight", entry.config.tileHeight},
+        {"timeMs", entry.timeMs},
+        {"baselineMs", entry.baselineMs},
+    };
+}
+
+// Deserialize entry. Returns false if entry is invalid.
+bool fromJson(const json& j, VarjoExamples::KernelProfile::Entry& entry)
+{
+    entry.kernel = j.at("kernel").get<std::string>();
+    entry.width = j.at("width").get<int>();
+    entry.height = j.at("height").get<int>();
+    entry.config.threads = j.at("threads").get<int>();
+    entry.config.tileWidth = j.at("tileWidth").get<int>();
+    entry.config.tileHeight = j.at("tileHeight").get<int>();
+    entry.timeMs = j.value("timeMs", 0.0);
+    entry.baselineMs = j.value("baselineMs", 0.0);
+
+    return VarjoExamples::parseSimdLevel(j.at("simd").get<std::string>(), entry.config.simd) &&
+           VarjoExamples::parseExecutionMode(j.at("mode").get<std::string>(), entry.config.mode) && entry.width > 0 && entry.height > 0 &&
+           entry.config.threads >= 0 && entry.config.tileWidth >= 0 && entry.config.tileHeight > 0;
+}
+
+}  // namespace
+
+namespace VarjoExamples
+{
+constexpr const char* KernelProfile::c_defaultFilename;
+
+KernelProfile::KernelProfile()
+    : m_machineKey(CpuInfo::get().getKey())
+{
+}
+
+KernelProfile::Machine& KernelProfile::getMachine()
+{
+    auto it = m_machines.find(m_machineKey);
+    if (it == m_machines.end()) {
+        const auto& cpu = CpuInfo::get();
+        Machine machine;
+        machine.cpu = cpu.brand;
+        machine.features = cpu.getFeatureNames();
+        machine.logicalCores = cpu.logicalCores;
+        it = m_machines.emplace(m_machineKey, machine).first;
+    }
+    return it->second;
+}
+
+const std::vector<KernelProfile::Entry>& KernelProfile::getEntries() const
+{
+    static const std::vector<Entry> s_empty;
+    const auto it = m_machines.find(m_machineKey);
+    return (it != m_machines.end()) ? it->second.entries : s_empty;
+}
+
+bool KernelProfile::hasEntry(const std::string& kernel, int width, int height) const
+{
+    for (const auto& entry : getEntries()) {
+        if (entry.kernel == kernel && entry.width == width && entry.height == height) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void KernelProfile::setEntry(const Entry& entry)
+{
+    auto& machine = getMachine();
+    machine.timestamp = getTimeString();
+    for (auto& existing : machine.entries) {
+        if (existing.kernel == entry.kernel && existing.width == entry.width && existing.height == entry.height) {
+            existing = entry;
+            return;
+        }
+    }
+    machine.entries.push_back(entry);
+}
+
+void KernelProfile::clear()
+{
+    auto it = m_machines.find(m_machineKey);
+    if (it != m_machines.end()) {
+        it->second.entries.clear();
+    }
+}
+
+bool KernelProfile::findConfig(const std::string& kernel, int width, int height, KernelConfig& outConfig) const
+{
+    const Entry* best = nullptr;
+    int64_t bestDiff = 0;
+    const int64_t pixels = static_cast<int64_t>(width) * height;
+
+    for (const auto& entry : getEntries()) {
+        if (entry.kernel != kernel) {
+            continue;
+        }
+        const int64_t diff = std::abs(static_cast<int64_t>(entry.width) * entry.height - pixels);
+        if (!best || diff < bestDiff) {
+            best = &entry;
+            bestDiff = diff;
+        }
+    }
+
+    if (!best) {
+        return false;
+    }
+
+    // Profile may have been copied from a machine with wider SIMD support
+    outConfig = best->config;
+    if (!isSimdLevelSupported(outConfig.simd)) {
+        outConfig.simd = getMaxSimdLevel();
+    }
+    return true;
+}
+
+bool KernelProfile::load(const std::string& filename)
+{
+    std::ifstream inFile(filename);
+    if (!inFile.good()) {
+        LOGW("Kernel profile not found: %s", filename.c_str());
+        return false;
+    }
+
+    std::map<std::string, Machine> machines;
+    try {
+        const json root = json::parse(inFile);
+        if (root.value("version", 0) != c_profileVersion) {
+            LOGW("Unsupported kernel profile version: %s", filename.c_str());
+            return false;
+        }
+
+        for (const auto& item : root.at("machines").items()) {
+            const json& jm = item.value();
+            Machine machine;
+            machine.cpu = jm.value("cpu", std::string());
+            machine.features = jm.value("features", std::vector<std::string>());
+            machine.logicalCores = jm.value("logicalCores", 0);
+            machine.timestamp = jm.value("timestamp", std::string());
+            for (const auto& je : jm.at("entries")) {
+                Entry entry;
+                if (fromJson(je, entry)) {
+                    machine.entries.push_back(entry);
+                } else {
+                    LOGW("Ignoring invalid kernel profile entry: %s", je.dump().c_str());
+                }
+            }
+            machines[item.key()] = machine;
+        }
+    } catch (const json::exception& e) {
+        LOGE("Parsing kernel profile failed: %s (%s)", filename.c_str(), e.what());
+        return false;
+    }
+
+    m_machines = machines;
+    LOGI("Kernel profile loaded: %s (%d entries for this machine)", filename.c_str(), static_cast<int>(getEntries().size()));
+    return true;
+}
+
+bool KernelProfile::save(const std::string& filename) const
+{
+    json jmachines = json::object();
+    for (const auto& item : m_machines) {
+        const Machine& machine = item.second;
+        json jentries = json::array();
+        for (const auto& entry : machine.entries) {
+            jentries.push_back(toJson(entry));
+        }
+        jmachines[item.first] = json{
+            {"cpu", machine.cpu},
+            {"features", machine.features},
+            {"logicalCores", machine.logicalCores},
+            {"timestamp", machine.timestamp},
+            {"entries", jentries},
+        };
+    }
+
+    const json root{
+        {"version", c_profileVersion},
+        {"machines", jmachines},
+    };
+
+    std::ofstream outFile(filename);
+    outFile << root.dump(2) << std::endl;
+    if (!outFile.good()) {
+        LOGE("Writing kernel profile failed: %s", filename.c_str());
+        return false;
+    }
+
+    LOGI("Kernel profile saved: %s", filename.c_str());
+    return true;
+}
+
+}  // namespace VarjoExamples
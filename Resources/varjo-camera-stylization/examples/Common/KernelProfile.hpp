@@ -0,0 +1,84 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+
+#include "Globals.hpp"
+#include "KernelConfig.hpp"
+
+namespace VarjoExamples
+{
+//! Persisted CPU kernel tuning results. Profile file holds results for multiple machines keyed by
+//! CPU model and feature flags, and lookups are done from the entries of the current machine.
+class KernelProfile
+{
+public:
+    //! Default profile file name, relative to working directory
+    static constexpr const char* c_defaultFilename = "kernelProfile.json";
+
+    //! Tuning result for one kernel at one resolution
+    struct Entry {
+        std::string kernel;       //!< Kernel name
+        int width = 0;            //!< Image width
+        int height = 0;           //!< Image height
+        KernelConfig config;      //!< Winning configuration
+        double timeMs = 0.0;      //!< Measured time with winning configuration
+        double baselineMs = 0.0;  //!< Measured time with default configuration
+    };
+
+    //! Tuning results of one machine
+    struct Machine {
+        std::string cpu;                    //!< CPU brand string
+        std::vector<std::string> features;  //!< CPU feature names
+        int logicalCores = 0;               //!< Number of logical cores
+        std::string timestamp;              //!< Time of last update
+        std::vector<Entry> entries;         //!< Tuning results
+    };
+
+    //! Construct empty profile for current machine
+    KernelProfile();
+
+    //! Load profile file. Returns false if file can't be read or parsed.
+    bool load(const std::string& filename);
+
+    //! Save profile file including results of other machines. Returns false on failure.
+    bool save(const std::string& filename) const;
+
+    //! Returns key of current machine
+    const std::string& getMachineKey() const { return m_machineKey; }
+
+    //! Returns tuning results of all machines
+    const std::map<std::string, Machine>& getMachines() const { return m_machines; }
+
+    //! Returns entries of current machine
+    const std::vector<Entry>& getEntries() const;
+
+    //! Returns true if current machine has any tuning results
+    bool hasEntries() const { return !getEntries().empty(); }
+
+    //! Returns true if current machine has results for kernel at given resolution
+    bool hasEntry(const std::string& kernel, int width, int height) const;
+
+    //! Add or replace entry of current machine
+    void setEntry(const Entry& entry);
+
+    //! Remove all entries of current machine
+    void clear();
+
+    //! Find configuration for kernel. Uses exact resolution match or nearest pixel count of the same
+    //! kernel. Returns false if kernel has no results.
+    bool findConfig(const std::string& kernel, int width, int height, KernelConfig& outConfig) const;
+
+private:
+    //! Returns current machine, creating it if needed
+    Machine& getMachine();
+
+private:
+    std::string m_machineKey;                   //!< Current machine key
+    std::map<std::string, Machine> m_machines;  //!< Results per machine
+};
+
+}  // namespace VarjoExamples
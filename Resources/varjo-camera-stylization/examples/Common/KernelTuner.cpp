@@ -0,0 +1,296 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "KernelTuner.hpp"
+
+#include <algorithm>
+#include <map>
+#include <tuple>
+#include <cmath>
+
+namespace
+{
+// Untimed runs before measuring each candidate
+constexpr int c_warmupIterations = 2;
+
+// Coordinate search rounds over all dimensions
+constexpr int c_searchRounds = 2;
+
+// Key for caching measured candidates
+using ConfigKey = std::tuple<int, int, int, int, int>;
+ConfigKey getKey(const VarjoExamples::KernelConfig& c)
+{
+    return ConfigKey(static_cast<int>(c.simd), static_cast<int>(c.mode), c.threads, c.tileWidth, c.tileHeight);
+}
+
+}  // namespace
+
+namespace VarjoExamples
+{
+KernelTuner::KernelTuner(int threadCount)
+    : m_threadPool(threadCount)
+    , m_stylizer(m_threadPool)
+    , m_cancel(false)
+{
+}
+
+KernelConfig KernelTuner::getDefaultConfig(CpuStylizer::Kernel kernel)
+{
+    // Same defaults CpuStylizer uses without a profile
+    KernelConfig config;
+    config.simd = CpuStylizer::hasSimdVariants(kernel) ? getMaxSimdLevel() : SimdLevel::Scalar;
+    return config;
+}
+
+CpuStylizer::Params KernelTuner::getBenchmarkParams(CpuStylizer::Kernel kernel)
+{
+    // Typical values from the UI
+    CpuStylizer::Params params;
+    switch (kernel) {
+        case CpuStylizer::Kernel::Cartoon: {
+            params.clusterSize = 8;
+            params.outlineIntensity = 0.5f;
+        } break;
+        case CpuStylizer::Kernel::Watercolor: {
+            params.watercolorRadius = 4;
+        } break;
+        case CpuStylizer::Kernel::Sketch: {
+            params.sketchIntensity = 1.0f;
+        } break;
+        case CpuStylizer::Kernel::Pointilism: {
+            params.pointilismStep = 100.0f;
+            params.pointilismThreshold = 0.3f;
+        } break;
+        case CpuStylizer::Kernel::OilPaint: {
+            params.oilPaintRadius = 4;
+        } break;
+        default: break;
+    }
+    return params;
+}
+
+KernelTuner::Dimensions KernelTuner::getDimensions(CpuStylizer::Kernel kernel, int width) const
+{
+    Dimensions dims;
+
+    if (CpuStylizer::hasSimdVariants(kernel)) {
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2}) {
+            if (isSimdLevelSupported(level)) {
+                dims.simd.push_back(level);
+            }
+        }
+    } else {
+        dims.simd = {SimdLevel::Scalar};
+    }
+
+    dims.modes = {ExecutionMode::Frame};
+    if (CpuStylizer::isMultiStage(kernel)) {
+        dims.modes.push_back(ExecutionMode::Streaming);
+    }
+
+    // Powers of two up to all threads
+    const int maxThreads = m_threadPool.getThreadCount() + 1;
+    for (int t = 1; t < maxThreads; t *= 2) {
+        dims.threads.push_back(t);
+    }
+    dims.threads.push_back(maxThreads);
+
+    // Banded kernels split rows evenly between tasks, so tile size has no effect
+    if (CpuStylizer::isBanded(kernel)) {
+        dims.tileWidths = {0};
+        dims.tileHeights = {KernelConfig().tileHeight};
+        return dims;
+    }
+
+    dims.tileWidths = {0};
+    for (int w : {64, 128, 256, 512}) {
+        if (w < width) {
+            dims.tileWidths.push_back(w);
+        }
+    }
+
+    dims.tileHeights = {4, 8, 16, 32, 64, 128};
+    return dims;
+}
+
+void KernelTuner::prepareInput(int width, int height)
+{
+    if (width == m_inputWidth && height == m_inputHeight) {
+        return;
+    }
+    m_inputWidth = width;
+    m_inputHeight = height;
+
+    // Smooth gradients with blocky features and noise, roughly like a camera image
+    uint32_t seed = 12345;
+    auto random = [&seed]() {
+        seed = seed * 1664525u + 1013904223u;
+        return static_cast<int>((seed >> 24) & 0xff);
+    };
+
+    m_rgba.resize(static_cast<size_t>(width) * height * 4);
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const bool block = ((x / 37) + (y / 53)) % 3 == 0;
+            uint8_t* p = m_rgba.data() + (static_cast<size_t>(width) * y + x) * 4;
+            p[0] = static_cast<uint8_t>(std::min(255, (x * 255 / width) / (block ? 2 : 1) + random() / 16));
+            p[1] = static_cast<uint8_t>(std::min(255, (y * 255 / height) / (block ? 2 : 1) + random() / 16));
+            p[2] = static_cast<uint8_t>(std::min(255, 128 + (block ? 64 : 0) + random() / 16));
+            p[3] = 255;
+        }
+    }
+
+    // Luma plane followed by chroma plane of same stride
+    m_yuv.resize(static_cast<size_t>(width) * height * 2);
+    for (size_t i = 0; i < m_yuv.size(); i++) {
+        m_yuv[i] = static_cast<uint8_t>(i < m_yuv.size() / 2 ? 16 + random() * 219 / 255 : 128 + random() / 8 - 16);
+    }
+
+    m_output.resize(m_rgba.size());
+}
+
+double KernelTuner::benchmark(CpuStylizer::Kernel kernel, const KernelConfig& config, int width, int height, int iterations)
+{
+    return benchmark(kernel, config, getBenchmarkParams(kernel), width, height, iterations);
+}
+
+double KernelTuner::benchmark(
+    CpuStylizer::Kernel kernel, const KernelConfig& config, const CpuStylizer::Params& params, int width, int height, int iterations)
+{
+    prepareInput(width, height);
+    const size_t stride = static_cast<size_t>(width) * 4;
+    const uint8_t* yPlane = m_yuv.data();
+    const uint8_t* uvPlane = m_yuv.data() + static_cast<size_t>(width) * height;
+
+    auto run = [&]() {
+        if (kernel == CpuStylizer::Kernel::ConvertYUV422 || kernel == CpuStylizer::Kernel::ConvertNV12) {
+            m_stylizer.runConvert(kernel, config, yPlane, uvPlane, width, m_output.data(), width, height);
+        } else {
+            m_stylizer.runEffect(kernel, config, m_rgba.data(), stride, m_output.data(), stride, width, height, params);
+        }
+    };
+
+    for (int i = 0; i < c_warmupIterations; i++) {
+        run();
+    }
+
+    std::vector<double> times(std::max(1, iterations));
+    for (auto& time : times) {
+        const int64_t start = getTimestampNs();
+        run();
+        time = static_cast<double>(getTimestampNs() - start) * 1e-6;
+    }
+
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+bool KernelTuner::tuneKernel(CpuStylizer::Kernel kernel, int width, int height, const Options& options, KernelProfile::Entry& outEntry)
+{
+    const Dimensions dims = getDimensions(kernel, width);
+    std::map<ConfigKey, double> measured;
+
+    auto measure = [&](const KernelConfig& config) {
+        const auto key = getKey(config);
+        auto it = measured.find(key);
+        if (it == measured.end()) {
+            it = measured.emplace(key, benchmark(kernel, config, width, height, options.iterations)).first;
+        }
+        return it->second;
+    };
+
+    // Default configuration, with all threads spelled out
+    KernelConfig best = getDefaultConfig(kernel);
+    best.threads = dims.threads.back();
+    const double baselineMs = measure(best);
+    double bestMs = baselineMs;
+
+    auto consider = [&](const KernelConfig& config) {
+        if (m_cancel) {
+            return;
+        }
+        const double ms = measure(config);
+        if (ms < bestMs) {
+            bestMs = ms;
+            best = config;
+        }
+    };
+
+    if (options.exhaustive) {
+        for (SimdLevel simd : dims.simd) {
+            for (ExecutionMode mode : dims.modes) {
+                for (int threads : dims.threads) {
+                    for (int tileWidth : dims.tileWidths) {
+                        for (int tileHeight : dims.tileHeights) {
+                            consider(KernelConfig{simd, mode, threads, tileWidth, tileHeight});
+                        }
+                    }
+                }
+            }
+        }
+    } else {
+        // Optimize one dimension at a time keeping others at current best
+        for (int round = 0; round < c_searchRounds && !m_cancel; round++) {
+            for (SimdLevel simd : dims.simd) {
+                consider(KernelConfig{simd, best.mode, best.threads, best.tileWidth, best.tileHeight});
+            }
+            for (ExecutionMode mode : dims.modes) {
+                consider(KernelConfig{best.simd, mode, best.threads, best.tileWidth, best.tileHeight});
+            }
+            for (int tileHeight : dims.tileHeights) {
+                consider(KernelConfig{best.simd, best.mode, best.threads, best.tileWidth, tileHeight});
+            }
+            for (int tileWidth : dims.tileWidths) {
+                consider(KernelConfig{best.simd, best.mode, best.threads, tileWidth, best.tileHeight});
+            }
+            for (int threads : dims.threads) {
+                consider(KernelConfig{best.simd, best.mode, threads, best.tileWidth, best.tileHeight});
+            }
+        }
+    }
+
+    if (m_cancel) {
+        return false;
+    }
+
+    outEntry.kernel = CpuStylizer::getKernelName(kernel);
+    outEntry.width = width;
+    outEntry.height = height;
+    outEntry.config = best;
+    outEntry.timeMs = bestMs;
+    outEntry.baselineMs = baselineMs;
+
+    LOGI("Tuned %s %dx%d: %s, %.3f ms (default %.3f ms, %d candidates)", outEntry.kernel.c_str(), width, height, toString(best).c_str(), bestMs,
+        baselineMs, static_cast<int>(measured.size()));
+    return true;
+}
+
+bool KernelTuner::tune(const Options& options, KernelProfile& profile)
+{
+    std::vector<CpuStylizer::Kernel> kernels = options.kernels;
+    if (kernels.empty()) {
+        for (int i = 0; i < static_cast<int>(CpuStylizer::Kernel::Count); i++) {
+            kernels.push_back(static_cast<CpuStylizer::Kernel>(i));
+        }
+    }
+
+    LOGI("Tuning CPU kernels on %s using %d threads", profile.getMachineKey().c_str(), m_threadPool.getThreadCount() + 1);
+
+    for (const auto& resolution : options.resolutions) {
+        for (const auto kernel : kernels) {
+            if (options.skipExisting && profile.hasEntry(CpuStylizer::getKernelName(kernel), resolution.first, resolution.second)) {
+                continue;
+            }
+
+            KernelProfile::Entry entry;
+            if (!tuneKernel(kernel, resolution.first, resolution.second, options, entry)) {
+                LOGW("Kernel tuning cancelled.");
+                return false;
+            }
+            profile.setEntry(entry);
+        }
+    }
+
+    return true;
+}
+
+}  // namespace VarjoExamples
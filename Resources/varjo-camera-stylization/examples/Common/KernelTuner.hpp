@@ -0,0 +1,93 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <utility>
+
+#include "Globals.hpp"
+#include "ThreadPool.hpp"
+#include "CpuStylizer.hpp"
+#include "KernelProfile.hpp"
+
+namespace VarjoExamples
+{
+//! Benchmarks candidate configurations of CPU stylizer kernels on this machine and stores the
+//! fastest ones to a kernel profile.
+class KernelTuner
+{
+public:
+    //! Tuning options
+    struct Options {
+        std::vector<CpuStylizer::Kernel> kernels;      //!< Kernels to tune, empty for all
+        std::vector<std::pair<int, int>> resolutions;  //!< Resolutions to tune
+        int iterations = 15;                           //!< Timed runs per candidate
+        bool exhaustive = false;                       //!< Test every candidate instead of coordinate search
+        bool skipExisting = false;                     //!< Skip kernels already in profile
+    };
+
+    //! Construct tuner with its own worker threads. Zero thread count uses hardware concurrency minus one.
+    KernelTuner(int threadCount = 0);
+
+    // Disable copy, move and assign
+    KernelTuner(const KernelTuner& other) = delete;
+    KernelTuner(const KernelTuner&& other) = delete;
+    KernelTuner& operator=(const KernelTuner& other) = delete;
+    KernelTuner& operator=(const KernelTuner&& other) = delete;
+
+    //! Tune kernels and store results to profile. Returns false if cancelled.
+    bool tune(const Options& options, KernelProfile& profile);
+
+    //! Tune single kernel at given resolution. Returns false if cancelled.
+    bool tuneKernel(CpuStylizer::Kernel kernel, int width, int height, const Options& options, KernelProfile::Entry& outEntry);
+
+    //! Measure median kernel time in milliseconds
+    double benchmark(CpuStylizer::Kernel kernel, const KernelConfig& config, int width, int height, int iterations);
+
+    //! Measure median kernel time in milliseconds with given effect parameters
+    double benchmark(CpuStylizer::Kernel kernel, const KernelConfig& config, const CpuStylizer::Params& params, int width, int height, int iterations);
+
+    //! Returns default configuration used when kernel has no tuning results
+    static KernelConfig getDefaultConfig(CpuStylizer::Kernel kernel);
+
+    //! Returns effect parameters used for benchmarking kernel
+    static CpuStylizer::Params getBenchmarkParams(CpuStylizer::Kernel kernel);
+
+    //! Returns stylizer under test
+    CpuStylizer& getStylizer() { return m_stylizer; }
+
+    //! Returns output image of last benchmark run
+    const std::vector<uint8_t>& getOutput() const { return m_output; }
+
+    //! Cancel running tuning from another thread
+    void cancel() { m_cancel = true; }
+
+private:
+    //! Candidate values for each configuration dimension
+    struct Dimensions {
+        std::vector<SimdLevel> simd;       //!< SIMD levels
+        std::vector<ExecutionMode> modes;  //!< Execution modes
+        std::vector<int> threads;          //!< Thread counts
+        std::vector<int> tileWidths;       //!< Tile widths
+        std::vector<int> tileHeights;      //!< Tile heights
+    };
+
+    //! Returns candidate dimensions for kernel
+    Dimensions getDimensions(CpuStylizer::Kernel kernel, int width) const;
+
+    //! Generate synthetic input images
+    void prepareInput(int width, int height);
+
+private:
+    ThreadPool m_threadPool;        //!< Benchmark worker threads
+    CpuStylizer m_stylizer;         //!< Stylizer under test
+    std::atomic_bool m_cancel;      //!< Cancel flag
+    int m_inputWidth = 0;           //!< Input image width
+    int m_inputHeight = 0;          //!< Input image height
+    std::vector<uint8_t> m_rgba;    //!< RGBA8 input image
+    std::vector<uint8_t> m_yuv;     //!< YUV422 input buffer, NV12 uses the first part of the chroma plane
+    std::vector<uint8_t> m_output;  //!< Output image
+};
+
+}  // namespace VarjoExamples
@@ -0,0 +1,166 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "LateLatch.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include <Varjo_mr_experimental.h>
+
+using namespace VarjoExamples;
+
+LateLatch::LateLatch(varjo_Session* session, const Config& config, LatchFunction latchFunction)
+    : m_session(session)
+    , m_config(config)
+    , m_latchFunction(std::move(latchFunction))
+{
+}
+
+LateLatch::~LateLatch() { stop(); }
+
+void LateLatch::start()
+{
+    if (m_thread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = false;
+        m_hasPending = false;
+    }
+    m_submittedSize = -1;
+    m_thread = std::thread(&LateLatch::latchMain, this);
+}
+
+void LateLatch::stop()
+{
+    if (!m_thread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_quit = true;
+    }
+    m_cond.notify_all();
+    m_thread.join();
+}
+
+bool LateLatch::submit(const Frame& frame)
+{
+    if (frame.constantSize < 0 || frame.constantSize > c_maxConstantSize) {
+        LOGE("Invalid late latch constant buffer size: %d", frame.constantSize);
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_hasPending) {
+            m_stats.superseded++;
+        }
+        m_pending = frame;
+        m_hasPending = true;
+        m_stats.frames++;
+    }
+    m_cond.notify_one();
+    return true;
+}
+
+LateLatch::Stats LateLatch::getStats() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void LateLatch::setMetrics(MetricsRegistry* metrics)
+{
+    m_metrics = metrics;
+    if (metrics) {
+        m_latchMetric = metrics->addMetric("Late latch: latch", MetricsRegistry::Kind::Timer);
+        m_ageMetric = metrics->addMetric("Late latch: data age", MetricsRegistry::Kind::Timer);
+        m_missedMetric = metrics->addMetric("Late latch: missed", MetricsRegistry::Kind::Counter);
+    } else {
+        m_latchMetric = m_ageMetric = m_missedMetric = MetricsRegistry::c_invalidId;
+    }
+}
+
+void LateLatch::latchMain()
+{
+    const int64_t leadNs = static_cast<int64_t>((m_config.compositorLeadMs + m_config.marginMs) * 1e6);
+    const int64_t spinNs = static_cast<int64_t>(m_config.spinMs * 1e6);
+
+    // Stream processing must not delay the latch
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while (!m_quit) {
+        if (!m_hasPending) {
+            m_cond.wait(lock);
+            continue;
+        }
+
+        // Sleep until shortly before latch time. New frame or stop wakes up and starts over.
+        const varjo_Nanoseconds latchTime = m_pending.displayTime - leadNs;
+        const varjo_Nanoseconds now = varjo_GetCurrentTime(m_session);
+        if (now < latchTime - spinNs) {
+            m_cond.wait_for(lock, std::chrono::nanoseconds(latchTime - spinNs - now));
+            continue;
+        }
+
+        m_latching = m_pending;
+        m_hasPending = false;
+        lock.unlock();
+        latch(latchTime);
+        lock.lock();
+    }
+}
+
+void LateLatch::latch(varjo_Nanoseconds latchTime)
+{
+    varjo_Nanoseconds now = varjo_GetCurrentTime(m_session);
+    while (now < latchTime) {
+        std::this_thread::yield();
+        now = varjo_GetCurrentTime(m_session);
+    }
+
+    const int64_t begin = getTimestampNs();
+    Frame& frame = m_latching;
+    const varjo_Nanoseconds frameSampleTime = frame.sampleTime;
+    const varjo_Nanoseconds sampleTime = m_latchFunction(frame);
+
+    const size_t size = static_cast<size_t>(frame.constantSize);
+    const bool changed = frame.constantSize != m_submittedSize || memcmp(frame.constants.data(), m_submitted.data(), size) != 0;
+    if (changed) {
+        varjo_MRSubmitShaderInputs(m_session, m_config.shaderType, nullptr, 0, frame.constants.data(), frame.constantSize);
+        CHECK_VARJO_ERR(m_session);
+        memcpy(m_submitted.data(), frame.constants.data(), size);
+        m_submittedSize = frame.constantSize;
+    }
+
+    const varjo_Nanoseconds deadline = frame.displayTime - static_cast<int64_t>(m_config.compositorLeadMs * 1e6);
+    const bool missed = varjo_GetCurrentTime(m_session) > deadline;
+    const int64_t latchTimeNs = getTimestampNs() - begin;
+    const int64_t wakeDelayNs = now - latchTime;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.latched++;
+        m_stats.submitted += changed ? 1 : 0;
+        m_stats.unchanged += changed ? 0 : 1;
+        m_stats.missed += missed ? 1 : 0;
+        m_stats.frameAgeNs += frame.displayTime - frameSampleTime;
+        m_stats.latchedAgeNs += frame.displayTime - sampleTime;
+        m_stats.wakeDelayNs += wakeDelayNs;
+        m_stats.maxWakeDelayNs = std::max(m_stats.maxWakeDelayNs, wakeDelayNs);
+        m_stats.latchTimeNs += latchTimeNs;
+    }
+
+    if (m_metrics) {
+        m_metrics->recordTime(m_latchMetric, latchTimeNs);
+        m_metrics->recordTime(m_ageMetric, frame.displayTime - sampleTime);
+        if (missed) {
+            m_metrics->increment(m_missedMetric);
+        }
+    }
+}
@@ -0,0 +1,144 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <glm/glm.hpp>
+
+#include <Varjo.h>
+#include <Varjo_types_mr_experimental.h>
+
+#include "Globals.hpp"
+#include "MetricsRegistry.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Late latch submits post process shader inputs that depend on head or eye pose, e.g. gaze
+// point, marker regions of interest and reprojection of the render pose, as close to the compositor
+// deadline as possible. Frame loop builds the constant buffer after frame sync and passes it here
+// instead of submitting it. Latch thread sleeps until shortly before the deadline of the frame on
+// the runtime frame clock, recomputes the pose dependent fields with the latest samples through the
+// latch function, and submits the constant buffer. Sleep is coarse, so the last moment is spun.
+// Latch thread runs at high priority, so that worker threads do not delay it.
+//
+// varjo_MRSubmitShaderInputs() replaces the whole constant buffer, so the latched buffer is
+// submitted as a whole. If it is identical to the last submitted buffer, nothing is submitted.
+// Textures are not touched, frame loop keeps submitting its texture updates itself.
+//
+// If the next frame is passed before the previous one was latched, the previous one is dropped.
+// Latches that finish after the deadline are counted missed, compositor would use them one frame
+// late. Statistics compare age of data at display time between samples taken on frame thread and
+// samples taken at latch time.
+
+//! Submits pose dependent shader inputs on own thread just before compositor deadline
+class LateLatch
+{
+public:
+    //! Largest constant buffer size
+    static constexpr int32_t c_maxConstantSize = 256;
+
+    //! Latch configuration
+    struct Config {
+        double compositorLeadMs = 2.0;                                    //!< Time before display time when compositor takes shader inputs
+        double marginMs = 1.0;                                            //!< Time before compositor deadline when inputs are latched
+        double spinMs = 0.5;                                              //!< Time spun instead of slept before latch time
+        varjo_ShaderType shaderType = varjo_ShaderType_VideoPostProcess;  //!< Shader of submitted inputs
+    };
+
+    //! Frame to latch
+    struct Frame {
+        int64_t frameNumber = 0;                          //!< Frame number
+        varjo_Nanoseconds displayTime = 0;                //!< Predicted display time of frame
+        glm::mat4 view{1.0f};                             //!< View matrix frame was rendered with
+        glm::mat4 projection{1.0f};                       //!< Projection matrix frame was rendered with
+        varjo_Nanoseconds sampleTime = 0;                 //!< Oldest sample time of pose dependent inputs in constants
+        int32_t constantSize = 0;                         //!< Constant buffer size
+        std::array<char, c_maxConstantSize> constants{};  //!< Constant buffer
+    };
+
+    //! Latch statistics
+    struct Stats {
+        int64_t frames = 0;          //!< Frames passed for latching
+        int64_t latched = 0;         //!< Latched frames
+        int64_t superseded = 0;      //!< Frames dropped because next frame was passed before latch
+        int64_t submitted = 0;       //!< Latched constant buffers submitted
+        int64_t unchanged = 0;       //!< Latched constant buffers identical to last submitted, not submitted
+        int64_t missed = 0;          //!< Latches finished after compositor deadline
+        int64_t frameAgeNs = 0;      //!< Total display time minus sample time of latched frames as sampled on frame thread
+        int64_t latchedAgeNs = 0;    //!< Total display time minus sample time of latched frames as sampled at latch
+        int64_t wakeDelayNs = 0;     //!< Total delay of latch after latch time
+        int64_t maxWakeDelayNs = 0;  //!< Longest delay of latch after latch time
+        int64_t latchTimeNs = 0;     //!< Total latch function and submit time
+    };
+
+    //! Recomputes pose dependent inputs in frame constants for its display time. Returns oldest
+    //! sample time of recomputed inputs. Called from latch thread.
+    using LatchFunction = std::function<varjo_Nanoseconds(Frame& frame)>;
+
+    //! Construct late latch submitting to given session
+    LateLatch(varjo_Session* session, const Config& config, LatchFunction latchFunction);
+
+    //! Destruct late latch. Stops latch thread.
+    ~LateLatch();
+
+    // Disable copy, move and assign
+    LateLatch(const LateLatch& other) = delete;
+    LateLatch(const LateLatch&& other) = delete;
+    LateLatch& operator=(const LateLatch& other) = delete;
+    LateLatch& operator=(const LateLatch&& other) = delete;
+
+    //! Start latch thread
+    void start();
+
+    //! Stop latch thread. Pending frame is not latched.
+    void stop();
+
+    //! Returns true if latch thread is running
+    bool isRunning() const { return m_thread.joinable(); }
+
+    //! Pass frame for latching. Call from frame thread after frame sync. Returns false if constant buffer is too large.
+    bool submit(const Frame& frame);
+
+    //! Returns latch statistics
+    Stats getStats() const;
+
+    //! Register latch timer, data age timer and missed counter metrics to given registry. Pass null to stop
+    //! publishing. Call before start.
+    void setMetrics(MetricsRegistry* metrics);
+
+private:
+    //! Latch thread main function
+    void latchMain();
+
+    //! Spin until latch time, then latch and submit frame being latched. Called from latch thread without lock.
+    void latch(varjo_Nanoseconds latchTime);
+
+private:
+    varjo_Session* const m_session;       //!< Varjo session
+    const Config m_config;                //!< Latch configuration
+    const LatchFunction m_latchFunction;  //!< Pose dependent input function
+    std::thread m_thread;                 //!< Latch thread
+
+    mutable std::mutex m_mutex;      //!< Pending frame, quit flag and statistics mutex
+    std::condition_variable m_cond;  //!< Signaled on new frame and stop
+    bool m_quit = false;             //!< Quit flag for latch thread
+    bool m_hasPending = false;       //!< Pending frame not latched yet
+    Frame m_pending;                 //!< Last frame passed for latching
+    Stats m_stats{};                 //!< Latch statistics
+
+    Frame m_latching;                                   //!< Frame being latched, owned by latch thread
+    std::array<char, c_maxConstantSize> m_submitted{};  //!< Last submitted constant buffer, owned by latch thread
+    int32_t m_submittedSize = -1;                       //!< Last submitted constant buffer size, -1 if none
+
+    MetricsRegistry* m_metrics = nullptr;                               //!< Metrics registry, null if not published
+    MetricsRegistry::Id m_latchMetric = MetricsRegistry::c_invalidId;   //!< Latch timer
+    MetricsRegistry::Id m_ageMetric = MetricsRegistry::c_invalidId;     //!< Latched data age timer
+    MetricsRegistry::Id m_missedMetric = MetricsRegistry::c_invalidId;  //!< Missed deadline counter
+};
+
+}  // namespace VarjoExamples
@@ -18,6 +18,12 @@ LayerView::LayerView(varjo_Session* session, Renderer& renderer)
 
     // Allocate view specific data
     m_viewports = calculateViewports(getSession());
+    m_fullViewports = m_viewports;
+    m_viewScales.assign(m_viewCount, 1.0f);
+    m_focusViews.resize(m_viewCount);
+    for (int i = 0; i < m_viewCount; i++) {
+        m_focusViews[i] = varjo_GetViewDescription(getSession(), i).display == varjo_DisplayType_Focus;
+    }
     m_multiProjViews.resize(m_viewCount);
     m_extDepthViews.resize(m_viewCount);
     m_extDepthTestRangeViews.resize(m_viewCount);
@@ -35,8 +41,7 @@ void LayerView::setupViews()
     // Setup views
     for (int i = 0; i < m_viewCount; ++i) {
         // Viewport layout
-        const varjo_Viewport& viewport = m_viewports[i];
-        m_multiProjViews[i].viewport = varjo_SwapChainViewport{m_colorSwapChain, viewport.x, viewport.y, viewport.width, viewport.height, 0};
+        updateSubmitViewports(i);
 
         // Notice that we set extension links nullptr here and do the actual linking later
         // in render call according to the render parameters.
@@ -48,7 +53,6 @@ void LayerView::setupViews()
         m_extDepthViews[i].maxDepth = 1.0;
         m_extDepthViews[i].nearZ = c_nearClipPlane;
         m_extDepthViews[i].farZ = c_farClipPlane;
-        m_extDepthViews[i].viewport = varjo_SwapChainViewport{m_depthSwapChain, viewport.x, viewport.y, viewport.width, viewport.height, 0};
 
         // Depth test range extension
         m_extDepthTestRangeViews[i].header.type = varjo_ViewExtensionDepthTestRangeType;
@@ -58,6 +62,13 @@ void LayerView::setupViews()
     }
 }
 
+void LayerView::updateSubmitViewports(int i)
+{
+    const varjo_Viewport& viewport = m_viewports[i];
+    m_multiProjViews[i].viewport = varjo_SwapChainViewport{m_colorSwapChain, viewport.x, viewport.y, viewport.width, viewport.height, 0};
+    m_extDepthViews[i].viewport = varjo_SwapChainViewport{m_depthSwapChain, viewport.x, viewport.y, viewport.width, viewport.height, 0};
+}
+
 std::vector<varjo_Viewport> LayerView::calculateViewports(varjo_Session* session) const
 {
     const int viewsPerRow = 2;
@@ -116,6 +127,18 @@ void LayerView::syncFrame()
     // Reset update state
     m_updateState = {};
 
+    // Apply view scales. Scaled viewports stay at the top left corner of their full viewport.
+    for (int i = 0; i < m_viewCount; i++) {
+        const varjo_Viewport& full = m_fullViewports[i];
+        const float scale = (std::max)(0.0f, (std::min)(1.0f, m_viewScales[i]));
+        const int32_t width = (std::max)(1, static_cast<int32_t>(full.width * scale + 0.5f));
+        const int32_t height = (std::max)(1, static_cast<int32_t>(full.height * scale + 0.5f));
+        if (width != m_viewports[i].width || height != m_viewports[i].height) {
+            m_viewports[i] = varjo_Viewport{full.x, full.y, width, height};
+            updateSubmitViewports(i);
+        }
+    }
+
     // Iterate views to update
     for (int i = 0; i < m_viewCount; i++) {
         // Get the view information for this frame.
@@ -93,6 +93,27 @@ public:
     //! Return viewport for given view index
     const varjo_Viewport& getViewport(int i) const { return m_viewports.at(i); }
 
+    //! Return full resolution viewport for given view index
+    const varjo_Viewport& getFullViewport(int i) const { return m_fullViewports.at(i); }
+
+    //! Returns true if view is shown on focus display
+    bool isFocusView(int i) const { return m_focusViews.at(i); }
+
+    //! Returns projection matrix of given view index from last syncFrame()
+    glm::mat4 getProjectionMatrix(int i) const { return fromVarjoMatrix(m_multiProjViews.at(i).projection); }
+
+    //! Returns view matrix of given view index from last syncFrame()
+    glm::mat4 getViewMatrix(int i) const { return fromVarjoMatrix(m_multiProjViews.at(i).view); }
+
+    //! Set render scale in (0, 1] for given view index. Applied from next syncFrame().
+    //!
+    //! NOTICE! Swap chains keep their full size. Scaled views render to the top left part of their
+    //! full viewport and the smaller viewport is submitted, so the compositor upsamples the view.
+    void setViewScale(int i, float scale) { m_viewScales.at(i) = scale; }
+
+    //! Returns render scale for given view index
+    float getViewScale(int i) const { return m_viewScales.at(i); }
+
     //! From SyncFrame. Called to sync varjo frame before rendering.
     void syncFrame() override;
 
@@ -121,6 +142,9 @@ protected:
     //! Setup multi view structures. Called from implementing class constructor.
     void setupViews();
 
+    //! Update submitted color and depth viewports of view from its current viewport
+    void updateSubmitViewports(int i);
+
     //! Returns width of a texture which can fit all specified viewports
     static int32_t getTotalWidth(const std::vector<varjo_Viewport>& viewports);
 
@@ -138,7 +162,10 @@ protected:
 
     // View specific data
     int32_t m_viewCount = 0;                                                  //!< Number of views
-    std::vector<varjo_Viewport> m_viewports;                                  //!< View port layout for each view
+    std::vector<varjo_Viewport> m_viewports;                                  //!< View port layout for each view, scaled
+    std::vector<varjo_Viewport> m_fullViewports;                              //!< Full resolution view port layout for each view
+    std::vector<float> m_viewScales;                                          //!< Render scale for each view
+    std::vector<bool> m_focusViews;                                           //!< Focus display flag for each view
     std::vector<varjo_LayerMultiProjView> m_multiProjViews;                   //!< Multi projection views for each view
     std::vector<varjo_ViewExtensionDepth> m_extDepthViews;                    //!< Client depth extension for each view
     std::vector<varjo_ViewExtensionDepthTestRange> m_extDepthTestRangeViews;  //!< Client depth test range extension for each view
@@ -0,0 +1,106 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "LogRing.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+// Round up to power of two
+size_t roundUpPow2(size_t value)
+{
+    size_t result = 1;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+// Sequence number of published record
+inline uint64_t publishedSequence(uint64_t index) { return 2 * index + 2; }
+
+// Sequence number of record being written
+inline uint64_t writingSequence(uint64_t index) { return 2 * index + 1; }
+
+}  // namespace
+
+namespace VarjoExamples
+{
+constexpr size_t LogRing::c_maxTextLength;
+constexpr size_t LogRing::c_defaultCapacity;
+
+LogRing::LogRing(size_t capacity)
+    : m_capacity(roundUpPow2(std::max<size_t>(capacity, 2)))
+    , m_slots(new Slot[m_capacity])
+    , m_memory(MemoryTag::UI, m_capacity * sizeof(Slot))
+{
+}
+
+void LogRing::write(LogLevel level, const std::string& text)
+{
+    const int64_t timestamp = getTimestampNs();
+    const uint64_t index = m_writeIndex.fetch_add(1, std::memory_order_relaxed);
+    Slot& slot = m_slots[index & (m_capacity - 1)];
+
+    // Take slot unless a newer writer already owns it or an older one is still writing it
+    uint64_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    do {
+        if ((sequence & 1) != 0 || sequence >= writingSequence(index)) {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    } while (!slot.sequence.compare_exchange_weak(sequence, writingSequence(index), std::memory_order_acquire, std::memory_order_relaxed));
+    std::atomic_thread_fence(std::memory_order_release);
+
+    // Strip trailing line feeds
+    size_t length = text.size();
+    while (length > 0 && (text[length - 1] == '\n' || text[length - 1] == '\r')) {
+        length--;
+    }
+    length = std::min(length, c_maxTextLength - 1);
+
+    Record& record = slot.record;
+    record.index = index;
+    record.timestamp = timestamp;
+    record.threadId = static_cast<uint32_t>(GetCurrentThreadId());
+    record.level = level;
+    record.length = static_cast<uint32_t>(length);
+    memcpy(record.text, text.data(), length);
+    record.text[length] = '\0';
+
+    slot.sequence.store(publishedSequence(index), std::memory_order_release);
+}
+
+bool LogRing::read(uint64_t index, Record& outRecord) const
+{
+    const Slot& slot = m_slots[index & (m_capacity - 1)];
+    if (slot.sequence.load(std::memory_order_acquire) != publishedSequence(index)) {
+        return false;
+    }
+
+    // Copy only used part of text, then make sure the slot was not taken while copying
+    outRecord.index = slot.record.index;
+    outRecord.timestamp = slot.record.timestamp;
+    outRecord.threadId = slot.record.threadId;
+    outRecord.level = slot.record.level;
+    outRecord.length = std::min<uint32_t>(slot.record.length, c_maxTextLength - 1);
+    memcpy(outRecord.text, slot.record.text, outRecord.length);
+    outRecord.text[outRecord.length] = '\0';
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return slot.sequence.load(std::memory_order_relaxed) == publishedSequence(index);
+}
+
+bool LogRing::isPublished(uint64_t index) const
+{
+    return m_slots[index & (m_capacity - 1)].sequence.load(std::memory_order_acquire) == publishedSequence(index);
+}
+
+uint64_t LogRing::getOldestIndex() const
+{
+    const uint64_t writeIndex = getWriteIndex();
+    return writeIndex > m_capacity ? writeIndex - m_capacity : 0;
+}
+
+}  // namespace VarjoExamples
@@ -0,0 +1,84 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+#include "Globals.hpp"
+#include "MemoryAccounting.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Writers claim records with a single atomic increment and publish them with a per slot
+// sequence number, so logging threads never take a lock or wait for the reader. Reader copies
+// records out and detects records that were overwritten while copying. If writers lap the reader,
+// the oldest records are lost.
+
+//! Fixed capacity multi producer ring of log records
+class LogRing
+{
+public:
+    //! Maximum stored text length in bytes, including terminator. Longer lines are truncated.
+    static constexpr size_t c_maxTextLength = 224;
+
+    //! Default record capacity
+    static constexpr size_t c_defaultCapacity = 4096;
+
+    //! Log record
+    struct Record {
+        uint64_t index = 0;               //!< Running record index
+        int64_t timestamp = 0;            //!< Write timestamp in nanoseconds
+        uint32_t threadId = 0;            //!< Writing thread id
+        LogLevel level = LogLevel::Info;  //!< Log level
+        uint32_t length = 0;              //!< Text length without terminator
+        char text[c_maxTextLength] = {};  //!< Null terminated text
+    };
+
+    //! Construct ring. Capacity is rounded up to power of two.
+    LogRing(size_t capacity = c_defaultCapacity);
+
+    // Disable copy, move and assign
+    LogRing(const LogRing& other) = delete;
+    LogRing(const LogRing&& other) = delete;
+    LogRing& operator=(const LogRing& other) = delete;
+    LogRing& operator=(const LogRing&& other) = delete;
+
+    //! Write record. Lock free, can be called from any thread.
+    void write(LogLevel level, const std::string& text);
+
+    //! Read record with given index. Returns false if record is not yet written or was overwritten.
+    bool read(uint64_t index, Record& outRecord) const;
+
+    //! Returns true if record with given index is published and not yet overwritten
+    bool isPublished(uint64_t index) const;
+
+    //! Returns index of next record to be written, i.e. total number of records written
+    uint64_t getWriteIndex() const { return m_writeIndex.load(std::memory_order_acquire); }
+
+    //! Returns index of oldest record that may still be available
+    uint64_t getOldestIndex() const;
+
+    //! Returns number of records dropped because ring wrapped during write
+    uint64_t getDroppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    //! Returns record capacity
+    size_t getCapacity() const { return m_capacity; }
+
+private:
+    //! Record slot guarded by sequence number: odd while writing, even when published
+    struct Slot {
+        std::atomic<uint64_t> sequence{0};  //!< Slot sequence number
+        Record record;                      //!< Record data
+    };
+
+    const size_t m_capacity;                //!< Record capacity
+    std::unique_ptr<Slot[]> m_slots;        //!< Record slots
+    std::atomic<uint64_t> m_writeIndex{0};  //!< Next record index
+    std::atomic<uint64_t> m_dropped{0};     //!< Dropped record count
+    TrackedBytes m_memory;                  //!< Record slot memory hook
+};
+
+}  // namespace VarjoExamples
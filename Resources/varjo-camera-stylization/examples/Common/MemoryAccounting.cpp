@@ -0,0 +1,144 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include <windows.h>
+#include <psapi.h>
+
+#include "MemoryAccounting.hpp"
+
+#include <atomic>
+#include <string>
+
+using namespace VarjoExamples;
+
+namespace
+{
+// Minimum time between shed calls of a tag, so that shedding has time to take effect
+constexpr int64_t c_shedIntervalNs = 1000000000;
+
+// Tag names in tag order
+const char* c_tagNames[MemoryAccounting::c_tagCount] = {"stream", "cubemap", "stylization", "renderer", "ui", "markers"};
+
+// Global counters
+std::atomic<int64_t> g_bytes[MemoryAccounting::c_tagCount];
+std::atomic<int64_t> g_peakBytes[MemoryAccounting::c_tagCount];
+std::atomic<int64_t> g_allocations[MemoryAccounting::c_tagCount];
+std::atomic<int64_t> g_frees[MemoryAccounting::c_tagCount];
+
+}  // namespace
+
+void MemoryAccounting::onAllocate(MemoryTag tag, size_t bytes)
+{
+    const int i = static_cast<int>(tag);
+    const int64_t current = g_bytes[i].fetch_add(static_cast<int64_t>(bytes), std::memory_order_relaxed) + static_cast<int64_t>(bytes);
+    g_allocations[i].fetch_add(1, std::memory_order_relaxed);
+
+    int64_t peak = g_peakBytes[i].load(std::memory_order_relaxed);
+    while (current > peak && !g_peakBytes[i].compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+    }
+}
+
+void MemoryAccounting::onFree(MemoryTag tag, size_t bytes)
+{
+    const int i = static_cast<int>(tag);
+    g_bytes[i].fetch_sub(static_cast<int64_t>(bytes), std::memory_order_relaxed);
+    g_frees[i].fetch_add(1, std::memory_order_relaxed);
+}
+
+MemoryAccounting::TagStats MemoryAccounting::getStats(MemoryTag tag)
+{
+    const int i = static_cast<int>(tag);
+    TagStats stats;
+    stats.bytes = g_bytes[i].load(std::memory_order_relaxed);
+    stats.peakBytes = g_peakBytes[i].load(std::memory_order_relaxed);
+    stats.allocations = g_allocations[i].load(std::memory_order_relaxed);
+    stats.frees = g_frees[i].load(std::memory_order_relaxed);
+    return stats;
+}
+
+int64_t MemoryAccounting::getTotalBytes()
+{
+    int64_t total = 0;
+    for (int i = 0; i < c_tagCount; i++) {
+        total += g_bytes[i].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+const char* MemoryAccounting::getTagName(MemoryTag tag) { return c_tagNames[static_cast<int>(tag)]; }
+
+bool MemoryAccounting::findTag(const std::string& name, MemoryTag& outTag)
+{
+    for (int i = 0; i < c_tagCount; i++) {
+        if (name == c_tagNames[i]) {
+            outTag = static_cast<MemoryTag>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+int64_t MemoryAccounting::getProcessResidentBytes()
+{
+    PROCESS_MEMORY_COUNTERS counters{};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+        return 0;
+    }
+    return static_cast<int64_t>(counters.WorkingSetSize);
+}
+
+//---------------------------------------------------------------------------
+
+void MemoryBudget::setMetrics(MetricsRegistry* metrics)
+{
+    m_metrics = metrics;
+    if (m_metrics) {
+        for (int i = 0; i < MemoryAccounting::c_tagCount; i++) {
+            const std::string name = std::string("Memory: ") + c_tagNames[i];
+            m_tags[i].bytesMetric = m_metrics->addMetric(name.c_str(), MetricsRegistry::Kind::Gauge);
+        }
+        m_totalMetric = m_metrics->addMetric("Memory: tagged total", MetricsRegistry::Kind::Gauge);
+        m_warningsMetric = m_metrics->addMetric("Memory: budget warnings", MetricsRegistry::Kind::Counter);
+        m_shedsMetric = m_metrics->addMetric("Memory: budget sheds", MetricsRegistry::Kind::Counter);
+    }
+}
+
+void MemoryBudget::update(int64_t nowNs)
+{
+    m_stats.checks++;
+
+    int64_t total = 0;
+    for (int i = 0; i < MemoryAccounting::c_tagCount; i++) {
+        TagState& state = m_tags[i];
+        const int64_t bytes = g_bytes[i].load(std::memory_order_relaxed);
+        total += bytes;
+        if (m_metrics) {
+            m_metrics->set(state.bytesMetric, bytes);
+        }
+
+        const bool over = state.budget.bytes > 0 && bytes > state.budget.bytes;
+        if (over && !state.over) {
+            LOGW("Memory budget exceeded: %s %.1f MB, budget %.1f MB", c_tagNames[i], bytes / (1024.0 * 1024.0),
+                state.budget.bytes / (1024.0 * 1024.0));
+            m_stats.warnings++;
+            if (m_metrics) {
+                m_metrics->increment(m_warningsMetric);
+            }
+        } else if (!over && state.over) {
+            LOGI("Memory back within budget: %s %.1f MB", c_tagNames[i], bytes / (1024.0 * 1024.0));
+        }
+        state.over = over;
+
+        if (over && state.budget.policy == Policy::Shed && state.shedFunction && nowNs - state.lastShedNs >= c_shedIntervalNs) {
+            state.lastShedNs = nowNs;
+            state.shedFunction(bytes - state.budget.bytes);
+            m_stats.sheds++;
+            if (m_metrics) {
+                m_metrics->increment(m_shedsMetric);
+            }
+        }
+    }
+
+    if (m_metrics) {
+        m_metrics->set(m_totalMetric, total);
+    }
+}
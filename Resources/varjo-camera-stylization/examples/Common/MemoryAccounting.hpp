@@ -0,0 +1,259 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <array>
+#include <vector>
+#include <memory>
+#include <string>
+#include <functional>
+
+#include "Globals.hpp"
+#include "MetricsRegistry.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Memory accounting attributes long lived buffers to subsystems so that growth in a long
+// session can be traced to its owner. Containers use TrackedAllocator, and memory that is not
+// allocated through containers, like locked runtime buffers and GPU textures, is reported through
+// TrackedBytes hooks. Counters are global relaxed atomics, so accounting adds no locking to
+// allocation paths and works across all threads.
+//
+// Only tagged memory is counted. Small and short lived allocations are not worth tagging, use
+// process resident memory for the total.
+//
+// MemoryBudget compares tagged memory against configured budgets on the thread that owns it,
+// warns when a budget is exceeded and calls shed functions that release or downgrade buffers.
+// Shed functions are called from MemoryBudget::update(), so they must hand work to the owning
+// thread if the subsystem is not thread safe.
+
+//! Subsystems memory is attributed to
+enum class MemoryTag {
+    Stream = 0,   //!< Stream consumers and buffers held from runtime
+    Cubemap,      //!< Environment cubemap copies
+    Stylization,  //!< CPU stylizer intermediates and scratch
+    Renderer,     //!< Meshes and textures
+    UI,           //!< Log and UI buffers
+    Markers,      //!< Marker detection and tracking
+    Count
+};
+
+//! Global per subsystem memory counters
+class MemoryAccounting
+{
+public:
+    //! Number of tags
+    static constexpr int c_tagCount = static_cast<int>(MemoryTag::Count);
+
+    //! Counters of one tag
+    struct TagStats {
+        int64_t bytes = 0;        //!< Currently allocated bytes
+        int64_t peakBytes = 0;    //!< Peak allocated bytes
+        int64_t allocations = 0;  //!< Total allocations
+        int64_t frees = 0;        //!< Total frees
+    };
+
+    //! Count allocation. Lock free, can be called from any thread.
+    static void onAllocate(MemoryTag tag, size_t bytes);
+
+    //! Count free. Lock free, can be called from any thread.
+    static void onFree(MemoryTag tag, size_t bytes);
+
+    //! Returns counters of given tag
+    static TagStats getStats(MemoryTag tag);
+
+    //! Returns currently allocated bytes of all tags
+    static int64_t getTotalBytes();
+
+    //! Returns tag name
+    static const char* getTagName(MemoryTag tag);
+
+    //! Find tag by name. Returns false if name is unknown.
+    static bool findTag(const std::string& name, MemoryTag& outTag);
+
+    //! Returns resident memory of process in bytes, including untagged memory
+    static int64_t getProcessResidentBytes();
+};
+
+//! Standard allocator adaptor counting container memory to given tag
+template <typename T, MemoryTag Tag>
+class TrackedAllocator
+{
+public:
+    using value_type = T;
+
+    //! Rebind for containers allocating internal nodes
+    template <typename U>
+    struct rebind {
+        using other = TrackedAllocator<U, Tag>;
+    };
+
+    //! Constructor
+    TrackedAllocator() = default;
+
+    //! Converting constructor
+    template <typename U>
+    TrackedAllocator(const TrackedAllocator<U, Tag>&)
+    {
+    }
+
+    //! Allocate storage for n objects
+    T* allocate(size_t n)
+    {
+        T* ptr = std::allocator<T>().allocate(n);
+        MemoryAccounting::onAllocate(Tag, n * sizeof(T));
+        return ptr;
+    }
+
+    //! Free storage of n objects
+    void deallocate(T* ptr, size_t n)
+    {
+        MemoryAccounting::onFree(Tag, n * sizeof(T));
+        std::allocator<T>().deallocate(ptr, n);
+    }
+
+    //! Allocators are stateless, so all instances are equal
+    template <typename U>
+    bool operator==(const TrackedAllocator<U, Tag>&) const
+    {
+        return true;
+    }
+
+    //! Allocators are stateless, so all instances are equal
+    template <typename U>
+    bool operator!=(const TrackedAllocator<U, Tag>&) const
+    {
+        return false;
+    }
+};
+
+//! Vector counting its storage to given tag
+template <typename T, MemoryTag Tag>
+using TrackedVector = std::vector<T, TrackedAllocator<T, Tag>>;
+
+//! Hook reporting memory not allocated through tracked containers. Reported size is released on destruction,
+//! and copies report the same size again, so that hooks can be members of copyable objects.
+class TrackedBytes
+{
+public:
+    //! Constructor
+    TrackedBytes(MemoryTag tag, size_t bytes = 0)
+        : m_tag(tag)
+    {
+        set(bytes);
+    }
+
+    //! Copy constructor
+    TrackedBytes(const TrackedBytes& other)
+        : m_tag(other.m_tag)
+    {
+        set(other.m_bytes);
+    }
+
+    //! Destructor
+    ~TrackedBytes() { set(0); }
+
+    //! Copy assignment. Tag is kept, size is copied.
+    TrackedBytes& operator=(const TrackedBytes& other)
+    {
+        set(other.m_bytes);
+        return *this;
+    }
+
+    //! Set reported size
+    void set(size_t bytes)
+    {
+        if (bytes > m_bytes) {
+            MemoryAccounting::onAllocate(m_tag, bytes - m_bytes);
+        } else if (bytes < m_bytes) {
+            MemoryAccounting::onFree(m_tag, m_bytes - bytes);
+        }
+        m_bytes = bytes;
+    }
+
+    //! Returns reported size
+    size_t get() const { return m_bytes; }
+
+private:
+    const MemoryTag m_tag;  //!< Accounted tag
+    size_t m_bytes = 0;     //!< Reported size
+};
+
+//! Checks tagged memory against budgets and applies budget policies. Not thread safe, use from one thread.
+class MemoryBudget
+{
+public:
+    //! Action taken when budget is exceeded
+    enum class Policy {
+        Warn = 0,  //!< Log warning
+        Shed,      //!< Log warning and call shed function
+    };
+
+    //! Budget of one tag
+    struct Budget {
+        int64_t bytes = 0;             //!< Budget in bytes, zero for unlimited
+        Policy policy = Policy::Warn;  //!< Policy when exceeded
+    };
+
+    //! Shed function called with bytes over budget. Should release or downgrade buffers of the tag.
+    using ShedFunction = std::function<void(int64_t excessBytes)>;
+
+    //! Budget statistics
+    struct Stats {
+        int64_t checks = 0;    //!< Budget checks
+        int64_t warnings = 0;  //!< Times a budget was exceeded
+        int64_t sheds = 0;     //!< Shed function calls
+    };
+
+    //! Constructor
+    MemoryBudget() = default;
+
+    // Disable copy, move and assign
+    MemoryBudget(const MemoryBudget& other) = delete;
+    MemoryBudget(const MemoryBudget&& other) = delete;
+    MemoryBudget& operator=(const MemoryBudget& other) = delete;
+    MemoryBudget& operator=(const MemoryBudget&& other) = delete;
+
+    //! Set budget of given tag
+    void setBudget(MemoryTag tag, const Budget& budget) { m_tags[static_cast<int>(tag)].budget = budget; }
+
+    //! Returns budget of given tag
+    const Budget& getBudget(MemoryTag tag) const { return m_tags[static_cast<int>(tag)].budget; }
+
+    //! Set shed function of given tag
+    void setShedFunction(MemoryTag tag, ShedFunction shedFunction) { m_tags[static_cast<int>(tag)].shedFunction = std::move(shedFunction); }
+
+    //! Set metrics registry for memory gauges. Pass null to stop publishing.
+    void setMetrics(MetricsRegistry* metrics);
+
+    //! Check budgets, apply policies and publish gauges. Call periodically, e.g. once per frame.
+    void update(int64_t nowNs);
+
+    //! Returns true if tag was over budget at last update
+    bool isOverBudget(MemoryTag tag) const { return m_tags[static_cast<int>(tag)].over; }
+
+    //! Returns statistics
+    Stats getStats() const { return m_stats; }
+
+private:
+    //! Budget state of one tag
+    struct TagState {
+        Budget budget;                                                   //!< Configured budget
+        ShedFunction shedFunction;                                       //!< Shed function
+        bool over = false;                                               //!< Over budget at last update
+        int64_t lastShedNs = 0;                                          //!< Time of last shed call
+        MetricsRegistry::Id bytesMetric = MetricsRegistry::c_invalidId;  //!< Allocated bytes gauge
+    };
+
+    std::array<TagState, MemoryAccounting::c_tagCount> m_tags;  //!< Per tag state
+    Stats m_stats;                                              //!< Statistics
+
+    MetricsRegistry* m_metrics = nullptr;                                 //!< Metrics registry, null if not published
+    MetricsRegistry::Id m_totalMetric = MetricsRegistry::c_invalidId;     //!< Total tagged bytes gauge
+    MetricsRegistry::Id m_warningsMetric = MetricsRegistry::c_invalidId;  //!< Budget warnings counter
+    MetricsRegistry::Id m_shedsMetric = MetricsRegistry::c_invalidId;     //!< Shed calls counter
+};
+
+}  // namespace VarjoExamples
@@ -0,0 +1,116 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "MetricsRegistry.hpp"
+
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+
+using namespace VarjoExamples;
+
+// Bucket bounds from 50 us to 250 ms cover per frame phases as well as stream latencies
+const int64_t MetricsRegistry::c_bucketBoundsNs[MetricsRegistry::c_histogramBuckets] = {
+    50000, 100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 25000000, 50000000, 100000000, 250000000};
+
+MetricsRegistry::Id MetricsRegistry::addMetric(const char* name, Kind kind)
+{
+    std::lock_guard<std::mutex> lock(m_addMutex);
+
+    const int count = m_count.load(std::memory_order_relaxed);
+    for (int i = 0; i < count; i++) {
+        if (strncmp(m_names[i].data(), name, c_maxNameLength - 1) == 0) {
+            return i;
+        }
+    }
+
+    if (count >= c_maxMetrics) {
+        LOGE("Metrics registry full, ignoring metric: %s", name);
+        return c_invalidId;
+    }
+
+    strncpy(m_names[count].data(), name, c_maxNameLength - 1);
+    m_kinds[count] = kind;
+
+    // Publish name and kind to readers
+    m_count.store(count + 1, std::memory_order_release);
+    return count;
+}
+
+//---------------------------------------------------------------------------
+
+MetricsHistory::MetricsHistory(const MetricsRegistry& registry, double seconds, double intervalMs)
+    : m_registry(registry)
+    , m_length(std::max(2, static_cast<int>(std::ceil(seconds * 1000.0 / intervalMs))))
+    , m_intervalNs(static_cast<int64_t>(intervalMs * 1e6))
+    , m_samples(static_cast<size_t>(MetricsRegistry::c_maxMetrics) * m_length, 0.0f)
+{
+}
+
+bool MetricsHistory::update(int64_t nowNs)
+{
+    // First call only sets baseline values. Metrics registered later get their baseline when first seen.
+    const bool first = (m_prevNs == 0);
+    if (!first && nowNs - m_prevNs < m_intervalNs) {
+        return false;
+    }
+
+    const double seconds = (nowNs - m_prevNs) * 1e-9;
+    const int count = m_registry.getCount();
+    for (int i = 0; i < count; i++) {
+        const MetricsRegistry::Value value = m_registry.read(i);
+        const MetricsRegistry::Value& prev = m_prev[i];
+
+        float sample = 0.0f;
+        switch (m_registry.getKind(i)) {
+            case MetricsRegistry::Kind::Counter: {
+                sample = static_cast<float>((value.value - prev.value) / seconds);
+            } break;
+            case MetricsRegistry::Kind::Gauge: {
+                sample = static_cast<float>(value.value);
+            } break;
+            case MetricsRegistry::Kind::Timer: {
+                const int64_t measurements = value.count - prev.count;
+                sample = measurements > 0 ? static_cast<float>((value.value - prev.value) * 1e-6 / measurements) : 0.0f;
+            } break;
+        }
+
+        m_prev[i] = value;
+        if (!first) {
+            if (i >= m_prevCount) {
+                sample = 0.0f;
+            }
+            m_samples[static_cast<size_t>(i) * m_length + m_next] = sample;
+        }
+    }
+
+    m_prevCount = count;
+    m_prevNs = nowNs;
+    if (first) {
+        return false;
+    }
+
+    if (++m_next == m_length) {
+        m_next = 0;
+        m_filled = true;
+    }
+    return true;
+}
+
+float MetricsHistory::getLatest(MetricsRegistry::Id id) const
+{
+    if (getSampleCount() == 0) {
+        return 0.0f;
+    }
+    return getSamples(id)[(m_next + m_length - 1) % m_length];
+}
+
+float MetricsHistory::getMax(MetricsRegistry::Id id) const
+{
+    const float* samples = getSamples(id);
+    const int count = getSampleCount();
+    float result = 0.0f;
+    for (int i = 0; i < count; i++) {
+        result = std::max(result, samples[i]);
+    }
+    return result;
+}
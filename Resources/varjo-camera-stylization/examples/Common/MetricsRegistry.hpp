@@ -0,0 +1,239 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+#include "Globals.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Metrics registry is written from hot paths on any thread and read by the UI thread.
+// Updates are single relaxed atomic operations on preallocated slots, so they never lock or
+// allocate. Metrics are registered up front, which is the only locking operation. Each slot is
+// padded to a cache line so that metrics updated from different threads do not share lines.
+//
+// Timers also count measurements in fixed histogram buckets, so that latency distributions can be
+// exported without storing samples.
+//
+// Readers get values that may be a few updates behind, and sum, count and buckets of a timer are not
+// read atomically together. That is fine for monitoring, but do not use metrics for program logic.
+
+//! Lock-free registry of counters, gauges and timers for runtime monitoring
+class MetricsRegistry
+{
+public:
+    //! Maximum number of metrics
+    static constexpr int c_maxMetrics = 64;
+
+    //! Maximum metric name length including terminator
+    static constexpr int c_maxNameLength = 48;
+
+    //! Metric identifier. Updates with invalid id are ignored.
+    using Id = int;
+
+    //! Invalid metric identifier
+    static constexpr Id c_invalidId = -1;
+
+    //! Number of finite timer histogram buckets. Measurements above the last bound are only in the count.
+    static constexpr int c_histogramBuckets = 12;
+
+    //! Metric kind
+    enum class Kind {
+        Counter = 0,  //!< Monotonic event count
+        Gauge,        //!< Current level, like queue depth
+        Timer,        //!< Sum and count of measured durations
+    };
+
+    //! Metric value at read time
+    struct Value {
+        int64_t value = 0;  //!< Count, level or duration sum in nanoseconds
+        int64_t count = 0;  //!< Number of timer measurements
+    };
+
+    //! Scope guard for measuring duration to timer
+    class ScopedTimer
+    {
+    public:
+        //! Begin measurement
+        ScopedTimer(MetricsRegistry& registry, Id id)
+            : ScopedTimer(&registry, id)
+        {
+        }
+
+        //! Begin measurement. Does nothing if registry is null.
+        ScopedTimer(MetricsRegistry* registry, Id id)
+            : m_registry(registry)
+            , m_id(id)
+            , m_beginNs(registry ? getTimestampNs() : 0)
+        {
+        }
+
+        //! End measurement
+        ~ScopedTimer()
+        {
+            if (m_registry) {
+                m_registry->recordTime(m_id, getTimestampNs() - m_beginNs);
+            }
+        }
+
+        // Disable copy, move and assign
+        ScopedTimer(const ScopedTimer& other) = delete;
+        ScopedTimer(const ScopedTimer&& other) = delete;
+        ScopedTimer& operator=(const ScopedTimer& other) = delete;
+        ScopedTimer& operator=(const ScopedTimer&& other) = delete;
+
+    private:
+        MetricsRegistry* m_registry;  //!< Registry
+        Id m_id;                      //!< Measured timer
+        int64_t m_beginNs;            //!< Measurement begin time
+    };
+
+    //! Constructor
+    MetricsRegistry() = default;
+
+    // Disable copy, move and assign
+    MetricsRegistry(const MetricsRegistry& other) = delete;
+    MetricsRegistry(const MetricsRegistry&& other) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry& other) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&& other) = delete;
+
+    //! Register metric. Returns existing id if name is already registered, or invalid id if registry is full.
+    Id addMetric(const char* name, Kind kind);
+
+    //! Returns number of registered metrics
+    int getCount() const { return m_count.load(std::memory_order_acquire); }
+
+    //! Returns metric name
+    const char* getName(Id id) const { return m_names[id].data(); }
+
+    //! Returns metric kind
+    Kind getKind(Id id) const { return m_kinds[id]; }
+
+    //! Add to counter or gauge
+    void increment(Id id, int64_t delta = 1)
+    {
+        if (id >= 0) {
+            m_slots[id].value.fetch_add(delta, std::memory_order_relaxed);
+        }
+    }
+
+    //! Set counter total or gauge level
+    void set(Id id, int64_t value)
+    {
+        if (id >= 0) {
+            m_slots[id].value.store(value, std::memory_order_relaxed);
+        }
+    }
+
+    //! Add timer measurement
+    void recordTime(Id id, int64_t durationNs)
+    {
+        if (id >= 0) {
+            Slot& slot = m_slots[id];
+            slot.value.fetch_add(durationNs, std::memory_order_relaxed);
+            slot.count.fetch_add(1, std::memory_order_relaxed);
+            for (int i = 0; i < c_histogramBuckets; i++) {
+                if (durationNs <= c_bucketBoundsNs[i]) {
+                    slot.buckets[i].fetch_add(1, std::memory_order_relaxed);
+                    break;
+                }
+            }
+        }
+    }
+
+    //! Read current metric value
+    Value read(Id id) const
+    {
+        Value v;
+        v.value = m_slots[id].value.load(std::memory_order_relaxed);
+        v.count = m_slots[id].count.load(std::memory_order_relaxed);
+        return v;
+    }
+
+    //! Read timer histogram. Bucket i counts measurements in (bound i-1, bound i], not cumulatively.
+    void readBuckets(Id id, std::array<int64_t, c_histogramBuckets>& outBuckets) const
+    {
+        for (int i = 0; i < c_histogramBuckets; i++) {
+            outBuckets[i] = m_slots[id].buckets[i].load(std::memory_order_relaxed);
+        }
+    }
+
+    //! Returns upper bound of timer histogram bucket in nanoseconds
+    static int64_t getBucketBoundNs(int bucket) { return c_bucketBoundsNs[bucket]; }
+
+private:
+    //! Metric slot padded to cache lines
+    struct Slot {
+        std::atomic<int64_t> value{0};                                                //!< Count, level or duration sum
+        std::atomic<int64_t> count{0};                                                //!< Timer measurements
+        std::array<std::atomic<int64_t>, c_histogramBuckets> buckets{};               //!< Timer histogram buckets
+        char padding[128 - (2 + c_histogramBuckets) * sizeof(std::atomic<int64_t>)];  //!< Padding to cache lines
+    };
+
+    //! Timer histogram bucket upper bounds
+    static const int64_t c_bucketBoundsNs[c_histogramBuckets];
+
+    std::array<Slot, c_maxMetrics> m_slots;                                 //!< Metric values
+    std::array<std::array<char, c_maxNameLength>, c_maxMetrics> m_names{};  //!< Metric names
+    std::array<Kind, c_maxMetrics> m_kinds{};                               //!< Metric kinds
+    std::atomic<int> m_count{0};                                            //!< Registered metrics, published after name and kind
+    std::mutex m_addMutex;                                                  //!< Registration mutex
+};
+
+//! Rolling history of registry metrics sampled at fixed interval, for plotting. Not thread safe, use
+//! from one reader thread.
+class MetricsHistory
+{
+public:
+    //! Construct history covering given number of seconds. Storage for all metrics is allocated here.
+    MetricsHistory(const MetricsRegistry& registry, double seconds, double intervalMs);
+
+    // Disable copy, move and assign
+    MetricsHistory(const MetricsHistory& other) = delete;
+    MetricsHistory(const MetricsHistory&& other) = delete;
+    MetricsHistory& operator=(const MetricsHistory& other) = delete;
+    MetricsHistory& operator=(const MetricsHistory&& other) = delete;
+
+    //! Take sample if interval has elapsed since previous one. Returns true if sampled.
+    bool update(int64_t nowNs);
+
+    //! Returns number of samples in ring. Oldest sample is at getOffset().
+    int getLength() const { return m_length; }
+
+    //! Returns ring index of oldest sample
+    int getOffset() const { return m_filled ? m_next : 0; }
+
+    //! Returns number of valid samples
+    int getSampleCount() const { return m_filled ? m_length : m_next; }
+
+    //! Returns sample ring of metric. Counters are rates per second, gauges are levels and timers
+    //! are mean milliseconds per measurement over each interval.
+    const float* getSamples(MetricsRegistry::Id id) const { return &m_samples[static_cast<size_t>(id) * m_length]; }
+
+    //! Returns latest sample of metric
+    float getLatest(MetricsRegistry::Id id) const;
+
+    //! Returns maximum sample of metric in history
+    float getMax(MetricsRegistry::Id id) const;
+
+    //! Returns registry
+    const MetricsRegistry& getRegistry() const { return m_registry; }
+
+private:
+    const MetricsRegistry& m_registry;                                           //!< Sampled registry
+    const int m_length;                                                          //!< Samples in ring
+    const int64_t m_intervalNs;                                                  //!< Sampling interval
+    std::vector<float> m_samples;                                                //!< Sample rings of all metrics
+    std::array<MetricsRegistry::Value, MetricsRegistry::c_maxMetrics> m_prev{};  //!< Values at previous sample
+    int m_prevCount = 0;                                                         //!< Metrics with baseline values
+    int64_t m_prevNs = 0;                                                        //!< Previous sample time
+    int m_next = 0;                                                              //!< Next ring index
+    bool m_filled = false;                                                       //!< Ring wrapped flag
+};
+
+}  // namespace VarjoExamples
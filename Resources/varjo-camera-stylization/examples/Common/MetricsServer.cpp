@@ -0,0 +1,337 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+// Winsock headers must be included before windows.h
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include "MetricsServer.hpp"
+#include "MemoryAccounting.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+
+using namespace VarjoExamples;
+
+namespace
+{
+// Select timeout for network thread
+constexpr long c_networkPollUs = 100000;
+
+// Time client has for sending its request
+constexpr long c_requestTimeoutUs = 1000000;
+
+// Time client has for closing its end after response
+constexpr long c_closeTimeoutUs = 100000;
+
+// Maximum request size
+constexpr size_t c_maxRequestSize = 8192;
+
+// Initial response buffer size
+constexpr size_t c_responseReserve = 64 * 1024;
+
+// Content type of Prometheus text exposition format
+const char* c_contentType = "text/plain; version=0.0.4; charset=utf-8";
+
+// Send whole buffer to TCP socket
+bool sendAll(SOCKET socket, const char* data, size_t size)
+{
+    while (size > 0) {
+        const int sent = send(socket, data, static_cast<int>(size), 0);
+        if (sent == SOCKET_ERROR) {
+            return false;
+        }
+        data += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+// Wait until socket is readable. Returns false on timeout.
+bool waitReadable(SOCKET socket, long timeoutUs)
+{
+    fd_set readSet;
+    FD_ZERO(&readSet);
+    FD_SET(socket, &readSet);
+    timeval timeout{0, timeoutUs};
+    return select(0, &readSet, nullptr, nullptr, &timeout) > 0;
+}
+
+// Append formatted text
+template <typename... Args>
+void appendf(std::string& out, const char* fmt, Args... args)
+{
+    char buf[256];
+    const int n = snprintf(buf, sizeof(buf), fmt, args...);
+    out.append(buf, static_cast<size_t>(std::max(0, std::min(n, static_cast<int>(sizeof(buf)) - 1))));
+}
+
+// Convert registry name to metric name: lower case alphanumerics, other runs replaced with underscore
+std::string toMetricName(const std::string& prefix, const char* name)
+{
+    std::string result = prefix;
+    bool separator = !result.empty();
+    for (const char* c = name; *c; c++) {
+        if (isalnum(static_cast<unsigned char>(*c))) {
+            if (separator) {
+                result += '_';
+                separator = false;
+            }
+            result += static_cast<char>(tolower(static_cast<unsigned char>(*c)));
+        } else {
+            separator = !result.empty();
+        }
+    }
+    return result;
+}
+
+// Returns CPU time of all process threads in seconds
+double getProcessCpuSeconds()
+{
+    return getProcessCpuTimeNs() * 1e-9;
+}
+
+}  // namespace
+
+MetricsServer::MetricsServer(const MetricsRegistry& registry, const Config& config)
+    : m_registry(registry)
+    , m_config(config)
+{
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        LOGE("Initializing Winsock failed.");
+        return;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(m_config.port);
+    if (inet_pton(AF_INET, m_config.bindAddress.c_str(), &addr.sin_addr) != 1) {
+        LOGE("Invalid metrics bind address: %s", m_config.bindAddress.c_str());
+        return;
+    }
+
+    SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s == INVALID_SOCKET) {
+        LOGE("Creating metrics socket failed: %d", WSAGetLastError());
+        return;
+    }
+    m_socket = s;
+
+    if (bind(s, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == SOCKET_ERROR) {
+        LOGE("Binding metrics socket failed: %s:%d (error %d)", m_config.bindAddress.c_str(), m_config.port, WSAGetLastError());
+        return;
+    }
+
+    if (listen(s, SOMAXCONN) == SOCKET_ERROR) {
+        LOGE("Listening metrics socket failed: %d", WSAGetLastError());
+        return;
+    }
+
+    m_request.reserve(c_maxRequestSize);
+    m_response.reserve(c_responseReserve);
+    m_running = true;
+    m_networkThread = std::thread(&MetricsServer::networkMain, this);
+
+    LOGI("Metrics server running: http://%s:%d/metrics", m_config.bindAddress.c_str(), m_config.port);
+}
+
+MetricsServer::~MetricsServer()
+{
+    m_running = false;
+    if (m_networkThread.joinable()) {
+        m_networkThread.join();
+    }
+
+    if (m_socket != INVALID_SOCKET) {
+        closesocket(m_socket);
+        m_socket = INVALID_SOCKET;
+    }
+
+    WSACleanup();
+}
+
+MetricsServer::Stats MetricsServer::getStats() const
+{
+    Stats stats;
+    stats.scrapes = m_scrapes.load(std::memory_order_relaxed);
+    stats.rejected = m_rejected.load(std::memory_order_relaxed);
+    stats.bytesSent = m_bytesSent.load(std::memory_order_relaxed);
+    stats.scrapeTimeAvgMs = stats.scrapes > 0 ? m_scrapeTimeNs.load(std::memory_order_relaxed) * 1e-6 / stats.scrapes : 0.0;
+    stats.scrapeTimeMaxMs = m_scrapeTimeMaxNs.load(std::memory_order_relaxed) * 1e-6;
+    return stats;
+}
+
+void MetricsServer::networkMain()
+{
+    while (m_running) {
+        if (!waitReadable(m_socket, c_networkPollUs)) {
+            continue;
+        }
+
+        sockaddr_in addr{};
+        int addrSize = sizeof(addr);
+        SOCKET s = accept(m_socket, reinterpret_cast<sockaddr*>(&addr), &addrSize);
+        if (s != INVALID_SOCKET) {
+            serveClient(s);
+            closesocket(s);
+        }
+    }
+}
+
+void MetricsServer::serveClient(uintptr_t socket)
+{
+    // Read request headers. Body is never needed.
+    m_request.clear();
+    char buf[1024];
+    while (m_request.find("\r\n\r\n") == std::string::npos) {
+        if (m_request.size() >= c_maxRequestSize || !waitReadable(socket, c_requestTimeoutUs)) {
+            m_rejected++;
+            return;
+        }
+        const int received = recv(socket, buf, sizeof(buf), 0);
+        if (received <= 0) {
+            m_rejected++;
+            return;
+        }
+        m_request.append(buf, received);
+    }
+
+    const int64_t begin = getTimestampNs();
+
+    // Request line: method, target and version
+    const size_t methodEnd = m_request.find(' ');
+    const size_t targetEnd = (methodEnd == std::string::npos) ? std::string::npos : m_request.find(' ', methodEnd + 1);
+    const std::string method = m_request.substr(0, methodEnd);
+    const std::string target = (targetEnd == std::string::npos) ? std::string() : m_request.substr(methodEnd + 1, targetEnd - methodEnd - 1);
+    const std::string path = target.substr(0, target.find('?'));
+
+    const char* status = "200 OK";
+    m_response.clear();
+    if (method != "GET" && method != "HEAD") {
+        status = "405 Method Not Allowed";
+    } else if (path != "/metrics") {
+        status = "404 Not Found";
+    } else {
+        format(m_registry, m_config.prefix, m_response);
+    }
+
+    const bool ok = (m_response.size() > 0);
+    std::string header;
+    appendf(header, "HTTP/1.1 %s\r\nContent-Type: %s\r\nContent-Length: %zu\r\nConnection: close\r\n\r\n", status, ok ? c_contentType : "text/plain",
+        m_response.size());
+
+    bool sent = sendAll(socket, header.data(), header.size());
+    if (sent && method == "GET") {
+        sent = sendAll(socket, m_response.data(), m_response.size());
+    }
+
+    // Give client time to close first so that closed connections do not keep server port in TIME_WAIT
+    while (sent && waitReadable(socket, c_closeTimeoutUs) && recv(socket, buf, sizeof(buf), 0) > 0) {
+    }
+    shutdown(socket, SD_BOTH);
+
+    if (!ok || !sent) {
+        m_rejected++;
+        return;
+    }
+
+    const int64_t timeNs = getTimestampNs() - begin;
+    m_scrapes++;
+    m_bytesSent += static_cast<int64_t>(header.size() + m_response.size());
+    m_scrapeTimeNs += timeNs;
+    m_scrapeTimeMaxNs = std::max(m_scrapeTimeMaxNs.load(), timeNs);
+}
+
+void MetricsServer::format(const MetricsRegistry& registry, const std::string& prefix, std::string& outText)
+{
+    std::array<int64_t, MetricsRegistry::c_histogramBuckets> buckets;
+
+    for (int i = 0; i < registry.getCount(); i++) {
+        std::string name = toMetricName(prefix, registry.getName(i));
+
+        switch (registry.getKind(i)) {
+            case MetricsRegistry::Kind::Counter: {
+                name += "_total";
+                appendf(outText, "# HELP %s %s\n# TYPE %s counter\n", name.c_str(), registry.getName(i), name.c_str());
+                appendf(outText, "%s %lld\n", name.c_str(), static_cast<long long>(registry.read(i).value));
+            } break;
+            case MetricsRegistry::Kind::Gauge: {
+                appendf(outText, "# HELP %s %s\n# TYPE %s gauge\n", name.c_str(), registry.getName(i), name.c_str());
+                appendf(outText, "%s %lld\n", name.c_str(), static_cast<long long>(registry.read(i).value));
+            } break;
+            case MetricsRegistry::Kind::Timer: {
+                name += "_seconds";
+                appendf(outText, "# HELP %s %s\n# TYPE %s histogram\n", name.c_str(), registry.getName(i), name.c_str());
+
+                // Buckets are read before totals, and counts are kept consistent for readers
+                registry.readBuckets(i, buckets);
+                const MetricsRegistry::Value value = registry.read(i);
+                int64_t cumulative = 0;
+                for (int b = 0; b < MetricsRegistry::c_histogramBuckets; b++) {
+                    cumulative += buckets[b];
+                    appendf(outText, "%s_bucket{le=\"%g\"} %lld\n", name.c_str(), MetricsRegistry::getBucketBoundNs(b) * 1e-9, static_cast<long long>(cumulative));
+                }
+                const long long count = static_cast<long long>(std::max(cumulative, value.count));
+                appendf(outText, "%s_bucket{le=\"+Inf\"} %lld\n", name.c_str(), count);
+                appendf(outText, "%s_sum %.9g\n", name.c_str(), value.value * 1e-9);
+                appendf(outText, "%s_count %lld\n", name.c_str(), count);
+            } break;
+        }
+    }
+
+    appendf(outText, "# HELP process_cpu_seconds_total Total user and system CPU time spent in seconds.\n# TYPE process_cpu_seconds_total counter\n");
+    appendf(outText, "process_cpu_seconds_total %.3f\n", getProcessCpuSeconds());
+    appendf(outText, "# HELP process_resident_memory_bytes Resident memory size in bytes.\n# TYPE process_resident_memory_bytes gauge\n");
+    appendf(outText, "process_resident_memory_bytes %lld\n", static_cast<long long>(MemoryAccounting::getProcessResidentBytes()));
+}
+
+bool MetricsServer::fetch(const std::string& address, uint16_t port, const std::string& path, int& outStatus, std::string& outBody)
+{
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        return false;
+    }
+
+    bool ok = false;
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    SOCKET s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (s != INVALID_SOCKET && inet_pton(AF_INET, address.c_str(), &addr.sin_addr) == 1 &&
+        connect(s, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != SOCKET_ERROR) {
+        const std::string request = "GET " + path + " HTTP/1.1\r\nHost: " + address + "\r\nConnection: close\r\n\r\n";
+        if (sendAll(s, request.data(), request.size())) {
+            // Read until content length is received, then close before server does
+            std::string response;
+            char buf[16384];
+            size_t headerEnd = std::string::npos;
+            size_t contentLength = 0;
+            while (headerEnd == std::string::npos || response.size() < headerEnd + 4 + contentLength) {
+                const int received = waitReadable(s, c_requestTimeoutUs) ? recv(s, buf, sizeof(buf), 0) : 0;
+                if (received <= 0) {
+                    break;
+                }
+                response.append(buf, received);
+                if (headerEnd == std::string::npos && (headerEnd = response.find("\r\n\r\n")) != std::string::npos) {
+                    const size_t field = response.find("Content-Length:");
+                    contentLength = (field < headerEnd) ? strtoul(response.c_str() + field + 15, nullptr, 10) : 0;
+                }
+            }
+
+            if (headerEnd != std::string::npos && response.size() == headerEnd + 4 + contentLength &&
+                sscanf(response.c_str(), "HTTP/1.%*d %d", &outStatus) == 1) {
+                outBody = response.substr(headerEnd + 4);
+                ok = true;
+            }
+        }
+    }
+
+    if (s != INVALID_SOCKET) {
+        closesocket(s);
+    }
+    WSACleanup();
+    return ok;
+}
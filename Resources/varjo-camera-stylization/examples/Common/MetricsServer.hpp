@@ -0,0 +1,93 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <string>
+#include <thread>
+#include <atomic>
+
+#include "Globals.hpp"
+#include "MetricsRegistry.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Metrics server answers HTTP scrapes in Prometheus text exposition format from its own
+// thread. It only reads registry atomics, so scraping never locks or waits on the frame thread
+// or stream threads that update the registry. Requests are served one at a time and connections
+// are closed after each response, which is all a scraper needs.
+//
+// Registry names are converted to metric names by lower casing them and replacing other characters
+// with underscores: counters get a _total suffix and timers are exported as histograms in seconds.
+// Process CPU time and resident memory are added as the standard process metrics.
+
+//! Local HTTP endpoint exporting metrics registry for Prometheus style scrapers
+class MetricsServer
+{
+public:
+    //! Default port
+    static constexpr uint16_t c_defaultPort = 9464;
+
+    //! Server configuration
+    struct Config {
+        std::string bindAddress = "127.0.0.1";  //!< Local address to bind, keep on loopback unless exposed on purpose
+        uint16_t port = c_defaultPort;          //!< Local port to bind
+        std::string prefix = "varjo";           //!< Prefix of exported metric names
+    };
+
+    //! Server statistics
+    struct Stats {
+        int64_t scrapes = 0;            //!< Served metrics requests
+        int64_t rejected = 0;           //!< Invalid or unknown requests
+        int64_t bytesSent = 0;          //!< Response bytes sent
+        double scrapeTimeAvgMs = 0.0;   //!< Average time to format and send metrics
+        double scrapeTimeMaxMs = 0.0;   //!< Maximum time to format and send metrics
+    };
+
+    //! Construct and start server
+    MetricsServer(const MetricsRegistry& registry, const Config& config);
+
+    //! Destruct server. Waits for request in progress.
+    ~MetricsServer();
+
+    // Disable copy, move and assign
+    MetricsServer(const MetricsServer& other) = delete;
+    MetricsServer(const MetricsServer&& other) = delete;
+    MetricsServer& operator=(const MetricsServer& other) = delete;
+    MetricsServer& operator=(const MetricsServer&& other) = delete;
+
+    //! Returns true if server socket is up
+    bool isRunning() const { return m_running; }
+
+    //! Returns server statistics
+    Stats getStats() const;
+
+    //! Format registry in Prometheus text exposition format, appending to given string
+    static void format(const MetricsRegistry& registry, const std::string& prefix, std::string& outText);
+
+    //! Fetch path from HTTP server, for testing endpoints. Returns false if request failed.
+    static bool fetch(const std::string& address, uint16_t port, const std::string& path, int& outStatus, std::string& outBody);
+
+private:
+    //! Network thread accepting and serving requests
+    void networkMain();
+
+    //! Read request from client and send response
+    void serveClient(uintptr_t socket);
+
+private:
+    const MetricsRegistry& m_registry;   //!< Exported registry
+    const Config m_config;               //!< Server configuration
+    uintptr_t m_socket = ~uintptr_t(0);  //!< Listen socket
+    std::atomic<bool> m_running{false};  //!< Running flag
+    std::thread m_networkThread;         //!< Network thread
+    std::string m_request;               //!< Request buffer
+    std::string m_response;              //!< Response buffer
+
+    std::atomic<int64_t> m_scrapes{0};          //!< Served metrics requests
+    std::atomic<int64_t> m_rejected{0};         //!< Invalid or unknown requests
+    std::atomic<int64_t> m_bytesSent{0};        //!< Response bytes sent
+    std::atomic<int64_t> m_scrapeTimeNs{0};     //!< Total scrape time
+    std::atomic<int64_t> m_scrapeTimeMaxNs{0};  //!< Maximum scrape time
+};
+
+}  // namespace VarjoExamples
@@ -0,0 +1,38 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "NullLayerView.hpp"
+#include "StandInRuntime.hpp"
+
+namespace VarjoExamples
+{
+NullLayerView::NullLayerView(varjo_Session* session, NullRenderer& renderer)
+    : LayerView(session, renderer)
+{
+    // Create color swap chain without textures
+    varjo_SwapChainConfig2 colorConfig;
+    colorConfig.numberOfTextures = 4;
+    colorConfig.textureArraySize = 1;
+    colorConfig.textureFormat = varjo_TextureFormat_R8G8B8A8_SRGB;
+    colorConfig.textureWidth = getTotalWidth(m_fullViewports);
+    colorConfig.textureHeight = getTotalHeight(m_fullViewports);
+
+    m_colorSwapChain = StandInRuntime::createSwapChain(getSession(), colorConfig);
+    CHECK_VARJO_ERR(getSession());
+
+    // Create depth swap chain without textures
+    varjo_SwapChainConfig2 depthConfig{colorConfig};
+    depthConfig.textureFormat = varjo_DepthTextureFormat_D32_FLOAT;
+
+    m_depthSwapChain = StandInRuntime::createSwapChain(getSession(), depthConfig);
+    CHECK_VARJO_ERR(getSession());
+
+    // Create a null render target for each swap chain image
+    for (int i = 0; i < colorConfig.numberOfTextures; ++i) {
+        m_renderTargets.emplace_back(std::make_unique<NullRenderer::RenderTarget>(colorConfig.textureWidth, colorConfig.textureHeight));
+    }
+
+    // Setup views
+    setupViews();
+}
+
+}  // namespace VarjoExamples
@@ -0,0 +1,19 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include "Globals.hpp"
+#include "LayerView.hpp"
+#include "NullRenderer.hpp"
+
+namespace VarjoExamples
+{
+//! Layer view implementation for null renderer. Requires stand-in runtime for swap chains.
+class NullLayerView final : public LayerView
+{
+public:
+    //! Constructor
+    NullLayerView(varjo_Session* session, NullRenderer& renderer);
+};
+
+}  // namespace VarjoExamples
@@ -0,0 +1,46 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "NullRenderer.hpp"
+
+namespace VarjoExamples
+{
+std::unique_ptr<Renderer::Mesh> NullRenderer::createMesh(
+    const std::vector<float>& vertexData, int /*vertexStride*/, const std::vector<unsigned short>& indexData, PrimitiveTopology topology)
+{
+    return std::make_unique<NullRenderer::Mesh>(vertexData, indexData, topology);
+}
+
+std::unique_ptr<Renderer::Texture> NullRenderer::loadTextureFromMemory(const uint8_t* /*memory*/, size_t /*size*/)
+{
+    // Size is not decoded, textures have no contents
+    auto texture = std::make_unique<NullRenderer::Texture>();
+    texture->init(1, 1);
+    return texture;
+}
+
+std::unique_ptr<Renderer::Texture> NullRenderer::createHdrCubemap(int32_t resolution, varjo_TextureFormat /*format*/)
+{
+    auto texture = std::make_unique<NullRenderer::Texture>();
+    texture->init(resolution, resolution, TextureType::Cubemap);
+    return texture;
+}
+
+void NullRenderer::renderMesh(Renderer::Mesh& mesh, const void* vsConstants, size_t vsConstantsSize, const void* psConstants, size_t psConstantsSize)
+{
+    m_stats.meshes++;
+    m_stats.indices += static_cast<int64_t>(static_cast<NullRenderer::Mesh&>(mesh).getIndexCount());
+    m_stats.constantBytes += static_cast<int64_t>(vsConstantsSize + psConstantsSize);
+
+    // Touch first word of each constant block like a driver copy would
+    uint32_t word = 0;
+    if (vsConstantsSize >= sizeof(word)) {
+        memcpy(&word, vsConstants, sizeof(word));
+        m_constantChecksum = m_constantChecksum * 31 + word;
+    }
+    if (psConstantsSize >= sizeof(word)) {
+        memcpy(&word, psConstants, sizeof(word));
+        m_constantChecksum = m_constantChecksum * 31 + word;
+    }
+}
+
+}  // namespace VarjoExamples
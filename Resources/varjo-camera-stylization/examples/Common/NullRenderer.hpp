@@ -0,0 +1,115 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include "Globals.hpp"
+#include "Renderer.hpp"
+#include "ExampleShaders.hpp"
+
+namespace VarjoExamples
+{
+//! Renderer implementation that records calls without any graphics API. Used for measuring CPU
+//! side cost of scene traversal and layer submission in headless benchmarks.
+class NullRenderer final : public Renderer
+{
+public:
+    //! Render target implementation for null renderer
+    class RenderTarget final : public Renderer::RenderTarget
+    {
+    public:
+        //! Construct render target of given size
+        RenderTarget(int32_t width, int32_t height)
+            : Renderer::RenderTarget(width, height)
+        {
+        }
+    };
+
+    //! Shader implementation for null renderer
+    class Shader final : public Renderer::Shader
+    {
+    };
+
+    //! Texture implementation for null renderer
+    class Texture final : public Renderer::Texture
+    {
+    };
+
+    //! Mesh implementation for null renderer
+    class Mesh final : public Renderer::Mesh
+    {
+    public:
+        //! Construct mesh storing given vertex data
+        Mesh(const std::vector<float>& vertexData, const std::vector<unsigned short>& indexData, PrimitiveTopology topology)
+            : Renderer::Mesh(vertexData, indexData, topology)
+        {
+        }
+
+        //! Returns number of indices
+        size_t getIndexCount() const { return m_indices.size(); }
+    };
+
+    //! Call statistics
+    struct Stats {
+        int64_t meshes = 0;          //!< Rendered meshes
+        int64_t indices = 0;         //!< Rendered mesh indices
+        int64_t constantBytes = 0;   //!< Shader constant bytes passed
+        int64_t clears = 0;          //!< Render target clears
+        int64_t viewports = 0;       //!< Viewport changes
+        int64_t viewportPixels = 0;  //!< Pixels in set viewports
+        int64_t targetBinds = 0;     //!< Render target binds
+        int64_t shaderBinds = 0;     //!< Shader binds
+    };
+
+    //! Constructor
+    NullRenderer() = default;
+
+    // Disable copy, move and assign
+    NullRenderer(const NullRenderer& other) = delete;
+    NullRenderer(const NullRenderer&& other) = delete;
+    NullRenderer& operator=(const NullRenderer& other) = delete;
+    NullRenderer& operator=(const NullRenderer&& other) = delete;
+
+    //! Returns call statistics
+    const Stats& getStats() const { return m_stats; }
+
+    //! Returns checksum of passed shader constants. Keeps constant setup from being optimized away.
+    uint32_t getConstantChecksum() const { return m_constantChecksum; }
+
+    //! From Renderer
+    std::unique_ptr<Renderer::Mesh> createMesh(
+        const std::vector<float>& vertexData, int vertexStride, const std::vector<unsigned short>& indexData, PrimitiveTopology topology) override;
+    std::unique_ptr<Renderer::Texture> loadTextureFromMemory(const uint8_t* memory, size_t size) override;
+    std::unique_ptr<Renderer::Texture> createHdrCubemap(int32_t resolution, varjo_TextureFormat format) override;
+    void updateTexture(Renderer::Texture* /*texture*/, const uint8_t* /*data*/, size_t /*rowPitch*/) override {}
+    void renderMesh(Renderer::Mesh& mesh, const void* vsConstants, size_t vsConstantsSize, const void* psConstants, size_t psConstantsSize) override;
+    void setDepthEnabled(bool /*enabled*/) override {}
+    void bindRenderTarget(Renderer::RenderTarget& /*target*/) override { m_stats.targetBinds++; }
+    void unbindRenderTarget() override {}
+    void bindShader(Renderer::Shader& /*shader*/) override { m_stats.shaderBinds++; }
+    void bindTextures(const std::vector<Renderer::Texture*> /*textures*/) override {}
+    void setViewport(int32_t /*x*/, int32_t /*y*/, int32_t width, int32_t height) override
+    {
+        m_stats.viewports++;
+        m_stats.viewportPixels += static_cast<int64_t>(width) * height;
+    }
+    void clear(Renderer::RenderTarget& /*target*/, const glm::vec4& /*colorValue*/, bool /*clearColor*/, bool /*clearDepth*/, bool /*clearStencil*/,
+        float /*depthValue*/, uint8_t /*stencilValue*/) override
+    {
+        m_stats.clears++;
+    }
+    const ExampleShaders& getShaders() const override { return m_shaders; }
+
+private:
+    //! Example shader library creating null shaders
+    class Shaders final : public ExampleShaders
+    {
+    public:
+        std::unique_ptr<Renderer::Shader> createShader(ShaderType /*type*/) const override { return std::make_unique<NullRenderer::Shader>(); }
+    };
+
+    Shaders m_shaders;                //!< Shader library
+    Stats m_stats;                    //!< Call statistics
+    uint32_t m_constantChecksum = 0;  //!< Shader constant checksum
+};
+
+}  // namespace VarjoExamples
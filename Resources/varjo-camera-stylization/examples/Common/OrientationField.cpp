@@ -0,0 +1,326 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "OrientationField.hpp"
+
+#include <cmath>
+
+#include "SimdMath.hpp"
+
+using namespace VarjoExamples;
+
+namespace
+{
+// Integral image columns per accumulation task
+constexpr int c_columnBlock = 256;
+
+// Call function with SIMD variant tag
+template <typename F>
+void dispatchSimd(SimdLevel level, F&& func)
+{
+    switch (level) {
+        case SimdLevel::AVX2: func(Simd::AVX2()); break;
+        case SimdLevel::SSE41: func(Simd::SSE41()); break;
+        default: func(Simd::Scalar()); break;
+    }
+}
+
+//---------------------------------------------------------------------------
+// Box downscale of one field row. SIMD variants have a path for the default downscale of four,
+// which sums byte pairs with maddubs and pairs of pairs with madd. All variants round the same.
+
+template <typename V>
+void downscaleRow(const uint8_t* block, size_t rowStride, int downscale, uint8_t* out, int x0, int x1);
+
+template <>
+void downscaleRow<Simd::Scalar>(const uint8_t* block, size_t rowStride, int downscale, uint8_t* out, int x0, int x1)
+{
+    const uint32_t area = downscale * downscale;
+    for (int x = x0; x < x1; x++) {
+        uint32_t sum = 0;
+        for (int dy = 0; dy < downscale; dy++) {
+            const uint8_t* p = block + dy * rowStride + x * downscale;
+            for (int dx = 0; dx < downscale; dx++) {
+                sum += p[dx];
+            }
+        }
+        out[x] = static_cast<uint8_t>((sum + area / 2) / area);
+    }
+}
+
+template <>
+void downscaleRow<Simd::SSE41>(const uint8_t* block, size_t rowStride, int downscale, uint8_t* out, int x0, int x1)
+{
+    int x = x0;
+    if (downscale == 4) {
+        const __m128i ones8 = _mm_set1_epi8(1);
+        const __m128i ones16 = _mm_set1_epi16(1);
+        const __m128i bias = _mm_set1_epi32(8);
+        for (; x + 16 <= x1; x += 16) {
+            __m128i quads[4];
+            for (int i = 0; i < 4; i++) {
+                __m128i pairs = _mm_setzero_si128();
+                for (int dy = 0; dy < 4; dy++) {
+                    const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block + dy * rowStride + 4 * x + 16 * i));
+                    pairs = _mm_add_epi16(pairs, _mm_maddubs_epi16(bytes, ones8));
+                }
+                quads[i] = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(pairs, ones16), bias), 4);
+            }
+            const __m128i packed = _mm_packus_epi16(_mm_packus_epi32(quads[0], quads[1]), _mm_packus_epi32(quads[2], quads[3]));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), packed);
+        }
+    }
+    downscaleRow<Simd::Scalar>(block, rowStride, downscale, out, x, x1);
+}
+
+template <>
+void downscaleRow<Simd::AVX2>(const uint8_t* block, size_t rowStride, int downscale, uint8_t* out, int x0, int x1)
+{
+    int x = x0;
+    if (downscale == 4) {
+        const __m256i ones8 = _mm256_set1_epi8(1);
+        const __m256i ones16 = _mm256_set1_epi16(1);
+        const __m256i bias = _mm256_set1_epi32(8);
+        // Packs work within 128-bit lanes, this restores output order of 4 pixel groups
+        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        for (; x + 32 <= x1; x += 32) {
+            __m256i quads[4];
+            for (int i = 0; i < 4; i++) {
+                __m256i pairs = _mm256_setzero_si256();
+                for (int dy = 0; dy < 4; dy++) {
+                    const __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + dy * rowStride + 4 * x + 32 * i));
+                    pairs = _mm256_add_epi16(pairs, _mm256_maddubs_epi16(bytes, ones8));
+                }
+                quads[i] = _mm256_srli_epi32(_mm256_add_epi32(_mm256_madd_epi16(pairs, ones16), bias), 4);
+            }
+            const __m256i packed = _mm256_packus_epi16(_mm256_packus_epi32(quads[0], quads[1]), _mm256_packus_epi32(quads[2], quads[3]));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), _mm256_permutevar8x32_epi32(packed, order));
+        }
+    }
+    downscaleRow<Simd::SSE41>(block, rowStride, downscale, out, x, x1);
+}
+
+//---------------------------------------------------------------------------
+// Vertical integral image pass: add previous row to current row with wrap around
+
+template <typename V>
+void accumulateRow(const uint32_t* previous, uint32_t* current, int x0, int x1);
+
+template <>
+void accumulateRow<Simd::Scalar>(const uint32_t* previous, uint32_t* current, int x0, int x1)
+{
+    for (int x = x0; x < x1; x++) {
+        current[x] += previous[x];
+    }
+}
+
+template <>
+void accumulateRow<Simd::SSE41>(const uint32_t* previous, uint32_t* current, int x0, int x1)
+{
+    int x = x0;
+    for (; x + 4 <= x1; x += 4) {
+        __m128i* p = reinterpret_cast<__m128i*>(current + x);
+        _mm_storeu_si128(p, _mm_add_epi32(_mm_loadu_si128(p), _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + x))));
+    }
+    accumulateRow<Simd::Scalar>(previous, current, x, x1);
+}
+
+template <>
+void accumulateRow<Simd::AVX2>(const uint32_t* previous, uint32_t* current, int x0, int x1)
+{
+    int x = x0;
+    for (; x + 8 <= x1; x += 8) {
+        __m256i* p = reinterpret_cast<__m256i*>(current + x);
+        _mm256_storeu_si256(p, _mm256_add_epi32(_mm256_loadu_si256(p), _mm256_loadu_si256(reinterpret_cast<const __m256i*>(previous + x))));
+    }
+    accumulateRow<Simd::SSE41>(previous, current, x, x1);
+}
+
+//---------------------------------------------------------------------------
+// Decomposition of smoothed tensor [xx xy; xy yy] in place: xx becomes tangent x, yy tangent y
+// and xy coherence. Eigenvector of the larger eigenvalue is the gradient direction at half the
+// angle of (xx - yy, 2 xy), which is found with half-angle formulas instead of trigonometry.
+
+template <typename V>
+void decomposeRow(float* xxToTangentX, float* yyToTangentY, float* xyToCoherence, int x0, int x1, float minEnergy)
+{
+    using F = typename V::Float;
+    const F zero = V::zero();
+    const F half = V::set1(0.5f);
+    const F one = V::set1(1.0f);
+    const F two = V::set1(2.0f);
+    const F energy = V::set1(minEnergy);
+    const F tiny = V::set1(1e-20f);
+
+    int x = x0;
+    for (; x + V::c_width <= x1; x += V::c_width) {
+        const F xx = V::load(xxToTangentX + x);
+        const F yy = V::load(yyToTangentY + x);
+        const F xy = V::load(xyToCoherence + x);
+
+        // Eigenvalue difference and sum
+        const F trace = V::add(xx, yy);
+        const F diff = V::sub(xx, yy);
+        const F xy2 = V::mul(two, xy);
+        const F root = V::sqrt(V::madd(diff, diff, V::mul(xy2, xy2)));
+        const auto oriented = V::maskAnd(V::cmpgt(trace, energy), V::cmpgt(root, V::mul(trace, V::set1(1e-6f))));
+
+        // Half-angle of double angle gradient direction, sine takes sign of xy
+        const F cos2 = V::div(diff, V::max(root, tiny));
+        const F cosine = V::sqrt(V::max(V::mul(half, V::add(one, cos2)), zero));
+        const F sine = V::sqrt(V::max(V::mul(half, V::sub(one, cos2)), zero));
+        const F signedSine = V::select(V::cmplt(xy, zero), V::sub(zero, sine), sine);
+
+        // Tangent is gradient rotated by 90 degrees, y is the non-negative cosine
+        const F tangentX = V::sub(zero, signedSine);
+        const F tangentY = cosine;
+        const F coherence = V::div(root, V::max(trace, tiny));
+
+        V::store(xxToTangentX + x, V::select(oriented, tangentX, one));
+        V::store(yyToTangentY + x, V::select(oriented, tangentY, zero));
+        V::store(xyToCoherence + x, V::select(oriented, coherence, zero));
+    }
+    if (V::c_width > 1) {
+        decomposeRow<Simd::Scalar>(xxToTangentX, yyToTangentY, xyToCoherence, x, x1, minEnergy);
+    }
+}
+
+}  // namespace
+
+namespace VarjoExamples
+{
+OrientationField::OrientationField(ThreadPool& threadPool, const Config& config)
+    : m_threadPool(threadPool)
+    , m_config(config)
+{
+}
+
+bool OrientationField::update(const uint8_t* luma, int width, int height, size_t rowStride, int64_t frameNumber)
+{
+    const int downscale = std::max(m_config.downscale, 1);
+    const int fieldWidth = width / downscale;
+    const int fieldHeight = height / downscale;
+    if (fieldWidth < 3 || fieldHeight < 3) {
+        return false;
+    }
+
+    const int64_t begin = getTimestampNs();
+    if (fieldWidth != m_width || fieldHeight != m_height || downscale != m_downscale) {
+        const size_t count = static_cast<size_t>(fieldWidth) * fieldHeight;
+        m_luma.resize(count);
+        m_integral.assign(static_cast<size_t>(fieldWidth + 1) * (fieldHeight + 1) * 3, 0);
+        m_tangentX.resize(count);
+        m_tangentY.resize(count);
+        m_coherence.resize(count);
+        m_width = fieldWidth;
+        m_height = fieldHeight;
+        m_downscale = downscale;
+    }
+    // Box downscale
+    dispatchSimd(m_config.simd, [&](auto simd) {
+        using V = decltype(simd);
+        m_threadPool.parallelFor(fieldHeight, [&](int y0, int y1) {
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* block = luma + static_cast<size_t>(y) * downscale * rowStride;
+                downscaleRow<V>(block, rowStride, downscale, m_luma.data() + static_cast<size_t>(y) * fieldWidth, 0, fieldWidth);
+            }
+        });
+    });
+    const int64_t downscaleEnd = getTimestampNs();
+
+    // Scharr gradient products with clamped borders, summed along rows. Products are divided by 16,
+    // which scales them to the range of Sobel products. Row and column zero of integral images stay zero.
+    const int integralStride = fieldWidth + 1;
+    const size_t planeSize = static_cast<size_t>(integralStride) * (fieldHeight + 1);
+    uint32_t* integralXX = m_integral.data();
+    uint32_t* integralXY = integralXX + planeSize;
+    uint32_t* integralYY = integralXY + planeSize;
+    m_threadPool.parallelFor(fieldHeight, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            const uint8_t* r0 = m_luma.data() + static_cast<size_t>(std::max(y - 1, 0)) * fieldWidth;
+            const uint8_t* r1 = m_luma.data() + static_cast<size_t>(y) * fieldWidth;
+            const uint8_t* r2 = m_luma.data() + static_cast<size_t>(std::min(y + 1, fieldHeight - 1)) * fieldWidth;
+            const size_t row = static_cast<size_t>(y + 1) * integralStride;
+            uint32_t sumXX = 0, sumXY = 0, sumYY = 0;
+            for (int x = 0; x < fieldWidth; x++) {
+                const int xl = std::max(x - 1, 0);
+                const int xr = std::min(x + 1, fieldWidth - 1);
+                const int gx = 3 * (r0[xr] - r0[xl] + r2[xr] - r2[xl]) + 10 * (r1[xr] - r1[xl]);
+                const int gy = 3 * (r2[xl] - r0[xl] + r2[xr] - r0[xr]) + 10 * (r2[x] - r0[x]);
+                sumXX += static_cast<uint32_t>((gx * gx + 8) >> 4);
+                sumXY += static_cast<uint32_t>((gx * gy + 8) >> 4);
+                sumYY += static_cast<uint32_t>((gy * gy + 8) >> 4);
+                integralXX[row + x + 1] = sumXX;
+                integralXY[row + x + 1] = sumXY;
+                integralYY[row + x + 1] = sumYY;
+            }
+        }
+    });
+
+    // Sum rows, column blocks in parallel
+    dispatchSimd(m_config.simd, [&](auto simd) {
+        using V = decltype(simd);
+        const int blocks = (integralStride + c_columnBlock - 1) / c_columnBlock;
+        m_threadPool.parallelFor(blocks * 3, [&](int i0, int i1) {
+            for (int i = i0; i < i1; i++) {
+                uint32_t* plane = m_integral.data() + planeSize * (i / blocks);
+                const int x0 = (i % blocks) * c_columnBlock;
+                const int x1 = std::min(x0 + c_columnBlock, integralStride);
+                for (int y = 2; y <= fieldHeight; y++) {
+                    accumulateRow<V>(plane + static_cast<size_t>(y - 1) * integralStride, plane + static_cast<size_t>(y) * integralStride, x0, x1);
+                }
+            }
+        }, 1);
+    });
+    const int64_t tensorEnd = getTimestampNs();
+
+    // Box smoothed tensor means into output planes, then decompose them in place. Boxes are clipped
+    // at field borders. Differences of wrapped sums are exact, since box sums fit in 31 bits.
+    const int radius = std::min(std::max(m_config.radius, 0), c_maxRadius);
+    dispatchSimd(m_config.simd, [&](auto simd) {
+        using V = decltype(simd);
+        m_threadPool.parallelFor(fieldHeight, [&](int y0, int y1) {
+            for (int y = y0; y < y1; y++) {
+                const size_t top = static_cast<size_t>(std::max(y - radius, 0)) * integralStride;
+                const size_t bottom = static_cast<size_t>(std::min(y + radius + 1, fieldHeight)) * integralStride;
+                const int rows = static_cast<int>((bottom - top) / integralStride);
+                const size_t row = static_cast<size_t>(y) * fieldWidth;
+                for (int x = 0; x < fieldWidth; x++) {
+                    const int left = std::max(x - radius, 0);
+                    const int right = std::min(x + radius + 1, fieldWidth);
+                    const float scale = 1.0f / static_cast<float>(rows * (right - left));
+                    const auto boxSum = [&](const uint32_t* plane) {
+                        return static_cast<int32_t>(plane[bottom + right] - plane[bottom + left] - plane[top + right] + plane[top + left]);
+                    };
+                    m_tangentX[row + x] = static_cast<float>(boxSum(integralXX)) * scale;
+                    m_coherence[row + x] = static_cast<float>(boxSum(integralXY)) * scale;
+                    m_tangentY[row + x] = static_cast<float>(boxSum(integralYY)) * scale;
+                }
+                decomposeRow<V>(m_tangentX.data() + row, m_tangentY.data() + row, m_coherence.data() + row, 0, fieldWidth, m_config.minEnergy);
+            }
+        });
+    });
+
+    const int64_t end = getTimestampNs();
+    m_frameNumber = frameNumber;
+    m_stats.frames++;
+    m_stats.downscaleTimeNs += downscaleEnd - begin;
+    m_stats.tensorTimeNs += tensorEnd - downscaleEnd;
+    m_stats.decomposeTimeNs += end - tensorEnd;
+    m_stats.lastTimeNs = end - begin;
+    m_stats.totalTimeNs += m_stats.lastTimeNs;
+    m_stats.maxTimeNs = std::max(m_stats.maxTimeNs, m_stats.lastTimeNs);
+    if (m_metrics) {
+        m_metrics->recordTime(m_updateMetric, m_stats.lastTimeNs);
+    }
+    return true;
+}
+
+void OrientationField::setMetrics(MetricsRegistry* metrics)
+{
+    m_metrics = metrics;
+    if (m_metrics) {
+        m_updateMetric = m_metrics->addMetric("Orientation: update", MetricsRegistry::Kind::Timer);
+    }
+}
+
+}  // namespace VarjoExamples
@@ -0,0 +1,143 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+
+#include "Globals.hpp"
+#include "KernelConfig.hpp"
+#include "ThreadPool.hpp"
+#include "MetricsRegistry.hpp"
+#include "MemoryAccounting.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Orientation field computes the local edge orientation of a luma plane once per frame at
+// reduced resolution, so that anisotropic effects (sketch strokes, hatching, brush directions) can
+// share it instead of each estimating orientation per output pixel. Stages, each run in parallel
+// on the thread pool:
+//
+//   1. Downscale: box average luma to field resolution, with SIMD for the default downscale of four.
+//   2. Tensor: Scharr gradient products gx * gx, gx * gy and gy * gy, summed into integral images.
+//      Scharr kernel is used instead of Sobel, because it is close to rotation invariant, which
+//      matters at field resolution where stripes are only a few pixels wide.
+//      Integral images are 32-bit and wrap around, box sums of them are still exact because they
+//      fit in 32 bits. Box smoothing cost is then independent of radius.
+//   3. Decompose: eigen-decomposition of the box smoothed 2x2 structure tensor with SIMD, which
+//      gives edge tangent direction and coherence (lambda1 - lambda2) / (lambda1 + lambda2).
+//
+// Tangent is the direction of least luma change, along edges and stripes. Orientation is modulo
+// 180 degrees: tangent is returned with non-negative y. Coherence is one for straight edges and
+// zero for isotropic or flat areas. Flat areas get tangent (1, 0).
+//
+// Field is read only between updates. Effects take it as a const reference and sample it from any
+// thread, as long as the next update does not run at the same time.
+
+//! Structure tensor orientation field of luma plane
+class OrientationField
+{
+public:
+    //! Field configuration
+    struct Config {
+        int downscale = 4;                   //!< Source pixels per field pixel in both directions
+        int radius = 3;                      //!< Box smoothing radius in field pixels, up to 15
+        float minEnergy = 64.0f;             //!< Smallest mean gradient product trace of an oriented pixel, 64 for one luma level per field pixel
+        SimdLevel simd = getMaxSimdLevel();  //!< SIMD variant
+    };
+
+    //! Orientation at one field pixel
+    struct Sample {
+        glm::vec2 tangent{1.0f, 0.0f};  //!< Unit edge tangent, y non-negative
+        float coherence = 0.0f;         //!< Anisotropy in [0, 1]
+    };
+
+    //! Field statistics
+    struct Stats {
+        int64_t frames = 0;           //!< Updates
+        int64_t downscaleTimeNs = 0;  //!< Total downscale time
+        int64_t tensorTimeNs = 0;     //!< Total gradient and integral image time
+        int64_t decomposeTimeNs = 0;  //!< Total box smoothing and decomposition time
+        int64_t lastTimeNs = 0;       //!< Duration of last update
+        int64_t totalTimeNs = 0;      //!< Total duration of updates
+        int64_t maxTimeNs = 0;        //!< Longest update
+    };
+
+    //! Largest box smoothing radius. Box sums of gradient products must fit in 31 bits.
+    static constexpr int c_maxRadius = 15;
+
+    //! Construct field running on given thread pool
+    OrientationField(ThreadPool& threadPool, const Config& config);
+
+    // Disable copy, move and assign
+    OrientationField(const OrientationField& other) = delete;
+    OrientationField(const OrientationField&& other) = delete;
+    OrientationField& operator=(const OrientationField& other) = delete;
+    OrientationField& operator=(const OrientationField&& other) = delete;
+
+    //! Compute field of 8-bit luma plane. Returns false if plane is smaller than three field pixels.
+    //! Does not allocate unless size changes. Call from one thread only.
+    bool update(const uint8_t* luma, int width, int height, size_t rowStride, int64_t frameNumber);
+
+    //! Returns field width in field pixels
+    int getWidth() const { return m_width; }
+
+    //! Returns field height in field pixels
+    int getHeight() const { return m_height; }
+
+    //! Returns source pixels per field pixel
+    int getDownscale() const { return m_downscale; }
+
+    //! Returns orientation at source pixel, nearest field pixel, clamped to field
+    Sample sample(int x, int y) const
+    {
+        Sample result;
+        if (m_width > 0) {
+            const int fx = std::min(std::max(x / m_downscale, 0), m_width - 1);
+            const int fy = std::min(std::max(y / m_downscale, 0), m_height - 1);
+            const size_t i = static_cast<size_t>(fy) * m_width + fx;
+            result.tangent = glm::vec2(m_tangentX[i], m_tangentY[i]);
+            result.coherence = m_coherence[i];
+        }
+        return result;
+    }
+
+    //! Returns tangent x per field pixel, row order
+    const TrackedVector<float, MemoryTag::Stylization>& getTangentX() const { return m_tangentX; }
+
+    //! Returns tangent y per field pixel, row order
+    const TrackedVector<float, MemoryTag::Stylization>& getTangentY() const { return m_tangentY; }
+
+    //! Returns coherence per field pixel, row order
+    const TrackedVector<float, MemoryTag::Stylization>& getCoherence() const { return m_coherence; }
+
+    //! Returns frame number of last update, -1 if none
+    int64_t getFrameNumber() const { return m_frameNumber; }
+
+    //! Returns field statistics
+    const Stats& getStats() const { return m_stats; }
+
+    //! Register update timer metric to given registry. Pass null to stop publishing.
+    void setMetrics(MetricsRegistry* metrics);
+
+private:
+    ThreadPool& m_threadPool;    //!< Worker threads
+    const Config m_config;       //!< Field configuration
+    int m_downscale = 1;         //!< Source pixels per field pixel
+    int m_width = 0;             //!< Field width
+    int m_height = 0;            //!< Field height
+    int64_t m_frameNumber = -1;  //!< Frame number of last update
+
+    TrackedVector<uint8_t, MemoryTag::Stylization> m_luma;       //!< Downscaled luma
+    TrackedVector<uint32_t, MemoryTag::Stylization> m_integral;  //!< Wrapping integral images of xx, xy and yy gradient products, one plane each
+    TrackedVector<float, MemoryTag::Stylization> m_tangentX;     //!< Tangent x, holds smoothed xx during update
+    TrackedVector<float, MemoryTag::Stylization> m_tangentY;     //!< Tangent y, holds smoothed yy during update
+    TrackedVector<float, MemoryTag::Stylization> m_coherence;    //!< Coherence, holds smoothed xy during update
+    Stats m_stats{};                                             //!< Field statistics
+
+    MetricsRegistry* m_metrics = nullptr;                               //!< Metrics registry, null if not published
+    MetricsRegistry::Id m_updateMetric = MetricsRegistry::c_invalidId;  //!< Update timer
+};
+
+}  // namespace VarjoExamples
@@ -0,0 +1,21 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+namespace VarjoExamples
+{
+//! Constant buffer of the example video post process shader, vstPostProcess.hlsl. Must match with the shader exactly!
+struct PostProcessConstantBuffer {
+    int clusterSize = 0;
+    float outlineIntensity = 0.0f;
+
+    int watercolorRadius = 0;
+    float sketchIntensity = 0.0f;
+
+    float pointilismStep = 0.0f;
+    float pointilismThreshold = 0.0f;
+
+    float _padding0[2] = {0.0f, 0.0f};
+};
+
+}  // namespace VarjoExamples
@@ -0,0 +1,147 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "PowerStateMachine.hpp"
+
+namespace VarjoExamples
+{
+PowerStateMachine::PowerStateMachine(const Config& config)
+    : m_config(config)
+{
+}
+
+bool PowerStateMachine::handleEvent(const varjo_Event& evt)
+{
+    switch (evt.header.type) {
+        case varjo_EventType_HeadsetStandbyStatus: {
+            setReason(Reason::Standby, evt.data.headsetStandbyStatus.onStandby == varjo_True);
+        } break;
+        case varjo_EventType_Visibility: {
+            setReason(Reason::Hidden, evt.data.visibility.visible == varjo_False);
+        } break;
+        case varjo_EventType_Foreground: {
+            setReason(Reason::Background, evt.data.foreground.isForeground == varjo_False);
+        } break;
+        case varjo_EventType_DataStreamStart: {
+            // Stream running again, no need to wait for retry
+            setReason(Reason::StreamStopped, false);
+        } break;
+        default: {
+            return false;
+        }
+    }
+    m_stats.events++;
+    return true;
+}
+
+void PowerStateMachine::setReason(Reason reason, bool set)
+{
+    if (set) {
+        m_reasons |= getMask(reason);
+    } else {
+        m_reasons &= ~getMask(reason);
+        if (reason == Reason::StreamStopped) {
+            m_streamStoppedNs = -1;
+        }
+    }
+}
+
+bool PowerStateMachine::update(int64_t nowNs)
+{
+    if (m_stateBeginNs < 0) {
+        m_stateBeginNs = nowNs;
+        m_stateCpuBeginNs = getProcessCpuTimeNs();
+        m_stats.states[static_cast<int>(m_state)].entries++;
+    }
+
+    // Retry timer starts from the first frame that sees the stop
+    if (hasReason(Reason::StreamStopped)) {
+        if (m_streamStoppedNs < 0) {
+            m_streamStoppedNs = nowNs;
+        } else if (nowNs - m_streamStoppedNs >= m_config.streamRetryNs) {
+            setReason(Reason::StreamStopped, false);
+            m_stats.streamRetries++;
+        }
+    }
+
+    State state = State::Active;
+    if (m_reasons & m_config.suspendReasons) {
+        state = State::Suspended;
+    } else if (hasReason(Reason::StreamStopped)) {
+        state = State::StreamPaused;
+    }
+
+    if (state == m_state) {
+        return false;
+    }
+
+    // Process CPU time is only read on transitions, not every frame
+    const int64_t cpuNs = getProcessCpuTimeNs();
+    accountState(nowNs, cpuNs, m_stats.states[static_cast<int>(m_state)]);
+    m_stats.states[static_cast<int>(state)].entries++;
+    m_stats.transitions++;
+    m_stateBeginNs = nowNs;
+    m_stateCpuBeginNs = cpuNs;
+
+    LOGI("Power state: %s -> %s (%s)", getStateName(m_state), getStateName(state), getReasonNames(m_reasons).c_str());
+    m_previousState = m_state;
+    m_state = state;
+
+    if (m_metrics) {
+        m_metrics->set(m_stateMetric, static_cast<int64_t>(m_state));
+        m_metrics->increment(m_transitionMetric);
+    }
+    return true;
+}
+
+PowerStateMachine::Stats PowerStateMachine::getStats(int64_t nowNs) const
+{
+    Stats stats = m_stats;
+    if (m_stateBeginNs >= 0) {
+        accountState(nowNs, getProcessCpuTimeNs(), stats.states[static_cast<int>(m_state)]);
+    }
+    for (auto& state : stats.states) {
+        state.cpuUsage = state.wallTimeNs > 0 ? static_cast<double>(state.cpuTimeNs) / state.wallTimeNs : 0.0;
+    }
+    return stats;
+}
+
+void PowerStateMachine::setMetrics(MetricsRegistry* metrics)
+{
+    m_metrics = metrics;
+    if (m_metrics) {
+        m_stateMetric = m_metrics->addMetric("Power: state", MetricsRegistry::Kind::Gauge);
+        m_transitionMetric = m_metrics->addMetric("Power: transitions", MetricsRegistry::Kind::Counter);
+        m_metrics->set(m_stateMetric, static_cast<int64_t>(m_state));
+    }
+}
+
+const char* PowerStateMachine::getStateName(State state)
+{
+    switch (state) {
+        case State::Active: return "active";
+        case State::StreamPaused: return "stream paused";
+        case State::Suspended: return "suspended";
+        default: return "unknown";
+    }
+}
+
+std::string PowerStateMachine::getReasonNames(uint32_t reasons)
+{
+    static const char* const c_names[] = {"standby", "hidden", "background", "stream stopped"};
+
+    std::string names;
+    for (int i = 0; i < 4; i++) {
+        if (reasons & (1u << i)) {
+            names += std::string(names.empty() ? "" : "+") + c_names[i];
+        }
+    }
+    return names.empty() ? "none" : names;
+}
+
+void PowerStateMachine::accountState(int64_t nowNs, int64_t cpuNs, StateStats& stats) const
+{
+    stats.wallTimeNs += nowNs - m_stateBeginNs;
+    stats.cpuTimeNs += cpuNs - m_stateCpuBeginNs;
+}
+
+}  // namespace VarjoExamples
@@ -0,0 +1,149 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <string>
+
+#include <Varjo.h>
+#include <Varjo_events.h>
+
+#include "Globals.hpp"
+#include "MetricsRegistry.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Power state machine decides from Varjo events how much work the application does. Headset
+// standby, hidden session and session in background suspend the application: textures are not
+// generated, shader inputs are not submitted, data streams are stopped and worker threads parked.
+// A data stream stopped by the runtime only pauses stream consumers. Runtime does not tell when the
+// stream can be started again, so the reason is dropped after a retry interval and the application
+// tries to start the stream again. Reasons can be left out of suspend reasons, e.g. background for
+// an application that runs behind other applications on purpose, and are then only tracked.
+//
+// Events only set and clear reasons. The state is derived from reasons once per frame in update(),
+// so that the application reacts to at most one transition per frame and never stops and restarts
+// consumers within a frame. Consumers keep their buffers while paused, so work resumes with warm
+// caches and without allocating.
+//
+// Wall time and process CPU time are accounted per state, so that the idle cost of a suspended
+// application can be compared to its active cost. CPU time covers all threads of the process.
+
+//! Event driven power and load state machine
+class PowerStateMachine
+{
+public:
+    //! Power state, from full to least work
+    enum class State {
+        Active = 0,    //!< Everything runs
+        StreamPaused,  //!< Stream consumers paused, frame work runs
+        Suspended,     //!< Stream consumers, worker threads and post process updates paused
+        Count
+    };
+
+    //! Reason for reduced work. Reasons are bit flags, several can be set at once.
+    enum class Reason : uint32_t {
+        Standby = 1 << 0,        //!< Headset on standby
+        Hidden = 1 << 1,         //!< Session not visible
+        Background = 1 << 2,     //!< Session not in foreground
+        StreamStopped = 1 << 3,  //!< Data stream stopped by runtime
+    };
+
+    //! Number of states
+    static constexpr int c_stateCount = static_cast<int>(State::Count);
+
+    //! State machine configuration
+    struct Config {
+        uint32_t suspendReasons = 0x7;       //!< Reasons that suspend. Default standby, hidden and background.
+        int64_t streamRetryNs = 2000000000;  //!< Time after runtime stopped stream before starting it again
+    };
+
+    //! Accounting of one state
+    struct StateStats {
+        int64_t entries = 0;     //!< Times state was entered
+        int64_t wallTimeNs = 0;  //!< Wall time spent in state
+        int64_t cpuTimeNs = 0;   //!< Process CPU time spent in state
+        double cpuUsage = 0.0;   //!< Busy cores on average, CPU time per wall time
+    };
+
+    //! State machine statistics
+    struct Stats {
+        int64_t events = 0;                           //!< Handled power events
+        int64_t transitions = 0;                      //!< State changes
+        int64_t streamRetries = 0;                    //!< Stream stops dropped after retry interval
+        std::array<StateStats, c_stateCount> states;  //!< Accounting per state
+    };
+
+    //! Construct state machine in active state
+    PowerStateMachine(const Config& config);
+
+    // Disable copy, move and assign
+    PowerStateMachine(const PowerStateMachine& other) = delete;
+    PowerStateMachine(const PowerStateMachine&& other) = delete;
+    PowerStateMachine& operator=(const PowerStateMachine& other) = delete;
+    PowerStateMachine& operator=(const PowerStateMachine&& other) = delete;
+
+    //! Handle visibility, standby, foreground and data stream start events. Returns false for other events.
+    //! Stream stops are not handled here, since only the application knows which stops it requested itself.
+    bool handleEvent(const varjo_Event& evt);
+
+    //! Set or clear reason. Takes effect on next update.
+    void setReason(Reason reason, bool set);
+
+    //! Apply reasons and account time. Call once per frame. Returns true if state changed.
+    bool update(int64_t nowNs);
+
+    //! Returns current state
+    State getState() const { return m_state; }
+
+    //! Returns state before last transition
+    State getPreviousState() const { return m_previousState; }
+
+    //! Returns reason flags
+    uint32_t getReasons() const { return m_reasons; }
+
+    //! Returns true if reason is set
+    bool hasReason(Reason reason) const { return (m_reasons & getMask(reason)) != 0; }
+
+    //! Returns true if application is suspended
+    bool isSuspended() const { return m_state == State::Suspended; }
+
+    //! Returns true if stream consumers are paused
+    bool isStreamPaused() const { return m_state != State::Active; }
+
+    //! Returns statistics including time spent in current state until given time
+    Stats getStats(int64_t nowNs) const;
+
+    //! Register state and transition metrics to given registry and update them from update(). Pass null to stop publishing.
+    void setMetrics(MetricsRegistry* metrics);
+
+    //! Returns reason bit mask
+    static uint32_t getMask(Reason reason) { return static_cast<uint32_t>(reason); }
+
+    //! Returns state name
+    static const char* getStateName(State state);
+
+    //! Returns reason names separated by '+', "none" if no reasons
+    static std::string getReasonNames(uint32_t reasons);
+
+private:
+    //! Add time since current state began to its accounting
+    void accountState(int64_t nowNs, int64_t cpuNs, StateStats& stats) const;
+
+private:
+    const Config m_config;                  //!< State machine configuration
+    State m_state = State::Active;          //!< Current state
+    State m_previousState = State::Active;  //!< State before last transition
+    uint32_t m_reasons = 0;                 //!< Reason flags
+    int64_t m_streamStoppedNs = -1;         //!< Time stream stop was first seen in update, -1 if not stopped
+    int64_t m_stateBeginNs = -1;            //!< Wall time current state began, -1 before first update
+    int64_t m_stateCpuBeginNs = 0;          //!< Process CPU time current state began
+    Stats m_stats{};                        //!< Statistics of finished state periods
+
+    MetricsRegistry* m_metrics = nullptr;                                   //!< Metrics registry, null if not published
+    MetricsRegistry::Id m_stateMetric = MetricsRegistry::c_invalidId;       //!< Current state gauge
+    MetricsRegistry::Id m_transitionMetric = MetricsRegistry::c_invalidId;  //!< State change counter
+};
+
+}  // namespace VarjoExamples
@@ -45,6 +45,7 @@ Renderer::Mesh::Mesh(const std::vector<float>& vertexData, const std::vector<uns
     : m_vertices(vertexData)
     , m_indices(indexData)
     , m_topology(topology)
+    , m_memory(MemoryTag::Renderer, vertexData.size() * sizeof(float) + indexData.size() * sizeof(unsigned short))
 {
 }
 
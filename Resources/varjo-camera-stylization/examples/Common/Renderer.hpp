@@ -8,6 +8,7 @@
 #include <cassert>
 
 #include "Globals.hpp"
+#include "MemoryAccounting.hpp"
 
 namespace VarjoExamples
 {
@@ -74,6 +75,9 @@ public:
         //! Returns texture type
         TextureType getType() const { return m_type; }
 
+        //! Set texture memory size reported to memory accounting
+        void setMemoryBytes(size_t bytes) { m_memory.set(bytes); }
+
     protected:
         //! Protected constructor
         Texture() = default;
@@ -81,6 +85,7 @@ public:
     private:
         glm::ivec2 m_size{0, 0};                      //!< Texture size
         TextureType m_type = TextureType::Texture2D;  //!< Texture type
+        TrackedBytes m_memory{MemoryTag::Renderer};   //!< Texture memory hook
     };
 
     //! Primitive topology enumeration
@@ -104,6 +109,7 @@ public:
         std::vector<float> m_vertices;          //!< Object vertex data
         std::vector<unsigned short> m_indices;  //!< Object index data
         PrimitiveTopology m_topology;           //!< Mesh topology
+        TrackedBytes m_memory;                  //!< Mesh data memory hook
     };
 
     //! Default virtual destructor
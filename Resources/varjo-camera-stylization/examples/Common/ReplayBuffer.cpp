@@ -0,0 +1,380 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "ReplayBuffer.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <cstring>
+
+using namespace VarjoExamples;
+
+namespace
+{
+// Copy stream buffer planes to tightly packed destination
+void copyPacked(const varjo_BufferMetadata& buffer, const void* cpuData, uint8_t* dst)
+{
+    const size_t rowCount = FrameCodec::getPackedSize(buffer.format, buffer.width, buffer.height) / buffer.width;
+    const uint8_t* src = reinterpret_cast<const uint8_t*>(cpuData);
+    for (size_t y = 0; y < rowCount; y++) {
+        memcpy(dst + buffer.width * y, src + buffer.rowStride * y, buffer.width);
+    }
+}
+
+}  // namespace
+
+namespace VarjoExamples
+{
+ReplayBuffer::ReplayBuffer(ThreadPool& threadPool, const Config& config)
+    : m_threadPool(threadPool)
+    , m_config(config)
+    , m_ring(config.memoryBudget)
+{
+    m_stats.budgetBytes = static_cast<int64_t>(m_ring.size());
+    if (m_config.compress) {
+        m_encoderThread = std::thread(&ReplayBuffer::encoderMain, this);
+    }
+}
+
+ReplayBuffer::~ReplayBuffer()
+{
+    if (m_encoderThread.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            m_quit = true;
+        }
+        m_queueCond.notify_all();
+        m_encoderThread.join();
+    }
+    joinDump();
+}
+
+void ReplayBuffer::submitFrame(const DataStreamer::Frame& frame)
+{
+    const varjo_BufferMetadata& buffer = frame.buffer;
+    if (frame.type != varjo_StreamType_DistortedColor || frame.cpuData == nullptr || buffer.type != varjo_BufferType_CPU ||
+        !FrameCodec::isSupportedFormat(buffer.format)) {
+        return;
+    }
+
+    Entry entry;
+    entry.record.frameNumber = frame.frameNumber;
+    entry.record.timestamp = frame.metadata.distortedColor.timestamp;
+    entry.record.channelIndex = frame.channelIndex;
+    entry.metadata = FrameMetadata::fromFrame(frame);
+    entry.buffer = buffer;
+    entry.buffer.rowStride = buffer.width;
+    entry.buffer.byteSize = static_cast<int32_t>(FrameCodec::getPackedSize(buffer.format, buffer.width, buffer.height));
+
+    if (!m_config.compress) {
+        // Packed frames are copied straight to ring. Each one decodes on its own.
+        entry.size = static_cast<size_t>(entry.buffer.byteSize);
+        entry.record.keyframe = true;
+        {
+            std::lock_guard<std::mutex> lock(m_ringMutex);
+            if (!reserve(entry)) {
+                m_stats.droppedFrames++;
+                return;
+            }
+        }
+        copyPacked(buffer, frame.cpuData, m_ring.data() + entry.offset);
+        commit(entry);
+        return;
+    }
+
+    // Take free pending frame, or allocate one if queue is not yet at its limit
+    std::unique_ptr<PendingFrame> pending;
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        if (!m_freeFrames.empty()) {
+            pending = std::move(m_freeFrames.back());
+            m_freeFrames.pop_back();
+        } else if (m_allocatedFrames < m_config.maxPendingFrames) {
+            pending = std::make_unique<PendingFrame>();
+            m_allocatedFrames++;
+        }
+    }
+
+    if (!pending) {
+        std::lock_guard<std::mutex> lock(m_ringMutex);
+        m_stats.droppedFrames++;
+        return;
+    }
+
+    pending->entry = entry;
+    pending->data.resize(static_cast<size_t>(entry.buffer.byteSize));
+    copyPacked(buffer, frame.cpuData, pending->data.data());
+
+    {
+        std::lock_guard<std::mutex> lock(m_queueMutex);
+        m_queue.push_back(std::move(pending));
+    }
+    m_queueCond.notify_one();
+}
+
+bool ReplayBuffer::dump(const std::string& filename, double seconds)
+{
+    if (m_dumping) {
+        LOGW("Replay dump already in progress.");
+        return false;
+    }
+    joinDump();
+
+    std::vector<Entry> entries;
+    {
+        std::lock_guard<std::mutex> lock(m_ringMutex);
+        if (m_entries.empty()) {
+            LOGW("Replay buffer is empty.");
+            return false;
+        }
+
+        const int64_t first = m_entries.back().record.timestamp - static_cast<int64_t>(seconds * 1e9);
+        auto begin = m_entries.end();
+        while (begin != m_entries.begin() && std::prev(begin)->record.timestamp >= first) {
+            --begin;
+        }
+
+        // Extend range back to preceding keyframe of each channel, so that the whole requested time
+        // span decodes. Channels waiting for a keyframe are those whose first frame in range is not one.
+        std::map<varjo_ChannelIndex, bool> waiting;
+        for (auto it = begin; it != m_entries.end(); ++it) {
+            waiting.insert(std::make_pair(it->record.channelIndex, !it->record.keyframe));
+        }
+        int waitingCount = static_cast<int>(std::count_if(waiting.begin(), waiting.end(), [](const auto& w) { return w.second; }));
+        auto extended = begin;
+        for (auto it = begin; it != m_entries.begin() && waitingCount > 0;) {
+            --it;
+            auto channel = waiting.find(it->record.channelIndex);
+            if (channel != waiting.end() && channel->second) {
+                extended = it;
+                if (it->record.keyframe) {
+                    channel->second = false;
+                    waitingCount--;
+                }
+            }
+        }
+        entries.assign(extended, m_entries.end());
+        if (entries.empty()) {
+            return false;
+        }
+
+        // Pin dumped entries until they have been written
+        m_pinBegin = entries.front().sequence;
+        m_pinEnd = entries.back().sequence + 1;
+        m_stats.dumpedFrames = 0;
+    }
+
+    m_dumping = true;
+    m_dumpThread = std::thread(&ReplayBuffer::dumpMain, this, filename, std::move(entries));
+    LOGI("Replay dump started: %s, %.1f s", filename.c_str(), seconds);
+    return true;
+}
+
+void ReplayBuffer::clear()
+{
+    joinDump();
+
+    std::lock_guard<std::mutex> lock(m_ringMutex);
+    m_entries.clear();
+    m_stats.frames = 0;
+    m_stats.keyframes = 0;
+    m_stats.usedBytes = 0;
+}
+
+ReplayBuffer::Stats ReplayBuffer::getStats() const
+{
+    std::lock_guard<std::mutex> lock(m_ringMutex);
+    Stats stats = m_stats;
+    if (!m_entries.empty()) {
+        stats.retainedSeconds = (m_entries.back().record.timestamp - m_entries.front().record.timestamp) * 1e-9;
+    }
+    if (stats.usedBytes > 0) {
+        stats.framesPerMB = stats.frames / (stats.usedBytes / static_cast<double>(1 << 20));
+    }
+    stats.encodeTimeAvgMs = m_encodedFrames > 0 ? m_encodeTimeTotalMs / m_encodedFrames : 0.0;
+    stats.dumping = m_dumping;
+    return stats;
+}
+
+void ReplayBuffer::encoderMain()
+{
+    while (true) {
+        std::unique_ptr<PendingFrame> pending;
+        {
+            std::unique_lock<std::mutex> lock(m_queueMutex);
+            m_queueCond.wait(lock, [this]() { return m_quit || !m_queue.empty(); });
+            if (m_quit) {
+                return;
+            }
+            pending = std::move(m_queue.front());
+            m_queue.pop_front();
+        }
+
+        Entry entry = pending->entry;
+        auto& encoder = m_encoders[entry.record.channelIndex];
+        if (!encoder) {
+            encoder = std::make_unique<FrameEncoder>(m_threadPool, m_config.sliceCount);
+        }
+
+        int64_t& channelFrames = m_channelFrames[entry.record.channelIndex];
+        const bool keyframe = (m_config.keyframeInterval <= 0) ? (channelFrames == 0) : (channelFrames % m_config.keyframeInterval == 0);
+
+        const int64_t start = getTimestampNs();
+        m_encoded.clear();
+        const bool encoded = encoder->encode(entry.buffer, pending->data.data(), keyframe, m_encoded);
+        const double encodeTimeMs = (getTimestampNs() - start) * 1e-6;
+
+        {
+            std::lock_guard<std::mutex> lock(m_queueMutex);
+            m_freeFrames.push_back(std::move(pending));
+        }
+        if (!encoded) {
+            continue;
+        }
+
+        FrameCodec::FrameInfo info;
+        FrameCodec::readFrameInfo(m_encoded.data(), m_encoded.size(), info);
+        entry.encoded = true;
+        entry.record.keyframe = info.keyframe;
+        entry.size = m_encoded.size();
+
+        bool reserved = false;
+        {
+            std::lock_guard<std::mutex> lock(m_ringMutex);
+            m_encodeTimeTotalMs += encodeTimeMs;
+            m_encodedFrames++;
+            reserved = reserve(entry);
+            if (!reserved) {
+                m_stats.droppedFrames++;
+            }
+        }
+
+        // Next frame of channel cannot reference a frame missing from ring
+        if (!reserved) {
+            encoder->reset();
+            channelFrames = 0;
+            continue;
+        }
+
+        memcpy(m_ring.data() + entry.offset, m_encoded.data(), entry.size);
+        commit(entry);
+        channelFrames++;
+    }
+}
+
+bool ReplayBuffer::reserve(Entry& entry)
+{
+    if (entry.size > m_ring.size()) {
+        return false;
+    }
+
+    auto isPinned = [this](const Entry& e) { return e.sequence >= m_pinBegin && e.sequence < m_pinEnd; };
+    auto evictFront = [this]() {
+        const Entry& front = m_entries.front();
+        m_stats.frames--;
+        m_stats.keyframes -= front.record.keyframe ? 1 : 0;
+        m_stats.usedBytes -= static_cast<int64_t>(front.size);
+        m_stats.evictedFrames++;
+        m_entries.pop_front();
+    };
+
+    // Entries after write offset are the oldest ones. If they leave no room at the end of ring,
+    // they are evicted and writing continues from the beginning.
+    size_t offset = m_writeOffset;
+    if (offset + entry.size > m_ring.size()) {
+        while (!m_entries.empty() && m_entries.front().offset >= offset) {
+            if (isPinned(m_entries.front())) {
+                return false;
+            }
+            evictFront();
+        }
+        offset = 0;
+    }
+
+    while (!m_entries.empty() && m_entries.front().offset < offset + entry.size && m_entries.front().offset + m_entries.front().size > offset) {
+        if (isPinned(m_entries.front())) {
+            return false;
+        }
+        evictFront();
+    }
+
+    entry.offset = offset;
+    entry.sequence = m_nextSequence++;
+    m_writeOffset = offset + entry.size;
+    return true;
+}
+
+void ReplayBuffer::commit(const Entry& entry)
+{
+    std::lock_guard<std::mutex> lock(m_ringMutex);
+    m_entries.push_back(entry);
+    m_stats.frames++;
+    m_stats.keyframes += entry.record.keyframe ? 1 : 0;
+    m_stats.usedBytes += static_cast<int64_t>(entry.size);
+}
+
+void ReplayBuffer::dumpMain(std::string filename, std::vector<Entry> entries)
+{
+    FrameRecordingWriter writer;
+    std::map<varjo_ChannelIndex, std::unique_ptr<FrameEncoder>> encoders;
+    std::map<varjo_ChannelIndex, int64_t> channelFrames;
+    std::vector<uint8_t> encoded;
+    int64_t written = 0;
+
+    if (writer.open(filename)) {
+        for (const Entry& entry : entries) {
+            const uint8_t* data = m_ring.data() + entry.offset;
+            size_t size = entry.size;
+            int64_t& frames = channelFrames[entry.record.channelIndex];
+
+            if (entry.encoded) {
+                // Frames before first keyframe of channel lost their reference to eviction
+                if (frames == 0 && !entry.record.keyframe) {
+                    data = nullptr;
+                }
+            } else {
+                // Packed frames are encoded here, so uncompressed ring still dumps to a small file
+                auto& encoder = encoders[entry.record.channelIndex];
+                if (!encoder) {
+                    encoder = std::make_unique<FrameEncoder>(m_threadPool, m_config.sliceCount);
+                }
+                const bool keyframe = (m_config.keyframeInterval > 0) && (frames % m_config.keyframeInterval == 0);
+                encoded.clear();
+                if (encoder->encode(entry.buffer, data, keyframe, encoded)) {
+                    data = encoded.data();
+                    size = encoded.size();
+                } else {
+                    data = nullptr;
+                }
+            }
+
+            FrameRecord record = entry.record;
+            if (data && writer.writeFrame(record, entry.metadata, data, size)) {
+                frames++;
+                written++;
+            }
+
+            // Release written entry for eviction
+            std::lock_guard<std::mutex> lock(m_ringMutex);
+            m_pinBegin = entry.sequence + 1;
+        }
+        writer.close();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_ringMutex);
+        m_pinBegin = 0;
+        m_pinEnd = 0;
+        m_stats.dumpedFrames = written;
+    }
+    LOGI("Replay dump finished: %s, %lld frames", filename.c_str(), static_cast<long long>(written));
+    m_dumping = false;
+}
+
+void ReplayBuffer::joinDump()
+{
+    if (m_dumpThread.joinable()) {
+        m_dumpThread.join();
+    }
+}
+
+}  // namespace VarjoExamples
@@ -0,0 +1,151 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+
+#include "Globals.hpp"
+#include "ThreadPool.hpp"
+#include "DataStreamer.hpp"
+#include "FrameCodec.hpp"
+#include "FrameRecorder.hpp"
+#include "MemoryAccounting.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Replay buffer keeps the most recent color stream frames in one byte ring allocated up front,
+// so its memory use never grows past the configured budget. New frames evict the oldest ones. With
+// compression, frames are copied to a small pool of pending buffers on the stream thread and encoded
+// on a worker thread. Without it, packed frames are copied straight to the ring. Dumping writes a
+// recording file readable with FrameRecordingReader on a background thread. Frames being dumped are
+// pinned in the ring, and new frames that would evict them are dropped, so the stream never waits.
+// Dumps start from the keyframe preceding the requested time span on each channel. Evicting a keyframe
+// leaves the frames depending on it in the ring until they are evicted too, but dumps skip them.
+
+//! Fixed memory ring of recent color stream frames for dumping instant replays
+class ReplayBuffer
+{
+public:
+    //! Replay buffer configuration
+    struct Config {
+        size_t memoryBudget = size_t(512) << 20;           //!< Ring size in bytes
+        bool compress = true;                              //!< Encode frames with frame codec on worker thread
+        int keyframeInterval = 45;                         //!< Frames per channel between keyframes
+        int sliceCount = FrameCodec::c_defaultSliceCount;  //!< Row slices per frame
+        int maxPendingFrames = 4;                          //!< Frames waiting for encoding before dropping
+    };
+
+    //! Replay buffer statistics
+    struct Stats {
+        int64_t frames = 0;            //!< Frames in ring
+        int64_t keyframes = 0;         //!< Keyframes in ring
+        int64_t usedBytes = 0;         //!< Bytes used by frames in ring
+        int64_t budgetBytes = 0;       //!< Ring size in bytes
+        double retainedSeconds = 0.0;  //!< Capture time span of frames in ring
+        double framesPerMB = 0.0;      //!< Frames in ring per megabyte used
+        int64_t droppedFrames = 0;     //!< Frames dropped because encoder was behind or ring was pinned
+        int64_t evictedFrames = 0;     //!< Frames evicted to make room for new ones
+        double encodeTimeAvgMs = 0.0;  //!< Average frame encode time
+        bool dumping = false;          //!< Dump in progress flag
+        int64_t dumpedFrames = 0;      //!< Frames written by last dump
+    };
+
+    //! Construct replay buffer and allocate ring. Frames are encoded on given thread pool.
+    ReplayBuffer(ThreadPool& threadPool, const Config& config);
+
+    //! Destruct replay buffer. Waits for dump in progress.
+    ~ReplayBuffer();
+
+    // Disable copy, move and assign
+    ReplayBuffer(const ReplayBuffer& other) = delete;
+    ReplayBuffer(const ReplayBuffer&& other) = delete;
+    ReplayBuffer& operator=(const ReplayBuffer& other) = delete;
+    ReplayBuffer& operator=(const ReplayBuffer&& other) = delete;
+
+    //! Store frame to ring. Called from stream thread. Unsupported frames are ignored.
+    void submitFrame(const DataStreamer::Frame& frame);
+
+    //! Start writing frames captured during last given seconds to file in background.
+    //! Returns false if previous dump is still in progress or ring is empty.
+    bool dump(const std::string& filename, double seconds);
+
+    //! Forget all frames in ring. Waits for dump in progress.
+    void clear();
+
+    //! Returns replay buffer statistics
+    Stats getStats() const;
+
+private:
+    //! Frame stored in ring
+    struct Entry {
+        int64_t sequence = 0;         //!< Sequence number of entry
+        size_t offset = 0;            //!< Data offset in ring
+        size_t size = 0;              //!< Data size in ring
+        FrameRecord record;           //!< Record description
+        FrameMetadata metadata;       //!< Stream metadata
+        varjo_BufferMetadata buffer;  //!< Packed buffer metadata
+        bool encoded = false;         //!< Data is frame codec encoded, otherwise packed planes
+    };
+
+    //! Frame copied from stream buffer for encoding
+    struct PendingFrame {
+        Entry entry;                                     //!< Entry description
+        TrackedVector<uint8_t, MemoryTag::Stream> data;  //!< Packed frame data
+    };
+
+    //! Encoder thread main function
+    void encoderMain();
+
+    //! Reserve ring space for entry by evicting oldest entries. Returns false if pinned entries are in the way.
+    bool reserve(Entry& entry);
+
+    //! Add reserved entry to ring
+    void commit(const Entry& entry);
+
+    //! Dump thread main function
+    void dumpMain(std::string filename, std::vector<Entry> entries);
+
+    //! Wait for dump thread
+    void joinDump();
+
+private:
+    ThreadPool& m_threadPool;                          //!< Encoding threads
+    const Config m_config;                             //!< Replay buffer configuration
+    TrackedVector<uint8_t, MemoryTag::Stream> m_ring;  //!< Frame data ring
+
+    mutable std::mutex m_ringMutex;    //!< Ring mutex
+    std::deque<Entry> m_entries;       //!< Entries from oldest to newest
+    size_t m_writeOffset = 0;          //!< Ring offset after newest entry
+    int64_t m_nextSequence = 0;        //!< Sequence number of next entry
+    int64_t m_pinBegin = 0;            //!< First pinned entry sequence
+    int64_t m_pinEnd = 0;              //!< Sequence after last pinned entry
+    Stats m_stats{};                   //!< Statistics
+    double m_encodeTimeTotalMs = 0.0;  //!< Total encode time
+    int64_t m_encodedFrames = 0;       //!< Encoded frames for average
+
+    std::mutex m_queueMutex;                                  //!< Pending queue mutex
+    std::condition_variable m_queueCond;                      //!< Signaled when frames are queued
+    std::deque<std::unique_ptr<PendingFrame>> m_queue;        //!< Frames waiting for encoding
+    std::vector<std::unique_ptr<PendingFrame>> m_freeFrames;  //!< Reusable pending frames
+    int m_allocatedFrames = 0;                                //!< Allocated pending frames
+    bool m_quit = false;                                      //!< Quit flag for encoder thread
+    std::thread m_encoderThread;                              //!< Encoder thread
+
+    std::map<varjo_ChannelIndex, std::unique_ptr<FrameEncoder>> m_encoders;  //!< Encoder per channel
+    std::map<varjo_ChannelIndex, int64_t> m_channelFrames;                   //!< Encoded frames per channel
+    std::vector<uint8_t> m_encoded;                                          //!< Encoding buffer
+
+    std::thread m_dumpThread;            //!< Dump thread
+    std::atomic<bool> m_dumping{false};  //!< Dump in progress flag
+};
+
+}  // namespace VarjoExamples
@@ -0,0 +1,88 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "ResolutionScaler.hpp"
+
+#include <algorithm>
+
+using namespace VarjoExamples;
+
+ResolutionScaler::ResolutionScaler(const Config& config, double contextPixels, double focusPixels)
+    : m_config(config)
+    , m_contextPixels(contextPixels)
+    , m_focusPixels(focusPixels)
+{
+}
+
+void ResolutionScaler::reset()
+{
+    m_contextScale = 1.0f;
+    m_focusScale = 1.0f;
+    m_cooldown = 0;
+    m_hasAverage = false;
+    m_stats = {};
+}
+
+double ResolutionScaler::getPixels(float contextScale, float focusScale) const
+{
+    return m_contextPixels * contextScale * contextScale + m_focusPixels * focusScale * focusScale;
+}
+
+bool ResolutionScaler::update(double frameTimeMs)
+{
+    m_stats.frames++;
+    if (frameTimeMs > m_config.budgetMs) {
+        m_stats.framesOverBudget++;
+    }
+
+    // Smoothed frame time
+    if (!m_hasAverage) {
+        m_stats.smoothedFrameTimeMs = frameTimeMs;
+        m_hasAverage = true;
+    } else {
+        m_stats.smoothedFrameTimeMs += m_config.smoothing * (frameTimeMs - m_stats.smoothedFrameTimeMs);
+    }
+
+    if (m_cooldown > 0) {
+        m_cooldown--;
+        return false;
+    }
+
+    const float step = m_config.scaleStep;
+    float contextScale = m_contextScale;
+    float focusScale = m_focusScale;
+
+    if (m_stats.smoothedFrameTimeMs > m_config.budgetMs * m_config.upperThreshold) {
+        // Over budget: reduce context first, then focus
+        if (contextScale > m_config.minContextScale) {
+            contextScale = std::max(m_config.minContextScale, contextScale - step);
+        } else {
+            focusScale = std::max(m_config.minFocusScale, focusScale - step);
+        }
+    } else {
+        // Under budget: restore focus first, then context, if predicted time leaves headroom
+        if (focusScale < 1.0f) {
+            focusScale = std::min(1.0f, focusScale + step);
+        } else {
+            contextScale = std::min(1.0f, contextScale + step);
+        }
+        const double pixels = getPixels(m_contextScale, m_focusScale);
+        const double predictedMs = pixels > 0.0 ? m_stats.smoothedFrameTimeMs * getPixels(contextScale, focusScale) / pixels : 0.0;
+        if (predictedMs > m_config.budgetMs * m_config.lowerThreshold) {
+            return false;
+        }
+    }
+
+    if (contextScale == m_contextScale && focusScale == m_focusScale) {
+        return false;
+    }
+
+    if (getPixels(contextScale, focusScale) < getPixels(m_contextScale, m_focusScale)) {
+        m_stats.decreases++;
+    } else {
+        m_stats.increases++;
+    }
+    m_contextScale = contextScale;
+    m_focusScale = focusScale;
+    m_cooldown = m_config.cooldownFrames;
+    return true;
+}
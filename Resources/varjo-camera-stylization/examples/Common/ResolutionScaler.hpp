@@ -0,0 +1,89 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+
+#include "Globals.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Resolution scaler picks render scales of context and focus views from measured frame
+// times. Frame time is smoothed with an exponential moving average, and scales change by one step
+// at a time with a cooldown between changes, so a single slow frame does not change resolution.
+//
+// Hysteresis comes from two thresholds: resolution is decreased when smoothed time exceeds the
+// upper threshold of the budget, but increased only if time predicted for the larger render area
+// stays below the lower threshold. Render cost is assumed to scale with pixel count.
+//
+// Context views are reduced first and restored last, and focus views have a higher minimum scale,
+// so detail is lost from the periphery before the area the user is looking at.
+
+//! Dynamic resolution controller for layer view rendering
+class ResolutionScaler
+{
+public:
+    //! Controller configuration
+    struct Config {
+        double budgetMs = 1000.0 / 90.0;  //!< Frame time budget
+        double upperThreshold = 0.95;     //!< Decrease resolution above this fraction of budget
+        double lowerThreshold = 0.8;      //!< Increase resolution if predicted time is below this fraction of budget
+        double smoothing = 0.1;           //!< Weight of new frame time in moving average
+        float scaleStep = 0.05f;          //!< Scale change per adjustment
+        float minContextScale = 0.5f;     //!< Minimum context view scale
+        float minFocusScale = 0.7f;       //!< Minimum focus view scale
+        int cooldownFrames = 15;          //!< Frames to wait after adjustment before next one
+    };
+
+    //! Controller statistics
+    struct Stats {
+        int64_t frames = 0;                //!< Measured frames
+        int64_t decreases = 0;             //!< Resolution decreases
+        int64_t increases = 0;             //!< Resolution increases
+        int64_t framesOverBudget = 0;      //!< Frames with measured time over budget
+        double smoothedFrameTimeMs = 0.0;  //!< Current smoothed frame time
+    };
+
+    //! Construct controller at full resolution. Pixel counts are full resolution totals of context and focus views.
+    ResolutionScaler(const Config& config, double contextPixels, double focusPixels);
+
+    // Disable copy, move and assign
+    ResolutionScaler(const ResolutionScaler& other) = delete;
+    ResolutionScaler(const ResolutionScaler&& other) = delete;
+    ResolutionScaler& operator=(const ResolutionScaler& other) = delete;
+    ResolutionScaler& operator=(const ResolutionScaler&& other) = delete;
+
+    //! Add measured frame time. Returns true if scales changed.
+    bool update(double frameTimeMs);
+
+    //! Reset to full resolution and clear frame time history
+    void reset();
+
+    //! Returns render scale of context views
+    float getContextScale() const { return m_contextScale; }
+
+    //! Returns render scale of focus views
+    float getFocusScale() const { return m_focusScale; }
+
+    //! Returns render scale of view of given display type
+    float getScale(bool focus) const { return focus ? m_focusScale : m_contextScale; }
+
+    //! Returns controller statistics
+    const Stats& getStats() const { return m_stats; }
+
+private:
+    //! Returns rendered pixels at given scales
+    double getPixels(float contextScale, float focusScale) const;
+
+private:
+    const Config m_config;         //!< Controller configuration
+    const double m_contextPixels;  //!< Full resolution context view pixels
+    const double m_focusPixels;    //!< Full resolution focus view pixels
+    float m_contextScale = 1.0f;   //!< Context view scale
+    float m_focusScale = 1.0f;     //!< Focus view scale
+    int m_cooldown = 0;            //!< Frames left until next adjustment
+    bool m_hasAverage = false;     //!< Moving average initialized flag
+    Stats m_stats{};               //!< Statistics
+};
+
+}  // namespace VarjoExamples
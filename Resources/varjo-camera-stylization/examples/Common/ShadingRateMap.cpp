@@ -0,0 +1,275 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "ShadingRateMap.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+
+using namespace VarjoExamples;
+
+namespace
+{
+// Occlusion samples per tile edge, inset from tile border. Tile is hidden only if all samples are inside the mesh.
+constexpr int c_occlusionSamples = 3;
+
+// Points this close to a triangle edge count as inside, so that points on edges shared by two triangles are not lost to rounding
+constexpr float c_edgeEpsilon = 1e-6f;
+
+// Shaded samples of a 4x4 pixel block per rate encoding. Invalid encodings count as full rate.
+const uint8_t c_blockSamples[16] = {16, 8, 16, 16, 8, 4, 2, 16, 16, 2, 1, 16, 16, 16, 16, 16};
+
+// Returns true if point is inside triangle of either winding order
+bool isInsideTriangle(const glm::vec2& p, const varjo_Vector2Df& a, const varjo_Vector2Df& b, const varjo_Vector2Df& c)
+{
+    const float d0 = (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+    const float d1 = (c.x - b.x) * (p.y - b.y) - (c.y - b.y) * (p.x - b.x);
+    const float d2 = (a.x - c.x) * (p.y - c.y) - (a.y - c.y) * (p.x - c.x);
+    const bool negative = d0 < -c_edgeEpsilon || d1 < -c_edgeEpsilon || d2 < -c_edgeEpsilon;
+    const bool positive = d0 > c_edgeEpsilon || d1 > c_edgeEpsilon || d2 > c_edgeEpsilon;
+    return !(negative && positive);
+}
+
+// Returns true if point is inside any mesh triangle
+bool isInsideMesh(const glm::vec2& p, const varjo_Mesh2Df& mesh)
+{
+    for (int32_t i = 0; i + 2 < mesh.vertexCount; i += 3) {
+        if (isInsideTriangle(p, mesh.vertices[i], mesh.vertices[i + 1], mesh.vertices[i + 2])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+ShadingRateMap::ShadingRateMap(const Config& config, int viewCount)
+    : m_config(config)
+    , m_views(std::max(viewCount, 0))
+{
+    const size_t cells = static_cast<size_t>(m_config.edgeGridSize) * m_config.edgeGridSize;
+    m_detailedCells.valid = true;
+    m_detailedCells.inner.assign(cells, static_cast<uint8_t>(Rate::Rate1x1));
+    m_detailedCells.outer.assign(cells, static_cast<uint8_t>(Rate::Rate2x2));
+}
+
+void ShadingRateMap::setViewSize(int viewIndex, int width, int height)
+{
+    View& view = m_views.at(viewIndex);
+    view.width = std::max(width, 1);
+    view.height = std::max(height, 1);
+    view.tilesX = (view.width + m_config.tileSize - 1) / m_config.tileSize;
+    view.tilesY = (view.height + m_config.tileSize - 1) / m_config.tileSize;
+    const size_t tiles = static_cast<size_t>(view.tilesX) * view.tilesY;
+    view.occluded.assign(tiles, 0);
+    view.rates.assign(tiles, static_cast<uint8_t>(Rate::Rate1x1));
+
+    // Column values are the same for every row
+    view.columnNdc.resize(view.tilesX);
+    view.columnCells.resize(view.tilesX);
+    for (int tx = 0; tx < view.tilesX; tx++) {
+        view.columnNdc[tx] = -1.0f + (tx + 0.5f) * 2.0f * m_config.tileSize / view.width;
+        view.columnCells[tx] = std::min(static_cast<int>((view.columnNdc[tx] + 1.0f) * 0.5f * m_config.edgeGridSize), m_config.edgeGridSize - 1);
+    }
+}
+
+bool ShadingRateMap::setOcclusionMesh(int viewIndex, const varjo_Mesh2Df* mesh)
+{
+    if (viewIndex < 0 || viewIndex >= getViewCount()) {
+        LOGE("Invalid view index for occlusion mesh: %d", viewIndex);
+        return false;
+    }
+
+    View& view = m_views[viewIndex];
+    std::fill(view.occluded.begin(), view.occluded.end(), static_cast<uint8_t>(0));
+    if (!mesh || !mesh->vertices) {
+        return true;
+    }
+
+    // Mesh is done once per session, so brute force sampling against every triangle is fine
+    const float tileW = 2.0f * m_config.tileSize / view.width;
+    const float tileH = 2.0f * m_config.tileSize / view.height;
+    for (int ty = 0; ty < view.tilesY; ty++) {
+        for (int tx = 0; tx < view.tilesX; tx++) {
+            bool hidden = true;
+            for (int s = 0; s < c_occlusionSamples * c_occlusionSamples && hidden; s++) {
+                const float fx = (s % c_occlusionSamples + 0.5f) / c_occlusionSamples;
+                const float fy = (s / c_occlusionSamples + 0.5f) / c_occlusionSamples;
+                const glm::vec2 p(std::min(-1.0f + (tx + fx) * tileW, 1.0f), std::max(1.0f - (ty + fy) * tileH, -1.0f));
+                hidden = isInsideMesh(p, *mesh);
+            }
+            view.occluded[static_cast<size_t>(ty) * view.tilesX + tx] = hidden ? 1 : 0;
+        }
+    }
+    return true;
+}
+
+void ShadingRateMap::computeEdgeGrid(
+    const uint8_t* luma, int width, int height, size_t rowStride, int gridWidth, int gridHeight, int sampleStep, EdgeGrid& outGrid)
+{
+    const size_t cells = static_cast<size_t>(gridWidth) * gridHeight;
+    outGrid.width = gridWidth;
+    outGrid.height = gridHeight;
+    outGrid.horizontal.assign(cells, 0.0f);
+    outGrid.vertical.assign(cells, 0.0f);
+
+    // Differences over sample step catch edges between samples too
+    const int step = std::max(sampleStep, 1);
+    for (int gy = 0; gy < gridHeight; gy++) {
+        const int y0 = gy * height / gridHeight;
+        const int y1 = std::min((gy + 1) * height / gridHeight, height - step);
+        for (int gx = 0; gx < gridWidth; gx++) {
+            const int x0 = gx * width / gridWidth;
+            const int x1 = std::min((gx + 1) * width / gridWidth, width - step);
+            int horizontal = 0;
+            int vertical = 0;
+            int samples = 0;
+            for (int y = y0; y < y1; y += step) {
+                const uint8_t* row = luma + static_cast<size_t>(y) * rowStride;
+                const uint8_t* below = row + static_cast<size_t>(step) * rowStride;
+                for (int x = x0; x < x1; x += step) {
+                    horizontal += std::abs(row[x + step] - row[x]);
+                    vertical += std::abs(below[x] - row[x]);
+                    samples++;
+                }
+            }
+            if (samples > 0) {
+                const size_t i = static_cast<size_t>(gy) * gridWidth + gx;
+                outGrid.horizontal[i] = static_cast<float>(horizontal) / samples;
+                outGrid.vertical[i] = static_cast<float>(vertical) / samples;
+            }
+        }
+    }
+}
+
+void ShadingRateMap::updateEdges(const uint8_t* luma, int width, int height, size_t rowStride, int64_t frameNumber)
+{
+    computeEdgeGrid(luma, width, height, rowStride, m_config.edgeGridSize, m_config.edgeGridSize, m_config.edgeSampleStep, m_edgeGrid);
+    m_edgeGrid.frameNumber = frameNumber;
+
+    CellRates& cells = m_cells.getWriteBuffer();
+    const size_t count = m_edgeGrid.horizontal.size();
+    cells.inner.resize(count);
+    cells.outer.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        cells.inner[i] = static_cast<uint8_t>(pickRate(0, m_edgeGrid.horizontal[i], m_edgeGrid.vertical[i]));
+        cells.outer[i] = static_cast<uint8_t>(pickRate(1, m_edgeGrid.horizontal[i], m_edgeGrid.vertical[i]));
+    }
+    cells.valid = true;
+    m_cells.publish();
+    m_edgeGrids++;
+}
+
+ShadingRateMap::Rate ShadingRateMap::pickRate(int level, float horizontal, float vertical) const
+{
+    // Flat content is two levels coarser, moderate detail one level
+    const float detail = std::max(horizontal, vertical);
+    if (detail < m_config.flatThreshold) {
+        level += 2;
+    } else if (detail < m_config.detailThreshold) {
+        level += 1;
+    }
+    level = std::min(level, 2);
+    if (level == 0) {
+        return Rate::Rate1x1;
+    }
+
+    // Directional detail keeps full or half rate across the detail
+    const bool directional = detail >= m_config.flatThreshold;
+    const bool acrossColumns = directional && horizontal > m_config.anisotropy * vertical;
+    const bool acrossRows = directional && vertical > m_config.anisotropy * horizontal;
+    if (level == 1) {
+        return acrossColumns ? Rate::Rate1x2 : (acrossRows ? Rate::Rate2x1 : Rate::Rate2x2);
+    }
+    return acrossColumns ? Rate::Rate2x4 : (acrossRows ? Rate::Rate4x2 : Rate::Rate4x4);
+}
+
+int64_t ShadingRateMap::generateView(View& view, const glm::vec2& focus, const CellRates& cells)
+{
+    const float aspect = static_cast<float>(view.width) / view.height;
+    const float fovealRadius2 = m_config.fovealRadius * m_config.fovealRadius;
+    const float peripheralRadius2 = m_config.peripheralRadius * m_config.peripheralRadius;
+    const float tileH = 2.0f * m_config.tileSize / view.height;
+
+    // Without camera frames all tiles count as detailed, so rates depend on gaze only
+    const CellRates& rates = cells.valid ? cells : m_detailedCells;
+
+    // Rate is picked with selects instead of branches, so that the loop does not mispredict along ring borders.
+    // Sum of block samples is a single add per tile instead of a store to a counter per rate.
+    const uint8_t fullRate = static_cast<uint8_t>(Rate::Rate1x1);
+    const uint8_t hiddenRate = static_cast<uint8_t>(Rate::Rate4x4);
+    int64_t blockSamples = 0;
+    for (int ty = 0; ty < view.tilesY; ty++) {
+        const float ndcY = 1.0f - (ty + 0.5f) * tileH;
+        const float dy = ndcY - focus.y;
+        const float dy2 = dy * dy;
+        const int cellY = std::min(static_cast<int>((1.0f - ndcY) * 0.5f * m_config.edgeGridSize), m_config.edgeGridSize - 1);
+        const uint8_t* innerRow = rates.inner.data() + static_cast<size_t>(cellY) * m_config.edgeGridSize;
+        const uint8_t* outerRow = rates.outer.data() + static_cast<size_t>(cellY) * m_config.edgeGridSize;
+        const size_t rowBegin = static_cast<size_t>(ty) * view.tilesX;
+        for (int tx = 0; tx < view.tilesX; tx++) {
+            const size_t i = rowBegin + tx;
+            const float dx = (view.columnNdc[tx] - focus.x) * aspect;
+            const float distance2 = dx * dx + dy2;
+            const int cell = view.columnCells[tx];
+            uint8_t rate = distance2 > peripheralRadius2 ? outerRow[cell] : innerRow[cell];
+            rate = distance2 < fovealRadius2 ? fullRate : rate;
+            rate = view.occluded[i] ? hiddenRate : rate;
+            view.rates[i] = rate;
+            blockSamples += c_blockSamples[rate];
+        }
+    }
+    return blockSamples;
+}
+
+void ShadingRateMap::generate(const std::vector<glm::vec2>& focusNdc)
+{
+    const int64_t beginNs = getTimestampNs();
+
+    const CellRates& cells = m_cells.read();
+    int64_t blockSamples = 0;
+    size_t tiles = 0;
+    for (size_t i = 0; i < m_views.size(); i++) {
+        const glm::vec2 focus = i < focusNdc.size() ? focusNdc[i] : glm::vec2(0.0f);
+        blockSamples += generateView(m_views[i], focus, cells);
+        tiles += m_views[i].rates.size();
+    }
+
+    const int64_t timeNs = getTimestampNs() - beginNs;
+    m_stats.maps++;
+    m_stats.edgeGrids = m_edgeGrids.load(std::memory_order_relaxed);
+    m_stats.lastTimeNs = timeNs;
+    m_stats.totalTimeNs += timeNs;
+    m_stats.maxTimeNs = std::max(m_stats.maxTimeNs, timeNs);
+    m_stats.shadedFraction = tiles > 0 ? blockSamples / (16.0 * tiles) : 1.0;
+}
+
+bool ShadingRateMap::projectGaze(const varjo_Gaze& gaze, const glm::mat4& projection, glm::vec2& outNdc)
+{
+    if (gaze.status != varjo_GazeStatus_Valid) {
+        return false;
+    }
+
+    // Gaze forward points to +Z, view space forward is -Z. Direction has no translation.
+    const glm::vec4 direction(gaze.gaze.forward[0], gaze.gaze.forward[1], -gaze.gaze.forward[2], 0.0);
+    const glm::vec4 clip = projection * direction;
+    if (clip.w <= 0.0f) {
+        return false;
+    }
+    outNdc = glm::vec2(clip.x, clip.y) / clip.w;
+    return true;
+}
+
+const char* ShadingRateMap::getRateName(Rate rate)
+{
+    switch (rate) {
+        case Rate::Rate1x1: return "1x1";
+        case Rate::Rate1x2: return "1x2";
+        case Rate::Rate2x1: return "2x1";
+        case Rate::Rate2x2: return "2x2";
+        case Rate::Rate2x4: return "2x4";
+        case Rate::Rate4x2: return "4x2";
+        case Rate::Rate4x4: return "4x4";
+        default: return "unknown";
+    }
+}
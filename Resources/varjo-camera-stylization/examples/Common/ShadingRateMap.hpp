@@ -0,0 +1,181 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <atomic>
+
+#include <Varjo.h>
+
+#include "Globals.hpp"
+#include "SnapshotBuffer.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Shading rate map picks a shading rate for every screen tile of every view from three
+// inputs: distance to the gaze point, lens occlusion and amount of detail in the camera image.
+// Tiles in the foveal circle around the gaze point always get full rate. Outside it the rate
+// coarsens with detail level, and one level further in the periphery beyond the outer radius.
+// Tiles covered by the occlusion mesh are never seen and always get the coarsest rate.
+//
+// Detail is estimated from a low resolution grid of mean absolute luma differences of the latest
+// camera frame. Stream thread turns the grid into mid ring and peripheral rates per cell and hands
+// them over through a SnapshotBuffer, so the frame thread only looks rates up per tile. The grid is
+// sampled with view UV directly: camera and view fields of view differ, but a tile rarely moves far
+// enough to change its detail level. Detail mostly in one direction keeps full rate in that
+// direction, so e.g. vertical stripes get 1x2 instead of 2x2.
+//
+// Rates use D3D12_SHADING_RATE encoding (log2 width << 2 | log2 height), one byte per tile with
+// rows from top of the view, so a map can be uploaded to a shading rate image as such.
+
+//! Gaze, occlusion and content adaptive shading rate map generator
+class ShadingRateMap
+{
+public:
+    //! Shading rate in D3D12_SHADING_RATE encoding. Width is horizontal pixels per shaded sample.
+    enum class Rate : uint8_t {
+        Rate1x1 = 0x0,  //!< Full rate
+        Rate1x2 = 0x1,  //!< Half vertical rate
+        Rate2x1 = 0x4,  //!< Half horizontal rate
+        Rate2x2 = 0x5,  //!< Quarter rate
+        Rate2x4 = 0x6,  //!< Half horizontal, quarter vertical rate
+        Rate4x2 = 0x9,  //!< Quarter horizontal, half vertical rate
+        Rate4x4 = 0xA,  //!< Sixteenth rate
+    };
+
+    //! Generator configuration
+    struct Config {
+        int tileSize = 16;              //!< Tile width and height in pixels
+        float fovealRadius = 0.25f;     //!< Full rate radius around gaze point in view NDC units
+        float peripheralRadius = 0.6f;  //!< Radius beyond which rates are one level coarser
+        float detailThreshold = 3.0f;   //!< Mean luma difference from which tile has full detail
+        float flatThreshold = 1.0f;     //!< Mean luma difference below which tile is flat
+        float anisotropy = 2.0f;        //!< Detail ratio from which detail is treated directional
+        int edgeGridSize = 64;          //!< Edge grid width and height in cells
+        int edgeSampleStep = 4;         //!< Luma sample step of edge grid in pixels
+    };
+
+    //! Per cell mean absolute luma differences of camera frame
+    struct EdgeGrid {
+        int width = 0;                  //!< Grid width in cells
+        int height = 0;                 //!< Grid height in cells
+        int64_t frameNumber = -1;       //!< Source stream frame number
+        std::vector<float> horizontal;  //!< Mean difference between horizontal neighbours, detail across columns
+        std::vector<float> vertical;    //!< Mean difference between vertical neighbours, detail across rows
+    };
+
+    //! Generator statistics
+    struct Stats {
+        int64_t maps = 0;             //!< Generated maps, one per generate call
+        int64_t edgeGrids = 0;        //!< Edge grids computed from camera frames
+        int64_t lastTimeNs = 0;       //!< Duration of last generate call
+        int64_t totalTimeNs = 0;      //!< Total duration of generate calls
+        int64_t maxTimeNs = 0;        //!< Longest generate call
+        double shadedFraction = 0.0;  //!< Shaded samples per pixel of last map over all views
+    };
+
+    //! Construct generator for given view count. Set view sizes before generating.
+    ShadingRateMap(const Config& config, int viewCount);
+
+    // Disable copy, move and assign
+    ShadingRateMap(const ShadingRateMap& other) = delete;
+    ShadingRateMap(const ShadingRateMap&& other) = delete;
+    ShadingRateMap& operator=(const ShadingRateMap& other) = delete;
+    ShadingRateMap& operator=(const ShadingRateMap&& other) = delete;
+
+    //! Set view size in pixels. Resizes tile grid and clears occlusion of view.
+    void setViewSize(int viewIndex, int width, int height);
+
+    //! Set occlusion mesh of view from varjo_CreateOcclusionMesh. Tiles fully inside mesh triangles are hidden.
+    //! Pass null to clear occlusion. Returns false if view index is invalid.
+    bool setOcclusionMesh(int viewIndex, const varjo_Mesh2Df* mesh);
+
+    //! Compute edge grid from 8-bit luma plane and publish it to next generate call. Call from one thread only, e.g. stream thread.
+    void updateEdges(const uint8_t* luma, int width, int height, size_t rowStride, int64_t frameNumber);
+
+    //! Generate maps of all views. Focus points are gaze points in view NDC, one per view.
+    //! Call from frame thread only. Does not allocate.
+    void generate(const std::vector<glm::vec2>& focusNdc);
+
+    //! Returns view count
+    int getViewCount() const { return static_cast<int>(m_views.size()); }
+
+    //! Returns tile columns of view
+    int getTilesX(int viewIndex) const { return m_views.at(viewIndex).tilesX; }
+
+    //! Returns tile rows of view
+    int getTilesY(int viewIndex) const { return m_views.at(viewIndex).tilesY; }
+
+    //! Returns rate bytes of view, tilesX * tilesY in row order from top
+    const std::vector<uint8_t>& getRates(int viewIndex) const { return m_views.at(viewIndex).rates; }
+
+    //! Returns rate of given tile
+    Rate getRate(int viewIndex, int tileX, int tileY) const
+    {
+        const View& view = m_views.at(viewIndex);
+        return static_cast<Rate>(view.rates[static_cast<size_t>(tileY) * view.tilesX + tileX]);
+    }
+
+    //! Returns true if tile is hidden by occlusion mesh
+    bool isOccluded(int viewIndex, int tileX, int tileY) const
+    {
+        const View& view = m_views.at(viewIndex);
+        return view.occluded[static_cast<size_t>(tileY) * view.tilesX + tileX] != 0;
+    }
+
+    //! Returns generator statistics
+    const Stats& getStats() const { return m_stats; }
+
+    //! Returns horizontal pixels per shaded sample
+    static int getRateWidth(Rate rate) { return 1 << (static_cast<int>(rate) >> 2); }
+
+    //! Returns vertical pixels per shaded sample
+    static int getRateHeight(Rate rate) { return 1 << (static_cast<int>(rate) & 3); }
+
+    //! Returns rate name, e.g. "2x2"
+    static const char* getRateName(Rate rate);
+
+    //! Project gaze direction to view NDC with view projection. Returns false if gaze is not valid or points behind the view.
+    static bool projectGaze(const varjo_Gaze& gaze, const glm::mat4& projection, glm::vec2& outNdc);
+
+    //! Compute edge grid from 8-bit luma plane
+    static void computeEdgeGrid(const uint8_t* luma, int width, int height, size_t rowStride, int gridWidth, int gridHeight, int sampleStep, EdgeGrid& outGrid);
+
+private:
+    //! Tile grid of one view
+    struct View {
+        int width = 0;                  //!< View width in pixels
+        int height = 0;                 //!< View height in pixels
+        int tilesX = 0;                 //!< Tile columns
+        int tilesY = 0;                 //!< Tile rows
+        std::vector<uint8_t> occluded;  //!< Hidden flag per tile
+        std::vector<uint8_t> rates;     //!< Rate per tile
+        std::vector<float> columnNdc;   //!< Tile center NDC x per column
+        std::vector<int> columnCells;   //!< Edge grid column per tile column
+    };
+
+    //! Rates per edge grid cell, derived from edge grid on stream thread
+    struct CellRates {
+        bool valid = false;          //!< Rates computed from a camera frame
+        std::vector<uint8_t> inner;  //!< Rate between foveal and peripheral radius
+        std::vector<uint8_t> outer;  //!< Rate beyond peripheral radius
+    };
+
+    //! Generate map of one view. Returns sum of shaded samples per 4x4 pixel block over tiles.
+    int64_t generateView(View& view, const glm::vec2& focus, const CellRates& cells);
+
+    //! Pick rate for detail and coarseness level
+    Rate pickRate(int level, float horizontal, float vertical) const;
+
+private:
+    const Config m_config;                //!< Generator configuration
+    std::vector<View> m_views;            //!< Tile grids of views
+    EdgeGrid m_edgeGrid;                  //!< Edge grid being computed, used by stream thread only
+    CellRates m_detailedCells;            //!< Cell rates of all detailed content, used until first camera frame
+    SnapshotBuffer<CellRates> m_cells;    //!< Latest cell rates from stream thread
+    std::atomic<int64_t> m_edgeGrids{0};  //!< Computed edge grids
+    Stats m_stats{};                      //!< Statistics, written by frame thread
+};
+
+}  // namespace VarjoExamples
@@ -0,0 +1,568 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "SharedFrameRing.hpp"
+
+#include <cassert>
+#include <algorithm>
+
+namespace
+{
+// Shared memory identification
+constexpr uint32_t c_ringMagic = 0x56465247;  // 'VFRG'
+constexpr uint32_t c_ringVersion = 1;
+
+// Payload alignment. Page aligned slots keep consumer SIMD loads aligned as well.
+constexpr size_t c_payloadAlignment = 4096;
+
+// Interval for checking dead and stalled consumers
+constexpr int64_t c_reclaimIntervalNs = 100000000;
+
+// Maximum single wait before consumer refreshes its heartbeat
+constexpr int c_heartbeatWaitMs = 100;
+
+// Refcount value marking slot locked for writing by producer
+constexpr int32_t c_writeLocked = -1;
+
+// Consumer states
+enum ConsumerState : uint32_t {
+    ConsumerState_Free = 0,
+    ConsumerState_Registering,
+    ConsumerState_Active,
+    ConsumerState_Slow,
+};
+
+// Round size up to given alignment
+size_t alignUp(size_t size, size_t alignment) { return (size + alignment - 1) / alignment * alignment; }
+
+// Full name of the file mapping object
+std::wstring toMappingName(const std::string& name) { return L"Local\\VarjoFrameRing_" + std::wstring(name.begin(), name.end()); }
+
+}  // namespace
+
+namespace VarjoExamples
+{
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "Shared memory atomics must be lock free");
+
+//! Slot header in shared memory
+struct SharedFrameRing::Slot {
+    std::atomic<int64_t> sequence;  //!< Published sequence number or -1 if not valid
+    std::atomic<int32_t> refCount;  //!< Number of consumer references, c_writeLocked while producer writes
+    uint32_t reserved;              //!< Padding
+    uint64_t dataSize;              //!< Payload size in bytes
+    SharedFrameInfo info;           //!< Frame metadata
+};
+
+//! Consumer state in shared memory
+struct SharedFrameRing::Consumer {
+    std::atomic<uint32_t> state;      //!< Consumer state
+    std::atomic<uint32_t> processId;  //!< Consumer process id
+    std::atomic<int64_t> heartbeat;   //!< Last heartbeat timestamp
+    std::atomic<uint64_t> heldSlots;  //!< Bit mask of slots referenced by this consumer
+};
+
+//! Shared memory header
+struct SharedFrameRing::Header {
+    uint32_t magic;                                  //!< Magic number
+    uint32_t version;                                //!< Layout version
+    int32_t slotCount;                               //!< Number of slots
+    std::atomic<int32_t> closed;                     //!< Producer closed flag
+    uint64_t slotSize;                               //!< Payload capacity of a slot
+    uint64_t slotStride;                             //!< Payload stride of a slot
+    uint64_t payloadOffset;                          //!< Offset of first payload from header
+    std::atomic<int64_t> writeSequence;              //!< Next sequence number to be published
+    std::atomic<int32_t> sequenceSlots[c_maxSlots];  //!< Slot index for each sequence modulo slot count
+    Consumer consumers[c_maxConsumers];              //!< Consumer states
+    Slot slots[c_maxSlots];                          //!< Slot headers
+};
+
+SharedFrameRing::SharedFrameRing(const std::string& name)
+    : m_name(name)
+{
+}
+
+SharedFrameRing::~SharedFrameRing()
+{
+    if (m_header) {
+        UnmapViewOfFile(m_header);
+        m_header = nullptr;
+        m_payload = nullptr;
+    }
+
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+}
+
+int32_t SharedFrameRing::getSlotCount() const { return m_header ? m_header->slotCount : 0; }
+
+size_t SharedFrameRing::getSlotSize() const { return m_header ? static_cast<size_t>(m_header->slotSize) : 0; }
+
+int64_t SharedFrameRing::getTimestamp() { return getTimestampNs(); }
+
+bool SharedFrameRing::create(int32_t slotCount, size_t slotSize)
+{
+    if (slotCount < 2 || slotCount > c_maxSlots) {
+        LOGE("Invalid shared frame ring slot count: %d", slotCount);
+        return false;
+    }
+
+    const size_t payloadOffset = alignUp(sizeof(Header), c_payloadAlignment);
+    const size_t slotStride = alignUp(slotSize, c_payloadAlignment);
+    const uint64_t totalSize = payloadOffset + slotStride * slotCount;
+
+    const std::wstring mappingName = toMappingName(m_name);
+    m_mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(totalSize >> 32),
+        static_cast<DWORD>(totalSize & 0xffffffff), mappingName.c_str());
+    if (m_mapping == nullptr) {
+        LOGE("Creating shared frame ring failed: %s (error %u)", m_name.c_str(), GetLastError());
+        return false;
+    }
+
+    // Another producer owns the ring and consumers may be attached to it, so it must not be reinitialized
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        LOGE("Shared frame ring already exists: %s", m_name.c_str());
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+        return false;
+    }
+
+    m_header = reinterpret_cast<Header*>(MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, static_cast<SIZE_T>(totalSize)));
+    if (m_header == nullptr) {
+        LOGE("Mapping shared frame ring failed: %s (error %u)", m_name.c_str(), GetLastError());
+        return false;
+    }
+
+    // Initialize header in place. Consumers check magic last.
+    new (m_header) Header();
+    m_header->version = c_ringVersion;
+    m_header->slotCount = slotCount;
+    m_header->closed = 0;
+    m_header->slotSize = slotSize;
+    m_header->slotStride = slotStride;
+    m_header->payloadOffset = payloadOffset;
+    m_header->writeSequence = 0;
+    for (int32_t i = 0; i < c_maxSlots; i++) {
+        m_header->sequenceSlots[i] = -1;
+        m_header->slots[i].sequence = -1;
+        m_header->slots[i].refCount = 0;
+        m_header->slots[i].dataSize = 0;
+    }
+    for (auto& consumer : m_header->consumers) {
+        consumer.state = ConsumerState_Free;
+        consumer.processId = 0;
+        consumer.heartbeat = 0;
+        consumer.heldSlots = 0;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    m_header->magic = c_ringMagic;
+
+    m_payload = reinterpret_cast<uint8_t*>(m_header) + payloadOffset;
+
+    LOGI("Shared frame ring created: name=%s, slots=%d, slotSize=%zu, total=%llu bytes", m_name.c_str(), slotCount, slotSize, totalSize);
+    return true;
+}
+
+bool SharedFrameRing::open()
+{
+    const std::wstring mappingName = toMappingName(m_name);
+    m_mapping = OpenFileMappingW(FILE_MAP_ALL_ACCESS, FALSE, mappingName.c_str());
+    if (m_mapping == nullptr) {
+        LOGE("Opening shared frame ring failed: %s (error %u)", m_name.c_str(), GetLastError());
+        return false;
+    }
+
+    // Map whole section
+    m_header = reinterpret_cast<Header*>(MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0));
+    if (m_header == nullptr) {
+        LOGE("Mapping shared frame ring failed: %s (error %u)", m_name.c_str(), GetLastError());
+        return false;
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (m_header->magic != c_ringMagic || m_header->version != c_ringVersion) {
+        LOGE("Shared frame ring not initialized or version mismatch: %s", m_name.c_str());
+        UnmapViewOfFile(m_header);
+        m_header = nullptr;
+        return false;
+    }
+
+    m_payload = reinterpret_cast<uint8_t*>(m_header) + m_header->payloadOffset;
+    return true;
+}
+
+SharedFrameRing::Slot& SharedFrameRing::getSlot(int32_t index) const
+{
+    assert(index >= 0 && index < m_header->slotCount);
+    return m_header->slots[index];
+}
+
+SharedFrameRing::Consumer& SharedFrameRing::getConsumer(int32_t index) const
+{
+    assert(index >= 0 && index < c_maxConsumers);
+    return m_header->consumers[index];
+}
+
+uint8_t* SharedFrameRing::getPayload(int32_t index) const { return m_payload + m_header->slotStride * index; }
+
+std::wstring SharedFrameRing::getEventName(int32_t consumerIndex) const { return toMappingName(m_name) + L"_c" + std::to_wstring(consumerIndex); }
+
+//---------------------------------------------------------------------------
+
+SharedFrameProducer::SharedFrameProducer(const std::string& name, int32_t slotCount, size_t slotSize)
+    : SharedFrameRing(name)
+{
+    if (!create(slotCount, slotSize)) {
+        return;
+    }
+
+    // Create auto reset signal events for all consumer slots up front
+    for (int32_t i = 0; i < c_maxConsumers; i++) {
+        m_events[i] = CreateEventW(nullptr, FALSE, FALSE, getEventName(i).c_str());
+        if (m_events[i] == nullptr) {
+            LOGE("Creating consumer event failed: %d (error %u)", i, GetLastError());
+        }
+    }
+}
+
+SharedFrameProducer::~SharedFrameProducer()
+{
+    close();
+
+    for (auto& event : m_events) {
+        if (event) {
+            CloseHandle(event);
+            event = nullptr;
+        }
+    }
+}
+
+void SharedFrameProducer::close()
+{
+    // Tell consumers we are gone and wake them up
+    if (isValid() && m_header->closed.exchange(1) == 0) {
+        signalConsumers();
+    }
+}
+
+int32_t SharedFrameProducer::acquireWriteSlot()
+{
+    const int32_t slotCount = m_header->slotCount;
+
+    // Round robin from previously written slot so that the oldest unreferenced frame gets overwritten
+    for (int32_t i = 0; i < slotCount; i++) {
+        const int32_t index = (m_nextSlot + i) % slotCount;
+        int32_t expected = 0;
+        if (getSlot(index).refCount.compare_exchange_strong(expected, c_writeLocked, std::memory_order_acquire)) {
+            m_nextSlot = (index + 1) % slotCount;
+            return index;
+        }
+    }
+    return -1;
+}
+
+void SharedFrameProducer::reclaimConsumers()
+{
+    const int64_t now = getTimestamp();
+    m_lastReclaimTime = now;
+
+    m_stats.activeConsumers = 0;
+    m_stats.slowConsumers = 0;
+
+    for (int32_t i = 0; i < c_maxConsumers; i++) {
+        auto& consumer = getConsumer(i);
+        // Registering consumer has not written its process id yet
+        const uint32_t state = consumer.state.load(std::memory_order_acquire);
+        if (state == ConsumerState_Free || state == ConsumerState_Registering) {
+            continue;
+        }
+
+        // Check if consumer process is still alive. Process that can not be opened for other reasons than
+        // not existing, e.g. access rights, is treated as alive.
+        bool alive = true;
+        HANDLE process = OpenProcess(SYNCHRONIZE, FALSE, consumer.processId.load());
+        if (process) {
+            alive = (WaitForSingleObject(process, 0) == WAIT_TIMEOUT);
+            CloseHandle(process);
+        } else {
+            alive = (GetLastError() != ERROR_INVALID_PARAMETER);
+        }
+
+        if (!alive) {
+            // Take over all slot references held by exited consumer
+            const uint64_t held = consumer.heldSlots.exchange(0);
+            for (int32_t s = 0; s < m_header->slotCount; s++) {
+                if (held & (1ull << s)) {
+                    getSlot(s).refCount.fetch_sub(1, std::memory_order_release);
+                    m_stats.reclaimedSlots++;
+                }
+            }
+
+            LOGW("Shared frame consumer %d (pid=%u) died, slots reclaimed: 0x%llx", i, consumer.processId.load(), held);
+            consumer.processId = 0;
+            consumer.state.store(ConsumerState_Free, std::memory_order_release);
+            continue;
+        }
+
+        // Live consumer may still be reading the frames it holds, so stalled consumer is only flagged slow.
+        // Its references are kept, producer drops frames instead if it runs out of slots.
+        const bool stalled = (now - consumer.heartbeat.load(std::memory_order_relaxed)) > m_stallTimeoutNs;
+        if (stalled && consumer.state.exchange(ConsumerState_Slow, std::memory_order_acq_rel) != ConsumerState_Slow) {
+            LOGW("Shared frame consumer %d (pid=%u) stalled, holding slots: 0x%llx", i, consumer.processId.load(), consumer.heldSlots.load());
+        }
+
+        m_stats.activeConsumers++;
+        if (consumer.state.load(std::memory_order_relaxed) == ConsumerState_Slow) {
+            m_stats.slowConsumers++;
+        }
+    }
+}
+
+void SharedFrameProducer::signalConsumers()
+{
+    for (int32_t i = 0; i < c_maxConsumers; i++) {
+        if (m_events[i] && getConsumer(i).state.load(std::memory_order_relaxed) != ConsumerState_Free) {
+            SetEvent(m_events[i]);
+        }
+    }
+}
+
+bool SharedFrameProducer::publish(const SharedFrameInfo& info, const void* data, size_t dataSize)
+{
+    if (!isValid() || m_header->closed.load(std::memory_order_relaxed) != 0) {
+        return false;
+    }
+
+    if (dataSize > m_header->slotSize) {
+        m_stats.droppedTooLarge++;
+        return false;
+    }
+
+    // Periodically check consumer health
+    if (getTimestamp() - m_lastReclaimTime > c_reclaimIntervalNs) {
+        reclaimConsumers();
+    }
+
+    int32_t slotIndex = acquireWriteSlot();
+    if (slotIndex < 0) {
+        // Every slot is referenced. Check for dead consumers once more before dropping.
+        reclaimConsumers();
+        slotIndex = acquireWriteSlot();
+        if (slotIndex < 0) {
+            m_stats.droppedNoSlot++;
+            return false;
+        }
+    }
+
+    auto& slot = getSlot(slotIndex);
+    slot.sequence.store(-1, std::memory_order_relaxed);
+
+    // The only copy: from stream buffer to shared memory
+    if (data && dataSize > 0) {
+        memcpy(getPayload(slotIndex), data, dataSize);
+    }
+    slot.dataSize = dataSize;
+    slot.info = info;
+    slot.info.publishTime = getTimestamp();
+
+    // Publish slot. Sequence and slot mapping must be visible before write sequence advances.
+    const int64_t sequence = m_header->writeSequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence, std::memory_order_release);
+    m_header->sequenceSlots[sequence % m_header->slotCount].store(slotIndex, std::memory_order_release);
+    slot.refCount.store(0, std::memory_order_release);
+    m_header->writeSequence.store(sequence + 1, std::memory_order_release);
+
+    m_stats.published++;
+
+    signalConsumers();
+    return true;
+}
+
+bool SharedFrameProducer::publish(const DataStreamer::Frame& frame)
+{
+    if (frame.cpuData == nullptr) {
+        return false;
+    }
+
+    SharedFrameInfo info;
+    info.type = frame.type;
+    info.channelIndex = frame.channelIndex;
+    info.frameNumber = frame.frameNumber;
+    info.hmdPose = frame.hmdPose;
+    info.metadata = frame.metadata;
+    info.intrinsics = frame.intrinsics;
+    info.extrinsics = frame.extrinsics;
+    info.buffer = frame.buffer;
+
+    return publish(info, frame.cpuData, static_cast<size_t>(frame.buffer.byteSize));
+}
+
+SharedFrameProducer::Stats SharedFrameProducer::getStats() const { return m_stats; }
+
+//---------------------------------------------------------------------------
+
+SharedFrameConsumer::SharedFrameConsumer(const std::string& name)
+    : SharedFrameRing(name)
+{
+    if (!open()) {
+        return;
+    }
+
+    // Register to free consumer slot. Slot is published active only after process id and heartbeat are
+    // written, so producer never checks a consumer without process.
+    for (int32_t i = 0; i < c_maxConsumers; i++) {
+        auto& consumer = getConsumer(i);
+        uint32_t expected = ConsumerState_Free;
+        if (consumer.state.compare_exchange_strong(expected, ConsumerState_Registering)) {
+            consumer.processId = GetCurrentProcessId();
+            consumer.heartbeat = getTimestamp();
+            consumer.heldSlots = 0;
+            consumer.state.store(ConsumerState_Active, std::memory_order_release);
+            m_consumerIndex = i;
+            break;
+        }
+    }
+
+    if (m_consumerIndex < 0) {
+        LOGE("Shared frame ring has no free consumer slots: %s", m_name.c_str());
+        return;
+    }
+
+    m_event = OpenEventW(SYNCHRONIZE, FALSE, getEventName(m_consumerIndex).c_str());
+    if (m_event == nullptr) {
+        LOGE("Opening consumer event failed: %d (error %u)", m_consumerIndex, GetLastError());
+    }
+
+    // Start from next published frame
+    m_readSequence = m_header->writeSequence.load(std::memory_order_acquire);
+
+    LOGI("Attached to shared frame ring: name=%s, consumer=%d", m_name.c_str(), m_consumerIndex);
+}
+
+SharedFrameConsumer::~SharedFrameConsumer()
+{
+    if (isAttached()) {
+        auto& consumer = getConsumer(m_consumerIndex);
+
+        // Drop all references we still hold
+        const uint64_t held = consumer.heldSlots.exchange(0);
+        for (int32_t s = 0; s < m_header->slotCount; s++) {
+            if (held & (1ull << s)) {
+                getSlot(s).refCount.fetch_sub(1, std::memory_order_release);
+            }
+        }
+
+        consumer.processId = 0;
+        consumer.state.store(ConsumerState_Free, std::memory_order_release);
+        m_consumerIndex = -1;
+    }
+
+    if (m_event) {
+        CloseHandle(m_event);
+        m_event = nullptr;
+    }
+}
+
+bool SharedFrameConsumer::isClosed() const { return !isValid() || m_header->closed.load(std::memory_order_acquire) != 0; }
+
+bool SharedFrameConsumer::tryAcquire(int64_t sequence, FrameRef& frame)
+{
+    const int32_t slotIndex = m_header->sequenceSlots[sequence % m_header->slotCount].load(std::memory_order_acquire);
+    if (slotIndex < 0) {
+        return false;
+    }
+
+    // Take reference unless producer is writing the slot
+    auto& slot = getSlot(slotIndex);
+    int32_t refCount = slot.refCount.load(std::memory_order_relaxed);
+    do {
+        if (refCount < 0) {
+            return false;
+        }
+    } while (!slot.refCount.compare_exchange_weak(refCount, refCount + 1, std::memory_order_acquire));
+
+    auto& consumer = getConsumer(m_consumerIndex);
+    const uint64_t bit = 1ull << slotIndex;
+    consumer.heldSlots.fetch_or(bit);
+
+    // Slot might have been recycled for newer frame before we got the reference
+    if (slot.sequence.load(std::memory_order_acquire) != sequence) {
+        if (consumer.heldSlots.fetch_and(~bit) & bit) {
+            slot.refCount.fetch_sub(1, std::memory_order_release);
+        }
+        return false;
+    }
+
+    frame.slot = slotIndex;
+    frame.sequence = sequence;
+    frame.info = &slot.info;
+    frame.data = getPayload(slotIndex);
+    frame.dataSize = static_cast<size_t>(slot.dataSize);
+    return true;
+}
+
+bool SharedFrameConsumer::acquire(FrameRef& frame, int timeoutMs)
+{
+    if (!isAttached()) {
+        return false;
+    }
+
+    auto& consumer = getConsumer(m_consumerIndex);
+    const int64_t slotCount = m_header->slotCount;
+    const int64_t startTime = getTimestamp();
+
+    while (!isClosed()) {
+        consumer.heartbeat.store(getTimestamp(), std::memory_order_relaxed);
+
+        const int64_t writeSequence = m_header->writeSequence.load(std::memory_order_acquire);
+
+        // Jump to latest frame if we have fallen more than a full ring behind
+        if (writeSequence - m_readSequence > slotCount) {
+            const int64_t missed = writeSequence - 1 - m_readSequence;
+            m_stats.skipped += missed;
+            m_readSequence = writeSequence - 1;
+            consumer.state.store(ConsumerState_Slow, std::memory_order_relaxed);
+        } else {
+            consumer.state.store(ConsumerState_Active, std::memory_order_relaxed);
+        }
+
+        while (m_readSequence < writeSequence) {
+            const int64_t sequence = m_readSequence++;
+            if (tryAcquire(sequence, frame)) {
+                const double latencyMs = static_cast<double>(getTimestamp() - frame.info->publishTime) * 1e-6;
+                m_stats.received++;
+                m_stats.latencyAvgMs += (latencyMs - m_stats.latencyAvgMs) / static_cast<double>(m_stats.received);
+                m_stats.latencyMaxMs = (std::max)(m_stats.latencyMaxMs, latencyMs);
+                return true;
+            }
+            m_stats.skipped++;
+        }
+
+        // Wait for producer signal in short steps to keep heartbeat fresh
+        const int elapsedMs = static_cast<int>((getTimestamp() - startTime) / 1000000);
+        if (elapsedMs >= timeoutMs) {
+            break;
+        }
+        WaitForSingleObject(m_event, static_cast<DWORD>((std::min)(timeoutMs - elapsedMs, c_heartbeatWaitMs)));
+    }
+
+    return false;
+}
+
+void SharedFrameConsumer::release(FrameRef& frame)
+{
+    if (!isAttached() || frame.slot < 0) {
+        return;
+    }
+
+    // Only drop reference if producer has not reclaimed it already
+    const uint64_t bit = 1ull << frame.slot;
+    if (getConsumer(m_consumerIndex).heldSlots.fetch_and(~bit) & bit) {
+        getSlot(frame.slot).refCount.fetch_sub(1, std::memory_order_release);
+    }
+
+    getConsumer(m_consumerIndex).heartbeat.store(getTimestamp(), std::memory_order_relaxed);
+    frame = {};
+}
+
+}  // namespace VarjoExamples
@@ -0,0 +1,208 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <string>
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include <Varjo_types_datastream.h>
+
+#include "Globals.hpp"
+#include "DataStreamer.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! The ring lives in a named shared memory section (file mapping) and frame availability is
+// signalled with one named auto-reset event per consumer. Producer never waits for consumers: frames
+// are dropped instead if no slot is free, so the process owning the Varjo session never stalls.
+// Slot references are reclaimed only from consumer processes that have exited. Consumers that stop
+// sending heartbeats are flagged slow but keep their references, so a frame is never overwritten
+// while a live consumer reads it.
+
+//! Frame metadata stored in shared memory next to each slot payload.
+struct SharedFrameInfo {
+    varjo_StreamType type = 0;                                   //!< Stream type
+    varjo_ChannelIndex channelIndex = varjo_ChannelIndex_First;  //!< Channel index
+    int64_t frameNumber = 0;                                     //!< Stream frame number
+    varjo_Matrix hmdPose{};                                      //!< HMD world pose
+    varjo_StreamFrameMetadata metadata{};                        //!< Stream specific metadata
+    varjo_CameraIntrinsics intrinsics{};                         //!< Camera intrinsics (if available)
+    varjo_Matrix extrinsics{};                                   //!< Camera extrinsics (if available)
+    varjo_BufferMetadata buffer{};                               //!< Buffer metadata for slot payload
+    int64_t publishTime = 0;                                     //!< Publish timestamp in nanoseconds (system wide clock)
+};
+
+//! Base class for mapping a shared frame ring into this process
+class SharedFrameRing
+{
+public:
+    //! Maximum number of simultaneous consumer processes
+    static constexpr int32_t c_maxConsumers = 8;
+
+    //! Maximum number of frame slots
+    static constexpr int32_t c_maxSlots = 64;
+
+    //! Destructor. Unmaps the shared memory.
+    virtual ~SharedFrameRing();
+
+    // Disable copy, move and assign
+    SharedFrameRing(const SharedFrameRing& other) = delete;
+    SharedFrameRing(const SharedFrameRing&& other) = delete;
+    SharedFrameRing& operator=(const SharedFrameRing& other) = delete;
+    SharedFrameRing& operator=(const SharedFrameRing&& other) = delete;
+
+    //! Returns true if ring is mapped
+    bool isValid() const { return m_header != nullptr; }
+
+    //! Returns number of slots in ring
+    int32_t getSlotCount() const;
+
+    //! Returns payload capacity of single slot in bytes
+    size_t getSlotSize() const;
+
+    //! Returns system wide timestamp in nanoseconds used for latency measurements
+    static int64_t getTimestamp();
+
+protected:
+    //! Shared memory layout. Defined in implementation.
+    struct Header;
+    struct Slot;
+    struct Consumer;
+
+    //! Protected constructor
+    SharedFrameRing(const std::string& name);
+
+    //! Create new shared memory ring. Fails if ring of same name already exists.
+    bool create(int32_t slotCount, size_t slotSize);
+
+    //! Open existing shared memory ring
+    bool open();
+
+    //! Returns slot header for given index
+    Slot& getSlot(int32_t index) const;
+
+    //! Returns consumer state for given index
+    Consumer& getConsumer(int32_t index) const;
+
+    //! Returns payload pointer for given slot index
+    uint8_t* getPayload(int32_t index) const;
+
+    //! Returns name of the consumer signal event
+    std::wstring getEventName(int32_t consumerIndex) const;
+
+protected:
+    std::string m_name;            //!< Ring name
+    HANDLE m_mapping = nullptr;    //!< File mapping handle
+    Header* m_header = nullptr;    //!< Mapped shared memory
+    uint8_t* m_payload = nullptr;  //!< Start of slot payload area
+};
+
+//! Producer side of shared frame ring. Only one producer per ring.
+class SharedFrameProducer final : public SharedFrameRing
+{
+public:
+    //! Producer statistics
+    struct Stats {
+        int64_t published = 0;        //!< Published frames
+        int64_t droppedNoSlot = 0;    //!< Frames dropped because every slot was referenced
+        int64_t droppedTooLarge = 0;  //!< Frames dropped because payload did not fit in slot
+        int64_t reclaimedSlots = 0;   //!< Slot references reclaimed from exited consumers
+        int32_t activeConsumers = 0;  //!< Currently attached consumers
+        int32_t slowConsumers = 0;    //!< Currently attached consumers flagged slow
+    };
+
+    //! Create producer and shared memory ring
+    SharedFrameProducer(const std::string& name, int32_t slotCount, size_t slotSize);
+
+    //! Destructor. Closes ring.
+    ~SharedFrameProducer();
+
+    //! Publish frame to ring. Copies given data once into shared memory. Returns false if frame was dropped.
+    bool publish(const SharedFrameInfo& info, const void* data, size_t dataSize);
+
+    //! Publish data streamer frame. Can be called directly from a DataStreamer frame listener.
+    bool publish(const DataStreamer::Frame& frame);
+
+    //! Mark ring closed and wake up consumers. Frames are not published after this.
+    void close();
+
+    //! Set time after which a consumer missing heartbeats is flagged slow
+    void setStallTimeout(double seconds) { m_stallTimeoutNs = static_cast<int64_t>(seconds * 1e9); }
+
+    //! Returns producer statistics
+    Stats getStats() const;
+
+private:
+    //! Find next free slot and lock it for writing. Returns -1 if not found.
+    int32_t acquireWriteSlot();
+
+    //! Check consumers, reclaim slot references held by exited ones and flag stalled ones slow
+    void reclaimConsumers();
+
+    //! Wake up consumers waiting for frames
+    void signalConsumers();
+
+private:
+    std::array<HANDLE, c_maxConsumers> m_events{};  //!< Consumer signal events
+    int32_t m_nextSlot = 0;                         //!< Round robin slot search start
+    int64_t m_stallTimeoutNs = 2000000000;          //!< Consumer heartbeat timeout
+    int64_t m_lastReclaimTime = 0;                  //!< Last consumer check timestamp
+    Stats m_stats{};                                //!< Producer statistics
+};
+
+//! Consumer side of shared frame ring. Frames are accessed in place without copying.
+class SharedFrameConsumer final : public SharedFrameRing
+{
+public:
+    //! Frame reference valid until released
+    struct FrameRef {
+        int32_t slot = -1;                      //!< Slot index
+        int64_t sequence = -1;                  //!< Ring sequence number
+        const SharedFrameInfo* info = nullptr;  //!< Frame metadata
+        const uint8_t* data = nullptr;          //!< Frame payload in shared memory
+        size_t dataSize = 0;                    //!< Payload size in bytes
+    };
+
+    //! Consumer statistics
+    struct Stats {
+        int64_t received = 0;       //!< Frames acquired
+        int64_t skipped = 0;        //!< Frames missed because consumer was too slow
+        double latencyAvgMs = 0.0;  //!< Running average publish-to-acquire latency
+        double latencyMaxMs = 0.0;  //!< Maximum publish-to-acquire latency
+    };
+
+    //! Attach to existing ring. Check isAttached() for success.
+    SharedFrameConsumer(const std::string& name);
+
+    //! Destructor. Releases held frames and detaches from ring.
+    ~SharedFrameConsumer();
+
+    //! Returns true if consumer was attached successfully
+    bool isAttached() const { return m_consumerIndex >= 0; }
+
+    //! Wait for and acquire next frame. Skips to latest frame if consumer has fallen behind.
+    bool acquire(FrameRef& frame, int timeoutMs);
+
+    //! Release acquired frame back to producer
+    void release(FrameRef& frame);
+
+    //! Returns true if producer has closed the ring
+    bool isClosed() const;
+
+    //! Returns consumer statistics
+    const Stats& getStats() const { return m_stats; }
+
+private:
+    //! Try to acquire frame with given sequence number
+    bool tryAcquire(int64_t sequence, FrameRef& frame);
+
+private:
+    int32_t m_consumerIndex = -1;  //!< Consumer slot in shared header
+    HANDLE m_event = nullptr;      //!< Signal event
+    int64_t m_readSequence = 0;    //!< Next sequence to read
+    Stats m_stats{};               //!< Consumer statistics
+};
+
+}  // namespace VarjoExamples
@@ -0,0 +1,244 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <smmintrin.h>
+#include <immintrin.h>
+
+// Thin SIMD wrappers for writing CPU image kernels once as templates and instantiating
+// them for each instruction set. All variants expose the same static interface:
+//
+//   Float      Vector of c_width floats
+//   Mask       Comparison result usable with select()
+//
+// NOTICE! AVX2 variant is compiled unconditionally, callers must check CPU support at runtime
+// before dispatching to it (see isSimdLevelSupported).
+//
+// Intermediate buffers can be stored as Half instead of float: load and store convert and all
+// arithmetic stays float. SSE 4.1 and AVX2 variants convert with F16C, which callers must also
+// check at runtime. Scalar variant converts in software with the same rounding, so results do
+// not depend on the variant used.
+
+namespace VarjoExamples
+{
+namespace Simd
+{
+//! IEEE 754 binary16 storage element
+struct Half {
+    uint16_t bits;  //!< Sign, 5-bit exponent and 10-bit mantissa
+};
+
+//! Convert float to half, rounding to nearest even like F16C
+inline Half floatToHalf(float value)
+{
+    uint32_t f;
+    std::memcpy(&f, &value, sizeof(f));
+    const uint16_t sign = static_cast<uint16_t>((f >> 16) & 0x8000);
+    f &= 0x7fffffff;
+
+    if (f >= 0x477ff000) {
+        // Infinity, NaN or value rounding above largest half
+        return Half{static_cast<uint16_t>(sign | (f > 0x7f800000 ? 0x7e00 : 0x7c00))};
+    }
+    if (f < 0x38800000) {
+        // Subnormal half: let float addition do the rounding
+        float magnitude;
+        std::memcpy(&magnitude, &f, sizeof(f));
+        magnitude += 0.5f;
+        uint32_t rounded;
+        std::memcpy(&rounded, &magnitude, sizeof(rounded));
+        return Half{static_cast<uint16_t>(sign | (rounded - 0x3f000000))};
+    }
+
+    // Normal half: rebias exponent and round mantissa to nearest even
+    f += 0xc8000fff + ((f >> 13) & 1);
+    return Half{static_cast<uint16_t>(sign | (f >> 13))};
+}
+
+//! Convert half to float
+inline float halfToFloat(Half value)
+{
+    const uint32_t sign = static_cast<uint32_t>(value.bits & 0x8000) << 16;
+    const uint32_t exponent = (value.bits >> 10) & 0x1f;
+    const uint32_t mantissa = value.bits & 0x3ff;
+
+    uint32_t f;
+    if (exponent == 0) {
+        // Zero or subnormal, exact in float
+        const float magnitude = static_cast<float>(mantissa) * (1.0f / 16777216.0f);
+        std::memcpy(&f, &magnitude, sizeof(f));
+        f |= sign;
+    } else if (exponent == 0x1f) {
+        f = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        f = sign | ((exponent + 112) << 23) | (mantissa << 13);
+    }
+
+    float result;
+    std::memcpy(&result, &f, sizeof(result));
+    return result;
+}
+
+//! Plain C++ single lane variant
+struct Scalar {
+    using Float = float;
+    using Mask = bool;
+    static constexpr int c_width = 1;
+
+    static Float load(const float* p) { return *p; }
+    static void store(float* p, Float v) { *p = v; }
+    static Float load(const Half* p) { return halfToFloat(*p); }
+    static void store(Half* p, Float v) { *p = floatToHalf(v); }
+    static Float set1(float v) { return v; }
+    static Float zero() { return 0.0f; }
+    static Float add(Float a, Float b) { return a + b; }
+    static Float sub(Float a, Float b) { return a - b; }
+    static Float mul(Float a, Float b) { return a * b; }
+    static Float div(Float a, Float b) { return a / b; }
+    static Float madd(Float a, Float b, Float c) { return a * b + c; }
+    static Float min(Float a, Float b) { return std::min(a, b); }
+    static Float max(Float a, Float b) { return std::max(a, b); }
+    static Float abs(Float a) { return std::fabs(a); }
+    static Float sqrt(Float a) { return std::sqrt(a); }
+    static Float round(Float a) { return std::floor(a + 0.5f); }
+    static Mask cmplt(Float a, Float b) { return a < b; }
+    static Mask cmpgt(Float a, Float b) { return a > b; }
+    static Mask cmpge(Float a, Float b) { return a >= b; }
+    static Mask maskAnd(Mask a, Mask b) { return a && b; }
+    static Float select(Mask m, Float a, Float b) { return m ? a : b; }
+    static int movemask(Mask m) { return m ? 1 : 0; }
+
+    //! Load one RGBA8 pixel as normalized floats
+    static void loadRGBA(const uint8_t* p, Float& r, Float& g, Float& b)
+    {
+        constexpr float scale = 1.0f / 255.0f;
+        r = p[0] * scale;
+        g = p[1] * scale;
+        b = p[2] * scale;
+    }
+
+    //! Store one normalized RGB pixel as opaque RGBA8
+    static void storeRGBA(uint8_t* p, Float r, Float g, Float b)
+    {
+        p[0] = static_cast<uint8_t>(std::max(0.0f, std::min(1.0f, r)) * 255.0f + 0.5f);
+        p[1] = static_cast<uint8_t>(std::max(0.0f, std::min(1.0f, g)) * 255.0f + 0.5f);
+        p[2] = static_cast<uint8_t>(std::max(0.0f, std::min(1.0f, b)) * 255.0f + 0.5f);
+        p[3] = 255;
+    }
+};
+
+//! 4-wide SSE 4.1 variant
+struct SSE41 {
+    using Float = __m128;
+    using Mask = __m128;
+    static constexpr int c_width = 4;
+
+    static Float load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, Float v) { _mm_storeu_ps(p, v); }
+    static Float load(const Half* p) { return _mm_cvtph_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p))); }
+    static void store(Half* p, Float v) { _mm_storel_epi64(reinterpret_cast<__m128i*>(p), _mm_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT)); }
+    static Float set1(float v) { return _mm_set1_ps(v); }
+    static Float zero() { return _mm_setzero_ps(); }
+    static Float add(Float a, Float b) { return _mm_add_ps(a, b); }
+    static Float sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+    static Float mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+    static Float div(Float a, Float b) { return _mm_div_ps(a, b); }
+    static Float madd(Float a, Float b, Float c) { return _mm_add_ps(_mm_mul_ps(a, b), c); }
+    static Float min(Float a, Float b) { return _mm_min_ps(a, b); }
+    static Float max(Float a, Float b) { return _mm_max_ps(a, b); }
+    static Float abs(Float a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+    static Float sqrt(Float a) { return _mm_sqrt_ps(a); }
+    static Float round(Float a) { return _mm_floor_ps(_mm_add_ps(a, _mm_set1_ps(0.5f))); }
+    static Mask cmplt(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+    static Mask cmpgt(Float a, Float b) { return _mm_cmpgt_ps(a, b); }
+    static Mask cmpge(Float a, Float b) { return _mm_cmpge_ps(a, b); }
+    static Mask maskAnd(Mask a, Mask b) { return _mm_and_ps(a, b); }
+    static Float select(Mask m, Float a, Float b) { return _mm_blendv_ps(b, a, m); }
+    static int movemask(Mask m) { return _mm_movemask_ps(m); }
+
+    //! Load four RGBA8 pixels as normalized floats
+    static void loadRGBA(const uint8_t* p, Float& r, Float& g, Float& b)
+    {
+        const __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const __m128i mask = _mm_set1_epi32(0xff);
+        const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+        r = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(px, mask)), scale);
+        g = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 8), mask)), scale);
+        b = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(px, 16), mask)), scale);
+    }
+
+    //! Store four normalized RGB pixels as opaque RGBA8
+    static void storeRGBA(uint8_t* p, Float r, Float g, Float b)
+    {
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 scale = _mm_set1_ps(255.0f);
+        const __m128 half = _mm_set1_ps(0.5f);
+        const __m128i ri = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_max_ps(_mm_setzero_ps(), _mm_min_ps(one, r)), scale), half));
+        const __m128i gi = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_max_ps(_mm_setzero_ps(), _mm_min_ps(one, g)), scale), half));
+        const __m128i bi = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(_mm_max_ps(_mm_setzero_ps(), _mm_min_ps(one, b)), scale), half));
+        const __m128i px = _mm_or_si128(_mm_or_si128(ri, _mm_slli_epi32(gi, 8)), _mm_or_si128(_mm_slli_epi32(bi, 16), _mm_set1_epi32(0xff000000)));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), px);
+    }
+};
+
+//! 8-wide AVX2 + FMA variant
+struct AVX2 {
+    using Float = __m256;
+    using Mask = __m256;
+    static constexpr int c_width = 8;
+
+    static Float load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, Float v) { _mm256_storeu_ps(p, v); }
+    static Float load(const Half* p) { return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))); }
+    static void store(Half* p, Float v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT)); }
+    static Float set1(float v) { return _mm256_set1_ps(v); }
+    static Float zero() { return _mm256_setzero_ps(); }
+    static Float add(Float a, Float b) { return _mm256_add_ps(a, b); }
+    static Float sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+    static Float mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+    static Float div(Float a, Float b) { return _mm256_div_ps(a, b); }
+    static Float madd(Float a, Float b, Float c) { return _mm256_fmadd_ps(a, b, c); }
+    static Float min(Float a, Float b) { return _mm256_min_ps(a, b); }
+    static Float max(Float a, Float b) { return _mm256_max_ps(a, b); }
+    static Float abs(Float a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+    static Float sqrt(Float a) { return _mm256_sqrt_ps(a); }
+    static Float round(Float a) { return _mm256_floor_ps(_mm256_add_ps(a, _mm256_set1_ps(0.5f))); }
+    static Mask cmplt(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static Mask cmpgt(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static Mask cmpge(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GE_OQ); }
+    static Mask maskAnd(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+    static Float select(Mask m, Float a, Float b) { return _mm256_blendv_ps(b, a, m); }
+    static int movemask(Mask m) { return _mm256_movemask_ps(m); }
+
+    //! Load eight RGBA8 pixels as normalized floats
+    static void loadRGBA(const uint8_t* p, Float& r, Float& g, Float& b)
+    {
+        const __m256i px = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const __m256i mask = _mm256_set1_epi32(0xff);
+        const __m256 scale = _mm256_set1_ps(1.0f / 255.0f);
+        r = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(px, mask)), scale);
+        g = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 8), mask)), scale);
+        b = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(px, 16), mask)), scale);
+    }
+
+    //! Store eight normalized RGB pixels as opaque RGBA8
+    static void storeRGBA(uint8_t* p, Float r, Float g, Float b)
+    {
+        const __m256 one = _mm256_set1_ps(1.0f);
+        const __m256 scale = _mm256_set1_ps(255.0f);
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256i ri = _mm256_cvttps_epi32(_mm256_fmadd_ps(_mm256_max_ps(_mm256_setzero_ps(), _mm256_min_ps(one, r)), scale, half));
+        const __m256i gi = _mm256_cvttps_epi32(_mm256_fmadd_ps(_mm256_max_ps(_mm256_setzero_ps(), _mm256_min_ps(one, g)), scale, half));
+        const __m256i bi = _mm256_cvttps_epi32(_mm256_fmadd_ps(_mm256_max_ps(_mm256_setzero_ps(), _mm256_min_ps(one, b)), scale, half));
+        const __m256i px =
+            _mm256_or_si256(_mm256_or_si256(ri, _mm256_slli_epi32(gi, 8)), _mm256_or_si256(_mm256_slli_epi32(bi, 16), _mm256_set1_epi32(0xff000000)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), px);
+    }
+};
+
+}  // namespace Simd
+}  // namespace VarjoExamples
@@ -0,0 +1,73 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <atomic>
+
+#include "Globals.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Snapshot buffer passes latest state from one writer thread to one reader thread, e.g.
+// status from frame loop to UI thread. Writer fills its own buffer and reader reads its own, so
+// both work on a buffer nobody else touches. A third buffer is held in between: publishing swaps
+// the filled buffer with it, and reading swaps it out when it holds a newer snapshot. With only
+// two buffers the writer would have to wait until the reader is done before it could publish.
+//
+// Reader always gets a complete snapshot, but intermediate snapshots are skipped if the writer
+// publishes faster than the reader reads. Use CommandQueue for data that must not be lost.
+
+//! Lock-free latest value exchange between one writer and one reader thread
+template <typename T>
+class SnapshotBuffer
+{
+public:
+    //! Constructor
+    SnapshotBuffer() = default;
+
+    // Disable copy, move and assign
+    SnapshotBuffer(const SnapshotBuffer& other) = delete;
+    SnapshotBuffer(const SnapshotBuffer&& other) = delete;
+    SnapshotBuffer& operator=(const SnapshotBuffer& other) = delete;
+    SnapshotBuffer& operator=(const SnapshotBuffer&& other) = delete;
+
+    //! Returns buffer to fill for next snapshot. Call from writer thread only. Buffer has contents of
+    //! some earlier snapshot, so overwrite all fields.
+    T& getWriteBuffer() { return m_buffers[m_writeIndex]; }
+
+    //! Publish filled write buffer. Call from writer thread only.
+    void publish()
+    {
+        m_writeIndex = m_middle.exchange(m_writeIndex | c_freshFlag, std::memory_order_acq_rel) & c_indexMask;
+        m_published.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    //! Returns latest published snapshot. Call from reader thread only. Reference stays valid until next read.
+    const T& read()
+    {
+        if (m_middle.load(std::memory_order_relaxed) & c_freshFlag) {
+            m_readIndex = m_middle.exchange(m_readIndex, std::memory_order_acq_rel) & c_indexMask;
+        }
+        return m_buffers[m_readIndex];
+    }
+
+    //! Returns number of published snapshots
+    int64_t getPublishedCount() const { return m_published.load(std::memory_order_relaxed); }
+
+private:
+    //! Middle buffer holds snapshot not yet read
+    static constexpr int c_freshFlag = 4;
+
+    //! Mask of buffer index in middle
+    static constexpr int c_indexMask = 3;
+
+    std::array<T, 3> m_buffers{};         //!< Write, middle and read buffers
+    int m_writeIndex = 0;                 //!< Writer buffer index
+    std::atomic<int> m_middle{1};         //!< Middle buffer index and fresh flag
+    int m_readIndex = 2;                  //!< Reader buffer index
+    std::atomic<int64_t> m_published{0};  //!< Published snapshot count
+};
+
+}  // namespace VarjoExamples
@@ -0,0 +1,77 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+
+namespace VarjoExamples
+{
+//! Spectator stream wire format shared by server and clients
+namespace SpectatorProtocol
+{
+// NOTICE! Frames are sent as one or more packets. Each packet carries a header followed by a number
+// of changed tiles, so the same packets can be written to a TCP stream or sent as UDP datagrams.
+// Over UDP a lost packet only leaves its tiles stale until they change again or are refreshed.
+
+//! Default server port
+constexpr uint16_t c_defaultPort = 27150;
+
+//! Packet magic 'VSPS'
+constexpr uint32_t c_magic = 0x53505356;
+
+//! Maximum packet size including headers. Fits in single UDP datagram.
+constexpr uint32_t c_maxPacketSize = 60000;
+
+//! Maximum tile size in pixels. Worst case encoded tile must fit in packet.
+constexpr int c_maxTileSize = 96;
+
+//! Socket transport
+enum class Transport { TCP = 0, UDP };
+
+//! Packet types
+enum class PacketType : uint8_t {
+    Frame = 0,  //!< Server to client frame tiles
+    Hello = 1,  //!< Client to server registration/keepalive (UDP only)
+};
+
+//! Tile encoding
+enum class TileEncoding : uint8_t {
+    Raw = 0,  //!< Uncompressed RGBA8 rows
+    QOI = 1,  //!< TileCodec encoded
+};
+
+#pragma pack(push, 1)
+
+//! Packet header
+struct PacketHeader {
+    uint32_t magic;        //!< Packet magic
+    uint8_t type;          //!< Packet type
+    uint8_t viewIndex;     //!< View index
+    uint16_t tileSize;     //!< Tile size in pixels
+    uint16_t width;        //!< Frame width
+    uint16_t height;       //!< Frame height
+    uint16_t packetIndex;  //!< Packet index within frame
+    uint16_t packetCount;  //!< Packet count for frame
+    uint16_t tileCount;    //!< Number of tiles in this packet
+    uint16_t flags;        //!< Packet flags
+    int64_t frameNumber;   //!< Frame number
+    int64_t captureTime;   //!< Capture timestamp in nanoseconds
+    uint32_t payloadSize;  //!< Payload bytes following header
+};
+
+//! Tile header preceding each tile payload
+struct TileHeader {
+    uint16_t tileX;    //!< Tile column
+    uint16_t tileY;    //!< Tile row
+    uint8_t encoding;  //!< Tile encoding
+    uint8_t reserved;  //!< Reserved
+    uint32_t size;     //!< Encoded tile size in bytes
+};
+
+#pragma pack(pop)
+
+//! Packet flag for frames containing every tile
+constexpr uint16_t c_flagFullFrame = 1 << 0;
+
+}  // namespace SpectatorProtocol
+}  // namespace VarjoExamples
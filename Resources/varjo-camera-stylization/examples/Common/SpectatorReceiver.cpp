@@ -0,0 +1,309 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+// Winsock headers must be included before windows.h
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include "SpectatorReceiver.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "TileCodec.hpp"
+
+using namespace VarjoExamples::SpectatorProtocol;
+
+namespace
+{
+// Hello interval for UDP keepalive
+constexpr int64_t c_helloIntervalNs = 1000000000;
+
+// Statistics window length
+constexpr int64_t c_statsWindowNs = 1000000000;
+
+// Smoothing factor for averages
+constexpr double c_statsSmoothing = 0.05;
+
+// Socket receive buffer size
+constexpr int c_recvBufferSize = 4 * 1024 * 1024;
+
+//! Parsed tile reference
+struct TileRef {
+    TileHeader header;    //!< Tile header
+    const uint8_t* data;  //!< Tile payload
+};
+
+}  // namespace
+
+namespace VarjoExamples
+{
+SpectatorReceiver::SpectatorReceiver(ThreadPool& threadPool, const Config& config)
+    : m_threadPool(threadPool)
+    , m_config(config)
+{
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        LOGE("Initializing Winsock failed.");
+        return;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(m_config.port);
+    if (inet_pton(AF_INET, m_config.host.c_str(), &addr.sin_addr) != 1) {
+        LOGE("Invalid spectator server address: %s", m_config.host.c_str());
+        return;
+    }
+    m_address.assign(reinterpret_cast<const uint8_t*>(&addr), reinterpret_cast<const uint8_t*>(&addr) + sizeof(addr));
+
+    const bool tcp = (m_config.transport == Transport::TCP);
+    SOCKET s = tcp ? socket(AF_INET, SOCK_STREAM, IPPROTO_TCP) : socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == INVALID_SOCKET) {
+        LOGE("Creating spectator socket failed: %d", WSAGetLastError());
+        return;
+    }
+    m_socket = s;
+    setsockopt(s, SOL_SOCKET, SO_RCVBUF, reinterpret_cast<const char*>(&c_recvBufferSize), sizeof(c_recvBufferSize));
+
+    if (tcp) {
+        if (connect(s, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == SOCKET_ERROR) {
+            LOGE("Connecting to spectator server failed: %s:%u (error %d)", m_config.host.c_str(), m_config.port, WSAGetLastError());
+            return;
+        }
+        const BOOL noDelay = TRUE;
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+    } else {
+        sendHello();
+    }
+
+    m_recvBuffer.resize(2 * c_maxPacketSize);
+    m_windowStart = getTimestampNs();
+    m_connected = true;
+
+    LOGI("Connected to spectator server: %s:%u (%s)", m_config.host.c_str(), m_config.port, tcp ? "TCP" : "UDP");
+}
+
+SpectatorReceiver::~SpectatorReceiver()
+{
+    if (m_socket != INVALID_SOCKET) {
+        closesocket(m_socket);
+        m_socket = INVALID_SOCKET;
+    }
+
+    WSACleanup();
+}
+
+void SpectatorReceiver::sendHello()
+{
+    PacketHeader header{};
+    header.magic = c_magic;
+    header.type = static_cast<uint8_t>(PacketType::Hello);
+    sendto(m_socket, reinterpret_cast<const char*>(&header), sizeof(header), 0, reinterpret_cast<const sockaddr*>(m_address.data()),
+        static_cast<int>(m_address.size()));
+    m_lastHello = getTimestampNs();
+}
+
+bool SpectatorReceiver::receive(int timeoutMs)
+{
+    if (!m_connected) {
+        return false;
+    }
+
+    const bool tcp = (m_config.transport == Transport::TCP);
+    const int64_t deadline = getTimestampNs() + static_cast<int64_t>(timeoutMs) * 1000000;
+
+    while (true) {
+        const int64_t now = getTimestampNs();
+        updateWindow(now);
+
+        if (!tcp && now - m_lastHello > c_helloIntervalNs) {
+            sendHello();
+        }
+
+        if (now >= deadline) {
+            break;
+        }
+
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(m_socket, &readSet);
+        const int64_t waitUs = (deadline - now) / 1000;
+        timeval timeout{static_cast<long>(waitUs / 1000000), static_cast<long>(waitUs % 1000000)};
+        if (select(0, &readSet, nullptr, nullptr, &timeout) <= 0) {
+            continue;
+        }
+
+        if (tcp) {
+            // Append to stream buffer and handle all complete packets
+            const int size = recv(m_socket, reinterpret_cast<char*>(m_recvBuffer.data() + m_recvSize), static_cast<int>(m_recvBuffer.size() - m_recvSize), 0);
+            if (size <= 0) {
+                LOGI("Spectator server closed connection.");
+                m_connected = false;
+                return false;
+            }
+            m_recvSize += size;
+            m_stats.bytes += size;
+            m_windowBytes += size;
+
+            size_t offset = 0;
+            while (m_recvSize - offset >= sizeof(PacketHeader)) {
+                PacketHeader header;
+                memcpy(&header, m_recvBuffer.data() + offset, sizeof(header));
+                const size_t packetSize = sizeof(PacketHeader) + header.payloadSize;
+                if (header.magic != c_magic || packetSize > c_maxPacketSize) {
+                    LOGE("Spectator stream out of sync.");
+                    m_connected = false;
+                    return false;
+                }
+                if (m_recvSize - offset < packetSize) {
+                    break;
+                }
+                handlePacket(m_recvBuffer.data() + offset, packetSize);
+                offset += packetSize;
+            }
+
+            // Move partial packet to front
+            memmove(m_recvBuffer.data(), m_recvBuffer.data() + offset, m_recvSize - offset);
+            m_recvSize -= offset;
+        } else {
+            const int size = recvfrom(m_socket, reinterpret_cast<char*>(m_recvBuffer.data()), static_cast<int>(m_recvBuffer.size()), 0, nullptr, nullptr);
+            if (size > 0) {
+                m_stats.bytes += size;
+                m_windowBytes += size;
+                handlePacket(m_recvBuffer.data(), size);
+            }
+        }
+    }
+
+    return true;
+}
+
+bool SpectatorReceiver::handlePacket(const uint8_t* data, size_t size)
+{
+    const int64_t startTime = getTimestampNs();
+
+    PacketHeader header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != c_magic || header.type != static_cast<uint8_t>(PacketType::Frame) || sizeof(header) + header.payloadSize != size) {
+        return false;
+    }
+    m_stats.packets++;
+
+    if (header.viewIndex >= m_views.size()) {
+        m_views.resize(header.viewIndex + 1);
+    }
+    auto& state = m_views[header.viewIndex];
+    auto& view = state.view;
+
+    // Resize image on resolution change
+    if (view.width != header.width || view.height != header.height) {
+        view.width = header.width;
+        view.height = header.height;
+        view.rgba.assign(static_cast<size_t>(view.width) * view.height * 4, 0);
+    }
+
+    // Track packets of pending frame
+    if (state.pendingFrame != header.frameNumber) {
+        if (state.pendingFrame >= 0 && state.pendingPackets < state.pendingPacketCount) {
+            // Previous frame never completed
+            m_stats.lostPackets += state.pendingPacketCount - state.pendingPackets;
+        }
+        state.pendingFrame = header.frameNumber;
+        state.pendingPackets = 0;
+        state.pendingPacketCount = header.packetCount;
+    }
+    state.pendingPackets++;
+
+    // Parse tile headers
+    std::vector<TileRef> tiles;
+    tiles.reserve(header.tileCount);
+    size_t offset = sizeof(header);
+    for (int i = 0; i < header.tileCount; i++) {
+        if (offset + sizeof(TileHeader) > size) {
+            return false;
+        }
+        TileRef tile;
+        memcpy(&tile.header, data + offset, sizeof(TileHeader));
+        offset += sizeof(TileHeader);
+        if (offset + tile.header.size > size) {
+            return false;
+        }
+        tile.data = data + offset;
+        offset += tile.header.size;
+        tiles.push_back(tile);
+    }
+
+    // Decode tiles in place
+    const int tileSize = header.tileSize;
+    const size_t stride = static_cast<size_t>(view.width) * 4;
+    std::atomic<int64_t> corrupt{0};
+    m_threadPool.parallelFor(static_cast<int>(tiles.size()), [&](int begin, int end) {
+        for (int i = begin; i < end; i++) {
+            const auto& tile = tiles[i];
+            const int x0 = tile.header.tileX * tileSize;
+            const int y0 = tile.header.tileY * tileSize;
+            if (x0 >= view.width || y0 >= view.height) {
+                corrupt++;
+                continue;
+            }
+            const int w = std::min(tileSize, view.width - x0);
+            const int h = std::min(tileSize, view.height - y0);
+            uint8_t* dst = view.rgba.data() + stride * y0 + x0 * 4;
+
+            if (tile.header.encoding == static_cast<uint8_t>(TileEncoding::QOI)) {
+                if (!TileCodec::decode(tile.data, tile.header.size, dst, stride, w, h)) {
+                    corrupt++;
+                }
+            } else if (tile.header.encoding == static_cast<uint8_t>(TileEncoding::Raw) && tile.header.size == static_cast<uint32_t>(w * h * 4)) {
+                for (int y = 0; y < h; y++) {
+                    memcpy(dst + stride * y, tile.data + w * 4 * y, w * 4);
+                }
+            } else {
+                corrupt++;
+            }
+        }
+    });
+    m_stats.corruptTiles += corrupt;
+
+    const int64_t endTime = getTimestampNs();
+    const double decodeMs = static_cast<double>(endTime - startTime) * 1e-6;
+    m_stats.decodeTimeAvgMs = (m_stats.packets == 1) ? decodeMs : (m_stats.decodeTimeAvgMs * (1.0 - c_statsSmoothing) + decodeMs * c_statsSmoothing);
+
+    // Last packet completes the frame
+    if (header.packetIndex + 1 == header.packetCount) {
+        m_stats.lostPackets += state.pendingPacketCount - state.pendingPackets;
+        state.pendingPackets = state.pendingPacketCount;
+        view.frameNumber = header.frameNumber;
+
+        const double latencyMs = static_cast<double>(endTime - header.captureTime) * 1e-6;
+        m_stats.frames++;
+        m_stats.latencyAvgMs = (m_stats.frames == 1) ? latencyMs : (m_stats.latencyAvgMs * (1.0 - c_statsSmoothing) + latencyMs * c_statsSmoothing);
+        m_windowLatencyMaxMs = std::max(m_windowLatencyMaxMs, latencyMs);
+
+        if (m_frameCallback) {
+            m_frameCallback(header.viewIndex, view);
+        }
+    }
+
+    return true;
+}
+
+void SpectatorReceiver::updateWindow(int64_t now)
+{
+    if (now - m_windowStart < c_statsWindowNs) {
+        return;
+    }
+
+    const double seconds = static_cast<double>(now - m_windowStart) * 1e-9;
+    m_stats.bandwidthMbps = static_cast<double>(m_windowBytes) * 8.0 * 1e-6 / seconds;
+    m_stats.latencyMaxMs = m_windowLatencyMaxMs;
+    m_windowStart = now;
+    m_windowBytes = 0;
+    m_windowLatencyMaxMs = 0.0;
+}
+
+}  // namespace VarjoExamples
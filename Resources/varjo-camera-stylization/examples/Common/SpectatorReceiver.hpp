@@ -0,0 +1,116 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "Globals.hpp"
+#include "ThreadPool.hpp"
+#include "SpectatorProtocol.hpp"
+
+namespace VarjoExamples
+{
+//! Spectator stream client side. Receives tile packets and reassembles view images.
+class SpectatorReceiver
+{
+public:
+    //! Receiver configuration
+    struct Config {
+        SpectatorProtocol::Transport transport = SpectatorProtocol::Transport::TCP;  //!< Socket transport
+        std::string host = "127.0.0.1";                                              //!< Server address
+        uint16_t port = SpectatorProtocol::c_defaultPort;                            //!< Server port
+    };
+
+    //! Reassembled view image
+    struct View {
+        int width = 0;              //!< Image width
+        int height = 0;             //!< Image height
+        int64_t frameNumber = -1;   //!< Latest completed frame number
+        std::vector<uint8_t> rgba;  //!< RGBA8 image data, tightly packed
+    };
+
+    //! Receiver statistics
+    struct Stats {
+        int64_t frames = 0;            //!< Completed frames
+        int64_t packets = 0;           //!< Received packets
+        int64_t bytes = 0;             //!< Received bytes
+        int64_t lostPackets = 0;       //!< Packets missing from completed frames (UDP)
+        int64_t corruptTiles = 0;      //!< Tiles failing to decode
+        double bandwidthMbps = 0.0;    //!< Receive bandwidth over last second
+        double latencyAvgMs = 0.0;     //!< Average capture to reassembled latency
+        double latencyMaxMs = 0.0;     //!< Maximum latency over last second
+        double decodeTimeAvgMs = 0.0;  //!< Average packet decode time
+    };
+
+    //! Frame completed callback
+    using FrameCallback = std::function<void(int viewIndex, const View& view)>;
+
+    //! Construct receiver and connect to server. Decoding runs on given thread pool.
+    SpectatorReceiver(ThreadPool& threadPool, const Config& config);
+
+    //! Destruct receiver. Closes connection.
+    ~SpectatorReceiver();
+
+    // Disable copy, move and assign
+    SpectatorReceiver(const SpectatorReceiver& other) = delete;
+    SpectatorReceiver(const SpectatorReceiver&& other) = delete;
+    SpectatorReceiver& operator=(const SpectatorReceiver& other) = delete;
+    SpectatorReceiver& operator=(const SpectatorReceiver&& other) = delete;
+
+    //! Returns true if connected to server
+    bool isConnected() const { return m_connected; }
+
+    //! Set callback for completed frames
+    void setFrameCallback(const FrameCallback& callback) { m_frameCallback = callback; }
+
+    //! Receive and process packets until timeout. Returns false if connection was lost.
+    bool receive(int timeoutMs);
+
+    //! Returns number of views received so far
+    int getViewCount() const { return static_cast<int>(m_views.size()); }
+
+    //! Returns view image
+    const View& getView(int viewIndex) const { return m_views[viewIndex].view; }
+
+    //! Returns receiver statistics
+    const Stats& getStats() const { return m_stats; }
+
+private:
+    //! Receive side view state
+    struct ViewState {
+        View view;                   //!< Reassembled image
+        int64_t pendingFrame = -1;   //!< Frame number being assembled
+        int pendingPackets = 0;      //!< Packets received for pending frame
+        int pendingPacketCount = 0;  //!< Expected packets for pending frame
+    };
+
+    //! Decode single packet. Returns false if packet is malformed.
+    bool handlePacket(const uint8_t* data, size_t size);
+
+    //! Send hello to server (UDP)
+    void sendHello();
+
+    //! Update windowed statistics
+    void updateWindow(int64_t now);
+
+private:
+    ThreadPool& m_threadPool;            //!< Decoding thread pool
+    const Config m_config;               //!< Receiver configuration
+    uintptr_t m_socket = ~uintptr_t(0);  //!< Client socket
+    std::vector<uint8_t> m_address;      //!< Server address
+    bool m_connected = false;            //!< Connection flag
+    std::vector<uint8_t> m_recvBuffer;   //!< Stream receive buffer
+    size_t m_recvSize = 0;               //!< Bytes in receive buffer
+    std::vector<ViewState> m_views;      //!< View states
+    FrameCallback m_frameCallback;       //!< Frame completed callback
+    int64_t m_lastHello = 0;             //!< Last hello timestamp
+
+    Stats m_stats{};                  //!< Statistics
+    int64_t m_windowStart = 0;        //!< Statistics window start time
+    int64_t m_windowBytes = 0;        //!< Bytes received in statistics window
+    double m_windowLatencyMaxMs = 0;  //!< Max latency in statistics window
+};
+
+}  // namespace VarjoExamples
@@ -0,0 +1,488 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+// Winsock headers must be included before windows.h
+#include <winsock2.h>
+#include <ws2tcpip.h>
+
+#include "SpectatorServer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "TileCodec.hpp"
+
+using namespace VarjoExamples::SpectatorProtocol;
+
+namespace
+{
+// Select timeout for network thread
+constexpr long c_networkPollUs = 100000;
+
+// UDP client is dropped if no hello received within this time
+constexpr int64_t c_udpClientTimeoutNs = 5000000000;
+
+// Statistics window length
+constexpr int64_t c_statsWindowNs = 1000000000;
+
+// Smoothing factor for average encode time
+constexpr double c_statsSmoothing = 0.05;
+
+// Socket send buffer size
+constexpr int c_sendBufferSize = 4 * 1024 * 1024;
+
+// Send whole buffer to TCP socket
+bool sendAll(SOCKET socket, const uint8_t* data, size_t size)
+{
+    while (size > 0) {
+        const int sent = send(socket, reinterpret_cast<const char*>(data), static_cast<int>(size), 0);
+        if (sent == SOCKET_ERROR) {
+            return false;
+        }
+        data += sent;
+        size -= sent;
+    }
+    return true;
+}
+
+// Address to string for logging
+std::string toString(const sockaddr_in& addr)
+{
+    char buf[INET_ADDRSTRLEN] = {};
+    inet_ntop(AF_INET, &addr.sin_addr, buf, sizeof(buf));
+    return std::string(buf) + ":" + std::to_string(ntohs(addr.sin_port));
+}
+
+}  // namespace
+
+namespace VarjoExamples
+{
+SpectatorServer::SpectatorServer(ThreadPool& threadPool, const Config& config)
+    : m_threadPool(threadPool)
+    , m_config(config)
+{
+    WSADATA wsaData;
+    if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+        LOGE("Initializing Winsock failed.");
+        return;
+    }
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(m_config.port);
+    if (inet_pton(AF_INET, m_config.bindAddress.c_str(), &addr.sin_addr) != 1) {
+        LOGE("Invalid spectator bind address: %s", m_config.bindAddress.c_str());
+        return;
+    }
+
+    const bool tcp = (m_config.transport == Transport::TCP);
+    SOCKET s = tcp ? socket(AF_INET, SOCK_STREAM, IPPROTO_TCP) : socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (s == INVALID_SOCKET) {
+        LOGE("Creating spectator socket failed: %d", WSAGetLastError());
+        return;
+    }
+    m_socket = s;
+
+    if (!tcp) {
+        setsockopt(s, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<const char*>(&c_sendBufferSize), sizeof(c_sendBufferSize));
+    }
+
+    if (bind(s, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == SOCKET_ERROR) {
+        LOGE("Binding spectator socket failed: %s (error %d)", toString(addr).c_str(), WSAGetLastError());
+        return;
+    }
+
+    if (tcp && listen(s, SOMAXCONN) == SOCKET_ERROR) {
+        LOGE("Listening spectator socket failed: %d", WSAGetLastError());
+        return;
+    }
+
+    m_windowStart = getTimestampNs();
+    m_running = true;
+    m_networkThread = std::thread(&SpectatorServer::networkMain, this);
+
+    LOGI("Spectator server running: %s (%s), tile size %d", toString(addr).c_str(), tcp ? "TCP" : "UDP", m_config.tileSize);
+}
+
+SpectatorServer::~SpectatorServer()
+{
+    m_running = false;
+    if (m_networkThread.joinable()) {
+        m_networkThread.join();
+    }
+
+    // Stop client senders
+    {
+        std::lock_guard<std::mutex> lock(m_clientMutex);
+        for (auto& client : m_clients) {
+            client->alive = false;
+            client->cond.notify_all();
+            if (client->socket != INVALID_SOCKET) {
+                shutdown(client->socket, SD_BOTH);
+            }
+        }
+        for (auto& client : m_clients) {
+            client->thread.join();
+            if (client->socket != INVALID_SOCKET) {
+                closesocket(client->socket);
+            }
+        }
+        m_clients.clear();
+    }
+
+    if (m_socket != INVALID_SOCKET) {
+        closesocket(m_socket);
+        m_socket = INVALID_SOCKET;
+    }
+
+    WSACleanup();
+}
+
+void SpectatorServer::networkMain()
+{
+    const bool tcp = (m_config.transport == Transport::TCP);
+    std::vector<char> recvBuf(c_maxPacketSize);
+
+    while (m_running) {
+        fd_set readSet;
+        FD_ZERO(&readSet);
+        FD_SET(m_socket, &readSet);
+        timeval timeout{0, c_networkPollUs};
+
+        if (select(0, &readSet, nullptr, nullptr, &timeout) > 0) {
+            sockaddr_in addr{};
+            int addrSize = sizeof(addr);
+
+            if (tcp) {
+                // New client connection
+                SOCKET s = accept(m_socket, reinterpret_cast<sockaddr*>(&addr), &addrSize);
+                if (s != INVALID_SOCKET) {
+                    const BOOL noDelay = TRUE;
+                    setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&noDelay), sizeof(noDelay));
+                    setsockopt(s, SOL_SOCKET, SO_SNDBUF, reinterpret_cast<const char*>(&c_sendBufferSize), sizeof(c_sendBufferSize));
+                    addClient(s, &addr, addrSize);
+                }
+            } else {
+                // Client hello datagram
+                const int size = recvfrom(m_socket, recvBuf.data(), static_cast<int>(recvBuf.size()), 0, reinterpret_cast<sockaddr*>(&addr), &addrSize);
+                if (size >= static_cast<int>(sizeof(PacketHeader))) {
+                    PacketHeader header;
+                    memcpy(&header, recvBuf.data(), sizeof(header));
+                    if (header.magic == c_magic && header.type == static_cast<uint8_t>(PacketType::Hello)) {
+                        bool known = false;
+                        {
+                            std::lock_guard<std::mutex> lock(m_clientMutex);
+                            for (auto& client : m_clients) {
+                                if (client->address.size() == static_cast<size_t>(addrSize) && memcmp(client->address.data(), &addr, addrSize) == 0) {
+                                    client->lastSeen = getTimestampNs();
+                                    known = true;
+                                }
+                            }
+                        }
+                        if (!known) {
+                            addClient(INVALID_SOCKET, &addr, addrSize);
+                        }
+                    }
+                }
+            }
+        }
+
+        removeDeadClients();
+    }
+}
+
+void SpectatorServer::addClient(uintptr_t socket, const void* address, int addressSize)
+{
+    auto client = std::make_unique<Client>();
+    client->socket = socket;
+    client->address.assign(reinterpret_cast<const uint8_t*>(address), reinterpret_cast<const uint8_t*>(address) + addressSize);
+    client->lastSeen = getTimestampNs();
+    client->thread = std::thread(&SpectatorServer::clientMain, this, client.get());
+
+    LOGI("Spectator client connected: %s", toString(*reinterpret_cast<const sockaddr_in*>(address)).c_str());
+
+    std::lock_guard<std::mutex> lock(m_clientMutex);
+    m_clients.emplace_back(std::move(client));
+
+    // New client needs every tile
+    m_fullFrameRequest++;
+}
+
+void SpectatorServer::removeDeadClients()
+{
+    const int64_t now = getTimestampNs();
+
+    std::lock_guard<std::mutex> lock(m_clientMutex);
+    for (auto it = m_clients.begin(); it != m_clients.end();) {
+        auto& client = *it;
+        const bool timedOut = (client->socket == INVALID_SOCKET) && (now - client->lastSeen > c_udpClientTimeoutNs);
+        if (client->alive && !timedOut) {
+            ++it;
+            continue;
+        }
+
+        LOGI("Spectator client disconnected: %s", toString(*reinterpret_cast<const sockaddr_in*>(client->address.data())).c_str());
+
+        client->alive = false;
+        client->cond.notify_all();
+        client->thread.join();
+        if (client->socket != INVALID_SOCKET) {
+            closesocket(client->socket);
+        }
+        it = m_clients.erase(it);
+    }
+}
+
+void SpectatorServer::clientMain(Client* client)
+{
+    const auto* addr = reinterpret_cast<const sockaddr*>(client->address.data());
+    const int addrSize = static_cast<int>(client->address.size());
+
+    while (client->alive) {
+        Packets packets;
+        {
+            std::unique_lock<std::mutex> lock(client->mutex);
+            client->cond.wait(lock, [client]() { return !client->alive || !client->queue.empty(); });
+            if (!client->alive) {
+                break;
+            }
+            packets = std::move(client->queue.front());
+            client->queue.pop_front();
+        }
+
+        int64_t bytes = 0;
+        for (const auto& packet : *packets) {
+            if (client->socket != INVALID_SOCKET) {
+                if (!sendAll(client->socket, packet.data(), packet.size())) {
+                    client->alive = false;
+                    break;
+                }
+            } else {
+                // Lost datagrams are fine, tiles are refreshed later
+                sendto(m_socket, reinterpret_cast<const char*>(packet.data()), static_cast<int>(packet.size()), 0, addr, addrSize);
+            }
+            bytes += packet.size();
+        }
+
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        m_stats.bytesSent += bytes;
+        m_windowBytes += bytes;
+    }
+}
+
+void SpectatorServer::submitFrame(int viewIndex, int64_t frameNumber, int64_t captureTime, int width, int height, size_t rowStride, const uint8_t* rgba)
+{
+    if (!m_running || viewIndex < 0 || width <= 0 || height <= 0) {
+        return;
+    }
+
+    {
+        // Skip encoding altogether if nobody is watching
+        std::lock_guard<std::mutex> lock(m_clientMutex);
+        if (m_clients.empty()) {
+            return;
+        }
+    }
+
+    const int64_t startTime = getTimestampNs();
+
+    if (viewIndex >= static_cast<int>(m_views.size())) {
+        m_views.resize(viewIndex + 1);
+    }
+    auto& view = m_views[viewIndex];
+
+    const int tileSize = std::max(8, std::min(m_config.tileSize, c_maxTileSize));
+
+    // Check full frame request
+    bool fullFrame = false;
+    const int64_t fullFrameRequest = m_fullFrameRequest;
+    if (view.fullFrameRequest != fullFrameRequest) {
+        view.fullFrameRequest = fullFrameRequest;
+        fullFrame = true;
+    }
+
+    // Reset view state on resolution change
+    if (view.width != width || view.height != height) {
+        view.width = width;
+        view.height = height;
+        view.tilesX = (width + tileSize - 1) / tileSize;
+        view.tilesY = (height + tileSize - 1) / tileSize;
+        view.reference.assign(static_cast<size_t>(width) * height * 4, 0);
+        view.encoded.resize(view.tilesX * view.tilesY);
+        view.changed.assign(view.tilesX * view.tilesY, 0);
+        fullFrame = true;
+    }
+
+    const int tileCount = view.tilesX * view.tilesY;
+    const int refreshInterval = m_config.refreshInterval;
+    const int refreshPhase = refreshInterval > 0 ? static_cast<int>(view.frameCounter % refreshInterval) : -1;
+    const size_t refStride = static_cast<size_t>(width) * 4;
+    view.frameCounter++;
+
+    // Compare and encode tiles in parallel
+    m_threadPool.parallelFor(tileCount, [&](int begin, int end) {
+        for (int t = begin; t < end; t++) {
+            const int x0 = (t % view.tilesX) * tileSize;
+            const int y0 = (t / view.tilesX) * tileSize;
+            const int w = std::min(tileSize, width - x0);
+            const int h = std::min(tileSize, height - y0);
+            const uint8_t* src = rgba + rowStride * y0 + x0 * 4;
+            uint8_t* ref = view.reference.data() + refStride * y0 + x0 * 4;
+
+            const bool refresh = (refreshInterval > 0) && (t % refreshInterval == refreshPhase);
+            if (!fullFrame && !refresh && TileCodec::meanAbsDiff(src, rowStride, ref, refStride, w, h) <= m_config.changeThreshold) {
+                view.changed[t] = 0;
+                continue;
+            }
+
+            // Update reference to what the clients will see
+            for (int y = 0; y < h; y++) {
+                memcpy(ref + refStride * y, src + rowStride * y, w * 4);
+            }
+
+            auto& encoded = view.encoded[t];
+            encoded.clear();
+            const size_t rawSize = static_cast<size_t>(w) * h * 4;
+            if (TileCodec::encode(ref, refStride, w, h, encoded) < rawSize) {
+                view.changed[t] = 1 + static_cast<uint8_t>(TileEncoding::QOI);
+            } else {
+                // Incompressible tile, send raw rows
+                encoded.resize(rawSize);
+                for (int y = 0; y < h; y++) {
+                    memcpy(encoded.data() + w * 4 * y, ref + refStride * y, w * 4);
+                }
+                view.changed[t] = 1 + static_cast<uint8_t>(TileEncoding::Raw);
+            }
+        }
+    });
+
+    auto packets = buildPackets(view, viewIndex, frameNumber, captureTime, fullFrame);
+
+    // Queue for clients
+    int64_t dropped = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_clientMutex);
+        for (auto& client : m_clients) {
+            std::lock_guard<std::mutex> clientLock(client->mutex);
+            if (static_cast<int>(client->queue.size()) >= m_config.maxQueuedFrames) {
+                // Client can't keep up. Drop its backlog and resync with full frame.
+                client->queue.clear();
+                m_fullFrameRequest++;
+                dropped++;
+            } else {
+                client->queue.push_back(packets);
+                client->cond.notify_one();
+            }
+        }
+    }
+
+    // Update statistics
+    const int64_t endTime = getTimestampNs();
+    const double encodeMs = static_cast<double>(endTime - startTime) * 1e-6;
+    const int64_t tilesSent = std::count_if(view.changed.begin(), view.changed.end(), [](uint8_t c) { return c != 0; });
+
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_stats.frames++;
+    m_stats.tilesSent += tilesSent;
+    m_stats.tilesTotal += tileCount;
+    m_stats.droppedFrames += dropped;
+    m_stats.encodeTimeAvgMs = (m_stats.frames == 1) ? encodeMs : (m_stats.encodeTimeAvgMs * (1.0 - c_statsSmoothing) + encodeMs * c_statsSmoothing);
+    m_windowTilesSent += tilesSent;
+    m_windowTilesTotal += tileCount;
+    m_windowEncodeMaxMs = std::max(m_windowEncodeMaxMs, encodeMs);
+
+    if (endTime - m_windowStart >= c_statsWindowNs) {
+        const double seconds = static_cast<double>(endTime - m_windowStart) * 1e-9;
+        m_stats.bandwidthMbps = static_cast<double>(m_windowBytes) * 8.0 * 1e-6 / seconds;
+        m_stats.changedTileRatio = m_windowTilesTotal > 0 ? static_cast<double>(m_windowTilesSent) / m_windowTilesTotal : 0.0;
+        m_stats.encodeTimeMaxMs = m_windowEncodeMaxMs;
+        m_windowStart = endTime;
+        m_windowBytes = 0;
+        m_windowTilesSent = 0;
+        m_windowTilesTotal = 0;
+        m_windowEncodeMaxMs = 0.0;
+    }
+}
+
+SpectatorServer::Packets SpectatorServer::buildPackets(const ViewState& view, int viewIndex, int64_t frameNumber, int64_t captureTime, bool fullFrame) const
+{
+    auto packets = std::make_shared<std::vector<std::vector<uint8_t>>>();
+    std::vector<uint16_t> tileCounts;
+
+    auto beginPacket = [&]() {
+        packets->emplace_back();
+        packets->back().reserve(c_maxPacketSize);
+        packets->back().resize(sizeof(PacketHeader));
+        tileCounts.push_back(0);
+    };
+
+    // Pack changed tiles to packets
+    const int tileCount = view.tilesX * view.tilesY;
+    for (int t = 0; t < tileCount; t++) {
+        if (view.changed[t] == 0) {
+            continue;
+        }
+
+        const auto& encoded = view.encoded[t];
+        const size_t tileBytes = sizeof(TileHeader) + encoded.size();
+        if (packets->empty() || packets->back().size() + tileBytes > c_maxPacketSize) {
+            beginPacket();
+        }
+
+        TileHeader tileHeader{};
+        tileHeader.tileX = static_cast<uint16_t>(t % view.tilesX);
+        tileHeader.tileY = static_cast<uint16_t>(t / view.tilesX);
+        tileHeader.encoding = view.changed[t] - 1;
+        tileHeader.size = static_cast<uint32_t>(encoded.size());
+
+        auto& packet = packets->back();
+        const uint8_t* headerBytes = reinterpret_cast<const uint8_t*>(&tileHeader);
+        packet.insert(packet.end(), headerBytes, headerBytes + sizeof(tileHeader));
+        packet.insert(packet.end(), encoded.begin(), encoded.end());
+        tileCounts.back()++;
+    }
+
+    // Always send at least one packet so clients see every frame
+    if (packets->empty()) {
+        beginPacket();
+    }
+
+    // Fill in packet headers
+    const int tileSize = std::max(8, std::min(m_config.tileSize, c_maxTileSize));
+    for (size_t i = 0; i < packets->size(); i++) {
+        auto& packet = (*packets)[i];
+
+        PacketHeader header{};
+        header.magic = c_magic;
+        header.type = static_cast<uint8_t>(PacketType::Frame);
+        header.viewIndex = static_cast<uint8_t>(viewIndex);
+        header.tileSize = static_cast<uint16_t>(tileSize);
+        header.width = static_cast<uint16_t>(view.width);
+        header.height = static_cast<uint16_t>(view.height);
+        header.packetIndex = static_cast<uint16_t>(i);
+        header.packetCount = static_cast<uint16_t>(packets->size());
+        header.tileCount = tileCounts[i];
+        header.flags = fullFrame ? c_flagFullFrame : 0;
+        header.frameNumber = frameNumber;
+        header.captureTime = captureTime;
+        header.payloadSize = static_cast<uint32_t>(packet.size() - sizeof(PacketHeader));
+        memcpy(packet.data(), &header, sizeof(header));
+    }
+
+    return packets;
+}
+
+SpectatorServer::Stats SpectatorServer::getStats() const
+{
+    Stats stats;
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        stats = m_stats;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_clientMutex);
+        stats.clients = static_cast<int32_t>(m_clients.size());
+    }
+    return stats;
+}
+
+}  // namespace VarjoExamples
@@ -0,0 +1,134 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+
+#include "Globals.hpp"
+#include "ThreadPool.hpp"
+#include "SpectatorProtocol.hpp"
+
+namespace VarjoExamples
+{
+//! Spectator stream server. Splits submitted view images to tiles and sends changed tiles to connected clients.
+class SpectatorServer
+{
+public:
+    //! Server configuration
+    struct Config {
+        SpectatorProtocol::Transport transport = SpectatorProtocol::Transport::TCP;  //!< Socket transport
+        std::string bindAddress = "127.0.0.1";                                       //!< Local address to bind
+        uint16_t port = SpectatorProtocol::c_defaultPort;                            //!< Local port to bind
+        int tileSize = 64;                                                           //!< Tile size in pixels
+        float changeThreshold = 1.0f;                                                //!< Mean absolute difference for sending tile
+        int refreshInterval = 120;                                                   //!< Frames to cycle through all tiles for refresh. Zero disables.
+        int maxQueuedFrames = 4;                                                     //!< Queued frames per client before dropping
+    };
+
+    //! Server statistics
+    struct Stats {
+        int64_t frames = 0;             //!< Submitted frames
+        int64_t tilesSent = 0;          //!< Tiles sent
+        int64_t tilesTotal = 0;         //!< Tiles processed
+        int64_t bytesSent = 0;          //!< Bytes sent to all clients
+        int64_t droppedFrames = 0;      //!< Frames dropped for slow clients
+        double bandwidthMbps = 0.0;     //!< Send bandwidth over last second
+        double encodeTimeAvgMs = 0.0;   //!< Average frame encode time
+        double encodeTimeMaxMs = 0.0;   //!< Maximum frame encode time over last second
+        double changedTileRatio = 0.0;  //!< Ratio of sent tiles over last second
+        int32_t clients = 0;            //!< Connected clients
+    };
+
+    //! Construct and start server. Encoding runs on given thread pool.
+    SpectatorServer(ThreadPool& threadPool, const Config& config);
+
+    //! Destruct server. Disconnects all clients.
+    ~SpectatorServer();
+
+    // Disable copy, move and assign
+    SpectatorServer(const SpectatorServer& other) = delete;
+    SpectatorServer(const SpectatorServer&& other) = delete;
+    SpectatorServer& operator=(const SpectatorServer& other) = delete;
+    SpectatorServer& operator=(const SpectatorServer&& other) = delete;
+
+    //! Returns true if server socket is up
+    bool isRunning() const { return m_running; }
+
+    //! Submit RGBA8 view image. Encodes changed tiles and queues them for clients. Returns immediately if no clients.
+    void submitFrame(int viewIndex, int64_t frameNumber, int64_t captureTime, int width, int height, size_t rowStride, const uint8_t* rgba);
+
+    //! Returns server statistics
+    Stats getStats() const;
+
+private:
+    //! Encoded frame packets shared between client queues
+    using Packets = std::shared_ptr<const std::vector<std::vector<uint8_t>>>;
+
+    //! Connected client
+    struct Client {
+        uintptr_t socket = ~uintptr_t(0);  //!< Client socket (TCP)
+        std::vector<uint8_t> address;      //!< Client address (UDP)
+        std::deque<Packets> queue;         //!< Queued frames
+        std::mutex mutex;                  //!< Queue mutex
+        std::condition_variable cond;      //!< Queue signal
+        std::thread thread;                //!< Sender thread
+        std::atomic<bool> alive{true};     //!< Connection alive flag
+        int64_t lastSeen = 0;              //!< Last hello timestamp (UDP)
+    };
+
+    //! Per view tile state
+    struct ViewState {
+        int width = 0;                              //!< View width
+        int height = 0;                             //!< View height
+        int tilesX = 0;                             //!< Tile columns
+        int tilesY = 0;                             //!< Tile rows
+        std::vector<uint8_t> reference;             //!< Last sent image contents
+        std::vector<std::vector<uint8_t>> encoded;  //!< Encoded tile buffers
+        std::vector<uint8_t> changed;               //!< Zero for unchanged tiles, otherwise one plus tile encoding
+        int64_t frameCounter = 0;                   //!< Submitted frames for refresh cycling
+        int64_t fullFrameRequest = -1;              //!< Last handled full frame request
+    };
+
+    //! Network thread accepting connections and handling hellos
+    void networkMain();
+
+    //! Client sender thread
+    void clientMain(Client* client);
+
+    //! Add new client
+    void addClient(uintptr_t socket, const void* address, int addressSize);
+
+    //! Remove disconnected and timed out clients
+    void removeDeadClients();
+
+    //! Build packets from encoded tiles
+    Packets buildPackets(const ViewState& view, int viewIndex, int64_t frameNumber, int64_t captureTime, bool fullFrame) const;
+
+private:
+    ThreadPool& m_threadPool;                        //!< Encoding thread pool
+    const Config m_config;                           //!< Server configuration
+    uintptr_t m_socket = ~uintptr_t(0);              //!< Listen or datagram socket
+    std::atomic<bool> m_running{false};              //!< Running flag
+    std::thread m_networkThread;                     //!< Network thread
+    mutable std::mutex m_clientMutex;                //!< Client list mutex
+    std::vector<std::unique_ptr<Client>> m_clients;  //!< Connected clients
+    std::atomic<int64_t> m_fullFrameRequest{0};      //!< Incremented to request all tiles on next frame of each view
+    std::vector<ViewState> m_views;                  //!< View tile states
+
+    mutable std::mutex m_statsMutex;   //!< Statistics mutex
+    Stats m_stats{};                   //!< Statistics
+    int64_t m_windowStart = 0;         //!< Statistics window start time
+    int64_t m_windowBytes = 0;         //!< Bytes sent in statistics window
+    int64_t m_windowTilesSent = 0;     //!< Tiles sent in statistics window
+    int64_t m_windowTilesTotal = 0;    //!< Tiles processed in statistics window
+    double m_windowEncodeMaxMs = 0.0;  //!< Max encode time in statistics window
+};
+
+}  // namespace VarjoExamples
@@ -0,0 +1,966 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "StandInRuntime.hpp"
+
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <array>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+
+#include <Varjo_datastream.h>
+#include <Varjo_mr.h>
+#include <Varjo_mr_experimental.h>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "FiducialDetector.hpp"
+
+using VarjoExamples::StandInRuntime;
+using VarjoExamples::getTimestampNs;
+
+namespace
+{
+// Id of the synthetic color stream
+constexpr varjo_StreamId c_colorStreamId = 1;
+
+// Neutral white balance for synthetic frames
+const varjo_WBNormalizationData c_identityWB = {
+    {1.0, 1.0, 1.0},
+    {1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0},
+    {1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0},
+};
+
+// Buffer ids are stream id times this plus channel index
+constexpr varjo_BufferId c_bufferIdStride = 16;
+
+// Interpupillary distance for view matrices
+constexpr float c_ipd = 0.064f;
+
+// Vertical field of views for context and focus views
+constexpr float c_contextFov = 100.0f;
+constexpr float c_focusFov = 40.0f;
+
+// Occlusion mesh hides view corners outside circle of this radius in NDC, in this many segments
+constexpr float c_occlusionRadius = 1.1f;
+constexpr int c_occlusionSegments = 32;
+
+// Synthetic gaze wanders around view center with these amplitudes in radians
+constexpr float c_gazeYawAmplitude = 0.25f;
+constexpr float c_gazePitchAmplitude = 0.15f;
+
+// Runtime statistics counters
+struct Counters {
+    std::atomic<int64_t> framesSynced{0};
+    std::atomic<int64_t> framesSubmitted{0};
+    std::atomic<int64_t> layersSubmitted{0};
+    std::atomic<int64_t> viewsSubmitted{0};
+    std::atomic<int64_t> viewPixelsSubmitted{0};
+    std::atomic<int64_t> eventsPolled{0};
+    std::atomic<int64_t> shaderInputsSubmitted{0};
+    std::atomic<int64_t> shaderInputsLate{0};
+    std::atomic<int64_t> streamFramesDelivered{0};
+    std::atomic<int64_t> streamFramesSkipped{0};
+    std::atomic<int64_t> errors{0};
+};
+
+// Global runtime state shared by sessions
+std::mutex g_configMutex;
+StandInRuntime::Config g_config;
+Counters g_counters;
+std::mutex g_eventMutex;
+std::deque<varjo_Event> g_events;
+
+// Errors are tracked per calling thread, so stream threads do not clear main thread errors
+thread_local varjo_Error t_error = varjo_NoError;
+
+void setError(varjo_Error error)
+{
+    t_error = error;
+    g_counters.errors++;
+}
+
+// Copy GLM matrix to Varjo double matrix
+void copyMatrix(const glm::mat4& m, double* out)
+{
+    const float* p = glm::value_ptr(m);
+    std::copy(p, p + 16, out);
+}
+
+// Slowly swaying head pose at given time since session start
+glm::mat4 getHeadPose(varjo_Nanoseconds sinceStart)
+{
+    const float t = static_cast<float>(sinceStart) * 1e-9f;
+    return glm::rotate(glm::mat4(1.0f), 0.3f * std::sin(t), glm::vec3(0.0f, 1.0f, 0.0f)) * glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 1.6f, 0.0f));
+}
+
+}  // namespace
+
+//! Synthetic data stream with its own frame thread
+struct StandInStream {
+    varjo_Session* session = nullptr;                      //!< Owning session
+    varjo_StreamConfig config{};                           //!< Stream config
+    varjo_ChannelFlag channels = varjo_ChannelFlag_None;   //!< Requested channels
+    varjo_FrameListener* callback = nullptr;               //!< Frame callback
+    void* userData = nullptr;                              //!< Callback user data
+    std::array<std::vector<uint8_t>, 2> buffers;           //!< Channel buffers
+    std::array<std::atomic_bool, 2> locked;                //!< Channel buffer lock flags
+    std::mutex stopMutex;                                  //!< Stop flag mutex
+    std::condition_variable stopCondition;                 //!< Stop signal
+    bool stop = false;                                     //!< Stop flag
+    std::thread thread;                                    //!< Frame thread
+};
+
+//! Stand-in session state
+struct varjo_Session {
+    StandInRuntime::Config config;                                 //!< Configuration at init
+    varjo_Nanoseconds startTime = 0;                               //!< Session start time
+    varjo_Nanoseconds displayTime = 0;                             //!< Display time of last synced frame
+    std::atomic<varjo_Nanoseconds> inputDeadline{0};               //!< Shader input deadline of last synced frame
+    std::atomic<int64_t> frameNumber{0};                           //!< Last synced frame number, read by gaze from any thread
+    bool frameStarted = false;                                     //!< Between begin and end frame
+    varjo_Bool videoRender = varjo_False;                          //!< Video rendering flag
+    int32_t priority = 0;                                          //!< Session priority
+    bool gazeInitialized = false;                                  //!< Gaze tracking initialized flag
+    std::vector<char> shaderConstants;                             //!< Last submitted shader constants
+    std::mutex streamMutex;                                        //!< Stream map mutex
+    std::map<varjo_StreamId, std::unique_ptr<StandInStream>> streams;  //!< Running streams
+};
+
+//! Stand-in swap chain without textures
+struct varjo_SwapChain {
+    varjo_SwapChainConfig2 config{};  //!< Swap chain config
+    int32_t index = 0;                //!< Current image index
+    bool acquired = false;            //!< Image acquired flag
+};
+
+namespace
+{
+varjo_Session* g_session = nullptr;
+
+// Returns stream config for color stream
+varjo_StreamConfig getColorStreamConfig(const StandInRuntime::Config& config)
+{
+    varjo_StreamConfig stream{};
+    stream.streamId = c_colorStreamId;
+    stream.channelFlags = varjo_ChannelFlag_Left | varjo_ChannelFlag_Right;
+    stream.streamType = varjo_StreamType_DistortedColor;
+    stream.bufferType = varjo_BufferType_CPU;
+    stream.format = varjo_TextureFormat_YUV422;
+    stream.streamTransform = VarjoExamples::toVarjoMatrix(glm::mat4(1.0f));
+    stream.frameRate = config.streamFrameRate;
+    stream.width = config.streamWidth;
+    stream.height = config.streamHeight;
+    stream.rowStride = config.streamWidth;
+    return stream;
+}
+
+// Returns stream for id, nullptr if not running
+StandInStream* findStream(varjo_Session* session, varjo_StreamId id)
+{
+    std::lock_guard<std::mutex> lock(session->streamMutex);
+    const auto it = session->streams.find(id);
+    return (it != session->streams.end()) ? it->second.get() : nullptr;
+}
+
+// Returns stream and channel for buffer id, nullptr if invalid
+StandInStream* findBuffer(varjo_Session* session, varjo_BufferId id, int& outChannel)
+{
+    outChannel = static_cast<int>(id % c_bufferIdStride);
+    StandInStream* stream = (outChannel < 2) ? findStream(session, id / c_bufferIdStride) : nullptr;
+    if (!stream) {
+        setError(varjo_Error_IndexOutOfBounds);
+    }
+    return stream;
+}
+
+// Fill YUV422 planes with a test pattern: luma gradient with blocks and optional marker, mildly colored chroma
+void fillStreamBuffer(std::vector<uint8_t>& buffer, int32_t width, int32_t height, int channel, const StandInRuntime::Config& config)
+{
+    buffer.resize(static_cast<size_t>(width) * height * 2);
+    uint8_t* yPlane = buffer.data();
+    uint8_t* uvPlane = buffer.data() + static_cast<size_t>(width) * height;
+    for (int32_t y = 0; y < height; y++) {
+        for (int32_t x = 0; x < width; x++) {
+            const bool block = (((x + channel * 16) / 48 + y / 48) & 1) != 0;
+            yPlane[y * width + x] = static_cast<uint8_t>(16 + ((x + y) * 200 / (width + height)) + (block ? 19 : 0));
+            uvPlane[y * width + x] = static_cast<uint8_t>(128 + ((x & 1) ? (y * 32 / height) : -(x * 32 / width)));
+        }
+    }
+
+    // Marker in limited range luma, same place in both channels like a distant marker
+    std::vector<uint8_t> marker;
+    if (config.streamMarkerId >= 0 && VarjoExamples::FiducialDetector::renderMarker(config.streamMarkerId, config.streamMarkerCell, marker)) {
+        const int32_t size = static_cast<int32_t>(std::sqrt(static_cast<double>(marker.size())));
+        const int32_t x0 = (width - size) / 2;
+        const int32_t y0 = (height - size) / 2;
+        for (int32_t y = std::max(0, -y0); y < std::min(size, height - y0); y++) {
+            for (int32_t x = std::max(0, -x0); x < std::min(size, width - x0); x++) {
+                yPlane[(y0 + y) * width + x0 + x] = static_cast<uint8_t>(16 + marker[y * size + x] * 219 / 255);
+            }
+        }
+    }
+}
+
+// Stream frame thread. Delivers frames at stream frame rate, skipping frames if callback is late.
+void runStream(StandInStream* stream)
+{
+    const int64_t period = 1000000000ll / std::max(1, stream->config.frameRate);
+    int64_t nextTime = getTimestampNs();
+    int64_t frameNumber = 0;
+
+    std::unique_lock<std::mutex> lock(stream->stopMutex);
+    while (!stream->stop) {
+        const int64_t now = getTimestampNs();
+        if (now < nextTime) {
+            stream->stopCondition.wait_for(lock, std::chrono::nanoseconds(nextTime - now));
+            continue;
+        }
+
+        const int64_t skipped = (now - nextTime) / period;
+        g_counters.streamFramesSkipped += skipped;
+        frameNumber += skipped + 1;
+        nextTime += (skipped + 1) * period;
+
+        varjo_StreamFrame frame{};
+        frame.type = stream->config.streamType;
+        frame.id = stream->config.streamId;
+        frame.frameNumber = frameNumber;
+        frame.channels = stream->channels;
+        frame.dataFlags = varjo_DataFlag_Buffer | varjo_DataFlag_Intrinsics | varjo_DataFlag_Extrinsics;
+        frame.hmdPose = VarjoExamples::toVarjoMatrix(getHeadPose(now - stream->session->startTime));
+        auto& metadata = frame.metadata.distortedColor;
+        metadata.timestamp = now;
+        metadata.ev = 6.2;
+        metadata.exposureTime = 1.0 / stream->config.frameRate;
+        metadata.whiteBalanceTemperature = 5000.0;
+        metadata.wbNormalizationData = c_identityWB;
+        metadata.cameraCalibrationConstant = 1.0 / 1.2;
+
+        // Callback runs unlocked so that stop can be signalled meanwhile
+        lock.unlock();
+        stream->callback(&frame, stream->session, stream->userData);
+        g_counters.streamFramesDelivered++;
+        lock.lock();
+    }
+}
+
+// Queue data stream start or stop event
+void pushStreamEvent(varjo_EventType type, varjo_StreamId id)
+{
+    varjo_Event evt{};
+    evt.header.type = type;
+    if (type == varjo_EventType_DataStreamStart) {
+        evt.data.dataStreamStart.streamId = id;
+    } else {
+        evt.data.dataStreamStop.streamId = id;
+    }
+    StandInRuntime::pushEvent(evt);
+}
+
+// Signal stream thread to stop and wait for it
+void joinStream(StandInStream& stream)
+{
+    {
+        std::lock_guard<std::mutex> lock(stream.stopMutex);
+        stream.stop = true;
+    }
+    stream.stopCondition.notify_all();
+    if (stream.thread.joinable()) {
+        stream.thread.join();
+    }
+}
+
+// Stop stream and wait for its thread
+void stopStream(std::unique_ptr<StandInStream> stream) { joinStream(*stream); }
+
+}  // namespace
+
+namespace VarjoExamples
+{
+void StandInRuntime::configure(const Config& config)
+{
+    std::lock_guard<std::mutex> lock(g_configMutex);
+    g_config = config;
+}
+
+StandInRuntime::Config StandInRuntime::getConfig()
+{
+    std::lock_guard<std::mutex> lock(g_configMutex);
+    return g_config;
+}
+
+void StandInRuntime::pushEvent(const varjo_Event& evt)
+{
+    std::lock_guard<std::mutex> lock(g_eventMutex);
+    g_events.push_back(evt);
+    g_events.back().header.timestamp = getTimestampNs();
+}
+
+int StandInRuntime::interruptDataStreams()
+{
+    if (!g_session) {
+        return 0;
+    }
+
+    std::vector<varjo_StreamId> ids;
+    {
+        std::lock_guard<std::mutex> lock(g_session->streamMutex);
+        for (const auto& stream : g_session->streams) {
+            ids.push_back(stream.first);
+        }
+    }
+
+    // Stream stays findable until its thread has stopped, so that a callback in flight can still lock its buffers
+    for (varjo_StreamId id : ids) {
+        if (StandInStream* stream = findStream(g_session, id)) {
+            joinStream(*stream);
+        }
+        {
+            std::lock_guard<std::mutex> lock(g_session->streamMutex);
+            g_session->streams.erase(id);
+        }
+        pushStreamEvent(varjo_EventType_DataStreamStop, id);
+    }
+    return static_cast<int>(ids.size());
+}
+
+varjo_SwapChain* StandInRuntime::createSwapChain(varjo_Session* session, const varjo_SwapChainConfig2& config)
+{
+    if (!session) {
+        setError(varjo_Error_InvalidSession);
+        return nullptr;
+    }
+    if (config.numberOfTextures <= 0 || config.textureWidth <= 0 || config.textureHeight <= 0) {
+        setError(varjo_Error_ValidationFailure);
+        return nullptr;
+    }
+
+    auto swapChain = new varjo_SwapChain();
+    swapChain->config = config;
+    return swapChain;
+}
+
+StandInRuntime::Stats StandInRuntime::getStats()
+{
+    Stats stats;
+    stats.framesSynced = g_counters.framesSynced;
+    stats.framesSubmitted = g_counters.framesSubmitted;
+    stats.layersSubmitted = g_counters.layersSubmitted;
+    stats.viewsSubmitted = g_counters.viewsSubmitted;
+    stats.viewPixelsSubmitted = g_counters.viewPixelsSubmitted;
+    stats.eventsPolled = g_counters.eventsPolled;
+    stats.shaderInputsSubmitted = g_counters.shaderInputsSubmitted;
+    stats.shaderInputsLate = g_counters.shaderInputsLate;
+    stats.streamFramesDelivered = g_counters.streamFramesDelivered;
+    stats.streamFramesSkipped = g_counters.streamFramesSkipped;
+    stats.errors = g_counters.errors;
+    return stats;
+}
+
+}  // namespace VarjoExamples
+
+//---------------------------------------------------------------------------
+// Session
+
+struct varjo_Session* varjo_SessionInit(void)
+{
+    if (g_session) {
+        setError(varjo_Error_InvalidSession);
+        return nullptr;
+    }
+
+    g_session = new varjo_Session();
+    g_session->config = StandInRuntime::getConfig();
+    g_session->config.viewCount = (g_session->config.viewCount > 2) ? 4 : 2;
+    g_session->startTime = g_session->displayTime = getTimestampNs();
+
+    // Stream events of previous session are not delivered to next one
+    {
+        std::lock_guard<std::mutex> lock(g_eventMutex);
+        g_events.clear();
+    }
+
+    g_counters.framesSynced = 0;
+    g_counters.framesSubmitted = 0;
+    g_counters.layersSubmitted = 0;
+    g_counters.viewsSubmitted = 0;
+    g_counters.eventsPolled = 0;
+    g_counters.shaderInputsSubmitted = 0;
+    g_counters.shaderInputsLate = 0;
+    g_counters.streamFramesDelivered = 0;
+    g_counters.streamFramesSkipped = 0;
+    g_counters.errors = 0;
+    return g_session;
+}
+
+void varjo_SessionShutDown(struct varjo_Session* session)
+{
+    if (!session || session != g_session) {
+        return;
+    }
+
+    std::map<varjo_StreamId, std::unique_ptr<StandInStream>> streams;
+    {
+        std::lock_guard<std::mutex> lock(session->streamMutex);
+        streams.swap(session->streams);
+    }
+    for (auto& stream : streams) {
+        stopStream(std::move(stream.second));
+    }
+
+    delete session;
+    g_session = nullptr;
+}
+
+void varjo_SessionSetPriority(struct varjo_Session* session, int32_t priority)
+{
+    if (!session) {
+        setError(varjo_Error_InvalidSession);
+        return;
+    }
+    session->priority = priority;
+}
+
+varjo_Nanoseconds varjo_GetCurrentTime(struct varjo_Session* /*session*/) { return getTimestampNs(); }
+
+varjo_Error varjo_GetError(struct varjo_Session* /*session*/)
+{
+    const varjo_Error error = t_error;
+    t_error = varjo_NoError;
+    return error;
+}
+
+const char* varjo_GetErrorDesc(varjo_Error error)
+{
+    switch (error) {
+        case varjo_NoError: return "No error";
+        case varjo_Error_InvalidSession: return "Invalid session";
+        case varjo_Error_FrameNotStarted: return "Frame not started";
+        case varjo_Error_FrameAlreadyStarted: return "Frame already started";
+        case varjo_Error_ViewIndexOutOfBounds: return "View index out of bounds";
+        case varjo_Error_NullPointer: return "Null pointer";
+        case varjo_Error_ValidationFailure: return "Validation failure";
+        case varjo_Error_IndexOutOfBounds: return "Index out of bounds";
+        case varjo_Error_AlreadyLocked: return "Already locked";
+        case varjo_Error_NotLocked: return "Not locked";
+        case varjo_Error_GazeNotInitialized: return "Gaze not initialized";
+        default: return "Unknown error";
+    }
+}
+
+//---------------------------------------------------------------------------
+// Properties and events
+
+void varjo_SyncProperties(struct varjo_Session* /*session*/) {}
+
+varjo_Bool varjo_HasProperty(struct varjo_Session* /*session*/, varjo_PropertyKey propertyKey)
+{
+    return (propertyKey == varjo_PropertyKey_MRAvailable) ? varjo_True : varjo_False;
+}
+
+varjo_Bool varjo_GetPropertyBool(struct varjo_Session* session, varjo_PropertyKey propertyKey)
+{
+    if (!session) {
+        setError(varjo_Error_InvalidSession);
+        return varjo_False;
+    }
+    return (propertyKey == varjo_PropertyKey_MRAvailable && session->config.mrAvailable) ? varjo_True : varjo_False;
+}
+
+varjo_Bool varjo_PollEvent(struct varjo_Session* /*session*/, struct varjo_Event* evt)
+{
+    if (!evt) {
+        setError(varjo_Error_NullPointer);
+        return varjo_False;
+    }
+
+    std::lock_guard<std::mutex> lock(g_eventMutex);
+    if (g_events.empty()) {
+        return varjo_False;
+    }
+    *evt = g_events.front();
+    g_events.pop_front();
+    g_counters.eventsPolled++;
+    return varjo_True;
+}
+
+//---------------------------------------------------------------------------
+// Frame timing and views
+
+int32_t varjo_GetViewCount(struct varjo_Session* session)
+{
+    if (!session) {
+        setError(varjo_Error_InvalidSession);
+        return 0;
+    }
+    return session->config.viewCount;
+}
+
+struct varjo_ViewDescription varjo_GetViewDescription(struct varjo_Session* session, int32_t viewIndex)
+{
+    varjo_ViewDescription desc{};
+    if (!session || viewIndex < 0 || viewIndex >= session->config.viewCount) {
+        setError(varjo_Error_ViewIndexOutOfBounds);
+        return desc;
+    }
+    desc.width = session->config.viewWidth;
+    desc.height = session->config.viewHeight;
+    desc.display = (viewIndex < 2) ? varjo_DisplayType_Context : varjo_DisplayType_Focus;
+    desc.eye = (viewIndex % 2 == 0) ? varjo_Eye_Left : varjo_Eye_Right;
+    return desc;
+}
+
+struct varjo_Mesh2Df* varjo_CreateOcclusionMesh(struct varjo_Session* session, int32_t viewIndex, varjo_WindingOrder windingOrder)
+{
+    if (!session || viewIndex < 0 || viewIndex >= session->config.viewCount) {
+        setError(varjo_Error_ViewIndexOutOfBounds);
+        return nullptr;
+    }
+
+    // Two triangles per segment between circle and view border. Border point is the circle point pushed out to the NDC square.
+    std::vector<varjo_Vector2Df> vertices;
+    vertices.reserve(c_occlusionSegments * 6);
+    const auto getPoints = [](int segment, varjo_Vector2Df& outCircle, varjo_Vector2Df& outBorder) {
+        const float angle = 2.0f * glm::pi<float>() * segment / c_occlusionSegments;
+        const float x = std::cos(angle);
+        const float y = std::sin(angle);
+        const float border = 1.0f / std::max(std::abs(x), std::abs(y));
+        outCircle = {x * c_occlusionRadius, y * c_occlusionRadius};
+        outBorder = {x * std::max(border, c_occlusionRadius), y * std::max(border, c_occlusionRadius)};
+    };
+    for (int i = 0; i < c_occlusionSegments; i++) {
+        varjo_Vector2Df c0, b0, c1, b1;
+        getPoints(i, c0, b0);
+        getPoints(i + 1, c1, b1);
+
+        // Points go counter-clockwise around the circle
+        const bool ccw = (windingOrder == varjo_WindingOrder_CounterClockwise);
+        vertices.insert(vertices.end(), {c0, ccw ? b0 : b1, ccw ? b1 : b0, c0, ccw ? b1 : c1, ccw ? c1 : b1});
+    }
+
+    auto* mesh = new varjo_Mesh2Df{};
+    mesh->vertexCount = static_cast<int32_t>(vertices.size());
+    mesh->vertices = new varjo_Vector2Df[vertices.size()];
+    std::copy(vertices.begin(), vertices.end(), mesh->vertices);
+    return mesh;
+}
+
+void varjo_FreeOcclusionMesh(struct varjo_Mesh2Df* mesh)
+{
+    if (mesh) {
+        delete[] mesh->vertices;
+        delete mesh;
+    }
+}
+
+struct varjo_FrameInfo* varjo_CreateFrameInfo(struct varjo_Session* session)
+{
+    if (!session) {
+        setError(varjo_Error_InvalidSession);
+        return nullptr;
+    }
+    auto frameInfo = new varjo_FrameInfo();
+    frameInfo->views = new varjo_ViewInfo[session->config.viewCount]();
+    return frameInfo;
+}
+
+void varjo_FreeFrameInfo(struct varjo_FrameInfo* frameInfo)
+{
+    if (frameInfo) {
+        delete[] frameInfo->views;
+        delete frameInfo;
+    }
+}
+
+void varjo_WaitSync(struct varjo_Session* session, struct varjo_FrameInfo* frameInfo)
+{
+    if (!session || !frameInfo) {
+        setError(varjo_Error_NullPointer);
+        return;
+    }
+
+    const auto& config = session->config;
+    const int64_t period = static_cast<int64_t>(1e9 / config.frameRate);
+    varjo_Nanoseconds displayTime = session->startTime + (session->frameNumber + 1) * period;
+
+    if (config.throttle) {
+        // Wait for the frame slot. Late frames are displayed on the next free slot.
+        const int64_t now = getTimestampNs();
+        if (now > displayTime) {
+            displayTime += ((now - displayTime) / period + 1) * period;
+        }
+        std::this_thread::sleep_for(std::chrono::nanoseconds(displayTime - period - getTimestampNs()));
+    }
+
+    session->displayTime = displayTime;
+    session->inputDeadline = displayTime - static_cast<int64_t>(config.compositorLeadMs * 1e6);
+    session->frameNumber++;
+    g_counters.framesSynced++;
+
+    const glm::mat4 head = getHeadPose(displayTime - session->startTime);
+
+    for (int32_t i = 0; i < config.viewCount; i++) {
+        auto& view = frameInfo->views[i];
+        const float eyeOffset = (i % 2 == 0 ? -0.5f : 0.5f) * c_ipd;
+        const float fov = glm::radians(i < 2 ? c_contextFov : c_focusFov);
+        const glm::mat4 viewMat = glm::inverse(head * glm::translate(glm::mat4(1.0f), glm::vec3(eyeOffset, 0.0f, 0.0f)));
+        const glm::mat4 projMat = glm::perspective(fov, static_cast<float>(config.viewWidth) / config.viewHeight, 0.1f, 1000.0f);
+        copyMatrix(projMat, view.projectionMatrix);
+        copyMatrix(viewMat, view.viewMatrix);
+        view.preferredWidth = config.viewWidth;
+        view.preferredHeight = config.viewHeight;
+        view.enabled = varjo_True;
+    }
+    frameInfo->displayTime = displayTime;
+    frameInfo->frameNumber = session->frameNumber;
+}
+
+varjo_Nanoseconds varjo_FrameGetDisplayTime(struct varjo_Session* session)
+{
+    if (!session) {
+        setError(varjo_Error_InvalidSession);
+        return 0;
+    }
+    return session->displayTime;
+}
+
+//---------------------------------------------------------------------------
+// Layers and swap chains
+
+void varjo_BeginFrameWithLayers(struct varjo_Session* session)
+{
+    if (!session) {
+        setError(varjo_Error_InvalidSession);
+        return;
+    }
+    if (session->frameStarted) {
+        setError(varjo_Error_FrameAlreadyStarted);
+        return;
+    }
+    session->frameStarted = true;
+}
+
+void varjo_EndFrameWithLayers(struct varjo_Session* session, struct varjo_SubmitInfoLayers* submitInfo)
+{
+    if (!session || !submitInfo) {
+        setError(varjo_Error_NullPointer);
+        return;
+    }
+    if (!session->frameStarted) {
+        setError(varjo_Error_FrameNotStarted);
+        return;
+    }
+    session->frameStarted = false;
+
+    if (submitInfo->frameNumber != session->frameNumber) {
+        setError(varjo_Error_ValidationFailure);
+        return;
+    }
+
+    for (int32_t i = 0; i < submitInfo->layerCount; i++) {
+        const varjo_LayerHeader* header = submitInfo->layers[i];
+        if (header && header->type == varjo_LayerMultiProjType) {
+            const auto layer = reinterpret_cast<const varjo_LayerMultiProj*>(header);
+            if (layer->viewCount != session->config.viewCount || !layer->views) {
+                setError(varjo_Error_ValidationFailure);
+                return;
+            }
+
+            // Viewports must lie inside their swap chains
+            int64_t pixels = 0;
+            for (int32_t v = 0; v < layer->viewCount; v++) {
+                const varjo_SwapChainViewport& viewport = layer->views[v].viewport;
+                if (!viewport.swapChain || viewport.x < 0 || viewport.y < 0 || viewport.width <= 0 || viewport.height <= 0 ||
+                    viewport.x + viewport.width > viewport.swapChain->config.textureWidth ||
+                    viewport.y + viewport.height > viewport.swapChain->config.textureHeight) {
+                    setError(varjo_Error_ValidationFailure);
+                    return;
+                }
+                pixels += static_cast<int64_t>(viewport.width) * viewport.height;
+            }
+            g_counters.viewsSubmitted += layer->viewCount;
+            g_counters.viewPixelsSubmitted += pixels;
+        }
+    }
+
+    g_counters.layersSubmitted += submitInfo->layerCount;
+    g_counters.framesSubmitted++;
+}
+
+void varjo_AcquireSwapChainImage(struct varjo_SwapChain* swapChain, int32_t* index)
+{
+    if (!swapChain || !index) {
+        setError(varjo_Error_NullPointer);
+        return;
+    }
+    if (swapChain->acquired) {
+        setError(varjo_Error_AlreadyLocked);
+        return;
+    }
+    swapChain->acquired = true;
+    *index = swapChain->index;
+}
+
+void varjo_ReleaseSwapChainImage(struct varjo_SwapChain* swapChain)
+{
+    if (!swapChain) {
+        setError(varjo_Error_NullPointer);
+        return;
+    }
+    if (!swapChain->acquired) {
+        setError(varjo_Error_NotLocked);
+        return;
+    }
+    swapChain->acquired = false;
+    swapChain->index = (swapChain->index + 1) % swapChain->config.numberOfTextures;
+}
+
+struct varjo_Texture varjo_GetSwapChainImage(struct varjo_SwapChain* swapChain, int32_t index)
+{
+    varjo_Texture texture{};
+    if (!swapChain || index < 0 || index >= swapChain->config.numberOfTextures) {
+        setError(varjo_Error_IndexOutOfBounds);
+    }
+    return texture;
+}
+
+void varjo_FreeSwapChain(struct varjo_SwapChain* swapChain) { delete swapChain; }
+
+//---------------------------------------------------------------------------
+// Gaze
+
+void varjo_GazeInit(struct varjo_Session* session)
+{
+    if (!session) {
+        setError(varjo_Error_InvalidSession);
+        return;
+    }
+    session->gazeInitialized = true;
+}
+
+varjo_Bool varjo_IsGazeAllowed(struct varjo_Session* session)
+{
+    if (!session) {
+        setError(varjo_Error_InvalidSession);
+        return varjo_False;
+    }
+    return varjo_True;
+}
+
+struct varjo_Gaze varjo_GetGaze(struct varjo_Session* session)
+{
+    varjo_Gaze gaze{};
+    if (!session) {
+        setError(varjo_Error_InvalidSession);
+        return gaze;
+    }
+    if (!session->gazeInitialized) {
+        setError(varjo_Error_GazeNotInitialized);
+        return gaze;
+    }
+
+    // Gaze wanders slowly on a Lissajous curve, forward is +Z
+    const varjo_Nanoseconds now = getTimestampNs();
+    const float t = static_cast<float>(now - session->startTime) * 1e-9f;
+    const float yaw = c_gazeYawAmplitude * std::sin(0.7f * t);
+    const float pitch = c_gazePitchAmplitude * std::sin(1.1f * t);
+    const glm::vec3 forward = glm::normalize(glm::vec3(std::tan(yaw), std::tan(pitch), 1.0f));
+    for (varjo_Ray* ray : {&gaze.gaze, &gaze.leftEye, &gaze.rightEye}) {
+        ray->forward[0] = forward.x;
+        ray->forward[1] = forward.y;
+        ray->forward[2] = forward.z;
+    }
+    gaze.leftEye.origin[0] = -0.5 * c_ipd;
+    gaze.rightEye.origin[0] = 0.5 * c_ipd;
+    gaze.focusDistance = 1.0;
+    gaze.stability = 1.0;
+    gaze.captureTime = now;
+    gaze.leftStatus = varjo_GazeEyeStatus_Tracked;
+    gaze.rightStatus = varjo_GazeEyeStatus_Tracked;
+    gaze.status = varjo_GazeStatus_Valid;
+    gaze.frameNumber = session->frameNumber;
+    gaze.leftPupilSize = 0.5;
+    gaze.rightPupilSize = 0.5;
+    return gaze;
+}
+
+//---------------------------------------------------------------------------
+// Mixed reality
+
+void varjo_MRSetVideoRender(struct varjo_Session* session, varjo_Bool enabled)
+{
+    if (!session) {
+        setError(varjo_Error_InvalidSession);
+        return;
+    }
+    session->videoRender = enabled;
+}
+
+void varjo_MRSubmitShaderInputs(struct varjo_Session* session, varjo_ShaderType /*shaderType*/, const int32_t* /*textureIndices*/,
+    int32_t /*numTextureIndices*/, const char* constantBufferData, int32_t constantBufferSize)
+{
+    if (!session) {
+        setError(varjo_Error_InvalidSession);
+        return;
+    }
+    if (constantBufferSize > 0 && !constantBufferData) {
+        setError(varjo_Error_NullPointer);
+        return;
+    }
+    session->shaderConstants.assign(constantBufferData, constantBufferData + std::max(0, constantBufferSize));
+    g_counters.shaderInputsSubmitted++;
+    if (getTimestampNs() > session->inputDeadline) {
+        g_counters.shaderInputsLate++;
+    }
+}
+
+//---------------------------------------------------------------------------
+// Data streams
+
+int32_t varjo_GetDataStreamConfigCount(struct varjo_Session* session)
+{
+    if (!session) {
+        setError(varjo_Error_InvalidSession);
+        return 0;
+    }
+    return (session->config.streamWidth > 0 && session->config.streamHeight > 0) ? 1 : 0;
+}
+
+void varjo_GetDataStreamConfigs(struct varjo_Session* session, struct varjo_StreamConfig* configs, int32_t maxSize)
+{
+    if (maxSize > 0 && varjo_GetDataStreamConfigCount(session) > 0) {
+        configs[0] = getColorStreamConfig(session->config);
+    }
+}
+
+void varjo_StartDataStream(struct varjo_Session* session, varjo_StreamId id, varjo_ChannelFlag channels, varjo_FrameListener* callback, void* userData)
+{
+    if (!session || !callback) {
+        setError(varjo_Error_NullPointer);
+        return;
+    }
+    if (id != c_colorStreamId || varjo_GetDataStreamConfigCount(session) == 0 || findStream(session, id)) {
+        setError(varjo_Error_ValidationFailure);
+        return;
+    }
+
+    auto stream = std::make_unique<StandInStream>();
+    stream->session = session;
+    stream->config = getColorStreamConfig(session->config);
+    stream->channels = channels & stream->config.channelFlags;
+    stream->callback = callback;
+    stream->userData = userData;
+    for (int i = 0; i < 2; i++) {
+        fillStreamBuffer(stream->buffers[i], stream->config.width, stream->config.height, i, session->config);
+        stream->locked[i] = false;
+    }
+    stream->thread = std::thread(runStream, stream.get());
+
+    {
+        std::lock_guard<std::mutex> lock(session->streamMutex);
+        session->streams[id] = std::move(stream);
+    }
+    pushStreamEvent(varjo_EventType_DataStreamStart, id);
+}
+
+void varjo_StopDataStream(struct varjo_Session* session, varjo_StreamId id)
+{
+    if (!session) {
+        setError(varjo_Error_InvalidSession);
+        return;
+    }
+
+    std::unique_ptr<StandInStream> stream;
+    {
+        std::lock_guard<std::mutex> lock(session->streamMutex);
+        auto it = session->streams.find(id);
+        if (it == session->streams.end()) {
+            setError(varjo_Error_ValidationFailure);
+            return;
+        }
+        stream = std::move(it->second);
+        session->streams.erase(it);
+    }
+    stopStream(std::move(stream));
+    pushStreamEvent(varjo_EventType_DataStreamStop, id);
+}
+
+varjo_BufferId varjo_GetBufferId(struct varjo_Session* session, varjo_StreamId id, int64_t /*frameNumber*/, varjo_ChannelIndex index)
+{
+    if (!session || !findStream(session, id) || index < 0 || index > 1) {
+        setError(varjo_Error_IndexOutOfBounds);
+        return varjo_InvalidId;
+    }
+    return id * c_bufferIdStride + index;
+}
+
+void varjo_LockDataStreamBuffer(struct varjo_Session* session, varjo_BufferId id)
+{
+    int channel = 0;
+    if (StandInStream* stream = findBuffer(session, id, channel)) {
+        if (stream->locked[channel].exchange(true)) {
+            setError(varjo_Error_AlreadyLocked);
+        }
+    }
+}
+
+void varjo_UnlockDataStreamBuffer(struct varjo_Session* session, varjo_BufferId id)
+{
+    int channel = 0;
+    if (StandInStream* stream = findBuffer(session, id, channel)) {
+        if (!stream->locked[channel].exchange(false)) {
+            setError(varjo_Error_NotLocked);
+        }
+    }
+}
+
+struct varjo_BufferMetadata varjo_GetBufferMetadata(struct varjo_Session* session, varjo_BufferId id)
+{
+    varjo_BufferMetadata meta{};
+    int channel = 0;
+    if (StandInStream* stream = findBuffer(session, id, channel)) {
+        meta.format = stream->config.format;
+        meta.type = stream->config.bufferType;
+        meta.byteSize = static_cast<int32_t>(stream->buffers[channel].size());
+        meta.rowStride = stream->config.rowStride;
+        meta.width = stream->config.width;
+        meta.height = stream->config.height;
+    }
+    return meta;
+}
+
+void* varjo_GetBufferCPUData(struct varjo_Session* session, varjo_BufferId id)
+{
+    int channel = 0;
+    StandInStream* stream = findBuffer(session, id, channel);
+    if (!stream || !stream->locked[channel]) {
+        setError(varjo_Error_NotLocked);
+        return nullptr;
+    }
+    return stream->buffers[channel].data();
+}
+
+struct varjo_CameraIntrinsics varjo_GetCameraIntrinsics(
+    struct varjo_Session* /*session*/, varjo_StreamId /*id*/, int64_t /*frameNumber*/, varjo_ChannelIndex /*index*/)
+{
+    varjo_CameraIntrinsics intrinsics{};
+    intrinsics.model = varjo_IntrinsicsModel_Omnidir;
+    intrinsics.principalPointX = 0.5;
+    intrinsics.principalPointY = 0.5;
+    intrinsics.focalLengthX = 0.6;
+    intrinsics.focalLengthY = 0.6;
+    return intrinsics;
+}
+
+struct varjo_Matrix varjo_GetCameraExtrinsics(
+    struct varjo_Session* /*session*/, varjo_StreamId /*id*/, int64_t /*frameNumber*/, varjo_ChannelIndex index)
+{
+    const float offset = (index == varjo_ChannelIndex_Left ? -0.5f : 0.5f) * c_ipd;
+    return VarjoExamples::toVarjoMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(offset, 0.0f, 0.0f)));
+}
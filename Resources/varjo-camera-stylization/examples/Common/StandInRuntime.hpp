@@ -0,0 +1,95 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+
+#include <Varjo.h>
+#include <Varjo_events.h>
+#include <Varjo_layers.h>
+#include <Varjo_types_layers.h>
+
+#include "Globals.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Stand-in runtime implements the subset of Varjo API functions used by the example frame
+// loop and data streamer, so that frame path can be benchmarked and tested without a headset or
+// Varjo Base. Build the stand-in into a headless tool INSTEAD of linking VarjoLib, with
+// VARJORUNTIME_STATIC defined. Only one session can be active at a time.
+//
+// Frames are not rendered or composited. Swap chains have no textures and layer submissions are
+// only validated and counted. Data streams deliver synthetic YUV422 color frames from a stream
+// thread per started stream. A fiducial marker can be drawn into stream frames for testing
+// FiducialDetector. varjo_StopDataStream() waits for a running frame callback to return,
+// so do not call it while holding a lock taken in the callback. Starting and stopping streams
+// queues DataStreamStart and DataStreamStop events like the runtime does.
+//
+// Gaze is always allowed and valid, wandering slowly around view center. Occlusion meshes hide
+// the view corners outside a circle. Head pose sways slowly around the vertical axis. Frames get
+// the pose at their display time and stream frames the pose at their capture time.
+//
+// Compositor takes shader inputs of a frame compositorLeadMs before its display time. Shader
+// inputs submitted after that are counted late, since a real compositor would use them only for
+// the next frame.
+
+//! Controls and inspects the stand-in Varjo runtime
+class StandInRuntime
+{
+public:
+    //! Runtime configuration. Applied on varjo_SessionInit().
+    struct Config {
+        int32_t viewCount = 4;          //!< Number of views: 2 context views, optionally followed by 2 focus views
+        int32_t viewWidth = 1152;       //!< View width in pixels
+        int32_t viewHeight = 1152;      //!< View height in pixels
+        double frameRate = 90.0;        //!< Display refresh rate
+        bool throttle = false;          //!< Pace varjo_WaitSync() to frame rate instead of returning immediately
+        bool mrAvailable = true;        //!< Report mixed reality hardware available
+        int32_t streamWidth = 1152;     //!< Color stream frame width, zero for no color stream
+        int32_t streamHeight = 1152;    //!< Color stream frame height
+        int32_t streamFrameRate = 90;   //!< Color stream frame rate
+        int32_t streamMarkerId = -1;    //!< Fiducial marker id drawn at color stream frame center, -1 for none
+        int32_t streamMarkerCell = 16;  //!< Fiducial marker cell size in pixels
+        double compositorLeadMs = 2.0;  //!< Time before display time when compositor takes shader inputs
+    };
+
+    //! Runtime statistics
+    struct Stats {
+        int64_t framesSynced = 0;           //!< varjo_WaitSync() calls
+        int64_t framesSubmitted = 0;        //!< varjo_EndFrameWithLayers() calls
+        int64_t layersSubmitted = 0;        //!< Submitted layers
+        int64_t viewsSubmitted = 0;         //!< Submitted multi projection views
+        int64_t viewPixelsSubmitted = 0;    //!< Pixels in submitted color viewports of multi projection views
+        int64_t eventsPolled = 0;           //!< Events returned from varjo_PollEvent()
+        int64_t shaderInputsSubmitted = 0;  //!< varjo_MRSubmitShaderInputs() calls
+        int64_t shaderInputsLate = 0;       //!< varjo_MRSubmitShaderInputs() calls after compositor deadline of last synced frame
+        int64_t streamFramesDelivered = 0;  //!< Data stream frame callbacks
+        int64_t streamFramesSkipped = 0;    //!< Data stream frames skipped because callback was late
+        int64_t errors = 0;                 //!< API misuse errors raised
+    };
+
+    //! Set configuration for next session
+    static void configure(const Config& config);
+
+    //! Returns configuration of current or next session
+    static Config getConfig();
+
+    //! Queue event to be returned from varjo_PollEvent(). Can be called from any thread.
+    static void pushEvent(const varjo_Event& evt);
+
+    //! Stop all data streams of current session as if runtime stopped them, e.g. on camera disconnect.
+    //! Queues DataStreamStop events. Returns number of stopped streams.
+    static int interruptDataStreams();
+
+    //! Create swap chain without graphics API textures
+    static varjo_SwapChain* createSwapChain(varjo_Session* session, const varjo_SwapChainConfig2& config);
+
+    //! Returns statistics since session init
+    static Stats getStats();
+
+private:
+    //! Static interface only
+    StandInRuntime() = delete;
+};
+
+}  // namespace VarjoExamples
@@ -0,0 +1,678 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "StereoMatcher.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "SimdMath.hpp"
+#include "CameraModel.hpp"
+
+using namespace VarjoExamples;
+
+namespace
+{
+// Census window radius. 5x5 window without center gives 24 bits.
+constexpr int c_censusRadius = 2;
+
+// Largest matching cost, used for disparities that fall outside the right image
+constexpr uint8_t c_maxCost = 24;
+
+// Path cost buffer padding in elements before and after disparities of each pixel. Padding
+// holds largest cost, so that neighbour disparities at range ends never win.
+constexpr int c_pathPadding = 16;
+
+// Largest supported disparity range
+constexpr int c_maxDisparities = 256;
+
+// Columns per vertical path task
+constexpr int c_columnGrain = 16;
+
+// Convert between OpenCV camera space used for matching (Y down, Z forward) and Varjo camera space (Y up, Z backward)
+const glm::dmat3 c_cvToCamera(1.0, 0.0, 0.0, 0.0, -1.0, 0.0, 0.0, 0.0, -1.0);
+
+// Call function with SIMD variant tag
+template <typename F>
+void dispatchSimd(SimdLevel level, F&& func)
+{
+    switch (level) {
+        case SimdLevel::AVX2: func(Simd::AVX2()); break;
+        case SimdLevel::SSE41: func(Simd::SSE41()); break;
+        default: func(Simd::Scalar()); break;
+    }
+}
+
+// Number of set bits
+inline uint32_t popcount(uint32_t v)
+{
+    v = v - ((v >> 1) & 0x55555555u);
+    v = (v & 0x33333333u) + ((v >> 2) & 0x33333333u);
+    return (((v + (v >> 4)) & 0x0f0f0f0fu) * 0x01010101u) >> 24;
+}
+
+//---------------------------------------------------------------------------
+// Census transform. Bit k is set if k:th window neighbour in row order is brighter than center.
+
+// Census of pixels [x0, x1) of row y. Window must fit in image for all pixels.
+template <typename V>
+void censusRow(const uint8_t* image, int width, int y, int x0, int x1, uint32_t* out);
+
+template <>
+void censusRow<Simd::Scalar>(const uint8_t* image, int width, int y, int x0, int x1, uint32_t* out)
+{
+    for (int x = x0; x < x1; x++) {
+        const uint8_t center = image[y * width + x];
+        uint32_t bits = 0;
+        int k = 0;
+        for (int dy = -c_censusRadius; dy <= c_censusRadius; dy++) {
+            const uint8_t* row = image + (y + dy) * width + x;
+            for (int dx = -c_censusRadius; dx <= c_censusRadius; dx++) {
+                if (dx != 0 || dy != 0) {
+                    bits |= static_cast<uint32_t>(row[dx] > center) << k++;
+                }
+            }
+        }
+        out[x] = bits;
+    }
+}
+
+template <>
+void censusRow<Simd::SSE41>(const uint8_t* image, int width, int y, int x0, int x1, uint32_t* out)
+{
+    // Signed byte compare after flipping sign bits compares unsigned values
+    const __m128i sign = _mm_set1_epi8(static_cast<char>(0x80));
+    const __m128i zero = _mm_setzero_si128();
+    int x = x0;
+    for (; x + 16 <= x1; x += 16) {
+        const __m128i center = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(image + y * width + x)), sign);
+        __m128i planes[3] = {zero, zero, zero};
+        int k = 0;
+        for (int dy = -c_censusRadius; dy <= c_censusRadius; dy++) {
+            const uint8_t* row = image + (y + dy) * width + x;
+            for (int dx = -c_censusRadius; dx <= c_censusRadius; dx++) {
+                if (dx != 0 || dy != 0) {
+                    const __m128i n = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(row + dx)), sign);
+                    const __m128i bit = _mm_and_si128(_mm_cmpgt_epi8(n, center), _mm_set1_epi8(static_cast<char>(1 << (k & 7))));
+                    planes[k >> 3] = _mm_or_si128(planes[k >> 3], bit);
+                    k++;
+                }
+            }
+        }
+
+        // Interleave bit planes to 32-bit census per pixel
+        const __m128i lo = _mm_unpacklo_epi8(planes[0], planes[1]);
+        const __m128i hi = _mm_unpackhi_epi8(planes[0], planes[1]);
+        const __m128i lo2 = _mm_unpacklo_epi8(planes[2], zero);
+        const __m128i hi2 = _mm_unpackhi_epi8(planes[2], zero);
+        __m128i* dst = reinterpret_cast<__m128i*>(out + x);
+        _mm_storeu_si128(dst + 0, _mm_unpacklo_epi16(lo, lo2));
+        _mm_storeu_si128(dst + 1, _mm_unpackhi_epi16(lo, lo2));
+        _mm_storeu_si128(dst + 2, _mm_unpacklo_epi16(hi, hi2));
+        _mm_storeu_si128(dst + 3, _mm_unpackhi_epi16(hi, hi2));
+    }
+    censusRow<Simd::Scalar>(image, width, y, x, x1, out);
+}
+
+//---------------------------------------------------------------------------
+// Matching cost. Right census row is reversed, so that right pixels x - d for increasing d are consecutive.
+
+// Hamming costs of left pixel census against reversed right census from disparity zero on
+template <typename V>
+void costPixel(uint32_t census, const uint32_t* reversed, int disparities, uint8_t* out);
+
+template <>
+void costPixel<Simd::Scalar>(uint32_t census, const uint32_t* reversed, int disparities, uint8_t* out)
+{
+    for (int d = 0; d < disparities; d++) {
+        out[d] = static_cast<uint8_t>(popcount(census ^ reversed[d]));
+    }
+}
+
+template <>
+void costPixel<Simd::SSE41>(uint32_t census, const uint32_t* reversed, int disparities, uint8_t* out)
+{
+    const __m128i left = _mm_set1_epi32(static_cast<int>(census));
+    const __m128i nibbles = _mm_set1_epi8(0x0f);
+    const __m128i lut = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m128i ones8 = _mm_set1_epi8(1);
+    const __m128i ones16 = _mm_set1_epi16(1);
+
+    // Count bits per byte with nibble lookup and sum bytes of each 32-bit lane
+    const auto count = [&](const uint32_t* p) {
+        const __m128i v = _mm_xor_si128(left, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+        const __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(v, nibbles));
+        const __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(v, 4), nibbles));
+        return _mm_madd_epi16(_mm_maddubs_epi16(_mm_add_epi8(lo, hi), ones8), ones16);
+    };
+    for (int d = 0; d < disparities; d += 16) {
+        const __m128i c01 = _mm_packs_epi32(count(reversed + d), count(reversed + d + 4));
+        const __m128i c23 = _mm_packs_epi32(count(reversed + d + 8), count(reversed + d + 12));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + d), _mm_packus_epi16(c01, c23));
+    }
+}
+
+//---------------------------------------------------------------------------
+// Path aggregation of one pixel:
+//
+//   L(p, d) = C(p, d) + min(L(p-r, d), L(p-r, d+-1) + P1, min L(p-r) + P2) - min L(p-r)
+//
+// Previous and current path costs are padded with c_pathPadding elements on both sides. Path
+// cost is stored to sum, or added to it when accumulating. Returns smallest current path cost.
+
+template <typename V>
+uint16_t aggregatePixel(const uint8_t* cost, const uint16_t* prev, uint16_t minPrev, uint16_t* cur, uint16_t* sum, bool accumulate, int disparities, int p1,
+    int p2);
+
+template <>
+uint16_t aggregatePixel<Simd::Scalar>(const uint8_t* cost, const uint16_t* prev, uint16_t minPrev, uint16_t* cur, uint16_t* sum, bool accumulate,
+    int disparities, int p1, int p2)
+{
+    const int jump = std::min(minPrev + p2, 0xffff);
+    uint16_t minCur = 0xffff;
+    for (int d = 0; d < disparities; d++) {
+        const int best = std::min(std::min<int>(prev[d], jump), std::min(std::min(prev[d - 1] + p1, prev[d + 1] + p1), 0xffff));
+        const uint16_t value = static_cast<uint16_t>(std::min(cost[d] + best - minPrev, 0xffff));
+        cur[d] = value;
+        sum[d] = static_cast<uint16_t>(accumulate ? std::min(sum[d] + value, 0xffff) : value);
+        minCur = std::min(minCur, value);
+    }
+    return minCur;
+}
+
+template <>
+uint16_t aggregatePixel<Simd::SSE41>(const uint8_t* cost, const uint16_t* prev, uint16_t minPrev, uint16_t* cur, uint16_t* sum, bool accumulate,
+    int disparities, int p1, int p2)
+{
+    const __m128i penalty1 = _mm_set1_epi16(static_cast<short>(p1));
+    const __m128i jump = _mm_adds_epu16(_mm_set1_epi16(static_cast<short>(minPrev)), _mm_set1_epi16(static_cast<short>(p2)));
+    const __m128i base = _mm_set1_epi16(static_cast<short>(minPrev));
+    __m128i minCur = _mm_set1_epi16(-1);
+    for (int d = 0; d < disparities; d += 8) {
+        const __m128i same = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + d));
+        const __m128i lower = _mm_adds_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + d - 1)), penalty1);
+        const __m128i upper = _mm_adds_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + d + 1)), penalty1);
+        const __m128i best = _mm_min_epu16(_mm_min_epu16(same, jump), _mm_min_epu16(lower, upper));
+        const __m128i c = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(cost + d)));
+        const __m128i value = _mm_adds_epu16(c, _mm_subs_epu16(best, base));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(cur + d), value);
+        __m128i* s = reinterpret_cast<__m128i*>(sum + d);
+        _mm_storeu_si128(s, accumulate ? _mm_adds_epu16(_mm_loadu_si128(s), value) : value);
+        minCur = _mm_min_epu16(minCur, value);
+    }
+    return static_cast<uint16_t>(_mm_cvtsi128_si32(_mm_minpos_epu16(minCur)));
+}
+
+template <>
+uint16_t aggregatePixel<Simd::AVX2>(const uint8_t* cost, const uint16_t* prev, uint16_t minPrev, uint16_t* cur, uint16_t* sum, bool accumulate,
+    int disparities, int p1, int p2)
+{
+    const __m256i penalty1 = _mm256_set1_epi16(static_cast<short>(p1));
+    const __m256i jump = _mm256_adds_epu16(_mm256_set1_epi16(static_cast<short>(minPrev)), _mm256_set1_epi16(static_cast<short>(p2)));
+    const __m256i base = _mm256_set1_epi16(static_cast<short>(minPrev));
+    __m256i minCur = _mm256_set1_epi16(-1);
+    for (int d = 0; d < disparities; d += 16) {
+        const __m256i same = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev + d));
+        const __m256i lower = _mm256_adds_epu16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev + d - 1)), penalty1);
+        const __m256i upper = _mm256_adds_epu16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev + d + 1)), penalty1);
+        const __m256i best = _mm256_min_epu16(_mm256_min_epu16(same, jump), _mm256_min_epu16(lower, upper));
+        const __m256i c = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(cost + d)));
+        const __m256i value = _mm256_adds_epu16(c, _mm256_subs_epu16(best, base));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(cur + d), value);
+        __m256i* s = reinterpret_cast<__m256i*>(sum + d);
+        _mm256_storeu_si256(s, accumulate ? _mm256_adds_epu16(_mm256_loadu_si256(s), value) : value);
+        minCur = _mm256_min_epu16(minCur, value);
+    }
+    const __m128i half = _mm_min_epu16(_mm256_castsi256_si128(minCur), _mm256_extracti128_si256(minCur, 1));
+    return static_cast<uint16_t>(_mm_cvtsi128_si32(_mm_minpos_epu16(half)));
+}
+
+//---------------------------------------------------------------------------
+// Disparity selection
+
+// Returns disparity with smallest aggregated cost, smallest disparity on ties
+template <typename V>
+int selectPixel(const uint16_t* sum, int disparities);
+
+template <>
+int selectPixel<Simd::Scalar>(const uint16_t* sum, int disparities)
+{
+    return static_cast<int>(std::min_element(sum, sum + disparities) - sum);
+}
+
+template <>
+int selectPixel<Simd::SSE41>(const uint16_t* sum, int disparities)
+{
+    // Position of minimum is in bits 16-18 of minpos result, value in bits 0-15
+    int best = 0;
+    uint32_t bestValue = 0xffff + 1;
+    for (int d = 0; d < disparities; d += 8) {
+        const uint32_t r = static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_minpos_epu16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(sum + d)))));
+        if ((r & 0xffff) < bestValue) {
+            bestValue = r & 0xffff;
+            best = d + static_cast<int>((r >> 16) & 7);
+        }
+    }
+    return best;
+}
+
+// Offer aggregated costs of left pixel to right pixels x - d. Best keys of right pixels are reversed like right
+// census, key is cost in high and disparity in low 16 bits, so that smallest key has smallest cost and disparity.
+template <typename V>
+void offerRight(const uint16_t* sum, int disparities, uint32_t* reversedBest);
+
+template <>
+void offerRight<Simd::Scalar>(const uint16_t* sum, int disparities, uint32_t* reversedBest)
+{
+    for (int d = 0; d < disparities; d++) {
+        reversedBest[d] = std::min(reversedBest[d], (static_cast<uint32_t>(sum[d]) << 16) | static_cast<uint32_t>(d));
+    }
+}
+
+template <>
+void offerRight<Simd::SSE41>(const uint16_t* sum, int disparities, uint32_t* reversedBest)
+{
+    __m128i d = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i step = _mm_set1_epi32(4);
+    for (int i = 0; i < disparities; i += 4) {
+        const __m128i cost = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(sum + i)));
+        const __m128i key = _mm_or_si128(_mm_slli_epi32(cost, 16), d);
+        __m128i* best = reinterpret_cast<__m128i*>(reversedBest + i);
+        _mm_storeu_si128(best, _mm_min_epu32(_mm_loadu_si128(best), key));
+        d = _mm_add_epi32(d, step);
+    }
+}
+
+// AVX2 does not widen census, cost and selection, they run the SSE 4.1 variant
+template <typename V>
+struct RowVariant {
+    using Type = V;
+};
+
+template <>
+struct RowVariant<Simd::AVX2> {
+    using Type = Simd::SSE41;
+};
+
+}  // namespace
+
+namespace VarjoExamples
+{
+StereoMatcher::StereoMatcher(ThreadPool& threadPool, const Config& config)
+    : m_threadPool(threadPool)
+    , m_config(config)
+{
+}
+
+bool StereoMatcher::addImage(varjo_ChannelIndex channel, const uint8_t* luma, int width, int height, size_t rowStride,
+    const varjo_CameraIntrinsics& intrinsics, const varjo_Matrix& extrinsics, int64_t frameNumber)
+{
+    if (channel != varjo_ChannelIndex_Left && channel != varjo_ChannelIndex_Right) {
+        return false;
+    }
+    const int index = (channel == varjo_ChannelIndex_Left) ? 0 : 1;
+    Image& image = m_images[index];
+    const Image& other = m_images[1 - index];
+
+    // Rectification depends on both cameras, so it is rebuilt when either calibration changes
+    if (!image.calibrated || std::memcmp(&image.intrinsics, &intrinsics, sizeof(intrinsics)) != 0 ||
+        std::memcmp(&image.extrinsics, &extrinsics, sizeof(extrinsics)) != 0) {
+        image.calibrated = true;
+        image.intrinsics = intrinsics;
+        image.extrinsics = extrinsics;
+        m_rect.valid = false;
+    }
+
+    // Image that was rectified but never matched is dropped
+    if (image.frameNumber >= 0 && image.frameNumber != m_matchedFrame) {
+        m_stats.skipped++;
+    }
+    image.frameNumber = -1;
+
+    if (!m_rect.valid || width != m_sourceWidth || height != m_sourceHeight) {
+        if (!other.calibrated || !buildRectification(width, height)) {
+            m_stats.skipped++;
+            return false;
+        }
+    }
+
+    const int64_t begin = getTimestampNs();
+    rectify(image, luma, width, height, rowStride);
+    image.rectifyTimeNs = getTimestampNs() - begin;
+    image.frameNumber = frameNumber;
+    m_stats.rectifyTimeNs += image.rectifyTimeNs;
+    return other.frameNumber == frameNumber;
+}
+
+bool StereoMatcher::match()
+{
+    const Image& left = m_images[0];
+    const Image& right = m_images[1];
+    if (!m_rect.valid || left.frameNumber < 0 || left.frameNumber != right.frameNumber) {
+        return false;
+    }
+
+    const int width = m_rect.width;
+    const int height = m_rect.height;
+    const int disparities = m_config.maxDisparity;
+    const size_t pixels = static_cast<size_t>(width) * height;
+    const int p1 = m_config.penalty1;
+    const int p2 = m_config.penalty2;
+    const int64_t begin = getTimestampNs();
+
+    // Buffers keep their size between matches
+    const size_t reversedStride = static_cast<size_t>(width) + disparities;
+    const size_t pathStride = static_cast<size_t>(disparities) + 2 * c_pathPadding;
+    m_reversed.resize(reversedStride * height);
+    m_costs.resize(pixels * disparities);
+    m_aggregated.resize(pixels * disparities);
+    m_pathRows.resize(4 * pathStride * width);
+    m_pathMins.resize(2 * width);
+    m_rightBest.resize(reversedStride * height);
+    m_disparity.resize(pixels);
+
+    dispatchSimd(m_config.simd, [&](auto simd) {
+        using V = decltype(simd);
+        using R = typename RowVariant<V>::Type;
+
+        // Census of both images, right one stored reversed per row
+        m_threadPool.parallelFor(height, [&](int y0, int y1) {
+            for (int y = y0; y < y1; y++) {
+                for (int i = 0; i < 2; i++) {
+                    uint32_t* census = m_images[i].census.data() + static_cast<size_t>(y) * width;
+                    if (y < c_censusRadius || y >= height - c_censusRadius) {
+                        std::fill(census, census + width, 0);
+                        continue;
+                    }
+                    std::fill(census, census + c_censusRadius, 0);
+                    std::fill(census + width - c_censusRadius, census + width, 0);
+                    censusRow<R>(m_images[i].pixels.data(), width, y, c_censusRadius, width - c_censusRadius, census);
+                }
+
+                const uint32_t* rightCensus = m_images[1].census.data() + static_cast<size_t>(y) * width;
+                uint32_t* reversed = m_reversed.data() + y * reversedStride;
+                std::reverse_copy(rightCensus, rightCensus + width, reversed);
+                std::fill(reversed + width, reversed + reversedStride, 0);
+            }
+        });
+
+        // Costs per pixel and disparity. Right pixels x - d < 0 are outside the image.
+        m_threadPool.parallelFor(height, [&](int y0, int y1) {
+            for (int y = y0; y < y1; y++) {
+                const uint32_t* census = m_images[0].census.data() + static_cast<size_t>(y) * width;
+                const uint32_t* reversed = m_reversed.data() + y * reversedStride;
+                uint8_t* costs = m_costs.data() + static_cast<size_t>(y) * width * disparities;
+                for (int x = 0; x < width; x++) {
+                    uint8_t* out = costs + static_cast<size_t>(x) * disparities;
+                    costPixel<R>(census[x], reversed + (width - 1 - x), disparities, out);
+                    if (x + 1 < disparities) {
+                        std::fill(out + x + 1, out + disparities, c_maxCost);
+                    }
+                }
+            }
+        });
+        const int64_t costEnd = getTimestampNs();
+
+        // Left to right and right to left paths per row, first path stores the sum
+        m_threadPool.parallelFor(height, [&](int y0, int y1) {
+            uint16_t rows[2 * (c_maxDisparities + 2 * c_pathPadding)];
+            std::fill(rows, rows + 2 * pathStride, 0xffff);
+            for (int y = y0; y < y1; y++) {
+                const uint8_t* costs = m_costs.data() + static_cast<size_t>(y) * width * disparities;
+                uint16_t* sums = m_aggregated.data() + static_cast<size_t>(y) * width * disparities;
+                for (int direction = 0; direction < 2; direction++) {
+                    uint16_t* prev = rows + c_pathPadding;
+                    uint16_t* cur = prev + pathStride;
+                    std::fill(prev, prev + disparities, 0);
+                    uint16_t minPrev = 0;
+                    for (int i = 0; i < width; i++) {
+                        const size_t offset = static_cast<size_t>(direction == 0 ? i : width - 1 - i) * disparities;
+                        minPrev = aggregatePixel<V>(costs + offset, prev, minPrev, cur, sums + offset, direction != 0, disparities, p1, p2);
+                        std::swap(prev, cur);
+                    }
+                }
+            }
+        });
+
+        // Top to bottom and bottom to top paths per column range, added to the sum
+        m_threadPool.parallelFor(width, [&](int x0, int x1) {
+            for (int direction = 0; direction < 2; direction++) {
+                uint16_t* prevRow = m_pathRows.data() + direction * 2 * pathStride * width;
+                uint16_t* curRow = prevRow + pathStride * width;
+                uint16_t* minPrev = m_pathMins.data() + direction * width;
+                for (int x = x0; x < x1; x++) {
+                    uint16_t* prev = prevRow + x * pathStride;
+                    uint16_t* cur = curRow + x * pathStride;
+                    std::fill(prev, prev + pathStride, 0xffff);
+                    std::fill(cur, cur + pathStride, 0xffff);
+                    std::fill(prev + c_pathPadding, prev + c_pathPadding + disparities, 0);
+                    minPrev[x] = 0;
+                }
+                for (int i = 0; i < height; i++) {
+                    const size_t rowOffset = static_cast<size_t>(direction == 0 ? i : height - 1 - i) * width * disparities;
+                    for (int x = x0; x < x1; x++) {
+                        const size_t offset = rowOffset + static_cast<size_t>(x) * disparities;
+                        uint16_t* prev = prevRow + x * pathStride + c_pathPadding;
+                        uint16_t* cur = curRow + x * pathStride + c_pathPadding;
+                        minPrev[x] = aggregatePixel<V>(m_costs.data() + offset, prev, minPrev[x], cur, m_aggregated.data() + offset, true, disparities,
+                            p1, p2);
+                    }
+                    std::swap(prevRow, curRow);
+                }
+            }
+        }, c_columnGrain);
+        const int64_t aggregateEnd = getTimestampNs();
+
+        // Winner takes all per pixel, right disparities from the same sums, then left right check. Offers to
+        // right pixels x - d < 0 land in padding of reversed row and are never read.
+        m_validPixels = 0;
+        m_threadPool.parallelFor(height, [&](int y0, int y1) {
+            int64_t valid = 0;
+            for (int y = y0; y < y1; y++) {
+                const uint16_t* sums = m_aggregated.data() + static_cast<size_t>(y) * width * disparities;
+                uint32_t* rightBest = m_rightBest.data() + y * reversedStride;
+                std::fill(rightBest, rightBest + reversedStride, 0xffffffffu);
+                for (int x = 0; x < width; x++) {
+                    offerRight<R>(sums + static_cast<size_t>(x) * disparities, disparities, rightBest + (width - 1 - x));
+                }
+
+                const int32_t* remap = m_images[0].remapOffsets.data() + static_cast<size_t>(y) * width;
+                float* out = m_disparity.data() + static_cast<size_t>(y) * width;
+                for (int x = 0; x < width; x++) {
+                    const uint16_t* s = sums + static_cast<size_t>(x) * disparities;
+                    const int d = selectPixel<R>(s, disparities);
+                    const int rightD = static_cast<int>(rightBest[width - 1 - x + d] & 0xffff);
+                    const bool border = x < c_censusRadius || x >= width - c_censusRadius || y < c_censusRadius || y >= height - c_censusRadius;
+                    if (border || remap[x] < 0 || d > x || std::abs(rightD - d) > m_config.lrTolerance) {
+                        out[x] = -1.0f;
+                        continue;
+                    }
+
+                    // Parabola through neighbour costs
+                    float refined = static_cast<float>(d);
+                    if (d > 0 && d < disparities - 1) {
+                        const int c0 = s[d - 1];
+                        const int c2 = s[d + 1];
+                        const int curvature = c0 + c2 - 2 * s[d];
+                        if (curvature > 0) {
+                            refined += std::max(-0.5f, std::min(0.5f, static_cast<float>(c0 - c2) / (2.0f * curvature)));
+                        }
+                    }
+                    out[x] = refined;
+                    valid++;
+                }
+            }
+            m_validPixels += valid;
+        });
+        const int64_t selectEnd = getTimestampNs();
+
+        m_stats.costTimeNs += costEnd - begin;
+        m_stats.aggregateTimeNs += aggregateEnd - costEnd;
+        m_stats.selectTimeNs += selectEnd - aggregateEnd;
+    });
+
+    const int64_t timeNs = getTimestampNs() - begin + left.rectifyTimeNs + right.rectifyTimeNs;
+    m_stats.pairs++;
+    m_stats.lastTimeNs = timeNs;
+    m_stats.totalTimeNs += timeNs;
+    m_stats.maxTimeNs = std::max(m_stats.maxTimeNs, timeNs);
+    m_stats.validFraction = static_cast<double>(m_validPixels) / pixels;
+    m_matchedFrame = left.frameNumber;
+
+    if (m_metrics) {
+        m_metrics->recordTime(m_matchMetric, timeNs);
+        m_metrics->set(m_validMetric, static_cast<int64_t>(m_stats.validFraction * 100.0));
+    }
+    return true;
+}
+
+void StereoMatcher::setMetrics(MetricsRegistry* metrics)
+{
+    m_metrics = metrics;
+    if (m_metrics) {
+        m_matchMetric = m_metrics->addMetric("Stereo: match", MetricsRegistry::Kind::Timer);
+        m_validMetric = m_metrics->addMetric("Stereo: valid percent", MetricsRegistry::Kind::Gauge);
+    }
+}
+
+bool StereoMatcher::buildRectification(int sourceWidth, int sourceHeight)
+{
+    const int downscale = std::max(m_config.downscale, 1);
+    if (m_config.maxDisparity <= 0 || m_config.maxDisparity % 16 != 0 || m_config.maxDisparity > c_maxDisparities) {
+        LOGE("Invalid stereo disparity range: %d", m_config.maxDisparity);
+        return false;
+    }
+
+    // Camera axes in HMD space
+    glm::dmat3 rotations[2];
+    for (int i = 0; i < 2; i++) {
+        const glm::dmat4 pose(fromVarjoMatrix(m_images[i].extrinsics));
+        rotations[i] = glm::dmat3(pose) * c_cvToCamera;
+        m_rect.origins[i] = glm::dvec3(pose[3]);
+    }
+
+    // Rectified X axis along baseline, Z axis closest to mean optical axis of cameras
+    const glm::dvec3 baseline = m_rect.origins[1] - m_rect.origins[0];
+    const double length = glm::length(baseline);
+    if (length < 1e-4 || glm::dot(baseline, rotations[0][0]) < 0.5 * length) {
+        LOGE("Stereo cameras are not side by side, right camera at (%.3f, %.3f, %.3f) from left", baseline.x, baseline.y, baseline.z);
+        return false;
+    }
+    const glm::dvec3 xAxis = baseline / length;
+    const glm::dvec3 forward = rotations[0][2] + rotations[1][2];
+    const glm::dvec3 zAxis = glm::normalize(forward - glm::dot(forward, xAxis) * xAxis);
+    const glm::dvec3 yAxis = glm::cross(zAxis, xAxis);
+
+    // Rectified pinhole keeps vertical focal length of source at center
+    const double focalY = 0.5 * (m_images[0].intrinsics.focalLengthY + m_images[1].intrinsics.focalLengthY) * sourceHeight;
+    m_rect.width = sourceWidth / downscale;
+    m_rect.height = sourceHeight / downscale;
+    m_rect.focal = focalY / downscale;
+    m_rect.center = glm::dvec2(0.5 * m_rect.width - 0.5, 0.5 * m_rect.height - 0.5);
+    m_rect.baseline = length;
+    m_rect.rotation = glm::dmat3(xAxis, yAxis, zAxis);
+    m_sourceWidth = sourceWidth;
+    m_sourceHeight = sourceHeight;
+
+    const size_t pixels = static_cast<size_t>(m_rect.width) * m_rect.height;
+    for (int i = 0; i < 2; i++) {
+        Image& image = m_images[i];
+        image.downscaled.resize(static_cast<size_t>(sourceWidth / downscale) * (sourceHeight / downscale));
+        image.remapOffsets.resize(pixels);
+        image.remapWeights.resize(pixels);
+        image.pixels.resize(pixels);
+        image.census.resize(pixels);
+        image.frameNumber = -1;
+        buildRemap(image, rotations[i]);
+    }
+
+    m_rect.valid = true;
+    LOGI("Stereo rectification: %dx%d, focal %.1f px, baseline %.1f mm", m_rect.width, m_rect.height, m_rect.focal, m_rect.baseline * 1000.0);
+    return true;
+}
+
+void StereoMatcher::buildRemap(Image& image, const glm::dmat3& cameraRotation)
+{
+    const int downscale = std::max(m_config.downscale, 1);
+    const int sourceWidth = m_sourceWidth / downscale;
+    const int sourceHeight = m_sourceHeight / downscale;
+    const CameraModel camera(image.intrinsics, m_sourceWidth, m_sourceHeight);
+    const glm::dmat3 toCamera = glm::transpose(cameraRotation) * m_rect.rotation;
+
+    m_threadPool.parallelFor(m_rect.height, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            for (int x = 0; x < m_rect.width; x++) {
+                const size_t index = static_cast<size_t>(y) * m_rect.width + x;
+                image.remapOffsets[index] = -1;
+                image.remapWeights[index] = 0;
+
+                // Source pixel centers of box downscaled image are at downscale - 1 / 2 source pixels
+                const glm::dvec3 ray((x - m_rect.center.x) / m_rect.focal, (y - m_rect.center.y) / m_rect.focal, 1.0);
+                glm::dvec2 pixel;
+                if (!camera.project(toCamera * ray, pixel)) {
+                    continue;
+                }
+                const double sx = (pixel.x + 0.5) / downscale - 0.5;
+                const double sy = (pixel.y + 0.5) / downscale - 0.5;
+                if (sx < 0.0 || sy < 0.0 || sx >= sourceWidth - 1 || sy >= sourceHeight - 1) {
+                    continue;
+                }
+                const int ix = static_cast<int>(sx);
+                const int iy = static_cast<int>(sy);
+                const int wx = std::min(static_cast<int>((sx - ix) * 256.0 + 0.5), 255);
+                const int wy = std::min(static_cast<int>((sy - iy) * 256.0 + 0.5), 255);
+                image.remapOffsets[index] = iy * sourceWidth + ix;
+                image.remapWeights[index] = static_cast<uint16_t>(wx | (wy << 8));
+            }
+        }
+    });
+}
+
+void StereoMatcher::rectify(Image& image, const uint8_t* luma, int width, int height, size_t rowStride)
+{
+    const int downscale = std::max(m_config.downscale, 1);
+    const int sourceWidth = width / downscale;
+    const int sourceHeight = height / downscale;
+    const int area = downscale * downscale;
+
+    // Box downscale
+    m_threadPool.parallelFor(sourceHeight, [&](int y0, int y1) {
+        for (int y = y0; y < y1; y++) {
+            const uint8_t* block = luma + static_cast<size_t>(y) * downscale * rowStride;
+            uint8_t* out = image.downscaled.data() + static_cast<size_t>(y) * sourceWidth;
+            for (int x = 0; x < sourceWidth; x++) {
+                uint32_t sum = 0;
+                for (int dy = 0; dy < downscale; dy++) {
+                    const uint8_t* p = block + dy * rowStride + x * downscale;
+                    for (int dx = 0; dx < downscale; dx++) {
+                        sum += p[dx];
+                    }
+                }
+                out[x] = static_cast<uint8_t>((sum + area / 2) / area);
+            }
+        }
+    });
+
+    // Bilinear remap with 8-bit weights
+    m_threadPool.parallelFor(m_rect.height, [&](int y0, int y1) {
+        const uint8_t* source = image.downscaled.data();
+        for (int y = y0; y < y1; y++) {
+            const size_t row = static_cast<size_t>(y) * m_rect.width;
+            for (int x = 0; x < m_rect.width; x++) {
+                const int32_t offset = image.remapOffsets[row + x];
+                if (offset < 0) {
+                    image.pixels[row + x] = 0;
+                    continue;
+                }
+                const uint32_t wx = image.remapWeights[row + x] & 0xff;
+                const uint32_t wy = image.remapWeights[row + x] >> 8;
+                const uint8_t* p = source + offset;
+                const uint32_t top = p[0] * (256 - wx) + p[1] * wx;
+                const uint32_t bottom = p[sourceWidth] * (256 - wx) + p[sourceWidth + 1] * wx;
+                image.pixels[row + x] = static_cast<uint8_t>((top * (256 - wy) + bottom * wy + 32768) >> 16);
+            }
+        }
+    });
+}
+
+}  // namespace VarjoExamples
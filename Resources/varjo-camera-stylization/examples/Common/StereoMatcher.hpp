@@ -0,0 +1,171 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <vector>
+
+#include <Varjo.h>
+
+#include "Globals.hpp"
+#include "KernelConfig.hpp"
+#include "ThreadPool.hpp"
+#include "MetricsRegistry.hpp"
+#include "MemoryAccounting.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Stereo matcher estimates disparity and depth from the luma planes of left and right
+// camera stream frames with semi-global matching. Stages, each run in parallel on the thread pool:
+//
+//   1. Rectify: box downscale luma, then remap both images to a common pinhole camera rotated so
+//      that rows are epipolar lines. Remap tables are built once per calibration.
+//   2. Census: 5x5 census transform, 24 bits per pixel.
+//   3. Cost: Hamming distance of left and right census per pixel and disparity, 8 bits.
+//   4. Aggregate: cost is aggregated along left, right, top and bottom paths with small penalty P1
+//      for disparity changes of one and large penalty P2 for larger jumps. Horizontal paths run
+//      over rows and vertical paths over column ranges, SIMD lanes run over disparities.
+//   5. Select: winner takes all disparity with parabola sub-pixel refinement. Right image
+//      disparities come from the same aggregated costs, and left disparities that do not agree
+//      with them within tolerance are invalidated, which removes occlusions and mismatches.
+//
+// Everything is integer arithmetic with saturating 16-bit aggregation, so all SIMD variants
+// produce identical disparities. Left camera is the reference: disparity map has the size of the
+// rectified images and covers the left image, invalid pixels are negative.
+//
+// Extrinsics are camera to HMD poses in Varjo camera space. Stream frames of the two channels
+// arrive one by one, so images are rectified when added and matched once both channels of a
+// frame number have been added.
+
+//! Semi-global stereo matcher for camera stream frames
+class StereoMatcher
+{
+public:
+    //! Matcher configuration
+    struct Config {
+        int downscale = 4;                   //!< Source pixels per rectified pixel in both directions
+        int maxDisparity = 64;               //!< Disparity range in rectified pixels, multiple of 16 up to 256
+        int penalty1 = 6;                    //!< Aggregation penalty for disparity change of one
+        int penalty2 = 48;                   //!< Aggregation penalty for larger disparity changes
+        int lrTolerance = 1;                 //!< Largest left right disparity difference accepted
+        SimdLevel simd = getMaxSimdLevel();  //!< SIMD variant
+    };
+
+    //! Rectified camera shared by both channels
+    struct Rectification {
+        bool valid = false;                   //!< Remap tables built
+        int width = 0;                        //!< Rectified image width
+        int height = 0;                       //!< Rectified image height
+        double focal = 0.0;                   //!< Focal length in rectified pixels
+        glm::dvec2 center{0.0};               //!< Principal point in rectified pixels
+        double baseline = 0.0;                //!< Distance between cameras in meters
+        glm::dmat3 rotation{1.0};             //!< Rectified camera to HMD rotation, OpenCV camera axes
+        std::array<glm::dvec3, 2> origins{};  //!< Left and right camera positions in HMD space
+    };
+
+    //! Matcher statistics
+    struct Stats {
+        int64_t pairs = 0;            //!< Matched image pairs
+        int64_t skipped = 0;          //!< Images added without their pair, e.g. before calibration was known
+        int64_t rectifyTimeNs = 0;    //!< Total rectification time of both channels
+        int64_t costTimeNs = 0;       //!< Total census and cost time
+        int64_t aggregateTimeNs = 0;  //!< Total path aggregation time
+        int64_t selectTimeNs = 0;     //!< Total disparity selection time
+        int64_t lastTimeNs = 0;       //!< Duration of last match including its rectification
+        int64_t totalTimeNs = 0;      //!< Total duration of matches including rectification
+        int64_t maxTimeNs = 0;        //!< Longest match including rectification
+        double validFraction = 0.0;   //!< Fraction of pixels with valid disparity in last match
+    };
+
+    //! Construct matcher running on given thread pool
+    StereoMatcher(ThreadPool& threadPool, const Config& config);
+
+    // Disable copy, move and assign
+    StereoMatcher(const StereoMatcher& other) = delete;
+    StereoMatcher(const StereoMatcher&& other) = delete;
+    StereoMatcher& operator=(const StereoMatcher& other) = delete;
+    StereoMatcher& operator=(const StereoMatcher&& other) = delete;
+
+    //! Rectify 8-bit luma plane of left or right channel. Returns true if both channels of frame number
+    //! are now rectified and ready to match. Call from one thread only, e.g. stream thread.
+    bool addImage(varjo_ChannelIndex channel, const uint8_t* luma, int width, int height, size_t rowStride, const varjo_CameraIntrinsics& intrinsics,
+        const varjo_Matrix& extrinsics, int64_t frameNumber);
+
+    //! Match rectified images. Returns false if pair is not ready. Does not allocate after first match.
+    bool match();
+
+    //! Returns rectified camera
+    const Rectification& getRectification() const { return m_rect; }
+
+    //! Returns rectified luma of channel, rectified width times height
+    const TrackedVector<uint8_t, MemoryTag::Stream>& getRectified(varjo_ChannelIndex channel) const
+    {
+        return m_images[channel == varjo_ChannelIndex_Left ? 0 : 1].pixels;
+    }
+
+    //! Returns disparity map of last match in rectified pixels, negative for invalid
+    const TrackedVector<float, MemoryTag::Stream>& getDisparity() const { return m_disparity; }
+
+    //! Returns frame number of last match, -1 if none
+    int64_t getFrameNumber() const { return m_matchedFrame; }
+
+    //! Returns depth along rectified optical axis in meters for disparity, zero for invalid
+    double getDepth(float disparity) const { return disparity > 0.0f ? m_rect.focal * m_rect.baseline / disparity : 0.0; }
+
+    //! Returns matcher statistics
+    const Stats& getStats() const { return m_stats; }
+
+    //! Register match timer and valid fraction metrics to given registry. Pass null to stop publishing.
+    void setMetrics(MetricsRegistry* metrics);
+
+private:
+    //! Calibration and rectified image of one channel
+    struct Image {
+        bool calibrated = false;                                  //!< Calibration received
+        varjo_CameraIntrinsics intrinsics{};                      //!< Intrinsics of last frame
+        varjo_Matrix extrinsics{};                                //!< Extrinsics of last frame
+        int64_t frameNumber = -1;                                 //!< Frame number of rectified pixels, -1 if none
+        int64_t rectifyTimeNs = 0;                                //!< Rectification time of rectified pixels
+        TrackedVector<uint8_t, MemoryTag::Stream> downscaled;     //!< Box downscaled source luma
+        TrackedVector<int32_t, MemoryTag::Stream> remapOffsets;   //!< Top left downscaled source pixel per rectified pixel, -1 outside source
+        TrackedVector<uint16_t, MemoryTag::Stream> remapWeights;  //!< Bilinear weights per rectified pixel, 8-bit x and y fraction
+        TrackedVector<uint8_t, MemoryTag::Stream> pixels;         //!< Rectified luma
+        TrackedVector<uint32_t, MemoryTag::Stream> census;        //!< Census bits per rectified pixel
+    };
+
+    //! Build rectification and remap tables from calibration of both channels. Returns false if cameras are not side by side.
+    bool buildRectification(int sourceWidth, int sourceHeight);
+
+    //! Build remap table of channel from rectified pixels to downscaled source pixels
+    void buildRemap(Image& image, const glm::dmat3& cameraRotation);
+
+    //! Box downscale and remap source luma to rectified image
+    void rectify(Image& image, const uint8_t* luma, int width, int height, size_t rowStride);
+
+private:
+    ThreadPool& m_threadPool;       //!< Worker threads
+    const Config m_config;          //!< Matcher configuration
+    std::array<Image, 2> m_images;  //!< Left and right channel
+    Rectification m_rect;           //!< Rectified camera
+    int m_sourceWidth = 0;          //!< Source luma width of remap tables
+    int m_sourceHeight = 0;         //!< Source luma height of remap tables
+    int64_t m_matchedFrame = -1;    //!< Frame number of last match
+
+    TrackedVector<uint32_t, MemoryTag::Stream> m_reversed;    //!< Right census rows in reverse order, padded by disparity range
+    TrackedVector<uint8_t, MemoryTag::Stream> m_costs;        //!< Matching cost per pixel and disparity
+    TrackedVector<uint16_t, MemoryTag::Stream> m_aggregated;  //!< Aggregated cost per pixel and disparity, sum of all paths
+    TrackedVector<uint16_t, MemoryTag::Stream> m_pathRows;    //!< Previous and current path costs of vertical paths per column and disparity
+    TrackedVector<uint16_t, MemoryTag::Stream> m_pathMins;    //!< Smallest previous path cost of vertical paths per column
+    TrackedVector<uint32_t, MemoryTag::Stream> m_rightBest;   //!< Best aggregated cost and disparity per right pixel, rows reversed and padded
+    TrackedVector<float, MemoryTag::Stream> m_disparity;      //!< Left image disparity per pixel, negative for invalid
+    std::atomic<int64_t> m_validPixels{0};                    //!< Valid disparities counted by select stage
+    Stats m_stats{};                                          //!< Matcher statistics
+
+    MetricsRegistry* m_metrics = nullptr;                              //!< Metrics registry, null if not published
+    MetricsRegistry::Id m_matchMetric = MetricsRegistry::c_invalidId;  //!< Match timer
+    MetricsRegistry::Id m_validMetric = MetricsRegistry::c_invalidId;  //!< Valid pixel percentage gauge
+};
+
+}  // namespace VarjoExamples
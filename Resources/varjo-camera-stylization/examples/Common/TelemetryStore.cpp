@@ -0,0 +1,722 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "TelemetryStore.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+using namespace VarjoExamples;
+
+namespace
+{
+// File magic 'VTLF', block magic 'VTLB' and index footer magic 'VTLI'
+constexpr uint32_t c_fileMagic = 0x464c5456;
+constexpr uint32_t c_blockMagic = 0x424c5456;
+constexpr uint32_t c_indexMagic = 0x494c5456;
+
+// File format version
+constexpr uint32_t c_fileVersion = 1;
+
+#pragma pack(push, 1)
+
+//! File header, followed by column headers
+struct FileHeader {
+    uint32_t magic;        //!< File magic
+    uint32_t version;      //!< File format version
+    uint32_t columnCount;  //!< Number of columns
+    uint32_t reserved;     //!< Reserved
+};
+
+//! Column header
+struct ColumnHeader {
+    uint8_t type;                                    //!< Column value type
+    uint8_t reserved[3];                             //!< Reserved
+    char name[TelemetryStore::c_maxNameLength + 1];  //!< Zero terminated column name
+};
+
+//! Block header, followed by encoded size of each column and encoded columns
+struct BlockHeader {
+    uint32_t magic;  //!< Block magic
+    uint32_t rows;   //!< Rows in block
+};
+
+//! Index entry
+struct IndexEntry {
+    int64_t offset;     //!< Block header offset
+    uint32_t rows;      //!< Rows in block
+    uint32_t reserved;  //!< Reserved
+};
+
+//! Index footer at end of file
+struct IndexFooter {
+    int64_t indexOffset;  //!< First index entry offset
+    uint32_t count;       //!< Number of index entries
+    uint32_t magic;       //!< Index magic
+};
+
+#pragma pack(pop)
+
+//! Delta of delta bucket, selected by prefix of ones terminated by zero
+struct Bucket {
+    uint32_t prefix;  //!< Prefix code
+    int prefixBits;   //!< Prefix length
+    int valueBits;    //!< Zigzag value length
+};
+
+// Buckets for nonzero delta of delta, zero is a single zero bit. Buckets are wider than in
+// Gorilla, because nanosecond timestamps jitter by microseconds from frame to frame.
+constexpr Bucket c_buckets[] = {{0x2, 2, 7}, {0x6, 3, 12}, {0xe, 4, 20}, {0x1e, 5, 32}, {0x1f, 5, 64}};
+constexpr int c_bucketCount = static_cast<int>(sizeof(c_buckets) / sizeof(c_buckets[0]));
+
+// Bit lengths of XOR leading zero count and meaningful bit count fields
+constexpr int c_leadingBits = 5;
+constexpr int c_lengthBits = 6;
+
+//! Appends bits most significant first to byte buffer
+class BitWriter
+{
+public:
+    BitWriter(std::vector<uint8_t>& out)
+        : m_out(out)
+    {
+    }
+
+    //! Write low bits of value, up to 64
+    void write(uint64_t value, int bits)
+    {
+        if (bits > 32) {
+            writeShort(value >> 32, bits - 32);
+            bits = 32;
+        }
+        writeShort(value, bits);
+    }
+
+    //! Write pending bits padded with zeros to byte boundary
+    void flush()
+    {
+        if (m_count > 0) {
+            m_out.push_back(static_cast<uint8_t>(m_bits << (8 - m_count)));
+            m_bits = 0;
+            m_count = 0;
+        }
+    }
+
+private:
+    void writeShort(uint64_t value, int bits)
+    {
+        m_bits = (m_bits << bits) | (value & ((uint64_t(1) << bits) - 1));
+        m_count += bits;
+        while (m_count >= 8) {
+            m_count -= 8;
+            m_out.push_back(static_cast<uint8_t>(m_bits >> m_count));
+        }
+        m_bits &= (uint64_t(1) << m_count) - 1;
+    }
+
+    std::vector<uint8_t>& m_out;  //!< Output buffer
+    uint64_t m_bits = 0;          //!< Pending bits
+    int m_count = 0;              //!< Number of pending bits
+};
+
+//! Reads bits most significant first from byte buffer
+class BitReader
+{
+public:
+    BitReader(const uint8_t* data, size_t size)
+        : m_data(data)
+        , m_end(data + size)
+    {
+    }
+
+    //! Read value of given bits, up to 64. Reads past end return zeros and set overrun.
+    uint64_t read(int bits)
+    {
+        if (bits > 32) {
+            const uint64_t high = readShort(bits - 32);
+            return (high << 32) | readShort(32);
+        }
+        return readShort(bits);
+    }
+
+    //! Returns true if more bits were read than there are
+    bool isOverrun() const { return m_overrun; }
+
+private:
+    uint64_t readShort(int bits)
+    {
+        while (m_count < bits) {
+            uint8_t byte = 0;
+            if (m_data < m_end) {
+                byte = *m_data++;
+            } else {
+                m_overrun = true;
+            }
+            m_bits = (m_bits << 8) | byte;
+            m_count += 8;
+        }
+        m_count -= bits;
+        const uint64_t value = (m_bits >> m_count) & ((uint64_t(1) << bits) - 1);
+        m_bits &= (uint64_t(1) << m_count) - 1;
+        return value;
+    }
+
+    const uint8_t* m_data;   //!< Next byte
+    const uint8_t* m_end;    //!< End of data
+    uint64_t m_bits = 0;     //!< Buffered bits
+    int m_count = 0;         //!< Number of buffered bits
+    bool m_overrun = false;  //!< Read past end flag
+};
+
+// Returns leading zero bits of nonzero value
+int countLeadingZeros(uint64_t x)
+{
+    int n = 0;
+    for (int shift = 32; shift > 0; shift >>= 1) {
+        if ((x >> (64 - shift)) == 0) {
+            n += shift;
+            x <<= shift;
+        }
+    }
+    return n;
+}
+
+// Returns trailing zero bits of nonzero value
+int countTrailingZeros(uint64_t x)
+{
+    int n = 0;
+    for (int shift = 32; shift > 0; shift >>= 1) {
+        if ((x & ((uint64_t(1) << shift) - 1)) == 0) {
+            n += shift;
+            x >>= shift;
+        }
+    }
+    return n;
+}
+
+// Encode integer values as first value and delta of deltas. Arithmetic wraps, so any values round trip.
+void encodeInts(const int64_t* values, int count, BitWriter& writer)
+{
+    writer.write(static_cast<uint64_t>(values[0]), 64);
+    uint64_t lastDelta = 0;
+    for (int i = 1; i < count; i++) {
+        const uint64_t delta = static_cast<uint64_t>(values[i]) - static_cast<uint64_t>(values[i - 1]);
+        const uint64_t dod = delta - lastDelta;
+        lastDelta = delta;
+
+        // Zigzag maps small negative and positive values to small unsigned values
+        const uint64_t zigzag = (dod << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(dod) >> 63);
+        if (zigzag == 0) {
+            writer.write(0, 1);
+            continue;
+        }
+        int b = 0;
+        while (c_buckets[b].valueBits < 64 && zigzag >> c_buckets[b].valueBits) {
+            b++;
+        }
+        writer.write(c_buckets[b].prefix, c_buckets[b].prefixBits);
+        writer.write(zigzag, c_buckets[b].valueBits);
+    }
+}
+
+// Decode integer values
+void decodeInts(BitReader& reader, int count, int64_t* outValues)
+{
+    uint64_t value = reader.read(64);
+    uint64_t delta = 0;
+    outValues[0] = static_cast<int64_t>(value);
+    for (int i = 1; i < count; i++) {
+        if (reader.read(1)) {
+            int b = 0;
+            while (b + 1 < c_bucketCount && reader.read(1)) {
+                b++;
+            }
+            const uint64_t zigzag = reader.read(c_buckets[b].valueBits);
+            delta += (zigzag >> 1) ^ (0 - (zigzag & 1));
+        }
+        value += delta;
+        outValues[i] = static_cast<int64_t>(value);
+    }
+}
+
+// Encode float bit patterns as first value and XOR with previous value. Meaningful bits of XOR reuse
+// previous leading and trailing zero counts when they fit in them.
+void encodeFloats(const int64_t* values, int count, BitWriter& writer)
+{
+    uint64_t last = static_cast<uint64_t>(values[0]);
+    writer.write(last, 64);
+    int lastLeading = -1;
+    int lastTrailing = 0;
+    for (int i = 1; i < count; i++) {
+        const uint64_t value = static_cast<uint64_t>(values[i]);
+        const uint64_t x = value ^ last;
+        last = value;
+        if (x == 0) {
+            writer.write(0, 1);
+            continue;
+        }
+
+        const int leading = std::min(countLeadingZeros(x), (1 << c_leadingBits) - 1);
+        const int trailing = countTrailingZeros(x);
+        if (lastLeading >= 0 && leading >= lastLeading && trailing >= lastTrailing) {
+            writer.write(0x2, 2);
+            writer.write(x >> lastTrailing, 64 - lastLeading - lastTrailing);
+        } else {
+            const int length = 64 - leading - trailing;
+            writer.write(0x3, 2);
+            writer.write(static_cast<uint64_t>(leading), c_leadingBits);
+            writer.write(static_cast<uint64_t>(length - 1), c_lengthBits);
+            writer.write(x >> trailing, length);
+            lastLeading = leading;
+            lastTrailing = trailing;
+        }
+    }
+}
+
+// Decode float bit patterns
+void decodeFloats(BitReader& reader, int count, int64_t* outValues)
+{
+    uint64_t value = reader.read(64);
+    outValues[0] = static_cast<int64_t>(value);
+    int leading = 0;
+    int trailing = 0;
+    for (int i = 1; i < count; i++) {
+        if (reader.read(1)) {
+            if (reader.read(1)) {
+                leading = static_cast<int>(reader.read(c_leadingBits));
+                trailing = 64 - leading - static_cast<int>(reader.read(c_lengthBits)) - 1;
+                if (trailing < 0) {
+                    // Corrupt data, caller sees overrun or garbage values but never shifts out of range
+                    trailing = 0;
+                }
+            }
+            value ^= reader.read(64 - leading - trailing) << trailing;
+        }
+        outValues[i] = static_cast<int64_t>(value);
+    }
+}
+
+// Returns column index of name, -1 if not found
+int findColumnIndex(const std::vector<TelemetryStore::Column>& columns, const std::string& name)
+{
+    for (size_t i = 0; i < columns.size(); i++) {
+        if (columns[i].name == name) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+}  // namespace
+
+namespace VarjoExamples
+{
+TelemetryStore::TelemetryStore(const std::vector<Column>& columns, const Config& config)
+    : m_columns(columns)
+    , m_config(config)
+{
+}
+
+TelemetryStore::~TelemetryStore() { close(); }
+
+bool TelemetryStore::open(const std::string& filename)
+{
+    close();
+
+    if (m_columns.empty() || m_columns.size() > c_maxColumns) {
+        LOGE("Invalid telemetry column count: %d", static_cast<int>(m_columns.size()));
+        return false;
+    }
+    for (const auto& column : m_columns) {
+        if (column.name.empty() || column.name.size() > c_maxNameLength) {
+            LOGE("Invalid telemetry column name: %s", column.name.c_str());
+            return false;
+        }
+    }
+
+    m_file.open(filename, std::ofstream::binary | std::ofstream::trunc);
+    if (!m_file) {
+        LOGE("Opening telemetry file failed: %s", filename.c_str());
+        return false;
+    }
+
+    const FileHeader header{c_fileMagic, c_fileVersion, static_cast<uint32_t>(m_columns.size()), 0};
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const auto& column : m_columns) {
+        ColumnHeader columnHeader{};
+        columnHeader.type = static_cast<uint8_t>(column.type);
+        column.name.copy(columnHeader.name, column.name.size());
+        m_file.write(reinterpret_cast<const char*>(&columnHeader), sizeof(columnHeader));
+    }
+
+    // Pending block is allocated once, so that drains do not allocate
+    const int blockRows = std::max(m_config.blockRows, 1);
+    m_pending.resize(m_columns.size());
+    for (auto& values : m_pending) {
+        values.clear();
+        values.reserve(blockRows);
+    }
+    m_pendingRows = 0;
+    m_blockOffsets.clear();
+    m_blockRows.clear();
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        m_stats = Stats();
+    }
+
+    m_quit = false;
+    m_thread = std::thread(&TelemetryStore::storeMain, this);
+    return true;
+}
+
+void TelemetryStore::close()
+{
+    if (!m_thread.joinable()) {
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_quitMutex);
+        m_quit = true;
+    }
+    m_quitCond.notify_all();
+    m_thread.join();
+
+    // Rows appended before close are written
+    drain();
+    writeBlock();
+
+    // Index of all blocks for seeking
+    IndexFooter footer{};
+    footer.indexOffset = static_cast<int64_t>(m_file.tellp());
+    footer.count = static_cast<uint32_t>(m_blockOffsets.size());
+    footer.magic = c_indexMagic;
+    for (size_t i = 0; i < m_blockOffsets.size(); i++) {
+        const IndexEntry entry{m_blockOffsets[i], m_blockRows[i], 0};
+        m_file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    }
+    m_file.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+    m_file.close();
+
+    const Stats stats = getStats();
+    LOGI("Telemetry closed: %lld rows, %lld dropped, %lld blocks, compression ratio %.2f", stats.rows, stats.droppedRows, stats.blocks,
+        stats.encodedBytes > 0 ? static_cast<double>(stats.rawBytes) / stats.encodedBytes : 0.0);
+}
+
+TelemetryStore::Writer* TelemetryStore::createWriter()
+{
+    std::lock_guard<std::mutex> lock(m_writersMutex);
+    m_writers.push_back(std::make_unique<Writer>());
+    return m_writers.back().get();
+}
+
+int TelemetryStore::findColumn(const std::string& name) const { return findColumnIndex(m_columns, name); }
+
+TelemetryStore::Stats TelemetryStore::getStats() const
+{
+    Stats stats;
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        stats = m_stats;
+    }
+    std::lock_guard<std::mutex> lock(m_writersMutex);
+    for (const auto& writer : m_writers) {
+        stats.droppedRows += writer->getDropped();
+    }
+    return stats;
+}
+
+void TelemetryStore::setMetrics(MetricsRegistry* metrics)
+{
+    m_metrics = metrics;
+    m_flushMetric = metrics ? metrics->addMetric("Telemetry: flush", MetricsRegistry::Kind::Timer) : MetricsRegistry::c_invalidId;
+}
+
+void TelemetryStore::storeMain()
+{
+    std::unique_lock<std::mutex> lock(m_quitMutex);
+    while (!m_quit) {
+        m_quitCond.wait_for(lock, std::chrono::milliseconds(m_config.flushIntervalMs), [this]() { return m_quit; });
+        if (m_quit) {
+            return;
+        }
+        lock.unlock();
+        drain();
+        lock.lock();
+    }
+}
+
+void TelemetryStore::drain()
+{
+    const int64_t start = getTimestampNs();
+    const int blockRows = std::max(m_config.blockRows, 1);
+    const size_t columnCount = m_columns.size();
+    int64_t rows = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_writersMutex);
+        Row row;
+        for (auto& writer : m_writers) {
+            // Take at most one queue worth, so that a busy writer can not keep store thread here
+            for (size_t i = 0; i < c_writerCapacity && writer->m_queue.pop(row); i++) {
+                for (size_t c = 0; c < columnCount; c++) {
+                    m_pending[c].push_back(row.values[c]);
+                }
+                rows++;
+                if (++m_pendingRows == blockRows) {
+                    writeBlock();
+                }
+            }
+        }
+    }
+    if (rows == 0) {
+        return;
+    }
+
+    const int64_t timeNs = getTimestampNs() - start;
+    if (m_metrics) {
+        m_metrics->recordTime(m_flushMetric, timeNs);
+    }
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_stats.rows += rows;
+    m_stats.flushTimeNs += timeNs;
+}
+
+void TelemetryStore::writeBlock()
+{
+    if (m_pendingRows == 0) {
+        return;
+    }
+
+    // Columns are byte aligned, so that reader can decode any column of a block alone
+    m_encoded.clear();
+    m_columnSizes.clear();
+    BitWriter writer(m_encoded);
+    for (size_t c = 0; c < m_columns.size(); c++) {
+        const size_t begin = m_encoded.size();
+        if (m_columns[c].type == ColumnType::Float) {
+            encodeFloats(m_pending[c].data(), m_pendingRows, writer);
+        } else {
+            encodeInts(m_pending[c].data(), m_pendingRows, writer);
+        }
+        writer.flush();
+        m_columnSizes.push_back(static_cast<uint32_t>(m_encoded.size() - begin));
+        m_pending[c].clear();
+    }
+
+    const BlockHeader header{c_blockMagic, static_cast<uint32_t>(m_pendingRows)};
+    m_blockOffsets.push_back(static_cast<int64_t>(m_file.tellp()));
+    m_blockRows.push_back(header.rows);
+    m_file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    m_file.write(reinterpret_cast<const char*>(m_columnSizes.data()), m_columnSizes.size() * sizeof(uint32_t));
+    m_file.write(reinterpret_cast<const char*>(m_encoded.data()), m_encoded.size());
+    m_file.flush();
+    if (!m_file) {
+        LOGE("Writing telemetry failed.");
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        m_stats.blocks++;
+        m_stats.rawBytes += static_cast<int64_t>(m_pendingRows) * static_cast<int64_t>(m_columns.size() * sizeof(int64_t));
+        m_stats.encodedBytes += static_cast<int64_t>(m_encoded.size());
+    }
+    m_pendingRows = 0;
+}
+
+TelemetryReader::~TelemetryReader() { close(); }
+
+bool TelemetryReader::open(const std::string& filename)
+{
+    close();
+
+    m_file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        LOGE("Opening telemetry file failed: %s", filename.c_str());
+        return false;
+    }
+
+    LARGE_INTEGER fileSize{};
+    if (!GetFileSizeEx(m_file, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(FileHeader))) {
+        LOGE("Not a telemetry file: %s", filename.c_str());
+        close();
+        return false;
+    }
+    m_size = fileSize.QuadPart;
+
+    m_mapping = CreateFileMappingA(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping) {
+        m_data = reinterpret_cast<const uint8_t*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (!m_data) {
+        LOGE("Mapping telemetry file failed: %s", filename.c_str());
+        close();
+        return false;
+    }
+
+    // Mapped structures are copied out, because nothing in file is aligned
+    FileHeader header{};
+    memcpy(&header, m_data, sizeof(header));
+    const int64_t dataOffset = static_cast<int64_t>(sizeof(FileHeader) + header.columnCount * sizeof(ColumnHeader));
+    if (header.magic != c_fileMagic || header.version != c_fileVersion || header.columnCount == 0 ||
+        header.columnCount > TelemetryStore::c_maxColumns || dataOffset > m_size) {
+        LOGE("Not a telemetry file: %s", filename.c_str());
+        close();
+        return false;
+    }
+    for (uint32_t i = 0; i < header.columnCount; i++) {
+        ColumnHeader columnHeader{};
+        memcpy(&columnHeader, m_data + sizeof(FileHeader) + i * sizeof(ColumnHeader), sizeof(columnHeader));
+        TelemetryStore::Column column;
+        column.name.assign(columnHeader.name, std::find(columnHeader.name, columnHeader.name + TelemetryStore::c_maxNameLength, '\0'));
+        column.type = (columnHeader.type == static_cast<uint8_t>(TelemetryStore::ColumnType::Float)) ? TelemetryStore::ColumnType::Float
+                                                                                                     : TelemetryStore::ColumnType::Int;
+        m_columns.push_back(column);
+    }
+
+    // Use index if store was closed cleanly
+    IndexFooter footer{};
+    if (m_size >= dataOffset + static_cast<int64_t>(sizeof(IndexFooter))) {
+        memcpy(&footer, m_data + m_size - sizeof(footer), sizeof(footer));
+    }
+
+    const int64_t indexSize = static_cast<int64_t>(footer.count) * static_cast<int64_t>(sizeof(IndexEntry));
+    if (footer.magic == c_indexMagic && footer.indexOffset >= dataOffset && footer.indexOffset + indexSize + static_cast<int64_t>(sizeof(footer)) == m_size) {
+        for (uint32_t i = 0; i < footer.count; i++) {
+            IndexEntry entry{};
+            memcpy(&entry, m_data + footer.indexOffset + i * sizeof(IndexEntry), sizeof(entry));
+            int64_t next = 0;
+            if (!addBlock(entry.offset, next) || m_blocks.back().rows != entry.rows) {
+                LOGE("Telemetry index is corrupt: %s", filename.c_str());
+                close();
+                return false;
+            }
+        }
+    } else {
+        // Scan blocks until end of file or first truncated block
+        LOGW("Telemetry file has no index, scanning blocks: %s", filename.c_str());
+        int64_t offset = dataOffset;
+        while (addBlock(offset, offset)) {
+        }
+    }
+    return true;
+}
+
+void TelemetryReader::close()
+{
+    if (m_data) {
+        UnmapViewOfFile(m_data);
+        m_data = nullptr;
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if (m_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_file);
+        m_file = INVALID_HANDLE_VALUE;
+    }
+    m_size = 0;
+    m_columns.clear();
+    m_blocks.clear();
+    m_columnSizes.clear();
+    m_rowCount = 0;
+}
+
+int TelemetryReader::findColumn(const std::string& name) const { return findColumnIndex(m_columns, name); }
+
+int64_t TelemetryReader::getColumnBytes(int column) const
+{
+    int64_t bytes = 0;
+    for (const auto& block : m_blocks) {
+        bytes += m_columnSizes[block.firstSize + column];
+    }
+    return bytes;
+}
+
+bool TelemetryReader::readInts(int column, std::vector<int64_t>& outValues) const
+{
+    if (column < 0 || column >= static_cast<int>(m_columns.size()) || m_columns[column].type != TelemetryStore::ColumnType::Int) {
+        return false;
+    }
+    return readColumn(column, outValues);
+}
+
+bool TelemetryReader::readFloats(int column, std::vector<double>& outValues) const
+{
+    if (column < 0 || column >= static_cast<int>(m_columns.size()) || m_columns[column].type != TelemetryStore::ColumnType::Float) {
+        return false;
+    }
+    std::vector<int64_t> bits;
+    if (!readColumn(column, bits)) {
+        return false;
+    }
+    outValues.resize(bits.size());
+    memcpy(outValues.data(), bits.data(), bits.size() * sizeof(int64_t));
+    return true;
+}
+
+bool TelemetryReader::addBlock(int64_t offset, int64_t& outNext)
+{
+    const size_t columnCount = m_columns.size();
+    const int64_t sizesOffset = offset + static_cast<int64_t>(sizeof(BlockHeader));
+    const int64_t dataOffset = sizesOffset + static_cast<int64_t>(columnCount * sizeof(uint32_t));
+    if (offset < 0 || dataOffset > m_size) {
+        return false;
+    }
+
+    BlockHeader header{};
+    memcpy(&header, m_data + offset, sizeof(header));
+    if (header.magic != c_blockMagic || header.rows == 0) {
+        return false;
+    }
+
+    const size_t firstSize = m_columnSizes.size();
+    int64_t end = dataOffset;
+    for (size_t c = 0; c < columnCount; c++) {
+        uint32_t size = 0;
+        memcpy(&size, m_data + sizesOffset + c * sizeof(uint32_t), sizeof(size));
+        m_columnSizes.push_back(size);
+        end += size;
+    }
+    if (end > m_size) {
+        m_columnSizes.resize(firstSize);
+        return false;
+    }
+
+    Block block;
+    block.offset = dataOffset;
+    block.rows = header.rows;
+    block.firstSize = firstSize;
+    m_blocks.push_back(block);
+    m_rowCount += header.rows;
+    outNext = end;
+    return true;
+}
+
+bool TelemetryReader::readColumn(int column, std::vector<int64_t>& outValues) const
+{
+    outValues.resize(static_cast<size_t>(m_rowCount));
+    int64_t* out = outValues.data();
+    const bool isFloat = m_columns[column].type == TelemetryStore::ColumnType::Float;
+    for (const auto& block : m_blocks) {
+        // Skip preceding columns of block without touching their pages
+        int64_t offset = block.offset;
+        for (int c = 0; c < column; c++) {
+            offset += m_columnSizes[block.firstSize + c];
+        }
+
+        BitReader reader(m_data + offset, m_columnSizes[block.firstSize + column]);
+        if (isFloat) {
+            decodeFloats(reader, static_cast<int>(block.rows), out);
+        } else {
+            decodeInts(reader, static_cast<int>(block.rows), out);
+        }
+        if (reader.isOverrun()) {
+            LOGE("Telemetry column is corrupt: %s", m_columns[column].name.c_str());
+            return false;
+        }
+        out += block.rows;
+    }
+    return true;
+}
+
+}  // namespace VarjoExamples
@@ -0,0 +1,272 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <array>
+#include <memory>
+#include <fstream>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+
+#include "Globals.hpp"
+#include "CommandQueue.hpp"
+#include "MetricsRegistry.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Telemetry store writes per-frame records, e.g. frame number, capture timestamp, exposure
+// and stage timings, to a columnar file for offline analysis over hours of operation. Hot paths
+// append whole rows to their own writer, which is a lock-free single producer queue, so appending
+// is a copy and never locks or waits. Store thread drains the writers periodically into a block of
+// rows, and writes the block once it is full, each column compressed separately:
+//
+//   - Integer columns store delta of delta, so regular sequences like frame numbers and capture
+//     timestamps cost one or a few bits per row.
+//   - Float columns store XOR with the previous value, so repeated and slowly changing values like
+//     exposure time and white balance cost one or a few bits per row.
+//
+// Rows of one writer stay in append order. Rows of different writers are interleaved in drain
+// order, so readers should sort by a time or frame number column when that matters. If a writer
+// fills up between drains, rows are dropped and counted instead of blocking the hot path.
+//
+// When store is closed, an index of all blocks is appended for seeking. Reader maps the file to
+// memory and decodes only the blocks of requested columns. It scans the blocks if index is missing.
+
+//! Columnar time series store for per-frame telemetry
+class TelemetryStore
+{
+public:
+    //! Column value type
+    enum class ColumnType : uint8_t {
+        Int = 0,  //!< 64-bit signed integer, delta of delta compressed
+        Float,    //!< 64-bit float, XOR compressed
+    };
+
+    //! Column description
+    struct Column {
+        std::string name;                   //!< Column name, up to c_maxNameLength characters
+        ColumnType type = ColumnType::Int;  //!< Value type
+    };
+
+    //! Largest number of columns
+    static constexpr int c_maxColumns = 32;
+
+    //! Longest column name
+    static constexpr int c_maxNameLength = 31;
+
+    //! Rows per writer queue
+    static constexpr size_t c_writerCapacity = 1024;
+
+    //! One record, one value per column. Float values are stored as their bit pattern.
+    struct Row {
+        std::array<int64_t, c_maxColumns> values{};  //!< Column values
+
+        //! Set integer column value
+        void setInt(int column, int64_t value) { values[column] = value; }
+
+        //! Set float column value
+        void setFloat(int column, double value) { memcpy(&values[column], &value, sizeof(value)); }
+    };
+
+    //! Per-thread row writer
+    class Writer
+    {
+    public:
+        //! Construct writer
+        Writer() = default;
+
+        // Disable copy, move and assign
+        Writer(const Writer& other) = delete;
+        Writer(const Writer&& other) = delete;
+        Writer& operator=(const Writer& other) = delete;
+        Writer& operator=(const Writer&& other) = delete;
+
+        //! Append row. Lock-free, call from owning thread only. Returns false if row was dropped.
+        bool append(const Row& row)
+        {
+            if (!m_queue.push(row)) {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            return true;
+        }
+
+        //! Returns rows dropped because writer was full
+        int64_t getDropped() const { return m_dropped.load(std::memory_order_relaxed); }
+
+    private:
+        friend class TelemetryStore;
+
+        CommandQueue<Row, c_writerCapacity> m_queue;  //!< Rows waiting for store thread
+        std::atomic<int64_t> m_dropped{0};            //!< Dropped rows
+    };
+
+    //! Store configuration
+    struct Config {
+        int blockRows = 4096;       //!< Rows per compressed block
+        int flushIntervalMs = 100;  //!< Interval of draining writers
+    };
+
+    //! Store statistics
+    struct Stats {
+        int64_t rows = 0;          //!< Rows drained from writers
+        int64_t droppedRows = 0;   //!< Rows dropped because a writer was full
+        int64_t blocks = 0;        //!< Written blocks
+        int64_t rawBytes = 0;      //!< Uncompressed size of written rows
+        int64_t encodedBytes = 0;  //!< Compressed column size of written rows
+        int64_t flushTimeNs = 0;   //!< Total drain, encode and write time
+    };
+
+    //! Construct store with given columns
+    TelemetryStore(const std::vector<Column>& columns, const Config& config);
+
+    //! Destruct store. Closes file.
+    ~TelemetryStore();
+
+    // Disable copy, move and assign
+    TelemetryStore(const TelemetryStore& other) = delete;
+    TelemetryStore(const TelemetryStore&& other) = delete;
+    TelemetryStore& operator=(const TelemetryStore& other) = delete;
+    TelemetryStore& operator=(const TelemetryStore&& other) = delete;
+
+    //! Create telemetry file and start store thread. Returns false if columns are invalid or file cannot be created.
+    bool open(const std::string& filename);
+
+    //! Drain writers, write last partial block and block index, and close file. Appends after this are
+    //! kept in writers until next open.
+    void close();
+
+    //! Returns true if file is open
+    bool isOpen() const { return m_thread.joinable(); }
+
+    //! Create writer for calling thread. Writers live as long as the store. Not for hot paths, locks.
+    Writer* createWriter();
+
+    //! Returns columns
+    const std::vector<Column>& getColumns() const { return m_columns; }
+
+    //! Returns index of named column, -1 if not found
+    int findColumn(const std::string& name) const;
+
+    //! Returns store statistics
+    Stats getStats() const;
+
+    //! Register flush timer metric to given registry. Pass null to stop publishing. Call before open.
+    void setMetrics(MetricsRegistry* metrics);
+
+private:
+    //! Store thread main function
+    void storeMain();
+
+    //! Move queued rows of all writers to pending block, writing full blocks. Called from store thread.
+    void drain();
+
+    //! Compress and write pending rows as one block. Called from store thread.
+    void writeBlock();
+
+private:
+    const std::vector<Column> m_columns;  //!< Columns
+    const Config m_config;                //!< Store configuration
+    std::ofstream m_file;                 //!< Telemetry file
+    std::thread m_thread;                 //!< Store thread
+
+    mutable std::mutex m_writersMutex;               //!< Writer list mutex, not taken by appends
+    std::vector<std::unique_ptr<Writer>> m_writers;  //!< Writers
+
+    std::mutex m_quitMutex;              //!< Quit flag mutex
+    std::condition_variable m_quitCond;  //!< Signaled on close
+    bool m_quit = false;                 //!< Quit flag for store thread
+
+    std::vector<std::vector<int64_t>> m_pending;  //!< Pending block values per column
+    int m_pendingRows = 0;                        //!< Rows in pending block
+    std::vector<uint8_t> m_encoded;               //!< Encoding buffer
+    std::vector<uint32_t> m_columnSizes;          //!< Encoded column sizes of current block
+    std::vector<int64_t> m_blockOffsets;          //!< Written block offsets for index
+    std::vector<uint32_t> m_blockRows;            //!< Written block row counts for index
+
+    mutable std::mutex m_statsMutex;  //!< Statistics mutex
+    Stats m_stats{};                  //!< Statistics, except dropped rows
+
+    MetricsRegistry* m_metrics = nullptr;                              //!< Metrics registry, null if not published
+    MetricsRegistry::Id m_flushMetric = MetricsRegistry::c_invalidId;  //!< Flush timer
+};
+
+//! Reads columns from memory mapped telemetry file
+class TelemetryReader
+{
+public:
+    //! Construct reader
+    TelemetryReader() = default;
+
+    //! Destruct reader. Unmaps file.
+    ~TelemetryReader();
+
+    // Disable copy, move and assign
+    TelemetryReader(const TelemetryReader& other) = delete;
+    TelemetryReader(const TelemetryReader&& other) = delete;
+    TelemetryReader& operator=(const TelemetryReader& other) = delete;
+    TelemetryReader& operator=(const TelemetryReader&& other) = delete;
+
+    //! Map telemetry file. Returns false if file is not a telemetry file.
+    bool open(const std::string& filename);
+
+    //! Unmap file
+    void close();
+
+    //! Returns columns
+    const std::vector<TelemetryStore::Column>& getColumns() const { return m_columns; }
+
+    //! Returns index of named column, -1 if not found
+    int findColumn(const std::string& name) const;
+
+    //! Returns total rows
+    int64_t getRowCount() const { return m_rowCount; }
+
+    //! Returns number of blocks
+    int getBlockCount() const { return static_cast<int>(m_blocks.size()); }
+
+    //! Returns compressed size of column in all blocks
+    int64_t getColumnBytes(int column) const;
+
+    //! Returns mapped file size
+    int64_t getFileSize() const { return m_size; }
+
+    //! Decode all values of integer column. Returns false if column is not integer or data is corrupt.
+    bool readInts(int column, std::vector<int64_t>& outValues) const;
+
+    //! Decode all values of float column. Returns false if column is not float or data is corrupt.
+    bool readFloats(int column, std::vector<double>& outValues) const;
+
+private:
+    //! Block location in mapped file
+    struct Block {
+        int64_t offset = 0;    //!< First column data offset
+        uint32_t rows = 0;     //!< Rows in block
+        size_t firstSize = 0;  //!< Index of first column size in m_columnSizes
+    };
+
+    //! Parse block header at offset. Returns false if there is no complete block there.
+    bool addBlock(int64_t offset, int64_t& outNext);
+
+    //! Decode values of column as raw 64-bit patterns
+    bool readColumn(int column, std::vector<int64_t>& outValues) const;
+
+private:
+    HANDLE m_file = INVALID_HANDLE_VALUE;  //!< File handle
+    HANDLE m_mapping = nullptr;            //!< File mapping handle
+    const uint8_t* m_data = nullptr;       //!< Mapped file
+    int64_t m_size = 0;                    //!< Mapped file size
+
+    std::vector<TelemetryStore::Column> m_columns;  //!< Columns
+    std::vector<Block> m_blocks;                    //!< Blocks in file order
+    std::vector<uint32_t> m_columnSizes;            //!< Encoded column sizes of all blocks
+    int64_t m_rowCount = 0;                         //!< Total rows
+};
+
+}  // namespace VarjoExamples
@@ -0,0 +1,152 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "ThreadPool.hpp"
+
+#include <atomic>
+#include <memory>
+#include <algorithm>
+
+namespace
+{
+// Chunks per thread for parallel ranges. Small oversubscription balances uneven rows.
+constexpr int c_chunksPerThread = 4;
+
+}  // namespace
+
+namespace VarjoExamples
+{
+ThreadPool::ThreadPool(int threadCount)
+{
+    if (threadCount <= 0) {
+        threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+    }
+
+    for (int i = 0; i < threadCount; i++) {
+        m_threads.emplace_back(&ThreadPool::workerMain, this);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_paused = false;
+        m_taskCond.notify_all();
+        m_idleCond.wait(lock, [this]() { return m_tasks.empty() && m_runningTasks == 0; });
+        m_quit = true;
+    }
+    m_taskCond.notify_all();
+
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+void ThreadPool::submit(Task task)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.emplace_back(std::move(task));
+        m_queueDepth.store(static_cast<int>(m_tasks.size()), std::memory_order_relaxed);
+    }
+    m_taskCond.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idleCond.wait(lock, [this]() { return m_tasks.empty() && m_runningTasks == 0; });
+}
+
+void ThreadPool::setPaused(bool paused)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_paused = paused;
+    }
+    if (!paused) {
+        m_taskCond.notify_all();
+    }
+}
+
+void ThreadPool::parallelFor(int count, const RangeFunc& func, int grain)
+{
+    if (count <= 0) {
+        return;
+    }
+
+    grain = std::max(1, grain);
+    const int maxChunks = (getThreadCount() + 1) * c_chunksPerThread;
+    const int chunkCount = std::min((count + grain - 1) / grain, maxChunks);
+    if (chunkCount <= 1) {
+        func(0, count);
+        return;
+    }
+
+    // Shared range state. Helpers may still be around after the range is done, so keep it alive with them.
+    struct RangeState {
+        std::atomic<int> nextChunk{0};
+        std::atomic<int> doneChunks{0};
+        std::mutex mutex;
+        std::condition_variable doneCond;
+    };
+    auto state = std::make_shared<RangeState>();
+    const int chunkSize = (count + chunkCount - 1) / chunkCount;
+
+    auto runChunks = [state, chunkCount, chunkSize, count, &func]() {
+        int chunk;
+        while ((chunk = state->nextChunk.fetch_add(1)) < chunkCount) {
+            const int begin = chunk * chunkSize;
+            const int end = std::min(count, begin + chunkSize);
+            if (begin < end) {
+                func(begin, end);
+            }
+            if (state->doneChunks.fetch_add(1) + 1 == chunkCount) {
+                std::lock_guard<std::mutex> lock(state->mutex);
+                state->doneCond.notify_all();
+            }
+        }
+    };
+
+    // Paused workers would only pick helpers up after the range is done
+    const int helpers = isPaused() ? 0 : std::min(getThreadCount(), chunkCount - 1);
+    for (int i = 0; i < helpers; i++) {
+        submit(runChunks);
+    }
+
+    // Participate on calling thread
+    runChunks();
+
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->doneCond.wait(lock, [&state, chunkCount]() { return state->doneChunks.load() == chunkCount; });
+}
+
+void ThreadPool::workerMain()
+{
+    while (true) {
+        Task task;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_taskCond.wait(lock, [this]() { return m_quit || (!m_paused && !m_tasks.empty()); });
+            if (m_quit && m_tasks.empty()) {
+                return;
+            }
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+            m_queueDepth.store(static_cast<int>(m_tasks.size()), std::memory_order_relaxed);
+            m_runningTasks++;
+        }
+
+        task();
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_runningTasks--;
+            if (m_tasks.empty() && m_runningTasks == 0) {
+                m_idleCond.notify_all();
+            }
+        }
+    }
+}
+
+}  // namespace VarjoExamples
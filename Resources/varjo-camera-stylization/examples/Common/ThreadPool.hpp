@@ -0,0 +1,78 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "Globals.hpp"
+
+namespace VarjoExamples
+{
+//! Simple worker thread pool for CPU side image processing
+class ThreadPool
+{
+public:
+    //! Task function type
+    using Task = std::function<void()>;
+
+    //! Range function type. Called with [begin, end) sub range.
+    using RangeFunc = std::function<void(int begin, int end)>;
+
+    //! Construct thread pool. Zero thread count uses hardware concurrency minus one.
+    ThreadPool(int threadCount = 0);
+
+    //! Destruct thread pool. Waits for queued tasks to finish.
+    ~ThreadPool();
+
+    // Disable copy, move and assign
+    ThreadPool(const ThreadPool& other) = delete;
+    ThreadPool(const ThreadPool&& other) = delete;
+    ThreadPool& operator=(const ThreadPool& other) = delete;
+    ThreadPool& operator=(const ThreadPool&& other) = delete;
+
+    //! Returns number of worker threads
+    int getThreadCount() const { return static_cast<int>(m_threads.size()); }
+
+    //! Returns number of queued tasks not yet started. Does not lock, so value may be slightly stale.
+    int getQueueDepth() const { return m_queueDepth.load(std::memory_order_relaxed); }
+
+    //! Queue task for execution on worker thread
+    void submit(Task task);
+
+    //! Wait until all queued tasks have finished. Blocks until resume if pool is paused with queued tasks.
+    void wait();
+
+    //! Pause or resume workers. Paused workers finish their running task and then sleep, keeping
+    //! queued tasks for resume. Parallel ranges still complete on the calling thread alone.
+    void setPaused(bool paused);
+
+    //! Returns true if workers are paused
+    bool isPaused() const { return m_paused.load(std::memory_order_relaxed); }
+
+    //! Split range [0, count) to chunks of at least grain size and run them in parallel. Calling thread
+    //! participates and the call returns once the whole range has been processed.
+    void parallelFor(int count, const RangeFunc& func, int grain = 1);
+
+private:
+    //! Worker thread main function
+    void workerMain();
+
+private:
+    std::vector<std::thread> m_threads;  //!< Worker threads
+    std::deque<Task> m_tasks;            //!< Queued tasks
+    std::mutex m_mutex;                  //!< Task queue mutex
+    std::condition_variable m_taskCond;  //!< Signaled when tasks are queued
+    std::condition_variable m_idleCond;  //!< Signaled when pool goes idle
+    int m_runningTasks = 0;              //!< Number of tasks being executed
+    std::atomic<int> m_queueDepth{0};    //!< Queued task count for lock-free monitoring
+    bool m_quit = false;                 //!< Quit flag for workers
+    std::atomic<bool> m_paused{false};   //!< Pause flag for workers
+};
+
+}  // namespace VarjoExamples
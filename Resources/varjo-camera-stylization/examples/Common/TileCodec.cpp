@@ -0,0 +1,205 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "TileCodec.hpp"
+
+#include <cstring>
+#include <cstdlib>
+#include <emmintrin.h>
+
+namespace
+{
+// QOI opcodes
+constexpr uint8_t c_opIndex = 0x00;
+constexpr uint8_t c_opDiff = 0x40;
+constexpr uint8_t c_opLuma = 0x80;
+constexpr uint8_t c_opRun = 0xc0;
+constexpr uint8_t c_opRGB = 0xfe;
+constexpr uint8_t c_opRGBA = 0xff;
+constexpr uint8_t c_opMask = 0xc0;
+
+// Maximum run length
+constexpr int c_maxRun = 62;
+
+//! RGBA pixel helper
+union Pixel {
+    struct {
+        uint8_t r, g, b, a;
+    } rgba;
+    uint32_t value;
+};
+
+// Color hash index
+inline int hashPixel(const Pixel& p) { return (p.rgba.r * 3 + p.rgba.g * 5 + p.rgba.b * 7 + p.rgba.a * 11) & 63; }
+
+}  // namespace
+
+namespace VarjoExamples
+{
+size_t TileCodec::getMaxEncodedSize(int width, int height) { return static_cast<size_t>(width) * height * 5; }
+
+size_t TileCodec::encode(const uint8_t* src, size_t rowStride, int width, int height, std::vector<uint8_t>& out)
+{
+    const size_t start = out.size();
+    out.resize(start + getMaxEncodedSize(width, height));
+    uint8_t* dst = out.data() + start;
+    size_t pos = 0;
+
+    Pixel index[64] = {};
+    Pixel prev;
+    prev.rgba = {0, 0, 0, 255};
+    int run = 0;
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t* row = src + rowStride * y;
+        for (int x = 0; x < width; x++) {
+            Pixel px;
+            memcpy(&px.value, row + x * 4, 4);
+
+            if (px.value == prev.value) {
+                run++;
+                if (run == c_maxRun) {
+                    dst[pos++] = c_opRun | (run - 1);
+                    run = 0;
+                }
+                continue;
+            }
+
+            if (run > 0) {
+                dst[pos++] = c_opRun | (run - 1);
+                run = 0;
+            }
+
+            const int hash = hashPixel(px);
+            if (index[hash].value == px.value) {
+                dst[pos++] = c_opIndex | static_cast<uint8_t>(hash);
+            } else {
+                index[hash] = px;
+
+                if (px.rgba.a == prev.rgba.a) {
+                    const int8_t dr = static_cast<int8_t>(px.rgba.r - prev.rgba.r);
+                    const int8_t dg = static_cast<int8_t>(px.rgba.g - prev.rgba.g);
+                    const int8_t db = static_cast<int8_t>(px.rgba.b - prev.rgba.b);
+                    const int8_t drg = dr - dg;
+                    const int8_t dbg = db - dg;
+
+                    if (dr > -3 && dr < 2 && dg > -3 && dg < 2 && db > -3 && db < 2) {
+                        dst[pos++] = c_opDiff | static_cast<uint8_t>((dr + 2) << 4 | (dg + 2) << 2 | (db + 2));
+                    } else if (drg > -9 && drg < 8 && dg > -33 && dg < 32 && dbg > -9 && dbg < 8) {
+                        dst[pos++] = c_opLuma | static_cast<uint8_t>(dg + 32);
+                        dst[pos++] = static_cast<uint8_t>((drg + 8) << 4 | (dbg + 8));
+                    } else {
+                        dst[pos++] = c_opRGB;
+                        dst[pos++] = px.rgba.r;
+                        dst[pos++] = px.rgba.g;
+                        dst[pos++] = px.rgba.b;
+                    }
+                } else {
+                    dst[pos++] = c_opRGBA;
+                    memcpy(dst + pos, &px.value, 4);
+                    pos += 4;
+                }
+            }
+            prev = px;
+        }
+    }
+
+    if (run > 0) {
+        dst[pos++] = c_opRun | (run - 1);
+    }
+
+    out.resize(start + pos);
+    return pos;
+}
+
+bool TileCodec::decode(const uint8_t* data, size_t dataSize, uint8_t* dst, size_t rowStride, int width, int height)
+{
+    Pixel index[64] = {};
+    Pixel px;
+    px.rgba = {0, 0, 0, 255};
+    int run = 0;
+    size_t pos = 0;
+
+    for (int y = 0; y < height; y++) {
+        uint8_t* row = dst + rowStride * y;
+        for (int x = 0; x < width; x++) {
+            if (run > 0) {
+                run--;
+            } else {
+                if (pos >= dataSize) {
+                    return false;
+                }
+
+                const uint8_t b1 = data[pos++];
+                if (b1 == c_opRGB) {
+                    if (pos + 3 > dataSize) {
+                        return false;
+                    }
+                    px.rgba.r = data[pos++];
+                    px.rgba.g = data[pos++];
+                    px.rgba.b = data[pos++];
+                } else if (b1 == c_opRGBA) {
+                    if (pos + 4 > dataSize) {
+                        return false;
+                    }
+                    memcpy(&px.value, data + pos, 4);
+                    pos += 4;
+                } else if ((b1 & c_opMask) == c_opIndex) {
+                    px = index[b1];
+                } else if ((b1 & c_opMask) == c_opDiff) {
+                    px.rgba.r += ((b1 >> 4) & 0x03) - 2;
+                    px.rgba.g += ((b1 >> 2) & 0x03) - 2;
+                    px.rgba.b += (b1 & 0x03) - 2;
+                } else if ((b1 & c_opMask) == c_opLuma) {
+                    if (pos >= dataSize) {
+                        return false;
+                    }
+                    const uint8_t b2 = data[pos++];
+                    const int dg = (b1 & 0x3f) - 32;
+                    px.rgba.r += dg - 8 + ((b2 >> 4) & 0x0f);
+                    px.rgba.g += dg;
+                    px.rgba.b += dg - 8 + (b2 & 0x0f);
+                } else {
+                    run = (b1 & 0x3f);
+                }
+
+                index[hashPixel(px)] = px;
+            }
+
+            memcpy(row + x * 4, &px.value, 4);
+        }
+    }
+
+    return pos == dataSize;
+}
+
+float TileCodec::meanAbsDiff(const uint8_t* a, size_t strideA, const uint8_t* b, size_t strideB, int width, int height)
+{
+    // Mask out alpha bytes
+    const __m128i mask = _mm_set1_epi32(0x00ffffff);
+    const int vecWidth = width & ~3;
+    uint64_t sum = 0;
+
+    for (int y = 0; y < height; y++) {
+        const uint8_t* rowA = a + strideA * y;
+        const uint8_t* rowB = b + strideB * y;
+
+        __m128i acc = _mm_setzero_si128();
+        for (int x = 0; x < vecWidth; x += 4) {
+            const __m128i va = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rowA + x * 4)), mask);
+            const __m128i vb = _mm_and_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(rowB + x * 4)), mask);
+            acc = _mm_add_epi64(acc, _mm_sad_epu8(va, vb));
+        }
+        sum += static_cast<uint64_t>(_mm_cvtsi128_si32(acc)) + static_cast<uint64_t>(_mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+
+        for (int x = vecWidth; x < width; x++) {
+            for (int c = 0; c < 3; c++) {
+                sum += std::abs(static_cast<int>(rowA[x * 4 + c]) - static_cast<int>(rowB[x * 4 + c]));
+            }
+        }
+    }
+
+    const int64_t samples = static_cast<int64_t>(width) * height * 3;
+    return samples > 0 ? static_cast<float>(sum) / static_cast<float>(samples) : 0.0f;
+}
+
+}  // namespace VarjoExamples
@@ -0,0 +1,33 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "Globals.hpp"
+
+namespace VarjoExamples
+{
+// NOTICE! Tile codec is a QOI style lossless RGBA8 encoder without file header. It is not
+// meant for storage but for quickly shipping small image tiles that changed between frames.
+
+//! Lossless RGBA8 tile codec
+class TileCodec
+{
+public:
+    //! Returns worst case encoded size for tile with given dimensions
+    static size_t getMaxEncodedSize(int width, int height);
+
+    //! Encode RGBA8 tile. Appends encoded bytes to output and returns number of bytes written.
+    static size_t encode(const uint8_t* src, size_t rowStride, int width, int height, std::vector<uint8_t>& out);
+
+    //! Decode RGBA8 tile to destination. Returns false if encoded data is corrupted.
+    static bool decode(const uint8_t* data, size_t dataSize, uint8_t* dst, size_t rowStride, int width, int height);
+
+    //! Returns mean absolute difference per channel between two RGBA8 tiles (alpha ignored)
+    static float meanAbsDiff(const uint8_t* a, size_t strideA, const uint8_t* b, size_t strideB, int width, int height);
+};
+
+}  // namespace VarjoExamples
@@ -0,0 +1,161 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "LogConsole.hpp"
+
+namespace
+{
+// Level names for combo box, indexed by log level
+const char* c_levelNames[] = {"Critical", "Error", "Warning", "Info", "Debug"};
+
+// Line colors, indexed by log level
+const ImVec4 c_levelColors[] = {
+    {1.0f, 0.2f, 0.2f, 1.0f},  // Critical
+    {1.0f, 0.4f, 0.4f, 1.0f},  // Error
+    {1.0f, 0.8f, 0.3f, 1.0f},  // Warning
+    {1.0f, 1.0f, 1.0f, 1.0f},  // Info
+    {0.6f, 0.6f, 0.6f, 1.0f},  // Debug
+};
+
+}  // namespace
+
+namespace VarjoExamples
+{
+LogConsole::LogConsole(size_t capacity)
+    : m_ring(capacity)
+    , m_history(m_ring.getCapacity())
+    , m_startTime(getTimestampNs())
+{
+}
+
+bool LogConsole::passFilter(const LogRing::Record& record) const
+{
+    return static_cast<int>(record.level) <= m_levelFilter && m_textFilter.PassFilter(record.text, record.text + record.length);
+}
+
+bool LogConsole::hasPublishedAfter(uint64_t index, uint64_t writeIndex) const
+{
+    for (uint64_t i = index + 1; i < writeIndex; i++) {
+        if (m_ring.isPublished(i)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void LogConsole::update()
+{
+    const uint64_t capacity = m_history.size();
+    const uint64_t writeIndex = m_ring.getWriteIndex();
+
+    // Skip records already overwritten in ring. History must stay contiguous, so older ones are dropped too.
+    const uint64_t oldest = m_ring.getOldestIndex();
+    if (m_historyEnd < oldest) {
+        m_lostCount += oldest - m_historyEnd;
+        m_historyBegin = oldest;
+        m_historyEnd = oldest;
+    }
+
+    while (m_historyEnd < writeIndex) {
+        LogRing::Record& record = m_history[m_historyEnd & (capacity - 1)];
+        if (!m_ring.read(m_historyEnd, record)) {
+            if (m_ring.getOldestIndex() <= m_historyEnd) {
+                // Not yet published. Writer that gave up on its slot never publishes the record, so once later
+                // records are published and this one is still missing on next frame, it is skipped as dropped.
+                if (!hasPublishedAfter(m_historyEnd, writeIndex)) {
+                    break;
+                }
+                if (m_pendingIndex != m_historyEnd) {
+                    m_pendingIndex = m_historyEnd;
+                    break;
+                }
+                m_droppedCount++;
+            } else {
+                // Overwritten while reading
+                m_lostCount++;
+            }
+            record.index = m_historyEnd;
+            record.length = 0;
+            record.text[0] = '\0';
+            record.level = LogLevel::Debug;
+            m_historyEnd++;
+            continue;
+        }
+
+        m_historyEnd++;
+        m_scrollToEnd = true;
+        if (passFilter(record)) {
+            m_filtered.push_back(record.index);
+        }
+    }
+
+    // Drop history records replaced by new ones
+    if (m_historyEnd - m_historyBegin > capacity) {
+        m_historyBegin = m_historyEnd - capacity;
+    }
+    while (!m_filtered.empty() && m_filtered.front() < m_historyBegin) {
+        m_filtered.pop_front();
+    }
+}
+
+void LogConsole::rebuildIndex()
+{
+    m_filtered.clear();
+    for (uint64_t i = m_historyBegin; i < m_historyEnd; i++) {
+        const auto& record = getRecord(i);
+        if (record.length > 0 && passFilter(record)) {
+            m_filtered.push_back(i);
+        }
+    }
+    m_scrollToEnd = true;
+}
+
+void LogConsole::clear()
+{
+    m_historyBegin = m_historyEnd;
+    m_filtered.clear();
+}
+
+void LogConsole::draw()
+{
+    update();
+
+    // Filter controls
+    bool filterChanged = false;
+    ImGui::PushItemWidth(100.0f);
+    filterChanged |= ImGui::Combo("Level", &m_levelFilter, c_levelNames, IM_ARRAYSIZE(c_levelNames));
+    ImGui::PopItemWidth();
+    ImGui::SameLine();
+    filterChanged |= m_textFilter.Draw("Filter", 200.0f);
+    if (filterChanged) {
+        rebuildIndex();
+    }
+    ImGui::SameLine();
+    ImGui::Checkbox("Auto-scroll", &m_autoScroll);
+    ImGui::SameLine();
+    if (ImGui::Button("Clear")) {
+        clear();
+    }
+    ImGui::SameLine();
+    ImGui::TextDisabled("%d/%d lines, %llu lost, %llu dropped", static_cast<int>(m_filtered.size()),
+        static_cast<int>(m_historyEnd - m_historyBegin), static_cast<unsigned long long>(m_lostCount),
+        static_cast<unsigned long long>(m_droppedCount));
+    ImGui::Separator();
+
+    // Lines. Clipper lays out only visible ones.
+    ImGui::BeginChild("LogLines", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
+    ImGuiListClipper clipper(static_cast<int>(m_filtered.size()));
+    while (clipper.Step()) {
+        for (int i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+            const auto& record = getRecord(m_filtered[i]);
+            const double time = static_cast<double>(record.timestamp - m_startTime) * 1e-9;
+            ImGui::TextColored(c_levelColors[static_cast<int>(record.level)], "%10.3f %6u  %s", time, record.threadId, record.text);
+        }
+    }
+    if (m_scrollToEnd && m_autoScroll) {
+        ImGui::SetScrollHereY(1.0f);
+    }
+    m_scrollToEnd = false;
+    ImGui::EndChild();
+}
+
+}  // namespace VarjoExamples
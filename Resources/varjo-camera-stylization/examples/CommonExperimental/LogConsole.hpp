@@ -0,0 +1,69 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <imgui.h>
+
+#include "Globals.hpp"
+#include "LogRing.hpp"
+
+namespace VarjoExamples
+{
+//! ImGui log console with bounded history. Lines are written to a lock free ring from any thread
+//! and copied to UI side history once per frame. Only visible lines of filtered history are drawn.
+class LogConsole
+{
+public:
+    //! Constructor
+    LogConsole(size_t capacity = LogRing::c_defaultCapacity);
+
+    // Disable copy, move and assign
+    LogConsole(const LogConsole& other) = delete;
+    LogConsole(const LogConsole&& other) = delete;
+    LogConsole& operator=(const LogConsole& other) = delete;
+    LogConsole& operator=(const LogConsole&& other) = delete;
+
+    //! Write log line. Lock free, can be called from any thread.
+    void write(LogLevel level, const std::string& line) { m_ring.write(level, line); }
+
+    //! Draw console into current ImGui window. Must be called from UI thread.
+    void draw();
+
+    //! Clear history. Must be called from UI thread.
+    void clear();
+
+private:
+    //! Copy new records from ring to history and index records passing filter
+    void update();
+
+    //! Rebuild filtered index from whole history
+    void rebuildIndex();
+
+    //! Returns true if record passes level and text filters
+    bool passFilter(const LogRing::Record& record) const;
+
+    //! Returns true if any record between given index and write index is published
+    bool hasPublishedAfter(uint64_t index, uint64_t writeIndex) const;
+
+    //! Returns history record for index
+    const LogRing::Record& getRecord(uint64_t index) const { return m_history[index & (m_history.size() - 1)]; }
+
+private:
+    LogRing m_ring;                                         //!< Lock free record ring written by logging threads
+    std::vector<LogRing::Record> m_history;                 //!< UI side record history, same capacity as ring
+    uint64_t m_historyBegin = 0;                            //!< Index of oldest valid history record
+    uint64_t m_historyEnd = 0;                              //!< Index of next history record
+    std::deque<uint64_t> m_filtered;                        //!< Indices of history records passing filter
+    ImGuiTextFilter m_textFilter;                           //!< Text filter
+    int m_levelFilter = static_cast<int>(LogLevel::Debug);  //!< Most verbose level shown
+    uint64_t m_lostCount = 0;                               //!< Records overwritten before they were copied
+    uint64_t m_droppedCount = 0;                            //!< Records never published, skipped after later ones were
+    uint64_t m_pendingIndex = UINT64_MAX;                   //!< Unpublished record waited for since previous update
+    int64_t m_startTime = 0;                                //!< Console creation timestamp for relative times
+    bool m_autoScroll = true;                               //!< Keep view at newest line
+    bool m_scrollToEnd = false;                             //!< New lines added since last draw
+};
+
+}  // namespace VarjoExamples
@@ -249,8 +249,14 @@ bool PostProcess::lockTextureBuffer(int textureIndex, varjo_Texture& varjoTextur
     varjoTexture = varjo_MRAcquireShaderTexture(m_session, varjo_ShaderType_VideoPostProcess, textureIndex);
     if (CHECK_VARJO_ERR(m_session) != varjo_NoError) {
         LOGE("Locking texture failed: index=%d", textureIndex);
+        if (m_metrics) {
+            m_metrics->increment(m_errorsMetric);
+        }
         return false;
     }
+    if (m_metrics) {
+        m_metrics->increment(m_locksMetric);
+    }
     return true;
 }
 
@@ -265,7 +271,20 @@ void PostProcess::applyInputBuffers(char* constantBuffer, int contantBufferSize,
     // Apply updated textures and constants to Varjo API
     varjo_MRSubmitShaderInputs(m_session, varjo_ShaderType_VideoPostProcess, textureIndices.empty() ? nullptr : textureIndices.data(),
         static_cast<int32_t>(textureIndices.size()), (contantBufferSize == 0) ? nullptr : constantBuffer, contantBufferSize);
-    CHECK_VARJO_ERR(m_session);
+    const bool failed = (CHECK_VARJO_ERR(m_session) != varjo_NoError);
+    if (m_metrics) {
+        m_metrics->increment(failed ? m_errorsMetric : m_submitsMetric);
+    }
+}
+
+void PostProcess::setMetrics(MetricsRegistry* metrics)
+{
+    m_metrics = metrics;
+    if (m_metrics) {
+        m_submitsMetric = m_metrics->addMetric("Post process: submits", MetricsRegistry::Kind::Counter);
+        m_locksMetric = m_metrics->addMetric("Post process: texture locks", MetricsRegistry::Kind::Counter);
+        m_errorsMetric = m_metrics->addMetric("Post process: errors", MetricsRegistry::Kind::Counter);
+    }
 }
 
 bool PostProcess::checkTextureFormat(GraphicsAPI api, varjo_TextureFormat format) const
@@ -11,6 +11,7 @@
 #include <Varjo_mr_experimental.h>
 
 #include "Globals.hpp"
+#include "MetricsRegistry.hpp"
 
 namespace VarjoExamples
 {
@@ -106,6 +107,9 @@ public:
     //! Returns current shader source
     ShaderSource getShaderSource() const { return m_shaderSource; }
 
+    //! Register post process metrics to given registry and update them from input buffer calls
+    void setMetrics(MetricsRegistry* metrics);
+
 private:
     //! Lock post processing feature for this session
     bool lock();
@@ -122,6 +126,11 @@ private:
     ShaderParams m_shaderParams{};                     //!< Shader parameters
     ComPtr<ID3D11Device> m_d3d11Device;                //!< D3D11 device instance
     ComPtr<ID3D12CommandQueue> m_d3d12CommandQueue;    //!< D3D12 command queue instance
+
+    MetricsRegistry* m_metrics = nullptr;                                //!< Metrics registry, null if not monitored
+    MetricsRegistry::Id m_submitsMetric = MetricsRegistry::c_invalidId;  //!< Shader input submits metric
+    MetricsRegistry::Id m_locksMetric = MetricsRegistry::c_invalidId;    //!< Texture locks metric
+    MetricsRegistry::Id m_errorsMetric = MetricsRegistry::c_invalidId;   //!< Failed Varjo calls metric
 };
 
 }  // namespace VarjoExamples
@@ -257,9 +257,8 @@ void UI::run()
         m_d3dDeviceContext->ClearRenderTargetView(m_d3dRenderTargetView.Get(), clearColor.data());
         ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
 
-        // Present with vsync OFF (We sync to Varjo API instead).
-        constexpr bool vsync = false;
-        m_d3dSwapChain->Present(vsync ? 1 : 0, 0);
+        // Present with vsync OFF unless enabled. Frame callback usually syncs to Varjo API instead.
+        m_d3dSwapChain->Present(m_vsync ? 1 : 0, 0);
     }
 
     LOGD("UI main loop finished.");
@@ -281,14 +280,7 @@ void UI::onKey(int keyCode)
     }
 }
 
-void UI::drawLog()
-{
-    ImGui::TextUnformatted(m_logBuf.begin());
-    if (m_scrollLog) {
-        ImGui::SetScrollHere(1.0f);
-    }
-    m_scrollLog = false;
-}
+void UI::drawLog() { m_logConsole.draw(); }
 
 void UI::writeLogEntry(LogLevel logLevel, const std::string& line)
 {
@@ -296,8 +288,7 @@ void UI::writeLogEntry(LogLevel logLevel, const std::string& line)
     std::cout << line << std::endl;
 
     // Write to imgui log
-    m_logBuf.appendf("%s\n", line.c_str());
-    m_scrollLog = true;
+    m_logConsole.write(logLevel, line);
 }
 
 }  // namespace VarjoExamples
@@ -6,6 +6,7 @@
 #include <imgui.h>
 
 #include "Globals.hpp"
+#include "LogConsole.hpp"
 
 // Forward declarations
 struct ID3D11Device;
@@ -43,7 +44,7 @@ public:
     //! Called on key press
     void onKey(int keyCode);
 
-    //! Write log message
+    //! Write log message. Can be called from any thread.
     void writeLogEntry(LogLevel logLevel, const std::string& logLine);
 
     //! Draw log buffers
@@ -52,6 +53,9 @@ public:
     //! Returns window handle
     HWND getWindowHandle() const { return m_hWnd; }
 
+    //! Set vertical sync of UI window. Off by default for frame callbacks that sync to Varjo frames.
+    void setVSync(bool enabled) { m_vsync = enabled; }
+
 private:
     //! Create window
     void createWindow(const std::wstring& title, int width, int height);
@@ -74,8 +78,8 @@ private:
     ComPtr<ID3D11DeviceContext> m_d3dDeviceContext;        //!< D3D device context
     ComPtr<IDXGISwapChain> m_d3dSwapChain;                 //!< Swap chain
     ComPtr<ID3D11RenderTargetView> m_d3dRenderTargetView;  //!< Render target
-    ImGuiTextBuffer m_logBuf;                              //!< Log buffer
-    bool m_scrollLog = true;                               //!< Scroll log to end flag
+    LogConsole m_logConsole;                               //!< Log console
+    bool m_vsync = false;                                  //!< Present with vertical sync
 };
 
 }  // namespace VarjoExamples
@@ -0,0 +1,744 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "BenchLogic.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+
+#include <Varjo.h>
+#include <Varjo_events.h>
+#include <Varjo_mr.h>
+#include <Varjo_mr_experimental.h>
+
+#include "BenchScene.hpp"
+#include "PostProcessConstants.hpp"
+
+// VarjoExamples namespace contains simple example wrappers for using Varjo API features.
+// These are only meant to be used in SDK example applications. In your own application,
+// use your own production quality integration layer.
+using namespace VarjoExamples;
+
+namespace
+{
+// Post process constants followed by pose dependent inputs for late latch measurements. The example
+// shader does not read the pose dependent inputs, so the application submits only the constants.
+struct LatchedConstantBuffer {
+    PostProcessConstantBuffer postProcess;           // Example shader constants
+    glm::vec2 gazePosition{0.0f};                    // Gaze point in left context view NDC
+    glm::vec2 _padding0{0.0f};                       // Padding to shader constant register boundary
+    glm::vec4 markerRect{0.0f};                      // Marker region in left context view NDC: min x, min y, max x, max y. Empty if no marker.
+    glm::vec4 reprojection{0.0f, 0.0f, 0.0f, 1.0f};  // Head rotation from render pose to latest tracked pose as quaternion x, y, z, w
+};
+static_assert(sizeof(LatchedConstantBuffer) <= LateLatch::c_maxConstantSize, "Constant buffer does not fit late latch");
+
+// Simulated GPU load alternates between normal and heavy scene content with this period
+constexpr int64_t c_gpuLoadPeriodFrames = 600;
+
+// Simulated GPU cost multiplier of heavy scene content
+constexpr double c_gpuHeavyLoad = 1.6;
+
+// Shared frame ring slots. Consumers releasing frames in time hold one slot each at most.
+constexpr int32_t c_frameRingSlots = 8;
+
+// Stream telemetry columns
+enum TelemetryColumn {
+    FrameNumber = 0,
+    Channel,
+    CaptureTime,
+    RecordTime,
+    ExposureTime,
+    Ev,
+    WhiteBalanceTemperature,
+    PositionX,
+    PositionY,
+    PositionZ,
+    RotationX,
+    RotationY,
+    RotationZ,
+    RotationW,
+    DetectTime,
+    StereoTime,
+    FlowTime,
+    OrientationTime,
+    StylizeTime,
+    QueueDepth,
+    ColumnCount
+};
+
+// Returns stream telemetry columns in column order
+std::vector<TelemetryStore::Column> getTelemetryColumns()
+{
+    using Type = TelemetryStore::ColumnType;
+    return {{"frameNumber", Type::Int}, {"channel", Type::Int}, {"captureTimeNs", Type::Int}, {"recordTimeNs", Type::Int},
+        {"exposureTime", Type::Float}, {"ev", Type::Float}, {"whiteBalanceTemperature", Type::Float}, {"positionX", Type::Float},
+        {"positionY", Type::Float}, {"positionZ", Type::Float}, {"rotationX", Type::Float}, {"rotationY", Type::Float}, {"rotationZ", Type::Float},
+        {"rotationW", Type::Float}, {"detectTimeNs", Type::Int}, {"stereoTimeNs", Type::Int}, {"flowTimeNs", Type::Int},
+        {"orientationTimeNs", Type::Int}, {"stylizeTimeNs", Type::Int}, {"queueDepth", Type::Int}};
+}
+
+}  // namespace
+
+//---------------------------------------------------------------------------
+
+BenchLogic::BenchLogic(const Options& options)
+    : m_options(options)
+{
+}
+
+BenchLogic::~BenchLogic()
+{
+    // Stop data streams before freeing their consumers, and latch thread before session
+    stopStreams();
+    m_lateLatch.reset();
+    m_dataStreamer.reset();
+    m_stylizer.reset();
+    m_fiducialDetector.reset();
+    m_stereoMatcher.reset();
+    m_flowTracker.reset();
+    m_orientationField.reset();
+    m_telemetry.reset();
+    m_frameRing.reset();
+    m_threadPool.reset();
+
+    // Free scene, view and renderer resources
+    m_scene.reset();
+    m_varjoView.reset();
+    m_renderer.reset();
+
+    // Shutdown the varjo session. Can't check errors anymore after this.
+    if (m_session) {
+        varjo_SessionShutDown(m_session);
+        m_session = nullptr;
+    }
+}
+
+std::vector<std::string> BenchLogic::getPhaseNames() { return {"events", "sync", "scene", "layers", "postprocess"}; }
+
+const std::vector<BenchLogic::Preset>& BenchLogic::getPresets()
+{
+    static const std::vector<Preset> presets = {
+        {"off", {}},
+        {"cartoon", {8, 1.0f, 0, 0.0f, 0.0f, 0.0f}},
+        {"watercolor", {0, 0.0f, 4, 0.0f, 0.0f, 0.0f}},
+        {"sketch", {0, 0.0f, 0, 1.0f, 0.0f, 0.0f}},
+        {"pointilism", {0, 0.0f, 0, 0.0f, 80.0f, 0.2f}},
+        {"outline-watercolor", {0, 1.0f, 4, 0.0f, 0.0f, 0.0f}},
+        {"oil-paint", {0, 0.0f, 0, 0.0f, 0.0f, 0.0f, 4}},
+    };
+    return presets;
+}
+
+bool BenchLogic::findPreset(const std::string& name, CpuStylizer::Params& outParams)
+{
+    for (const auto& preset : getPresets()) {
+        if (name == preset.name) {
+            outParams = preset.params;
+            return true;
+        }
+    }
+    LOGE("Unknown preset: %s", name.c_str());
+    return false;
+}
+
+bool BenchLogic::init()
+{
+    // Initialize the varjo session
+    m_session = varjo_SessionInit();
+    if (CHECK_VARJO_ERR(m_session) != varjo_NoError) {
+        LOGE("Creting Varjo session failed.");
+        return false;
+    }
+
+    // Create renderer, layer view and scene
+    m_renderer = std::make_unique<NullRenderer>();
+    m_varjoView = std::make_unique<NullLayerView>(m_session, *m_renderer);
+    m_scene = std::make_unique<BenchScene>(*m_renderer, m_options.objectCount);
+
+    // Create dynamic resolution controller for full resolution view sizes
+    if (m_options.resolutionBudgetMs > 0.0) {
+        double contextPixels = 0.0;
+        double focusPixels = 0.0;
+        for (int i = 0; i < m_varjoView->getViewCount(); i++) {
+            const varjo_Viewport& viewport = m_varjoView->getFullViewport(i);
+            (m_varjoView->isFocusView(i) ? focusPixels : contextPixels) += static_cast<double>(viewport.width) * viewport.height;
+        }
+        ResolutionScaler::Config config;
+        config.budgetMs = m_options.resolutionBudgetMs;
+        m_resolutionScaler = std::make_unique<ResolutionScaler>(config, contextPixels, focusPixels);
+    }
+
+    if (m_options.shadingRateEnabled) {
+        initShadingRate();
+    }
+
+    // Gaze feeds shading rate maps and pose dependent shader inputs
+    if (m_options.shadingRateEnabled || m_options.lateLatchEnabled) {
+        varjo_GazeInit(m_session);
+        m_gazeInitialized = CHECK_VARJO_ERR(m_session) == varjo_NoError;
+    }
+
+    // Check if Mixed Reality features are available.
+    varjo_SyncProperties(m_session);
+    CHECK_VARJO_ERR(m_session);
+    if (varjo_HasProperty(m_session, varjo_PropertyKey_MRAvailable)) {
+        m_mrAvailable = varjo_GetPropertyBool(m_session, varjo_PropertyKey_MRAvailable) == varjo_True;
+    }
+    if (m_mrAvailable) {
+        varjo_MRSetVideoRender(m_session, varjo_True);
+        CHECK_VARJO_ERR(m_session);
+    }
+
+    // Create stream consumers the same way as spectator stream does
+    m_threadPool = std::make_unique<ThreadPool>(m_options.threadCount);
+    m_stylizer = std::make_unique<CpuStylizer>(*m_threadPool);
+    m_dataStreamer = std::make_unique<DataStreamer>(m_session);
+    m_stylizerParams = m_options.params;
+    if (m_options.fiducialsEnabled) {
+        m_fiducialDetector = std::make_unique<FiducialDetector>(*m_threadPool, FiducialDetector::Config());
+    }
+    if (m_options.stereoEnabled) {
+        m_stereoMatcher = std::make_unique<StereoMatcher>(*m_threadPool, StereoMatcher::Config());
+        m_stereoMatcher->setMetrics(&m_metrics);
+    }
+    if (m_options.flowEnabled) {
+        m_flowTracker = std::make_unique<FlowTracker>(*m_threadPool, FlowTracker::Config());
+        m_flowTracker->setMetrics(&m_metrics);
+    }
+    if (m_options.orientationEnabled) {
+        m_orientationField = std::make_unique<OrientationField>(*m_threadPool, OrientationField::Config());
+        m_orientationField->setMetrics(&m_metrics);
+    }
+    if (!m_options.telemetryFile.empty() && !initTelemetry()) {
+        return false;
+    }
+    if (!m_options.frameRing.empty() && !initFrameRing()) {
+        return false;
+    }
+    if (m_options.lateLatchEnabled && m_mrAvailable) {
+        m_lateLatch = std::make_unique<LateLatch>(m_session, LateLatch::Config(), [this](LateLatch::Frame& frame) { return latchPoseInputs(frame); });
+        m_lateLatch->setMetrics(&m_metrics);
+        m_lateLatch->start();
+    }
+
+    // Register metrics under the same names as the application
+    const char* phaseMetricNames[] = {"Frame: events", "Frame: sync", "Frame: scene", "Frame: render", "Frame: post process"};
+    for (int i = 0; i < toIndex(Phase::Count); i++) {
+        m_phaseMetrics[i] = m_metrics.addMetric(phaseMetricNames[i], MetricsRegistry::Kind::Timer);
+    }
+    m_stylizeMetric = m_metrics.addMetric("Stream: stylize", MetricsRegistry::Kind::Timer);
+    if (m_fiducialDetector) {
+        m_detectMetric = m_metrics.addMetric("Markers: detect", MetricsRegistry::Kind::Timer);
+        m_markersMetric = m_metrics.addMetric("Markers: found", MetricsRegistry::Kind::Counter);
+    }
+    if (m_shadingRateMap) {
+        m_shadingRateMetric = m_metrics.addMetric("Frame: shading rate", MetricsRegistry::Kind::Timer);
+    }
+    m_dataStreamer->setMetrics(&m_metrics);
+
+    // Power state follows runtime events like in the application
+    PowerStateMachine::Config powerConfig;
+    powerConfig.streamRetryNs = static_cast<int64_t>(m_options.streamRetrySec * 1e9);
+    m_power = std::make_unique<PowerStateMachine>(powerConfig);
+    m_power->setMetrics(&m_metrics);
+
+    // Tags with shed support shed like the application does, others only warn
+    for (int i = 0; i < MemoryAccounting::c_tagCount; i++) {
+        const MemoryTag tag = static_cast<MemoryTag>(i);
+        MemoryBudget::Budget budget;
+        budget.bytes = m_options.memoryBudgets[i];
+        budget.policy = (tag == MemoryTag::Stylization) ? MemoryBudget::Policy::Shed : MemoryBudget::Policy::Warn;
+        m_memoryBudget.setBudget(tag, budget);
+    }
+    m_memoryBudget.setShedFunction(MemoryTag::Stylization, [this](int64_t) {
+        m_stylizer->setHalfIntermediates(m_stylizer->getHalfIntermediates() | CpuStylizer::getIntermediateMask(CpuStylizer::Intermediate::Luma) |
+                                         CpuStylizer::getIntermediateMask(CpuStylizer::Intermediate::WatercolorPlanes));
+        m_stylizer->releaseBuffers();
+    });
+    m_memoryBudget.setMetrics(&m_metrics);
+
+    if (m_options.streamEnabled) {
+        if (m_dataStreamer->getFormat(varjo_StreamType_DistortedColor) == varjo_TextureFormat_INVALID) {
+            LOGE("No color stream available.");
+            return false;
+        }
+        m_streamListener = m_dataStreamer->addFrameListener([this](const DataStreamer::Frame& frame) { onStreamFrame(frame); });
+        updateColorStream();
+    }
+
+    return true;
+}
+
+void BenchLogic::stopStreams()
+{
+    if (!m_dataStreamer) {
+        return;
+    }
+
+    // NOTICE! Data streamer stops streams in its destructor while holding its own lock, and stand-in
+    // runtime waits for the running frame callback there. Stop streams explicitly before that.
+    const varjo_StreamType streamType = varjo_StreamType_DistortedColor;
+    const varjo_TextureFormat streamFormat = m_dataStreamer->getFormat(streamType);
+    if (m_dataStreamer->isStreaming(streamType, streamFormat)) {
+        m_dataStreamer->stopDataStream(streamType, streamFormat);
+    }
+    if (m_streamListener >= 0) {
+        m_dataStreamer->removeFrameListener(m_streamListener);
+        m_streamListener = -1;
+    }
+
+    // No more rows are appended after streams have stopped
+    if (m_telemetry) {
+        m_telemetry->close();
+    }
+
+    // Consumers stop reading when ring is closed
+    if (m_frameRing) {
+        m_frameRing->close();
+    }
+}
+
+bool BenchLogic::initTelemetry()
+{
+    const std::vector<TelemetryStore::Column> columns = getTelemetryColumns();
+    assert(columns.size() == TelemetryColumn::ColumnCount);
+    m_telemetry = std::make_unique<TelemetryStore>(columns, TelemetryStore::Config());
+    m_telemetry->setMetrics(&m_metrics);
+    m_telemetryWriter = m_telemetry->createWriter();
+    return m_telemetry->open(m_options.telemetryFile);
+}
+
+bool BenchLogic::initFrameRing()
+{
+    std::vector<varjo_StreamConfig> configs(varjo_GetDataStreamConfigCount(m_session));
+    varjo_GetDataStreamConfigs(m_session, configs.data(), static_cast<int32_t>(configs.size()));
+    const auto config =
+        std::find_if(configs.begin(), configs.end(), [](const varjo_StreamConfig& c) { return c.streamType == varjo_StreamType_DistortedColor; });
+    if (config == configs.end()) {
+        LOGE("No color stream available for shared frame ring.");
+        return false;
+    }
+
+    // Two bytes per pixel fits both YUV422 and NV12 frames
+    const size_t slotSize = static_cast<size_t>(config->rowStride) * config->height * 2;
+    m_frameRing = std::make_unique<SharedFrameProducer>(m_options.frameRing, c_frameRingSlots, slotSize);
+    return m_frameRing->isValid();
+}
+
+void BenchLogic::updateColorStream()
+{
+    const varjo_StreamType streamType = varjo_StreamType_DistortedColor;
+    const varjo_TextureFormat streamFormat = m_dataStreamer->getFormat(streamType);
+    if (streamFormat == varjo_TextureFormat_INVALID) {
+        return;
+    }
+
+    const bool needed = m_streamListener >= 0 && !m_power->isStreamPaused();
+    const bool streaming = m_dataStreamer->isStreaming(streamType, streamFormat);
+    if (needed && !streaming) {
+        m_dataStreamer->startDataStream(streamType, streamFormat, varjo_ChannelFlag_Left | varjo_ChannelFlag_Right);
+    } else if (!needed && streaming) {
+        m_dataStreamer->stopDataStream(streamType, streamFormat);
+    }
+}
+
+void BenchLogic::onPowerStateChanged()
+{
+    // Consumers keep their buffers, so resumed frames do not allocate
+    m_threadPool->setPaused(m_power->isSuspended());
+    updateColorStream();
+}
+
+void BenchLogic::update(FrameProfiler& profiler)
+{
+    // Check for new mixed reality events
+    {
+        FrameProfiler::ScopedPhase phase(profiler, toIndex(Phase::Events));
+        MetricsRegistry::ScopedTimer timer(m_metrics, m_phaseMetrics[toIndex(Phase::Events)]);
+        checkEvents();
+        if (m_power->update(getTimestampNs())) {
+            onPowerStateChanged();
+        }
+    }
+    const bool suspended = m_power->isSuspended();
+    m_suspendedFrames += suspended ? 1 : 0;
+
+    // Sync frame
+    {
+        FrameProfiler::ScopedPhase phase(profiler, toIndex(Phase::Sync));
+        MetricsRegistry::ScopedTimer timer(m_metrics, m_phaseMetrics[toIndex(Phase::Sync)]);
+        m_varjoView->syncFrame();
+    }
+
+    // Update scene
+    {
+        FrameProfiler::ScopedPhase phase(profiler, toIndex(Phase::Scene));
+        MetricsRegistry::ScopedTimer timer(m_metrics, m_phaseMetrics[toIndex(Phase::Scene)]);
+        if (!suspended) {
+            m_scene->update(m_varjoView->getFrameTime(), m_varjoView->getDeltaTime(), m_varjoView->getFrameNumber(), Scene::UpdateParams());
+        }
+    }
+
+    // Render and submit layer
+    {
+        FrameProfiler::ScopedPhase phase(profiler, toIndex(Phase::Layers));
+        MetricsRegistry::ScopedTimer timer(m_metrics, m_phaseMetrics[toIndex(Phase::Layers)]);
+
+        // Suspended frames are still ended, but without layers
+        LayerView::SubmitParams submitParams{};
+        submitParams.submitLayer = m_options.vrEnabled && !suspended;
+        submitParams.submitDepth = true;
+        submitParams.depthTestEnabled = false;
+        submitParams.depthTestRangeEnabled = false;
+        submitParams.depthTestRangeLimits = {0.0f, 0.0f};
+        submitParams.chromaKeyEnabled = false;
+        submitParams.alphaBlend = true;
+
+        // Shading rate maps must be ready before views are rendered
+        if (m_shadingRateMap && !suspended) {
+            MetricsRegistry::ScopedTimer shadingRateTimer(m_metrics, m_shadingRateMetric);
+            updateShadingRate();
+        }
+
+        const int64_t pixelsBegin = m_renderer->getStats().viewportPixels;
+        m_varjoView->beginFrame(submitParams);
+        if (!suspended) {
+            m_varjoView->clear();
+            m_varjoView->renderScene(*m_scene);
+        }
+        m_varjoView->endFrame();
+
+        if (m_resolutionScaler && !suspended) {
+            updateResolution(m_renderer->getStats().viewportPixels - pixelsBegin);
+        }
+    }
+
+    // Pass state to stream consumers and post process, like application does every frame
+    {
+        FrameProfiler::ScopedPhase phase(profiler, toIndex(Phase::PostProcess));
+        MetricsRegistry::ScopedTimer timer(m_metrics, m_phaseMetrics[toIndex(Phase::PostProcess)]);
+        {
+            std::lock_guard<ProfiledMutex> lock(m_stylizerMutex);
+            m_stylizerParams = m_options.params;
+        }
+        if (m_mrAvailable && !suspended) {
+            updatePostProcessing();
+        }
+    }
+
+    m_memoryBudget.update(getTimestampNs());
+}
+
+void BenchLogic::updateResolution(int64_t pixels)
+{
+    // Null renderer does not render, so GPU time is simulated from rendered pixels
+    const bool heavy = (m_resolutionFrames / c_gpuLoadPeriodFrames) % 2 == 1;
+    const double gpuTimeMs = pixels * m_options.gpuNsPerPixel * (heavy ? c_gpuHeavyLoad : 1.0) * 1e-6;
+    m_resolutionFrames++;
+    m_gpuTimeTotalMs += gpuTimeMs;
+    m_pixelsTotal += static_cast<double>(pixels);
+
+    if (m_resolutionScaler->update(gpuTimeMs)) {
+        for (int i = 0; i < m_varjoView->getViewCount(); i++) {
+            m_varjoView->setViewScale(i, m_resolutionScaler->getScale(m_varjoView->isFocusView(i)));
+        }
+    }
+}
+
+bool BenchLogic::getResolutionStats(ResolutionStats& outStats) const
+{
+    if (!m_resolutionScaler) {
+        return false;
+    }
+    outStats.scaler = m_resolutionScaler->getStats();
+    outStats.contextScale = m_resolutionScaler->getContextScale();
+    outStats.focusScale = m_resolutionScaler->getFocusScale();
+    outStats.gpuTimeMeanMs = m_resolutionFrames > 0 ? m_gpuTimeTotalMs / m_resolutionFrames : 0.0;
+    outStats.pixelsMean = m_resolutionFrames > 0 ? m_pixelsTotal / m_resolutionFrames : 0.0;
+    return true;
+}
+
+void BenchLogic::initShadingRate()
+{
+    m_shadingRateMap = std::make_unique<ShadingRateMap>(ShadingRateMap::Config(), m_varjoView->getViewCount());
+    m_gazeNdc.assign(m_varjoView->getViewCount(), glm::vec2(0.0f));
+    for (int i = 0; i < m_varjoView->getViewCount(); i++) {
+        const varjo_Viewport& viewport = m_varjoView->getFullViewport(i);
+        m_shadingRateMap->setViewSize(i, viewport.width, viewport.height);
+
+        varjo_Mesh2Df* mesh = varjo_CreateOcclusionMesh(m_session, i, varjo_WindingOrder_CounterClockwise);
+        CHECK_VARJO_ERR(m_session);
+        m_shadingRateMap->setOcclusionMesh(i, mesh);
+        varjo_FreeOcclusionMesh(mesh);
+    }
+}
+
+void BenchLogic::updateShadingRate()
+{
+    // Without valid gaze views fall back to fixed foveation at view center
+    varjo_Gaze gaze{};
+    if (varjo_IsGazeAllowed(m_session)) {
+        gaze = varjo_GetGaze(m_session);
+        CHECK_VARJO_ERR(m_session);
+    }
+    for (int i = 0; i < m_varjoView->getViewCount(); i++) {
+        if (!ShadingRateMap::projectGaze(gaze, m_varjoView->getProjectionMatrix(i), m_gazeNdc[i])) {
+            m_gazeNdc[i] = glm::vec2(0.0f);
+        }
+    }
+    m_shadingRateMap->generate(m_gazeNdc);
+}
+
+void BenchLogic::updatePostProcessing()
+{
+    const auto& params = m_options.params;
+
+    // Set shader constant parameter values
+    LatchedConstantBuffer cBuffer{};
+    cBuffer.postProcess.clusterSize = params.clusterSize;
+    cBuffer.postProcess.outlineIntensity = params.outlineIntensity;
+    cBuffer.postProcess.watercolorRadius = params.watercolorRadius;
+    cBuffer.postProcess.sketchIntensity = params.sketchIntensity;
+    cBuffer.postProcess.pointilismStep = params.pointilismStep;
+    cBuffer.postProcess.pointilismThreshold = params.pointilismThreshold;
+
+    // Pose dependent inputs are sampled here for the left context view the frame was rendered with
+    LateLatch::Frame frame;
+    frame.frameNumber = m_varjoView->getFrameNumber();
+    frame.displayTime = varjo_FrameGetDisplayTime(m_session);
+    frame.view = m_varjoView->getViewMatrix(0);
+    frame.projection = m_varjoView->getProjectionMatrix(0);
+    frame.constantSize = sizeof(cBuffer);
+    memcpy(frame.constants.data(), &cBuffer, sizeof(cBuffer));
+    frame.sampleTime = latchPoseInputs(frame);
+
+    // Latch thread samples them again just before compositor deadline and submits
+    if (m_lateLatch) {
+        m_lateLatch->submit(frame);
+        return;
+    }
+
+    // Update constant buffer
+    varjo_MRSubmitShaderInputs(m_session, varjo_ShaderType_VideoPostProcess, nullptr, 0, frame.constants.data(), frame.constantSize);
+    CHECK_VARJO_ERR(m_session);
+}
+
+varjo_Nanoseconds BenchLogic::latchPoseInputs(LateLatch::Frame& frame)
+{
+    LatchedConstantBuffer cBuffer;
+    memcpy(&cBuffer, frame.constants.data(), sizeof(cBuffer));
+    varjo_Nanoseconds sampleTime = varjo_GetCurrentTime(m_session);
+
+    if (m_gazeInitialized && varjo_IsGazeAllowed(m_session)) {
+        const varjo_Gaze gaze = varjo_GetGaze(m_session);
+        CHECK_VARJO_ERR(m_session);
+        glm::vec2 ndc(0.0f);
+        if (ShadingRateMap::projectGaze(gaze, frame.projection, ndc)) {
+            cBuffer.gazePosition = ndc;
+            sampleTime = std::min(sampleTime, gaze.captureTime);
+        }
+    }
+
+    TrackedPose tracked;
+    {
+        std::lock_guard<ProfiledMutex> lock(m_trackingMutex);
+        tracked = m_trackedPose;
+    }
+    if (tracked.time > 0) {
+        // Head rotation from render pose to tracked pose. Translation is small within a frame, so view
+        // is only rotated about the eye like rotational reprojection does.
+        const glm::quat renderRotation = glm::quat_cast(glm::inverse(frame.view));
+        const glm::quat delta = glm::inverse(renderRotation) * glm::quat_cast(tracked.hmdPose);
+        cBuffer.reprojection = glm::vec4(delta.x, delta.y, delta.z, delta.w);
+        sampleTime = std::min(sampleTime, tracked.time);
+
+        // Bounds of marker corners in front of the eye
+        cBuffer.markerRect = glm::vec4(0.0f);
+        if (tracked.hasMarker) {
+            const glm::mat4 viewProjection = frame.projection * glm::mat4_cast(glm::inverse(delta)) * frame.view;
+            glm::vec2 minNdc(std::numeric_limits<float>::max());
+            glm::vec2 maxNdc(std::numeric_limits<float>::lowest());
+            bool visible = true;
+            for (int i = 0; i < 4; i++) {
+                const glm::vec4 corner((i & 1 ? 0.5f : -0.5f) * tracked.markerSize.x, (i & 2 ? 0.5f : -0.5f) * tracked.markerSize.y, 0.0f, 1.0f);
+                const glm::vec4 clip = viewProjection * tracked.markerPose * corner;
+                visible = visible && clip.w > 0.0f;
+                const glm::vec2 ndc = glm::vec2(clip) / clip.w;
+                minNdc = glm::min(minNdc, ndc);
+                maxNdc = glm::max(maxNdc, ndc);
+            }
+            if (visible) {
+                cBuffer.markerRect = glm::vec4(minNdc, maxNdc);
+            }
+        }
+    }
+
+    memcpy(frame.constants.data(), &cBuffer, sizeof(cBuffer));
+    return sampleTime;
+}
+
+void BenchLogic::onStreamFrame(const DataStreamer::Frame& frame)
+{
+    if (frame.type != varjo_StreamType_DistortedColor) {
+        return;
+    }
+
+    // Consumer processes get the frame before it is processed here. Publishing never waits for them.
+    if (m_frameRing) {
+        m_frameRing->publish(frame);
+    }
+
+    // Markers are detected before stylizing, like a tracker consuming the same stream would
+    int64_t detectTimeNs = 0;
+    if (m_fiducialDetector) {
+        const int64_t detectBegin = getTimestampNs();
+        m_markers.clear();
+        if (m_fiducialDetector->detect(frame, m_markers)) {
+            m_fiducialFrames++;
+        }
+        detectTimeNs = getTimestampNs() - detectBegin;
+        m_detectTimeNs += detectTimeNs;
+        m_metrics.recordTime(m_detectMetric, detectTimeNs);
+
+        if (!m_markers.empty()) {
+            const glm::vec3 cameraPosition(fromVarjoMatrix(frame.hmdPose) * fromVarjoMatrix(frame.extrinsics)[3]);
+            m_markerDistance = glm::distance(cameraPosition, glm::vec3(m_markers.begin()->second.pose[3]));
+            m_fiducialHits++;
+            m_metrics.increment(m_markersMetric);
+        }
+    }
+
+    // Latest pose and marker for pose dependent shader inputs
+    {
+        std::lock_guard<ProfiledMutex> lock(m_trackingMutex);
+        m_trackedPose.hmdPose = fromVarjoMatrix(frame.hmdPose);
+        m_trackedPose.time = frame.metadata.distortedColor.timestamp;
+        if (m_fiducialDetector) {
+            m_trackedPose.hasMarker = !m_markers.empty();
+            if (m_trackedPose.hasMarker) {
+                m_trackedPose.markerPose = m_markers.begin()->second.pose;
+                m_trackedPose.markerSize = m_markers.begin()->second.size;
+            }
+        }
+    }
+
+    // Luma plane comes first in YUV formats. One channel is enough for detail estimate.
+    const bool hasLuma = frame.buffer.format == varjo_TextureFormat_YUV422 || frame.buffer.format == varjo_TextureFormat_NV12;
+    const uint8_t* luma = static_cast<const uint8_t*>(frame.cpuData);
+    if (m_shadingRateMap && frame.channelIndex == varjo_ChannelIndex_Left && hasLuma) {
+        m_shadingRateMap->updateEdges(luma, frame.buffer.width, frame.buffer.height, frame.buffer.rowStride, frame.frameNumber);
+    }
+
+    // Channels are rectified as they arrive and matched once both have arrived
+    const int64_t stereoBegin = getTimestampNs();
+    if (m_stereoMatcher && hasLuma && frame.hasIntrinsics && frame.hasExtrinsics) {
+        if (m_stereoMatcher->addImage(frame.channelIndex, luma, frame.buffer.width, frame.buffer.height, frame.buffer.rowStride, frame.intrinsics,
+                frame.extrinsics, frame.frameNumber)) {
+            m_stereoMatcher->match();
+        }
+    }
+    const int64_t flowBegin = getTimestampNs();
+    if (m_flowTracker && frame.channelIndex == varjo_ChannelIndex_Left && hasLuma) {
+        m_flowTracker->update(luma, frame.buffer.width, frame.buffer.height, frame.buffer.rowStride, frame.frameNumber);
+    }
+
+    // Orientation is computed once per frame before stylizing, so that effects can share it
+    const int64_t orientationBegin = getTimestampNs();
+    if (m_orientationField && frame.channelIndex == varjo_ChannelIndex_Left && hasLuma) {
+        m_orientationField->update(luma, frame.buffer.width, frame.buffer.height, frame.buffer.rowStride, frame.frameNumber);
+    }
+
+    const int64_t begin = getTimestampNs();
+    if (!m_stylizer->convert(frame.buffer, frame.cpuData, m_streamImage) && !DataStreamer::convertToRGBA(frame.buffer, frame.cpuData, m_streamImage)) {
+        return;
+    }
+
+    CpuStylizer::Params params;
+    {
+        std::lock_guard<ProfiledMutex> lock(m_stylizerMutex);
+        params = m_stylizerParams;
+    }
+
+    const int width = frame.buffer.width;
+    const int height = frame.buffer.height;
+    const size_t stride = static_cast<size_t>(width) * 4;
+    m_streamStylized.resize(m_streamImage.size());
+    m_stylizer->stylize(m_streamImage.data(), stride, m_streamStylized.data(), stride, width, height, params);
+
+    const int64_t end = getTimestampNs();
+    const int64_t streamTimeNs = end - begin;
+    m_streamTimeNs += streamTimeNs;
+    m_metrics.recordTime(m_stylizeMetric, streamTimeNs);
+    m_streamFrames++;
+
+    // Telemetry row replaces per-frame logging. Appending never blocks this thread.
+    if (m_telemetryWriter) {
+        const varjo_DistortedColorFrameMetadata& metadata = frame.metadata.distortedColor;
+        const glm::mat4 pose = fromVarjoMatrix(frame.hmdPose);
+        const glm::quat rotation = glm::quat_cast(pose);
+        TelemetryStore::Row row;
+        row.setInt(TelemetryColumn::FrameNumber, frame.frameNumber);
+        row.setInt(TelemetryColumn::Channel, static_cast<int64_t>(frame.channelIndex));
+        row.setInt(TelemetryColumn::CaptureTime, metadata.timestamp);
+        row.setInt(TelemetryColumn::RecordTime, end);
+        row.setFloat(TelemetryColumn::ExposureTime, metadata.exposureTime);
+        row.setFloat(TelemetryColumn::Ev, metadata.ev);
+        row.setFloat(TelemetryColumn::WhiteBalanceTemperature, metadata.whiteBalanceTemperature);
+        row.setFloat(TelemetryColumn::PositionX, pose[3].x);
+        row.setFloat(TelemetryColumn::PositionY, pose[3].y);
+        row.setFloat(TelemetryColumn::PositionZ, pose[3].z);
+        row.setFloat(TelemetryColumn::RotationX, rotation.x);
+        row.setFloat(TelemetryColumn::RotationY, rotation.y);
+        row.setFloat(TelemetryColumn::RotationZ, rotation.z);
+        row.setFloat(TelemetryColumn::RotationW, rotation.w);
+        row.setInt(TelemetryColumn::DetectTime, detectTimeNs);
+        row.setInt(TelemetryColumn::StereoTime, flowBegin - stereoBegin);
+        row.setInt(TelemetryColumn::FlowTime, orientationBegin - flowBegin);
+        row.setInt(TelemetryColumn::OrientationTime, begin - orientationBegin);
+        row.setInt(TelemetryColumn::StylizeTime, streamTimeNs);
+        row.setInt(TelemetryColumn::QueueDepth, m_threadPool->getQueueDepth());
+        m_telemetryWriter->append(row);
+    }
+}
+
+BenchLogic::StreamStats BenchLogic::getStreamStats() const
+{
+    StreamStats stats;
+    stats.frames = m_streamFrames;
+    stats.stylizeTimeNs = m_streamTimeNs;
+    stats.fiducialFrames = m_fiducialFrames;
+    stats.fiducialHits = m_fiducialHits;
+    stats.detectTimeNs = m_detectTimeNs;
+    stats.markerDistance = m_markerDistance;
+    return stats;
+}
+
+void BenchLogic::checkEvents()
+{
+    varjo_Bool ret = varjo_False;
+
+    do {
+        varjo_Event evt{};
+        ret = varjo_PollEvent(m_session, &evt);
+        CHECK_VARJO_ERR(m_session);
+
+        if (ret == varjo_True) {
+            switch (evt.header.type) {
+                case varjo_EventType_MRDeviceStatus: {
+                    m_mrAvailable = (evt.data.mrDeviceStatus.status == varjo_MRDeviceStatus_Connected);
+                } break;
+                case varjo_EventType_DataStreamStop: {
+                    // Stops requested by this application are already forgotten by data streamer
+                    if (m_dataStreamer->onStreamStopped(evt.data.dataStreamStop.streamId)) {
+                        m_power->setReason(PowerStateMachine::Reason::StreamStopped, true);
+                    }
+                } break;
+                default: {
+                    // Power events, others are ignored
+                    m_power->handleEvent(evt);
+                } break;
+            }
+        }
+    } while (ret);
+}
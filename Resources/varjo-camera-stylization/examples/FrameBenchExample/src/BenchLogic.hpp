@@ -0,0 +1,277 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <string>
+#include <array>
+#include <atomic>
+
+#include "Globals.hpp"
+#include "NullRenderer.hpp"
+#include "NullLayerView.hpp"
+#include "Scene.hpp"
+#include "ThreadPool.hpp"
+#include "DataStreamer.hpp"
+#include "CpuStylizer.hpp"
+#include "FiducialDetector.hpp"
+#include "FrameProfiler.hpp"
+#include "MetricsRegistry.hpp"
+#include "MemoryAccounting.hpp"
+#include "ResolutionScaler.hpp"
+#include "ShadingRateMap.hpp"
+#include "PowerStateMachine.hpp"
+#include "StereoMatcher.hpp"
+#include "FlowTracker.hpp"
+#include "OrientationField.hpp"
+#include "TelemetryStore.hpp"
+#include "LateLatch.hpp"
+#include "SharedFrameRing.hpp"
+
+//! Frame loop of the video post process example running against stand-in runtime and null renderer
+class BenchLogic
+{
+public:
+    //! Measured frame phases
+    enum class Phase {
+        Events = 0,   //!< Polling and handling Varjo events
+        Sync,         //!< Frame sync
+        Scene,        //!< Scene update
+        Layers,       //!< Layer frame begin, clear, render and submit
+        PostProcess,  //!< Post process state and shader input submit
+        Count
+    };
+
+    //! Benchmark options
+    struct Options {
+        VarjoExamples::CpuStylizer::Params params;  //!< Effect parameters
+        int objectCount = 250;                      //!< Number of scene objects
+        bool vrEnabled = true;                      //!< Render and submit VR layer
+        bool streamEnabled = true;                  //!< Stylize color stream frames on stream thread
+        int threadCount = 0;                        //!< Stream worker threads, zero for default
+        bool fiducialsEnabled = false;              //!< Detect fiducial markers from color stream frames
+        double resolutionBudgetMs = 0.0;            //!< Dynamic resolution frame budget, zero to disable
+        double gpuNsPerPixel = 2.5;                 //!< Simulated GPU render cost per rendered pixel
+        bool shadingRateEnabled = false;            //!< Generate shading rate maps from gaze, occlusion and stream frames
+        double streamRetrySec = 2.0;                //!< Time before restarting stream stopped by runtime
+        bool stereoEnabled = false;                 //!< Estimate disparity from left and right color stream frames
+        bool flowEnabled = false;                   //!< Track points over left color stream frames
+        bool orientationEnabled = false;            //!< Compute orientation field of left color stream frames
+        std::string telemetryFile;                  //!< Per-frame stream telemetry file, empty to disable
+        bool lateLatchEnabled = false;              //!< Submit pose dependent shader inputs from latch thread just before compositor deadline
+        std::string frameRing;                      //!< Shared frame ring color stream frames are published to, empty to disable
+
+        std::array<int64_t, VarjoExamples::MemoryAccounting::c_tagCount> memoryBudgets{};  //!< Memory budget bytes per tag, zero for unlimited
+    };
+
+    //! Dynamic resolution statistics
+    struct ResolutionStats {
+        VarjoExamples::ResolutionScaler::Stats scaler;  //!< Controller statistics
+        float contextScale = 1.0f;                      //!< Current context view scale
+        float focusScale = 1.0f;                        //!< Current focus view scale
+        double gpuTimeMeanMs = 0.0;                     //!< Mean simulated GPU time
+        double pixelsMean = 0.0;                        //!< Mean rendered pixels per frame
+    };
+
+    //! Stream consumer statistics
+    struct StreamStats {
+        int64_t frames = 0;           //!< Stylized stream frames
+        int64_t stylizeTimeNs = 0;    //!< Total conversion and stylize time
+        int64_t fiducialFrames = 0;   //!< Stream frames searched for fiducial markers
+        int64_t fiducialHits = 0;     //!< Stream frames with a marker pose found
+        int64_t detectTimeNs = 0;     //!< Total fiducial detection time
+        double markerDistance = 0.0;  //!< Camera distance of last marker found
+    };
+
+    //! Effect preset
+    struct Preset {
+        const char* name;                           //!< Preset name
+        VarjoExamples::CpuStylizer::Params params;  //!< Effect parameters
+    };
+
+    //! Constructor
+    BenchLogic(const Options& options);
+
+    //! Destructor
+    ~BenchLogic();
+
+    // Disable copy, move and assign
+    BenchLogic(const BenchLogic& other) = delete;
+    BenchLogic(const BenchLogic&& other) = delete;
+    BenchLogic& operator=(const BenchLogic& other) = delete;
+    BenchLogic& operator=(const BenchLogic&& other) = delete;
+
+    //! Initialize session, view, scene and stream consumers
+    bool init();
+
+    //! Run one frame measuring phases with given profiler
+    void update(VarjoExamples::FrameProfiler& profiler);
+
+    //! Stop streams. Must be called before destruction if streams were started.
+    void stopStreams();
+
+    //! Returns phase names in phase order
+    static std::vector<std::string> getPhaseNames();
+
+    //! Returns effect presets matching typical post process UI settings
+    static const std::vector<Preset>& getPresets();
+
+    //! Find effect parameters of preset with given name. Returns false if not found.
+    static bool findPreset(const std::string& name, VarjoExamples::CpuStylizer::Params& outParams);
+
+    //! Returns stream consumer statistics
+    StreamStats getStreamStats() const;
+
+    //! Returns dynamic resolution statistics. Returns false if dynamic resolution is disabled.
+    bool getResolutionStats(ResolutionStats& outStats) const;
+
+    //! Returns renderer call statistics
+    const VarjoExamples::NullRenderer::Stats& getRendererStats() const { return m_renderer->getStats(); }
+
+    //! Returns metrics registry updated by frame loop and stream consumers
+    const VarjoExamples::MetricsRegistry& getMetrics() const { return m_metrics; }
+
+    //! Set effect parameters used from next frame on
+    void setParams(const VarjoExamples::CpuStylizer::Params& params) { m_options.params = params; }
+
+    //! Returns memory budget statistics
+    VarjoExamples::MemoryBudget::Stats getMemoryBudgetStats() const { return m_memoryBudget.getStats(); }
+
+    //! Returns shading rate map generator, null if disabled
+    const VarjoExamples::ShadingRateMap* getShadingRateMap() const { return m_shadingRateMap.get(); }
+
+    //! Returns stereo matcher, null if disabled. Read statistics only after streams have been stopped.
+    const VarjoExamples::StereoMatcher* getStereoMatcher() const { return m_stereoMatcher.get(); }
+
+    //! Returns flow tracker, null if disabled. Read statistics only after streams have been stopped.
+    const VarjoExamples::FlowTracker* getFlowTracker() const { return m_flowTracker.get(); }
+
+    //! Returns orientation field, null if disabled. Read statistics only after streams have been stopped.
+    const VarjoExamples::OrientationField* getOrientationField() const { return m_orientationField.get(); }
+
+    //! Returns telemetry store, null if disabled. Store is closed when streams are stopped.
+    const VarjoExamples::TelemetryStore* getTelemetry() const { return m_telemetry.get(); }
+
+    //! Returns shared frame ring producer, null if disabled. Read statistics only after streams have been stopped.
+    const VarjoExamples::SharedFrameProducer* getFrameRing() const { return m_frameRing.get(); }
+
+    //! Returns late latch, null if disabled
+    const VarjoExamples::LateLatch* getLateLatch() const { return m_lateLatch.get(); }
+
+    //! Returns power state machine
+    const VarjoExamples::PowerStateMachine& getPowerState() const { return *m_power; }
+
+    //! Returns frames run suspended
+    int64_t getSuspendedFrames() const { return m_suspendedFrames; }
+
+private:
+    //! Returns profiler phase index
+    static int toIndex(Phase phase) { return static_cast<int>(phase); }
+
+    //! Check for Varjo API events
+    void checkEvents();
+
+    //! Update post processing shader inputs
+    void updatePostProcessing();
+
+    //! Start color stream if it has a consumer and power state allows, otherwise stop it
+    void updateColorStream();
+
+    //! Pause or resume stream and worker threads after power state change
+    void onPowerStateChanged();
+
+    //! Feed simulated GPU time of rendered pixels to resolution controller and apply view scales
+    void updateResolution(int64_t pixels);
+
+    //! Create shading rate map generator with view sizes and occlusion meshes of session
+    void initShadingRate();
+
+    //! Generate shading rate maps for current gaze
+    void updateShadingRate();
+
+    //! Detect markers from, match and stylize color stream frame. Called from data stream thread.
+    void onStreamFrame(const VarjoExamples::DataStreamer::Frame& frame);
+
+    //! Create telemetry store and open telemetry file
+    bool initTelemetry();
+
+    //! Create shared frame ring with slots sized for color stream frames
+    bool initFrameRing();
+
+    //! Recompute gaze point, marker region and reprojection in frame constants from latest gaze and
+    //! tracked pose. Returns oldest sample time. Called from frame thread and latch thread.
+    varjo_Nanoseconds latchPoseInputs(VarjoExamples::LateLatch::Frame& frame);
+
+    //! Latest tracking state from color stream
+    struct TrackedPose {
+        glm::mat4 hmdPose{1.0f};     //!< HMD world pose
+        varjo_Nanoseconds time = 0;  //!< Capture time of HMD pose, zero if none
+        bool hasMarker = false;      //!< Marker found in last searched frame
+        glm::mat4 markerPose{1.0f};  //!< World pose of marker
+        glm::vec3 markerSize{0.0f};  //!< Size of marker
+    };
+
+private:
+    Options m_options;                   //!< Benchmark options
+    varjo_Session* m_session = nullptr;  //!< Varjo session
+    bool m_mrAvailable = false;          //!< Mixed reality available flag
+
+    std::unique_ptr<VarjoExamples::NullRenderer> m_renderer;    //!< Renderer instance
+    std::unique_ptr<VarjoExamples::NullLayerView> m_varjoView;  //!< Varjo layer view instance
+    std::unique_ptr<VarjoExamples::Scene> m_scene;              //!< Benchmark scene instance
+
+    std::unique_ptr<VarjoExamples::ResolutionScaler> m_resolutionScaler;  //!< Dynamic resolution controller
+    int64_t m_resolutionFrames = 0;                                       //!< Frames fed to resolution controller
+    double m_gpuTimeTotalMs = 0.0;                                        //!< Total simulated GPU time
+    double m_pixelsTotal = 0.0;                                           //!< Total rendered pixels
+
+    std::unique_ptr<VarjoExamples::ThreadPool> m_threadPool;      //!< Worker threads for CPU image processing
+    std::unique_ptr<VarjoExamples::DataStreamer> m_dataStreamer;  //!< Camera data streamer
+    std::unique_ptr<VarjoExamples::CpuStylizer> m_stylizer;       //!< CPU stylizer for stream frames
+    int m_streamListener = -1;                                    //!< Stream frame listener id
+    std::vector<uint8_t> m_streamImage;                           //!< Stream RGBA conversion buffer
+    std::vector<uint8_t> m_streamStylized;                        //!< Stream stylized image buffer
+
+    VarjoExamples::ProfiledMutex m_stylizerMutex;         //!< Stylizer params mutex
+    VarjoExamples::CpuStylizer::Params m_stylizerParams;  //!< Stylizer params shared with stream thread
+    std::atomic<int64_t> m_streamFrames{0};               //!< Stylized stream frames
+    std::atomic<int64_t> m_streamTimeNs{0};               //!< Stream frame processing time
+
+    std::unique_ptr<VarjoExamples::FiducialDetector> m_fiducialDetector;  //!< Fiducial marker detector for stream frames
+    VarjoExamples::MarkerTracker::MarkerMap m_markers;                    //!< World space markers found from stream
+    std::atomic<int64_t> m_fiducialFrames{0};                             //!< Stream frames searched for markers
+    std::atomic<int64_t> m_fiducialHits{0};                               //!< Stream frames with a marker pose found
+    std::atomic<int64_t> m_detectTimeNs{0};                               //!< Fiducial detection time
+    std::atomic<double> m_markerDistance{0.0};                            //!< Camera distance of last marker found
+
+    std::unique_ptr<VarjoExamples::StereoMatcher> m_stereoMatcher;        //!< Stereo matcher for left and right stream frames
+    std::unique_ptr<VarjoExamples::FlowTracker> m_flowTracker;            //!< Point tracker for left stream frames
+    std::unique_ptr<VarjoExamples::OrientationField> m_orientationField;  //!< Orientation field of left stream frames
+
+    VarjoExamples::ProfiledMutex m_trackingMutex;  //!< Tracked pose mutex
+    TrackedPose m_trackedPose;                     //!< Tracking state shared with frame and latch threads
+
+    bool m_gazeInitialized = false;                         //!< Gaze tracking initialized
+    std::unique_ptr<VarjoExamples::LateLatch> m_lateLatch;  //!< Pose dependent shader input latch
+
+    std::unique_ptr<VarjoExamples::TelemetryStore> m_telemetry;          //!< Per-frame stream telemetry
+    VarjoExamples::TelemetryStore::Writer* m_telemetryWriter = nullptr;  //!< Telemetry writer of data stream thread
+
+    std::unique_ptr<VarjoExamples::SharedFrameProducer> m_frameRing;  //!< Color stream frames for consumer processes
+
+    VarjoExamples::MetricsRegistry m_metrics;                                                            //!< Runtime metrics
+    std::array<VarjoExamples::MetricsRegistry::Id, static_cast<size_t>(Phase::Count)> m_phaseMetrics{};  //!< Frame phase timers
+    VarjoExamples::MetricsRegistry::Id m_stylizeMetric = VarjoExamples::MetricsRegistry::c_invalidId;    //!< Stream stylize timer
+    VarjoExamples::MetricsRegistry::Id m_detectMetric = VarjoExamples::MetricsRegistry::c_invalidId;     //!< Marker detection timer
+    VarjoExamples::MetricsRegistry::Id m_markersMetric = VarjoExamples::MetricsRegistry::c_invalidId;    //!< Frames with marker found counter
+
+    VarjoExamples::MemoryBudget m_memoryBudget;  //!< Subsystem memory budgets
+
+    std::unique_ptr<VarjoExamples::ShadingRateMap> m_shadingRateMap;                                       //!< Shading rate map generator
+    std::vector<glm::vec2> m_gazeNdc;                                                                      //!< Gaze point per view
+    VarjoExamples::MetricsRegistry::Id m_shadingRateMetric = VarjoExamples::MetricsRegistry::c_invalidId;  //!< Shading rate map timer
+
+    std::unique_ptr<VarjoExamples::PowerStateMachine> m_power;  //!< Power and load state from runtime events
+    int64_t m_suspendedFrames = 0;                              //!< Frames run suspended
+};
@@ -0,0 +1,43 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "BenchReport.hpp"
+
+#include <cstdio>
+#include <fstream>
+
+#include "Globals.hpp"
+
+// VarjoExamples namespace contains simple example wrappers for using Varjo API features.
+// These are only meant to be used in SDK example applications. In your own application,
+// use your own production quality integration layer.
+using namespace VarjoExamples;
+
+void printDistribution(const char* name, const FrameProfiler::Distribution& d)
+{
+    printf("  %-14s %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f %8.3f\n", name, d.min, d.mean, d.p50, d.p90, d.p95, d.p99, d.max);
+}
+
+nlohmann::json toJson(const FrameProfiler::Distribution& d)
+{
+    return {{"min", d.min}, {"mean", d.mean}, {"p50", d.p50}, {"p90", d.p90}, {"p95", d.p95}, {"p99", d.p99}, {"max", d.max}};
+}
+
+nlohmann::json toJson(const FrameProfiler::Counters& c)
+{
+    return {{"allocations", c.allocations}, {"allocatedBytes", c.allocatedBytes}, {"lockWaits", c.lockWaits}, {"lockWaitTimeNs", c.lockWaitTimeNs}};
+}
+
+bool writeReport(const std::string& filename, const nlohmann::json& report)
+{
+    if (filename.empty()) {
+        return true;
+    }
+
+    std::ofstream file(filename);
+    if (!file) {
+        LOGE("Opening file failed: %s", filename.c_str());
+        return false;
+    }
+    file << report.dump(4) << std::endl;
+    return true;
+}
@@ -0,0 +1,21 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <string>
+
+#include <json/json.hpp>
+
+#include "FrameProfiler.hpp"
+
+//! Print distribution table row
+void printDistribution(const char* name, const VarjoExamples::FrameProfiler::Distribution& d);
+
+//! Convert distribution to JSON
+nlohmann::json toJson(const VarjoExamples::FrameProfiler::Distribution& d);
+
+//! Convert allocation and lock counters to JSON
+nlohmann::json toJson(const VarjoExamples::FrameProfiler::Counters& c);
+
+//! Write JSON report to given file. Empty file name writes nothing. Returns false if file could not be opened.
+bool writeReport(const std::string& filename, const nlohmann::json& report);
@@ -0,0 +1,136 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "BenchScene.hpp"
+
+#include <cmath>
+
+#include "ExampleShaders.hpp"
+
+// VarjoExamples namespace contains simple example wrappers for using Varjo API features.
+// These are only meant to be used in SDK example applications. In your own application,
+// use your own production quality integration layer.
+using namespace VarjoExamples;
+
+namespace
+{
+// Scene luminance constant to simulate proper lighting.
+constexpr double c_sceneLuminance = 196.0 / 3.0;
+
+// Scene dimensions
+constexpr float c_cubeSize = 0.30f;
+constexpr float c_gridSpacing = 1.0f;
+
+// Object dimensions
+constexpr float d = 1.0f;
+constexpr float r = d * 0.5f;
+
+// clang-format off
+
+// Vertex data for cube
+const std::vector<float> c_cubeVertexData = {
+    -r, -r, -r, 0, 0, 0,
+    -r, -r, r, 0, 0, 1,
+    -r, r, -r, 0, 1, 0,
+    -r, r, r, 0, 1, 1,
+    r, -r, -r, 1, 0, 0,
+    r, -r, r, 1, 0, 1,
+    r, r, -r, 1, 1, 0,
+    r, r, r, 1, 1, 1,
+};
+
+// Index data for cube
+const std::vector<unsigned short> c_cubeIndexData = {
+    0, 2, 1,
+    1, 2, 3,
+    4, 5, 6,
+    5, 7, 6,
+    0, 1, 5,
+    0, 5, 4,
+    2, 6, 7,
+    2, 7, 3,
+    0, 4, 6,
+    0, 6, 2,
+    1, 3, 7,
+    1, 7, 5,
+};
+
+// clang-format on
+
+}  // namespace
+
+BenchScene::BenchScene(Renderer& renderer, int objectCount)
+    : m_cubeMesh(renderer.createMesh(c_cubeVertexData, sizeof(float) * 6, c_cubeIndexData, Renderer::PrimitiveTopology::TriangleList))
+    , m_cubeShader(renderer.getShaders().createShader(ExampleShaders::ShaderType::RainbowCube))
+{
+    // Smallest cubic grid fitting all objects
+    m_cubes.resize(std::max(objectCount, 0));
+    while (m_gridSize * m_gridSize * m_gridSize < objectCount) {
+        m_gridSize++;
+    }
+}
+
+void BenchScene::onUpdate(double frameTime, double deltaTime, int64_t frameCounter, const UpdateParams& params)
+{
+    // Animate all objects so that update cost does not depend on frame content
+    const double animPhase = 2.0 * frameTime;
+    const double animScale = 0.3;
+
+    // Constant multiplier x1.2 is commonly used is EV100 to luminance conversion
+    const double camLuminance = std::pow(2.0, -params.cameraParams.exposureEV) / params.cameraParams.cameraCalibrationConstant;
+    float tgtExposureGain = static_cast<float>(camLuminance);
+
+    // Do some simple filtering for exposure gain.
+    m_exposureGain = glm::mix(m_exposureGain, tgtExposureGain, m_exposureGain < 0.0 ? 1.0 : 0.5);
+    m_wbNormalization = params.cameraParams.wbNormalizationData;
+
+    // Scale lighting with scene luminance.
+    m_lighting = ExampleShaders::LightingData();
+    m_lighting.ambientLight *= c_sceneLuminance;
+
+    // Scene grid offsets: X centered, Y on floor, Z in front
+    const float gridOffs = 0.5f * (m_gridSize - 1);
+    const float offsY = 0.5f * c_cubeSize;
+    const float offsZ = 1.0f + 0.5f * c_cubeSize;
+
+    for (size_t i = 0; i < m_cubes.size(); i++) {
+        const int x = static_cast<int>(i) % m_gridSize;
+        const int y = (static_cast<int>(i) / m_gridSize) % m_gridSize;
+        const int z = static_cast<int>(i) / (m_gridSize * m_gridSize);
+
+        auto& object = m_cubes[i];
+        object.pose.position = {c_gridSpacing * (x - gridOffs), offsY + c_gridSpacing * y, -(offsZ + c_gridSpacing * z)};
+        object.pose.rotation = glm::angleAxis(static_cast<float>(animPhase + i), glm::vec3(0.0f, 1.0f, 0.0f));
+        const float s = static_cast<float>(c_cubeSize * (1.0 + animScale * sin(animPhase + x + y + z)));
+        object.pose.scale = {s, s, s};
+        object.color = {0.5f, 0.5f, 0.5f, 1.0f};
+        object.vtxColorFactor = 1.0f;
+    }
+}
+
+void BenchScene::onRender(Renderer& renderer, Renderer::RenderTarget& target, const glm::mat4x4& viewMat, const glm::mat4x4& projMat, void* userData) const
+{
+    // Bind the cube shader
+    renderer.bindShader(*m_cubeShader);
+
+    // Render cubes
+    for (const auto& object : m_cubes) {
+        // Calculate model transformation
+        glm::mat4x4 modelMat(1.0);
+        modelMat = glm::translate(modelMat, object.pose.position);
+        modelMat *= glm::toMat4(object.pose.rotation);
+        modelMat = glm::scale(modelMat, object.pose.scale);
+
+        ExampleShaders::RainbowCubeConstants constants{};
+
+        constants.vs.transform = ExampleShaders::TransformData(modelMat, viewMat, projMat);
+        constants.vs.vtxColorFactor = object.vtxColorFactor;
+        constants.vs.objectColor = object.color;
+        constants.vs.objectScale = object.pose.scale;
+
+        constants.ps.lighting = m_lighting;
+        constants.ps.exposureGain = m_exposureGain;
+        constants.ps.wbNormalization = m_wbNormalization;
+
+        renderer.renderMesh(*m_cubeMesh, constants.vs, constants.ps);
+    }
+}
@@ -0,0 +1,452 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "CompositeValidation.hpp"
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+#include "Globals.hpp"
+#include "ThreadPool.hpp"
+#include "SimdMath.hpp"
+#include "CpuRenderer.hpp"
+#include "CpuCompositor.hpp"
+#include "CpuLayerView.hpp"
+#include "CpuStylizer.hpp"
+#include "BenchScene.hpp"
+
+// VarjoExamples namespace contains simple example wrappers for using Varjo API features.
+// These are only meant to be used in SDK example applications. In your own application,
+// use your own production quality integration layer.
+using namespace VarjoExamples;
+
+namespace
+{
+// Compositor validation: synthetic image size, not a multiple of row span or lane width, largest difference
+// to expected color in 8 bit units, preview view size as divisor of stream size and preview frames timed per
+// SIMD level after the first frame
+constexpr int c_compositeWidth = 150;
+constexpr int c_compositeHeight = 70;
+constexpr int c_compositeMaxError = 1;
+constexpr int c_compositePreviewDivisor = 2;
+constexpr int c_compositeTimingFrames = 10;
+
+// Benchmark scene time of composited scene views
+constexpr double c_compositeSceneTime = 1.0;
+
+}  // namespace
+
+//---------------------------------------------------------------------------
+
+CompositeValidation::CompositeValidation(int threadCount, int objectCount, int streamSize, int streamFps)
+    : Validation("Composite", "composite")
+    , m_threadCount(threadCount)
+    , m_objectCount(objectCount)
+    , m_streamSize(streamSize)
+    , m_streamFps(streamFps)
+{
+}
+
+void CompositeValidation::validate()
+{
+    ThreadPool threadPool(m_threadCount);
+    m_result.threads = threadPool.getThreadCount() + 1;
+
+    constexpr int w = c_compositeWidth;
+    constexpr int h = c_compositeHeight;
+    const size_t count = static_cast<size_t>(w) * h;
+    const auto toLinear = [](int v) {
+        const double s = v / 255.0;
+        return s <= 0.04045 ? s / 12.92 : std::pow((s + 0.055) / 1.055, 2.4);
+    };
+    const auto toSrgb = [](double v) {
+        v = std::min(std::max(v, 0.0), 1.0);
+        return static_cast<int>((v <= 0.0031308 ? 12.92 * v : 1.055 * std::pow(v, 1.0 / 2.4) - 0.055) * 255.0 + 0.5);
+    };
+    const auto pack = [](const glm::ivec4& c) { return static_cast<uint32_t>(c.r | (c.g << 8) | (c.b << 16) | (c.a << 24)); };
+
+    // Depth buffer value of distance in meters for LayerView clip planes
+    const CpuCompositor::LayerParams defaults;
+    const auto toDepth = [&](double z) { return static_cast<float>(defaults.farZ * (z - defaults.nearZ) / (z * (defaults.farZ - defaults.nearZ))); };
+
+    // Synthetic inputs: layer color and depth, video color and depth, left and right halves set separately
+    std::vector<uint32_t> layerColor(count);
+    std::vector<float> layerDepth(count, toDepth(1.0));
+    std::vector<uint8_t> videoColor(count * 4);
+    std::vector<float> videoDepth(count);
+    std::vector<uint8_t> output(count * 4);
+    const auto fillLayer = [&](const glm::ivec4& left, const glm::ivec4& right) {
+        for (size_t i = 0; i < count; i++) {
+            layerColor[i] = pack(static_cast<int>(i % w) < w / 2 ? left : right);
+        }
+    };
+    const auto fillVideo = [&](const glm::ivec3& left, const glm::ivec3& right) {
+        for (size_t i = 0; i < count; i++) {
+            const glm::ivec3& c = static_cast<int>(i % w) < w / 2 ? left : right;
+            videoColor[i * 4 + 0] = static_cast<uint8_t>(c.r);
+            videoColor[i * 4 + 1] = static_cast<uint8_t>(c.g);
+            videoColor[i * 4 + 2] = static_cast<uint8_t>(c.b);
+            videoColor[i * 4 + 3] = 255;
+        }
+    };
+    CpuCompositor::LayerImage layer;
+    layer.color = layerColor.data();
+    layer.colorStride = w;
+    layer.depth = layerDepth.data();
+    layer.depthStride = w;
+    CpuCompositor::VideoFrame video;
+    video.color = videoColor.data();
+    video.colorStride = w * 4;
+    video.depthStride = w;
+
+    CpuCompositor compositor(threadPool, CpuCompositor::Config());
+    const auto run = [&](const CpuCompositor::LayerParams& params) { return compositor.composite(params, layer, video, output.data(), w * 4, w, h); };
+
+    // Largest difference of output to expected colors of left and right halves
+    const auto errorTo = [&](const glm::ivec3& left, const glm::ivec3& right) {
+        int error = 0;
+        for (size_t i = 0; i < count; i++) {
+            const glm::ivec3& c = static_cast<int>(i % w) < w / 2 ? left : right;
+            for (int ch = 0; ch < 3; ch++) {
+                error = std::max(error, std::abs(output[i * 4 + ch] - c[ch]));
+            }
+            error = std::max(error, 255 - output[i * 4 + 3]);
+        }
+        m_result.maxError = std::max(m_result.maxError, error);
+        return error;
+    };
+    const auto blend = [&](const glm::ivec4& l, const glm::ivec3& v, bool premultiplied, bool invert) {
+        const double a = (invert ? 255 - l.a : l.a) / 255.0;
+        glm::ivec3 c;
+        for (int ch = 0; ch < 3; ch++) {
+            c[ch] = toSrgb(toLinear(l[ch]) * (premultiplied ? 1.0 : a) + toLinear(v[ch]) * (1.0 - a));
+        }
+        return c;
+    };
+
+    // HSV chroma key with hue tolerance of a few degrees, wide saturation and value tolerances
+    const auto hsvKey = [](float h, float s, float v) {
+        varjo_ChromaKeyConfig config{};
+        config.type = varjo_ChromaKeyType_HSV;
+        config.params.hsv.targetColor[0] = h;
+        config.params.hsv.targetColor[1] = s;
+        config.params.hsv.targetColor[2] = v;
+        config.params.hsv.tolerance[0] = 0.05;
+        config.params.hsv.tolerance[1] = 0.3;
+        config.params.hsv.tolerance[2] = 0.3;
+        config.params.hsv.falloff[0] = 0.02;
+        config.params.hsv.falloff[1] = 0.1;
+        config.params.hsv.falloff[2] = 0.1;
+        return config;
+    };
+
+    const glm::ivec4 layerA(200, 100, 50, 255);
+    const glm::ivec4 layerB(120, 60, 30, 128);
+    const glm::ivec3 videoA(40, 200, 90);
+    const glm::ivec3 videoB(250, 10, 160);
+    const glm::ivec3 layerRgbA(layerA);
+    const glm::ivec3 layerRgbB(layerB);
+
+    // Alpha
+    {
+        CpuCompositor::LayerParams params;
+        params.flags = 0;
+        fillLayer(layerA, layerB);
+        fillVideo(videoA, videoB);
+        check(run(params) && errorTo(layerRgbA, layerRgbB) <= c_compositeMaxError, "opaque layer replaces video");
+
+        params.flags = varjo_LayerFlag_BlendMode_AlphaBlend;
+        check(run(params) && errorTo(blend(layerA, videoA, true, false), blend(layerB, videoB, true, false)) <= c_compositeMaxError,
+            "premultiplied alpha blends");
+        params.premultiplied = false;
+        check(run(params) && errorTo(blend(layerA, videoA, false, false), blend(layerB, videoB, false, false)) <= c_compositeMaxError,
+            "straight alpha blends");
+        params.premultiplied = true;
+        params.flags |= varjo_LayerFlag_InvertAlpha;
+        check(run(params) && errorTo(blend(layerA, videoA, true, true), blend(layerB, videoB, true, true)) <= c_compositeMaxError,
+            "inverted alpha blends");
+    }
+
+    // Depth: opaque layer at 1 m over video at 0.5 m on left and 2 m on right
+    {
+        CpuCompositor::LayerParams params;
+        params.flags = varjo_LayerFlag_BlendMode_AlphaBlend | varjo_LayerFlag_DepthTesting;
+        fillLayer(layerA, layerA);
+        fillVideo(videoA, videoB);
+        video.constantDepth = 2.0f;
+        check(run(params) && errorTo(layerRgbA, layerRgbA) <= c_compositeMaxError, "layer in front of constant depth");
+        video.constantDepth = 0.5f;
+        check(run(params) && errorTo(videoA, videoB) <= c_compositeMaxError, "layer behind constant depth");
+
+        // Invalid estimates fall back to constant depth
+        for (size_t i = 0; i < count; i++) {
+            videoDepth[i] = static_cast<int>(i % w) < w / 2 ? 0.5f : (i / w == 0 ? -1.0f : 2.0f);
+        }
+        video.depth = videoDepth.data();
+        video.constantDepth = 2.0f;
+        check(run(params) && errorTo(videoA, layerRgbA) <= c_compositeMaxError, "layer tested against estimated depth");
+
+        params.depthTestRangeEnabled = true;
+        params.depthTestNearZ = 0.0;
+        params.depthTestFarZ = 0.8;
+        check(run(params) && errorTo(layerRgbA, layerRgbA) <= c_compositeMaxError, "layer outside test range blended");
+        params.depthTestFarZ = 1.5;
+        check(run(params) && errorTo(videoA, layerRgbA) <= c_compositeMaxError, "layer inside test range tested");
+        video.depth = nullptr;
+
+        layer.depth = nullptr;
+        check(!run(params), "depth testing needs layer depth");
+        layer.depth = layerDepth.data();
+    }
+
+    // Chroma key: green and blue keys, red key at the hue wrap around
+    {
+        CpuCompositor::LayerParams params;
+        params.flags = varjo_LayerFlag_BlendMode_AlphaBlend | varjo_LayerFlag_ChromaKeyMasking;
+        fillLayer(layerA, layerA);
+        const glm::ivec3 green(20, 200, 30);
+        const glm::ivec3 gray(128, 128, 128);
+        fillVideo(green, gray);
+        varjo_ChromaKeyConfig disabled{};
+        check(compositor.setChromaKeys({hsvKey(1.0f / 3.0f, 0.9f, 0.8f), disabled}) && run(params) && errorTo(layerRgbA, gray) <= c_compositeMaxError,
+            "chroma key shows layer on keyed video");
+        fillVideo(gray, glm::ivec3(30, 20, 210));
+        check(compositor.setChromaKeys({hsvKey(1.0f / 3.0f, 0.9f, 0.8f), hsvKey(2.0f / 3.0f, 0.9f, 0.8f)}) && run(params) &&
+                  errorTo(gray, layerRgbA) <= c_compositeMaxError,
+            "chroma keys combine");
+        fillVideo(glm::ivec3(210, 25, 10), gray);
+        check(compositor.setChromaKeys({hsvKey(0.99f, 0.9f, 0.8f)}) && run(params) && errorTo(layerRgbA, gray) <= c_compositeMaxError,
+            "chroma key hue wraps around");
+        check(compositor.setChromaKeys({}) && run(params) && errorTo(glm::ivec3(210, 25, 10), gray) <= c_compositeMaxError,
+            "no chroma key hides layer");
+    }
+
+    // Random inputs with all features: SIMD variants and single thread match scalar on the pool
+    {
+        const auto random = [](size_t i, uint32_t seed) { return getLatticeValue(static_cast<int>(i % w), static_cast<int>(i / w), seed); };
+        const auto byte = [&](size_t i, uint32_t seed) { return static_cast<int>(random(i, seed) * 256.0); };
+        for (size_t i = 0; i < count; i++) {
+            // Premultiplied layer color
+            const int a = byte(i, 0);
+            layerColor[i] = pack(glm::ivec4(byte(i, 1) * a / 255, byte(i, 2) * a / 255, byte(i, 3) * a / 255, a));
+            layerDepth[i] = toDepth(0.3 + 2.7 * random(i, 4));
+            for (int ch = 0; ch < 3; ch++) {
+                videoColor[i * 4 + ch] = static_cast<uint8_t>(byte(i, 5 + ch));
+            }
+            videoDepth[i] = static_cast<float>(0.3 + 2.7 * random(i, 8));
+        }
+        video.depth = videoDepth.data();
+        CpuCompositor::LayerParams params;
+        params.flags = varjo_LayerFlag_BlendMode_AlphaBlend | varjo_LayerFlag_DepthTesting | varjo_LayerFlag_ChromaKeyMasking;
+        params.depthTestRangeEnabled = true;
+        params.depthTestFarZ = 2.0;
+        varjo_ChromaKeyConfig key{};
+        key.type = varjo_ChromaKeyType_HSV;
+        for (int c = 0; c < 3; c++) {
+            key.params.hsv.targetColor[c] = 0.5;
+            key.params.hsv.tolerance[c] = 0.2;
+            key.params.hsv.falloff[c] = 0.2;
+        }
+
+        const auto runVariant = [&](ThreadPool& pool, SimdLevel level) {
+            CpuCompositor::Config config;
+            config.simd = level;
+            CpuCompositor variant(pool, config);
+            variant.setChromaKeys({key});
+            std::vector<uint8_t> out(count * 4);
+            variant.composite(params, layer, video, out.data(), w * 4, w, h);
+            return out;
+        };
+        const std::vector<uint8_t> reference = runVariant(threadPool, SimdLevel::Scalar);
+        for (SimdLevel level : {SimdLevel::SSE41, SimdLevel::AVX2}) {
+            if (isSimdLevelSupported(level)) {
+                const std::vector<uint8_t> out = runVariant(threadPool, level);
+                for (size_t i = 0; i < out.size(); i++) {
+                    m_result.simdError = std::max(m_result.simdError, std::abs(out[i] - reference[i]));
+                }
+            }
+        }
+        check(m_result.simdError <= c_compositeMaxError, "SIMD variants match");
+
+        ThreadPool serialPool(1);
+        serialPool.setPaused(true);
+        const std::vector<uint8_t> serial = runVariant(serialPool, SimdLevel::Scalar);
+        serialPool.setPaused(false);
+        check(serial == reference, "output independent of thread count");
+        video.depth = nullptr;
+    }
+
+    // Benchmark scene views composited over stylized camera frames. Views are captured, so that preview frames
+    // render the same scene.
+    varjo_Session* session = varjo_SessionInit();
+    if (!session) {
+        check(false, "session init");
+        return;
+    }
+    CpuRenderer renderer(threadPool, CpuRenderer::Config());
+    BenchScene scene(renderer, m_objectCount);
+    CpuStylizer stylizer(threadPool);
+    CpuStylizer::Params cartoon;
+    BenchLogic::findPreset("cartoon", cartoon);
+
+    // Camera frame: gradient with a green screen rectangle, stylized like the post process does
+    const auto makeCameraFrame = [&](int width, int height) {
+        std::vector<uint8_t> camera(static_cast<size_t>(width) * height * 4);
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                uint8_t* p = &camera[(static_cast<size_t>(y) * width + x) * 4];
+                const bool screen = x > width / 3 && x < 2 * width / 3 && y > height / 3 && y < 2 * height / 3;
+                p[0] = static_cast<uint8_t>(screen ? 20 : 255 * x / width);
+                p[1] = static_cast<uint8_t>(screen ? 200 : 255 * y / height);
+                p[2] = static_cast<uint8_t>(screen ? 30 : 128);
+                p[3] = 255;
+            }
+        }
+        std::vector<uint8_t> stylized(camera.size());
+        stylizer.stylize(camera.data(), static_cast<size_t>(width) * 4, stylized.data(), static_cast<size_t>(width) * 4, width, height, cartoon);
+        return stylized;
+    };
+
+    struct View {
+        varjo_Viewport viewport;
+        glm::mat4 view;
+        glm::mat4 projection;
+    };
+    std::vector<View> views;
+    {
+        CpuLayerView layerView(session, renderer);
+        layerView.syncFrame();
+        scene.update(c_compositeSceneTime, 0.0, 0, Scene::UpdateParams());
+        const LayerView::SubmitParams submitParams;
+        layerView.beginFrame(submitParams);
+        const glm::ivec2 atlasSize = layerView.getSize();
+        CpuRenderer::RenderTarget atlas(atlasSize.x, atlasSize.y);
+        layerView.clearTarget(atlas, LayerView::ClearParams());
+        layerView.renderSceneToTarget(atlas, scene, LayerView::RenderParams());
+
+        const CpuCompositor::LayerParams params = CpuCompositor::getLayerParams(submitParams);
+        bool composited = true;
+        int64_t mismatch = 0;
+        for (int i = 0; i < layerView.getViewCount(); i++) {
+            const varjo_Viewport& vp = layerView.getViewport(i);
+            views.push_back({vp, layerView.getViewMatrix(i), layerView.getProjectionMatrix(i)});
+
+            // Layer view image is the view region of the atlas
+            const size_t offset = static_cast<size_t>(vp.y) * atlasSize.x + vp.x;
+            CpuCompositor::LayerImage viewLayer;
+            viewLayer.color = atlas.getColor() + offset;
+            viewLayer.colorStride = atlasSize.x;
+            viewLayer.depth = atlas.getDepth() + offset;
+            viewLayer.depthStride = atlasSize.x;
+            const std::vector<uint8_t> camera = makeCameraFrame(vp.width, vp.height);
+            CpuCompositor::VideoFrame viewVideo;
+            viewVideo.color = camera.data();
+            viewVideo.colorStride = static_cast<size_t>(vp.width) * 4;
+            std::vector<uint8_t> out(camera.size());
+            composited = composited && compositor.composite(params, viewLayer, viewVideo, out.data(), viewVideo.colorStride, vp.width, vp.height);
+
+            // Transparent layer shows stylized video, opaque layer replaces it
+            for (int y = 0; y < vp.height; y++) {
+                for (int x = 0; x < vp.width; x++) {
+                    const uint32_t l = viewLayer.color[static_cast<size_t>(y) * atlasSize.x + x];
+                    const size_t p = (static_cast<size_t>(y) * vp.width + x) * 4;
+                    if ((l >> 24) == 0 || (l >> 24) == 255) {
+                        const bool opaque = (l >> 24) == 255;
+                        m_result.layerPixels += opaque;
+                        m_result.videoPixels += !opaque;
+                        for (int ch = 0; ch < 3; ch++) {
+                            const int expected = opaque ? static_cast<int>((l >> (ch * 8)) & 0xff) : camera[p + ch];
+                            mismatch += std::abs(out[p + ch] - expected) > c_compositeMaxError;
+                        }
+                    }
+                }
+            }
+        }
+        layerView.endFrame();
+        check(composited && mismatch == 0 && m_result.layerPixels > 0 && m_result.videoPixels > 0, "scene views composite over stylized video");
+    }
+    varjo_SessionShutDown(session);
+
+    // Preview frame: stereo views rendered from the first two views, all layer features enabled
+    const int previewSize = m_streamSize / c_compositePreviewDivisor;
+    m_result.previewSize = glm::ivec2(previewSize);
+    m_result.previewViews = std::min(static_cast<int>(views.size()), 2);
+    m_result.budgetMs = m_streamFps > 0 ? 1000.0 / m_streamFps : 0.0;
+    std::vector<std::unique_ptr<CpuRenderer::RenderTarget>> previewLayers;
+    for (int i = 0; i < m_result.previewViews; i++) {
+        previewLayers.push_back(std::make_unique<CpuRenderer::RenderTarget>(previewSize, previewSize));
+        CpuRenderer::RenderTarget& target = *previewLayers.back();
+        renderer.clear(target, glm::vec4(0.0f), true, true, true, 1.0f, 0);
+        renderer.bindRenderTarget(target);
+        renderer.setViewport(0, 0, previewSize, previewSize);
+        scene.render(renderer, target, views[i].view, views[i].projection);
+        renderer.unbindRenderTarget();
+    }
+    const std::vector<uint8_t> previewCamera = makeCameraFrame(previewSize, previewSize);
+    std::vector<uint8_t> previewOut(previewCamera.size());
+    CpuCompositor::LayerParams previewParams;
+    previewParams.flags = varjo_LayerFlag_BlendMode_AlphaBlend | varjo_LayerFlag_DepthTesting | varjo_LayerFlag_ChromaKeyMasking;
+    previewParams.depthTestRangeEnabled = true;
+    previewParams.depthTestFarZ = 5.0;
+    CpuCompositor::VideoFrame previewVideo;
+    previewVideo.color = previewCamera.data();
+    previewVideo.colorStride = static_cast<size_t>(previewSize) * 4;
+    previewVideo.constantDepth = 2.0f;
+
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2}) {
+        if (!isSimdLevelSupported(level)) {
+            continue;
+        }
+        CpuCompositor::Config config;
+        config.simd = level;
+        CpuCompositor previewCompositor(threadPool, config);
+        previewCompositor.setChromaKeys({hsvKey(1.0f / 3.0f, 0.9f, 0.8f)});
+        int64_t timeNs = 0;
+        for (int i = 0; i <= c_compositeTimingFrames; i++) {
+            const int64_t begin = getTimestampNs();
+            for (const auto& target : previewLayers) {
+                CpuCompositor::LayerImage previewLayer;
+                previewLayer.color = target->getColor();
+                previewLayer.colorStride = previewSize;
+                previewLayer.depth = target->getDepth();
+                previewLayer.depthStride = previewSize;
+                previewCompositor.composite(
+                    previewParams, previewLayer, previewVideo, previewOut.data(), previewVideo.colorStride, previewSize, previewSize);
+            }
+            timeNs += i > 0 ? getTimestampNs() - begin : 0;
+        }
+        const double frameSec = timeNs * 1e-9 / c_compositeTimingFrames;
+        m_result.frameMs[static_cast<int>(level)] = frameSec * 1e3;
+        m_result.pixelsPerSec[static_cast<int>(level)] =
+            frameSec > 0.0 ? static_cast<double>(previewSize) * previewSize * m_result.previewViews / frameSec : 0.0;
+    }
+    const double bestMs = m_result.frameMs[static_cast<int>(getMaxSimdLevel())];
+    check(m_result.budgetMs == 0.0 || bestMs <= m_result.budgetMs, "preview composites at stream rate");
+}
+
+void CompositeValidation::printResults() const
+{
+    const auto& r = m_result;
+    printf("Composite validation: max error %d, SIMD error %d, %lld layer and %lld video pixels in scene views\n", r.maxError, r.simdError,
+        static_cast<long long>(r.layerPixels), static_cast<long long>(r.videoPixels));
+    printf("Composite preview: %d views of %dx%d on %d threads, %.3f ms scalar, %.3f ms SSE4.1, %.3f ms AVX2 per frame, %.3f ms stream interval\n",
+        r.previewViews, r.previewSize.x, r.previewSize.y, r.threads, r.frameMs[0], r.frameMs[1], r.frameMs[2], r.budgetMs);
+    printf("Composite preview: %.2f / %.2f / %.2f Mpixels/s (scalar / SSE4.1 / AVX2)\n", r.pixelsPerSec[0] * 1e-6, r.pixelsPerSec[1] * 1e-6,
+        r.pixelsPerSec[2] * 1e-6);
+}
+
+void CompositeValidation::writeResults(nlohmann::json& section) const
+{
+    section["maxError"] = m_result.maxError;
+    section["simdError"] = m_result.simdError;
+    section["layerPixels"] = m_result.layerPixels;
+    section["videoPixels"] = m_result.videoPixels;
+    section["previewSize"] = {m_result.previewSize.x, m_result.previewSize.y};
+    section["previewViews"] = m_result.previewViews;
+    section["frameMs"] = m_result.frameMs;
+    section["pixelsPerSec"] = m_result.pixelsPerSec;
+    section["budgetMs"] = m_result.budgetMs;
+    section["threads"] = m_result.threads;
+}
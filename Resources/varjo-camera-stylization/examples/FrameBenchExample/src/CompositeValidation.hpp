@@ -0,0 +1,48 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <array>
+
+#include "Validation.hpp"
+
+//! CPU compositor validation on synthetic layers and scene views over stylized camera frames, with preview timing per SIMD level
+class CompositeValidation : public Validation
+{
+public:
+    //! Composite validation results
+    struct Result {
+        int maxError = 0;                      //!< Largest difference to expected blend in 8 bit units
+        int simdError = 0;                     //!< Largest difference between SIMD variants and scalar in 8 bit units
+        int64_t layerPixels = 0;               //!< Opaque layer pixels in composited scene views
+        int64_t videoPixels = 0;               //!< Transparent layer pixels in composited scene views
+        glm::ivec2 previewSize{0};             //!< Preview view size
+        int previewViews = 0;                  //!< Views composited per preview frame
+        std::array<double, 3> frameMs{};       //!< Mean preview frame time per SIMD level, zero if unsupported
+        std::array<double, 3> pixelsPerSec{};  //!< Composited pixels per second per SIMD level
+        double budgetMs = 0.0;                 //!< Stream frame interval
+        int threads = 0;                       //!< Threads including calling thread
+    };
+
+    //! Construct validation compositing on given number of worker threads, zero for default, benchmark scene of given
+    //! object count, and previews for given stream size timed against given stream frame rate, zero for no budget
+    CompositeValidation(int threadCount, int objectCount, int streamSize, int streamFps);
+
+    //! Validate opaque, premultiplied, straight and inverted alpha blend to expected linear colors, depth test hiding
+    //! the layer behind constant and estimated video depth except outside test range, chroma keys showing the layer
+    //! only on keyed video with hue wrapping around, SIMD variants and thread count not changing output, and benchmark
+    //! scene views compositing over stylized camera frames. Preview frames of stereo views at half stream size with
+    //! all layer features enabled are timed per SIMD level against stream frame interval.
+    void validate() override;
+
+protected:
+    void printResults() const override;
+    void writeResults(nlohmann::json& section) const override;
+
+private:
+    const int m_threadCount;  //!< Worker thread count
+    const int m_objectCount;  //!< Benchmark scene object count
+    const int m_streamSize;   //!< Stream frame width and height
+    const int m_streamFps;    //!< Stream frame rate
+    Result m_result;          //!< Validation results
+};
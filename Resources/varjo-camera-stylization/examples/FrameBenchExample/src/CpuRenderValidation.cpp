@@ -0,0 +1,398 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "CpuRenderValidation.hpp"
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include "Globals.hpp"
+#include "ThreadPool.hpp"
+#include "SimdMath.hpp"
+#include "CpuRenderer.hpp"
+#include "CpuLayerView.hpp"
+#include "BenchScene.hpp"
+
+// VarjoExamples namespace contains simple example wrappers for using Varjo API features.
+// These are only meant to be used in SDK example applications. In your own application,
+// use your own production quality integration layer.
+using namespace VarjoExamples;
+
+namespace
+{
+// CPU render validation: grid cells per side of watertight test, largest fraction of atlas pixels differing
+// between SIMD variants or between atlas and separately rendered views, largest texture sample error in
+// 8 bit units, scene time of rendered frame and frames timed per SIMD level after the first frame
+constexpr int c_cpuRenderGridCells = 24;
+constexpr double c_cpuRenderMaxMismatch = 0.001;
+constexpr int c_cpuRenderMaxTextureError = 6;
+constexpr double c_cpuRenderSceneTime = 1.0;
+constexpr int c_cpuRenderTimingFrames = 5;
+
+}  // namespace
+
+//---------------------------------------------------------------------------
+
+CpuRenderValidation::CpuRenderValidation(int threadCount, int objectCount)
+    : Validation("CPU render", "cpuRender")
+    , m_threadCount(threadCount)
+    , m_objectCount(objectCount)
+{
+}
+
+void CpuRenderValidation::validate()
+{
+    ThreadPool threadPool(m_threadCount);
+    m_result.threads = threadPool.getThreadCount() + 1;
+    const auto countMismatch = [](const CpuRenderer::RenderTarget& a, const CpuRenderer::RenderTarget& b) {
+        const size_t count = static_cast<size_t>(a.getSize().x) * a.getSize().y;
+        return static_cast<int64_t>(count - std::inner_product(a.getColor(), a.getColor() + count, b.getColor(), size_t(0), std::plus<size_t>(),
+                                                std::equal_to<uint32_t>()));
+    };
+
+    // Flat shader: clip space position from vertex, color from pixel shader constants
+    const CpuRenderer::Shader::InitParams flatParams = {"Flat",
+        [](const float* vertex, const void*, float*) { return glm::vec4(vertex[0], vertex[1], vertex[2], 1.0f); },
+        [](const CpuRenderer::PixelInput& input) { return *static_cast<const glm::vec4*>(input.constants); }, 0, 0, sizeof(glm::vec4)};
+
+    CpuRenderer renderer(threadPool, CpuRenderer::Config());
+    auto flatShader = renderer.createShader(flatParams);
+    const auto draw = [&](CpuRenderer::RenderTarget& target, const std::vector<float>& vertices, const std::vector<unsigned short>& indices,
+                          const glm::vec4& color, bool depth) {
+        auto mesh = renderer.createMesh(vertices, 3 * sizeof(float), indices, Renderer::PrimitiveTopology::TriangleList);
+        renderer.bindRenderTarget(target);
+        renderer.setViewport(0, 0, target.getSize().x, target.getSize().y);
+        renderer.setDepthEnabled(depth);
+        renderer.bindShader(*flatShader);
+        renderer.renderMesh(*mesh, nullptr, 0, &color, sizeof(color));
+        renderer.unbindRenderTarget();
+    };
+    const auto quad = [](float x0, float y0, float x1, float y1, float z) { return std::vector<float>{x0, y0, z, x1, y0, z, x0, y1, z, x1, y1, z}; };
+    const std::vector<unsigned short> quadIndices = {0, 2, 1, 1, 2, 3};
+
+    // Watertight: jittered grid over whole target, every pixel shaded once
+    {
+        constexpr int c_size = 256;
+        CpuRenderer::RenderTarget target(c_size, c_size, false);
+        renderer.clear(target, glm::vec4(0.0f), true, true, true, 1.0f, 0);
+        std::vector<float> vertices;
+        std::vector<unsigned short> indices;
+        uint32_t seed = 1;
+        const auto jitter = [&seed]() {
+            seed = seed * 1664525u + 1013904223u;
+            return ((seed >> 8) / 16777216.0f - 0.5f) * 0.6f;
+        };
+        constexpr int n = c_cpuRenderGridCells;
+        for (int y = 0; y <= n; y++) {
+            for (int x = 0; x <= n; x++) {
+                const bool inner = x > 0 && x < n && y > 0 && y < n;
+                vertices.push_back(-1.0f + 2.0f * (x + (inner ? jitter() : 0.0f)) / n);
+                vertices.push_back(-1.0f + 2.0f * (y + (inner ? jitter() : 0.0f)) / n);
+                vertices.push_back(0.5f);
+            }
+        }
+        for (int y = 0; y < n; y++) {
+            for (int x = 0; x < n; x++) {
+                const unsigned short i = static_cast<unsigned short>(y * (n + 1) + x);
+                const unsigned short j = static_cast<unsigned short>(i + n + 1);
+                if ((x + y) % 2) {
+                    indices.insert(indices.end(), {i, j, static_cast<unsigned short>(i + 1), static_cast<unsigned short>(i + 1), j,
+                                                      static_cast<unsigned short>(j + 1)});
+                } else {
+                    indices.insert(indices.end(), {i, j, static_cast<unsigned short>(j + 1), i, static_cast<unsigned short>(j + 1),
+                                                      static_cast<unsigned short>(i + 1)});
+                }
+            }
+        }
+        renderer.resetStats();
+        draw(target, vertices, indices, glm::vec4(1.0f), false);
+        m_result.gridPixels = renderer.getStats().shadedPixels;
+        m_result.gridArea = std::count(target.getColor(), target.getColor() + c_size * c_size, 0xffffffffu);
+        check(m_result.gridArea == c_size * c_size && m_result.gridPixels == m_result.gridArea, "grid shades every pixel once");
+
+        // Triangle fan around center off pixel grid, shared edges at every slope
+        vertices = {0.013f, -0.021f, 0.5f};
+        indices.clear();
+        constexpr int c_fanSegments = 97;
+        for (int i = 0; i < c_fanSegments; i++) {
+            const float angle = glm::two_pi<float>() * i / c_fanSegments;
+            vertices.insert(vertices.end(), {0.8f * std::cos(angle), 0.8f * std::sin(angle), 0.5f});
+            indices.insert(indices.end(), {0, static_cast<unsigned short>(1 + i), static_cast<unsigned short>(1 + (i + 1) % c_fanSegments)});
+        }
+        renderer.clear(target, glm::vec4(0.0f), true, true, true, 1.0f, 0);
+        renderer.resetStats();
+        draw(target, vertices, indices, glm::vec4(1.0f), false);
+        const int64_t fanArea = std::count(target.getColor(), target.getColor() + c_size * c_size, 0xffffffffu);
+        check(fanArea > 0 && renderer.getStats().shadedPixels == fanArea, "fan shades every pixel once");
+    }
+
+    // Depth: far, near left half and far again. Fully hidden quad is rejected by blocks.
+    for (bool hierarchical : {true, false}) {
+        constexpr int c_size = 128;
+        CpuRenderer::Config config;
+        config.hierarchicalDepth = hierarchical;
+        CpuRenderer depthRenderer(threadPool, config);
+        auto depthShader = depthRenderer.createShader(flatParams);
+        CpuRenderer::RenderTarget target(c_size, c_size, false);
+        depthRenderer.clear(target, glm::vec4(0.0f), true, true, true, 1.0f, 0);
+        const auto drawQuad = [&](const std::vector<float>& vertices, const glm::vec4& color) {
+            auto mesh = depthRenderer.createMesh(vertices, 3 * sizeof(float), quadIndices, Renderer::PrimitiveTopology::TriangleList);
+            depthRenderer.bindRenderTarget(target);
+            depthRenderer.setViewport(0, 0, c_size, c_size);
+            depthRenderer.bindShader(*depthShader);
+            depthRenderer.renderMesh(*mesh, nullptr, 0, &color, sizeof(color));
+            depthRenderer.unbindRenderTarget();
+        };
+        drawQuad(quad(-1.0f, -1.0f, 1.0f, 1.0f, 0.8f), {1.0f, 0.0f, 0.0f, 1.0f});
+        drawQuad(quad(-1.0f, -1.0f, 0.0f, 1.0f, 0.2f), {0.0f, 1.0f, 0.0f, 1.0f});
+        drawQuad(quad(-1.0f, -1.0f, 1.0f, 1.0f, 0.8f), {0.0f, 0.0f, 1.0f, 1.0f});
+        bool ordered = true;
+        for (int y = 0; y < c_size; y++) {
+            for (int x = 0; x < c_size; x++) {
+                const bool left = x < c_size / 2;
+                const size_t i = static_cast<size_t>(y) * c_size + x;
+                ordered = ordered && target.getColor()[i] == (left ? 0xff00ff00u : 0xffff0000u) &&
+                          std::abs(target.getDepth()[i] - (left ? 0.2f : 0.8f)) < 1e-6f;
+            }
+        }
+        check(ordered, "depth test keeps nearest surface");
+
+        drawQuad(quad(-1.0f, -1.0f, 0.0f, 1.0f, 0.1f), {1.0f, 1.0f, 1.0f, 1.0f});
+        depthRenderer.resetStats();
+        drawQuad(quad(-1.0f, -1.0f, 0.0f, 1.0f, 0.15f), {1.0f, 0.0f, 1.0f, 1.0f});
+        const CpuRenderer::Stats& stats = depthRenderer.getStats();
+        // Both triangles of the quad span all blocks of the left half
+        const int64_t hiddenBlocks = 2 * (c_size / CpuRenderer::c_blockSize) * (c_size / CpuRenderer::c_blockSize / 2);
+        check(stats.shadedPixels == 0 && stats.depthRejectedBlocks == (hierarchical ? hiddenBlocks : 0),
+            "hidden quad rejected by hierarchical depth");
+    }
+
+    // Textures: 2x2 BMP on textured plane shader, quadrant centers show their texel. Cubemap faces by direction.
+    {
+        const uint8_t bgra[4][4] = {{255, 0, 0, 255}, {255, 255, 255, 255}, {0, 0, 255, 255}, {0, 255, 0, 255}};  // Bottom row first
+        std::vector<uint8_t> bmp(14 + 40 + sizeof(bgra), 0);
+        const auto put = [&bmp](size_t offset, uint32_t value, int bytes) {
+            for (int i = 0; i < bytes; i++) {
+                bmp[offset + i] = static_cast<uint8_t>(value >> (8 * i));
+            }
+        };
+        bmp[0] = 'B';
+        bmp[1] = 'M';
+        put(2, static_cast<uint32_t>(bmp.size()), 4);
+        put(10, 14 + 40, 4);
+        put(14, 40, 4);
+        put(18, 2, 4);
+        put(22, 2, 4);
+        put(26, 1, 2);
+        put(28, 32, 2);
+        memcpy(bmp.data() + 14 + 40, bgra, sizeof(bgra));
+        auto texture = renderer.loadTextureFromMemory(bmp.data(), bmp.size());
+        check(texture != nullptr, "BMP texture loaded");
+
+        constexpr int c_size = 256;
+        CpuRenderer::RenderTarget target(c_size, c_size, false);
+        if (texture) {
+            const std::vector<float> vertices = {-1, 1, 0, 0, 0, 1, 1, 0, 1, 0, -1, -1, 0, 0, 1, 1, -1, 0, 1, 1};
+            auto mesh = renderer.createMesh(vertices, 5 * sizeof(float), quadIndices, Renderer::PrimitiveTopology::TriangleList);
+            auto shader = renderer.getShaders().createShader(ExampleShaders::ShaderType::TexturedPlane);
+            ExampleShaders::TexturedPlaneConstants constants{};
+            constants.ps.colorCorrection = glm::vec4(1.0f);
+            renderer.clear(target, glm::vec4(0.0f), true, true, true, 1.0f, 0);
+            renderer.bindRenderTarget(target);
+            renderer.setViewport(0, 0, c_size, c_size);
+            renderer.setDepthEnabled(true);
+            renderer.bindShader(*shader);
+            renderer.bindTextures({texture.get()});
+            renderer.renderMesh(*mesh, constants.vs, constants.ps);
+            renderer.unbindRenderTarget();
+            renderer.bindTextures({});
+        }
+        const uint32_t expected[4] = {0xff0000ffu, 0xff00ff00u, 0xffff0000u, 0xffffffffu};  // Top left, top right, bottom left, bottom right
+        int maxError = 0;
+        for (int q = 0; q < 4; q++) {
+            const size_t row = static_cast<size_t>((q / 2) * c_size / 2 + c_size / 4);
+            const uint32_t pixel = target.getColor()[row * c_size + (q % 2) * c_size / 2 + c_size / 4];
+            for (int c = 0; c < 32; c += 8) {
+                maxError = std::max(maxError, std::abs(static_cast<int>((pixel >> c) & 0xff) - static_cast<int>((expected[q] >> c) & 0xff)));
+            }
+        }
+        check(maxError <= c_cpuRenderMaxTextureError, "textured plane samples texels");
+
+        auto cubemap = renderer.createHdrCubemap(2, varjo_TextureFormat_RGBA16_FLOAT);
+        bool facesOk = cubemap != nullptr;
+        if (cubemap) {
+            std::vector<Simd::Half> faces(6 * 2 * 2 * 4);
+            for (size_t i = 0; i < faces.size(); i++) {
+                const int face = static_cast<int>(i / 16);
+                const float values[4] = {face / 5.0f, 1.0f - face / 5.0f, 0.5f, 1.0f};
+                faces[i] = Simd::floatToHalf(values[i % 4]);
+            }
+            renderer.updateTexture(cubemap.get(), reinterpret_cast<const uint8_t*>(faces.data()), 2 * 4 * sizeof(Simd::Half));
+            const glm::vec3 directions[6] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0}, {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+            for (int face = 0; face < 6; face++) {
+                const glm::vec4 sample = static_cast<CpuRenderer::Texture&>(*cubemap).sampleCube(directions[face]);
+                facesOk = facesOk && std::abs(sample.r - face / 5.0f) < 1e-3f && std::abs(sample.g - (1.0f - face / 5.0f)) < 1e-3f;
+            }
+        }
+        check(facesOk, "cubemap samples faces");
+    }
+
+    // Benchmark scene in layer view atlas. Views are captured, so that other renderers draw the same frame.
+    varjo_Session* session = varjo_SessionInit();
+    if (!session) {
+        check(false, "session init");
+        return;
+    }
+    struct View {
+        varjo_Viewport viewport;
+        glm::mat4 view;
+        glm::mat4 projection;
+    };
+    std::vector<View> views;
+    std::unique_ptr<CpuRenderer::RenderTarget> atlas;
+    {
+        CpuLayerView layerView(session, renderer);
+        BenchScene scene(renderer, m_objectCount);
+        layerView.syncFrame();
+        scene.update(c_cpuRenderSceneTime, 0.0, 0, Scene::UpdateParams());
+        layerView.beginFrame(LayerView::SubmitParams());
+        layerView.clear(LayerView::ClearParams());
+        layerView.renderScene(scene, LayerView::RenderParams());
+
+        // Layer view atlas of renderer with default configuration is the reference
+        m_result.atlasSize = layerView.getSize();
+        atlas = std::make_unique<CpuRenderer::RenderTarget>(m_result.atlasSize.x, m_result.atlasSize.y);
+        renderer.resetStats();
+        layerView.clearTarget(*atlas, LayerView::ClearParams());
+        layerView.renderSceneToTarget(*atlas, scene, LayerView::RenderParams());
+        m_result.depthRejectedBlocks = renderer.getStats().depthRejectedBlocks;
+        m_result.blocks = renderer.getStats().blocks;
+        layerView.endFrame();
+
+        for (int i = 0; i < layerView.getViewCount(); i++) {
+            views.push_back({layerView.getViewport(i), layerView.getViewMatrix(i), layerView.getProjectionMatrix(i)});
+        }
+    }
+    varjo_SessionShutDown(session);
+
+    const auto renderViews = [&](CpuRenderer& cpuRenderer, const Scene& scene, CpuRenderer::RenderTarget& target) {
+        cpuRenderer.clear(target, glm::vec4(0.0f), true, true, true, 1.0f, 0);
+        cpuRenderer.bindRenderTarget(target);
+        for (const View& v : views) {
+            cpuRenderer.setViewport(v.viewport.x, v.viewport.y, v.viewport.width, v.viewport.height);
+            scene.render(cpuRenderer, target, v.view, v.projection);
+        }
+        cpuRenderer.unbindRenderTarget();
+    };
+    const auto renderScene = [&](ThreadPool& pool, const CpuRenderer::Config& config, CpuRenderer::RenderTarget& target) {
+        CpuRenderer cpuRenderer(pool, config);
+        BenchScene scene(cpuRenderer, m_objectCount);
+        scene.update(c_cpuRenderSceneTime, 0.0, 0, Scene::UpdateParams());
+        renderViews(cpuRenderer, scene, target);
+    };
+    const double atlasPixels = static_cast<double>(m_result.atlasSize.x) * m_result.atlasSize.y;
+    CpuRenderer::RenderTarget variant(m_result.atlasSize.x, m_result.atlasSize.y);
+    CpuRenderer::Config flatConfig;
+    flatConfig.hierarchicalDepth = false;
+    renderScene(threadPool, flatConfig, variant);
+    check(countMismatch(*atlas, variant) == 0 && m_result.depthRejectedBlocks > 0, "hierarchical depth does not change output");
+
+    // Paused pool runs all tiles on calling thread
+    ThreadPool serialPool(1);
+    serialPool.setPaused(true);
+    renderScene(serialPool, CpuRenderer::Config(), variant);
+    serialPool.setPaused(false);
+    check(countMismatch(*atlas, variant) == 0, "output independent of thread count");
+
+    // Views rendered alone match their atlas regions, pixels outside views keep clear color
+    {
+        BenchScene scene(renderer, m_objectCount);
+        scene.update(c_cpuRenderSceneTime, 0.0, 0, Scene::UpdateParams());
+        std::vector<bool> inView(static_cast<size_t>(atlasPixels), false);
+        for (const View& v : views) {
+            CpuRenderer::RenderTarget target(v.viewport.width, v.viewport.height);
+            renderer.clear(target, glm::vec4(0.0f), true, true, true, 1.0f, 0);
+            renderer.bindRenderTarget(target);
+            renderer.setViewport(0, 0, v.viewport.width, v.viewport.height);
+            scene.render(renderer, target, v.view, v.projection);
+            renderer.unbindRenderTarget();
+            int64_t mismatch = 0;
+            for (int y = 0; y < v.viewport.height; y++) {
+                for (int x = 0; x < v.viewport.width; x++) {
+                    const size_t a = static_cast<size_t>(v.viewport.y + y) * m_result.atlasSize.x + v.viewport.x + x;
+                    mismatch += atlas->getColor()[a] != target.getColor()[static_cast<size_t>(y) * v.viewport.width + x];
+                    inView[a] = true;
+                }
+            }
+            const double viewPixels = static_cast<double>(v.viewport.width) * v.viewport.height;
+            m_result.viewMismatch = std::max(m_result.viewMismatch, static_cast<double>(mismatch) / viewPixels);
+        }
+        int64_t outside = 0;
+        for (size_t i = 0; i < inView.size(); i++) {
+            outside += !inView[i] && atlas->getColor()[i] != 0;
+        }
+        check(m_result.viewMismatch <= c_cpuRenderMaxMismatch && outside == 0, "atlas matches view layout");
+    }
+
+    // Every SIMD level compared with reference and timed
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2}) {
+        if (!isSimdLevelSupported(level)) {
+            continue;
+        }
+        CpuRenderer::Config config;
+        config.simd = level;
+        CpuRenderer cpuRenderer(threadPool, config);
+        BenchScene scene(cpuRenderer, m_objectCount);
+        scene.update(c_cpuRenderSceneTime, 0.0, 0, Scene::UpdateParams());
+        int64_t timeNs = 0;
+        for (int i = 0; i <= c_cpuRenderTimingFrames; i++) {
+            cpuRenderer.resetStats();
+            const int64_t begin = getTimestampNs();
+            renderViews(cpuRenderer, scene, variant);
+            timeNs += i > 0 ? getTimestampNs() - begin : 0;
+        }
+        const CpuRenderer::Stats& stats = cpuRenderer.getStats();
+        const double frameSec = timeNs * 1e-9 / c_cpuRenderTimingFrames;
+        m_result.frameMs[static_cast<int>(level)] = frameSec * 1e3;
+        m_result.trianglesPerSec[static_cast<int>(level)] = frameSec > 0.0 ? stats.triangles / frameSec : 0.0;
+        m_result.pixelsPerSec[static_cast<int>(level)] = frameSec > 0.0 ? stats.shadedPixels / frameSec : 0.0;
+        m_result.triangles = stats.triangles;
+        m_result.pixels = stats.shadedPixels;
+        m_result.simdMismatch = std::max(m_result.simdMismatch, countMismatch(*atlas, variant) / atlasPixels);
+    }
+    check(m_result.simdMismatch <= c_cpuRenderMaxMismatch, "SIMD variants match");
+    check(m_result.pixels > 0, "scene rendered");
+}
+
+void CpuRenderValidation::printResults() const
+{
+    const auto& r = m_result;
+    printf("CPU render validation: grid %lld/%lld pixels shaded, %.3f %% SIMD mismatch, %.3f %% view mismatch, %lld/%lld blocks depth rejected\n",
+        static_cast<long long>(r.gridPixels), static_cast<long long>(r.gridArea), 100.0 * r.simdMismatch, 100.0 * r.viewMismatch,
+        static_cast<long long>(r.depthRejectedBlocks), static_cast<long long>(r.depthRejectedBlocks + r.blocks));
+    printf("CPU render: %dx%d atlas, %lld triangles, %lld pixels per frame on %d threads\n", r.atlasSize.x, r.atlasSize.y,
+        static_cast<long long>(r.triangles), static_cast<long long>(r.pixels), r.threads);
+    printf("CPU render: %.3f ms scalar, %.3f ms SSE4.1, %.3f ms AVX2 per frame\n", r.frameMs[0], r.frameMs[1], r.frameMs[2]);
+    printf("CPU render: %.2f / %.2f / %.2f Mtriangles/s, %.2f / %.2f / %.2f Mpixels/s (scalar / SSE4.1 / AVX2)\n", r.trianglesPerSec[0] * 1e-6,
+        r.trianglesPerSec[1] * 1e-6, r.trianglesPerSec[2] * 1e-6, r.pixelsPerSec[0] * 1e-6, r.pixelsPerSec[1] * 1e-6, r.pixelsPerSec[2] * 1e-6);
+}
+
+void CpuRenderValidation::writeResults(nlohmann::json& section) const
+{
+    section["atlasSize"] = {m_result.atlasSize.x, m_result.atlasSize.y};
+    section["gridPixels"] = m_result.gridPixels;
+    section["gridArea"] = m_result.gridArea;
+    section["depthRejectedBlocks"] = m_result.depthRejectedBlocks;
+    section["blocks"] = m_result.blocks;
+    section["simdMismatch"] = m_result.simdMismatch;
+    section["viewMismatch"] = m_result.viewMismatch;
+    section["frameMs"] = m_result.frameMs;
+    section["trianglesPerSec"] = m_result.trianglesPerSec;
+    section["pixelsPerSec"] = m_result.pixelsPerSec;
+    section["triangles"] = m_result.triangles;
+    section["pixels"] = m_result.pixels;
+}
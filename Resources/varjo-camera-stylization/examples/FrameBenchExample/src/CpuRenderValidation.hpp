@@ -0,0 +1,48 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <array>
+
+#include "Validation.hpp"
+
+//! CPU renderer validation on synthetic geometry and benchmark scene, with scene render timing per SIMD level
+class CpuRenderValidation : public Validation
+{
+public:
+    //! CPU render validation results
+    struct Result {
+        glm::ivec2 atlasSize{0};                  //!< Atlas size of stand-in views
+        int64_t gridPixels = 0;                   //!< Pixels shaded by watertight grid
+        int64_t gridArea = 0;                     //!< Pixels covered by watertight grid
+        int64_t depthRejectedBlocks = 0;          //!< Blocks rejected by hierarchical depth in scene render
+        int64_t blocks = 0;                       //!< Blocks rasterized in scene render
+        double simdMismatch = 0.0;                //!< Largest fraction of atlas pixels differing from scalar
+        double viewMismatch = 0.0;                //!< Largest fraction of view pixels differing from atlas region
+        std::array<double, 3> frameMs{};          //!< Mean scene render time per SIMD level, zero if unsupported
+        std::array<double, 3> trianglesPerSec{};  //!< Submitted triangles per second per SIMD level
+        std::array<double, 3> pixelsPerSec{};     //!< Shaded pixels per second per SIMD level
+        int64_t triangles = 0;                    //!< Triangles submitted per scene render
+        int64_t pixels = 0;                       //!< Pixels shaded per scene render
+        int threads = 0;                          //!< Threads including calling thread
+    };
+
+    //! Construct validation rendering on given number of worker threads, zero for default, benchmark scene of given object count
+    CpuRenderValidation(int threadCount, int objectCount);
+
+    //! Validate that a jittered grid and a triangle fan shade each covered pixel exactly once, depth test keeps the
+    //! nearest surface and hierarchical depth rejects hidden blocks without changing output, textures and cubemaps
+    //! sample the expected texels, and the benchmark scene renders to the layer view atlas identically with and
+    //! without hierarchical depth, on one thread and on the pool, per SIMD level and per view. Scene renders are
+    //! timed per SIMD level.
+    void validate() override;
+
+protected:
+    void printResults() const override;
+    void writeResults(nlohmann::json& section) const override;
+
+private:
+    const int m_threadCount;  //!< Worker thread count
+    const int m_objectCount;  //!< Benchmark scene object count
+    Result m_result;          //!< Validation results
+};
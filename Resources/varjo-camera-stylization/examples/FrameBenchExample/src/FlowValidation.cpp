@@ -0,0 +1,233 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "FlowValidation.hpp"
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "Globals.hpp"
+#include "ThreadPool.hpp"
+#include "SimdMath.hpp"
+
+// VarjoExamples namespace contains simple example wrappers for using Varjo API features.
+// These are only meant to be used in SDK example applications. In your own application,
+// use your own production quality integration layer.
+using namespace VarjoExamples;
+
+namespace
+{
+// Flow validation: frames per synthetic sequence and their size, limits for median motion error of tracked
+// points and dense flow cells in pixels, and for fraction of points staying in image tracked from one frame to the next
+constexpr int c_flowFrames = 12;
+constexpr int c_flowSize = 512;
+constexpr double c_flowMaxMedianError = 0.1;
+constexpr double c_flowMaxDenseError = 0.5;
+constexpr double c_flowMinSurvival = 0.9;
+
+//! Synthetic flow sequence, texture moving every frame
+struct FlowSequence {
+    const char* name;        //!< Sequence name
+    glm::dvec2 translation;  //!< Translation per frame in pixels
+    double rotationDeg;      //!< Rotation about image center per frame
+};
+
+}  // namespace
+
+//---------------------------------------------------------------------------
+
+FlowValidation::FlowValidation(int threadCount)
+    : Validation("Flow", "flow")
+    , m_threadCount(threadCount)
+{
+}
+
+void FlowValidation::validate()
+{
+    ThreadPool threadPool(m_threadCount);
+    m_result.threads = threadPool.getThreadCount() + 1;
+    const auto median = [](std::vector<double>& values) {
+        if (values.empty()) {
+            return 1e9;
+        }
+        std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+        return values[values.size() / 2];
+    };
+
+    const std::array<FlowSequence, 3> sequences = {{
+        {"translation", glm::dvec2(3.3, -1.7), 0.0},
+        {"large translation", glm::dvec2(-12.4, 9.1), 0.0},
+        {"rotation", glm::dvec2(0.0), 1.0},
+    }};
+    const glm::dvec2 center(0.5 * (c_flowSize - 1));
+
+    // Frame transform from texture to image pixels
+    const auto transform = [&](const FlowSequence& sequence, int frame, const glm::dvec2& p, bool inverse) {
+        const double angle = glm::radians(sequence.rotationDeg * frame) * (inverse ? -1.0 : 1.0);
+        const glm::dmat2 rotation(std::cos(angle), std::sin(angle), -std::sin(angle), std::cos(angle));
+        const glm::dvec2 offset = sequence.translation * static_cast<double>(frame);
+        return inverse ? center + rotation * (p - center - offset) : center + rotation * (p - center) + offset;
+    };
+    // True position in frame of point at given position in previous frame
+    const auto getTruth = [&](const FlowSequence& sequence, int frame, const glm::vec2& previous) {
+        return glm::vec2(transform(sequence, frame, transform(sequence, frame - 1, glm::dvec2(previous), true), false));
+    };
+
+    std::vector<uint8_t> image(static_cast<size_t>(c_flowSize) * c_flowSize);
+    const auto render = [&](const FlowSequence& sequence, int frame) {
+        threadPool.parallelFor(c_flowSize, [&](int y0, int y1) {
+            for (int y = y0; y < y1; y++) {
+                for (int x = 0; x < c_flowSize; x++) {
+                    const glm::dvec2 p = transform(sequence, frame, glm::dvec2(x, y), true);
+                    const double value = 0.5 * getValueNoise(p / 7.0, 3) + 0.3 * getValueNoise(p / 3.0, 5) + 0.2 * getValueNoise(p / 23.0, 11);
+                    image[static_cast<size_t>(y) * c_flowSize + x] = static_cast<uint8_t>(glm::clamp(value * 255.0 + 0.5, 0.0, 255.0));
+                }
+            }
+        });
+    };
+
+    bool withinBudget = true;
+    bool budgetFilled = true;
+    for (size_t s = 0; s < sequences.size(); s++) {
+        const FlowSequence& sequence = sequences[s];
+        FlowTracker::Config config;
+        config.denseStep = 4;
+        FlowTracker tracker(threadPool, config);
+        std::map<int64_t, glm::vec2> previous;
+        std::vector<double> errors;
+        std::vector<double> denseErrors;
+        int64_t expected = 0;
+        int64_t survived = 0;
+        int64_t denseCells = 0;
+        for (int frame = 0; frame < c_flowFrames; frame++) {
+            render(sequence, frame);
+            tracker.update(image.data(), c_flowSize, c_flowSize, c_flowSize, frame);
+            const std::vector<FlowTracker::Track>& tracks = tracker.getTracks();
+            withinBudget &= static_cast<int>(tracks.size()) <= config.maxFeatures;
+            budgetFilled &= static_cast<int>(tracks.size()) == config.maxFeatures;
+
+            for (const FlowTracker::Track& track : tracks) {
+                const auto it = previous.find(track.id);
+                if (track.age > 0 && it != previous.end()) {
+                    errors.push_back(glm::distance(track.position, getTruth(sequence, frame, it->second)));
+                }
+                if (s == 0) {
+                    m_result.maxAge = std::max(m_result.maxAge, track.age);
+                }
+            }
+
+            // Points whose window stays inside the image are expected to survive
+            const float margin = static_cast<float>(config.windowRadius + 2);
+            for (const auto& point : previous) {
+                const glm::vec2 truth = getTruth(sequence, frame, point.second);
+                if (truth.x > margin && truth.y > margin && truth.x < c_flowSize - 1 - margin && truth.y < c_flowSize - 1 - margin) {
+                    expected++;
+                    const auto isPoint = [&](const FlowTracker::Track& track) { return track.id == point.first; };
+                    survived += std::any_of(tracks.begin(), tracks.end(), isPoint) ? 1 : 0;
+                }
+            }
+            previous.clear();
+            for (const FlowTracker::Track& track : tracks) {
+                previous[track.id] = track.position;
+            }
+
+            if (frame == 0) {
+                continue;
+            }
+            const int step = tracker.getFlowStep();
+            for (int y = 0; y < tracker.getFlowHeight(); y++) {
+                for (int x = 0; x < tracker.getFlowWidth(); x++) {
+                    const size_t cell = static_cast<size_t>(y) * tracker.getFlowWidth() + x;
+                    denseCells++;
+                    if (tracker.getFlowValid()[cell]) {
+                        const glm::vec2 cellCenter(step * (x + 0.5f) - 0.5f, step * (y + 0.5f) - 0.5f);
+                        const glm::vec2 truth = getTruth(sequence, frame, cellCenter) - cellCenter;
+                        denseErrors.push_back(glm::distance(tracker.getFlow()[cell], truth));
+                    }
+                }
+            }
+        }
+        if (s == 0) {
+            m_result.tracks = static_cast<int64_t>(tracker.getTracks().size());
+        }
+        m_result.medianError[s] = median(errors);
+        m_result.survival[s] = expected ? static_cast<double>(survived) / expected : 0.0;
+        m_result.denseValid[s] = denseCells ? static_cast<double>(denseErrors.size()) / denseCells : 0.0;
+        m_result.denseError[s] = median(denseErrors);
+    }
+
+    // Track first sequence with every supported SIMD level, timing updates after the first frame
+    std::vector<glm::vec2> reference;
+    bool identical = true;
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2}) {
+        if (!isSimdLevelSupported(level)) {
+            continue;
+        }
+        FlowTracker::Config config;
+        config.simd = level;
+        FlowTracker tracker(threadPool, config);
+        int64_t timeNs = 0;
+        for (int frame = 0; frame < c_flowFrames; frame++) {
+            render(sequences[0], frame);
+            tracker.update(image.data(), c_flowSize, c_flowSize, c_flowSize, frame);
+            timeNs += frame > 0 ? tracker.getStats().lastTimeNs : 0;
+        }
+        m_result.updateMs[static_cast<int>(level)] = timeNs * 1e-6 / (c_flowFrames - 1);
+        std::vector<glm::vec2> positions;
+        for (const FlowTracker::Track& track : tracker.getTracks()) {
+            positions.push_back(track.position);
+        }
+        if (reference.empty()) {
+            reference = positions;
+        } else {
+            identical &= positions == reference;
+        }
+    }
+
+    for (size_t s = 0; s < sequences.size(); s++) {
+        check(m_result.medianError[s] < c_flowMaxMedianError, "sub-pixel point motion");
+        check(m_result.survival[s] > c_flowMinSurvival, "points survive from frame to frame");
+        check(m_result.denseError[s] < c_flowMaxDenseError, "dense flow");
+    }
+    check(withinBudget, "feature budget respected");
+    check(budgetFilled, "feature budget filled on textured image");
+    check(m_result.maxAge == c_flowFrames - 1, "points carried across all frames");
+    check(identical, "SIMD variants give identical tracks");
+}
+
+void FlowValidation::collect(const BenchLogic& logic)
+{
+    if (const FlowTracker* tracker = logic.getFlowTracker()) {
+        m_streamStats = tracker->getStats();
+    }
+}
+
+void FlowValidation::printResults() const
+{
+    const auto& r = m_result;
+    const auto& s = m_streamStats;
+    const auto mean = [&](int64_t timeNs) { return s.frames ? timeNs * 1e-6 / s.frames : 0.0; };
+    printf("Flow validation: median error %.3f / %.3f / %.3f px, survival %.1f / %.1f / %.1f %% (translation / large translation / rotation)\n",
+        r.medianError[0], r.medianError[1], r.medianError[2], r.survival[0] * 100.0, r.survival[1] * 100.0, r.survival[2] * 100.0);
+    printf("Flow dense: median error %.3f / %.3f / %.3f px, %.1f / %.1f / %.1f %% valid\n", r.denseError[0], r.denseError[1], r.denseError[2],
+        r.denseValid[0] * 100.0, r.denseValid[1] * 100.0, r.denseValid[2] * 100.0);
+    printf("Flow update: %.3f ms scalar, %.3f ms SSE4.1, %.3f ms AVX2 per frame for %lld points on %d threads\n", r.updateMs[0], r.updateMs[1],
+        r.updateMs[2], static_cast<long long>(r.tracks), r.threads);
+    printf("Flow stream: %lld frames (%.3f ms mean, %.3f ms max: pyramid %.3f, track %.3f, detect %.3f), %lld tracked in last frame\n",
+        static_cast<long long>(s.frames), mean(s.totalTimeNs), s.maxTimeNs * 1e-6, mean(s.pyramidTimeNs), mean(s.trackTimeNs), mean(s.detectTimeNs),
+        static_cast<long long>(s.tracked));
+}
+
+void FlowValidation::writeResults(nlohmann::json& section) const
+{
+    section["medianError"] = m_result.medianError;
+    section["survival"] = m_result.survival;
+    section["denseError"] = m_result.denseError;
+    section["denseValid"] = m_result.denseValid;
+    section["tracks"] = m_result.tracks;
+    section["updateMs"] = m_result.updateMs;
+    section["streamFrames"] = m_streamStats.frames;
+    section["streamTimeNs"] = m_streamStats.totalTimeNs;
+}
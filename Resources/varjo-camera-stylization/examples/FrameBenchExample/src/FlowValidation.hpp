@@ -0,0 +1,44 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <array>
+
+#include "Validation.hpp"
+#include "FlowTracker.hpp"
+
+//! Flow tracker validation on synthetic moving sequences, and stream tracking statistics of bench run
+class FlowValidation : public Validation
+{
+public:
+    //! Flow validation results
+    struct Result {
+        std::array<double, 3> medianError{};  //!< Median point motion error per sequence
+        std::array<double, 3> survival{};     //!< Fraction of points staying in image that are tracked to next frame per sequence
+        std::array<double, 3> denseError{};   //!< Median dense flow error per sequence
+        std::array<double, 3> denseValid{};   //!< Fraction of valid dense flow cells per sequence
+        int64_t tracks = 0;                   //!< Points tracked in last frame of first sequence
+        int maxAge = 0;                       //!< Oldest track of first sequence in frames
+        std::array<double, 3> updateMs{};     //!< Mean update time per SIMD level without dense flow, zero if unsupported
+        int threads = 0;                      //!< Tracking threads including calling thread
+    };
+
+    //! Construct validation tracking on given number of worker threads, zero for default
+    FlowValidation(int threadCount);
+
+    //! Validate flow tracker on synthetic sequences of value noise texture translated and rotated by known
+    //! amounts, and time tracking per SIMD level. Large translation needs the coarse pyramid levels to be followed at all.
+    void validate() override;
+
+    //! Collect stream tracking statistics
+    void collect(const BenchLogic& logic) override;
+
+protected:
+    void printResults() const override;
+    void writeResults(nlohmann::json& section) const override;
+
+private:
+    const int m_threadCount;                          //!< Worker thread count
+    Result m_result;                                  //!< Validation results
+    VarjoExamples::FlowTracker::Stats m_streamStats;  //!< Stream tracking statistics of bench run
+};
@@ -0,0 +1,243 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "FrameRingValidation.hpp"
+
+#include <cstdio>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <thread>
+
+#include "Globals.hpp"
+
+// VarjoExamples namespace contains simple example wrappers for using Varjo API features.
+// These are only meant to be used in SDK example applications. In your own application,
+// use your own production quality integration layer.
+using namespace VarjoExamples;
+
+namespace
+{
+// Synthetic ring: slot count and size, publish interval, consumer stall timeout and time the stalled consumer holds
+// its frame, time to wait for a consumer process and largest allowed publish time
+constexpr int32_t c_ringSlots = 4;
+constexpr size_t c_ringSlotSize = 64 * 1024;
+constexpr int c_ringPublishIntervalMs = 2;
+constexpr double c_ringStallTimeoutSec = 0.05;
+constexpr int c_ringHoldMs = 300;
+constexpr int c_ringConsumerTimeoutMs = 5000;
+constexpr double c_ringMaxPublishMs = 5.0;
+
+// Consumer example executable, expected next to this one
+const wchar_t* c_consumerExe = L"FrameRingConsumer.exe";
+
+// Start consumer example process with given arguments. Returns null if it could not be started.
+HANDLE startConsumer(const std::string& arguments)
+{
+    wchar_t path[MAX_PATH];
+    const DWORD length = GetModuleFileNameW(nullptr, path, MAX_PATH);
+    std::wstring exe(path, length);
+    exe = exe.substr(0, exe.find_last_of(L"\\/") + 1) + c_consumerExe;
+
+    // Command line must be writable
+    std::wstring commandLine = L"\"" + exe + L"\" " + std::wstring(arguments.begin(), arguments.end());
+    STARTUPINFOW startupInfo{};
+    startupInfo.cb = sizeof(startupInfo);
+    PROCESS_INFORMATION processInfo{};
+    if (!CreateProcessW(exe.c_str(), &commandLine[0], nullptr, nullptr, FALSE, 0, nullptr, nullptr, &startupInfo, &processInfo)) {
+        LOGE("Starting frame ring consumer failed (error %u)", GetLastError());
+        return nullptr;
+    }
+    CloseHandle(processInfo.hThread);
+    return processInfo.hProcess;
+}
+
+// Wait for consumer process to exit, terminating it on timeout, and close it
+void stopConsumer(HANDLE process, int timeoutMs)
+{
+    if (WaitForSingleObject(process, static_cast<DWORD>(timeoutMs)) != WAIT_OBJECT_0) {
+        LOGE("Frame ring consumer did not exit, terminating.");
+        TerminateProcess(process, EXIT_FAILURE);
+        WaitForSingleObject(process, INFINITE);
+    }
+    CloseHandle(process);
+}
+
+// Read and remove consumer report. Returns empty report if consumer did not write one.
+nlohmann::json readReport(const std::string& filename)
+{
+    nlohmann::json report;
+    {
+        std::ifstream file(filename);
+        if (file) {
+            report = nlohmann::json::parse(file, nullptr, false);
+        }
+    }
+    std::remove(filename.c_str());
+    return report.is_object() ? report : nlohmann::json::object();
+}
+
+}  // namespace
+
+//---------------------------------------------------------------------------
+
+FrameRingValidation::FrameRingValidation(const std::string& ringName, int consumerCount, int streamFps)
+    : Validation("Frame ring", "frameRing")
+    , m_ringName(ringName)
+    , m_consumerCount(consumerCount)
+    , m_streamFps(streamFps)
+{
+}
+
+FrameRingValidation::~FrameRingValidation()
+{
+    for (HANDLE consumer : m_consumers) {
+        if (consumer) {
+            TerminateProcess(consumer, EXIT_FAILURE);
+            CloseHandle(consumer);
+        }
+    }
+}
+
+void FrameRingValidation::validate()
+{
+    const std::string name = m_ringName + ".validate";
+    SharedFrameProducer producer(name, c_ringSlots, c_ringSlotSize);
+    check(producer.isValid(), "synthetic ring created");
+    if (!producer.isValid()) {
+        return;
+    }
+    producer.setStallTimeout(c_ringStallTimeoutSec);
+
+    // Every payload word depends on frame sequence, so an overwritten frame changes its checksum
+    std::vector<uint64_t> payload(c_ringSlotSize / sizeof(uint64_t));
+    SharedFrameInfo info;
+    const auto publishUntil = [&](int timeoutMs, const std::function<bool()>& done) {
+        const int64_t endTime = getTimestampNs() + static_cast<int64_t>(timeoutMs) * 1000000;
+        while (!done() && getTimestampNs() < endTime) {
+            for (size_t i = 0; i < payload.size(); i++) {
+                payload[i] = static_cast<uint64_t>(info.frameNumber) * 0x9e3779b97f4a7c15ull + i;
+            }
+            const int64_t start = getTimestampNs();
+            producer.publish(info, payload.data(), c_ringSlotSize);
+            m_result.publishMaxMs = std::max(m_result.publishMaxMs, (getTimestampNs() - start) * 1e-6);
+            info.frameNumber++;
+            m_result.slowConsumers = std::max(m_result.slowConsumers, producer.getStats().slowConsumers);
+            std::this_thread::sleep_for(std::chrono::milliseconds(c_ringPublishIntervalMs));
+        }
+    };
+
+    // Stalled consumer holds its frame well past stall timeout. Producer keeps publishing around it.
+    const std::string heldReport = name + ".held.json";
+    if (HANDLE held = startConsumer("--ring " + name + " --frames 1 --hold-ms " + std::to_string(c_ringHoldMs) + " --json " + heldReport)) {
+        publishUntil(c_ringConsumerTimeoutMs, [&]() { return WaitForSingleObject(held, 0) == WAIT_OBJECT_0; });
+        stopConsumer(held, 0);
+    }
+    const nlohmann::json report = readReport(heldReport);
+    m_result.heldReceived = report.value("received", int64_t(0));
+    m_result.heldOverwritten = report.value("overwritten", int64_t(0));
+    check(m_result.heldReceived == 1, "stalled consumer received frame");
+    check(m_result.slowConsumers > 0, "stalled consumer flagged slow");
+    check(m_result.heldOverwritten == 0, "held frame not overwritten");
+
+    // Killed consumer never releases its frame. Producer sees it attached before it is killed while holding the frame.
+    if (HANDLE killed = startConsumer("--ring " + name + " --frames 1 --hold-ms " + std::to_string(c_ringConsumerTimeoutMs))) {
+        publishUntil(c_ringConsumerTimeoutMs, [&]() { return producer.getStats().activeConsumers > 0; });
+        publishUntil(c_ringHoldMs, []() { return false; });
+        TerminateProcess(killed, EXIT_FAILURE);
+        stopConsumer(killed, c_ringConsumerTimeoutMs);
+    }
+    publishUntil(c_ringHoldMs, [&]() { return producer.getStats().reclaimedSlots > 0; });
+    m_result.reclaimedSlots = producer.getStats().reclaimedSlots;
+    m_result.published = producer.getStats().published;
+    check(m_result.reclaimedSlots > 0, "killed consumer slots reclaimed");
+    check(m_result.publishMaxMs < c_ringMaxPublishMs, "publish does not wait for consumers");
+}
+
+void FrameRingValidation::onFrame(const BenchLogic& logic)
+{
+    if (m_started || !logic.getFrameRing()) {
+        return;
+    }
+
+    m_started = true;
+    for (int i = 0; i < m_consumerCount; i++) {
+        m_consumers.push_back(startConsumer("--ring " + m_ringName + " --json " + getReportFile(i)));
+    }
+}
+
+void FrameRingValidation::collect(const BenchLogic& logic)
+{
+    if (const SharedFrameProducer* frameRing = logic.getFrameRing()) {
+        m_streamStats = frameRing->getStats();
+    }
+
+    // Ring has been closed with streams, so consumers exit after releasing their last frame
+    double latencySum = 0.0;
+    m_result.receivedMin = m_consumerCount > 0 ? std::numeric_limits<int64_t>::max() : 0;
+    for (int i = 0; i < m_consumerCount; i++) {
+        if (i < static_cast<int>(m_consumers.size()) && m_consumers[i]) {
+            stopConsumer(m_consumers[i], c_ringConsumerTimeoutMs);
+            m_consumers[i] = nullptr;
+        }
+        const nlohmann::json report = readReport(getReportFile(i));
+        const int64_t received = report.value("received", int64_t(0));
+        m_result.attached += report.value("attached", false) ? 1 : 0;
+        m_result.received += received;
+        m_result.receivedMin = std::min(m_result.receivedMin, received);
+        m_result.skipped += report.value("skipped", int64_t(0));
+        m_result.overwritten += report.value("overwritten", int64_t(0));
+        latencySum += report.value("latencyMeanMs", 0.0) * received;
+        m_result.latencyP99Ms = std::max(m_result.latencyP99Ms, report.value("latencyP99Ms", 0.0));
+        m_result.latencyMaxMs = std::max(m_result.latencyMaxMs, report.value("latencyMaxMs", 0.0));
+    }
+    m_result.latencyMeanMs = m_result.received > 0 ? latencySum / m_result.received : 0.0;
+    m_result.budgetMs = m_streamFps > 0 ? 1000.0 / m_streamFps : 0.0;
+
+    check(m_streamStats.published > 0, "stream frames published");
+    check(m_result.attached == m_consumerCount, "consumers attached");
+    check(m_result.receivedMin > 0, "stream frames received by every consumer");
+    check(m_result.overwritten == 0, "stream frames not overwritten");
+    check(m_streamStats.droppedNoSlot == 0 && m_streamStats.droppedTooLarge == 0, "stream frames not dropped");
+    check(m_result.latencyMeanMs < m_result.budgetMs, "mean latency below stream frame interval");
+}
+
+std::string FrameRingValidation::getReportFile(int index) const { return m_ringName + ".consumer" + std::to_string(index) + ".json"; }
+
+void FrameRingValidation::printResults() const
+{
+    const auto& r = m_result;
+    const auto& s = m_streamStats;
+    printf("Frame ring validation: %lld frames published, %.3f ms max publish, %d slow consumers, held frame %lld received %lld overwritten, "
+           "%lld slots reclaimed\n",
+        static_cast<long long>(r.published), r.publishMaxMs, r.slowConsumers, static_cast<long long>(r.heldReceived),
+        static_cast<long long>(r.heldOverwritten), static_cast<long long>(r.reclaimedSlots));
+    printf("Frame ring stream: %lld published, %lld dropped, %d/%d consumers, %lld received (min %lld), %lld skipped, %lld overwritten\n",
+        static_cast<long long>(s.published), static_cast<long long>(s.droppedNoSlot + s.droppedTooLarge), r.attached, m_consumerCount,
+        static_cast<long long>(r.received), static_cast<long long>(r.receivedMin), static_cast<long long>(r.skipped),
+        static_cast<long long>(r.overwritten));
+    printf("Frame ring latency: mean %.3f ms, p99 %.3f ms, max %.3f ms, %.3f ms stream interval\n", r.latencyMeanMs, r.latencyP99Ms,
+        r.latencyMaxMs, r.budgetMs);
+}
+
+void FrameRingValidation::writeResults(nlohmann::json& section) const
+{
+    section["published"] = m_result.published;
+    section["publishMaxMs"] = m_result.publishMaxMs;
+    section["slowConsumers"] = m_result.slowConsumers;
+    section["heldReceived"] = m_result.heldReceived;
+    section["heldOverwritten"] = m_result.heldOverwritten;
+    section["reclaimedSlots"] = m_result.reclaimedSlots;
+    section["streamPublished"] = m_streamStats.published;
+    section["streamDropped"] = m_streamStats.droppedNoSlot + m_streamStats.droppedTooLarge;
+    section["attached"] = m_result.attached;
+    section["received"] = m_result.received;
+    section["receivedMin"] = m_result.receivedMin;
+    section["skipped"] = m_result.skipped;
+    section["overwritten"] = m_result.overwritten;
+    section["latencyMeanMs"] = m_result.latencyMeanMs;
+    section["latencyP99Ms"] = m_result.latencyP99Ms;
+    section["latencyMaxMs"] = m_result.latencyMaxMs;
+    section["budgetMs"] = m_result.budgetMs;
+}
@@ -0,0 +1,67 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Validation.hpp"
+#include "SharedFrameRing.hpp"
+
+//! Shared frame ring validation with stalled and killed consumer processes, and cross-process latency of color
+//! stream frames read by consumer processes in bench run
+class FrameRingValidation : public Validation
+{
+public:
+    //! Frame ring validation results
+    struct Result {
+        int64_t published = 0;        //!< Frames published to synthetic ring
+        double publishMaxMs = 0.0;    //!< Longest publish with stalled and killed consumers attached
+        int32_t slowConsumers = 0;    //!< Consumers flagged slow while holding a frame
+        int64_t heldReceived = 0;     //!< Frames received by stalled consumer
+        int64_t heldOverwritten = 0;  //!< Frames changed while held by stalled consumer
+        int64_t reclaimedSlots = 0;   //!< Slot references reclaimed from killed consumer
+        int attached = 0;             //!< Consumer processes attached to stream ring, filled after run
+        int64_t received = 0;         //!< Stream frames received over all consumers
+        int64_t receivedMin = 0;      //!< Stream frames received by least served consumer
+        int64_t skipped = 0;          //!< Stream frames missed over all consumers
+        int64_t overwritten = 0;      //!< Stream frames changed while held over all consumers
+        double latencyMeanMs = 0.0;   //!< Mean publish to acquire latency over all consumers
+        double latencyP99Ms = 0.0;    //!< Largest 99th percentile latency of consumers
+        double latencyMaxMs = 0.0;    //!< Largest latency of consumers
+        double budgetMs = 0.0;        //!< Stream frame interval
+    };
+
+    //! Construct validation for stream ring of given name read by given number of consumer processes, with
+    //! latency checked against given stream frame rate
+    FrameRingValidation(const std::string& ringName, int consumerCount, int streamFps);
+
+    //! Destructor. Terminates consumer processes still running.
+    ~FrameRingValidation();
+
+    //! Validate on synthetic ring that a consumer holding a frame past stall timeout is flagged slow and its frame
+    //! is not overwritten, that slots held by a killed consumer are reclaimed, and that publishing never waits
+    void validate() override;
+
+    //! Start stream ring consumer processes on first measured frame, when ring has been created
+    void onFrame(const BenchLogic& logic) override;
+
+    //! Check that every consumer received stream frames without overwrites and with mean latency below frame interval
+    void collect(const BenchLogic& logic) override;
+
+protected:
+    void printResults() const override;
+    void writeResults(nlohmann::json& section) const override;
+
+private:
+    //! Returns report file of stream ring consumer
+    std::string getReportFile(int index) const;
+
+    const std::string m_ringName;                               //!< Stream ring name
+    const int m_consumerCount;                                  //!< Stream ring consumer processes
+    const int m_streamFps;                                      //!< Stream frame rate
+    std::vector<HANDLE> m_consumers;                            //!< Stream ring consumer processes
+    bool m_started = false;                                     //!< Consumer processes started
+    Result m_result;                                            //!< Validation results
+    VarjoExamples::SharedFrameProducer::Stats m_streamStats{};  //!< Stream ring statistics of bench run
+};
@@ -0,0 +1,136 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "LateLatchValidation.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <thread>
+
+#include "Globals.hpp"
+#include "StandInRuntime.hpp"
+
+// VarjoExamples namespace contains simple example wrappers for using Varjo API features.
+// These are only meant to be used in SDK example applications. In your own application,
+// use your own production quality integration layer.
+using namespace VarjoExamples;
+
+namespace
+{
+// Late latch validation: frames latched, largest fractions of latches missing compositor deadline and of
+// frames superseded before latch, and largest mean latched data age over compositor lead and latch margin
+// in ms, for scheduling noise
+constexpr int c_lateLatchFrames = 180;
+constexpr double c_lateLatchMaxMissed = 0.05;
+constexpr double c_lateLatchMaxSuperseded = 0.05;
+constexpr double c_lateLatchAgeToleranceMs = 1.0;
+
+// Mean age of latched data at display time in ms, as sampled on frame thread or at latch
+double getMeanAgeMs(const LateLatch::Stats& stats, bool latched)
+{
+    return stats.latched > 0 ? (latched ? stats.latchedAgeNs : stats.frameAgeNs) * 1e-6 / stats.latched : 0.0;
+}
+
+// Print latch statistics report lines
+void printLatch(const char* name, const LateLatch::Stats& stats, int64_t lateInputs)
+{
+    printf("Late latch %s: %lld/%lld frames latched, %lld superseded, %lld submitted, %lld unchanged, %lld missed, %lld late inputs, "
+           "wake delay %.3f ms mean %.3f ms max\n",
+        name, static_cast<long long>(stats.latched), static_cast<long long>(stats.frames), static_cast<long long>(stats.superseded),
+        static_cast<long long>(stats.submitted), static_cast<long long>(stats.unchanged), static_cast<long long>(stats.missed),
+        static_cast<long long>(lateInputs), stats.latched ? stats.wakeDelayNs * 1e-6 / stats.latched : 0.0, stats.maxWakeDelayNs * 1e-6);
+    printf("Late latch %s: data age at display %.3f ms sampled on frame thread, %.3f ms latched, %.3f ms younger\n", name, getMeanAgeMs(stats, false),
+        getMeanAgeMs(stats, true), getMeanAgeMs(stats, false) - getMeanAgeMs(stats, true));
+}
+
+// Latch statistics as JSON
+nlohmann::json getLatchJson(const LateLatch::Stats& stats, int64_t lateInputs)
+{
+    return nlohmann::json{{"frames", stats.frames}, {"latched", stats.latched}, {"superseded", stats.superseded}, {"submitted", stats.submitted},
+        {"unchanged", stats.unchanged}, {"missed", stats.missed}, {"lateInputs", lateInputs}, {"frameAgeMs", getMeanAgeMs(stats, false)},
+        {"latchedAgeMs", getMeanAgeMs(stats, true)}, {"maxWakeDelayMs", stats.maxWakeDelayNs * 1e-6}};
+}
+
+}  // namespace
+
+//---------------------------------------------------------------------------
+
+LateLatchValidation::LateLatchValidation()
+    : Validation("Late latch", "lateLatch")
+{
+}
+
+void LateLatchValidation::validate()
+{
+    varjo_Session* session = varjo_SessionInit();
+    if (!session) {
+        check(false, "session init");
+        return;
+    }
+
+    // Latch time is stamped into constants of first half of frames, so they change on every latch.
+    // Second half keeps constants unchanged.
+    const LateLatch::Config config;
+    LateLatch latch(session, config, [&](LateLatch::Frame& frame) {
+        const varjo_Nanoseconds now = varjo_GetCurrentTime(session);
+        if (frame.frameNumber <= c_lateLatchFrames / 2) {
+            memcpy(frame.constants.data(), &now, sizeof(now));
+        }
+        return now;
+    });
+    latch.start();
+
+    varjo_FrameInfo* frameInfo = varjo_CreateFrameInfo(session);
+    for (int i = 0; i < c_lateLatchFrames; i++) {
+        varjo_WaitSync(session, frameInfo);
+        LateLatch::Frame frame;
+        frame.frameNumber = frameInfo->frameNumber;
+        frame.displayTime = frameInfo->displayTime;
+        frame.sampleTime = varjo_GetCurrentTime(session);
+        frame.constantSize = sizeof(varjo_Nanoseconds);
+        latch.submit(frame);
+    }
+
+    // Last frame is latched before its display time
+    std::this_thread::sleep_for(std::chrono::nanoseconds(frameInfo->displayTime - varjo_GetCurrentTime(session)));
+    latch.stop();
+    m_result.stats = latch.getStats();
+    const StandInRuntime::Stats runtimeStats = StandInRuntime::getStats();
+    m_result.lateInputs = runtimeStats.shaderInputsLate;
+    varjo_FreeFrameInfo(frameInfo);
+    varjo_SessionShutDown(session);
+
+    const auto& stats = m_result.stats;
+    const int64_t maxMissed = static_cast<int64_t>(c_lateLatchFrames * c_lateLatchMaxMissed);
+    const int64_t maxSuperseded = static_cast<int64_t>(c_lateLatchFrames * c_lateLatchMaxSuperseded);
+    check(stats.frames == c_lateLatchFrames && stats.latched + stats.superseded == c_lateLatchFrames && stats.superseded <= maxSuperseded,
+        "every frame latched once");
+    check(stats.missed <= maxMissed && m_result.lateInputs <= maxMissed, "latched before compositor deadline");
+    check(getMeanAgeMs(stats, true) < getMeanAgeMs(stats, false), "latched data younger than frame thread data");
+    check(getMeanAgeMs(stats, true) <= config.compositorLeadMs + config.marginMs + c_lateLatchAgeToleranceMs, "latched data age near latch time");
+    check(stats.unchanged >= c_lateLatchFrames / 2 - 1 - stats.superseded && stats.submitted == runtimeStats.shaderInputsSubmitted,
+        "unchanged constants not submitted");
+}
+
+void LateLatchValidation::collect(const BenchLogic& logic)
+{
+    if (const LateLatch* latch = logic.getLateLatch()) {
+        m_runStats = latch->getStats();
+        m_runLateInputs = StandInRuntime::getStats().shaderInputsLate;
+    }
+
+    // Deadlines missed in the run depend on stream load on the machine, so they are only reported
+    check(m_runStats.latched > 0 && getMeanAgeMs(m_runStats, true) < getMeanAgeMs(m_runStats, false), "frame loop latched data younger");
+}
+
+void LateLatchValidation::printResults() const
+{
+    printLatch("validation", m_result.stats, m_result.lateInputs);
+    printLatch("run", m_runStats, m_runLateInputs);
+}
+
+void LateLatchValidation::writeResults(nlohmann::json& section) const
+{
+    section["validation"] = getLatchJson(m_result.stats, m_result.lateInputs);
+    section["run"] = getLatchJson(m_runStats, m_runLateInputs);
+}
@@ -0,0 +1,40 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+
+#include "Validation.hpp"
+#include "LateLatch.hpp"
+
+//! Late latch validation against throttled stand-in frame clock, and latch statistics of bench run
+class LateLatchValidation : public Validation
+{
+public:
+    //! Late latch validation results
+    struct Result {
+        VarjoExamples::LateLatch::Stats stats;  //!< Latch statistics of validation frames
+        int64_t lateInputs = 0;                 //!< Shader inputs stand-in runtime received after compositor deadline
+    };
+
+    //! Construct validation
+    LateLatchValidation();
+
+    //! Validate that every frame is latched once and before its compositor deadline, except a few that may be
+    //! superseded or missed when the latch thread does not get a core in time, latched samples are younger at
+    //! display time than samples taken on frame thread after sync, and constants identical to the last submitted
+    //! ones are not submitted again.
+    void validate() override;
+
+    //! Collect latch statistics of bench run and check that frame loop latched data is younger
+    void collect(const BenchLogic& logic) override;
+
+protected:
+    void printResults() const override;
+    void writeResults(nlohmann::json& section) const override;
+
+private:
+    Result m_result;                             //!< Validation results
+    VarjoExamples::LateLatch::Stats m_runStats;  //!< Latch statistics of bench run
+    int64_t m_runLateInputs = 0;                 //!< Shader inputs received after compositor deadline in bench run
+};
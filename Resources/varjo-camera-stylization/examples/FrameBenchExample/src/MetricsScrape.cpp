@@ -0,0 +1,145 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "MetricsScrape.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <map>
+#include <sstream>
+
+#include "Globals.hpp"
+#include "MetricsServer.hpp"
+
+// VarjoExamples namespace contains simple example wrappers for using Varjo API features.
+// These are only meant to be used in SDK example applications. In your own application,
+// use your own production quality integration layer.
+using namespace VarjoExamples;
+
+namespace
+{
+// Returns true if string ends with given suffix
+bool endsWith(const std::string& str, const std::string& suffix)
+{
+    return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+}  // namespace
+
+bool validateExposition(const std::string& text, const std::vector<std::string>& required, std::string& outError)
+{
+    if (text.empty() || text.back() != '\n') {
+        outError = "Response does not end with newline";
+        return false;
+    }
+
+    std::map<std::string, double> infBuckets;
+    std::string bucketMetric;
+    double bucketPrev = 0.0;
+    std::vector<std::string> names;
+
+    std::istringstream stream(text);
+    std::string line;
+    while (std::getline(stream, line)) {
+        if (line.compare(0, 7, "# HELP ") == 0) {
+            continue;
+        }
+        if (line.compare(0, 7, "# TYPE ") == 0) {
+            const std::string type = line.substr(line.rfind(' ') + 1);
+            if (type != "counter" && type != "gauge" && type != "histogram") {
+                outError = "Unknown metric type: " + line;
+                return false;
+            }
+            continue;
+        }
+
+        // Sample line: name, optional labels, value
+        size_t pos = 0;
+        while (pos < line.size() && (isalnum(static_cast<unsigned char>(line[pos])) || line[pos] == '_' || line[pos] == ':')) {
+            pos++;
+        }
+        const std::string name = line.substr(0, pos);
+        if (name.empty() || isdigit(static_cast<unsigned char>(name[0]))) {
+            outError = "Invalid metric name: " + line;
+            return false;
+        }
+        std::string labels;
+        if (pos < line.size() && line[pos] == '{') {
+            const size_t end = line.find('}', pos);
+            if (end == std::string::npos) {
+                outError = "Unterminated labels: " + line;
+                return false;
+            }
+            labels = line.substr(pos + 1, end - pos - 1);
+            pos = end + 1;
+        }
+        if (pos >= line.size() || line[pos] != ' ') {
+            outError = "Missing value: " + line;
+            return false;
+        }
+        const char* valueBegin = line.c_str() + pos + 1;
+        char* valueEnd = nullptr;
+        const double value = strtod(valueBegin, &valueEnd);
+        if (valueEnd == valueBegin || *valueEnd != '\0') {
+            outError = "Invalid value: " + line;
+            return false;
+        }
+        names.push_back(name);
+
+        // Buckets must be cumulative and +Inf bucket must match count
+        if (endsWith(name, "_bucket")) {
+            const std::string base = name.substr(0, name.size() - 7);
+            if (base != bucketMetric) {
+                bucketMetric = base;
+                bucketPrev = 0.0;
+            }
+            if (value < bucketPrev) {
+                outError = "Histogram buckets not cumulative: " + line;
+                return false;
+            }
+            bucketPrev = value;
+            if (labels == "le=\"+Inf\"") {
+                infBuckets[base] = value;
+            }
+        } else if (endsWith(name, "_count")) {
+            const auto it = infBuckets.find(name.substr(0, name.size() - 6));
+            if (it == infBuckets.end() || it->second != value) {
+                outError = "Histogram count does not match +Inf bucket: " + line;
+                return false;
+            }
+        }
+    }
+
+    for (const auto& name : required) {
+        if (std::find(names.begin(), names.end(), name) == names.end()) {
+            outError = "Missing metric: " + name;
+            return false;
+        }
+    }
+    return true;
+}
+
+void scrapeMetrics(uint16_t port, const std::vector<std::string>& required, ScrapeStats& stats)
+{
+    const int64_t begin = getTimestampNs();
+    int status = 0;
+    std::string body;
+    const bool ok = MetricsServer::fetch("127.0.0.1", port, "/metrics", status, body) && status == 200;
+    const double timeMs = (getTimestampNs() - begin) * 1e-6;
+    if (!ok) {
+        stats.failed++;
+        return;
+    }
+
+    stats.scrapes++;
+    stats.bytes += static_cast<int64_t>(body.size());
+    stats.timeTotalMs += timeMs;
+    stats.timeMaxMs = std::max(stats.timeMaxMs, timeMs);
+
+    std::string error;
+    if (!validateExposition(body, required, error)) {
+        if (stats.invalid++ == 0) {
+            stats.firstError = error;
+        }
+    }
+}
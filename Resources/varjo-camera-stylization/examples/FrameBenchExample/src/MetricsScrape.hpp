@@ -0,0 +1,25 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+//! Metrics endpoint scrape statistics
+struct ScrapeStats {
+    int64_t scrapes = 0;       //!< Successful scrapes
+    int64_t failed = 0;        //!< Failed requests or non-OK responses
+    int64_t invalid = 0;       //!< Responses failing exposition format validation
+    int64_t bytes = 0;         //!< Received body bytes
+    double timeTotalMs = 0.0;  //!< Total request round trip time
+    double timeMaxMs = 0.0;    //!< Maximum request round trip time
+    std::string firstError;    //!< First validation error
+};
+
+//! Validate Prometheus text exposition: comment and sample line syntax, cumulative histogram buckets
+//! and presence of required metric names. Returns false and first error if invalid.
+bool validateExposition(const std::string& text, const std::vector<std::string>& required, std::string& outError);
+
+//! Scrape metrics endpoint on loopback port like a monitoring agent would and validate response
+void scrapeMetrics(uint16_t port, const std::vector<std::string>& required, ScrapeStats& stats);
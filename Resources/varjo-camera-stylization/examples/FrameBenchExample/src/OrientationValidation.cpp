@@ -0,0 +1,224 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "OrientationValidation.hpp"
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <vector>
+
+#include "Globals.hpp"
+#include "ThreadPool.hpp"
+#include "SimdMath.hpp"
+
+// VarjoExamples namespace contains simple example wrappers for using Varjo API features.
+// These are only meant to be used in SDK example applications. In your own application,
+// use your own production quality integration layer.
+using namespace VarjoExamples;
+
+namespace
+{
+// Orientation validation: stripe period of gratings and rings in pixels, limits for mean tangent error in
+// degrees on gratings and rings, smallest mean coherence of gratings and largest mean coherence of noise
+constexpr double c_orientationPeriod = 24.0;
+constexpr double c_orientationMaxGratingError = 0.5;
+constexpr double c_orientationMaxRingError = 1.0;
+constexpr double c_orientationMinCoherence = 0.9;
+constexpr double c_orientationMaxNoiseCoherence = 0.5;
+
+// Orientation updates timed per configuration after the first update
+constexpr int c_orientationTimingFrames = 10;
+
+}  // namespace
+
+//---------------------------------------------------------------------------
+
+OrientationValidation::OrientationValidation(int threadCount, int sourceSize)
+    : Validation("Orientation", "orientation")
+    , m_threadCount(threadCount)
+    , m_sourceSize(sourceSize)
+{
+}
+
+void OrientationValidation::validate()
+{
+    ThreadPool threadPool(m_threadCount);
+    m_result.threads = threadPool.getThreadCount() + 1;
+
+    std::vector<uint8_t> image(static_cast<size_t>(m_sourceSize) * m_sourceSize);
+    const auto render = [&](const std::function<double(double, double)>& func) {
+        threadPool.parallelFor(m_sourceSize, [&](int y0, int y1) {
+            for (int y = y0; y < y1; y++) {
+                for (int x = 0; x < m_sourceSize; x++) {
+                    image[static_cast<size_t>(y) * m_sourceSize + x] = static_cast<uint8_t>(glm::clamp(func(x, y) + 0.5, 0.0, 255.0));
+                }
+            }
+        });
+    };
+
+    // Mean tangent error in degrees and mean coherence over field pixels whose box is inside the field
+    const glm::dvec2 center(0.5 * (m_sourceSize - 1));
+    const auto measure = [&](const OrientationField& field, const std::function<glm::dvec2(const glm::dvec2&)>& truth, double& outError,
+                             double& outCoherence) {
+        const int downscale = field.getDownscale();
+        const int margin = OrientationField::Config().radius * OrientationField::Config().downscale / downscale + 2;
+        double errorSum = 0.0;
+        double coherenceSum = 0.0;
+        int64_t count = 0;
+        for (int y = margin; y < field.getHeight() - margin; y++) {
+            for (int x = margin; x < field.getWidth() - margin; x++) {
+                const glm::dvec2 p((x + 0.5) * downscale - 0.5, (y + 0.5) * downscale - 0.5);
+                const glm::dvec2 tangent = truth(p);
+                if (tangent == glm::dvec2(0.0)) {
+                    continue;
+                }
+                const OrientationField::Sample sample = field.sample(x * downscale, y * downscale);
+                const double cosine = std::abs(glm::dot(glm::dvec2(sample.tangent), tangent));
+                errorSum += glm::degrees(std::acos(std::min(cosine, 1.0)));
+                coherenceSum += sample.coherence;
+                count++;
+            }
+        }
+        outError = count ? errorSum / count : 180.0;
+        outCoherence = count ? coherenceSum / count : 0.0;
+    };
+
+    OrientationField field(threadPool, OrientationField::Config());
+
+    // Gratings, gradient at angle phi and tangent across it
+    double gratingErrorSum = 0.0;
+    m_result.gratingCoherence = 1.0;
+    constexpr int c_gratingAngles = 12;
+    for (int i = 0; i < c_gratingAngles; i++) {
+        const double phi = glm::radians(180.0 * i / c_gratingAngles + 7.0);
+        const glm::dvec2 normal(std::cos(phi), std::sin(phi));
+        render([&](double x, double y) {
+            return 128.0 + 100.0 * std::sin(glm::two_pi<double>() * glm::dot(glm::dvec2(x, y), normal) / c_orientationPeriod);
+        });
+        field.update(image.data(), m_sourceSize, m_sourceSize, m_sourceSize, i);
+        double error = 0.0;
+        double coherence = 0.0;
+        measure(field, [&](const glm::dvec2&) { return glm::dvec2(-normal.y, normal.x); }, error, coherence);
+        gratingErrorSum += error;
+        m_result.gratingCoherence = std::min(m_result.gratingCoherence, coherence);
+    }
+    m_result.gratingError = gratingErrorSum / c_gratingAngles;
+
+    // Concentric rings, tangent along circles. Center is left out where rings are too tight.
+    const auto renderRings = [&]() {
+        render([&](double x, double y) {
+            return 128.0 + 100.0 * std::sin(glm::two_pi<double>() * glm::distance(glm::dvec2(x, y), center) / c_orientationPeriod);
+        });
+    };
+    const auto ringTangent = [&](const glm::dvec2& p) {
+        const glm::dvec2 d = p - center;
+        return glm::length(d) < 2.0 * c_orientationPeriod ? glm::dvec2(0.0) : glm::dvec2(-d.y, d.x) / glm::length(d);
+    };
+    renderRings();
+    double ringCoherence = 0.0;
+    field.update(image.data(), m_sourceSize, m_sourceSize, m_sourceSize, 0);
+    measure(field, ringTangent, m_result.ringError, ringCoherence);
+
+    // Every SIMD level on rings, compared with scalar and timed
+    {
+        std::vector<float> reference[3];
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2}) {
+            if (!isSimdLevelSupported(level)) {
+                continue;
+            }
+            OrientationField::Config config;
+            config.simd = level;
+            OrientationField variant(threadPool, config);
+            int64_t timeNs = 0;
+            for (int i = 0; i <= c_orientationTimingFrames; i++) {
+                variant.update(image.data(), m_sourceSize, m_sourceSize, m_sourceSize, i);
+                timeNs += i > 0 ? variant.getStats().lastTimeNs : 0;
+            }
+            m_result.updateMs[static_cast<int>(level)] = timeNs * 1e-6 / c_orientationTimingFrames;
+
+            const TrackedVector<float, MemoryTag::Stylization>* planes[3] = {&variant.getTangentX(), &variant.getTangentY(), &variant.getCoherence()};
+            for (int p = 0; p < 3; p++) {
+                if (reference[p].empty()) {
+                    reference[p].assign(planes[p]->begin(), planes[p]->end());
+                    continue;
+                }
+                for (size_t i = 0; i < reference[p].size(); i++) {
+                    m_result.simdDifference = std::max(m_result.simdDifference, static_cast<double>(std::abs((*planes[p])[i] - reference[p][i])));
+                }
+            }
+        }
+    }
+
+    // Full resolution with same smoothing footprint
+    {
+        OrientationField::Config config;
+        config.downscale = 1;
+        config.radius = std::min(OrientationField::Config().radius * OrientationField::Config().downscale, OrientationField::c_maxRadius);
+        OrientationField full(threadPool, config);
+        int64_t timeNs = 0;
+        for (int i = 0; i <= c_orientationTimingFrames; i++) {
+            full.update(image.data(), m_sourceSize, m_sourceSize, m_sourceSize, i);
+            timeNs += i > 0 ? full.getStats().lastTimeNs : 0;
+        }
+        m_result.updateFullMs = timeNs * 1e-6 / c_orientationTimingFrames;
+        double coherence = 0.0;
+        measure(full, ringTangent, m_result.ringErrorFull, coherence);
+    }
+
+    // Isotropic noise
+    render([&](double x, double y) {
+        const glm::dvec2 p(x, y);
+        return 255.0 * (0.5 * getValueNoise(p / 7.0, 3) + 0.3 * getValueNoise(p / 3.0, 5) + 0.2 * getValueNoise(p / 23.0, 11));
+    });
+    field.update(image.data(), m_sourceSize, m_sourceSize, m_sourceSize, 0);
+    double noiseError = 0.0;
+    measure(field, [](const glm::dvec2&) { return glm::dvec2(1.0, 0.0); }, noiseError, m_result.noiseCoherence);
+
+    // Flat image
+    render([](double, double) { return 128.0; });
+    field.update(image.data(), m_sourceSize, m_sourceSize, m_sourceSize, 0);
+    const TrackedVector<float, MemoryTag::Stylization>& flatCoherence = field.getCoherence();
+    const bool flat = std::all_of(flatCoherence.begin(), flatCoherence.end(), [](float c) { return c == 0.0f; });
+
+    check(m_result.gratingError < c_orientationMaxGratingError, "grating orientation");
+    check(m_result.gratingCoherence > c_orientationMinCoherence, "grating coherence");
+    check(m_result.ringError < c_orientationMaxRingError, "ring orientation");
+    check(m_result.noiseCoherence < c_orientationMaxNoiseCoherence, "isotropic noise coherence");
+    check(flat, "flat image has no orientation");
+    check(m_result.simdDifference < 1e-4, "SIMD variants match scalar");
+}
+
+void OrientationValidation::collect(const BenchLogic& logic)
+{
+    if (const OrientationField* field = logic.getOrientationField()) {
+        m_streamStats = field->getStats();
+    }
+}
+
+void OrientationValidation::printResults() const
+{
+    const auto& r = m_result;
+    const auto& s = m_streamStats;
+    const auto mean = [&](int64_t timeNs) { return s.frames ? timeNs * 1e-6 / s.frames : 0.0; };
+    printf("Orientation validation: gratings %.3f deg (coherence %.3f), rings %.3f deg (%.3f deg full resolution), noise coherence %.3f\n",
+        r.gratingError, r.gratingCoherence, r.ringError, r.ringErrorFull, r.noiseCoherence);
+    printf("Orientation update: %.3f ms scalar, %.3f ms SSE4.1, %.3f ms AVX2, %.3f ms at full resolution on %d threads\n", r.updateMs[0],
+        r.updateMs[1], r.updateMs[2], r.updateFullMs, r.threads);
+    printf("Orientation stream: %lld frames (%.3f ms mean, %.3f ms max: downscale %.3f, tensor %.3f, decompose %.3f)\n",
+        static_cast<long long>(s.frames), mean(s.totalTimeNs), s.maxTimeNs * 1e-6, mean(s.downscaleTimeNs), mean(s.tensorTimeNs),
+        mean(s.decomposeTimeNs));
+}
+
+void OrientationValidation::writeResults(nlohmann::json& section) const
+{
+    section["gratingError"] = m_result.gratingError;
+    section["gratingCoherence"] = m_result.gratingCoherence;
+    section["ringError"] = m_result.ringError;
+    section["ringErrorFull"] = m_result.ringErrorFull;
+    section["noiseCoherence"] = m_result.noiseCoherence;
+    section["updateMs"] = m_result.updateMs;
+    section["updateFullMs"] = m_result.updateFullMs;
+    section["streamFrames"] = m_streamStats.frames;
+    section["streamTimeNs"] = m_streamStats.totalTimeNs;
+}
@@ -0,0 +1,47 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <array>
+
+#include "Validation.hpp"
+#include "OrientationField.hpp"
+
+//! Orientation field validation on synthetic luma with known orientation, and stream statistics of bench run
+class OrientationValidation : public Validation
+{
+public:
+    //! Orientation validation results
+    struct Result {
+        double gratingError = 0.0;         //!< Mean tangent error of gratings in degrees
+        double gratingCoherence = 0.0;     //!< Smallest mean coherence of a grating
+        double ringError = 0.0;            //!< Mean tangent error of rings in degrees
+        double ringErrorFull = 0.0;        //!< Mean tangent error of rings in degrees at full resolution
+        double noiseCoherence = 0.0;       //!< Mean coherence of isotropic noise
+        double simdDifference = 0.0;       //!< Largest tangent or coherence difference of SIMD variants to scalar
+        std::array<double, 3> updateMs{};  //!< Mean update time per SIMD level, zero if unsupported
+        double updateFullMs = 0.0;         //!< Mean update time at full resolution with same smoothing footprint
+        int threads = 0;                   //!< Threads including calling thread
+    };
+
+    //! Construct validation running on given number of worker threads, zero for default, with source images of given stream size
+    OrientationValidation(int threadCount, int sourceSize);
+
+    //! Validate orientation field on gratings at several angles, concentric rings, isotropic value noise and
+    //! a flat image. Full resolution field with the same smoothing footprint is timed for comparing the cost
+    //! of computing orientation per pixel.
+    void validate() override;
+
+    //! Collect stream statistics
+    void collect(const BenchLogic& logic) override;
+
+protected:
+    void printResults() const override;
+    void writeResults(nlohmann::json& section) const override;
+
+private:
+    const int m_threadCount;                               //!< Worker thread count
+    const int m_sourceSize;                                //!< Source image width and height
+    Result m_result;                                       //!< Validation results
+    VarjoExamples::OrientationField::Stats m_streamStats;  //!< Stream statistics of bench run
+};
@@ -0,0 +1,133 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "ShadingRateValidation.hpp"
+
+#include <cstdio>
+
+#include "BenchReport.hpp"
+
+// VarjoExamples namespace contains simple example wrappers for using Varjo API features.
+// These are only meant to be used in SDK example applications. In your own application,
+// use your own production quality integration layer.
+using namespace VarjoExamples;
+
+namespace
+{
+// Map generation time limit for all views
+constexpr double c_timeLimitMs = 0.2;
+
+}  // namespace
+
+//---------------------------------------------------------------------------
+
+ShadingRateValidation::ShadingRateValidation(int frames)
+    : Validation("Shading rate", "shadingRate")
+{
+    // Times are recorded during measured frames, which must not allocate
+    m_timesMs.reserve(frames);
+}
+
+// Validate shading rate maps generated from synthetic inputs. View has 16x16 tiles. Upper left quadrant
+// has vertical stripes, lower left quadrant a checkerboard, right half is flat and top right corner occluded.
+void ShadingRateValidation::validate()
+{
+    using Rate = ShadingRateMap::Rate;
+    constexpr int c_size = 256;
+
+    std::vector<uint8_t> luma(c_size * c_size);
+    for (int y = 0; y < c_size; y++) {
+        for (int x = 0; x < c_size; x++) {
+            const int stripe = (y < c_size / 2) ? (x / 4) : (x / 4 + y / 4);
+            luma[y * c_size + x] = (x < c_size / 2) ? ((stripe & 1) ? 200 : 40) : 128;
+        }
+    }
+    varjo_Vector2Df corner[3] = {{0.25f, 1.05f}, {1.05f, 1.05f}, {1.05f, 0.25f}};
+    const varjo_Mesh2Df mesh = {corner, 3};
+
+    const ShadingRateMap::Config config;
+    ShadingRateMap map(config, 1);
+    map.setViewSize(0, c_size, c_size);
+    map.setOcclusionMesh(0, &mesh);
+
+    // Gaze only, no camera frame yet: rates follow distance from gaze
+    map.generate({glm::vec2(-0.5f, 0.5f)});
+    check(map.getRate(0, 5, 1) == Rate::Rate1x1, "no edges: mid ring tile is full rate");
+    check(map.getRate(0, 0, 15) == Rate::Rate2x2, "no edges: peripheral tile is 2x2");
+
+    map.updateEdges(luma.data(), c_size, c_size, c_size, 0);
+    map.generate({glm::vec2(-0.5f, 0.5f)});
+
+    int occluded = 0;
+    bool fovealFull = true;
+    bool occludedCoarse = true;
+    bool flatCoarse = true;
+    const float tileNdc = 2.0f * config.tileSize / c_size;
+    for (int ty = 0; ty < map.getTilesY(0); ty++) {
+        for (int tx = 0; tx < map.getTilesX(0); tx++) {
+            const Rate rate = map.getRate(0, tx, ty);
+            const glm::vec2 ndc(-1.0f + (tx + 0.5f) * tileNdc, 1.0f - (ty + 0.5f) * tileNdc);
+            const bool foveal = glm::distance(ndc, glm::vec2(-0.5f, 0.5f)) < config.fovealRadius;
+            if (map.isOccluded(0, tx, ty)) {
+                occluded++;
+                occludedCoarse &= rate == Rate::Rate4x4;
+            } else if (foveal) {
+                fovealFull &= rate == Rate::Rate1x1;
+            } else if (ndc.x > 0.0f) {
+                flatCoarse &= rate == Rate::Rate4x4;
+            }
+        }
+    }
+    check(fovealFull, "foveal tiles are full rate");
+    check(occluded > 0 && map.isOccluded(0, 15, 0) && !map.isOccluded(0, 0, 0), "corner tiles are occluded");
+    check(occludedCoarse, "occluded tiles are 4x4");
+    check(flatCoarse, "flat tiles outside fovea are 4x4");
+    check(map.getRate(0, 5, 1) == Rate::Rate1x1, "detailed mid ring tile is full rate");
+    check(map.getRate(0, 0, 0) == Rate::Rate1x2, "peripheral vertical stripes keep horizontal rate");
+    check(map.getRate(0, 0, 15) == Rate::Rate2x2, "peripheral checkerboard is 2x2");
+    check(map.getStats().shadedFraction < 1.0, "map saves shading");
+
+    // Gaze moves to flat area: full rate follows gaze, stripes under old gaze point become peripheral
+    map.generate({glm::vec2(0.5f, -0.5f)});
+    check(map.getRate(0, 12, 12) == Rate::Rate1x1, "flat tile under gaze is full rate");
+    check(map.getRate(0, 3, 3) == Rate::Rate1x2, "stripes away from gaze keep horizontal rate only");
+}
+
+void ShadingRateValidation::onFrame(const BenchLogic& logic)
+{
+    const ShadingRateMap* map = logic.getShadingRateMap();
+    if (map && m_timesMs.size() < m_timesMs.capacity()) {
+        m_timesMs.push_back(map->getStats().lastTimeNs * 1e-6);
+    }
+}
+
+void ShadingRateValidation::collect(const BenchLogic& logic)
+{
+    const ShadingRateMap* map = logic.getShadingRateMap();
+    if (!map) {
+        return;
+    }
+
+    m_stats = map->getStats();
+    bool cornersOccluded = true;
+    for (int i = 0; i < map->getViewCount(); i++) {
+        cornersOccluded &= map->isOccluded(i, 0, 0) && map->isOccluded(i, map->getTilesX(i) - 1, map->getTilesY(i) - 1);
+    }
+    check(cornersOccluded, "runtime occlusion mesh hides view corners");
+    m_timeMs = FrameProfiler::getDistribution(m_timesMs);
+    check(m_timeMs.p99 < c_timeLimitMs, "map generation time");
+}
+
+void ShadingRateValidation::printResults() const
+{
+    printf("Shading rate: %lld maps from %lld edge grids, %.4f ms mean / %.4f ms p99 / %.4f ms max (limit %.2f ms), %.3f samples/pixel\n",
+        static_cast<long long>(m_stats.maps), static_cast<long long>(m_stats.edgeGrids), m_timeMs.mean, m_timeMs.p99, m_timeMs.max, c_timeLimitMs,
+        m_stats.shadedFraction);
+}
+
+void ShadingRateValidation::writeResults(nlohmann::json& section) const
+{
+    section["maps"] = m_stats.maps;
+    section["edgeGrids"] = m_stats.edgeGrids;
+    section["timeMs"] = toJson(m_timeMs);
+    section["shadedFraction"] = m_stats.shadedFraction;
+}
@@ -0,0 +1,35 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <vector>
+
+#include "Validation.hpp"
+#include "ShadingRateMap.hpp"
+#include "FrameProfiler.hpp"
+
+//! Shading rate map validation on synthetic inputs, and map generation time of bench run
+class ShadingRateValidation : public Validation
+{
+public:
+    //! Construct validation recording generation times of given number of measured frames
+    ShadingRateValidation(int frames);
+
+    //! Validate maps generated from synthetic edges, gaze and occlusion
+    void validate() override;
+
+    //! Record map generation time of frame
+    void onFrame(const BenchLogic& logic) override;
+
+    //! Check runtime occlusion meshes and map generation time
+    void collect(const BenchLogic& logic) override;
+
+protected:
+    void printResults() const override;
+    void writeResults(nlohmann::json& section) const override;
+
+private:
+    VarjoExamples::ShadingRateMap::Stats m_stats;         //!< Map generator statistics of bench run
+    std::vector<double> m_timesMs;                        //!< Map generation time of measured frames
+    VarjoExamples::FrameProfiler::Distribution m_timeMs;  //!< Map generation time distribution
+};
@@ -0,0 +1,242 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "StallTest.hpp"
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "Globals.hpp"
+#include "StandInRuntime.hpp"
+#include "FrameLoop.hpp"
+#include "CommandQueue.hpp"
+#include "SnapshotBuffer.hpp"
+#include "BenchReport.hpp"
+
+// VarjoExamples namespace contains simple example wrappers for using Varjo API features.
+// These are only meant to be used in SDK example applications. In your own application,
+// use your own production quality integration layer.
+using namespace VarjoExamples;
+
+namespace
+{
+// Simulated UI frame rate
+constexpr double c_uiFrameRate = 60.0;
+
+// UI frames between preset changes sent to frame loop
+constexpr int c_uiPresetFrames = 20;
+
+// Frame interval over this many display periods counts as missed frame
+constexpr double c_missedFramePeriods = 1.5;
+
+//! Preset command from simulated UI thread
+struct StallCommand {
+    uint64_t sequence = 0;       //!< Command sequence number
+    int64_t postNs = 0;          //!< Post timestamp
+    CpuStylizer::Params params;  //!< Effect parameters to apply
+};
+
+//! Frame loop status for simulated UI thread
+struct StallStatus {
+    int64_t frames = 0;            //!< Frames run
+    uint64_t commandSequence = 0;  //!< Sequence number of last applied command
+};
+
+// Returns standard deviation of values
+double getDeviation(const std::vector<double>& values)
+{
+    if (values.empty()) {
+        return 0.0;
+    }
+    double sum = 0.0;
+    double squareSum = 0.0;
+    for (double v : values) {
+        sum += v;
+        squareSum += v * v;
+    }
+    const double mean = sum / values.size();
+    return std::sqrt(std::max(squareSum / values.size() - mean * mean, 0.0));
+}
+
+}  // namespace
+
+//---------------------------------------------------------------------------
+
+StallTest::StallTest(const BenchLogic::Options& options, int warmup, int frames, double stallMs, int stallEvery)
+    : m_options(options)
+    , m_warmup(warmup)
+    , m_frames(frames)
+    , m_stallMs(stallMs)
+    , m_stallEvery(stallEvery)
+{
+}
+
+bool StallTest::run() { return runFrames(false, m_coupled) && runFrames(true, m_decoupled); }
+
+bool StallTest::hasPassed() const
+{
+    // Stalls must not show in frame intervals when frame loop runs on its own thread
+    const double periodMs = 1000.0 / StandInRuntime::getConfig().frameRate;
+    return m_decoupled.intervalMs.p99 <= c_missedFramePeriods * periodMs;
+}
+
+void StallTest::print() const
+{
+    printf("UI stall test: %lld frames at %.0f Hz, UI stalls %.1f ms every %d UI frames\n", static_cast<long long>(m_frames),
+        StandInRuntime::getConfig().frameRate, m_stallMs, m_stallEvery);
+    printf("  %-10s %8s %8s %8s %8s %8s %8s %8s %8s %10s\n", "UI thread", "mean", "p50", "p99", "max", "jitter", "missed", "stalls", "commands",
+        "cmd max");
+    printResult("frame", m_coupled);
+    printResult("own", m_decoupled);
+    printf("UI stalls %s frame loop\n", hasPassed() ? "do not delay" : "DELAY");
+}
+
+nlohmann::json StallTest::toJson() const
+{
+    nlohmann::json j;
+    j["frames"] = m_frames;
+    j["uiStallMs"] = m_stallMs;
+    j["uiStallEvery"] = m_stallEvery;
+    j["coupled"] = toJson(m_coupled);
+    j["decoupled"] = toJson(m_decoupled);
+    j["passed"] = hasPassed();
+    return j;
+}
+
+// Run bench frame loop with simulated UI that changes presets and stalls for given time every given UI
+// frames. Decoupled run has frame loop on FrameLoop thread and UI on calling thread, exchanging commands
+// and status like the video post process example does. Coupled run does UI frame on the frame thread
+// before every frame, like when UI frame callback updated app logic.
+bool StallTest::runFrames(bool decoupled, Result& outResult) const
+{
+    BenchLogic logic(m_options);
+    if (!logic.init()) {
+        return false;
+    }
+
+    // NOTICE! Stalls sleep instead of spinning, like a UI thread blocked in window resize or
+    // present. Spinning would compete for cores with frame loop, which is not what is measured here.
+    const auto stall = std::chrono::microseconds(static_cast<int64_t>(m_stallMs * 1000.0));
+    const auto& presets = BenchLogic::getPresets();
+
+    FrameProfiler profiler(BenchLogic::getPhaseNames(), m_frames);
+    std::vector<double> intervals;
+    intervals.reserve(static_cast<size_t>(m_frames));
+    int64_t frame = 0;
+    int64_t prevNs = 0;
+
+    // Runs one bench frame recording interval between frame starts
+    const auto runFrame = [&]() {
+        const int64_t nowNs = getTimestampNs();
+        const bool measured = (frame >= m_warmup);
+        if (measured && prevNs > 0) {
+            intervals.push_back((nowNs - prevNs) * 1e-6);
+        }
+        prevNs = nowNs;
+        if (measured) {
+            profiler.beginFrame();
+        }
+        logic.update(profiler);
+        if (measured) {
+            profiler.endFrame();
+        }
+        frame++;
+    };
+
+    const int64_t totalFrames = static_cast<int64_t>(m_warmup) + m_frames;
+    if (!decoupled) {
+        for (int64_t i = 0; i < totalFrames; i++) {
+            outResult.uiFrames++;
+            if (outResult.uiFrames % c_uiPresetFrames == 0) {
+                logic.setParams(presets[(outResult.uiFrames / c_uiPresetFrames) % presets.size()].params);
+                outResult.commands++;
+            }
+            if (outResult.uiFrames % m_stallEvery == 0) {
+                std::this_thread::sleep_for(stall);
+                outResult.stalls++;
+            }
+            runFrame();
+        }
+    } else {
+        CommandQueue<StallCommand, 64> commands;
+        SnapshotBuffer<StallStatus> status;
+        uint64_t appliedSequence = 0;
+        int64_t commandLatencyMaxNs = 0;
+
+        FrameLoop loop;
+        loop.start([&]() {
+            StallCommand command;
+            while (commands.pop(command)) {
+                logic.setParams(command.params);
+                appliedSequence = command.sequence;
+                commandLatencyMaxNs = std::max(commandLatencyMaxNs, getTimestampNs() - command.postNs);
+            }
+            runFrame();
+
+            StallStatus& next = status.getWriteBuffer();
+            next.frames = frame;
+            next.commandSequence = appliedSequence;
+            status.publish();
+            return frame < totalFrames;
+        });
+
+        // Simulated UI thread paced to its own frame rate, skipping frames it missed while stalled
+        const int64_t uiPeriodNs = static_cast<int64_t>(1e9 / c_uiFrameRate);
+        int64_t nextUiNs = getTimestampNs();
+        uint64_t sentSequence = 0;
+        while (loop.isRunning()) {
+            const StallStatus& current = status.read();
+            outResult.uiFrames++;
+            if (outResult.uiFrames % c_uiPresetFrames == 0 && current.commandSequence == sentSequence) {
+                StallCommand command;
+                command.sequence = sentSequence + 1;
+                command.postNs = getTimestampNs();
+                command.params = presets[(outResult.uiFrames / c_uiPresetFrames) % presets.size()].params;
+                if (commands.push(command)) {
+                    sentSequence = command.sequence;
+                }
+            }
+            if (outResult.uiFrames % m_stallEvery == 0) {
+                std::this_thread::sleep_for(stall);
+                outResult.stalls++;
+            }
+
+            nextUiNs += uiPeriodNs;
+            const int64_t nowNs = getTimestampNs();
+            if (nextUiNs < nowNs) {
+                nextUiNs = nowNs;
+            }
+            std::this_thread::sleep_for(std::chrono::nanoseconds(nextUiNs - nowNs));
+        }
+        loop.stop();
+
+        outResult.commands = static_cast<int64_t>(appliedSequence);
+        outResult.commandLatencyMaxMs = commandLatencyMaxNs * 1e-6;
+    }
+
+    logic.stopStreams();
+
+    const double periodMs = 1000.0 / StandInRuntime::getConfig().frameRate;
+    for (double interval : intervals) {
+        outResult.missedFrames += interval > c_missedFramePeriods * periodMs ? 1 : 0;
+    }
+    outResult.jitterMs = getDeviation(intervals);
+    outResult.intervalMs = FrameProfiler::getDistribution(intervals);
+    return true;
+}
+
+void StallTest::printResult(const char* name, const Result& r)
+{
+    printf("  %-10s %8.3f %8.3f %8.3f %8.3f %8.3f %8lld %8lld %8lld %10.3f\n", name, r.intervalMs.mean, r.intervalMs.p50, r.intervalMs.p99,
+        r.intervalMs.max, r.jitterMs, static_cast<long long>(r.missedFrames), static_cast<long long>(r.stalls), static_cast<long long>(r.commands),
+        r.commandLatencyMaxMs);
+}
+
+nlohmann::json StallTest::toJson(const Result& r)
+{
+    return {{"intervalMs", ::toJson(r.intervalMs)}, {"jitterMs", r.jitterMs}, {"missedFrames", r.missedFrames}, {"uiFrames", r.uiFrames},
+        {"stalls", r.stalls}, {"commands", r.commands}, {"commandLatencyMaxMs", r.commandLatencyMaxMs}};
+}
@@ -0,0 +1,65 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+
+#include <json/json.hpp>
+
+#include "FrameProfiler.hpp"
+#include "BenchLogic.hpp"
+
+//! UI stall test comparing frame jitter with simulated UI stalls on frame thread and on own thread
+class StallTest
+{
+public:
+    //! Frame loop timing of one test run
+    struct Result {
+        VarjoExamples::FrameProfiler::Distribution intervalMs;  //!< Frame interval distribution
+        double jitterMs = 0.0;                                  //!< Standard deviation of frame intervals
+        int64_t missedFrames = 0;                               //!< Intervals over missed frame limit
+        int64_t uiFrames = 0;                                   //!< Simulated UI frames
+        int64_t stalls = 0;                                     //!< Simulated UI stalls
+        int64_t commands = 0;                                   //!< Preset commands applied by frame loop
+        double commandLatencyMaxMs = 0.0;                       //!< Maximum time from command post to apply
+    };
+
+    //! Construct test running given frames with UI stalling given ms every given UI frames
+    StallTest(const BenchLogic::Options& options, int warmup, int frames, double stallMs, int stallEvery);
+
+    // Disable copy, move and assign
+    StallTest(const StallTest& other) = delete;
+    StallTest(const StallTest&& other) = delete;
+    StallTest& operator=(const StallTest& other) = delete;
+    StallTest& operator=(const StallTest&& other) = delete;
+
+    //! Run test with UI on frame thread and on own thread. Returns false if bench logic init failed.
+    bool run();
+
+    //! Returns true if stalls did not delay frame loop running on its own thread
+    bool hasPassed() const;
+
+    //! Print test report
+    void print() const;
+
+    //! Returns test report as JSON
+    nlohmann::json toJson() const;
+
+private:
+    //! Run bench frame loop with simulated UI. Decoupled run has frame loop on its own thread.
+    bool runFrames(bool decoupled, Result& outResult) const;
+
+    //! Print result table row
+    static void printResult(const char* name, const Result& r);
+
+    //! Convert result to JSON
+    static nlohmann::json toJson(const Result& r);
+
+    const BenchLogic::Options m_options;  //!< Bench options
+    const int m_warmup;                   //!< Frames run before measuring
+    const int m_frames;                   //!< Measured frames
+    const double m_stallMs;               //!< UI stall length
+    const int m_stallEvery;               //!< UI frames between stalls
+    Result m_coupled;                     //!< Result with UI on frame thread
+    Result m_decoupled;                   //!< Result with frame loop on its own thread
+};
@@ -0,0 +1,324 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "StereoValidation.hpp"
+
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+
+#include "Globals.hpp"
+#include "ThreadPool.hpp"
+#include "CameraModel.hpp"
+
+// VarjoExamples namespace contains simple example wrappers for using Varjo API features.
+// These are only meant to be used in SDK example applications. In your own application,
+// use your own production quality integration layer.
+using namespace VarjoExamples;
+
+namespace
+{
+// Stereo validation limits: valid fraction of pixels seen by both cameras, fraction of valid disparities off by
+// more than one pixel, mean error of the rest, invalidated fraction of occluded pixels and relative depth error
+constexpr double c_stereoMinDensity = 0.85;
+constexpr double c_stereoMaxBadFraction = 0.05;
+constexpr double c_stereoMaxMeanError = 0.3;
+constexpr double c_stereoMinOccludedInvalid = 0.5;
+constexpr double c_stereoDepthTolerance = 0.02;
+
+// Stereo validation pair width and height. Occlusion band width in pixels scales with image size, so limits
+// hold for this size only. Timing uses stream size.
+constexpr int c_stereoValidationSize = 1152;
+
+// Stereo pairs timed per SIMD level after the first pair
+constexpr int c_stereoTimingPairs = 10;
+
+//! Textured rectangle of stereo validation scene
+struct StereoPlane {
+    glm::dvec3 center;    //!< Center in HMD space
+    glm::dvec3 u;         //!< Unit horizontal axis
+    glm::dvec3 v;         //!< Unit vertical axis
+    glm::dvec2 halfSize;  //!< Half width and height in meters
+    uint32_t seed;        //!< Texture seed
+};
+
+// Intersect ray with scene. Returns distance along unit direction, or negative if nothing is hit.
+double traceStereoScene(const std::vector<StereoPlane>& planes, const glm::dvec3& origin, const glm::dvec3& dir, int* outPlane, glm::dvec2* outLocal)
+{
+    double nearest = -1.0;
+    for (size_t i = 0; i < planes.size(); i++) {
+        const StereoPlane& plane = planes[i];
+        const glm::dvec3 normal = glm::cross(plane.u, plane.v);
+        const double denom = glm::dot(dir, normal);
+        if (std::abs(denom) < 1e-9) {
+            continue;
+        }
+        const double t = glm::dot(plane.center - origin, normal) / denom;
+        if (t <= 1e-6 || (nearest > 0.0 && t >= nearest)) {
+            continue;
+        }
+        const glm::dvec3 offset = origin + dir * t - plane.center;
+        const glm::dvec2 local(glm::dot(offset, plane.u), glm::dot(offset, plane.v));
+        if (std::abs(local.x) > plane.halfSize.x || std::abs(local.y) > plane.halfSize.y) {
+            continue;
+        }
+        nearest = t;
+        if (outPlane) {
+            *outPlane = static_cast<int>(i);
+        }
+        if (outLocal) {
+            *outLocal = local;
+        }
+    }
+    return nearest;
+}
+
+}  // namespace
+
+//---------------------------------------------------------------------------
+
+StereoValidation::StereoValidation(int threadCount, int streamSize)
+    : Validation("Stereo", "stereo")
+    , m_threadCount(threadCount)
+    , m_streamSize(streamSize)
+{
+}
+
+// Validate stereo matcher on synthetic stereo pair of textured planes with known depth. Cameras have
+// lens distortion and are slightly rotated against each other, so rectification is part of the test.
+// Accuracy is validated on a pair of fixed size, matching is timed on a pair of given stream size.
+void StereoValidation::validate()
+{
+    ThreadPool threadPool(m_threadCount);
+    m_result.threads = threadPool.getThreadCount() + 1;
+    m_result.validationSize = c_stereoValidationSize;
+    m_result.timingSize = m_streamSize;
+
+    // Wall at 3 m, near rectangle at 1 m partly hiding it, and rectangle slanted away between them
+    const double slant = glm::radians(40.0);
+    const std::vector<StereoPlane> planes = {
+        {{0.0, 0.0, -3.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {100.0, 100.0}, 1},
+        {{-0.15, 0.05, -1.0}, {1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.2, 0.2}, 2},
+        {{0.45, -0.1, -1.8}, {std::cos(slant), 0.0, std::sin(slant)}, {0.0, 1.0, 0.0}, {0.3, 0.3}, 3},
+    };
+    const int nearPlane = 1;
+
+    varjo_CameraIntrinsics intrinsics{};
+    intrinsics.model = varjo_IntrinsicsModel_Omnidir;
+    intrinsics.principalPointX = 0.5;
+    intrinsics.principalPointY = 0.5;
+    intrinsics.focalLengthX = 0.6;
+    intrinsics.focalLengthY = 0.6;
+    intrinsics.distortionCoefficients[0] = -0.08;
+    intrinsics.distortionCoefficients[1] = 0.01;
+    const glm::mat4 rightRotation = glm::rotate(glm::mat4(1.0f), glm::radians(0.8f), glm::vec3(0.0f, 1.0f, 0.0f)) *
+                                    glm::rotate(glm::mat4(1.0f), glm::radians(0.4f), glm::vec3(0.0f, 0.0f, 1.0f));
+    const std::array<glm::mat4, 2> poses = {
+        glm::translate(glm::mat4(1.0f), glm::vec3(-0.032f, 0.0f, 0.0f)),
+        glm::translate(glm::mat4(1.0f), glm::vec3(0.032f, 0.0005f, 0.0f)) * rightRotation,
+    };
+
+    // Render luma of both cameras. Camera model works in OpenCV camera space.
+    const glm::dmat3 cvToCamera(1.0, 0.0, 0.0, 0.0, -1.0, 0.0, 0.0, 0.0, -1.0);
+    const auto renderPair = [&](int size) {
+        const CameraModel camera(intrinsics, size, size);
+        std::array<std::vector<uint8_t>, 2> images;
+        for (int c = 0; c < 2; c++) {
+            images[c].resize(static_cast<size_t>(size) * size);
+            const glm::dmat3 rotation = glm::dmat3(glm::dmat4(poses[c])) * cvToCamera;
+            const glm::dvec3 origin = glm::dvec3(glm::dmat4(poses[c])[3]);
+            threadPool.parallelFor(size, [&](int y0, int y1) {
+                for (int y = y0; y < y1; y++) {
+                    for (int x = 0; x < size; x++) {
+                        glm::dvec2 point;
+                        int plane = -1;
+                        glm::dvec2 local;
+                        double value = 0.5;
+                        if (camera.unproject(glm::dvec2(x, y), point) &&
+                            traceStereoScene(planes, origin, glm::normalize(rotation * glm::dvec3(point, 1.0)), &plane, &local) > 0.0) {
+                            const uint32_t seed = planes[plane].seed;
+                            value = 0.45 * getValueNoise(local / 0.03, seed) + 0.35 * getValueNoise(local / 0.012, seed + 7) +
+                                    0.2 * getValueNoise(local / 0.2, seed + 13);
+                        }
+                        images[c][static_cast<size_t>(y) * size + x] = static_cast<uint8_t>(16.0 + 219.0 * value);
+                    }
+                }
+            });
+        }
+        return images;
+    };
+    const int sourceSize = c_stereoValidationSize;
+    const CameraModel camera(intrinsics, sourceSize, sourceSize);
+    const std::array<std::vector<uint8_t>, 2> images = renderPair(sourceSize);
+    const std::array<std::vector<uint8_t>, 2> timingImages = m_streamSize == sourceSize ? images : renderPair(m_streamSize);
+
+    // Match with every supported SIMD level, timing rectification and match of repeated pairs
+    std::vector<float> reference;
+    bool identical = true;
+    StereoMatcher::Rectification rect;
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2}) {
+        if (!isSimdLevelSupported(level)) {
+            continue;
+        }
+        StereoMatcher::Config config;
+        config.simd = level;
+        StereoMatcher matcher(threadPool, config);
+
+        // Rectification is built when both cameras are known, so first pair is dropped
+        for (int i = 0; i < 2; i++) {
+            for (int c = 0; c < 2; c++) {
+                matcher.addImage(c == 0 ? varjo_ChannelIndex_Left : varjo_ChannelIndex_Right, images[c].data(), sourceSize, sourceSize, sourceSize,
+                    intrinsics, toVarjoMatrix(poses[c]), i);
+            }
+        }
+        matcher.match();
+        if (reference.empty()) {
+            reference.assign(matcher.getDisparity().begin(), matcher.getDisparity().end());
+            rect = matcher.getRectification();
+        } else {
+            identical &= std::equal(reference.begin(), reference.end(), matcher.getDisparity().begin());
+        }
+
+        StereoMatcher timingMatcher(threadPool, config);
+        int64_t firstNs = 0;
+        for (int i = 0; i <= c_stereoTimingPairs; i++) {
+            for (int c = 0; c < 2; c++) {
+                const varjo_ChannelIndex channel = c == 0 ? varjo_ChannelIndex_Left : varjo_ChannelIndex_Right;
+                timingMatcher.addImage(
+                    channel, timingImages[c].data(), m_streamSize, m_streamSize, m_streamSize, intrinsics, toVarjoMatrix(poses[c]), i);
+            }
+            timingMatcher.match();
+
+            // First pair builds remap tables and buffers, it is not timed
+            if (i == 0) {
+                firstNs = timingMatcher.getStats().totalTimeNs;
+            }
+        }
+        const StereoMatcher::Stats& stats = timingMatcher.getStats();
+        m_result.matchMs[static_cast<int>(level)] = stats.pairs > 1 ? (stats.totalTimeNs - firstNs) * 1e-6 / (stats.pairs - 1) : 0.0;
+    }
+    check(rect.valid, "rectification built");
+    if (!rect.valid) {
+        return;
+    }
+    check(identical, "SIMD variants give identical disparities");
+
+    // Compare with true disparity of rectified left pixels seen by both cameras
+    const double margin = 4.0 * StereoMatcher::Config().downscale;
+    int64_t valid = 0;
+    int64_t bad = 0;
+    int64_t occluded = 0;
+    int64_t occludedInvalid = 0;
+    double errorSum = 0.0;
+    std::vector<double> nearDepths;
+    std::vector<double> nearDepthsTrue;
+    for (int y = 2; y < rect.height - 2; y++) {
+        for (int x = 2; x < rect.width - 2; x++) {
+            const glm::dvec3 ray((x - rect.center.x) / rect.focal, (y - rect.center.y) / rect.focal, 1.0);
+            const glm::dvec3 dir = glm::normalize(rect.rotation * ray);
+            int plane = -1;
+            const double t = traceStereoScene(planes, rect.origins[0], dir, &plane, nullptr);
+            if (t <= 0.0) {
+                continue;
+            }
+            const glm::dvec3 hit = rect.origins[0] + dir * t;
+
+            // Point must project inside both source images
+            bool inside = true;
+            for (int c = 0; c < 2; c++) {
+                const glm::dmat3 rotation = glm::dmat3(glm::dmat4(poses[c])) * cvToCamera;
+                glm::dvec2 pixel;
+                inside &= camera.project(glm::transpose(rotation) * (hit - rect.origins[c]), pixel) && pixel.x > margin && pixel.y > margin &&
+                          pixel.x < sourceSize - margin && pixel.y < sourceSize - margin;
+            }
+            const double depth = glm::dot(hit - rect.origins[0], rect.rotation[2]);
+            const double truth = rect.focal * rect.baseline / depth;
+            if (!inside || truth >= x) {
+                continue;
+            }
+
+            const float disparity = reference[static_cast<size_t>(y) * rect.width + x];
+            const double toRight = glm::length(hit - rect.origins[1]);
+            if (traceStereoScene(planes, rect.origins[1], (hit - rect.origins[1]) / toRight, nullptr, nullptr) < toRight - 1e-3) {
+                occluded++;
+                occludedInvalid += disparity < 0.0f ? 1 : 0;
+                continue;
+            }
+
+            m_result.pixels++;
+            if (disparity < 0.0f) {
+                continue;
+            }
+            valid++;
+            const double error = std::abs(disparity - truth);
+            if (error > 1.0) {
+                bad++;
+            } else {
+                errorSum += error;
+            }
+            if (plane == nearPlane) {
+                nearDepths.push_back(rect.focal * rect.baseline / disparity);
+                nearDepthsTrue.push_back(depth);
+            }
+        }
+    }
+    const auto median = [](std::vector<double>& values) {
+        if (values.empty()) {
+            return 0.0;
+        }
+        std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+        return values[values.size() / 2];
+    };
+    m_result.density = m_result.pixels ? static_cast<double>(valid) / m_result.pixels : 0.0;
+    m_result.badFraction = valid ? static_cast<double>(bad) / valid : 1.0;
+    m_result.meanError = valid > bad ? errorSum / (valid - bad) : 0.0;
+    m_result.occludedInvalid = occluded ? static_cast<double>(occludedInvalid) / occluded : 0.0;
+    m_result.nearDepth = median(nearDepths);
+    m_result.nearDepthTrue = median(nearDepthsTrue);
+
+    check(m_result.density > c_stereoMinDensity, "dense disparity where both cameras see the scene");
+    check(m_result.badFraction < c_stereoMaxBadFraction, "disparities within one pixel of truth");
+    check(m_result.meanError < c_stereoMaxMeanError, "sub-pixel disparity error");
+    check(occluded > 0 && m_result.occludedInvalid > c_stereoMinOccludedInvalid, "left right check invalidates occlusions");
+    check(std::abs(m_result.nearDepth - m_result.nearDepthTrue) < c_stereoDepthTolerance * m_result.nearDepthTrue, "near plane depth");
+}
+
+void StereoValidation::collect(const BenchLogic& logic)
+{
+    if (const StereoMatcher* matcher = logic.getStereoMatcher()) {
+        m_streamStats = matcher->getStats();
+    }
+}
+
+void StereoValidation::printResults() const
+{
+    const auto& r = m_result;
+    const auto& s = m_streamStats;
+    const auto mean = [&](int64_t timeNs) { return s.pairs ? timeNs * 1e-6 / s.pairs : 0.0; };
+    printf("Stereo validation: %dx%d pair, %lld pixels, %.1f %% dense, %.2f %% bad, %.3f px mean error, %.1f %% occlusions invalidated, "
+           "near depth %.3f m (true %.3f m)\n",
+        r.validationSize, r.validationSize, static_cast<long long>(r.pixels), r.density * 100.0, r.badFraction * 100.0, r.meanError,
+        r.occludedInvalid * 100.0, r.nearDepth, r.nearDepthTrue);
+    printf("Stereo match: %.3f ms scalar, %.3f ms SSE4.1, %.3f ms AVX2 per %dx%d pair on %d threads\n", r.matchMs[0], r.matchMs[1], r.matchMs[2],
+        r.timingSize, r.timingSize, r.threads);
+    printf("Stereo stream: %lld pairs (%.3f ms mean, %.3f ms max: rectify %.3f, cost %.3f, aggregate %.3f, select %.3f), %lld images skipped, "
+           "%.1f %% valid\n",
+        static_cast<long long>(s.pairs), mean(s.totalTimeNs), s.maxTimeNs * 1e-6, mean(s.rectifyTimeNs), mean(s.costTimeNs), mean(s.aggregateTimeNs),
+        mean(s.selectTimeNs), static_cast<long long>(s.skipped), s.validFraction * 100.0);
+}
+
+void StereoValidation::writeResults(nlohmann::json& section) const
+{
+    section["validationSize"] = m_result.validationSize;
+    section["pixels"] = m_result.pixels;
+    section["density"] = m_result.density;
+    section["badFraction"] = m_result.badFraction;
+    section["meanError"] = m_result.meanError;
+    section["occludedInvalid"] = m_result.occludedInvalid;
+    section["nearDepth"] = m_result.nearDepth;
+    section["matchMs"] = m_result.matchMs;
+    section["timingSize"] = m_result.timingSize;
+    section["streamPairs"] = m_streamStats.pairs;
+    section["streamTimeNs"] = m_streamStats.totalTimeNs;
+    section["streamSkipped"] = m_streamStats.skipped;
+}
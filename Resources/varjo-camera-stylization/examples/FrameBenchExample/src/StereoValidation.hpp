@@ -0,0 +1,47 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <array>
+
+#include "Validation.hpp"
+#include "StereoMatcher.hpp"
+
+//! Stereo matcher validation on synthetic stereo pair with known depth, and stream matching statistics of bench run
+class StereoValidation : public Validation
+{
+public:
+    //! Stereo validation results
+    struct Result {
+        int64_t pixels = 0;               //!< Rectified pixels seen by both cameras
+        double density = 0.0;             //!< Fraction of pixels seen by both cameras with valid disparity
+        double badFraction = 0.0;         //!< Fraction of valid disparities off by more than one pixel
+        double meanError = 0.0;           //!< Mean absolute error of valid disparities within one pixel
+        double occludedInvalid = 0.0;     //!< Fraction of pixels occluded from right camera with invalid disparity
+        double nearDepth = 0.0;           //!< Median estimated depth of near plane
+        double nearDepthTrue = 0.0;       //!< Median true depth of near plane
+        std::array<double, 3> matchMs{};  //!< Mean match time per SIMD level including rectification, zero if unsupported
+        int threads = 0;                  //!< Matching threads including calling thread
+        int validationSize = 0;           //!< Validation pair width and height
+        int timingSize = 0;               //!< Timed pair width and height
+    };
+
+    //! Construct validation matching on given number of worker threads, zero for default, and timing pairs of given stream size
+    StereoValidation(int threadCount, int streamSize);
+
+    //! Validate disparity and depth of synthetic pair and time matching per SIMD level
+    void validate() override;
+
+    //! Collect stream matching statistics
+    void collect(const BenchLogic& logic) override;
+
+protected:
+    void printResults() const override;
+    void writeResults(nlohmann::json& section) const override;
+
+private:
+    const int m_threadCount;                            //!< Worker thread count
+    const int m_streamSize;                             //!< Stream frame width and height
+    Result m_result;                                    //!< Validation results
+    VarjoExamples::StereoMatcher::Stats m_streamStats;  //!< Stream matching statistics of bench run
+};
@@ -0,0 +1,226 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "SuspendTest.hpp"
+
+#include <cstdio>
+
+#include <Varjo_events.h>
+
+#include "Globals.hpp"
+#include "StandInRuntime.hpp"
+#include "FrameProfiler.hpp"
+#include "MemoryAccounting.hpp"
+
+// VarjoExamples namespace contains simple example wrappers for using Varjo API features.
+// These are only meant to be used in SDK example applications. In your own application,
+// use your own production quality integration layer.
+using namespace VarjoExamples;
+
+namespace
+{
+// Suspended application may use at most this fraction of the CPU time it uses when active
+constexpr double c_suspendCpuRatio = 0.25;
+
+// Stream frames a suspend may still deliver, one callback per channel already running at stop
+constexpr int64_t c_suspendStreamFrames = 2;
+
+// Returns power event of given type with given flag: standby on, visible or in foreground
+varjo_Event makePowerEvent(varjo_EventType type, bool value)
+{
+    varjo_Event evt{};
+    evt.header.type = type;
+    if (type == varjo_EventType_HeadsetStandbyStatus) {
+        evt.data.headsetStandbyStatus.onStandby = value ? varjo_True : varjo_False;
+    } else if (type == varjo_EventType_Visibility) {
+        evt.data.visibility.visible = value ? varjo_True : varjo_False;
+    } else if (type == varjo_EventType_Foreground) {
+        evt.data.foreground.isForeground = value ? varjo_True : varjo_False;
+    }
+    return evt;
+}
+
+}  // namespace
+
+//---------------------------------------------------------------------------
+
+SuspendTest::SuspendTest(const BenchLogic::Options& options, double phaseSec)
+    : m_options(options)
+    , m_phaseSec(phaseSec)
+{
+}
+
+bool SuspendTest::run()
+{
+    // Stream stop phase ends before retry, and retry lands in the middle of the next phase
+    BenchLogic::Options options = m_options;
+    options.streamRetrySec = 1.5 * m_phaseSec;
+
+    BenchLogic logic(options);
+    if (!logic.init()) {
+        return false;
+    }
+
+    // Phases start with an event or a runtime stream stop
+    enum class Action { None, Event, InterruptStreams };
+    struct PhaseSpec {
+        const char* name;
+        Action action;
+        varjo_EventType eventType;
+        bool eventValue;
+        State expected;
+    };
+    const PhaseSpec specs[] = {
+        {"active", Action::None, 0, false, State::Active},
+        {"standby", Action::Event, varjo_EventType_HeadsetStandbyStatus, true, State::Suspended},
+        {"wake", Action::Event, varjo_EventType_HeadsetStandbyStatus, false, State::Active},
+        {"hidden", Action::Event, varjo_EventType_Visibility, false, State::Suspended},
+        {"visible", Action::Event, varjo_EventType_Visibility, true, State::Active},
+        {"background", Action::Event, varjo_EventType_Foreground, false, State::Suspended},
+        {"foreground", Action::Event, varjo_EventType_Foreground, true, State::Active},
+        {"stream stop", Action::InterruptStreams, 0, false, State::StreamPaused},
+        {"retry", Action::None, 0, false, State::Active},
+    };
+
+    FrameProfiler profiler(BenchLogic::getPhaseNames(), 1);
+    const int64_t phaseNs = static_cast<int64_t>(m_phaseSec * 1e9);
+    int64_t allocationsBefore = 0;
+    double suspendedCpuNs = 0.0;
+    double suspendedWallNs = 0.0;
+    double activeCpuNs = 0.0;
+    double activeWallNs = 0.0;
+
+    for (const auto& spec : specs) {
+        if (spec.action == Action::Event) {
+            StandInRuntime::pushEvent(makePowerEvent(spec.eventType, spec.eventValue));
+        } else if (spec.action == Action::InterruptStreams) {
+            StandInRuntime::interruptDataStreams();
+        }
+
+        Phase phase;
+        phase.name = spec.name;
+        phase.expected = spec.expected;
+        const StandInRuntime::Stats runtimeBegin = StandInRuntime::getStats();
+        const int64_t streamBegin = logic.getStreamStats().frames;
+        const int64_t suspendedBegin = logic.getSuspendedFrames();
+        const int64_t cpuBegin = getProcessCpuTimeNs();
+        const int64_t beginNs = getTimestampNs();
+
+        int64_t nowNs = beginNs;
+        while (nowNs - beginNs < phaseNs) {
+            logic.update(profiler);
+            phase.frames++;
+            nowNs = getTimestampNs();
+            if (phase.firstStreamMs < 0.0 && logic.getStreamStats().frames > streamBegin) {
+                phase.firstStreamMs = (nowNs - beginNs) * 1e-6;
+            }
+        }
+
+        const StandInRuntime::Stats runtimeEnd = StandInRuntime::getStats();
+        const int64_t cpuNs = getProcessCpuTimeNs() - cpuBegin;
+        phase.wallSec = (nowNs - beginNs) * 1e-9;
+        phase.cpuUsage = cpuNs / static_cast<double>(nowNs - beginNs);
+        phase.suspendedFrames = logic.getSuspendedFrames() - suspendedBegin;
+        phase.streamFrames = logic.getStreamStats().frames - streamBegin;
+        phase.shaderInputs = runtimeEnd.shaderInputsSubmitted - runtimeBegin.shaderInputsSubmitted;
+        phase.layers = runtimeEnd.layersSubmitted - runtimeBegin.layersSubmitted;
+        phase.endState = logic.getPowerState().getState();
+
+        // Suspended phases do no frame work and stylize at most frames in flight at stop. Stream
+        // stop only pauses stylizing. Active phases do everything.
+        switch (spec.expected) {
+            case State::Suspended: {
+                phase.passed = phase.suspendedFrames == phase.frames && phase.layers == 0 && phase.shaderInputs == 0 &&
+                               phase.streamFrames <= c_suspendStreamFrames;
+                suspendedCpuNs += cpuNs;
+                suspendedWallNs += nowNs - beginNs;
+            } break;
+            case State::StreamPaused: {
+                phase.passed = phase.suspendedFrames == 0 && phase.layers > 0 && phase.shaderInputs > 0 &&
+                               phase.streamFrames <= c_suspendStreamFrames && phase.endState == State::StreamPaused;
+            } break;
+            default: {
+                phase.passed = phase.suspendedFrames == 0 && phase.layers > 0 && phase.shaderInputs > 0 && phase.streamFrames > 0 &&
+                               phase.endState == State::Active;
+                activeCpuNs += cpuNs;
+                activeWallNs += nowNs - beginNs;
+            } break;
+        }
+
+        // Stylizer buffers must survive suspend, so that first resumed frames do not allocate
+        const int64_t allocations = MemoryAccounting::getStats(MemoryTag::Stylization).allocations;
+        if (m_result.phases.empty()) {
+            allocationsBefore = allocations;
+        } else if (m_result.phases.size() == 2) {
+            m_result.resumeAllocations = allocations - allocationsBefore;
+        }
+        m_result.phases.push_back(phase);
+    }
+
+    logic.stopStreams();
+    m_result.power = logic.getPowerState().getStats(getTimestampNs());
+    m_result.suspendedCpuUsage = suspendedWallNs > 0.0 ? suspendedCpuNs / suspendedWallNs : 0.0;
+    m_result.activeCpuUsage = activeWallNs > 0.0 ? activeCpuNs / activeWallNs : 0.0;
+    return true;
+}
+
+bool SuspendTest::hasPassed() const
+{
+    bool phasesPassed = true;
+    for (const auto& p : m_result.phases) {
+        phasesPassed &= p.passed;
+    }
+    return phasesPassed && getCpuRatio() <= c_suspendCpuRatio && m_result.resumeAllocations == 0 && m_result.power.streamRetries > 0;
+}
+
+void SuspendTest::print() const
+{
+    printf("Suspend test: %.1f s phases\n", m_phaseSec);
+    printf("  %-12s %-14s %6s %6s %6s %9s %8s %8s %8s %9s\n", "phase", "state", "wall", "cores", "frames", "suspended", "stream", "inputs",
+        "layers", "1st strm");
+    for (const auto& p : m_result.phases) {
+        printf("  %-12s %-14s %6.2f %6.3f %6lld %9lld %8lld %8lld %8lld %9.1f%s\n", p.name.c_str(), PowerStateMachine::getStateName(p.endState),
+            p.wallSec, p.cpuUsage, static_cast<long long>(p.frames), static_cast<long long>(p.suspendedFrames),
+            static_cast<long long>(p.streamFrames), static_cast<long long>(p.shaderInputs), static_cast<long long>(p.layers), p.firstStreamMs,
+            p.passed ? "" : "  FAILED");
+    }
+
+    printf("Idle CPU: %.3f cores suspended, %.3f cores active, %.1f %% of active (limit %.0f %%)\n", m_result.suspendedCpuUsage,
+        m_result.activeCpuUsage, getCpuRatio() * 100.0, c_suspendCpuRatio * 100.0);
+    printf("Power state: %lld transitions, %lld stream retries, stylizer allocations over suspend and resume: %lld\n",
+        static_cast<long long>(m_result.power.transitions), static_cast<long long>(m_result.power.streamRetries),
+        static_cast<long long>(m_result.resumeAllocations));
+    printf("Suspend test %s\n", hasPassed() ? "passed" : "FAILED");
+}
+
+nlohmann::json SuspendTest::toJson() const
+{
+    nlohmann::json j;
+    j["phaseSec"] = m_phaseSec;
+    for (const auto& p : m_result.phases) {
+        j["phases"].push_back(toJson(p));
+    }
+    for (int i = 0; i < PowerStateMachine::c_stateCount; i++) {
+        const auto& state = m_result.power.states[i];
+        j["states"][PowerStateMachine::getStateName(static_cast<PowerStateMachine::State>(i))] = {
+            {"entries", state.entries}, {"wallSec", state.wallTimeNs * 1e-9}, {"cpuSec", state.cpuTimeNs * 1e-9}, {"cpuUsage", state.cpuUsage}};
+    }
+    j["suspendedCpuUsage"] = m_result.suspendedCpuUsage;
+    j["activeCpuUsage"] = m_result.activeCpuUsage;
+    j["resumeAllocations"] = m_result.resumeAllocations;
+    j["streamRetries"] = m_result.power.streamRetries;
+    j["passed"] = hasPassed();
+    return j;
+}
+
+double SuspendTest::getCpuRatio() const
+{
+    return m_result.activeCpuUsage > 0.0 ? m_result.suspendedCpuUsage / m_result.activeCpuUsage : 0.0;
+}
+
+nlohmann::json SuspendTest::toJson(const Phase& p)
+{
+    return {{"name", p.name}, {"expected", PowerStateMachine::getStateName(p.expected)}, {"endState", PowerStateMachine::getStateName(p.endState)},
+        {"wallSec", p.wallSec}, {"cpuUsage", p.cpuUsage}, {"frames", p.frames}, {"suspendedFrames", p.suspendedFrames},
+        {"streamFrames", p.streamFrames}, {"shaderInputs", p.shaderInputs}, {"layers", p.layers}, {"firstStreamMs", p.firstStreamMs},
+        {"passed", p.passed}};
+}
@@ -0,0 +1,78 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <json/json.hpp>
+
+#include "PowerStateMachine.hpp"
+#include "BenchLogic.hpp"
+
+//! Suspend test running bench frames through standby, hidden, background and stream stop phases
+class SuspendTest
+{
+public:
+    using State = VarjoExamples::PowerStateMachine::State;
+
+    //! Measurements of one test phase
+    struct Phase {
+        std::string name;                //!< Phase name
+        State expected = State::Active;  //!< Power state expected during phase
+        State endState = State::Active;  //!< Power state at phase end
+        double wallSec = 0.0;            //!< Phase length
+        double cpuUsage = 0.0;           //!< Busy cores on average
+        int64_t frames = 0;              //!< Frames run
+        int64_t suspendedFrames = 0;     //!< Frames run suspended
+        int64_t streamFrames = 0;        //!< Stylized stream frames
+        int64_t shaderInputs = 0;        //!< Submitted shader inputs
+        int64_t layers = 0;              //!< Submitted layers
+        double firstStreamMs = -1.0;     //!< Time from phase start to first stylized stream frame, -1 if none
+        bool passed = false;             //!< Work matched expected state
+    };
+
+    //! Test result
+    struct Result {
+        std::vector<Phase> phases;                      //!< Phases in run order
+        VarjoExamples::PowerStateMachine::Stats power;  //!< Power state accounting
+        int64_t resumeAllocations = 0;                  //!< Stylizer allocations from before first suspend to after first resume
+        double suspendedCpuUsage = 0.0;                 //!< Busy cores on average while suspended
+        double activeCpuUsage = 0.0;                    //!< Busy cores on average while active
+    };
+
+    //! Construct test with phases of given length
+    SuspendTest(const BenchLogic::Options& options, double phaseSec);
+
+    // Disable copy, move and assign
+    SuspendTest(const SuspendTest& other) = delete;
+    SuspendTest(const SuspendTest&& other) = delete;
+    SuspendTest& operator=(const SuspendTest& other) = delete;
+    SuspendTest& operator=(const SuspendTest&& other) = delete;
+
+    //! Run bench frames through test phases and measure work and process CPU usage of each. Frames must
+    //! be paced by the runtime, otherwise suspended frames spin. Returns false if bench logic init failed.
+    bool run();
+
+    //! Returns true if work matched expected state in every phase, suspended CPU usage stayed under limit,
+    //! stylizer did not allocate over suspend and resume, and stopped stream was retried
+    bool hasPassed() const;
+
+    //! Print test report
+    void print() const;
+
+    //! Returns test report as JSON
+    nlohmann::json toJson() const;
+
+private:
+    //! Returns suspended CPU usage relative to active CPU usage
+    double getCpuRatio() const;
+
+    //! Convert phase to JSON
+    static nlohmann::json toJson(const Phase& p);
+
+    const BenchLogic::Options m_options;  //!< Bench options
+    const double m_phaseSec;              //!< Phase length
+    Result m_result;                      //!< Test result
+};
@@ -0,0 +1,269 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "TelemetryValidation.hpp"
+
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <thread>
+#include <vector>
+
+#include "Globals.hpp"
+
+// VarjoExamples namespace contains simple example wrappers for using Varjo API features.
+// These are only meant to be used in SDK example applications. In your own application,
+// use your own production quality integration layer.
+using namespace VarjoExamples;
+
+namespace
+{
+// Telemetry validation: writer threads and rows per writer of concurrent test, frame-like rows and rows
+// appended per burst, smallest compression ratio of frame-like rows and largest mean append time in ns
+constexpr int c_telemetryWriters = 4;
+constexpr int c_telemetryWriterRows = 50000;
+constexpr int c_telemetryFrameRows = 90 * 2 * 60;
+constexpr int c_telemetryBurstRows = 512;
+constexpr double c_telemetryMinCompression = 4.0;
+constexpr double c_telemetryMaxAppendNs = 500.0;
+
+}  // namespace
+
+//---------------------------------------------------------------------------
+
+TelemetryValidation::TelemetryValidation(const std::string& filename)
+    : Validation("Telemetry", "telemetry")
+    , m_filename(filename)
+{
+}
+
+void TelemetryValidation::validate()
+{
+    const std::string filename = m_filename + ".validate";
+    using Type = TelemetryStore::ColumnType;
+
+    // Round trip over several small blocks, last one partial
+    {
+        const double specials[] = {0.0, -0.0, std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity(),
+            std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::denorm_min(), std::numeric_limits<double>::max(),
+            std::numeric_limits<double>::lowest(), 1.0, 1.0 + std::numeric_limits<double>::epsilon()};
+        const int64_t extremes[] = {std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::max(), 0, -1, 1,
+            std::numeric_limits<int64_t>::max(), std::numeric_limits<int64_t>::min()};
+        std::vector<TelemetryStore::Row> rows;
+        for (int i = 0; i < 1000; i++) {
+            TelemetryStore::Row row;
+            const double noise = getLatticeValue(i, 0, 1);
+            row.setInt(0, i < 7 ? extremes[i] : static_cast<int64_t>(i) * 11111111 + static_cast<int64_t>(noise * 1e6));
+            row.setInt(1, static_cast<int64_t>(getLatticeValue(i, 1, 2) * 4294967296.0) << (i % 32));
+            row.setFloat(2, i < 10 ? specials[i] : (i % 3 ? noise : std::round(noise * 8.0)));
+            rows.push_back(row);
+        }
+
+        TelemetryStore::Config config;
+        config.blockRows = 64;
+        TelemetryStore store({{"int", Type::Int}, {"bits", Type::Int}, {"float", Type::Float}}, config);
+        TelemetryStore::Writer* writer = store.createWriter();
+        bool opened = store.open(filename);
+        for (const auto& row : rows) {
+            writer->append(row);
+        }
+        store.close();
+
+        // Same file without its last byte has no valid index, so reader scans the blocks
+        std::ifstream in(filename, std::ifstream::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        in.close();
+        const std::string truncatedFile = filename + ".noindex";
+        std::ofstream(truncatedFile, std::ofstream::binary).write(bytes.data(), bytes.size() - 1);
+
+        for (const std::string& file : {filename, truncatedFile}) {
+            TelemetryReader reader;
+            std::vector<int64_t> ints;
+            std::vector<int64_t> bits;
+            std::vector<double> floats;
+            bool exact = opened && reader.open(file) && reader.getRowCount() == static_cast<int64_t>(rows.size()) &&
+                         reader.getBlockCount() == (static_cast<int>(rows.size()) + config.blockRows - 1) / config.blockRows &&
+                         reader.readInts(0, ints) && reader.readInts(1, bits) && reader.readFloats(2, floats) && !reader.readInts(2, ints);
+            for (size_t i = 0; exact && i < rows.size(); i++) {
+                exact = ints[i] == rows[i].values[0] && bits[i] == rows[i].values[1] && memcmp(&floats[i], &rows[i].values[2], sizeof(double)) == 0;
+            }
+            check(exact, file == filename ? "exact round trip" : "exact round trip without index");
+        }
+        std::remove(truncatedFile.c_str());
+    }
+
+    // Writers run flat out, so they fill up between drains and retry
+    {
+        TelemetryStore::Config config;
+        config.flushIntervalMs = 1;
+        TelemetryStore store({{"writer", Type::Int}, {"sequence", Type::Int}}, config);
+        std::vector<TelemetryStore::Writer*> writers;
+        for (int w = 0; w < c_telemetryWriters; w++) {
+            writers.push_back(store.createWriter());
+        }
+        bool opened = store.open(filename);
+        std::vector<std::thread> threads;
+        std::atomic<int64_t> retries{0};
+        for (int w = 0; w < c_telemetryWriters; w++) {
+            threads.emplace_back([&, w]() {
+                TelemetryStore::Row row;
+                row.setInt(0, w);
+                for (int i = 0; i < c_telemetryWriterRows; i++) {
+                    row.setInt(1, i);
+                    while (!writers[w]->append(row)) {
+                        retries++;
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        store.close();
+        const TelemetryStore::Stats stats = store.getStats();
+        m_result.concurrentRows = stats.rows;
+        m_result.concurrentRetries = retries;
+
+        TelemetryReader reader;
+        std::vector<int64_t> writerIds;
+        std::vector<int64_t> sequences;
+        bool ordered = opened && reader.open(filename) && reader.readInts(0, writerIds) && reader.readInts(1, sequences) &&
+                       reader.getRowCount() == static_cast<int64_t>(c_telemetryWriters) * c_telemetryWriterRows;
+        std::vector<int64_t> next(c_telemetryWriters, 0);
+        for (size_t i = 0; ordered && i < writerIds.size(); i++) {
+            ordered = writerIds[i] >= 0 && writerIds[i] < c_telemetryWriters && sequences[i] == next[writerIds[i]]++;
+        }
+        check(ordered, "concurrent rows exactly once in writer order");
+        check(stats.droppedRows == m_result.concurrentRetries, "dropped rows counted");
+    }
+
+    // Rows like stream frame telemetry: stereo frames at 90 Hz with capture jitter, auto exposure
+    // steps, slow head motion and noisy stage timings
+    {
+        std::vector<TelemetryStore::Column> columns = {{"frameNumber", Type::Int}, {"channel", Type::Int}, {"captureTimeNs", Type::Int},
+            {"recordTimeNs", Type::Int}, {"exposureTime", Type::Float}, {"ev", Type::Float}, {"whiteBalanceTemperature", Type::Float}};
+        for (const char* name : {"positionX", "positionY", "positionZ", "rotationX", "rotationY", "rotationZ", "rotationW"}) {
+            columns.push_back({name, Type::Float});
+        }
+        for (const char* name : {"detectTimeNs", "stereoTimeNs", "flowTimeNs", "orientationTimeNs", "stylizeTimeNs", "queueDepth"}) {
+            columns.push_back({name, Type::Int});
+        }
+
+        std::vector<TelemetryStore::Row> rows(c_telemetryFrameRows);
+        for (int i = 0; i < c_telemetryFrameRows; i++) {
+            const int frame = i / 2;
+            const double t = frame / 90.0;
+            const int64_t captureNs = static_cast<int64_t>(frame) * 11111111 + static_cast<int64_t>((getLatticeValue(frame, 0, 3) - 0.5) * 100000.0);
+            const double ev = 6.0 + 0.1 * static_cast<int>(3.0 * getValueNoise(glm::dvec2(t / 2.0, 0.0), 5));
+            const glm::quat rotation = glm::angleAxis(static_cast<float>(0.3 * std::sin(t * 0.7)), glm::vec3(0.0f, 1.0f, 0.0f));
+            auto& row = rows[i];
+            row.setInt(0, frame);
+            row.setInt(1, i % 2);
+            row.setInt(2, captureNs);
+            row.setInt(3, captureNs + 2000000 + static_cast<int64_t>(getLatticeValue(i, 1, 3) * 500000.0));
+            row.setFloat(4, 1.0 / 90.0 * std::exp2(6.0 - ev));
+            row.setFloat(5, ev);
+            row.setFloat(6, frame < 2700 ? 5000.0 : 4500.0);
+            row.setFloat(7, static_cast<float>(0.1 * std::sin(t * 0.5)));
+            row.setFloat(8, static_cast<float>(1.6 + 0.02 * std::sin(t * 1.9)));
+            row.setFloat(9, static_cast<float>(0.1 * std::cos(t * 0.4)));
+            row.setFloat(10, rotation.x);
+            row.setFloat(11, rotation.y);
+            row.setFloat(12, rotation.z);
+            row.setFloat(13, rotation.w);
+            for (int s = 0; s < 5; s++) {
+                row.setInt(14 + s, 200000 * (s + 1) + static_cast<int64_t>(getLatticeValue(i, 2 + s, 3) * 50000.0));
+            }
+            row.setInt(19, 0);
+        }
+
+        // Writer is given time to drain between bursts, like stream frames arriving at 180 Hz would
+        TelemetryStore::Config config;
+        config.flushIntervalMs = 5;
+        TelemetryStore store(columns, config);
+        TelemetryStore::Writer* writer = store.createWriter();
+        bool opened = store.open(filename);
+        int64_t appendNs = 0;
+        for (int i = 0; i < c_telemetryFrameRows; i += c_telemetryBurstRows) {
+            const int end = std::min(i + c_telemetryBurstRows, c_telemetryFrameRows);
+            const int64_t start = getTimestampNs();
+            for (int r = i; r < end; r++) {
+                writer->append(rows[r]);
+            }
+            appendNs += getTimestampNs() - start;
+            std::this_thread::sleep_for(std::chrono::milliseconds(4 * config.flushIntervalMs));
+        }
+        store.close();
+        const TelemetryStore::Stats stats = store.getStats();
+        m_result.appendNs = static_cast<double>(appendNs) / c_telemetryFrameRows;
+        m_result.compression = stats.encodedBytes > 0 ? static_cast<double>(stats.rawBytes) / stats.encodedBytes : 0.0;
+
+        const int64_t readStart = getTimestampNs();
+        TelemetryReader reader;
+        bool exact = opened && reader.open(filename) && reader.getRowCount() == c_telemetryFrameRows && stats.droppedRows == 0;
+        std::vector<int64_t> values;
+        for (int c = 0; exact && c < static_cast<int>(columns.size()); c++) {
+            if (columns[c].type == Type::Float) {
+                std::vector<double> floats;
+                exact = reader.readFloats(c, floats);
+                values.resize(floats.size());
+                memcpy(values.data(), floats.data(), floats.size() * sizeof(double));
+            } else {
+                exact = reader.readInts(c, values);
+            }
+            for (int i = 0; exact && i < c_telemetryFrameRows; i++) {
+                exact = values[i] == rows[i].values[c];
+            }
+        }
+        m_result.readMs = (getTimestampNs() - readStart) * 1e-6;
+        m_result.bytesPerRow = static_cast<double>(reader.getFileSize()) / c_telemetryFrameRows;
+        check(exact, "frame telemetry round trip");
+    }
+    std::remove(filename.c_str());
+
+    check(m_result.compression > c_telemetryMinCompression, "frame telemetry compression");
+    check(m_result.appendNs < c_telemetryMaxAppendNs, "append cost");
+}
+
+void TelemetryValidation::collect(const BenchLogic& logic)
+{
+    if (const TelemetryStore* telemetry = logic.getTelemetry()) {
+        m_streamStats = telemetry->getStats();
+    }
+
+    // Every stylized stream frame has a row in the file written during the run. Streams have been stopped and file closed.
+    TelemetryReader reader;
+    std::vector<int64_t> frameNumbers;
+    const bool readable = reader.open(m_filename) && reader.readInts(reader.findColumn("frameNumber"), frameNumbers);
+    m_result.streamRows = reader.getRowCount();
+    check(readable && m_result.streamRows == logic.getStreamStats().frames && m_streamStats.droppedRows == 0, "stream frames in telemetry file");
+}
+
+void TelemetryValidation::printResults() const
+{
+    const auto& r = m_result;
+    const auto& s = m_streamStats;
+    const double compression = s.encodedBytes > 0 ? static_cast<double>(s.rawBytes) / s.encodedBytes : 0.0;
+    printf("Telemetry validation: %lld concurrent rows (%lld retries), frame rows %.2f bytes/row, compression %.2f:1, append %.1f ns/row, "
+           "read %.3f ms\n",
+        static_cast<long long>(r.concurrentRows), static_cast<long long>(r.concurrentRetries), r.bytesPerRow, r.compression, r.appendNs, r.readMs);
+    printf("Telemetry stream: %lld rows in %lld blocks, %lld dropped, compression %.2f:1, %.3f ms flushing\n", static_cast<long long>(s.rows),
+        static_cast<long long>(s.blocks), static_cast<long long>(s.droppedRows), compression, s.flushTimeNs * 1e-6);
+}
+
+void TelemetryValidation::writeResults(nlohmann::json& section) const
+{
+    section["concurrentRows"] = m_result.concurrentRows;
+    section["concurrentRetries"] = m_result.concurrentRetries;
+    section["bytesPerRow"] = m_result.bytesPerRow;
+    section["compression"] = m_result.compression;
+    section["appendNs"] = m_result.appendNs;
+    section["readMs"] = m_result.readMs;
+    section["streamRows"] = m_result.streamRows;
+    section["streamDroppedRows"] = m_streamStats.droppedRows;
+}
@@ -0,0 +1,44 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <string>
+
+#include "Validation.hpp"
+#include "TelemetryStore.hpp"
+
+//! Telemetry store validation through temporary file, and check of stream telemetry file written in bench run
+class TelemetryValidation : public Validation
+{
+public:
+    //! Telemetry validation results
+    struct Result {
+        int64_t concurrentRows = 0;     //!< Rows appended from concurrent writers
+        int64_t concurrentRetries = 0;  //!< Appends retried because a writer was full
+        double bytesPerRow = 0.0;       //!< File bytes per frame-like row
+        double compression = 0.0;       //!< Raw column bytes per compressed column byte of frame-like rows
+        double appendNs = 0.0;          //!< Mean append time of frame-like rows
+        double readMs = 0.0;            //!< Time to map file and decode all frame-like columns
+        int64_t streamRows = 0;         //!< Rows in stream telemetry file, filled after run
+    };
+
+    //! Construct validation for stream telemetry file. Temporary file is named after it.
+    TelemetryValidation(const std::string& filename);
+
+    //! Validate exact round trip of integer extremes and special floats across blocks, reading without index,
+    //! rows of concurrent writers arriving exactly once and in writer order, and compression and append cost
+    //! of rows resembling stream frame telemetry
+    void validate() override;
+
+    //! Check that every stylized stream frame has a row in the stream telemetry file
+    void collect(const BenchLogic& logic) override;
+
+protected:
+    void printResults() const override;
+    void writeResults(nlohmann::json& section) const override;
+
+private:
+    const std::string m_filename;                        //!< Stream telemetry file
+    Result m_result;                                     //!< Validation results
+    VarjoExamples::TelemetryStore::Stats m_streamStats;  //!< Stream telemetry statistics of bench run
+};
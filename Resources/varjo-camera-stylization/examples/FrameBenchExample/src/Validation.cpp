@@ -0,0 +1,57 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include "Validation.hpp"
+
+#include <cstdio>
+#include <cmath>
+
+Validation::Validation(const char* name, const char* key)
+    : m_name(name)
+    , m_key(key)
+{
+}
+
+void Validation::print() const
+{
+    printResults();
+    printf("%s validation: %d/%d checks passed%s%s\n", m_name, m_checks - m_failed, m_checks, m_failed ? ", first failed: " : "", m_error.c_str());
+}
+
+void Validation::writeJson(nlohmann::json& report) const
+{
+    nlohmann::json& section = report[m_key];
+    writeResults(section);
+    section["checks"] = m_checks;
+    section["failed"] = m_failed;
+    section["passed"] = hasPassed();
+}
+
+void Validation::check(bool ok, const char* name)
+{
+    m_checks++;
+    if (!ok && m_failed++ == 0) {
+        m_error = name;
+    }
+}
+
+double getLatticeValue(int x, int y, uint32_t seed)
+{
+    uint32_t h = static_cast<uint32_t>(x) * 0x8da6b343u ^ static_cast<uint32_t>(y) * 0xd8163841u ^ seed * 0xcb1ab31fu;
+    h ^= h >> 13;
+    h *= 0x5bd1e995u;
+    h ^= h >> 15;
+    return (h & 0xffffff) / 16777216.0;
+}
+
+double getValueNoise(const glm::dvec2& p, uint32_t seed)
+{
+    const int x = static_cast<int>(std::floor(p.x));
+    const int y = static_cast<int>(std::floor(p.y));
+    const double fx = p.x - x;
+    const double fy = p.y - y;
+    const double sx = fx * fx * (3.0 - 2.0 * fx);
+    const double sy = fy * fy * (3.0 - 2.0 * fy);
+    const double top = getLatticeValue(x, y, seed) + (getLatticeValue(x + 1, y, seed) - getLatticeValue(x, y, seed)) * sx;
+    const double bottom = getLatticeValue(x, y + 1, seed) + (getLatticeValue(x + 1, y + 1, seed) - getLatticeValue(x, y + 1, seed)) * sx;
+    return top + (bottom - top) * sy;
+}
@@ -0,0 +1,72 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include <json/json.hpp>
+
+#include "BenchLogic.hpp"
+
+// NOTICE! Validations check a feature on synthetic inputs with known results before the bench run, and
+// collect statistics of the feature from bench logic after it. Every check is counted and the name of the
+// first failed one is reported, so a failing run tells what broke.
+
+//! Base class of feature validations run by FrameBench
+class Validation
+{
+public:
+    //! Construct validation with name used in report lines and key of its JSON report section
+    Validation(const char* name, const char* key);
+
+    //! Destructor
+    virtual ~Validation() = default;
+
+    // Disable copy, move and assign
+    Validation(const Validation& other) = delete;
+    Validation(const Validation&& other) = delete;
+    Validation& operator=(const Validation& other) = delete;
+    Validation& operator=(const Validation&& other) = delete;
+
+    //! Validate feature on synthetic inputs. Called before bench run.
+    virtual void validate() = 0;
+
+    //! Sample feature state after measured bench frame
+    virtual void onFrame(const BenchLogic& /*logic*/) {}
+
+    //! Collect feature statistics and check them after bench run. Streams have been stopped.
+    virtual void collect(const BenchLogic& /*logic*/) {}
+
+    //! Print feature report followed by check summary
+    void print() const;
+
+    //! Add feature report section with check counts to JSON report
+    void writeJson(nlohmann::json& report) const;
+
+    //! Returns true if no check failed
+    bool hasPassed() const { return m_failed == 0; }
+
+protected:
+    //! Count check. Name of first failed check is reported.
+    void check(bool ok, const char* name);
+
+    //! Print feature report lines
+    virtual void printResults() const = 0;
+
+    //! Write feature values to JSON report section
+    virtual void writeResults(nlohmann::json& section) const = 0;
+
+private:
+    const char* m_name;   //!< Name in report lines
+    const char* m_key;    //!< JSON report section key
+    int m_checks = 0;     //!< Checks run
+    int m_failed = 0;     //!< Checks failed
+    std::string m_error;  //!< First failed check
+};
+
+//! Returns pseudo random value in [0, 1) for lattice point. Synthetic validation inputs are built from it.
+double getLatticeValue(int x, int y, uint32_t seed);
+
+//! Smoothly interpolated value noise with lattice spacing of one
+double getValueNoise(const glm::dvec2& p, uint32_t seed);
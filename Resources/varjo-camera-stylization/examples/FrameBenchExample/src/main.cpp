@@ -0,0 +1,571 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <memory>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <thread>
+#include <atomic>
+#include <array>
+#include <functional>
+#include <cxxopts.hpp>
+#include <json/json.hpp>
+
+#include <Varjo_events.h>
+
+#include "Globals.hpp"
+#include "StandInRuntime.hpp"
+#include "FrameProfiler.hpp"
+#include "MetricsServer.hpp"
+#include "MemoryAccounting.hpp"
+
+#include "BenchLogic.hpp"
+#include "BenchReport.hpp"
+#include "MetricsScrape.hpp"
+#include "StallTest.hpp"
+#include "SuspendTest.hpp"
+#include "ShadingRateValidation.hpp"
+#include "StereoValidation.hpp"
+#include "FlowValidation.hpp"
+#include "OrientationValidation.hpp"
+#include "TelemetryValidation.hpp"
+#include "LateLatchValidation.hpp"
+#include "CpuRenderValidation.hpp"
+#include "CompositeValidation.hpp"
+#include "FrameRingValidation.hpp"
+
+// VarjoExamples namespace contains simple example wrappers for using Varjo API features.
+// These are only meant to be used in SDK example applications. In your own application,
+// use your own production quality integration layer.
+using namespace VarjoExamples;
+
+//---------------------------------------------------------------------------
+// Global allocation counting
+
+void* operator new(size_t size)
+{
+    FrameProfiler::onAllocation(size);
+    if (void* ptr = std::malloc(size ? size : 1)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+
+void operator delete[](void* ptr) noexcept { std::free(ptr); }
+
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+void operator delete[](void* ptr, size_t) noexcept { std::free(ptr); }
+
+//---------------------------------------------------------------------------
+
+namespace
+{
+// Simulated frame rate of synthetic sessions
+constexpr int c_sessionFrameRate = 90;
+
+// Frames in simulated minute. Presets are cycled and memory sampled every minute.
+constexpr int c_sessionMinuteFrames = c_sessionFrameRate * 60;
+
+// Allowed growth of tagged and resident memory after all presets have run once
+constexpr double c_taggedGrowthTolerance = 0.01;
+constexpr double c_residentGrowthTolerance = 0.05;
+
+//! Memory sample of synthetic session
+struct MemorySample {
+    int64_t frame = 0;                                                //!< Measured frame index
+    std::array<int64_t, MemoryAccounting::c_tagCount> tagBytes = {};  //!< Tagged bytes per tag
+    int64_t taggedBytes = 0;                                          //!< Tagged bytes of all tags
+    int64_t residentBytes = 0;                                        //!< Process resident memory
+};
+
+// Take memory sample
+MemorySample sampleMemory(int64_t frame)
+{
+    MemorySample sample;
+    sample.frame = frame;
+    for (int i = 0; i < MemoryAccounting::c_tagCount; i++) {
+        sample.tagBytes[i] = MemoryAccounting::getStats(static_cast<MemoryTag>(i)).bytes;
+    }
+    sample.taggedBytes = MemoryAccounting::getTotalBytes();
+    sample.residentBytes = MemoryAccounting::getProcessResidentBytes();
+    return sample;
+}
+
+// Parse comma separated tag=MB list
+bool parseMemoryBudgets(const std::string& spec, std::array<int64_t, MemoryAccounting::c_tagCount>& outBudgets)
+{
+    std::istringstream stream(spec);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        const size_t separator = item.find('=');
+        MemoryTag tag = MemoryTag::Count;
+        if (separator == std::string::npos || !MemoryAccounting::findTag(item.substr(0, separator), tag)) {
+            LOGE("Invalid memory budget: %s", item.c_str());
+            return false;
+        }
+        outBudgets[static_cast<int>(tag)] = static_cast<int64_t>(atof(item.c_str() + separator + 1) * 1024.0 * 1024.0);
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    const auto& presets = BenchLogic::getPresets();
+    std::string presetNames;
+    for (const auto& preset : presets) {
+        presetNames += std::string(presetNames.empty() ? "" : ", ") + preset.name;
+    }
+
+    cxxopts::Options options("FrameBench", "Run example frame loop headless against stand-in Varjo runtime and report frame costs");
+
+    // clang-format off
+    options.add_options()
+        ("frames", "Number of measured frames", cxxopts::value<int>()->default_value("5000"))
+        ("warmup", "Number of frames run before measuring", cxxopts::value<int>()->default_value("200"))
+        ("preset", "Effect preset: " + presetNames, cxxopts::value<std::string>()->default_value("cartoon"))
+        ("views", "View count, 2 or 4", cxxopts::value<int>()->default_value("4"))
+        ("view-size", "View width and height in pixels", cxxopts::value<int>()->default_value("1152"))
+        ("objects", "Scene object count", cxxopts::value<int>()->default_value("250"))
+        ("no-vr", "Do not render and submit VR layer")
+        ("stream-fps", "Color stream frame rate, zero to disable stream load", cxxopts::value<int>()->default_value("90"))
+        ("stream-size", "Color stream frame width and height", cxxopts::value<int>()->default_value("1152"))
+        ("threads", "Stream worker thread count, zero for hardware concurrency minus one", cxxopts::value<int>()->default_value("0"))
+        ("fiducials", "Draw fiducial marker with given id to stream frames and detect it, -1 to disable", cxxopts::value<int>()->default_value("-1"))
+        ("events", "Events injected per frame", cxxopts::value<int>()->default_value("0"))
+        ("dynres", "Scale view resolution to given frame budget in ms from simulated GPU time, zero to disable", cxxopts::value<double>()->default_value("0"))
+        ("gpu-cost", "Simulated GPU cost in ns per rendered pixel for dynamic resolution", cxxopts::value<double>()->default_value("2.5"))
+        ("throttle", "Pace frames to 90 Hz display rate")
+        ("vrs", "Validate shading rate maps on synthetic inputs and generate maps from gaze, occlusion and stream frames every frame")
+        ("stereo", "Validate stereo matcher on synthetic stereo pair with known depth and match left and right stream frames")
+        ("flow", "Validate flow tracker on synthetic translated and rotated sequences and track points over left stream frames")
+        ("orientation", "Validate orientation field on synthetic gratings, rings and noise and compute it from left stream frames")
+        ("late-latch", "Validate late latch on stand-in frame clock and submit pose dependent shader inputs from latch thread, paces frames to 90 Hz")
+        ("cpu-render", "Validate CPU renderer on synthetic meshes and benchmark scene in layer view atlas, and time it per SIMD level")
+        ("composite", "Validate CPU compositor on synthetic layers and scene views over stylized camera frames, and time half stream size previews per SIMD level")
+        ("frame-ring", "Validate shared frame ring with stalled and killed consumer processes and publish color stream frames to given number of consumer processes, measuring cross-process latency, zero to disable", cxxopts::value<int>()->default_value("0"))
+        ("telemetry", "Validate telemetry store and write per-frame stream telemetry to given file, empty to disable", cxxopts::value<std::string>()->default_value(""))
+        ("ui-stall-ms", "Compare frame jitter with simulated UI stalling given ms on frame thread and on own thread, zero to disable", cxxopts::value<double>()->default_value("0"))
+        ("ui-stall-every", "Simulated UI frames between UI stalls", cxxopts::value<int>()->default_value("30"))
+        ("suspend-sec", "Run standby, hidden, background and stream stop phases of given seconds, check that work pauses and resumes and compare idle CPU usage, zero to disable", cxxopts::value<double>()->default_value("0"))
+        ("memory-budgets", "Memory budgets in MB as comma separated tag=MB list. Tags: stream, cubemap, stylization, renderer, ui, markers", cxxopts::value<std::string>()->default_value(""))
+        ("session-hours", "Run synthetic session of given length at 90 Hz, cycling presets every simulated minute and checking that memory stays flat", cxxopts::value<double>()->default_value("0"))
+        ("metrics-port", "Serve metrics endpoint on given loopback port, zero to disable", cxxopts::value<int>()->default_value("0"))
+        ("scrape-ms", "Scrape and validate metrics endpoint at given interval in ms during run, zero to disable", cxxopts::value<int>()->default_value("0"))
+        ("json", "Write report to given JSON file", cxxopts::value<std::string>()->default_value(""))
+        ("verbose", "Print runtime log messages")
+        ("help", "Print help");
+    // clang-format on
+
+    cxxopts::ParseResult args = options.parse(argc, argv);
+    if (args.count("help")) {
+        printf("%s\n", options.help().c_str());
+        return EXIT_SUCCESS;
+    }
+
+    // Data streamer logs every frame on info level
+    LOG_INIT(nullptr, args.count("verbose") ? LogLevel::Info : LogLevel::Warning);
+
+    const int frames = std::max(args["frames"].as<int>(), 1);
+    const int warmup = std::max(args["warmup"].as<int>(), 0);
+    const int eventsPerFrame = std::max(args["events"].as<int>(), 0);
+    const int streamFps = std::max(args["stream-fps"].as<int>(), 0);
+    const int scrapeMs = std::max(args["scrape-ms"].as<int>(), 0);
+    int metricsPort = std::max(args["metrics-port"].as<int>(), 0);
+    if (scrapeMs > 0 && metricsPort == 0) {
+        metricsPort = MetricsServer::c_defaultPort;
+    }
+
+    BenchLogic::Options benchOptions;
+    if (!BenchLogic::findPreset(args["preset"].as<std::string>(), benchOptions.params)) {
+        return EXIT_FAILURE;
+    }
+    benchOptions.objectCount = args["objects"].as<int>();
+    benchOptions.vrEnabled = args.count("no-vr") == 0;
+    benchOptions.streamEnabled = streamFps > 0;
+    benchOptions.threadCount = args["threads"].as<int>();
+    benchOptions.fiducialsEnabled = args["fiducials"].as<int>() >= 0;
+    benchOptions.resolutionBudgetMs = args["dynres"].as<double>();
+    benchOptions.gpuNsPerPixel = args["gpu-cost"].as<double>();
+    benchOptions.shadingRateEnabled = args.count("vrs") > 0;
+    benchOptions.stereoEnabled = args.count("stereo") > 0;
+    benchOptions.flowEnabled = args.count("flow") > 0;
+    benchOptions.orientationEnabled = args.count("orientation") > 0;
+    benchOptions.telemetryFile = args["telemetry"].as<std::string>();
+    benchOptions.lateLatchEnabled = args.count("late-latch") > 0;
+    const int ringConsumers = args["frame-ring"].as<int>();
+    if (ringConsumers > 0) {
+        benchOptions.frameRing = "FrameBench" + std::to_string(GetCurrentProcessId());
+    }
+    if (!parseMemoryBudgets(args["memory-budgets"].as<std::string>(), benchOptions.memoryBudgets)) {
+        return EXIT_FAILURE;
+    }
+
+    // Session runs unprofiled frames past profiled ones, so that profiler storage does not grow with session length
+    const int64_t sessionFrames = static_cast<int64_t>(std::max(args["session-hours"].as<double>(), 0.0) * 3600.0 * c_sessionFrameRate);
+    const int64_t sessionMinutes = sessionFrames / c_sessionMinuteFrames;
+    const int64_t baselineMinute = static_cast<int64_t>(presets.size());
+    if (sessionFrames > 0 && sessionMinutes <= baselineMinute + 1) {
+        LOGE("Session must be longer than %lld minutes to run all presets before baseline", static_cast<long long>(baselineMinute + 1));
+        return EXIT_FAILURE;
+    }
+    const int64_t runFrames = std::max<int64_t>(frames, sessionFrames);
+
+    // Configure stand-in runtime before session init
+    StandInRuntime::Config runtimeConfig;
+    runtimeConfig.viewCount = args["views"].as<int>();
+    runtimeConfig.viewWidth = runtimeConfig.viewHeight = args["view-size"].as<int>();
+    runtimeConfig.throttle = args.count("throttle") > 0;
+    runtimeConfig.streamWidth = runtimeConfig.streamHeight = args["stream-size"].as<int>();
+    runtimeConfig.streamFrameRate = std::max(streamFps, 1);
+    runtimeConfig.streamMarkerId = args["fiducials"].as<int>();
+
+    // UI stall test needs frames paced to display rate, otherwise there are no frame intervals to disturb.
+    // Suspend test needs it too, since unpaced suspended frames would spin. Late latch needs display
+    // times on the frame clock.
+    const double uiStallMs = std::max(args["ui-stall-ms"].as<double>(), 0.0);
+    const double suspendSec = std::max(args["suspend-sec"].as<double>(), 0.0);
+    if (uiStallMs > 0.0 || suspendSec > 0.0 || benchOptions.lateLatchEnabled) {
+        runtimeConfig.throttle = true;
+    }
+    StandInRuntime::configure(runtimeConfig);
+
+    if (suspendSec > 0.0) {
+        SuspendTest test(benchOptions, suspendSec);
+        if (!test.run()) {
+            return EXIT_FAILURE;
+        }
+        test.print();
+        if (!writeReport(args["json"].as<std::string>(), test.toJson())) {
+            return EXIT_FAILURE;
+        }
+        return test.hasPassed() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    if (uiStallMs > 0.0) {
+        StallTest test(benchOptions, warmup, frames, uiStallMs, std::max(args["ui-stall-every"].as<int>(), 1));
+        if (!test.run()) {
+            return EXIT_FAILURE;
+        }
+        test.print();
+        if (!writeReport(args["json"].as<std::string>(), test.toJson())) {
+            return EXIT_FAILURE;
+        }
+        return test.hasPassed() ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    FrameProfiler profiler(BenchLogic::getPhaseNames(), frames);
+    BenchLogic::StreamStats streamStats;
+    StandInRuntime::Stats runtimeStats;
+    NullRenderer::Stats rendererStats;
+    BenchLogic::ResolutionStats resolutionStats;
+    bool resolutionEnabled = false;
+    ScrapeStats scrapeStats;
+    MetricsServer::Stats serverStats;
+    MemoryBudget::Stats budgetStats;
+    std::vector<MemorySample> memorySamples;
+    memorySamples.reserve(static_cast<size_t>(sessionMinutes + 1));
+
+    // Feature validations run before bench run, and collect feature statistics after it
+    std::vector<std::unique_ptr<Validation>> validations;
+    if (benchOptions.shadingRateEnabled) {
+        validations.push_back(std::make_unique<ShadingRateValidation>(frames));
+    }
+    if (benchOptions.stereoEnabled) {
+        validations.push_back(std::make_unique<StereoValidation>(benchOptions.threadCount, runtimeConfig.streamWidth));
+    }
+    if (benchOptions.flowEnabled) {
+        validations.push_back(std::make_unique<FlowValidation>(benchOptions.threadCount));
+    }
+    if (benchOptions.orientationEnabled) {
+        validations.push_back(std::make_unique<OrientationValidation>(benchOptions.threadCount, runtimeConfig.streamWidth));
+    }
+    if (!benchOptions.telemetryFile.empty()) {
+        validations.push_back(std::make_unique<TelemetryValidation>(benchOptions.telemetryFile));
+    }
+    if (benchOptions.lateLatchEnabled) {
+        validations.push_back(std::make_unique<LateLatchValidation>());
+    }
+    if (args.count("cpu-render") > 0) {
+        validations.push_back(std::make_unique<CpuRenderValidation>(benchOptions.threadCount, benchOptions.objectCount));
+    }
+    if (args.count("composite") > 0) {
+        validations.push_back(
+            std::make_unique<CompositeValidation>(benchOptions.threadCount, benchOptions.objectCount, runtimeConfig.streamWidth, streamFps));
+    }
+    if (!benchOptions.frameRing.empty()) {
+        validations.push_back(std::make_unique<FrameRingValidation>(benchOptions.frameRing, ringConsumers, streamFps));
+    }
+    for (auto& validation : validations) {
+        validation->validate();
+    }
+
+    {
+        BenchLogic logic(benchOptions);
+        if (!logic.init()) {
+            return EXIT_FAILURE;
+        }
+
+        // Serve metrics while frame loop runs, and scrape it from another thread like a monitoring agent would
+        std::unique_ptr<MetricsServer> metricsServer;
+        std::thread scrapeThread;
+        std::atomic<bool> scraping{false};
+        if (metricsPort > 0) {
+            MetricsServer::Config serverConfig;
+            serverConfig.port = static_cast<uint16_t>(metricsPort);
+            metricsServer = std::make_unique<MetricsServer>(logic.getMetrics(), serverConfig);
+            if (!metricsServer->isRunning()) {
+                return EXIT_FAILURE;
+            }
+        }
+        if (metricsServer && scrapeMs > 0) {
+            std::vector<std::string> required = {"varjo_frame_sync_seconds_count", "varjo_frame_render_seconds_count", "process_cpu_seconds_total",
+                "process_resident_memory_bytes"};
+            if (benchOptions.streamEnabled) {
+                required.push_back("varjo_stream_frames_total");
+            }
+            scraping = true;
+            scrapeThread = std::thread([&, required]() {
+                while (scraping) {
+                    scrapeMetrics(static_cast<uint16_t>(metricsPort), required, scrapeStats);
+                    std::this_thread::sleep_for(std::chrono::milliseconds(scrapeMs));
+                }
+            });
+        }
+
+        // Injected events are handled by the frame loop but do not change its state
+        varjo_Event evt{};
+        evt.header.type = varjo_EventType_Visibility;
+        evt.data.visibility.visible = varjo_True;
+
+        for (int64_t i = 0; i < warmup + runFrames; i++) {
+            for (int e = 0; e < eventsPerFrame; e++) {
+                StandInRuntime::pushEvent(evt);
+            }
+
+            const bool measured = (i >= warmup);
+            if (measured) {
+                profiler.beginFrame();
+            }
+            logic.update(profiler);
+            if (measured) {
+                profiler.endFrame();
+            }
+            if (measured) {
+                for (auto& validation : validations) {
+                    validation->onFrame(logic);
+                }
+            }
+
+            // Sample memory left by previous minute and switch to next preset
+            if (sessionFrames > 0 && measured && (i - warmup) % c_sessionMinuteFrames == 0) {
+                const int64_t minute = (i - warmup) / c_sessionMinuteFrames;
+                memorySamples.push_back(sampleMemory(i - warmup));
+                logic.setParams(presets[minute % presets.size()].params);
+            }
+        }
+        if (sessionFrames > 0) {
+            memorySamples.push_back(sampleMemory(runFrames));
+        }
+        budgetStats = logic.getMemoryBudgetStats();
+
+        if (scrapeThread.joinable()) {
+            scraping = false;
+            scrapeThread.join();
+        }
+        if (metricsServer) {
+            serverStats = metricsServer->getStats();
+            metricsServer.reset();
+        }
+
+        logic.stopStreams();
+        streamStats = logic.getStreamStats();
+        runtimeStats = StandInRuntime::getStats();
+        rendererStats = logic.getRendererStats();
+        resolutionEnabled = logic.getResolutionStats(resolutionStats);
+        for (auto& validation : validations) {
+            validation->collect(logic);
+        }
+    }
+
+    // All tagged memory is owned by bench logic, so anything left is leaked
+    const int64_t leakedBytes = MemoryAccounting::getTotalBytes();
+
+    const auto report = profiler.getReport();
+    const int64_t n = std::max<int64_t>(report.frames, 1);
+
+    printf("Frames: %lld measured, %d warmup, preset: %s, views: %d, objects: %d, stream: %d fps\n", static_cast<long long>(report.frames), warmup,
+        args["preset"].as<std::string>().c_str(), runtimeConfig.viewCount, benchOptions.objectCount, streamFps);
+    printf("Wall time: %.1f ms, process CPU time: %.1f ms (%.2f cores)\n", report.wallTimeMs, report.processCpuTimeMs,
+        report.wallTimeMs > 0.0 ? report.processCpuTimeMs / report.wallTimeMs : 0.0);
+    printf("\n  %-14s %8s %8s %8s %8s %8s %8s %8s\n", "Time ms", "min", "mean", "p50", "p90", "p95", "p99", "max");
+    printDistribution("frame", report.frameTimeMs);
+    for (size_t i = 0; i < report.phaseNames.size(); i++) {
+        printDistribution(report.phaseNames[i].c_str(), report.phaseTimeMs[i]);
+    }
+
+    printf("\nFrame time histogram:\n");
+    for (int i = 0; i < FrameProfiler::c_histogramBins; i++) {
+        const bool last = (i == FrameProfiler::c_histogramBins - 1);
+        const int bar = static_cast<int>(60 * report.histogram[i] / n);
+        printf("  %s%7.3f ms %7lld %s\n", last ? ">=" : "  ", i * report.histogramBinMs, static_cast<long long>(report.histogram[i]), std::string(bar, '#').c_str());
+    }
+
+    printf("\nFrame thread: %.2f allocations/frame (%.0f bytes/frame, p99 %.0f), %lld lock waits (%.3f ms)\n",
+        static_cast<double>(report.frameThread.allocations) / n, static_cast<double>(report.frameThread.allocatedBytes) / n, report.frameAllocations.p99,
+        static_cast<long long>(report.frameThread.lockWaits), report.frameThread.lockWaitTimeNs * 1e-6);
+    printf("All threads:  %.2f allocations/frame (%.0f bytes/frame), %lld lock waits (%.3f ms)\n", static_cast<double>(report.allThreads.allocations) / n,
+        static_cast<double>(report.allThreads.allocatedBytes) / n, static_cast<long long>(report.allThreads.lockWaits), report.allThreads.lockWaitTimeNs * 1e-6);
+    printf("Stream: %lld frames stylized (%.3f ms mean), %lld delivered, %lld skipped\n", static_cast<long long>(streamStats.frames),
+        streamStats.frames ? streamStats.stylizeTimeNs * 1e-6 / streamStats.frames : 0.0, static_cast<long long>(runtimeStats.streamFramesDelivered),
+        static_cast<long long>(runtimeStats.streamFramesSkipped));
+    if (benchOptions.fiducialsEnabled) {
+        printf("Fiducials: %lld/%lld frames with marker pose (%.3f ms mean detect), last distance %.3f m\n", static_cast<long long>(streamStats.fiducialHits),
+            static_cast<long long>(streamStats.fiducialFrames), streamStats.fiducialFrames ? streamStats.detectTimeNs * 1e-6 / streamStats.fiducialFrames : 0.0,
+            streamStats.markerDistance);
+    }
+    if (resolutionEnabled) {
+        const auto& scaler = resolutionStats.scaler;
+        printf("Dynamic resolution: %.2f ms budget, %.3f ms mean GPU (%.1f%% frames over), %.2f Mpix/frame, %lld decreases, %lld increases, scale %.2f context %.2f focus\n",
+            benchOptions.resolutionBudgetMs, resolutionStats.gpuTimeMeanMs, scaler.frames ? 100.0 * scaler.framesOverBudget / scaler.frames : 0.0,
+            resolutionStats.pixelsMean * 1e-6, static_cast<long long>(scaler.decreases), static_cast<long long>(scaler.increases), resolutionStats.contextScale,
+            resolutionStats.focusScale);
+        printf("Submitted view pixels: %.2f Mpix/frame\n", runtimeStats.framesSubmitted ? runtimeStats.viewPixelsSubmitted * 1e-6 / runtimeStats.framesSubmitted : 0.0);
+    }
+    bool validationsPassed = true;
+    for (const auto& validation : validations) {
+        validation->print();
+        validationsPassed &= validation->hasPassed();
+    }
+    bool memoryFlat = true;
+    if (sessionFrames > 0) {
+        // Growth compares high water marks of early and late part of session instead of single samples, because
+        // budget sheds make memory oscillate between released and working size. Early part includes a run of
+        // every preset, so buffers have reached their working size in it.
+        const size_t half = static_cast<size_t>(baselineMinute) + (memorySamples.size() - static_cast<size_t>(baselineMinute)) / 2;
+        const auto windowMax = [&](size_t begin, size_t end, const std::function<int64_t(const MemorySample&)>& get) {
+            int64_t maxBytes = 0;
+            for (size_t s = begin; s < end; s++) {
+                maxBytes = std::max(maxBytes, get(memorySamples[s]));
+            }
+            return maxBytes;
+        };
+        const MemorySample& last = memorySamples.back();
+        printf("\nSession: %.2f h simulated in %lld frames, %lld memory samples, early part until minute %lld\n", sessionFrames / (3600.0 * c_sessionFrameRate),
+            static_cast<long long>(sessionFrames), static_cast<long long>(memorySamples.size()), static_cast<long long>(half));
+        printf("  %-12s %10s %10s %10s %10s\n", "Memory MB", "early max", "late max", "end", "peak");
+        for (int t = 0; t < MemoryAccounting::c_tagCount; t++) {
+            const auto get = [t](const MemorySample& sample) { return sample.tagBytes[t]; };
+            const MemoryTag tag = static_cast<MemoryTag>(t);
+            printf("  %-12s %10.2f %10.2f %10.2f %10.2f\n", MemoryAccounting::getTagName(tag), windowMax(0, half, get) / 1048576.0,
+                windowMax(half, memorySamples.size(), get) / 1048576.0, last.tagBytes[t] / 1048576.0, MemoryAccounting::getStats(tag).peakBytes / 1048576.0);
+        }
+
+        const auto getTagged = [](const MemorySample& sample) { return sample.taggedBytes; };
+        const auto getResident = [](const MemorySample& sample) { return sample.residentBytes; };
+        const int64_t earlyTagged = windowMax(0, half, getTagged);
+        const int64_t lateTagged = windowMax(half, memorySamples.size(), getTagged);
+        const int64_t earlyResident = windowMax(0, half, getResident);
+        const int64_t lateResident = windowMax(half, memorySamples.size(), getResident);
+        const double taggedGrowth = earlyTagged > 0 ? static_cast<double>(lateTagged - earlyTagged) / earlyTagged : 0.0;
+        const double residentGrowth = earlyResident > 0 ? static_cast<double>(lateResident - earlyResident) / earlyResident : 0.0;
+        memoryFlat = taggedGrowth <= c_taggedGrowthTolerance && residentGrowth <= c_residentGrowthTolerance && leakedBytes == 0;
+        printf("  %-12s %10.2f %10.2f %10.2f     %+.2f%%\n", "tagged", earlyTagged / 1048576.0, lateTagged / 1048576.0, last.taggedBytes / 1048576.0,
+            100.0 * taggedGrowth);
+        printf("  %-12s %10.2f %10.2f %10.2f     %+.2f%%\n", "resident", earlyResident / 1048576.0, lateResident / 1048576.0,
+            last.residentBytes / 1048576.0, 100.0 * residentGrowth);
+        printf("Tagged bytes left after shutdown: %lld\n", static_cast<long long>(leakedBytes));
+        printf("Memory budgets: %lld warnings, %lld sheds. Memory %s\n", static_cast<long long>(budgetStats.warnings),
+            static_cast<long long>(budgetStats.sheds), memoryFlat ? "flat" : "GREW");
+    }
+
+    if (scrapeMs > 0) {
+        printf("Metrics: %lld scrapes (%.1f KB), %.3f ms mean / %.3f ms max round trip, server %.3f ms mean / %.3f ms max, %lld failed, %lld invalid\n",
+            static_cast<long long>(scrapeStats.scrapes), scrapeStats.scrapes ? scrapeStats.bytes / 1024.0 / scrapeStats.scrapes : 0.0,
+            scrapeStats.scrapes ? scrapeStats.timeTotalMs / scrapeStats.scrapes : 0.0, scrapeStats.timeMaxMs, serverStats.scrapeTimeAvgMs,
+            serverStats.scrapeTimeMaxMs, static_cast<long long>(scrapeStats.failed), static_cast<long long>(scrapeStats.invalid));
+        if (scrapeStats.invalid > 0) {
+            LOGE("Invalid metrics response: %s", scrapeStats.firstError.c_str());
+        }
+    }
+    printf("Runtime: %lld frames submitted, %lld views, %lld events, %lld errors. Renderer: %.1f meshes/frame\n",
+        static_cast<long long>(runtimeStats.framesSubmitted), static_cast<long long>(runtimeStats.viewsSubmitted), static_cast<long long>(runtimeStats.eventsPolled),
+        static_cast<long long>(runtimeStats.errors), static_cast<double>(rendererStats.meshes) / (warmup + runFrames));
+
+    const std::string jsonFile = args["json"].as<std::string>();
+    if (!jsonFile.empty()) {
+        nlohmann::json j;
+        j["frames"] = report.frames;
+        j["preset"] = args["preset"].as<std::string>();
+        j["views"] = runtimeConfig.viewCount;
+        j["objects"] = benchOptions.objectCount;
+        j["streamFps"] = streamFps;
+        j["wallTimeMs"] = report.wallTimeMs;
+        j["processCpuTimeMs"] = report.processCpuTimeMs;
+        j["frameTimeMs"] = toJson(report.frameTimeMs);
+        for (size_t i = 0; i < report.phaseNames.size(); i++) {
+            j["phaseTimeMs"][report.phaseNames[i]] = toJson(report.phaseTimeMs[i]);
+        }
+        j["histogramBinMs"] = report.histogramBinMs;
+        j["histogram"] = report.histogram;
+        j["frameThread"] = toJson(report.frameThread);
+        j["allThreads"] = toJson(report.allThreads);
+        j["streamFrames"] = streamStats.frames;
+        j["streamFramesSkipped"] = runtimeStats.streamFramesSkipped;
+        if (benchOptions.fiducialsEnabled) {
+            j["fiducialFrames"] = streamStats.fiducialFrames;
+            j["fiducialHits"] = streamStats.fiducialHits;
+            j["fiducialDetectTimeNs"] = streamStats.detectTimeNs;
+        }
+        if (resolutionEnabled) {
+            j["resolution"]["budgetMs"] = benchOptions.resolutionBudgetMs;
+            j["resolution"]["gpuTimeMeanMs"] = resolutionStats.gpuTimeMeanMs;
+            j["resolution"]["framesOverBudget"] = resolutionStats.scaler.framesOverBudget;
+            j["resolution"]["decreases"] = resolutionStats.scaler.decreases;
+            j["resolution"]["increases"] = resolutionStats.scaler.increases;
+        }
+        for (const auto& validation : validations) {
+            validation->writeJson(j);
+        }
+        if (sessionFrames > 0) {
+            nlohmann::json samples = nlohmann::json::array();
+            for (const auto& sample : memorySamples) {
+                samples.push_back({{"frame", sample.frame}, {"tagBytes", sample.tagBytes}, {"residentBytes", sample.residentBytes}});
+            }
+            j["session"]["frames"] = sessionFrames;
+            j["session"]["baselineMinute"] = baselineMinute;
+            j["session"]["memorySamples"] = samples;
+            j["session"]["memoryFlat"] = memoryFlat;
+            j["session"]["leakedBytes"] = leakedBytes;
+            j["session"]["budgetWarnings"] = budgetStats.warnings;
+            j["session"]["budgetSheds"] = budgetStats.sheds;
+        }
+        if (scrapeMs > 0) {
+            j["metrics"]["scrapes"] = scrapeStats.scrapes;
+            j["metrics"]["failed"] = scrapeStats.failed;
+            j["metrics"]["invalid"] = scrapeStats.invalid;
+            j["metrics"]["roundTripMeanMs"] = scrapeStats.scrapes ? scrapeStats.timeTotalMs / scrapeStats.scrapes : 0.0;
+            j["metrics"]["roundTripMaxMs"] = scrapeStats.timeMaxMs;
+        }
+        j["runtimeErrors"] = runtimeStats.errors;
+
+        if (!writeReport(jsonFile, j)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    const bool metricsValid = scrapeMs == 0 || (scrapeStats.scrapes > 0 && scrapeStats.failed == 0 && scrapeStats.invalid == 0);
+    const bool passed = runtimeStats.errors == 0 && metricsValid && memoryFlat && validationsPassed;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
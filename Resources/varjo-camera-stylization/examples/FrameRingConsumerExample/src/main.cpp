@@ -0,0 +1,154 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <cxxopts.hpp>
+#include <json/json.hpp>
+
+#include "Globals.hpp"
+#include "SharedFrameRing.hpp"
+
+// VarjoExamples namespace contains simple example wrappers for using Varjo API features.
+// These are only meant to be used in SDK example applications. In your own application,
+// use your own production quality integration layer.
+using namespace VarjoExamples;
+
+namespace
+{
+// Payload words skipped between checksummed words. Overwrite rewrites the whole slot, so sampling is enough.
+constexpr size_t c_checksumStep = 64;
+
+// Wait for a single frame before checking if ring was closed
+constexpr int c_acquireWaitMs = 100;
+
+// Consumer run statistics
+struct ConsumerStats {
+    bool attached = false;        // Attached to ring
+    int64_t received = 0;         // Frames acquired
+    int64_t skipped = 0;          // Frames missed because consumer was too slow
+    int64_t overwritten = 0;      // Frames changed while held
+    std::vector<double> latency;  // Publish to acquire latency of each frame in ms
+};
+
+// FNV-1a hash of sampled payload words
+uint64_t getChecksum(const uint8_t* data, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i + sizeof(uint64_t) <= size; i += c_checksumStep * sizeof(uint64_t)) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// Read frames until given count has been received or ring is closed. Every frame is held for given time
+// and checked to be unchanged before it is released.
+void consume(SharedFrameConsumer& consumer, int64_t frames, int holdMs, ConsumerStats& stats)
+{
+    SharedFrameConsumer::FrameRef frame;
+    while ((frames <= 0 || stats.received < frames) && !consumer.isClosed()) {
+        if (!consumer.acquire(frame, c_acquireWaitMs)) {
+            continue;
+        }
+        stats.received++;
+        stats.latency.push_back(static_cast<double>(SharedFrameRing::getTimestamp() - frame.info->publishTime) * 1e-6);
+
+        // Stream frames may share payload content, so frame identity is checked from metadata as well
+        const int64_t frameNumber = frame.info->frameNumber;
+        const varjo_ChannelIndex channel = frame.info->channelIndex;
+        const uint64_t checksum = getChecksum(frame.data, frame.dataSize);
+        if (holdMs > 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(holdMs));
+        }
+        if (frame.info->frameNumber != frameNumber || frame.info->channelIndex != channel || getChecksum(frame.data, frame.dataSize) != checksum) {
+            stats.overwritten++;
+        }
+        consumer.release(frame);
+    }
+    stats.skipped = consumer.getStats().skipped;
+}
+
+// Returns latency percentile in ms
+double getPercentile(std::vector<double> values, double percentile)
+{
+    if (values.empty()) {
+        return 0.0;
+    }
+    const size_t index = std::min(values.size() - 1, static_cast<size_t>(percentile * 0.01 * static_cast<double>(values.size())));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+// Write consumer statistics to JSON file
+bool writeReport(const std::string& filename, const ConsumerStats& stats)
+{
+    std::ofstream file(filename);
+    if (!file) {
+        LOGE("Opening file failed: %s", filename.c_str());
+        return false;
+    }
+
+    double latencyMean = 0.0;
+    for (double latency : stats.latency) {
+        latencyMean += latency / static_cast<double>(stats.latency.size());
+    }
+    const nlohmann::json report = {{"attached", stats.attached}, {"received", stats.received}, {"skipped", stats.skipped},
+        {"overwritten", stats.overwritten}, {"latencyMeanMs", latencyMean}, {"latencyP99Ms", getPercentile(stats.latency, 99.0)},
+        {"latencyMaxMs", getPercentile(stats.latency, 100.0)}};
+    file << report.dump(4) << std::endl;
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    cxxopts::Options options("FrameRingConsumer", "Read frames from shared frame ring published by another process and report latency");
+
+    // clang-format off
+    options.add_options()
+        ("ring", "Shared frame ring name", cxxopts::value<std::string>()->default_value("FrameBench"))
+        ("frames", "Number of frames to read, zero to read until ring is closed", cxxopts::value<int>()->default_value("0"))
+        ("hold-ms", "Time to hold each frame before releasing it", cxxopts::value<int>()->default_value("0"))
+        ("json", "Write statistics to given JSON file", cxxopts::value<std::string>()->default_value(""))
+        ("verbose", "Print log messages")
+        ("help", "Print help");
+    // clang-format on
+
+    cxxopts::ParseResult args = options.parse(argc, argv);
+    if (args.count("help")) {
+        printf("%s\n", options.help().c_str());
+        return EXIT_SUCCESS;
+    }
+
+    LOG_INIT(nullptr, args.count("verbose") ? LogLevel::Info : LogLevel::Warning);
+
+    ConsumerStats stats;
+    auto consumer = std::make_unique<SharedFrameConsumer>(args["ring"].as<std::string>());
+    stats.attached = consumer->isAttached();
+    if (stats.attached) {
+        consume(*consumer, args["frames"].as<int>(), args["hold-ms"].as<int>(), stats);
+    }
+
+    // Detach before reporting, so that producer sees held frames released
+    consumer.reset();
+
+    printf("Frames: %lld received, %lld skipped, %lld overwritten while held\n", static_cast<long long>(stats.received),
+        static_cast<long long>(stats.skipped), static_cast<long long>(stats.overwritten));
+    printf("Latency: p99 %.3f ms, max %.3f ms\n", getPercentile(stats.latency, 99.0), getPercentile(stats.latency, 100.0));
+
+    const std::string jsonFile = args["json"].as<std::string>();
+    if (!jsonFile.empty() && !writeReport(jsonFile, stats)) {
+        return EXIT_FAILURE;
+    }
+    return stats.attached ? EXIT_SUCCESS : EXIT_FAILURE;
+}
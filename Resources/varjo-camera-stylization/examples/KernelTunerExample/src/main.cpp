@@ -0,0 +1,457 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include <cstdio>
+#include <cmath>
+#include <string>
+#include <sstream>
+#include <random>
+#include <algorithm>
+#include <cxxopts.hpp>
+
+#include "Globals.hpp"
+#include "CpuInfo.hpp"
+#include "CpuStylizer.hpp"
+#include "KernelProfile.hpp"
+#include "KernelTuner.hpp"
+#include "Convolution.hpp"
+
+// VarjoExamples namespace contains simple example wrappers for using Varjo API features.
+// These are only meant to be used in SDK example applications. In your own application,
+// use your own production quality integration layer.
+using namespace VarjoExamples;
+
+namespace
+{
+// Default tuned resolutions: distorted color stream and half resolution preview
+const char* c_defaultResolutions = "1152x1152,576x576";
+
+// Radius range of radius sweep
+constexpr int c_sweepMinRadius = 2;
+constexpr int c_sweepMaxRadius = 24;
+
+// Convolution benchmark kernels
+using SobelX3 = Conv::Separable<Conv::Kernel1D<1, -1, 0, 1>, Conv::Kernel1D<1, 1, 2, 1>>;
+using Gaussian5 = Conv::Separable<Conv::Kernel1D<16, 1, 4, 6, 4, 1>, Conv::Kernel1D<16, 1, 4, 6, 4, 1>>;
+using Box3 = Conv::Kernel2D<3, 3, 9, 1, 1, 1, 1, 1, 1, 1, 1, 1>;
+using Laplacian3 = Conv::Kernel2D<3, 3, 1, 0, 1, 0, 1, -4, 1, 0, 1, 0>;
+
+// Split comma separated list
+std::vector<std::string> splitList(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+// Parse kernel names
+bool parseKernels(const std::string& list, std::vector<CpuStylizer::Kernel>& outKernels)
+{
+    for (const auto& name : splitList(list)) {
+        bool found = false;
+        for (int i = 0; i < static_cast<int>(CpuStylizer::Kernel::Count); i++) {
+            const auto kernel = static_cast<CpuStylizer::Kernel>(i);
+            if (name == CpuStylizer::getKernelName(kernel)) {
+                outKernels.push_back(kernel);
+                found = true;
+            }
+        }
+        if (!found) {
+            LOGE("Unknown kernel: %s", name.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+// Parse resolutions in WxH format
+bool parseResolutions(const std::string& list, std::vector<std::pair<int, int>>& outResolutions)
+{
+    for (const auto& item : splitList(list)) {
+        int w = 0, h = 0;
+        if (sscanf(item.c_str(), "%dx%d", &w, &h) != 2 || w <= 0 || h <= 0) {
+            LOGE("Invalid resolution: %s", item.c_str());
+            return false;
+        }
+        outResolutions.emplace_back(w, h);
+    }
+    return true;
+}
+
+// Print profile entries of one machine
+void printMachine(const std::string& key, const KernelProfile::Machine& machine)
+{
+    printf("%s\n", key.c_str());
+    printf("  Logical cores: %d, updated: %s\n", machine.logicalCores, machine.timestamp.c_str());
+    printf("  %-14s %-10s %-46s %10s %10s %8s\n", "Kernel", "Resolution", "Configuration", "Time ms", "Default ms", "Speedup");
+    for (const auto& entry : machine.entries) {
+        const std::string resolution = std::to_string(entry.width) + "x" + std::to_string(entry.height);
+        printf("  %-14s %-10s %-46s %10.3f %10.3f %7.2fx\n", entry.kernel.c_str(), resolution.c_str(), toString(entry.config).c_str(), entry.timeMs,
+            entry.baselineMs, entry.timeMs > 0.0 ? entry.baselineMs / entry.timeMs : 0.0);
+    }
+}
+
+// Time radius dependent kernels with their default configuration over radius range. Costs are
+// printed relative to the smallest radius, so a flat ratio means cost is independent of radius.
+void sweepRadius(KernelTuner& tuner, int width, int height, int iterations)
+{
+    const CpuStylizer::Kernel kernels[] = {CpuStylizer::Kernel::Watercolor, CpuStylizer::Kernel::OilPaint};
+
+    printf("Radius sweep at %dx%d\n", width, height);
+    printf("  %-8s", "Radius");
+    for (const auto kernel : kernels) {
+        printf(" %12s %8s", CpuStylizer::getKernelName(kernel), "ratio");
+    }
+    printf("\n");
+
+    double baseMs[2] = {};
+    for (int r = c_sweepMinRadius; r <= c_sweepMaxRadius; r++) {
+        printf("  %-8d", r);
+        for (int i = 0; i < 2; i++) {
+            CpuStylizer::Params params;
+            params.watercolorRadius = r;
+            params.oilPaintRadius = r;
+            const double ms = tuner.benchmark(kernels[i], KernelTuner::getDefaultConfig(kernels[i]), params, width, height, iterations);
+            if (r == c_sweepMinRadius) {
+                baseMs[i] = ms;
+            }
+            printf(" %9.3f ms %7.2fx", ms, baseMs[i] > 0.0 ? ms / baseMs[i] : 0.0);
+        }
+        printf("\n");
+    }
+}
+
+// Evaluate all kernel taps for each output
+struct DirectPass {
+    static const char* getName() { return "direct"; }
+
+    template <typename K, typename V, typename Layout>
+    static void run(const float* src, float*, float* dst, size_t stride, size_t planeStride, int width, int height)
+    {
+        Conv::convolveClamped<K, V, Layout>(src, stride, planeStride, dst, stride, planeStride, width, height, 0, 0, width, height);
+    }
+};
+
+// Evaluate separable kernel as row pass followed by column pass
+struct SeparablePass {
+    static const char* getName() { return "two-pass"; }
+
+    template <typename K, typename V, typename Layout>
+    static void run(const float* src, float* temp, float* dst, size_t stride, size_t planeStride, int width, int height)
+    {
+        Conv::convolveSeparable<K, V, Layout>(src, stride, planeStride, temp, dst, stride, planeStride, width, height, 0, 0, width, height);
+    }
+};
+
+// Returns median time of given function calls in milliseconds
+template <typename F>
+double timeMedianMs(int iterations, F&& func)
+{
+    func();
+    std::vector<double> times(std::max(1, iterations));
+    for (auto& time : times) {
+        const int64_t start = getTimestampNs();
+        func();
+        time = static_cast<double>(getTimestampNs() - start) * 1e-6;
+    }
+    std::sort(times.begin(), times.end());
+    return times[times.size() / 2];
+}
+
+// Hand-written scalar convolution with taps in a runtime array, as kernels were written before
+// compile time kernels. Samples outside the image are clamped to edges.
+void convolveScalar(const float* src, float* dst, int width, int height, int channels, const std::vector<float>& taps, int kernelWidth,
+    int kernelHeight, float divisor)
+{
+    const int originX = (kernelWidth - 1) / 2;
+    const int originY = (kernelHeight - 1) / 2;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            for (int c = 0; c < channels; c++) {
+                float acc = 0.0f;
+                for (int j = 0; j < kernelHeight; j++) {
+                    const int sy = std::max(0, std::min(height - 1, y + j - originY));
+                    for (int i = 0; i < kernelWidth; i++) {
+                        const int sx = std::max(0, std::min(width - 1, x + i - originX));
+                        acc += taps[j * kernelWidth + i] * src[(static_cast<size_t>(sy) * width + sx) * channels + c];
+                    }
+                }
+                dst[(static_cast<size_t>(y) * width + x) * channels + c] = acc / divisor;
+            }
+        }
+    }
+}
+
+// Time compile time kernel on each supported SIMD level against hand-written scalar loop. Runs
+// single threaded on whole image.
+template <typename K, typename Layout, typename Pass>
+void benchmarkConvolution(const char* name, int width, int height, int iterations)
+{
+    constexpr int channels = Layout::c_planes * Layout::c_pixelStep;
+    const size_t stride = static_cast<size_t>(width) * Layout::c_pixelStep;
+    const size_t planeStride = stride * height;
+    const size_t size = planeStride * Layout::c_planes;
+
+    // Deterministic noise input
+    std::vector<float> src(size);
+    std::mt19937 random(1);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    for (auto& value : src) {
+        value = dist(random);
+    }
+
+    // Reference works on interleaved pixels, which equals planar for one channel
+    static_assert(Layout::c_planes == 1, "Reference supports single plane layouts");
+    std::vector<float> taps(K::c_width * K::c_height);
+    for (size_t i = 0; i < taps.size(); i++) {
+        taps[i] = static_cast<float>(K::tap(static_cast<int>(i)));
+    }
+    std::vector<float> reference(size);
+    const double referenceMs = timeMedianMs(iterations, [&]() {
+        convolveScalar(src.data(), reference.data(), width, height, channels, taps, K::c_width, K::c_height, static_cast<float>(K::c_divisor));
+    });
+
+    const std::string label = std::string(name) + " " + std::to_string(K::c_width) + "x" + std::to_string(K::c_height) + " " + Pass::getName();
+    printf("  %-26s %3d %9.3f ms", label.c_str(), channels, referenceMs);
+
+    std::vector<float> temp(size);
+    std::vector<float> dst(size);
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2}) {
+        if (!isSimdLevelSupported(level)) {
+            printf(" %9s %8s", "-", "-");
+            continue;
+        }
+
+        double ms = 0.0;
+        auto run = [&](auto simd) {
+            using V = decltype(simd);
+            ms = timeMedianMs(iterations, [&]() { Pass::template run<K, V, Layout>(src.data(), temp.data(), dst.data(), stride, planeStride, width, height); });
+        };
+        switch (level) {
+            case SimdLevel::AVX2: run(Simd::AVX2()); break;
+            case SimdLevel::SSE41: run(Simd::SSE41()); break;
+            default: run(Simd::Scalar()); break;
+        }
+
+        float maxError = 0.0f;
+        for (size_t i = 0; i < size; i++) {
+            maxError = std::max(maxError, std::fabs(dst[i] - reference[i]));
+        }
+        printf(" %6.3f ms %7.2fx", ms, ms > 0.0 ? referenceMs / ms : 0.0);
+        if (maxError > 1e-4f) {
+            printf(" (error %g)", maxError);
+        }
+    }
+    printf("\n");
+}
+
+// Time compile time convolution kernels against hand-written scalar loops
+void benchmarkConvolutions(int width, int height, int iterations)
+{
+    printf("Convolution kernels at %dx%d, single thread\n", width, height);
+    printf("  %-26s %3s %12s", "Kernel", "Ch", "Handwritten");
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::SSE41, SimdLevel::AVX2}) {
+        printf(" %9s %8s", getSimdLevelName(level), "speedup");
+    }
+    printf("\n");
+
+    benchmarkConvolution<SobelX3, Conv::Planar<1>, DirectPass>("Sobel X", width, height, iterations);
+    benchmarkConvolution<Box3, Conv::Planar<1>, DirectPass>("Box", width, height, iterations);
+    benchmarkConvolution<Laplacian3, Conv::Planar<1>, DirectPass>("Laplacian", width, height, iterations);
+    benchmarkConvolution<Gaussian5, Conv::Planar<1>, DirectPass>("Gaussian", width, height, iterations);
+    benchmarkConvolution<Gaussian5, Conv::Planar<1>, SeparablePass>("Gaussian", width, height, iterations);
+    benchmarkConvolution<Gaussian5, Conv::Interleaved<3>, DirectPass>("Gaussian RGB", width, height, iterations);
+    benchmarkConvolution<Gaussian5, Conv::Interleaved<3>, SeparablePass>("Gaussian RGB", width, height, iterations);
+}
+
+// Compare RGB of stylized images. Returns PSNR in dB, infinite for identical images.
+double compareImages(const std::vector<uint8_t>& a, const std::vector<uint8_t>& b, int& outMaxDiff, double& outChangedPercent)
+{
+    double squaredError = 0.0;
+    size_t changed = 0;
+    outMaxDiff = 0;
+    for (size_t i = 0; i < a.size(); i += 4) {
+        bool pixelChanged = false;
+        for (size_t c = 0; c < 3; c++) {
+            const int diff = std::abs(a[i + c] - b[i + c]);
+            outMaxDiff = std::max(outMaxDiff, diff);
+            squaredError += static_cast<double>(diff) * diff;
+            pixelChanged |= (diff != 0);
+        }
+        changed += pixelChanged ? 1 : 0;
+    }
+    const size_t pixels = a.size() / 4;
+    outChangedPercent = pixels > 0 ? 100.0 * changed / pixels : 0.0;
+    const double mse = pixels > 0 ? squaredError / (3.0 * pixels) : 0.0;
+    return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : INFINITY;
+}
+
+// Time multi stage kernels in frame mode with intermediates stored as FP16 and compare output to
+// float32 intermediates. Traffic assumes each intermediate is written once and read once.
+void analyzeHalfIntermediates(KernelTuner& tuner, int width, int height, int iterations)
+{
+    using Intermediate = CpuStylizer::Intermediate;
+
+    struct Case {
+        CpuStylizer::Kernel kernel;
+        int radius;
+        std::vector<std::vector<Intermediate>> variants;
+    };
+    const std::vector<Intermediate> none;
+    const std::vector<Intermediate> planes = {Intermediate::WatercolorPlanes};
+    const std::vector<Intermediate> sums = {Intermediate::WatercolorSums};
+    const std::vector<Intermediate> boxes = {Intermediate::WatercolorBoxes};
+    const std::vector<Intermediate> all = {Intermediate::WatercolorPlanes, Intermediate::WatercolorSums, Intermediate::WatercolorBoxes};
+    const Case cases[] = {
+        {CpuStylizer::Kernel::Cartoon, 0, {none, {Intermediate::Luma}}},
+        {CpuStylizer::Kernel::Sketch, 0, {none, {Intermediate::Luma}}},
+        {CpuStylizer::Kernel::Watercolor, 4, {none, planes, sums, boxes, all}},
+        {CpuStylizer::Kernel::Watercolor, 15, {none, planes, sums, boxes, all}},
+    };
+
+    printf("FP16 intermediates at %dx%d, frame mode\n", width, height);
+    printf("  %-15s %-48s %8s %9s %8s %8s %8s %9s %8s\n", "Kernel", "FP16", "MB", "Time ms", "GB/s", "Speedup", "Max diff", "Changed %", "PSNR dB");
+
+    CpuStylizer& stylizer = tuner.getStylizer();
+    for (const auto& c : cases) {
+        KernelConfig config = KernelTuner::getDefaultConfig(c.kernel);
+        config.mode = ExecutionMode::Frame;
+        CpuStylizer::Params params = KernelTuner::getBenchmarkParams(c.kernel);
+        if (c.radius > 0) {
+            params.watercolorRadius = c.radius;
+        }
+
+        std::vector<uint8_t> reference;
+        double referenceMs = 0.0;
+        for (const auto& variant : c.variants) {
+            uint32_t mask = 0;
+            std::string names;
+            for (const auto intermediate : variant) {
+                mask |= CpuStylizer::getIntermediateMask(intermediate);
+                names += std::string(names.empty() ? "" : ",") + CpuStylizer::getIntermediateName(intermediate);
+            }
+            stylizer.setHalfIntermediates(mask);
+            const double ms = tuner.benchmark(c.kernel, config, params, width, height, iterations);
+            const double megabytes = static_cast<double>(stylizer.getIntermediateBytes()) / (1024.0 * 1024.0);
+            if (reference.empty()) {
+                reference = tuner.getOutput();
+                referenceMs = ms;
+            }
+
+            int maxDiff = 0;
+            double changedPercent = 0.0;
+            const double psnr = compareImages(reference, tuner.getOutput(), maxDiff, changedPercent);
+            const std::string label = c.radius > 0 ? std::string(CpuStylizer::getKernelName(c.kernel)) + " r=" + std::to_string(c.radius)
+                                                   : CpuStylizer::getKernelName(c.kernel);
+            printf("  %-15s %-48s %8.1f %9.3f %8.2f %7.2fx %8d %9.3f %8.1f\n", label.c_str(), names.empty() ? "none" : names.c_str(), megabytes, ms,
+                ms > 0.0 ? 2.0 * megabytes / 1024.0 / (ms * 1e-3) : 0.0, ms > 0.0 ? referenceMs / ms : 0.0, maxDiff, changedPercent, psnr);
+        }
+    }
+    stylizer.setHalfIntermediates(0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    std::string kernelNames;
+    for (int i = 0; i < static_cast<int>(CpuStylizer::Kernel::Count); i++) {
+        kernelNames += std::string(i > 0 ? ", " : "") + CpuStylizer::getKernelName(static_cast<CpuStylizer::Kernel>(i));
+    }
+
+    cxxopts::Options options("KernelTuner", "Benchmark CPU stylizer kernel configurations and store the fastest ones to a profile");
+
+    // clang-format off
+    options.add_options()
+        ("tune", "Benchmark kernels and update profile")
+        ("show", "Print profile of this machine")
+        ("all", "Print profiles of all machines in file")
+        ("clear", "Remove results of this machine before tuning")
+        ("profile", "Profile file", cxxopts::value<std::string>()->default_value(KernelProfile::c_defaultFilename))
+        ("kernels", "Comma separated kernels to tune: " + kernelNames, cxxopts::value<std::string>()->default_value(""))
+        ("resolutions", "Comma separated resolutions to tune", cxxopts::value<std::string>()->default_value(c_defaultResolutions))
+        ("iterations", "Timed runs per candidate", cxxopts::value<int>()->default_value("15"))
+        ("threads", "Worker thread count, zero for hardware concurrency minus one", cxxopts::value<int>()->default_value("0"))
+        ("exhaustive", "Test every candidate configuration instead of coordinate search")
+        ("sweep", "Time watercolor and oil paint kernels over radius range at first resolution")
+        ("convolution", "Time compile time convolution kernels against hand-written scalar loops at first resolution")
+        ("half", "Time multi stage kernels with FP16 intermediates and compare output at first resolution")
+        ("help", "Print help");
+    // clang-format on
+
+    cxxopts::ParseResult args = options.parse(argc, argv);
+    if (args.count("help") || (!args.count("tune") && !args.count("show") && !args.count("all") && !args.count("sweep") &&
+                                !args.count("convolution") && !args.count("half"))) {
+        printf("%s\n", options.help().c_str());
+        return EXIT_SUCCESS;
+    }
+
+    const std::string filename = args["profile"].as<std::string>();
+    KernelProfile profile;
+    profile.load(filename);
+
+    if (args.count("tune")) {
+        KernelTuner::Options tuneOptions;
+        tuneOptions.iterations = args["iterations"].as<int>();
+        tuneOptions.exhaustive = args.count("exhaustive") > 0;
+        if (!parseKernels(args["kernels"].as<std::string>(), tuneOptions.kernels) ||
+            !parseResolutions(args["resolutions"].as<std::string>(), tuneOptions.resolutions)) {
+            return EXIT_FAILURE;
+        }
+
+        if (args.count("clear")) {
+            profile.clear();
+        }
+
+        KernelTuner tuner(args["threads"].as<int>());
+        if (!tuner.tune(tuneOptions, profile) || !profile.save(filename)) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (args.count("sweep")) {
+        std::vector<std::pair<int, int>> resolutions;
+        if (!parseResolutions(args["resolutions"].as<std::string>(), resolutions) || resolutions.empty()) {
+            return EXIT_FAILURE;
+        }
+        KernelTuner tuner(args["threads"].as<int>());
+        sweepRadius(tuner, resolutions.front().first, resolutions.front().second, args["iterations"].as<int>());
+    }
+
+    if (args.count("convolution")) {
+        std::vector<std::pair<int, int>> resolutions;
+        if (!parseResolutions(args["resolutions"].as<std::string>(), resolutions) || resolutions.empty()) {
+            return EXIT_FAILURE;
+        }
+        benchmarkConvolutions(resolutions.front().first, resolutions.front().second, args["iterations"].as<int>());
+    }
+
+    if (args.count("half")) {
+        std::vector<std::pair<int, int>> resolutions;
+        if (!parseResolutions(args["resolutions"].as<std::string>(), resolutions) || resolutions.empty()) {
+            return EXIT_FAILURE;
+        }
+        KernelTuner tuner(args["threads"].as<int>());
+        analyzeHalfIntermediates(tuner, resolutions.front().first, resolutions.front().second, args["iterations"].as<int>());
+    }
+
+    if (args.count("all")) {
+        for (const auto& machine : profile.getMachines()) {
+            printMachine(machine.first, machine.second);
+        }
+    } else if (args.count("show") || args.count("tune")) {
+        const auto it = profile.getMachines().find(profile.getMachineKey());
+        if (it == profile.getMachines().end()) {
+            printf("No kernel profile for this machine: %s\n", profile.getMachineKey().c_str());
+        } else {
+            printMachine(it->first, it->second);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,109 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include <cstdio>
+#include <string>
+#include <fstream>
+#include <cxxopts.hpp>
+
+#include "Globals.hpp"
+#include "ThreadPool.hpp"
+#include "SpectatorReceiver.hpp"
+
+// VarjoExamples namespace contains simple example wrappers for using Varjo API features.
+// These are only meant to be used in SDK example applications. In your own application,
+// use your own production quality integration layer.
+using namespace VarjoExamples;
+
+namespace
+{
+// Statistics print interval
+constexpr int c_printIntervalMs = 1000;
+
+// Save view image as binary PPM file
+bool savePPM(const std::string& filename, const SpectatorReceiver::View& view)
+{
+    std::ofstream outFile(filename, std::ofstream::binary);
+    if (!outFile.good()) {
+        LOGE("Opening file for writing failed: %s", filename.c_str());
+        return false;
+    }
+
+    outFile << "P6\n" << view.width << " " << view.height << "\n255\n";
+    std::vector<uint8_t> line(view.width * 3);
+    for (int y = 0; y < view.height; y++) {
+        const uint8_t* src = view.rgba.data() + static_cast<size_t>(view.width) * 4 * y;
+        for (int x = 0; x < view.width; x++) {
+            line[x * 3 + 0] = src[x * 4 + 0];
+            line[x * 3 + 1] = src[x * 4 + 1];
+            line[x * 3 + 2] = src[x * 4 + 2];
+        }
+        outFile.write(reinterpret_cast<const char*>(line.data()), line.size());
+    }
+
+    if (!outFile.good()) {
+        LOGE("Writing image file failed: %s", filename.c_str());
+        return false;
+    }
+
+    LOGI("File saved succesfully: %s", filename.c_str());
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    cxxopts::Options options("SpectatorClient", "Reference client for VideoPostProcess spectator stream");
+
+    // clang-format off
+    options.add_options()
+        ("host", "Server address", cxxopts::value<std::string>()->default_value("127.0.0.1"))
+        ("port", "Server port", cxxopts::value<int>()->default_value(std::to_string(SpectatorProtocol::c_defaultPort)))
+        ("udp", "Use UDP transport instead of TCP")
+        ("time", "Run time in seconds, zero runs until disconnected", cxxopts::value<int>()->default_value("0"))
+        ("save", "Save received views as PPM files with given prefix on exit", cxxopts::value<std::string>())
+        ("help", "Print help");
+    // clang-format on
+
+    cxxopts::ParseResult args = options.parse(argc, argv);
+    if (args.count("help")) {
+        printf("%s\n", options.help().c_str());
+        return EXIT_SUCCESS;
+    }
+
+    SpectatorReceiver::Config config;
+    config.host = args["host"].as<std::string>();
+    config.port = static_cast<uint16_t>(args["port"].as<int>());
+    config.transport = args.count("udp") ? SpectatorProtocol::Transport::UDP : SpectatorProtocol::Transport::TCP;
+    const int runTimeMs = args["time"].as<int>() * 1000;
+
+    ThreadPool threadPool;
+    SpectatorReceiver receiver(threadPool, config);
+    if (!receiver.isConnected()) {
+        LOGE("Connecting to spectator server failed.");
+        return EXIT_FAILURE;
+    }
+
+    // Receive until disconnected or out of time
+    int elapsedMs = 0;
+    while (runTimeMs <= 0 || elapsedMs < runTimeMs) {
+        if (!receiver.receive(c_printIntervalMs)) {
+            break;
+        }
+        elapsedMs += c_printIntervalMs;
+
+        const auto& stats = receiver.getStats();
+        LOGI("Frames: %lld, bandwidth: %.2f Mbps, latency: %.2f ms (max %.2f ms), decode: %.3f ms, lost packets: %lld, corrupt tiles: %lld",
+            stats.frames, stats.bandwidthMbps, stats.latencyAvgMs, stats.latencyMaxMs, stats.decodeTimeAvgMs, stats.lostPackets, stats.corruptTiles);
+    }
+
+    if (args.count("save")) {
+        const std::string prefix = args["save"].as<std::string>();
+        for (int i = 0; i < receiver.getViewCount(); i++) {
+            savePPM(prefix + "_view" + std::to_string(i) + ".ppm", receiver.getView(i));
+        }
+    }
+
+    LOGI("Done!");
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,279 @@
+// Copyright 2020 Varjo Technologies Oy. All rights reserved.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <string>
+#include <sstream>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <cxxopts.hpp>
+
+#include "Globals.hpp"
+#include "TelemetryStore.hpp"
+
+// VarjoExamples namespace contains simple example wrappers for using Varjo API features.
+// These are only meant to be used in SDK example applications. In your own application,
+// use your own production quality integration layer.
+using namespace VarjoExamples;
+
+namespace
+{
+// Split comma separated list
+std::vector<std::string> splitList(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::stringstream ss(list);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+// Parse column names, all columns if list is empty
+bool parseColumns(const TelemetryReader& reader, const std::string& list, std::vector<int>& outColumns)
+{
+    if (list.empty()) {
+        for (int i = 0; i < static_cast<int>(reader.getColumns().size()); i++) {
+            outColumns.push_back(i);
+        }
+        return true;
+    }
+    for (const auto& name : splitList(list)) {
+        const int column = reader.findColumn(name);
+        if (column < 0) {
+            LOGE("Unknown column: %s", name.c_str());
+            return false;
+        }
+        outColumns.push_back(column);
+    }
+    return true;
+}
+
+// Read column of either type as doubles
+bool readValues(const TelemetryReader& reader, int column, std::vector<double>& outValues)
+{
+    if (reader.getColumns()[column].type == TelemetryStore::ColumnType::Float) {
+        return reader.readFloats(column, outValues);
+    }
+    std::vector<int64_t> ints;
+    if (!reader.readInts(column, ints)) {
+        return false;
+    }
+    outValues.assign(ints.begin(), ints.end());
+    return true;
+}
+
+// Returns row order sorted by column, file order if column is negative. Sort is stable, so rows
+// of the same value keep file order.
+bool getRowOrder(const TelemetryReader& reader, int sortColumn, std::vector<size_t>& outOrder)
+{
+    outOrder.resize(static_cast<size_t>(reader.getRowCount()));
+    std::iota(outOrder.begin(), outOrder.end(), size_t(0));
+    if (sortColumn < 0) {
+        return true;
+    }
+    std::vector<double> keys;
+    if (!readValues(reader, sortColumn, keys)) {
+        return false;
+    }
+    std::stable_sort(outOrder.begin(), outOrder.end(), [&keys](size_t a, size_t b) { return keys[a] < keys[b]; });
+    return true;
+}
+
+// Print columns, compressed sizes and row count
+void printInfo(const TelemetryReader& reader)
+{
+    const int64_t rows = reader.getRowCount();
+    printf("Rows: %lld in %d blocks, file %.1f kB, %.2f bytes/row\n", static_cast<long long>(rows), reader.getBlockCount(),
+        reader.getFileSize() / 1024.0, rows > 0 ? static_cast<double>(reader.getFileSize()) / rows : 0.0);
+    printf("%-28s %-6s %12s %10s\n", "Column", "Type", "Bytes", "Bits/row");
+    for (int i = 0; i < static_cast<int>(reader.getColumns().size()); i++) {
+        const auto& column = reader.getColumns()[i];
+        const int64_t bytes = reader.getColumnBytes(i);
+        printf("%-28s %-6s %12lld %10.2f\n", column.name.c_str(), column.type == TelemetryStore::ColumnType::Float ? "float" : "int",
+            static_cast<long long>(bytes), rows > 0 ? bytes * 8.0 / rows : 0.0);
+    }
+}
+
+// Write columns as CSV in given row order, to stdout if filename is "-"
+bool exportCsv(const TelemetryReader& reader, const std::vector<int>& columns, const std::vector<size_t>& order, const std::string& filename)
+{
+    // Integer columns are printed exactly, floats with enough digits to round trip
+    std::vector<std::vector<int64_t>> ints(columns.size());
+    std::vector<std::vector<double>> floats(columns.size());
+    for (size_t i = 0; i < columns.size(); i++) {
+        const bool isFloat = reader.getColumns()[columns[i]].type == TelemetryStore::ColumnType::Float;
+        if (isFloat ? !reader.readFloats(columns[i], floats[i]) : !reader.readInts(columns[i], ints[i])) {
+            return false;
+        }
+    }
+
+    FILE* file = (filename == "-") ? stdout : fopen(filename.c_str(), "w");
+    if (!file) {
+        LOGE("Opening export file failed: %s", filename.c_str());
+        return false;
+    }
+    for (size_t i = 0; i < columns.size(); i++) {
+        fprintf(file, "%s%s", i ? "," : "", reader.getColumns()[columns[i]].name.c_str());
+    }
+    fprintf(file, "\n");
+    for (size_t row : order) {
+        for (size_t i = 0; i < columns.size(); i++) {
+            if (ints[i].empty()) {
+                fprintf(file, "%s%.17g", i ? "," : "", floats[i][row]);
+            } else {
+                fprintf(file, "%s%lld", i ? "," : "", static_cast<long long>(ints[i][row]));
+            }
+        }
+        fprintf(file, "\n");
+    }
+    if (file != stdout) {
+        fclose(file);
+    }
+    return true;
+}
+
+// Print count, minimum, maximum, mean and standard deviation of columns
+bool printStats(const TelemetryReader& reader, const std::vector<int>& columns)
+{
+    printf("%-28s %14s %14s %14s %14s\n", "Column", "Min", "Max", "Mean", "Stddev");
+    std::vector<double> values;
+    for (int column : columns) {
+        if (!readValues(reader, column, values)) {
+            return false;
+        }
+        double minValue = values.empty() ? 0.0 : values[0];
+        double maxValue = minValue;
+        double sum = 0.0;
+        for (double v : values) {
+            minValue = std::min(minValue, v);
+            maxValue = std::max(maxValue, v);
+            sum += v;
+        }
+        const double mean = values.empty() ? 0.0 : sum / values.size();
+        double variance = 0.0;
+        for (double v : values) {
+            variance += (v - mean) * (v - mean);
+        }
+        variance = values.empty() ? 0.0 : variance / values.size();
+        printf("%-28s %14.6g %14.6g %14.6g %14.6g\n", reader.getColumns()[column].name.c_str(), minValue, maxValue, mean, std::sqrt(variance));
+    }
+    return true;
+}
+
+// Print Pearson correlation of two columns in given row order. With delta, correlates changes from
+// previous row instead, e.g. exposure changes against capture intervals.
+bool printCorrelation(const TelemetryReader& reader, int columnA, int columnB, const std::vector<size_t>& order, bool delta)
+{
+    std::vector<double> a;
+    std::vector<double> b;
+    if (!readValues(reader, columnA, a) || !readValues(reader, columnB, b)) {
+        return false;
+    }
+
+    double sumA = 0.0, sumB = 0.0, sumAA = 0.0, sumBB = 0.0, sumAB = 0.0;
+    size_t n = 0;
+    for (size_t i = delta ? 1 : 0; i < order.size(); i++) {
+        const double x = delta ? a[order[i]] - a[order[i - 1]] : a[order[i]];
+        const double y = delta ? b[order[i]] - b[order[i - 1]] : b[order[i]];
+        sumA += x;
+        sumB += y;
+        sumAA += x * x;
+        sumBB += y * y;
+        sumAB += x * y;
+        n++;
+    }
+    if (n < 2) {
+        LOGE("Not enough rows for correlation.");
+        return false;
+    }
+
+    const double covariance = sumAB - sumA * sumB / n;
+    const double varianceA = sumAA - sumA * sumA / n;
+    const double varianceB = sumBB - sumB * sumB / n;
+    const double r = (varianceA > 0.0 && varianceB > 0.0) ? covariance / std::sqrt(varianceA * varianceB) : 0.0;
+    printf("Correlation%s of %s and %s over %zu rows: %.4f\n", delta ? " of changes" : "", reader.getColumns()[columnA].name.c_str(),
+        reader.getColumns()[columnB].name.c_str(), n, r);
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv)
+{
+    cxxopts::Options options("TelemetryTool", "Query and export columnar per-frame telemetry files");
+
+    // clang-format off
+    options.add_options()
+        ("file", "Telemetry file", cxxopts::value<std::string>())
+        ("info", "Print columns and compressed sizes")
+        ("columns", "Comma separated columns for export and statistics, all if empty", cxxopts::value<std::string>()->default_value(""))
+        ("sort", "Sort rows by column before export and correlation", cxxopts::value<std::string>()->default_value(""))
+        ("export", "Export columns as CSV to given file, - for stdout", cxxopts::value<std::string>()->default_value(""))
+        ("stats", "Print statistics of columns")
+        ("correlate", "Print correlation of two comma separated columns", cxxopts::value<std::string>()->default_value(""))
+        ("delta", "Correlate changes from previous row instead of values")
+        ("help", "Print help");
+    // clang-format on
+
+    options.parse_positional({"file"});
+    cxxopts::ParseResult args = options.parse(argc, argv);
+    if (args.count("help") || !args.count("file")) {
+        printf("%s\n", options.help().c_str());
+        return args.count("help") ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+    LOG_INIT(nullptr, LogLevel::Warning);
+
+    TelemetryReader reader;
+    if (!reader.open(args["file"].as<std::string>())) {
+        return EXIT_FAILURE;
+    }
+
+    std::vector<int> columns;
+    if (!parseColumns(reader, args["columns"].as<std::string>(), columns)) {
+        return EXIT_FAILURE;
+    }
+
+    const std::string sortName = args["sort"].as<std::string>();
+    const int sortColumn = sortName.empty() ? -1 : reader.findColumn(sortName);
+    std::vector<size_t> order;
+    if (!sortName.empty() && sortColumn < 0) {
+        LOGE("Unknown column: %s", sortName.c_str());
+        return EXIT_FAILURE;
+    }
+    if (!getRowOrder(reader, sortColumn, order)) {
+        return EXIT_FAILURE;
+    }
+
+    const std::string exportFile = args["export"].as<std::string>();
+    const std::vector<std::string> correlate = splitList(args["correlate"].as<std::string>());
+    const bool info = args.count("info") || (exportFile.empty() && correlate.empty() && !args.count("stats"));
+    if (info) {
+        printInfo(reader);
+    }
+    if (args.count("stats") && !printStats(reader, columns)) {
+        return EXIT_FAILURE;
+    }
+    if (!correlate.empty()) {
+        const int columnA = reader.findColumn(correlate[0]);
+        const int columnB = correlate.size() == 2 ? reader.findColumn(correlate[1]) : -1;
+        if (columnA < 0 || columnB < 0) {
+            LOGE("Correlation needs two known columns: %s", args["correlate"].as<std::string>().c_str());
+            return EXIT_FAILURE;
+        }
+        if (!printCorrelation(reader, columnA, columnB, order, args.count("delta") > 0)) {
+            return EXIT_FAILURE;
+        }
+    }
+    if (!exportFile.empty() && !exportCsv(reader, columns, order, exportFile)) {
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
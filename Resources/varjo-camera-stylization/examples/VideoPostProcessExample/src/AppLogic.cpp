@@ -8,6 +8,7 @@
 
 #include <Varjo.h>
 #include <Varjo_events.h>
+#include <Varjo_experimental.h>
 #include <Varjo_mr.h>
 #include <Varjo_mr_experimental.h>
 #include <Varjo_gl.h>
@@ -33,12 +34,52 @@ namespace
 // The default value is 0, so we go way less than that.
 constexpr int32_t c_appOrderBg = -1000;
 
+// Memory budgets in tag order. Replay ring takes most of the stream budget when enabled.
+const MemoryBudget::Budget c_memoryBudgets[MemoryAccounting::c_tagCount] = {
+    {int64_t(640) << 20, MemoryBudget::Policy::Warn},  // Stream
+    {int64_t(16) << 20, MemoryBudget::Policy::Shed},   // Cubemap
+    {int64_t(64) << 20, MemoryBudget::Policy::Shed},   // Stylization
+    {int64_t(256) << 20, MemoryBudget::Policy::Warn},  // Renderer
+    {int64_t(8) << 20, MemoryBudget::Policy::Warn},    // UI
+    {int64_t(32) << 20, MemoryBudget::Policy::Warn},   // Markers
+};
+
+// Convert post process state to CPU stylizer params the same way shader constants are set
+CpuStylizer::Params getStylizerParams(const AppState::PostProcess& state)
+{
+    CpuStylizer::Params params;
+    if (state.enabled) {
+        params.clusterSize = state.cartoonEnabled ? state.clusterSize : 0;
+        params.outlineIntensity = state.cartoonEnabled ? state.outlineIntensity : 0.0f;
+        params.watercolorRadius = state.watercolorEnabled ? state.watercolorRadius : 0;
+        params.sketchIntensity = state.sketchEnabled ? state.sketchIntensity : 0.0f;
+        params.pointilismStep = state.pointilismEnabled ? state.pointilismStep : 0.0f;
+        params.pointilismThreshold = state.pointilismEnabled ? state.pointilismThreshold : 0.0f;
+        params.oilPaintRadius = state.oilPaintEnabled ? state.oilPaintRadius : 0;
+    }
+    return params;
+}
+
 }  // namespace
 
 //---------------------------------------------------------------------------
 
 AppLogic::~AppLogic()
 {
+    // Stop data streams before freeing their consumers
+    m_dataStreamer.reset();
+    m_spectator.reset();
+    m_replay.reset();
+    m_shadingRateMap.reset();
+
+    // Stop background kernel tuning
+    if (m_kernelTuner) {
+        m_kernelTuner->cancel();
+    }
+    if (m_kernelTunerThread.joinable()) {
+        m_kernelTunerThread.join();
+    }
+
     // Free post processor
     m_postProcess.reset();
 
@@ -78,6 +119,29 @@ bool AppLogic::init(GfxContext& context)
     // Create video post process instance
     m_postProcess = std::make_unique<PostProcess>(m_session);
 
+    // Create worker threads and data streamer for CPU side frame consumers
+    m_threadPool = std::make_unique<ThreadPool>();
+    m_dataStreamer = std::make_unique<DataStreamer>(m_session);
+
+    // Headless application renders nothing and stays behind other applications on purpose, so only
+    // headset standby suspends it
+    PowerStateMachine::Config powerConfig;
+#if (USE_HEADLESS_MODE)
+    powerConfig.suspendReasons = PowerStateMachine::getMask(PowerStateMachine::Reason::Standby);
+#endif
+    m_power = std::make_unique<PowerStateMachine>(powerConfig);
+
+    // Register metrics shown in performance panel
+    addMetrics();
+
+    // Create CPU stylizer using kernel configurations tuned for this machine
+    m_stylizer = std::make_unique<CpuStylizer>(*m_threadPool);
+    m_kernelProfile.load(KernelProfile::c_defaultFilename);
+    m_stylizer->setProfile(m_kernelProfile);
+
+    // Budget memory of subsystems created above
+    initMemoryBudgets();
+
     // NOTICE! In this example we always do VR scene rendering using the D3D11 graphics API.
     //
     // Still, we want to showcase video-see-through post processing API with D3D11, OpenGL and
@@ -167,6 +231,12 @@ void AppLogic::setState(const AppState& state, bool force)
     const auto prevState = m_appState;
     m_appState = state;
 
+    // Pass effect parameters to CPU stylizer running on data stream thread
+    {
+        std::lock_guard<std::mutex> lock(m_stylizerMutex);
+        m_stylizerParams = getStylizerParams(m_appState.postProcess);
+    }
+
     // Check for mixed reality availability
     if (!m_appState.general.mrAvailable) {
         // Toggle post process off
@@ -208,12 +278,32 @@ void AppLogic::setState(const AppState& state, bool force)
         setVSTRendering(state.general.vstEnabled);
     }
 
+    // Spectator stream
+    if (force || state.general.spectatorEnabled != prevState.general.spectatorEnabled) {
+        setSpectatorEnabled(state.general.spectatorEnabled);
+    }
+
+    // Instant replay buffer
+    if (force || state.general.replayEnabled != prevState.general.replayEnabled) {
+        setReplayEnabled(state.general.replayEnabled);
+    }
+
+    // Metrics endpoint
+    if (force || state.general.metricsServerEnabled != prevState.general.metricsServerEnabled) {
+        setMetricsServerEnabled(state.general.metricsServerEnabled);
+    }
+
     // Render VR scene
 #if (!USE_HEADLESS_MODE)
     if (force || state.general.vrEnabled != prevState.general.vrEnabled) {
         LOGI("Render VR scene: %s", state.general.vrEnabled ? "ON" : "OFF");
         m_appState.general.vrEnabled = state.general.vrEnabled;
     }
+
+    // Dynamic foveation and shading rate maps
+    if (force || state.general.foveationEnabled != prevState.general.foveationEnabled) {
+        setFoveationEnabled(state.general.foveationEnabled);
+    }
 #endif
 }
 
@@ -337,6 +427,7 @@ void AppLogic::updatePostProcessing()
         if (m_postProcess->lockTextureBuffer(textureIndex, varjoTexture)) {
             try {
                 // Update texture
+                MetricsRegistry::ScopedTimer timer(m_metrics, m_metricIds.textureUpdate);
                 m_texture->update(varjoTexture, m_appState.postProcess.textureGeneratedOnGPU);
             } catch (const std::runtime_error&) {
                 LOGE("Updating texture failed.");
@@ -354,13 +445,366 @@ void AppLogic::updatePostProcessing()
     m_postProcess->applyInputBuffers(reinterpret_cast<char*>(&cBuffer), sizeof(cBuffer), updatedTextures);
 }
 
+void AppLogic::setSpectatorEnabled(bool enabled)
+{
+    const varjo_StreamType streamType = varjo_StreamType_DistortedColor;
+
+    if (enabled && !m_spectator) {
+        if (m_dataStreamer->getFormat(streamType) == varjo_TextureFormat_INVALID) {
+            LOGE("Spectator stream: no color stream available.");
+            m_appState.general.spectatorEnabled = false;
+            return;
+        }
+
+        m_spectator = std::make_unique<SpectatorServer>(*m_threadPool, SpectatorServer::Config());
+        if (!m_spectator->isRunning()) {
+            m_spectator.reset();
+            m_appState.general.spectatorEnabled = false;
+            return;
+        }
+
+        // NOTICE! Post processed output only exists inside the compositor, so spectator frames are
+        // stylized with the CPU implementation of the same effects. Frames are converted, stylized
+        // and encoded on the data stream thread.
+        m_spectatorListener = m_dataStreamer->addFrameListener([this](const DataStreamer::Frame& frame) {
+            if (frame.type != varjo_StreamType_DistortedColor) {
+                return;
+            }
+            MetricsRegistry::ScopedTimer timer(m_metrics, m_metricIds.spectatorFrame);
+            if (!m_stylizer->convert(frame.buffer, frame.cpuData, m_spectatorImage) &&
+                !DataStreamer::convertToRGBA(frame.buffer, frame.cpuData, m_spectatorImage)) {
+                return;
+            }
+
+            const int width = frame.buffer.width;
+            const int height = frame.buffer.height;
+            const size_t stride = static_cast<size_t>(width) * 4;
+            startKernelTuning(width, height);
+
+            CpuStylizer::Params params;
+            {
+                std::lock_guard<std::mutex> lock(m_stylizerMutex);
+                params = m_stylizerParams;
+            }
+
+            const uint8_t* image = m_spectatorImage.data();
+            m_spectatorStylized.resize(m_spectatorImage.size());
+            if (m_stylizer->stylize(image, stride, m_spectatorStylized.data(), stride, width, height, params)) {
+                image = m_spectatorStylized.data();
+            }
+
+            m_spectator->submitFrame(static_cast<int>(frame.channelIndex), frame.frameNumber, getTimestampNs(), width, height, stride, image);
+            m_spectatorMemory.set(m_spectatorImage.capacity() + m_spectatorStylized.capacity());
+        });
+        updateColorStream();
+
+    } else if (!enabled && m_spectator) {
+        m_dataStreamer->removeFrameListener(m_spectatorListener);
+        m_spectatorListener = -1;
+        m_spectator.reset();
+        updateColorStream();
+    }
+
+    LOGI("Spectator stream: %s", m_spectator ? "ON" : "OFF");
+    m_appState.general.spectatorEnabled = (m_spectator != nullptr);
+}
+
+void AppLogic::setReplayEnabled(bool enabled)
+{
+    if (enabled && !m_replay) {
+        if (m_dataStreamer->getFormat(varjo_StreamType_DistortedColor) == varjo_TextureFormat_INVALID) {
+            LOGE("Instant replay: no color stream available.");
+            m_appState.general.replayEnabled = false;
+            return;
+        }
+
+        // Frames are copied on the data stream thread and compressed on replay buffer worker thread
+        m_replay = std::make_unique<ReplayBuffer>(*m_threadPool, ReplayBuffer::Config());
+        m_replayListener = m_dataStreamer->addFrameListener([this](const DataStreamer::Frame& frame) {
+            MetricsRegistry::ScopedTimer timer(m_metrics, m_metricIds.replayFrame);
+            m_replay->submitFrame(frame);
+        });
+        updateColorStream();
+
+    } else if (!enabled && m_replay) {
+        m_dataStreamer->removeFrameListener(m_replayListener);
+        m_replayListener = -1;
+        m_replay.reset();
+        updateColorStream();
+    }
+
+    LOGI("Instant replay: %s", m_replay ? "ON" : "OFF");
+    m_appState.general.replayEnabled = (m_replay != nullptr);
+}
+
+void AppLogic::setMetricsServerEnabled(bool enabled)
+{
+    if (enabled && !m_metricsServer) {
+        m_metricsServer = std::make_unique<MetricsServer>(m_metrics, MetricsServer::Config());
+        if (!m_metricsServer->isRunning()) {
+            m_metricsServer.reset();
+        }
+    } else if (!enabled && m_metricsServer) {
+        m_metricsServer.reset();
+    }
+
+    LOGI("Metrics endpoint: %s", m_metricsServer ? "ON" : "OFF");
+    m_appState.general.metricsServerEnabled = (m_metricsServer != nullptr);
+}
+
+#if (!USE_HEADLESS_MODE)
+
+void AppLogic::setFoveationEnabled(bool enabled)
+{
+    if (enabled && !m_shadingRateMap) {
+        if (!m_gazeInitialized) {
+            varjo_GazeInit(m_session);
+            m_gazeInitialized = CHECK_VARJO_ERR(m_session) == varjo_NoError;
+        }
+
+        // Runtime foveates its rendering around gaze and reports foveation status with events
+        varjo_SetFoveationMode(m_session, varjo_FoveationMode_DynamicFocus, varjo_True);
+        if (CHECK_VARJO_ERR(m_session) != varjo_NoError) {
+            LOGE("Enabling dynamic foveation failed.");
+            m_appState.general.foveationEnabled = false;
+            return;
+        }
+
+        // NOTICE! VR scene is rendered with D3D11, which has no shading rate image. D3D12 renderers can
+        // upload these maps as such, or let varjo_D3D12UpdateVariableRateShadingTexture compute a gaze
+        // and occlusion map on GPU. Here the maps are generated to show their cost and coverage.
+        const int viewCount = m_varjoView->getViewCount();
+        m_shadingRateMap = std::make_unique<ShadingRateMap>(ShadingRateMap::Config(), viewCount);
+        m_gazeNdc.assign(viewCount, glm::vec2(0.0f));
+        for (int i = 0; i < viewCount; i++) {
+            const varjo_Viewport& viewport = m_varjoView->getFullViewport(i);
+            m_shadingRateMap->setViewSize(i, viewport.width, viewport.height);
+
+            varjo_Mesh2Df* mesh = varjo_CreateOcclusionMesh(m_session, i, varjo_WindingOrder_CounterClockwise);
+            CHECK_VARJO_ERR(m_session);
+            m_shadingRateMap->setOcclusionMesh(i, mesh);
+            varjo_FreeOcclusionMesh(mesh);
+        }
+
+        // Content detail comes from left camera luma. Luma plane comes first in YUV formats.
+        m_shadingRateListener = m_dataStreamer->addFrameListener([this](const DataStreamer::Frame& frame) {
+            const bool hasLuma = frame.buffer.format == varjo_TextureFormat_YUV422 || frame.buffer.format == varjo_TextureFormat_NV12;
+            if (frame.type == varjo_StreamType_DistortedColor && frame.channelIndex == varjo_ChannelIndex_Left && hasLuma) {
+                m_shadingRateMap->updateEdges(static_cast<const uint8_t*>(frame.cpuData), frame.buffer.width, frame.buffer.height,
+                    frame.buffer.rowStride, frame.frameNumber);
+            }
+        });
+        updateColorStream();
+
+    } else if (!enabled && m_shadingRateMap) {
+        m_dataStreamer->removeFrameListener(m_shadingRateListener);
+        m_shadingRateListener = -1;
+        m_shadingRateMap.reset();
+        updateColorStream();
+
+        varjo_SetFoveationMode(m_session, varjo_FoveationMode_DynamicFocus, varjo_False);
+        CHECK_VARJO_ERR(m_session);
+    }
+
+    LOGI("Dynamic foveation: %s", m_shadingRateMap ? "ON" : "OFF");
+    m_appState.general.foveationEnabled = (m_shadingRateMap != nullptr);
+}
+
+void AppLogic::updateShadingRate()
+{
+    // Without valid gaze views fall back to fixed foveation at view center
+    varjo_Gaze gaze{};
+    if (m_gazeInitialized && varjo_IsGazeAllowed(m_session)) {
+        gaze = varjo_GetGaze(m_session);
+        CHECK_VARJO_ERR(m_session);
+    }
+    for (int i = 0; i < m_shadingRateMap->getViewCount(); i++) {
+        if (!ShadingRateMap::projectGaze(gaze, m_varjoView->getProjectionMatrix(i), m_gazeNdc[i])) {
+            m_gazeNdc[i] = glm::vec2(0.0f);
+        }
+    }
+    m_shadingRateMap->generate(m_gazeNdc);
+}
+
+#endif
+
+bool AppLogic::updateColorStream()
+{
+    const varjo_StreamType streamType = varjo_StreamType_DistortedColor;
+    const varjo_TextureFormat streamFormat = m_dataStreamer->getFormat(streamType);
+    if (streamFormat == varjo_TextureFormat_INVALID) {
+        return false;
+    }
+
+    const bool needed = (m_spectator || m_replay || m_shadingRateMap) && !m_power->isStreamPaused();
+    const bool streaming = m_dataStreamer->isStreaming(streamType, streamFormat);
+    if (needed && !streaming) {
+        m_dataStreamer->startDataStream(streamType, streamFormat, varjo_ChannelFlag_Left | varjo_ChannelFlag_Right);
+    } else if (!needed && streaming) {
+        m_dataStreamer->stopDataStream(streamType, streamFormat);
+    }
+    return true;
+}
+
+void AppLogic::startKernelTuning(int width, int height)
+{
+    // Tune only once per run, and only if some kernel has no results for this resolution
+    if (m_kernelTuner) {
+        return;
+    }
+
+    bool tuned = true;
+    for (int i = 0; i < static_cast<int>(CpuStylizer::Kernel::Count); i++) {
+        tuned = tuned && m_kernelProfile.hasEntry(CpuStylizer::getKernelName(static_cast<CpuStylizer::Kernel>(i)), width, height);
+    }
+    if (tuned) {
+        return;
+    }
+
+    LOGI("Tuning CPU kernels for %dx%d in background. Run KernelTuner for more accurate results.", width, height);
+    m_kernelTuner = std::make_unique<KernelTuner>();
+    m_kernelTunerThread = std::thread([this, width, height]() {
+        KernelProfile profile = m_kernelProfile;
+        KernelTuner::Options options;
+        options.resolutions = {{width, height}};
+        options.skipExisting = true;
+        if (m_kernelTuner->tune(options, profile)) {
+            profile.save(KernelProfile::c_defaultFilename);
+            m_stylizer->setProfile(profile);
+        }
+    });
+}
+
+bool AppLogic::getSpectatorStats(SpectatorServer::Stats& stats) const
+{
+    if (!m_spectator) {
+        return false;
+    }
+    stats = m_spectator->getStats();
+    return true;
+}
+
+bool AppLogic::dumpReplay(double seconds)
+{
+    if (!m_replay) {
+        return false;
+    }
+
+    // Timestamped file name so that consecutive dumps do not overwrite each other
+    char filename[64];
+    snprintf(filename, sizeof(filename), "replay_%lld.vfr", static_cast<long long>(getTimestampNs() / 1000000));
+    return m_replay->dump(filename, seconds);
+}
+
+bool AppLogic::getMetricsServerStats(MetricsServer::Stats& stats) const
+{
+    if (!m_metricsServer) {
+        return false;
+    }
+    stats = m_metricsServer->getStats();
+    return true;
+}
+
+bool AppLogic::getReplayStats(ReplayBuffer::Stats& stats) const
+{
+    if (!m_replay) {
+        return false;
+    }
+    stats = m_replay->getStats();
+    return true;
+}
+
+bool AppLogic::getShadingRateStats(ShadingRateMap::Stats& stats) const
+{
+    if (!m_shadingRateMap) {
+        return false;
+    }
+    stats = m_shadingRateMap->getStats();
+    return true;
+}
+
+void AppLogic::addMetrics()
+{
+    using Kind = MetricsRegistry::Kind;
+
+    m_metricIds.events = m_metrics.addMetric("Frame: events", Kind::Timer);
+    m_metricIds.sync = m_metrics.addMetric("Frame: sync", Kind::Timer);
+    m_metricIds.scene = m_metrics.addMetric("Frame: scene", Kind::Timer);
+    m_metricIds.render = m_metrics.addMetric("Frame: render", Kind::Timer);
+    m_metricIds.postProcess = m_metrics.addMetric("Frame: post process", Kind::Timer);
+    m_metricIds.textureUpdate = m_metrics.addMetric("Texture update", Kind::Timer);
+    m_metricIds.shadingRate = m_metrics.addMetric("Frame: shading rate", Kind::Timer);
+    m_metricIds.streamLatency = m_metrics.addMetric("Stream: latency", Kind::Timer);
+    m_metricIds.spectatorFrame = m_metrics.addMetric("Stream: spectator callback", Kind::Timer);
+    m_metricIds.replayFrame = m_metrics.addMetric("Stream: replay callback", Kind::Timer);
+    m_metricIds.workerQueue = m_metrics.addMetric("Queue: worker tasks", Kind::Gauge);
+    m_metricIds.spectatorDropped = m_metrics.addMetric("Dropped: spectator", Kind::Counter);
+    m_metricIds.replayDropped = m_metrics.addMetric("Dropped: replay", Kind::Counter);
+
+    // Subsystems update their own metrics
+    m_dataStreamer->setMetrics(&m_metrics);
+    m_postProcess->setMetrics(&m_metrics);
+    m_power->setMetrics(&m_metrics);
+
+    // Latency from end of exposure to stream callback. Listener is registered first, so it runs
+    // before the consumers.
+    m_metricsListener = m_dataStreamer->addFrameListener([this](const DataStreamer::Frame& frame) {
+        if (frame.type == varjo_StreamType_DistortedColor) {
+            m_metrics.recordTime(m_metricIds.streamLatency, varjo_GetCurrentTime(m_session) - frame.metadata.distortedColor.timestamp);
+        }
+    });
+}
+
+void AppLogic::initMemoryBudgets()
+{
+    for (int i = 0; i < MemoryAccounting::c_tagCount; i++) {
+        m_memoryBudget.setBudget(static_cast<MemoryTag>(i), c_memoryBudgets[i]);
+    }
+
+    // Cubemap copy is only needed for lighting, next cubemap frame brings it back
+    m_memoryBudget.setShedFunction(MemoryTag::Cubemap, [this](int64_t) { m_dataStreamer->releaseCubemapFrame(); });
+
+    // Stylizer halves its image plane intermediates and drops grown buffers. Watercolor sums stay
+    // float32, because FP16 sums change the result.
+    m_memoryBudget.setShedFunction(MemoryTag::Stylization, [this](int64_t) {
+        m_stylizer->setHalfIntermediates(m_stylizer->getHalfIntermediates() | CpuStylizer::getIntermediateMask(CpuStylizer::Intermediate::Luma) |
+                                         CpuStylizer::getIntermediateMask(CpuStylizer::Intermediate::WatercolorPlanes));
+        m_stylizer->releaseBuffers();
+    });
+
+    m_memoryBudget.setMetrics(&m_metrics);
+}
+
+void AppLogic::updateMetrics()
+{
+    m_metrics.set(m_metricIds.workerQueue, m_threadPool->getQueueDepth());
+
+    // Consumer statistics are cumulative, so they are stored as counter totals
+    if (m_spectator) {
+        m_metrics.set(m_metricIds.spectatorDropped, m_spectator->getStats().droppedFrames);
+    }
+    if (m_replay) {
+        m_metrics.set(m_metricIds.replayDropped, m_replay->getStats().droppedFrames);
+    }
+}
+
 void AppLogic::update()
 {
     // Check for new mixed reality events
-    checkEvents();
+    {
+        MetricsRegistry::ScopedTimer timer(m_metrics, m_metricIds.events);
+        checkEvents();
+        if (m_power->update(getTimestampNs())) {
+            onPowerStateChanged();
+        }
+    }
+    const bool suspended = m_power->isSuspended();
 
     // Sync frame
-    m_varjoView->syncFrame();
+    {
+        MetricsRegistry::ScopedTimer timer(m_metrics, m_metricIds.sync);
+        m_varjoView->syncFrame();
+    }
 
     // Update frame time
     m_appState.general.frameTime += m_varjoView->getDeltaTime();
@@ -368,13 +812,16 @@ void AppLogic::update()
 
 
     // Update scene
-    m_scene->update(m_varjoView->getFrameTime(), m_varjoView->getDeltaTime(), m_varjoView->getFrameNumber(), Scene::UpdateParams());
+    if (!suspended) {
+        MetricsRegistry::ScopedTimer timer(m_metrics, m_metricIds.scene);
+        m_scene->update(m_varjoView->getFrameTime(), m_varjoView->getDeltaTime(), m_varjoView->getFrameNumber(), Scene::UpdateParams());
+    }
 
 #if (!USE_HEADLESS_MODE)
 
-    // Setup render params
+    // Setup render params. Suspended frames are still ended, but without layers.
     LayerView::SubmitParams submitParams{};
-    submitParams.submitLayer = m_appState.general.vrEnabled;
+    submitParams.submitLayer = m_appState.general.vrEnabled && !suspended;
     submitParams.submitDepth = true;
     submitParams.depthTestEnabled = false;
     submitParams.depthTestRangeEnabled = false;
@@ -382,24 +829,85 @@ void AppLogic::update()
     submitParams.chromaKeyEnabled = false;
     submitParams.alphaBlend = true;
 
-    // Begin frame
-    m_varjoView->beginFrame(submitParams);
+    // Generate shading rate maps for this frame's gaze
+    if (m_shadingRateMap && !suspended) {
+        MetricsRegistry::ScopedTimer timer(m_metrics, m_metricIds.shadingRate);
+        updateShadingRate();
+    }
 
-    // Clear frame
-    m_varjoView->clear();
+    {
+        MetricsRegistry::ScopedTimer timer(m_metrics, m_metricIds.render);
 
-    // Render frame
-    m_varjoView->renderScene(*m_scene);
+        // Begin frame
+        m_varjoView->beginFrame(submitParams);
 
-    // End and submit frmae
-    m_varjoView->endFrame();
+        if (!suspended) {
+            // Clear frame
+            m_varjoView->clear();
+
+            // Render frame
+            m_varjoView->renderScene(*m_scene);
+        }
+
+        // End and submit frmae
+        m_varjoView->endFrame();
+    }
 
 #endif
 
-    // Update video post processing if active
-    if (m_appState.general.mrAvailable && m_postProcess->isActive()) {
+    // Update video post processing if active. Suspended application generates no textures and submits no shader inputs.
+    if (m_appState.general.mrAvailable && m_postProcess->isActive() && !suspended) {
+        MetricsRegistry::ScopedTimer timer(m_metrics, m_metricIds.postProcess);
         updatePostProcessing();
     }
+
+    // Update polled metrics and check memory budgets
+    updateMetrics();
+    m_memoryBudget.update(getTimestampNs());
+}
+
+void AppLogic::runFrame()
+{
+    // Apply commands sent by UI since previous frame. Queue is drained without waiting, so UI
+    // thread never holds up frame sync.
+    Command command;
+    while (m_commands.pop(command)) {
+        applyCommand(command);
+    }
+
+    update();
+    publishStatus();
+}
+
+void AppLogic::applyCommand(const Command& command)
+{
+    switch (command.type) {
+        case Command::Type::SetState: {
+            setState(command.state, command.force);
+        } break;
+        case Command::Type::DumpReplay: {
+            dumpReplay(command.seconds);
+        } break;
+        default: {
+            // Ignore unknown command
+        } break;
+    }
+    m_commandSequence = command.sequence;
+}
+
+void AppLogic::publishStatus()
+{
+    Status& status = m_status.getWriteBuffer();
+    status.state = m_appState;
+    status.commandSequence = m_commandSequence;
+    status.spectatorRunning = getSpectatorStats(status.spectatorStats);
+    status.replayRunning = getReplayStats(status.replayStats);
+    status.metricsServerRunning = getMetricsServerStats(status.metricsServerStats);
+    status.powerState = m_power->getState();
+    status.powerReasons = m_power->getReasons();
+    status.powerStats = m_power->getStats(getTimestampNs());
+    status.shadingRateRunning = getShadingRateStats(status.shadingRateStats);
+    m_status.publish();
 }
 
 void AppLogic::onMixedRealityAvailable(bool available, bool forceSetState)
@@ -420,6 +928,13 @@ void AppLogic::onMixedRealityAvailable(bool available, bool forceSetState)
 }
 
 
+void AppLogic::onPowerStateChanged()
+{
+    // Stream consumers and stylizer keep their buffers, so resumed frames are processed without allocating
+    m_threadPool->setPaused(m_power->isSuspended());
+    updateColorStream();
+}
+
 void AppLogic::checkEvents()
 {
     varjo_Bool ret = varjo_False;
@@ -451,8 +966,23 @@ void AppLogic::checkEvents()
                     }
                 } break;
 
+                case varjo_EventType_FoveationStatus: {
+                    // Runtime disables foveation e.g. when gaze tracking is lost. Maps fall back to view center then.
+                    const bool foveationOk = evt.data.foveationStatus.status == varjo_FoveationStatus_Ok;
+                    LOGI("EVENT: Foveation status: %s", foveationOk ? "OK" : "Disabled");
+                } break;
+
+                case varjo_EventType_DataStreamStop: {
+                    // Stops requested by this application are already forgotten by data streamer
+                    if (m_dataStreamer->onStreamStopped(evt.data.dataStreamStop.streamId)) {
+                        LOGI("EVENT: Data stream stopped by runtime: %d", static_cast<int>(evt.data.dataStreamStop.streamId));
+                        m_power->setReason(PowerStateMachine::Reason::StreamStopped, true);
+                    }
+                } break;
+
                 default: {
-                    // Ignore unknown event.
+                    // Standby, visibility and foreground events change power state, others are ignored
+                    m_power->handleEvent(evt);
                 } break;
             }
         }
@@ -3,6 +3,8 @@
 #pragma once
 
 #include <memory>
+#include <thread>
+#include <mutex>
 #include <glm/glm.hpp>
 #include <GL/glew.h>
 
@@ -11,6 +13,20 @@
 #include "LayerView.hpp"
 #include "HeadlessView.hpp"
 #include "Scene.hpp"
+#include "ThreadPool.hpp"
+#include "DataStreamer.hpp"
+#include "SpectatorServer.hpp"
+#include "ReplayBuffer.hpp"
+#include "CpuStylizer.hpp"
+#include "KernelProfile.hpp"
+#include "KernelTuner.hpp"
+#include "MetricsRegistry.hpp"
+#include "MetricsServer.hpp"
+#include "MemoryAccounting.hpp"
+#include "CommandQueue.hpp"
+#include "SnapshotBuffer.hpp"
+#include "PowerStateMachine.hpp"
+#include "ShadingRateMap.hpp"
 
 #include "AppState.hpp"
 #include "PostProcess.hpp"
@@ -21,6 +37,41 @@
 class AppLogic
 {
 public:
+    //! Command sent from UI thread to frame loop
+    struct Command {
+        //! Command type
+        enum class Type {
+            SetState = 0,  //!< Apply application state
+            DumpReplay,    //!< Dump instant replay buffer to file
+        };
+
+        Type type = Type::SetState;  //!< Command type
+        uint64_t sequence = 0;       //!< Sequence number assigned by sender
+        AppState state;              //!< State to apply
+        bool force = false;          //!< Force set whole state
+        double seconds = 0.0;        //!< Seconds of replay to dump
+    };
+
+    //! Status published by frame loop for UI thread
+    struct Status {
+        AppState state;                                          //!< Application state after frame
+        uint64_t commandSequence = 0;                            //!< Sequence number of last applied command
+        bool spectatorRunning = false;                           //!< Spectator stream running flag
+        VarjoExamples::SpectatorServer::Stats spectatorStats;    //!< Spectator stream statistics
+        bool replayRunning = false;                              //!< Instant replay running flag
+        VarjoExamples::ReplayBuffer::Stats replayStats;          //!< Instant replay statistics
+        bool metricsServerRunning = false;                       //!< Metrics endpoint running flag
+        VarjoExamples::MetricsServer::Stats metricsServerStats;  //!< Metrics endpoint statistics
+        VarjoExamples::PowerStateMachine::State powerState;      //!< Power state after frame
+        uint32_t powerReasons = 0;                               //!< Power state reason flags
+        VarjoExamples::PowerStateMachine::Stats powerStats;      //!< Power state accounting
+        bool shadingRateRunning = false;                         //!< Shading rate maps generated flag
+        VarjoExamples::ShadingRateMap::Stats shadingRateStats;   //!< Shading rate map statistics
+    };
+
+    //! Command queue capacity
+    static constexpr size_t c_commandCapacity = 64;
+
     //! Constructor
     AppLogic() = default;
 
@@ -48,6 +99,33 @@ public:
     //! Update application
     void update();
 
+    //! Queue command for frame loop. Call from UI thread only. Returns false if queue is full.
+    bool postCommand(const Command& command) { return m_commands.push(command); }
+
+    //! Apply queued commands, update application and publish status. Call from frame loop thread only.
+    void runFrame();
+
+    //! Returns latest status published by frame loop. Call from UI thread only.
+    const Status& getStatus() { return m_status.read(); }
+
+    //! Get spectator stream statistics. Returns false if spectator stream is not running.
+    bool getSpectatorStats(VarjoExamples::SpectatorServer::Stats& stats) const;
+
+    //! Start writing last given seconds of replay buffer to file. Returns false if replay buffer is not enabled.
+    bool dumpReplay(double seconds);
+
+    //! Get replay buffer statistics. Returns false if replay buffer is not enabled.
+    bool getReplayStats(VarjoExamples::ReplayBuffer::Stats& stats) const;
+
+    //! Returns runtime metrics registry
+    VarjoExamples::MetricsRegistry& getMetrics() { return m_metrics; }
+
+    //! Get metrics endpoint statistics. Returns false if endpoint is not running.
+    bool getMetricsServerStats(VarjoExamples::MetricsServer::Stats& stats) const;
+
+    //! Get shading rate map statistics. Returns false if foveation is not enabled.
+    bool getShadingRateStats(VarjoExamples::ShadingRateMap::Stats& stats) const;
+
 private:
     //! Enable/disable VST rendering
     void setVSTRendering(bool enabled);
@@ -59,11 +137,69 @@ private:
     //! Update post processing
     void updatePostProcessing();
 
+    //! Start/stop spectator stream server
+    void setSpectatorEnabled(bool enabled);
+
+    //! Start/stop instant replay buffer
+    void setReplayEnabled(bool enabled);
+
+    //! Start/stop metrics HTTP endpoint
+    void setMetricsServerEnabled(bool enabled);
+
+    //! Enable/disable dynamic foveation and shading rate map generation
+    void setFoveationEnabled(bool enabled);
+
+    //! Generate shading rate maps from latest gaze
+    void updateShadingRate();
+
+    //! Start color stream if it has consumers and power state allows, otherwise stop it. Returns false if no color stream available.
+    bool updateColorStream();
+
+    //! Start background kernel tuning if profile has no results for given resolution
+    void startKernelTuning(int width, int height);
+
+    //! Register runtime metrics
+    void addMetrics();
+
+    //! Update metrics polled from stream consumers
+    void updateMetrics();
+
+    //! Configure memory budgets and shedding of subsystems
+    void initMemoryBudgets();
+
+    //! Apply command from UI thread
+    void applyCommand(const Command& command);
+
+    //! Publish status for UI thread
+    void publishStatus();
+
 private:
     //! Handle mixed reality availablity
     void onMixedRealityAvailable(bool available, bool forceSetState);
 
+    //! Pause or resume streams and worker threads after power state change
+    void onPowerStateChanged();
+
 private:
+    //! Runtime metric ids
+    struct MetricIds {
+        using Id = VarjoExamples::MetricsRegistry::Id;
+
+        Id events = VarjoExamples::MetricsRegistry::c_invalidId;            //!< Event polling time
+        Id sync = VarjoExamples::MetricsRegistry::c_invalidId;              //!< Frame sync time
+        Id scene = VarjoExamples::MetricsRegistry::c_invalidId;             //!< Scene update time
+        Id render = VarjoExamples::MetricsRegistry::c_invalidId;            //!< Layer render and submit time
+        Id postProcess = VarjoExamples::MetricsRegistry::c_invalidId;       //!< Post process update time
+        Id textureUpdate = VarjoExamples::MetricsRegistry::c_invalidId;     //!< Post process texture update time
+        Id shadingRate = VarjoExamples::MetricsRegistry::c_invalidId;       //!< Shading rate map generation time
+        Id streamLatency = VarjoExamples::MetricsRegistry::c_invalidId;     //!< Color frame exposure to callback latency
+        Id spectatorFrame = VarjoExamples::MetricsRegistry::c_invalidId;    //!< Spectator frame callback time
+        Id replayFrame = VarjoExamples::MetricsRegistry::c_invalidId;       //!< Replay frame callback time
+        Id workerQueue = VarjoExamples::MetricsRegistry::c_invalidId;       //!< Worker thread task queue depth
+        Id spectatorDropped = VarjoExamples::MetricsRegistry::c_invalidId;  //!< Spectator frames dropped
+        Id replayDropped = VarjoExamples::MetricsRegistry::c_invalidId;     //!< Replay frames dropped
+    };
+
     varjo_Session* m_session = nullptr;  //!< Varjo session
 
 #if (!USE_HEADLESS_MODE)
@@ -77,4 +213,40 @@ private:
     std::unique_ptr<VarjoExamples::PostProcess> m_postProcess;  //!< VST post processor
     std::unique_ptr<TestTexture> m_texture;                     //!< Test texture instance
     AppState m_appState;                                        //!< Application state
+
+    std::unique_ptr<VarjoExamples::ThreadPool> m_threadPool;      //!< Worker threads for CPU image processing
+    std::unique_ptr<VarjoExamples::DataStreamer> m_dataStreamer;  //!< Camera data streamer
+    std::unique_ptr<VarjoExamples::SpectatorServer> m_spectator;  //!< Spectator stream server
+    int m_spectatorListener = -1;                                 //!< Spectator frame listener id
+    std::vector<uint8_t> m_spectatorImage;                        //!< Spectator RGBA conversion buffer
+    std::vector<uint8_t> m_spectatorStylized;                     //!< Spectator stylized image buffer
+    std::unique_ptr<VarjoExamples::ReplayBuffer> m_replay;        //!< Instant replay buffer
+    int m_replayListener = -1;                                    //!< Replay frame listener id
+
+    std::unique_ptr<VarjoExamples::CpuStylizer> m_stylizer;     //!< CPU stylizer for spectator frames
+    VarjoExamples::KernelProfile m_kernelProfile;               //!< Kernel tuning profile loaded at startup
+    std::unique_ptr<VarjoExamples::KernelTuner> m_kernelTuner;  //!< Background kernel tuner
+    std::thread m_kernelTunerThread;                            //!< Background kernel tuning thread
+    std::mutex m_stylizerMutex;                                 //!< Stylizer params mutex
+    VarjoExamples::CpuStylizer::Params m_stylizerParams;        //!< Stylizer params from post process state
+
+    VarjoExamples::MetricsRegistry m_metrics;  //!< Runtime metrics updated from frame and stream threads
+    MetricIds m_metricIds;                     //!< Runtime metric ids
+    int m_metricsListener = -1;                //!< Stream metrics frame listener id
+
+    std::unique_ptr<VarjoExamples::MetricsServer> m_metricsServer;  //!< Metrics HTTP endpoint
+
+    std::unique_ptr<VarjoExamples::PowerStateMachine> m_power;  //!< Power and load state from runtime events
+
+    bool m_gazeInitialized = false;                                   //!< Gaze tracking initialized
+    std::unique_ptr<VarjoExamples::ShadingRateMap> m_shadingRateMap;  //!< Gaze, occlusion and content adaptive shading rate maps
+    std::vector<glm::vec2> m_gazeNdc;                                 //!< Gaze point per view
+    int m_shadingRateListener = -1;                                   //!< Shading rate edge frame listener id
+
+    VarjoExamples::MemoryBudget m_memoryBudget;                                       //!< Subsystem memory budgets
+    VarjoExamples::TrackedBytes m_spectatorMemory{VarjoExamples::MemoryTag::Stream};  //!< Spectator image buffer memory hook
+
+    VarjoExamples::CommandQueue<Command, c_commandCapacity> m_commands;  //!< Commands from UI thread
+    VarjoExamples::SnapshotBuffer<Status> m_status;                      //!< Status for UI thread
+    uint64_t m_commandSequence = 0;                                      //!< Sequence number of last applied command
 };
@@ -17,13 +17,28 @@
 struct AppState {
     // General params structure
     struct General {
-        double frameTime = 0.0f;   //!< Current frame time
-        int64_t frameCount = 0;    //!< Current frame count
-        bool mrAvailable = false;  //!< Mixed reality available flag
-        bool vstEnabled = true;    //!< Render VST image flag
+        double frameTime = 0.0f;            //!< Current frame time
+        int64_t frameCount = 0;             //!< Current frame count
+        bool mrAvailable = false;           //!< Mixed reality available flag
+        bool vstEnabled = true;             //!< Render VST image flag
+        bool spectatorEnabled = false;      //!< Spectator stream server flag
+        bool replayEnabled = false;         //!< Instant replay buffer flag
+        bool metricsServerEnabled = false;  //!< Metrics HTTP endpoint flag
 #if (!USE_HEADLESS_MODE)
-        bool vrEnabled = false;  //!< Render VR scene flag
+        bool vrEnabled = false;         //!< Render VR scene flag
+        bool foveationEnabled = false;  //!< Dynamic foveation and shading rate maps flag
 #endif
+
+        bool operator==(const General& other) const
+        {
+            return frameTime == other.frameTime && frameCount == other.frameCount && mrAvailable == other.mrAvailable &&
+                   vstEnabled == other.vstEnabled && spectatorEnabled == other.spectatorEnabled && replayEnabled == other.replayEnabled &&
+#if (!USE_HEADLESS_MODE)
+                   vrEnabled == other.vrEnabled && foveationEnabled == other.foveationEnabled &&
+#endif
+                   metricsServerEnabled == other.metricsServerEnabled;
+        }
+        bool operator!=(const General& other) const { return !(*this == other); }
     } general;
 
     // VST Post process params
@@ -52,12 +67,31 @@ struct AppState {
         float pointilismStep = 0.0f;
         float pointilismThreshold = 0.0f;
 
+        bool oilPaintEnabled = false;
+        int oilPaintRadius = 0;
+
         
         bool grayscaleEnabled = false;
         bool puzzleFuckery = false;
         bool horizontalMirrorFuckery = false;
         bool verticalMirrorFuckery = false;
         
-
+        bool operator==(const PostProcess& other) const
+        {
+            return enabled == other.enabled && shaderSource == other.shaderSource && graphicsAPI == other.graphicsAPI &&
+                   textureType == other.textureType && textureEnabled == other.textureEnabled &&
+                   textureGeneratedOnGPU == other.textureGeneratedOnGPU && cartoonEnabled == other.cartoonEnabled &&
+                   clusterSize == other.clusterSize && outlineIntensity == other.outlineIntensity &&
+                   watercolorEnabled == other.watercolorEnabled && watercolorRadius == other.watercolorRadius &&
+                   sketchEnabled == other.sketchEnabled && sketchIntensity == other.sketchIntensity &&
+                   pointilismEnabled == other.pointilismEnabled && pointilismStep == other.pointilismStep &&
+                   pointilismThreshold == other.pointilismThreshold && oilPaintEnabled == other.oilPaintEnabled &&
+                   oilPaintRadius == other.oilPaintRadius && grayscaleEnabled == other.grayscaleEnabled && puzzleFuckery == other.puzzleFuckery &&
+                   horizontalMirrorFuckery == other.horizontalMirrorFuckery && verticalMirrorFuckery == other.verticalMirrorFuckery;
+        }
+        bool operator!=(const PostProcess& other) const { return !(*this == other); }
     } postProcess;
+
+    bool operator==(const AppState& other) const { return general == other.general && postProcess == other.postProcess; }
+    bool operator!=(const AppState& other) const { return !(*this == other); }
 };
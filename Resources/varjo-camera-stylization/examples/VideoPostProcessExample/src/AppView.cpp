@@ -7,6 +7,8 @@
 #include <iostream>
 #include <imgui_internal.h>
 #include <map>
+#include <cstdio>
+#include <cfloat>
 
 // VarjoExamples namespace contains simple example wrappers for using Varjo API features.
 // These are only meant to be used in SDK example applications. In your own application,
@@ -69,6 +71,16 @@ constexpr int c_logHeight = 230;
 // Default preset
 constexpr int c_defaultPresetIndex = 1;
 
+// Seconds written by instant replay dump
+constexpr double c_replayDumpSeconds = 10.0;
+
+// Performance graph history length and sampling interval
+constexpr double c_metricsHistorySeconds = 10.0;
+constexpr double c_metricsIntervalMs = 50.0;
+
+// Performance graph height
+constexpr float c_plotHeight = 32.0f;
+
 // Post process GUI presets
 const std::vector<std::pair<std::string, AppState::PostProcess>> c_guiPresets = {
     {"Off",
@@ -147,6 +159,9 @@ AppView::AppView(AppLogic& logic)
     // Set log function
     LOG_INIT(std::bind(&UI::writeLogEntry, m_ui.get(), std::placeholders::_1, std::placeholders::_2), LogLevel::Info);
 
+    // UI runs at its own rate, frame loop syncs to Varjo frames on its own thread
+    m_ui->setVSync(true);
+
     // Create contexts
     m_context = std::make_unique<GfxContext>(m_ui->getWindowHandle());
 
@@ -179,12 +194,20 @@ bool AppView::init()
 
     // Reset states
     m_uiState = {};
-    AppState appState;
-    appState.general = m_logic.getState().general;
-    appState.postProcess = c_guiPresets[c_defaultPresetIndex].second;
+    m_state = AppState();
+    m_state.general = m_logic.getState().general;
+    m_state.postProcess = c_guiPresets[c_defaultPresetIndex].second;
 
-    // Force set initial state
-    m_logic.setState(appState, true);
+    // Force set initial state. Frame loop applies it before its first frame.
+    sendState(true);
+
+    // Create frame loop. Its interval timer is shown in performance panel.
+    m_frameLoop = std::make_unique<FrameLoop>();
+    m_frameLoop->setMetrics(&m_logic.getMetrics());
+
+    // Create metrics history for performance panel
+    m_metricsHistory = std::make_unique<MetricsHistory>(m_logic.getMetrics(), c_metricsHistorySeconds, c_metricsIntervalMs);
+    m_hudMetric = m_logic.getMetrics().addMetric("Performance panel", MetricsRegistry::Kind::Timer);
 
     return true;
 }
@@ -193,8 +216,25 @@ void AppView::run()
 {
     LOGD("Entering main loop.");
 
+    // NOTICE! Frame loop owns Varjo session and graphics contexts while it runs, and UI thread only
+    // exchanges commands and status with it. This way window resizing, log layout or a slow UI
+    // frame can not delay frame submission. OpenGL context can only be current on one thread, so
+    // it moves to frame loop thread for the loop's lifetime.
+    const auto frame = [this]() {
+        m_logic.runFrame();
+        return true;
+    };
+    const auto bindGL = [this]() { m_context->setGLCurrent(true); };
+    const auto releaseGL = [this]() { m_context->setGLCurrent(false); };
+    m_context->setGLCurrent(false);
+    m_frameLoop->start(frame, bindGL, releaseGL);
+
     // Run UI main loop
     m_ui->run();
+
+    // Stop frame loop before logic is freed, and take OpenGL context back for freeing its resources
+    m_frameLoop->stop();
+    m_context->setGLCurrent(true);
 }
 
 bool AppView::onFrame(UI& ui)
@@ -204,17 +244,19 @@ bool AppView::onFrame(UI& ui)
         return false;
     }
 
-    // Check for varjo events
-    m_logic.checkEvents();
+    // Send state that did not fit to command queue on previous frame
+    if (m_statePending) {
+        sendState(false);
+    }
 
-    // Update state to logic state
+    // Update UI from frame loop status and send edits back to it
     updateUI();
 
-    // Update application logic
-    m_logic.update();
+    // Sample metrics for performance graphs
+    m_metricsHistory->update(getTimestampNs());
 
-    // Return true to continue running
-    return true;
+    // Continue running as long as frame loop runs
+    return m_frameLoop->isRunning();
 }
 
 void AppView::onKeyPress(UI& ui, int keyCode)
@@ -225,7 +267,7 @@ void AppView::onKeyPress(UI& ui, int keyCode)
     }
 
     bool stateDirty = false;
-    auto appState = m_logic.getState();
+    auto appState = m_state;
 
     // Check for input action
     Action action = Action::None;
@@ -286,7 +328,8 @@ void AppView::onKeyPress(UI& ui, int keyCode)
 
     // Update state if changed
     if (stateDirty) {
-        m_logic.setState(appState, false);
+        m_state = appState;
+        sendState(false);
     }
 }
 
@@ -307,8 +350,16 @@ void AppView::updateUI()
         ImGui::PopItemFlag(); \
     }
 
-    // Update from logic state
-    AppState appState = m_logic.getState();
+    // Take state from frame loop once it has applied all commands sent from UI. Until then keep own
+    // edits, so that controls do not flip back while commands are on their way.
+    const AppLogic::Status& status = m_logic.getStatus();
+    if (!m_statePending && status.commandSequence == m_commandSequence) {
+        m_state = status.state;
+    } else {
+        m_state.general.frameTime = status.state.general.frameTime;
+        m_state.general.frameCount = status.state.general.frameCount;
+    }
+    AppState appState = m_state;
 
     // Update UI state from logic state
     m_uiState.postProcessShaderSourceIndex = static_cast<int>(appState.postProcess.shaderSource);
@@ -333,6 +384,16 @@ void AppView::updateUI()
         ImGui::Checkbox("Render video", &appState.general.vstEnabled);
         ImGui::SameLine();
         ImGui::Checkbox("Post process video", &appState.postProcess.enabled);
+        ImGui::SameLine();
+        ImGui::Checkbox("Spectator stream", &appState.general.spectatorEnabled);
+        ImGui::SameLine();
+        ImGui::Checkbox("Instant replay", &appState.general.replayEnabled);
+        ImGui::SameLine();
+        ImGui::Checkbox("Metrics endpoint", &appState.general.metricsServerEnabled);
+#if (!USE_HEADLESS_MODE)
+        ImGui::SameLine();
+        ImGui::Checkbox("Dynamic foveation", &appState.general.foveationEnabled);
+#endif
 
         {
             std::array<char*, 3> items = {"None", "Binary Blob", "HLSL Source"};
@@ -389,6 +450,13 @@ void AppView::updateUI()
         ImGui::Dummy(ImVec2(0.0f, h));
 #undef _TAG
 
+        // Oil paint has only CPU implementation, so it affects stylized stream frames only
+#define _TAG "##oilpaint"
+        ImGui::Checkbox("Oil paint (CPU stream)" _TAG, &appState.postProcess.oilPaintEnabled);
+        ImGui::SliderInt("Oil paint radius" _TAG, &appState.postProcess.oilPaintRadius, 1, CpuStylizer::c_maxOilPaintRadius);
+        ImGui::Dummy(ImVec2(0.0f, h));
+#undef _TAG
+
 
         ImGui::Text("Apply preset: ");
         const auto presets = c_guiPresets;
@@ -404,10 +472,58 @@ void AppView::updateUI()
         }
 
         ImGui::Dummy(ImVec2(0.0f, h));
-        ImGui::Text("Frame timing: %.3f fps / %.3f ms / %.3f s / %d frames",  //
-            ImGui::GetIO().Framerate,                                         //
-            1000.0f / ImGui::GetIO().Framerate,                               //
-            appState.general.frameTime, appState.general.frameCount);
+        const FrameLoop::Stats loopStats = m_frameLoop->getStats();
+        ImGui::Text("Frame timing: %.3f s / %d frames / %.3f ms mean / %.3f ms max / %.3f ms jitter",  //
+            appState.general.frameTime, appState.general.frameCount,                                  //
+            loopStats.intervalMeanMs, loopStats.intervalMaxMs, loopStats.jitterMs);
+        ImGui::Text("UI timing: %.3f fps / %.3f ms", ImGui::GetIO().Framerate, 1000.0f / ImGui::GetIO().Framerate);
+
+        // Process CPU usage per power state shows what suspending saves
+        const auto& powerStates = status.powerStats.states;
+        ImGui::Text("Power: %s (%s) / %.2f cores active / %.2f cores suspended / %lld transitions",  //
+            PowerStateMachine::getStateName(status.powerState), PowerStateMachine::getReasonNames(status.powerReasons).c_str(),
+            powerStates[static_cast<int>(PowerStateMachine::State::Active)].cpuUsage,
+            powerStates[static_cast<int>(PowerStateMachine::State::Suspended)].cpuUsage, status.powerStats.transitions);
+
+        if (status.spectatorRunning) {
+            const SpectatorServer::Stats& spectatorStats = status.spectatorStats;
+            ImGui::Text("Spectator: %d clients / %.2f Mbps / encode %.2f ms (max %.2f ms) / %.1f%% tiles / %lld dropped",  //
+                spectatorStats.clients, spectatorStats.bandwidthMbps, spectatorStats.encodeTimeAvgMs, spectatorStats.encodeTimeMaxMs,
+                spectatorStats.changedTileRatio * 100.0, spectatorStats.droppedFrames);
+        }
+
+        if (status.replayRunning) {
+            const ReplayBuffer::Stats& replayStats = status.replayStats;
+            ImGui::Text("Replay: %.1f s / %lld frames / %.0f of %.0f MB / %.2f frames per MB / %lld dropped",  //
+                replayStats.retainedSeconds, replayStats.frames, replayStats.usedBytes / 1048576.0, replayStats.budgetBytes / 1048576.0,
+                replayStats.framesPerMB, replayStats.droppedFrames);
+            _PUSHDISABLEDIF(replayStats.dumping);
+            if (ImGui::Button("Dump last 10 s")) {
+                AppLogic::Command command;
+                command.type = AppLogic::Command::Type::DumpReplay;
+                command.seconds = c_replayDumpSeconds;
+                if (!sendCommand(command)) {
+                    LOGW("Frame loop busy, replay not dumped.");
+                }
+            }
+            _POPDISABLEDIF(replayStats.dumping);
+        }
+
+        if (status.metricsServerRunning) {
+            const MetricsServer::Stats& metricsStats = status.metricsServerStats;
+            ImGui::Text("Metrics endpoint: port %d / %lld scrapes / %.1f KB sent / %.2f ms (max %.2f ms) per scrape", MetricsServer::c_defaultPort,
+                metricsStats.scrapes, metricsStats.bytesSent / 1024.0, metricsStats.scrapeTimeAvgMs, metricsStats.scrapeTimeMaxMs);
+        }
+
+        if (status.shadingRateRunning) {
+            const ShadingRateMap::Stats& shadingRateStats = status.shadingRateStats;
+            ImGui::Text("Shading rate: %.1f%% shaded / %.3f ms (max %.3f ms) per map / %lld maps / %lld camera frames",  //
+                shadingRateStats.shadedFraction * 100.0, shadingRateStats.lastTimeNs * 1e-6, shadingRateStats.maxTimeNs * 1e-6,
+                shadingRateStats.maps, shadingRateStats.edgeGrids);
+        }
+
+        ImGui::Dummy(ImVec2(0.0f, h));
+        drawPerformance();
         ImGui::End();
     }
 
@@ -432,6 +548,58 @@ void AppView::updateUI()
     // Set UI item active flag
     m_uiState.anyItemActive = ImGui::IsAnyItemActive();
 
-    // Update state from UI back to logic
-    m_logic.setState(appState, false);
+    // Send state to frame loop if edited this frame
+    if (appState != m_state) {
+        m_state = appState;
+        sendState(false);
+    }
+}
+
+void AppView::sendState(bool force)
+{
+    AppLogic::Command command;
+    command.type = AppLogic::Command::Type::SetState;
+    command.state = m_state;
+    command.force = force;
+    m_statePending = !sendCommand(command);
+}
+
+bool AppView::sendCommand(AppLogic::Command command)
+{
+    command.sequence = m_commandSequence + 1;
+    if (!m_logic.postCommand(command)) {
+        return false;
+    }
+    m_commandSequence = command.sequence;
+    return true;
+}
+
+void AppView::drawPerformance()
+{
+    // NOTICE! Metrics are sampled once per interval and plotted from preallocated history, so the
+    // panel only reads floats and builds draw commands. Its own time is shown as one of the graphs.
+    MetricsRegistry::ScopedTimer timer(m_logic.getMetrics(), m_hudMetric);
+
+    if (!ImGui::CollapsingHeader("Performance")) {
+        return;
+    }
+
+    const MetricsRegistry& registry = m_metricsHistory->getRegistry();
+    const int length = m_metricsHistory->getLength();
+    const int offset = m_metricsHistory->getOffset();
+
+    ImGui::Text("Last %.0f s, sampled every %.0f ms", c_metricsHistorySeconds, c_metricsIntervalMs);
+
+    for (int i = 0; i < registry.getCount(); i++) {
+        const char* unit = "";
+        switch (registry.getKind(i)) {
+            case MetricsRegistry::Kind::Counter: unit = "/s"; break;
+            case MetricsRegistry::Kind::Gauge: unit = ""; break;
+            case MetricsRegistry::Kind::Timer: unit = "ms"; break;
+        }
+
+        char overlay[64];
+        snprintf(overlay, sizeof(overlay), "%.3f %s (max %.3f)", m_metricsHistory->getLatest(i), unit, m_metricsHistory->getMax(i));
+        ImGui::PlotLines(registry.getName(i), m_metricsHistory->getSamples(i), length, offset, overlay, 0.0f, FLT_MAX, ImVec2(0.0f, c_plotHeight));
+    }
 }
\ No newline at end of file
@@ -9,6 +9,8 @@
 
 #include "Globals.hpp"
 #include "UI.hpp"
+#include "MetricsRegistry.hpp"
+#include "FrameLoop.hpp"
 
 #include "GfxContext.hpp"
 #include "AppLogic.hpp"
@@ -55,9 +57,26 @@ private:
     //! Updates UI based on logic state and writes changes back to it.
     void updateUI();
 
+    //! Draw performance panel with metric history graphs
+    void drawPerformance();
+
+    //! Send UI state to frame loop. State is sent again on next UI frame if command queue is full.
+    void sendState(bool force);
+
+    //! Send command to frame loop. Returns false if command queue is full.
+    bool sendCommand(AppLogic::Command command);
+
 private:
     AppLogic& m_logic;                        //!< App logic instance
     std::unique_ptr<VarjoExamples::UI> m_ui;  //!< User interface wrapper
     std::unique_ptr<GfxContext> m_context;    //!< Graphics contexts
     UIState m_uiState{};                      //!< UI specific states
+
+    std::unique_ptr<VarjoExamples::MetricsHistory> m_metricsHistory;                               //!< Rolling metrics history for graphs
+    VarjoExamples::MetricsRegistry::Id m_hudMetric = VarjoExamples::MetricsRegistry::c_invalidId;  //!< Performance panel draw time
+
+    std::unique_ptr<VarjoExamples::FrameLoop> m_frameLoop;  //!< Frame loop thread running app logic
+    AppState m_state;                                       //!< State edited in UI
+    uint64_t m_commandSequence = 0;                         //!< Sequence number of last sent command
+    bool m_statePending = false;                            //!< State not yet sent because command queue was full
 };
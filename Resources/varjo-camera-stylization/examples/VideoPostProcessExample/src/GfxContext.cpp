@@ -26,6 +26,13 @@ void GfxContext::init(IDXGIAdapter* adapter)
     initD3D12(adapter);
 }
 
+void GfxContext::setGLCurrent(bool current)
+{
+    if (wglMakeCurrent(current ? m_hdc : NULL, current ? m_hglrc : NULL) == false) {
+        LOGE("Failed to %s OpenGL context.", current ? "make current" : "release");
+    }
+}
+
 void GfxContext::initD3D11(IDXGIAdapter* adapter)
 {
     LOGI("Initializing D3D11 context..");
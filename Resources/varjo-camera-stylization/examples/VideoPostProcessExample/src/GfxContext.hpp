@@ -31,6 +31,10 @@ public:
     //! Returns D3D12 command queue
     ComPtr<ID3D12CommandQueue> getD3D12CommandQueue() const { return m_d3d12Queue; }
 
+    //! Make OpenGL context current on calling thread, or release it from calling thread. Context can be
+    //! current on one thread at a time, so release it before making it current on another thread.
+    void setGLCurrent(bool current);
+
 private:
     //! Initialize OpenGL
     void initGL();
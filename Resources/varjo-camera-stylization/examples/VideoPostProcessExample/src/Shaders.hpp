@@ -7,32 +7,17 @@
 #include <glm/glm.hpp>
 
 #include "PostProcess.hpp"
+#include "PostProcessConstants.hpp"
 
 // This is example shader for showcasing how to use video post process filters from
 // your own application. In your application, implement your own shader that suits
 // your needs.
 
-//! Post process constant buffer. Must match with the shader exactly!
-struct PostProcessConstantBuffer {
-
-    int clusterSize = 0;
-    float outlineIntensity = 0.0f;
-
-    int watercolorRadius = 0;
-    float sketchIntensity = 0.0f;
-
-    float pointilismStep = 0.0f;
-    float pointilismThreshold = 0.0f;
-    
-    float _padding0[2];
- 
-};
-
 // Shader parameters
 static const VarjoExamples::PostProcess::ShaderParams c_postProcessShaderParams = {  //
     8,                                                                               // Block size
     3,                                                                               // Sampling margin
-    sizeof(PostProcessConstantBuffer),                                               // Size of constant buffer
+    sizeof(VarjoExamples::PostProcessConstantBuffer),                                // Size of constant buffer
     {
         // Texture size and format. Enable one of these for testing the format.
         {256, 256, varjo_TextureFormat_R8G8B8A8_UNORM},